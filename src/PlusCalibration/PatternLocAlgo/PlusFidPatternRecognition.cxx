@@ -9,6 +9,8 @@ See License.txt for details.
 #include "vtkMath.h"
 #include "vtkPoints.h"
 #include "vtkLine.h"
+#include "vtkMultiThreader.h"
+#include "vtkSmartPointer.h"
 
 #include "vtkIGSIOTrackedFrameList.h"
 #include "igsioTrackedFrame.h"
@@ -16,9 +18,54 @@ See License.txt for details.
 static const double DOT_STEPS  = 4.0;
 static const double DOT_RADIUS = 6.0;
 
+namespace
+{
+  /*! Shared data of the threads that process the frames of a tracked frame list */
+  struct FrameListRecognitionInfo
+  {
+    vtkIGSIOTrackedFrameList* TrackedFrameList;
+    const std::vector<unsigned int>* FrameIndices;
+    /*! Pattern recognition object of each thread, each thread uses only its own */
+    std::vector<PlusFidPatternRecognition*> Workers;
+    std::vector<PlusStatus>* Statuses;
+    std::vector<PlusFidPatternRecognition::PatternRecognitionError>* Errors;
+    std::vector<PlusPatternRecognitionResult>* Results;
+  };
+
+  //-----------------------------------------------------------------------------
+  void RecognizePatternInFrameRange(FrameListRecognitionInfo& info, int threadId, int numberOfThreads)
+  {
+    PlusFidPatternRecognition* worker = info.Workers[threadId];
+    // Frames are assigned to the threads in an interleaved order, as consecutive frames tend to have similar processing time
+    for (unsigned int i = threadId; i < info.FrameIndices->size(); i += numberOfThreads)
+    {
+      unsigned int frameIndex = (*info.FrameIndices)[i];
+      igsioTrackedFrame* trackedFrame = info.TrackedFrameList->GetTrackedFrame(frameIndex);
+      if (info.Results != NULL)
+      {
+        (*info.Statuses)[i] = worker->RecognizePattern(trackedFrame, (*info.Results)[i], (*info.Errors)[i], frameIndex);
+      }
+      else
+      {
+        (*info.Statuses)[i] = worker->RecognizePattern(trackedFrame, (*info.Errors)[i], frameIndex);
+      }
+    }
+  }
+
+  //-----------------------------------------------------------------------------
+  VTK_THREAD_RETURN_TYPE RecognizePatternThread(void* arg)
+  {
+    vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+    FrameListRecognitionInfo* info = static_cast<FrameListRecognitionInfo*>(threadInfo->UserData);
+    RecognizePatternInFrameRange(*info, threadInfo->ThreadID, threadInfo->NumberOfThreads);
+    return VTK_THREAD_RETURN_VALUE;
+  }
+}
+
 //-----------------------------------------------------------------------------
 
 PlusFidPatternRecognition::PlusFidPatternRecognition()
+  : m_NumberOfThreads(vtkMultiThreader::GetGlobalDefaultNumberOfThreads())
 {
 
 }
@@ -46,6 +93,13 @@ PlusStatus PlusFidPatternRecognition::ReadConfiguration(vtkXMLDataElement* rootC
   m_FidLineFinder.ReadConfiguration(rootConfigElement);
   m_FidLabeling.ReadConfiguration(rootConfigElement, m_FidLineFinder.GetMinThetaRad(), m_FidLineFinder.GetMaxThetaRad());
 
+  vtkXMLDataElement* segmentationParameters = rootConfigElement->FindNestedElementWithName("Segmentation");
+  int numberOfThreads = 0;
+  if (segmentationParameters != NULL && segmentationParameters->GetScalarAttribute("NumberOfThreads", numberOfThreads))
+  {
+    SetNumberOfThreads(numberOfThreads);
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -178,17 +232,28 @@ PlusStatus PlusFidPatternRecognition::RecognizePattern(vtkIGSIOTrackedFrameList*
     *numberOfSuccessfullySegmentedImages = 0;
   }
 
+  // segment only non segmented frames
+  std::vector<unsigned int> frameIndices;
   for (unsigned int currentFrameIndex = 0; currentFrameIndex < trackedFrameList->GetNumberOfTrackedFrames(); currentFrameIndex++)
   {
-    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(currentFrameIndex);
-
-    // segment only non segmented frames
-    if (trackedFrame->GetFiducialPointsCoordinatePx() != NULL)
+    if (trackedFrameList->GetTrackedFrame(currentFrameIndex)->GetFiducialPointsCoordinatePx() == NULL)
     {
-      continue;
+      frameIndices.push_back(currentFrameIndex);
     }
+  }
+
+  std::vector<PlusStatus> frameStatuses;
+  std::vector<PatternRecognitionError> frameErrors;
+  RecognizePatternInFrames(trackedFrameList, frameIndices, frameStatuses, frameErrors, NULL);
 
-    if (RecognizePattern(trackedFrame, patternRecognitionError, currentFrameIndex) != PLUS_SUCCESS)
+  // Collect the results in frame order, so that they are the same as if the frames were processed one by one
+  for (unsigned int i = 0; i < frameIndices.size(); i++)
+  {
+    unsigned int currentFrameIndex = frameIndices[i];
+    igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(currentFrameIndex);
+
+    patternRecognitionError = frameErrors[i];
+    if (frameStatuses[i] != PLUS_SUCCESS)
     {
       if (patternRecognitionError != PATTERN_RECOGNITION_ERROR_TOO_MANY_CANDIDATES)
       {
@@ -217,6 +282,82 @@ PlusStatus PlusFidPatternRecognition::RecognizePattern(vtkIGSIOTrackedFrameList*
 
 //-----------------------------------------------------------------------------
 
+PlusStatus PlusFidPatternRecognition::RecognizePattern(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<PlusPatternRecognitionResult>& patternRecognitionResults, std::vector<PatternRecognitionError>& patternRecognitionErrors)
+{
+  LOG_TRACE("FidPatternRecognition::RecognizePattern");
+
+  std::vector<unsigned int> frameIndices(trackedFrameList->GetNumberOfTrackedFrames());
+  for (unsigned int currentFrameIndex = 0; currentFrameIndex < frameIndices.size(); currentFrameIndex++)
+  {
+    frameIndices[currentFrameIndex] = currentFrameIndex;
+  }
+
+  std::vector<PlusStatus> frameStatuses;
+  RecognizePatternInFrames(trackedFrameList, frameIndices, frameStatuses, patternRecognitionErrors, &patternRecognitionResults);
+
+  PlusStatus status = PLUS_SUCCESS;
+  for (unsigned int currentFrameIndex = 0; currentFrameIndex < frameIndices.size(); currentFrameIndex++)
+  {
+    if (frameStatuses[currentFrameIndex] != PLUS_SUCCESS && patternRecognitionErrors[currentFrameIndex] != PATTERN_RECOGNITION_ERROR_TOO_MANY_CANDIDATES)
+    {
+      LOG_ERROR("Recognizing pattern failed on frame " << currentFrameIndex);
+      status = PLUS_FAIL;
+    }
+  }
+
+  return status;
+}
+
+//-----------------------------------------------------------------------------
+
+void PlusFidPatternRecognition::RecognizePatternInFrames(vtkIGSIOTrackedFrameList* trackedFrameList, const std::vector<unsigned int>& frameIndices, std::vector<PlusStatus>& statuses, std::vector<PatternRecognitionError>& errors, std::vector<PlusPatternRecognitionResult>* results)
+{
+  statuses.assign(frameIndices.size(), PLUS_FAIL);
+  errors.assign(frameIndices.size(), PATTERN_RECOGNITION_ERROR_NO_ERROR);
+  if (results != NULL)
+  {
+    results->assign(frameIndices.size(), PlusPatternRecognitionResult());
+  }
+
+  int numberOfThreads = std::max(1, std::min(m_NumberOfThreads, static_cast<int>(frameIndices.size())));
+  if (m_FidSegmentation.GetDebugOutput())
+  {
+    // Debug images of the intermediate processing steps are written to the same files for all frames
+    numberOfThreads = 1;
+  }
+
+  vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+  threader->SetNumberOfThreads(numberOfThreads);
+  numberOfThreads = threader->GetNumberOfThreads();
+
+  FrameListRecognitionInfo info;
+  info.TrackedFrameList = trackedFrameList;
+  info.FrameIndices = &frameIndices;
+  info.Statuses = &statuses;
+  info.Errors = &errors;
+  info.Results = results;
+
+  // The first thread uses this object, the others work on their own copy of the segmentation, line finder and labeling state.
+  // Patterns are shared, as they are not modified during recognition.
+  std::vector<PlusFidPatternRecognition> workerCopies(numberOfThreads - 1, *this);
+  info.Workers.push_back(this);
+  for (unsigned int i = 0; i < workerCopies.size(); i++)
+  {
+    info.Workers.push_back(&workerCopies[i]);
+  }
+
+  if (numberOfThreads == 1)
+  {
+    RecognizePatternInFrameRange(info, 0, 1);
+    return;
+  }
+
+  threader->SetSingleMethod(&RecognizePatternThread, &info);
+  threader->SingleMethodExecute();
+}
+
+//-----------------------------------------------------------------------------
+
 void PlusFidPatternRecognition::DrawDots(PlusFidSegmentation::PixelType* image)
 {
   LOG_TRACE("FidPatternRecognition::DrawDots");
@@ -51,6 +51,14 @@ public:
   */
   PlusStatus RecognizePattern(vtkIGSIOTrackedFrameList* trackedFrameList, PatternRecognitionError& patternRecognitionError, int* numberOfSuccessfullySegmentedImages = NULL, std::vector<unsigned int>* segmentedFramesIndices = NULL);
 
+  /*!
+  Run pattern recognition on all the frames of a tracked frame list and return the detailed result of each frame.
+  \param trackedFrameList Tracked frame list to segment
+  \param patternRecognitionResults Out parameter holding the pattern recognition result of each frame (in frame order)
+  \param patternRecognitionErrors Out parameter holding detailed information about the success of the recognition of each frame (in frame order)
+  */
+  PlusStatus RecognizePattern(vtkIGSIOTrackedFrameList* trackedFrameList, std::vector<PlusPatternRecognitionResult>& patternRecognitionResults, std::vector<PatternRecognitionError>& patternRecognitionErrors);
+
   /*!
   Run pattern recognition on a tracked frame list.
   \param trackedFrame image to segment
@@ -95,7 +103,21 @@ public:
   /*! Reads the phantom definition and computes the NWires intersection if needed */
   PlusStatus ReadPhantomDefinition(vtkXMLDataElement* rootConfigElement);
 
+  /*!
+    Set the number of threads used for processing the frames of a tracked frame list.
+    Each thread processes a subset of the frames with its own copy of the segmentation, line finder and labeling state.
+    The results are merged in frame order, therefore they do not depend on the number of threads.
+    Default is the number of processors.
+  */
+  void SetNumberOfThreads(int numberOfThreads) { m_NumberOfThreads = numberOfThreads; };
+  int GetNumberOfThreads() const { return m_NumberOfThreads; };
+
 protected:
+  /*!
+    Run pattern recognition on the listed frames of a tracked frame list, distributed over multiple threads.
+    Statuses, errors and the optional results are stored at the position of the frame index in frameIndices.
+  */
+  void RecognizePatternInFrames(vtkIGSIOTrackedFrameList* trackedFrameList, const std::vector<unsigned int>& frameIndices, std::vector<PlusStatus>& statuses, std::vector<PatternRecognitionError>& errors, std::vector<PlusPatternRecognitionResult>* results);
 
   PlusFidSegmentation           m_FidSegmentation;
   PlusFidLineFinder             m_FidLineFinder;
@@ -103,6 +125,9 @@ protected:
   std::vector<PlusFidPattern*>  m_Patterns;
 
   double                        m_MaxLineLengthToleranceMm;
+
+  /*! Number of threads used for processing the frames of a tracked frame list */
+  int                           m_NumberOfThreads;
 };
 
 //-----------------------------------------------------------------------------
@@ -13,6 +13,12 @@
 #include <iostream>
 #include <algorithm>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+// SSE2 is available on all x86-64 processors, used for pixel-wise minimum/maximum of image rows
+#include <emmintrin.h>
+#define PLUS_FID_SEGMENTATION_USE_SSE2
+#endif
+
 #include "itkRGBPixel.h"
 #include "itkImage.h"
 #include "itkImageFileReader.h"
@@ -52,10 +58,10 @@ PlusFidSegmentation::PlusFidSegmentation()
   , m_ApproximateSpacingMmPerPixel(-1)
   , m_DotsFound(false)
   , m_NumDots(-1.0)
-  , m_Working(new PlusFidSegmentation::PixelType[1])
-  , m_Dilated(new PlusFidSegmentation::PixelType[1])
-  , m_Eroded(new PlusFidSegmentation::PixelType[1])
-  , m_UnalteredImage(new PlusFidSegmentation::PixelType[1])
+  , m_Working(1)
+  , m_Dilated(1)
+  , m_Eroded(1)
+  , m_UnalteredImage(1)
   , m_DebugOutput(false)
 {
   //Initialization of member variables
@@ -93,10 +99,6 @@ PlusFidSegmentation::PlusFidSegmentation()
 
 PlusFidSegmentation::~PlusFidSegmentation()
 {
-  delete[] m_Dilated;
-  delete[] m_Eroded;
-  delete[] m_Working;
-  delete[] m_UnalteredImage;
 }
 
 //-----------------------------------------------------------------------------
@@ -108,6 +110,7 @@ void PlusFidSegmentation::UpdateParameters()
   // Create morphological circle
   m_MorphologicalCircle.clear();
   int radiuspx = floor((m_MorphologicalOpeningCircleRadiusMm / m_ApproximateSpacingMmPerPixel) + 0.5);
+  m_MorphologicalCircleRowHalfWidths.assign(radiuspx >= 0 ? 2 * radiuspx + 1 : 0, -1);
   for (int x = -radiuspx; x <= radiuspx; x++)
   {
     for (int y = -radiuspx; y <= radiuspx; y++)
@@ -118,6 +121,8 @@ void PlusFidSegmentation::UpdateParameters()
         dot.X = y;
         dot.Y = x;
         m_MorphologicalCircle.push_back(dot);
+        // circle operations use X as row offset and Y as column offset
+        m_MorphologicalCircleRowHalfWidths[dot.X + radiuspx] = std::max(m_MorphologicalCircleRowHalfWidths[dot.X + radiuspx], dot.Y);
       }
     }
   }
@@ -223,24 +228,16 @@ void PlusFidSegmentation::SetFrameSize(const FrameSizeType& frameSize)
     return;
   }
 
-  if ((m_FrameSize[0] != 0) && (m_FrameSize[1] != 0))
-  {
-    delete[] m_Dilated;
-    delete[] m_Eroded;
-    delete[] m_Working;
-    delete[] m_UnalteredImage;
-  }
-
   m_FrameSize[0] = frameSize[0];
   m_FrameSize[1] = frameSize[1];
   m_FrameSize[2] = 1;
 
-  // Create working images (after deleting them in case they were already created)
+  // Create working images (replacing them in case they were already created)
   long size = m_FrameSize[0] * m_FrameSize[1];
-  m_Dilated = new PlusFidSegmentation::PixelType[size];
-  m_Eroded = new PlusFidSegmentation::PixelType[size];
-  m_Working = new PlusFidSegmentation::PixelType[size];
-  m_UnalteredImage = new PlusFidSegmentation::PixelType[size];
+  m_Dilated.assign(size, 0);
+  m_Eroded.assign(size, 0);
+  m_Working.assign(size, 0);
+  m_UnalteredImage.assign(size, 0);
 
   // Set ROI to the largest possible if not already set
   if ((m_RegionOfInterest[0] == 0) || (m_RegionOfInterest[1] == 0) || (m_RegionOfInterest[2] == 0) || (m_RegionOfInterest[3] == 0))
@@ -298,590 +295,399 @@ unsigned int PlusFidSegmentation::GetMorphologicalOpeningBarSizePx()
 }
 
 //-----------------------------------------------------------------------------
-
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+// Morphological operation kernels
+namespace
 {
-  //LOG_TRACE("FidSegmentation::ErodePoint0");
+  typedef PlusFidSegmentation::PixelType PixelType;
 
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = ir * m_FrameSize[0] + ic - barSize; // current pixel - bar size (position of the start of the bar)
-  unsigned int p_max = ir * m_FrameSize[0] + ic + barSize; // current pixel +  bar size (position of the end  of the bar)
-
-  //find lowest intensity in bar shaped area in image
-  for (; p <= p_max; p++)
+  /*! Returns true if the region of interest (xmin, ymin, xmax, ymax) contains no pixels */
+  inline bool IsRegionEmpty(const std::array<unsigned int, 4>& roi)
   {
-    if (image[p] < dval)
-    {
-      dval = image[p];
-    }
-    if (image[p] == 0)
-    {
-      break;
-    }
+    return roi[0] >= roi[2] || roi[1] >= roi[3];
   }
 
-  return dval;
-}
-
-//-----------------------------------------------------------------------------
-
-void PlusFidSegmentation::Erode0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
-{
-  //LOG_TRACE("FidSegmentation::Erode0");
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
+  /*! Pixel-wise minimum (used for erosion) */
+  struct MinimumOperator
   {
-    unsigned int ic = m_RegionOfInterest[0];
-    unsigned int p_base = ir * m_FrameSize[0];
+    static inline PixelType Apply(PixelType a, PixelType b) { return a < b ? a : b; }
+#ifdef PLUS_FID_SEGMENTATION_USE_SSE2
+    static inline __m128i Apply(__m128i a, __m128i b) { return _mm_min_epu8(a, b); }
+#endif
+  };
 
-    PlusFidSegmentation::PixelType dval = ErodePoint0(image, ir, ic);   // find lowest pixel intensity in surrounding region ( positions +/- 8 of current pixel position)
-    dest[p_base + ic] = dval; // p_base+ic = current pixel
+  /*! Pixel-wise maximum (used for dilation) */
+  struct MaximumOperator
+  {
+    static inline PixelType Apply(PixelType a, PixelType b) { return a > b ? a : b; }
+#ifdef PLUS_FID_SEGMENTATION_USE_SSE2
+    static inline __m128i Apply(__m128i a, __m128i b) { return _mm_max_epu8(a, b); }
+#endif
+  };
 
-    for (ic++; ic < m_RegionOfInterest[2]; ic++)
+  //-----------------------------------------------------------------------------
+  /*! dest[i] = Operator(a[i], b[i]) for a contiguous span of pixels. dest may be the same as a or b. */
+  template<class Operator>
+  inline void ApplyOperatorToSpan(PixelType* dest, const PixelType* a, const PixelType* b, int numberOfPixels)
+  {
+    int i = 0;
+#ifdef PLUS_FID_SEGMENTATION_USE_SSE2
+    for (; i + 16 <= numberOfPixels; i += 16)
     {
-      PlusFidSegmentation::PixelType new_val = image[p_base + ic + barSize];
-      PlusFidSegmentation::PixelType del_val = image[p_base + ic - 1 - barSize];
-
-      dval = new_val <= dval ? new_val  : // dval = new val if new val is less than or equal to dval
-             del_val > dval ? std::min(dval, new_val) :   // if del val is greater than dval, dval= min of dval and new val
-             ErodePoint0(image, ir, ic);   //else dval = result of erode function
-
-      dest[ir * m_FrameSize[0] + ic] = dval; // update new "eroded" picture
+      __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+      __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), Operator::Apply(va, vb));
+    }
+#endif
+    for (; i < numberOfPixels; i++)
+    {
+      dest[i] = Operator::Apply(a[i], b[i]);
     }
   }
-}
-
-//-----------------------------------------------------------------------------
-
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
-{
-  //LOG_TRACE("FidSegmentation::ErodePoint45");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
 
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = (ir + barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir - barSize) * m_FrameSize[0] + ic + barSize;
-
-  for (; p >= p_max; p = p - m_FrameSize[0] + 1)
-  {
-    if (image[p] < dval)
+  //-----------------------------------------------------------------------------
+  /*!
+    Running minimum or maximum along a line, using the van Herk/Gil-Werman algorithm: the line is split into blocks of the window size,
+    cumulative values are computed forward and backward within each block, and the result for a window is combined from the backward
+    value at its start and the forward value at its end. Cost per pixel does not depend on the window size.
+    output[i * outputStep] = Operator(input[(i + k) * inputStep]) for k = -halfWidth..halfWidth and i = 0..numberOfOutputs-1
+  */
+  template<class Operator>
+  void FilterLine(PixelType* output, int outputStep, const PixelType* input, int inputStep, int numberOfOutputs, int halfWidth,
+                  std::vector<PixelType>& forward, std::vector<PixelType>& backward)
+  {
+    const int windowSize = 2 * halfWidth + 1;
+    const int numberOfInputs = numberOfOutputs + 2 * halfWidth;
+    forward.resize(numberOfInputs);
+    backward.resize(numberOfInputs);
+    const PixelType* lineStart = input - halfWidth * inputStep;
+
+    for (int j = 0, positionInBlock = 0; j < numberOfInputs; j++, positionInBlock++)
     {
-      dval = image[p];
+      if (positionInBlock == windowSize)
+      {
+        positionInBlock = 0;
+      }
+      PixelType value = lineStart[j * inputStep];
+      forward[j] = (positionInBlock == 0) ? value : Operator::Apply(forward[j - 1], value);
     }
-    if (image[p] == 0)
+    for (int j = numberOfInputs - 1; j >= 0; j--)
     {
-      break;
+      PixelType value = lineStart[j * inputStep];
+      backward[j] = (j == numberOfInputs - 1 || (j + 1) % windowSize == 0) ? value : Operator::Apply(backward[j + 1], value);
     }
-  }
-  return dval;
-}
-
-//-----------------------------------------------------------------------------
-
-void PlusFidSegmentation::Erode45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
-{
-  //LOG_TRACE("FidSegmentation::Erode45");
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  /* Down the left side. */
-  for (unsigned int sr = m_RegionOfInterest[1]; sr < m_RegionOfInterest[3]; sr++)
-  {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
 
-    PlusFidSegmentation::PixelType dval = ErodePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
+    if (outputStep == 1)
     {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint45(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
+      ApplyOperatorToSpan<Operator>(output, &backward[0], &forward[windowSize - 1], numberOfOutputs);
+    }
+    else
+    {
+      for (int i = 0; i < numberOfOutputs; i++)
+      {
+        output[i * outputStep] = Operator::Apply(backward[i], forward[i + windowSize - 1]);
+      }
     }
   }
 
-  /* Across the bottom */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
+  //-----------------------------------------------------------------------------
+  /*! Horizontal bar operation: each row of the region of interest is filtered separately */
+  template<class Operator>
+  void FilterBar0(PixelType* dest, const PixelType* image, int frameWidth, const std::array<unsigned int, 4>& roi, int barSize,
+                  std::vector<PixelType>& forward, std::vector<PixelType>& backward)
   {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[3] - 1;
-
-    PlusFidSegmentation::PixelType dval = ErodePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
+    const int numberOfColumns = roi[2] - roi[0];
+    for (int ir = roi[1]; ir < static_cast<int>(roi[3]); ir++)
     {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint45(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
+      int p = ir * frameWidth + roi[0];
+      FilterLine<Operator>(dest + p, 1, image + p, 1, numberOfColumns, barSize, forward, backward);
     }
   }
-}
 
-//-----------------------------------------------------------------------------
-
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
-{
-  //LOG_TRACE("FidSegmentation::ErodePoint90");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic;
-
-  for (; p <= p_max; p += m_FrameSize[0])
-  {
-    if (image[p] < dval)
+  //-----------------------------------------------------------------------------
+  /*!
+    Vertical bar operation: the van Herk/Gil-Werman algorithm is performed on entire rows at once,
+    so the cumulative values are computed by pixel-wise operations on contiguous spans.
+  */
+  template<class Operator>
+  void FilterBar90(PixelType* dest, const PixelType* image, int frameWidth, const std::array<unsigned int, 4>& roi, int barSize,
+                   std::vector<PixelType>& forward, std::vector<PixelType>& backward)
+  {
+    const int windowSize = 2 * barSize + 1;
+    const int numberOfColumns = roi[2] - roi[0];
+    const int numberOfOutputRows = roi[3] - roi[1];
+    const int numberOfInputRows = numberOfOutputRows + 2 * barSize;
+    forward.resize(numberOfInputRows * numberOfColumns);
+    backward.resize(numberOfInputRows * numberOfColumns);
+    const PixelType* input = image + (static_cast<int>(roi[1]) - barSize) * frameWidth + roi[0];
+
+    for (int j = 0; j < numberOfInputRows; j++)
     {
-      dval = image[p];
+      PixelType* forwardRow = &forward[j * numberOfColumns];
+      if (j % windowSize == 0)
+      {
+        memcpy(forwardRow, input + j * frameWidth, numberOfColumns * sizeof(PixelType));
+      }
+      else
+      {
+        ApplyOperatorToSpan<Operator>(forwardRow, forwardRow - numberOfColumns, input + j * frameWidth, numberOfColumns);
+      }
     }
-    if (image[p] == 0)
+    for (int j = numberOfInputRows - 1; j >= 0; j--)
     {
-      break;
+      PixelType* backwardRow = &backward[j * numberOfColumns];
+      if (j == numberOfInputRows - 1 || (j + 1) % windowSize == 0)
+      {
+        memcpy(backwardRow, input + j * frameWidth, numberOfColumns * sizeof(PixelType));
+      }
+      else
+      {
+        ApplyOperatorToSpan<Operator>(backwardRow, backwardRow + numberOfColumns, input + j * frameWidth, numberOfColumns);
+      }
     }
-  }
-  return dval;
-}
-
-//-----------------------------------------------------------------------------
-
-void PlusFidSegmentation::Erode90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
-{
-  //LOG_TRACE("FidSegmentation::Erode90");
 
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  for (unsigned int ic = m_RegionOfInterest[0]; ic < m_RegionOfInterest[2]; ic++)
-  {
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint90(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir++; ir < m_RegionOfInterest[3]; ir++)
+    for (int i = 0; i < numberOfOutputRows; i++)
     {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + ic];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + ic];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint90(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
+      ApplyOperatorToSpan<Operator>(dest + (roi[1] + i) * frameWidth + roi[0], &backward[i * numberOfColumns], &forward[(i + windowSize - 1) * numberOfColumns], numberOfColumns);
     }
   }
-}
-
-//-----------------------------------------------------------------------------
-
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::ErodePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
-{
-  //LOG_TRACE("FidSegmentation::ErodePoint135");
 
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic + barSize;
-
-  for (; p <= p_max; p = p + m_FrameSize[0] + 1)
+  //-----------------------------------------------------------------------------
+  /*! 45 degree bar operation (from bottom-left to top-right): each anti-diagonal of the region of interest is filtered separately */
+  template<class Operator>
+  void FilterBar45(PixelType* dest, const PixelType* image, int frameWidth, const std::array<unsigned int, 4>& roi, int barSize,
+                   std::vector<PixelType>& forward, std::vector<PixelType>& backward)
   {
-    if (image[p] < dval)
-    {
-      dval = image[p];
-    }
-    if (image[p] == 0)
+    const int step = -frameWidth + 1;
+    const int xMin = roi[0];
+    const int xMax = roi[2] - 1;
+    const int yMin = roi[1];
+    const int yMax = roi[3] - 1;
+    for (int diagonal = yMin + xMin; diagonal <= yMax + xMax; diagonal++)
     {
-      break;
+      // row + column = diagonal, the line starts at the bottom
+      int startRow = std::min(yMax, diagonal - xMin);
+      int endRow = std::max(yMin, diagonal - xMax);
+      int p = startRow * frameWidth + (diagonal - startRow);
+      FilterLine<Operator>(dest + p, step, image + p, step, startRow - endRow + 1, barSize, forward, backward);
     }
   }
-  return dval;
-}
 
-//-----------------------------------------------------------------------------
-
-void PlusFidSegmentation::Erode135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
-{
-  //LOG_TRACE("FidSegmentation::Erode135");
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  /* Up the left side. */
-  for (unsigned int sr = m_RegionOfInterest[3] - 1; sr >= m_RegionOfInterest[1]; sr--)
+  //-----------------------------------------------------------------------------
+  /*! 135 degree bar operation (from top-left to bottom-right): each diagonal of the region of interest is filtered separately */
+  template<class Operator>
+  void FilterBar135(PixelType* dest, const PixelType* image, int frameWidth, const std::array<unsigned int, 4>& roi, int barSize,
+                    std::vector<PixelType>& forward, std::vector<PixelType>& backward)
   {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
+    const int step = frameWidth + 1;
+    const int xMin = roi[0];
+    const int xMax = roi[2] - 1;
+    const int yMin = roi[1];
+    const int yMax = roi[3] - 1;
+    for (int diagonal = xMin - yMax; diagonal <= xMax - yMin; diagonal++)
     {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint135(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
+      // column - row = diagonal, the line starts at the top
+      int startRow = std::max(yMin, xMin - diagonal);
+      int endRow = std::min(yMax, xMax - diagonal);
+      int p = startRow * frameWidth + (startRow + diagonal);
+      FilterLine<Operator>(dest + p, step, image + p, step, endRow - startRow + 1, barSize, forward, backward);
     }
   }
 
-  /* Across the top. */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
+  //-----------------------------------------------------------------------------
+  /*!
+    Circle operation decomposed into horizontal bars: the input rows are filtered once with each distinct row half width of the circle,
+    then each output row is computed by combining the filtered rows that the circle covers.
+  */
+  template<class Operator>
+  void FilterCircle(PixelType* dest, const PixelType* image, int frameWidth, const std::array<unsigned int, 4>& roi, const std::vector<int>& rowHalfWidths,
+                    std::vector<PixelType>& circleRows, std::vector<PixelType>& forward, std::vector<PixelType>& backward)
   {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = ErodePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
+    const int radius = static_cast<int>(rowHalfWidths.size()) / 2;
+    std::vector<int> distinctHalfWidths;
+    for (std::vector<int>::const_iterator it = rowHalfWidths.begin(); it != rowHalfWidths.end(); ++it)
     {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val <= dval ? new_val :
-             del_val > dval ? std::min(dval, new_val) :
-             ErodePoint135(image, ir, ic);
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
+      if (*it >= 0 && std::find(distinctHalfWidths.begin(), distinctHalfWidths.end(), *it) == distinctHalfWidths.end())
+      {
+        distinctHalfWidths.push_back(*it);
+      }
     }
-  }
-}
 
-//-----------------------------------------------------------------------------
-
-void PlusFidSegmentation::ErodeCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
-{
-  //LOG_TRACE("FidSegmentation::ErodeCircle");
-
-  unsigned int slen = m_MorphologicalCircle.size();
-
-  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-
-  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
-  {
-    for (unsigned int ic = m_RegionOfInterest[0]; ic < m_RegionOfInterest[2]; ic++)
+    const int numberOfColumns = roi[2] - roi[0];
+    const int numberOfOutputRows = roi[3] - roi[1];
+    const int numberOfInputRows = numberOfOutputRows + 2 * radius;
+    const int firstInputRow = static_cast<int>(roi[1]) - radius;
+    circleRows.resize(distinctHalfWidths.size() * numberOfInputRows * numberOfColumns);
+    for (unsigned int widthIndex = 0; widthIndex < distinctHalfWidths.size(); widthIndex++)
     {
-      PlusFidSegmentation::PixelType dval = UCHAR_MAX;
-      for (unsigned int sp = 0; sp < slen; sp++)
+      for (int j = 0; j < numberOfInputRows; j++)
       {
-        int sr = ir + m_MorphologicalCircle[sp].X;
-        int sc = ic + m_MorphologicalCircle[sp].Y;
-        PlusFidSegmentation::PixelType pixSrc = image[sr * m_FrameSize[0] + sc];
+        FilterLine<Operator>(&circleRows[(widthIndex * numberOfInputRows + j) * numberOfColumns], 1,
+                             image + (firstInputRow + j) * frameWidth + roi[0], 1, numberOfColumns, distinctHalfWidths[widthIndex], forward, backward);
+      }
+    }
 
-        if (pixSrc < dval)
+    for (int i = 0; i < numberOfOutputRows; i++)
+    {
+      PixelType* destRow = dest + (roi[1] + i) * frameWidth + roi[0];
+      bool firstRow = true;
+      for (int rowOffset = -radius; rowOffset <= radius; rowOffset++)
+      {
+        int halfWidth = rowHalfWidths[rowOffset + radius];
+        if (halfWidth < 0)
         {
-          dval = pixSrc;
+          // the circle has no pixels in this row
+          continue;
         }
-
-        if (pixSrc == 0)
+        int widthIndex = std::find(distinctHalfWidths.begin(), distinctHalfWidths.end(), halfWidth) - distinctHalfWidths.begin();
+        const PixelType* filteredRow = &circleRows[(widthIndex * numberOfInputRows + i + radius + rowOffset) * numberOfColumns];
+        if (firstRow)
+        {
+          memcpy(destRow, filteredRow, numberOfColumns * sizeof(PixelType));
+          firstRow = false;
+        }
+        else
         {
-          break;
+          ApplyOperatorToSpan<Operator>(destRow, destRow, filteredRow, numberOfColumns);
         }
       }
-
-      dest[ir * m_FrameSize[0] + ic] = dval;
     }
   }
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::Erode0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::DilatePoint0");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = ir * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = ir * m_FrameSize[0] + ic + barSize;
+  //LOG_TRACE("FidSegmentation::Erode0");
 
-  for (; p <= p_max; p++)
+  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
+  if (IsRegionEmpty(m_RegionOfInterest))
   {
-    if (image[p] > dval)
-    {
-      dval = image[p];
-    }
+    return;
   }
 
-  return dval;
+  FilterBar0<MinimumOperator>(dest, image, m_FrameSize[0], m_RegionOfInterest, GetMorphologicalOpeningBarSizePx(), m_MorphologyForwardBuffer, m_MorphologyBackwardBuffer);
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Dilate0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::Erode45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Dilate0");
+  //LOG_TRACE("FidSegmentation::Erode45");
 
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
+  if (IsRegionEmpty(m_RegionOfInterest))
   {
-    unsigned int ic = m_RegionOfInterest[0];
-    unsigned int p_base = ir * m_FrameSize[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint0(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ic++; ic < m_RegionOfInterest[2]; ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[p_base + ic + barSize];
-      PlusFidSegmentation::PixelType del_val = image[p_base + ic - 1 - barSize];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint0(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
+    return;
   }
+
+  FilterBar45<MinimumOperator>(dest, image, m_FrameSize[0], m_RegionOfInterest, GetMorphologicalOpeningBarSizePx(), m_MorphologyForwardBuffer, m_MorphologyBackwardBuffer);
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::Erode90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::DilatePoint45");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = (ir + barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir - barSize) * m_FrameSize[0] + ic + barSize;
+  //LOG_TRACE("FidSegmentation::Erode90");
 
-  while (p >= p_max)
+  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
+  if (IsRegionEmpty(m_RegionOfInterest))
   {
-    if (image[p] > dval)
-    {
-      dval = image[p];
-    }
-    if (p - m_FrameSize[0] + 1 > p)
-    {
-      // unsigned int underflow, adjust
-      p = 0;
-    }
-    else
-    {
-      p = p - m_FrameSize[0] + 1;
-    }
+    return;
   }
 
-  return dval;
+  FilterBar90<MinimumOperator>(dest, image, m_FrameSize[0], m_RegionOfInterest, GetMorphologicalOpeningBarSizePx(), m_MorphologyForwardBuffer, m_MorphologyBackwardBuffer);
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Dilate45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::Erode135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Dilate45");
+  //LOG_TRACE("FidSegmentation::Erode135");
 
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  /* Down the left side. */
-  for (unsigned int sr = m_RegionOfInterest[1]; sr < m_RegionOfInterest[3]; sr++)
+  if (IsRegionEmpty(m_RegionOfInterest))
   {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint45(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval ;
-    }
+    return;
   }
 
-  /* Across the bottom */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
-  {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[3] - 1;
-
-    PlusFidSegmentation::PixelType dval = DilatePoint45(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir--, ic++; ir >= m_RegionOfInterest[1] && ic < m_RegionOfInterest[2]; ir--, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir - barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir + 1 + barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint45(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval ;
-    }
-  }
+  FilterBar135<MinimumOperator>(dest, image, m_FrameSize[0], m_RegionOfInterest, GetMorphologicalOpeningBarSizePx(), m_MorphologyForwardBuffer, m_MorphologyBackwardBuffer);
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::ErodeCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::DilatePoint90");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic;
+  //LOG_TRACE("FidSegmentation::ErodeCircle");
 
-  for (; p <= p_max; p += m_FrameSize[0])
+  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
+  if (IsRegionEmpty(m_RegionOfInterest) || m_MorphologicalCircleRowHalfWidths.empty())
   {
-    if (image[p] > dval)
-    {
-      dval = image[p];
-    }
+    return;
   }
-  return dval;
+
+  FilterCircle<MinimumOperator>(dest, image, m_FrameSize[0], m_RegionOfInterest, m_MorphologicalCircleRowHalfWidths,
+                                m_MorphologyCircleRowsBuffer, m_MorphologyForwardBuffer, m_MorphologyBackwardBuffer);
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Dilate90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::Dilate0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Dilate90");
+  //LOG_TRACE("FidSegmentation::Dilate0");
 
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  for (unsigned int ic = m_RegionOfInterest[0]; ic < m_RegionOfInterest[2]; ic++)
+  if (IsRegionEmpty(m_RegionOfInterest))
   {
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint90(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir++; ir < m_RegionOfInterest[3]; ir++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + ic];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + ic];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint90(image, ir, ic));
-
-      dest[ir * m_FrameSize[0] + ic] = dval ;
-    }
+    return;
   }
+
+  FilterBar0<MaximumOperator>(dest, image, m_FrameSize[0], m_RegionOfInterest, GetMorphologicalOpeningBarSizePx(), m_MorphologyForwardBuffer, m_MorphologyBackwardBuffer);
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic)
+void PlusFidSegmentation::Dilate45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::DilatePoint135");
-
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-  PlusFidSegmentation::PixelType dval = 0;
-  unsigned int p = (ir - barSize) * m_FrameSize[0] + ic - barSize;
-  unsigned int p_max = (ir + barSize) * m_FrameSize[0] + ic + barSize;
+  //LOG_TRACE("FidSegmentation::Dilate45");
 
-  for (; p <= p_max; p = p + m_FrameSize[0] + 1)
+  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
+  if (IsRegionEmpty(m_RegionOfInterest))
   {
-    if (image[p] > dval)
-    {
-      dval = image[p];
-    }
+    return;
   }
-  return dval;
+
+  FilterBar45<MaximumOperator>(dest, image, m_FrameSize[0], m_RegionOfInterest, GetMorphologicalOpeningBarSizePx(), m_MorphologyForwardBuffer, m_MorphologyBackwardBuffer);
 }
 
 //-----------------------------------------------------------------------------
 
-void PlusFidSegmentation::Dilate135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
+void PlusFidSegmentation::Dilate90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::Dilate135");
+  //LOG_TRACE("FidSegmentation::Dilate90");
 
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  const unsigned int barSize = GetMorphologicalOpeningBarSizePx();
-
-  /* Up the left side. */
-  for (unsigned int sr = m_RegionOfInterest[3] - 1; sr >= m_RegionOfInterest[1]; sr--)
+  if (IsRegionEmpty(m_RegionOfInterest))
   {
-    unsigned int ir = sr;
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval ;
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint135(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
+    return;
   }
 
-  /* Across the top. */
-  for (unsigned int sc = m_RegionOfInterest[0]; sc < m_RegionOfInterest[2]; sc++)
-  {
-    unsigned int ic = sc;
-    unsigned int ir = m_RegionOfInterest[1];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint135(image, ir, ic);
-    dest[ir * m_FrameSize[0] + ic] = dval;
-    for (ir++, ic++; ir < m_RegionOfInterest[3] && ic < m_RegionOfInterest[2]; ir++, ic++)
-    {
-      PlusFidSegmentation::PixelType new_val = image[(ir + barSize) * m_FrameSize[0] + (ic + barSize)];
-      PlusFidSegmentation::PixelType del_val = image[(ir - 1 - barSize) * m_FrameSize[0] + (ic - 1 - barSize)];
-
-      dval = new_val >= dval ? new_val :
-             (del_val < dval ? std::max(dval, new_val) :
-              DilatePoint135(image, ir, ic));
-      dest[ir * m_FrameSize[0] + ic] = dval;
-    }
-  }
+  FilterBar90<MaximumOperator>(dest, image, m_FrameSize[0], m_RegionOfInterest, GetMorphologicalOpeningBarSizePx(), m_MorphologyForwardBuffer, m_MorphologyBackwardBuffer);
 }
 
 //-----------------------------------------------------------------------------
 
-inline PlusFidSegmentation::PixelType PlusFidSegmentation::DilatePoint(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic, PlusCoordinate2D* shape, int slen)
+void PlusFidSegmentation::Dilate135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image)
 {
-  //LOG_TRACE("FidSegmentation::DilatePoint");
+  //LOG_TRACE("FidSegmentation::Dilate135");
 
-  PlusFidSegmentation::PixelType dval = 0;
-  for (int sp = 0; sp < slen; sp++)
+  memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
+  if (IsRegionEmpty(m_RegionOfInterest))
   {
-    unsigned int sr = ir + shape[sp].Y;
-    unsigned int sc = ic + shape[sp].X;
-
-    if (image[sr * m_FrameSize[0] + sc] > dval)
-    {
-      dval = image[sr * m_FrameSize[0] + sc];
-    }
+    return;
   }
-  return dval;
+
+  FilterBar135<MaximumOperator>(dest, image, m_FrameSize[0], m_RegionOfInterest, GetMorphologicalOpeningBarSizePx(), m_MorphologyForwardBuffer, m_MorphologyBackwardBuffer);
 }
 
 //-----------------------------------------------------------------------------
@@ -890,85 +696,14 @@ void PlusFidSegmentation::DilateCircle(PlusFidSegmentation::PixelType* dest, Plu
 {
   //LOG_TRACE("FidSegmentation::DilateCircle");
 
-  unsigned int slen = m_MorphologicalCircle.size();
-
-  PlusCoordinate2D* shape = new PlusCoordinate2D[slen];
-
-  for (unsigned int i = 0; i < slen; i++)
-  {
-    shape[i] = m_MorphologicalCircle[i];
-  }
-
-  /* Which elements stick around when you shift right? */
-  int n = 0;
-
-  bool* sr_exist = new bool[slen];
-
-  memset(sr_exist, 0, slen * sizeof(bool));
-  for (unsigned int si = 0; si < slen; si++)
-  {
-    PlusCoordinate2D dot;
-    dot.X = m_MorphologicalCircle[si].X + 1;
-    dot.Y = m_MorphologicalCircle[si].Y;
-
-    if (ShapeContains(m_MorphologicalCircle, dot))
-    {
-      sr_exist[si] = true, n++;
-    }
-  }
-  //cout << "shift_exist: " << n << endl;
-
-  PlusCoordinate2D* newDots = new PlusCoordinate2D[slen];
-  PlusCoordinate2D* oldDots = new PlusCoordinate2D[slen];
-
-  int nNewDots = 0, nOldDots = 0;
-  for (unsigned int si = 0; si < slen; si++)
-  {
-    if (sr_exist[si])
-    {
-      oldDots[nOldDots++] = shape[si];
-    }
-    else
-    {
-      newDots[nNewDots++] = shape[si];
-    }
-  }
-
-  delete [] sr_exist;
-
   memset(dest, 0, m_FrameSize[1]*m_FrameSize[0]*sizeof(PlusFidSegmentation::PixelType));
-  for (unsigned int ir = m_RegionOfInterest[1]; ir < m_RegionOfInterest[3]; ir++)
+  if (IsRegionEmpty(m_RegionOfInterest) || m_MorphologicalCircleRowHalfWidths.empty())
   {
-    unsigned int ic = m_RegionOfInterest[0];
-
-    PlusFidSegmentation::PixelType dval = DilatePoint(image, ir, ic, shape, slen);
-    PlusFidSegmentation::PixelType last = dest[ir * m_FrameSize[0] + ic] = dval;
-
-    for (ic++; ic < m_RegionOfInterest[2]; ic++)
-    {
-      PlusFidSegmentation::PixelType dval = DilatePoint(image, ir, ic, newDots, nNewDots);
-
-      if (dval < last)
-      {
-        for (int sp = 0; sp < nOldDots; sp++)
-        {
-          unsigned int sr = ir + oldDots[sp].Y;
-          unsigned int sc = ic + oldDots[sp].X;
-          if (image[sr * m_FrameSize[0] + sc] > dval)
-          {
-            dval = image[sr * m_FrameSize[0] + sc];
-          }
-          if (image[sr * m_FrameSize[0] + sc] == last)
-          {
-            break;
-          }
-        }
-      }
-      last = dest[ir * m_FrameSize[0] + ic] = dval ;
-    }
+    return;
   }
-  delete [] newDots;
-  delete [] oldDots;
+
+  FilterCircle<MaximumOperator>(dest, image, m_FrameSize[0], m_RegionOfInterest, m_MorphologicalCircleRowHalfWidths,
+                                m_MorphologyCircleRowsBuffer, m_MorphologyForwardBuffer, m_MorphologyBackwardBuffer);
 }
 
 //-----------------------------------------------------------------------------
@@ -1326,16 +1061,16 @@ bool PlusFidSegmentation::Cluster(bool& tooManyCandidates)
           PlusFidDot dot = testPosition.back();
           testPosition.pop_back();
 
-          ClusteringAddNeighbors(m_Working, dot.GetY() - 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() - 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() - 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() - 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() - 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() - 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
 
-          ClusteringAddNeighbors(m_Working, dot.GetY(), dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY(), dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY(), dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY(), dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
 
-          ClusteringAddNeighbors(m_Working, dot.GetY() + 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() + 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
-          ClusteringAddNeighbors(m_Working, dot.GetY() + 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() + 1, dot.GetX() - 1, testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() + 1, dot.GetX(), testPosition, setPosition, valuesOfPosition);
+          ClusteringAddNeighbors(&m_Working[0], dot.GetY() + 1, dot.GetX() + 1, testPosition, setPosition, valuesOfPosition);
         }
 
         double dest_r = 0, dest_c = 0, total = 0;
@@ -1409,92 +1144,92 @@ void PlusFidSegmentation::MorphologicalOperations()
   // Morphological operations with a stick-like structuring element
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg01-initial.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg01-initial.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode0(m_Eroded, m_Working);
+  Erode0(&m_Eroded[0], &m_Working[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg02-morph-bar-deg0-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Eroded[0], "seg02-morph-bar-deg0-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate0(m_Dilated, m_Eroded);
+  Dilate0(&m_Dilated[0], &m_Eroded[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg03-morph-bar-deg0-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Dilated[0], "seg03-morph-bar-deg0-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(&m_Working[0], &m_Dilated[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg04-morph-bar-deg0-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg04-morph-bar-deg0-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode45(m_Eroded, m_Working);
+  Erode45(&m_Eroded[0], &m_Working[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg05-morph-bar-deg45-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Eroded[0], "seg05-morph-bar-deg45-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate45(m_Dilated, m_Eroded);
+  Dilate45(&m_Dilated[0], &m_Eroded[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg06-morph-bar-deg45-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Dilated[0], "seg06-morph-bar-deg45-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(&m_Working[0], &m_Dilated[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg07-morph-bar-deg45-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg07-morph-bar-deg45-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode90(m_Eroded, m_Working);
+  Erode90(&m_Eroded[0], &m_Working[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg08-morph-bar-deg90-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Eroded[0], "seg08-morph-bar-deg90-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate90(m_Dilated, m_Eroded);
+  Dilate90(&m_Dilated[0], &m_Eroded[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg09-morph-bar-deg90-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Dilated[0], "seg09-morph-bar-deg90-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(&m_Working[0], &m_Dilated[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg10-morph-bar-deg90-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg10-morph-bar-deg90-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Erode135(m_Eroded, m_Working);
+  Erode135(&m_Eroded[0], &m_Working[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg11-morph-bar-deg135-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Eroded[0], "seg11-morph-bar-deg135-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Dilate135(m_Dilated, m_Eroded);
+  Dilate135(&m_Dilated[0], &m_Eroded[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Dilated, "seg12-morph-bar-deg135-dilated.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Dilated[0], "seg12-morph-bar-deg135-dilated.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  Subtract(m_Working, m_Dilated);
+  Subtract(&m_Working[0], &m_Dilated[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg13-morph-bar-deg135-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg13-morph-bar-deg135-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
   /* Circle operation. */
-  ErodeCircle(m_Eroded, m_Working);
+  ErodeCircle(&m_Eroded[0], &m_Working[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Eroded, "seg14-morph-circle-erode.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Eroded[0], "seg14-morph-circle-erode.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
-  DilateCircle(m_Working, m_Eroded);
+  DilateCircle(&m_Working[0], &m_Eroded[0]);
   if (m_DebugOutput)
   {
-    WritePng(m_Working, "seg15-morph-circle-final.png", m_FrameSize[0], m_FrameSize[1]);
+    WritePng(&m_Working[0], "seg15-morph-circle-final.png", m_FrameSize[0], m_FrameSize[1]);
   }
 
 }
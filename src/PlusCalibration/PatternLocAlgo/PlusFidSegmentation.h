@@ -86,25 +86,21 @@ public:
   /*! Check and modify if necessary the region of interest */
   void ValidateRegionOfInterest();
 
-  /*! Morphological operations performed by the algorithm */
-  inline PlusFidSegmentation::PixelType ErodePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
+  /*!
+    Morphological operations performed by the algorithm.
+    Bar operations compute running minimum/maximum along the bar direction (van Herk/Gil-Werman algorithm),
+    so their cost does not depend on the bar size. Circle operations are decomposed into horizontal bars (one for each row of the circle).
+    Only the region of interest is computed, the rest of dest is set to 0.
+  */
   void Erode0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType ErodePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Erode45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType ErodePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Erode90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType ErodePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Erode135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
   void ErodeCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint0(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate0(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint45(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate45(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint90(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate90(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint135(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic);
   void Dilate135(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
-  inline PlusFidSegmentation::PixelType DilatePoint(PlusFidSegmentation::PixelType* image, unsigned int ir, unsigned int ic, PlusCoordinate2D* shape, int slen);
   void DilateCircle(PlusFidSegmentation::PixelType* dest, PlusFidSegmentation::PixelType* image);
   void Subtract(PlusFidSegmentation::PixelType* image, PlusFidSegmentation::PixelType* vals);
 
@@ -190,10 +186,10 @@ public:
   FiducialGeometryType  GetFiducialGeometry() { return m_FiducialGeometry; };
 
   /*! Get the working copy of the image */
-  PlusFidSegmentation::PixelType* GetWorking() {return m_Working; };
+  PlusFidSegmentation::PixelType* GetWorking() {return &m_Working[0]; };
 
   /*! Get the unaltered copy of the image */
-  PlusFidSegmentation::PixelType* GetUnalteredImage() {return m_UnalteredImage; };
+  PlusFidSegmentation::PixelType* GetUnalteredImage() {return &m_UnalteredImage[0]; };
 
   /*! Set the Approximate spacing, this is in Mm per pixel */
   void  SetApproximateSpacingMmPerPixel(double value) { m_ApproximateSpacingMmPerPixel = value; };
@@ -234,6 +230,13 @@ protected:
   FiducialGeometryType m_FiducialGeometry;
 
   std::vector<PlusCoordinate2D> m_MorphologicalCircle;
+  /*! Half width of each row of the morphological circle (from -radius to +radius), used for decomposing circle operations into horizontal bars */
+  std::vector<int> m_MorphologicalCircleRowHalfWidths;
+
+  /*! Work buffers of the morphological operations, kept between frames to avoid reallocation */
+  std::vector<PlusFidSegmentation::PixelType> m_MorphologyForwardBuffer;
+  std::vector<PlusFidSegmentation::PixelType> m_MorphologyBackwardBuffer;
+  std::vector<PlusFidSegmentation::PixelType> m_MorphologyCircleRowsBuffer;
 
   double m_ApproximateSpacingMmPerPixel;
   double m_ImageScalingTolerancePercent[4];
@@ -253,10 +256,11 @@ protected:
   /*! Pointer to the fiducial candidates coordinates */
   std::vector<PlusFidDot> m_CandidateFidValues;
 
-  PlusFidSegmentation::PixelType* m_Working;
-  PlusFidSegmentation::PixelType* m_Dilated;
-  PlusFidSegmentation::PixelType* m_Eroded;
-  PlusFidSegmentation::PixelType* m_UnalteredImage;
+  /*! Image buffers of the current frame. Stored in vectors so that the class can be copied (e.g., to give each worker thread its own segmentation state) */
+  std::vector<PlusFidSegmentation::PixelType> m_Working;
+  std::vector<PlusFidSegmentation::PixelType> m_Dilated;
+  std::vector<PlusFidSegmentation::PixelType> m_Eroded;
+  std::vector<PlusFidSegmentation::PixelType> m_UnalteredImage;
 
   std::vector<PlusFidDot> m_DotsVector;
 
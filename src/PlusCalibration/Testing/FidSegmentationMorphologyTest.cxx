@@ -0,0 +1,219 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file FidSegmentationMorphologyTest.cxx
+  \brief Compares the morphological operations of PlusFidSegmentation to a brute-force implementation
+
+  Erosion and dilation with the 0, 45, 90 and 135 degree bars and with the circle are computed on random images
+  with random bar sizes, circle radii and regions of interest. Many of the regions of interest are narrower or shorter
+  than the structuring element. The result must be identical to the minimum or maximum of the pixels that the
+  structuring element covers, and pixels outside the region of interest must be set to 0.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusFidSegmentation.h"
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace
+{
+  typedef PlusFidSegmentation::PixelType PixelType;
+  typedef void (PlusFidSegmentation::*MorphologicalOperationMethod)(PixelType* dest, PixelType* image);
+
+  struct MorphologicalOperation
+  {
+    const char* Name;
+    MorphologicalOperationMethod Method;
+    bool Erosion;
+    int RowStep; // row and column offset between neighbor pixels of a bar, both 0 for the circle
+    int ColumnStep;
+  };
+
+  const MorphologicalOperation MORPHOLOGICAL_OPERATIONS[] =
+  {
+    { "Erode0", &PlusFidSegmentation::Erode0, true, 0, 1 },
+    { "Erode45", &PlusFidSegmentation::Erode45, true, -1, 1 },
+    { "Erode90", &PlusFidSegmentation::Erode90, true, 1, 0 },
+    { "Erode135", &PlusFidSegmentation::Erode135, true, 1, 1 },
+    { "ErodeCircle", &PlusFidSegmentation::ErodeCircle, true, 0, 0 },
+    { "Dilate0", &PlusFidSegmentation::Dilate0, false, 0, 1 },
+    { "Dilate45", &PlusFidSegmentation::Dilate45, false, -1, 1 },
+    { "Dilate90", &PlusFidSegmentation::Dilate90, false, 1, 0 },
+    { "Dilate135", &PlusFidSegmentation::Dilate135, false, 1, 1 },
+    { "DilateCircle", &PlusFidSegmentation::DilateCircle, false, 0, 0 }
+  };
+  const int NUMBER_OF_MORPHOLOGICAL_OPERATIONS = sizeof(MORPHOLOGICAL_OPERATIONS) / sizeof(MORPHOLOGICAL_OPERATIONS[0]);
+
+  //----------------------------------------------------------------------------
+  int GetRandomInt(int minValue, int maxValue)
+  {
+    return minValue + rand() % (maxValue - minValue + 1);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Brute-force morphological operation: the minimum or maximum of all the pixels that the structuring element covers */
+  void ComputeReference(const MorphologicalOperation& operation, const std::vector<PixelType>& image, int frameWidth, int frameHeight,
+                        unsigned int roi[4], int barSize, int circleRadius, std::vector<PixelType>& dest)
+  {
+    std::vector<std::pair<int, int> > offsets; // row and column offsets of the structuring element
+    if (operation.RowStep == 0 && operation.ColumnStep == 0)
+    {
+      for (int rowOffset = -circleRadius; rowOffset <= circleRadius; rowOffset++)
+      {
+        for (int columnOffset = -circleRadius; columnOffset <= circleRadius; columnOffset++)
+        {
+          if (sqrt(static_cast<double>(rowOffset * rowOffset + columnOffset * columnOffset)) <= circleRadius)
+          {
+            offsets.push_back(std::make_pair(rowOffset, columnOffset));
+          }
+        }
+      }
+    }
+    else
+    {
+      for (int k = -barSize; k <= barSize; k++)
+      {
+        offsets.push_back(std::make_pair(k * operation.RowStep, k * operation.ColumnStep));
+      }
+    }
+
+    dest.assign(frameWidth * frameHeight, 0);
+    for (int row = roi[1]; row < static_cast<int>(roi[3]); row++)
+    {
+      for (int column = roi[0]; column < static_cast<int>(roi[2]); column++)
+      {
+        PixelType value = operation.Erosion ? 255 : 0;
+        for (std::vector<std::pair<int, int> >::const_iterator offset = offsets.begin(); offset != offsets.end(); ++offset)
+        {
+          PixelType pixel = image[(row + offset->first) * frameWidth + column + offset->second];
+          value = operation.Erosion ? std::min(value, pixel) : std::max(value, pixel);
+        }
+        dest[row * frameWidth + column] = value;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Runs all morphological operations on a random image with random parameters. Returns the number of operations that differ from the reference. */
+  int TestRandomImage(int testIndex)
+  {
+    const int barSize = GetRandomInt(0, 10);
+    const int circleRadius = GetRandomInt(0, barSize); // the region of interest is only guaranteed to have a margin of the bar size
+    const int frameWidth = GetRandomInt(2 * barSize + 3, 2 * barSize + 60);
+    const int frameHeight = GetRandomInt(2 * barSize + 3, 2 * barSize + 60);
+
+    // Region of interest that is valid for the bar size. Every second one is smaller than the structuring element.
+    const int minPosition = barSize + 1;
+    const int maxColumn = frameWidth - barSize - 1;
+    const int maxRow = frameHeight - barSize - 1;
+    const int maxSize = (testIndex % 2 == 0) ? 2 * barSize : std::max(maxColumn, maxRow);
+    unsigned int roi[4] = { 0, 0, 0, 0 };
+    roi[0] = GetRandomInt(minPosition, maxColumn);
+    roi[1] = GetRandomInt(minPosition, maxRow);
+    roi[2] = std::min(maxColumn, static_cast<int>(roi[0]) + GetRandomInt(1, std::max(1, maxSize)));
+    roi[3] = std::min(maxRow, static_cast<int>(roi[1]) + GetRandomInt(1, std::max(1, maxSize)));
+
+    // Small intensity ranges make many equal pixels, large ranges make many different running minimum/maximum values
+    const int maxIntensity = (testIndex % 3 == 0) ? 3 : 255;
+    std::vector<PixelType> image(frameWidth * frameHeight);
+    for (std::vector<PixelType>::iterator pixel = image.begin(); pixel != image.end(); ++pixel)
+    {
+      *pixel = static_cast<PixelType>(GetRandomInt(0, maxIntensity));
+    }
+
+    PlusFidSegmentation segmentation;
+    segmentation.SetApproximateSpacingMmPerPixel(1.0);
+    segmentation.SetMorphologicalOpeningBarSizeMm(barSize);
+    segmentation.SetMorphologicalOpeningCircleRadiusMm(circleRadius);
+    segmentation.UpdateParameters();
+    segmentation.SetRegionOfInterest(roi[0], roi[1], roi[2], roi[3]);
+    FrameSizeType frameSize = { static_cast<unsigned int>(frameWidth), static_cast<unsigned int>(frameHeight), 1 };
+    segmentation.SetFrameSize(frameSize);
+    segmentation.GetRegionOfInterest(roi[0], roi[1], roi[2], roi[3]);
+
+    int numberOfErrors = 0;
+    std::vector<PixelType> dest(frameWidth * frameHeight);
+    std::vector<PixelType> expected;
+    for (int operationIndex = 0; operationIndex < NUMBER_OF_MORPHOLOGICAL_OPERATIONS; operationIndex++)
+    {
+      const MorphologicalOperation& operation = MORPHOLOGICAL_OPERATIONS[operationIndex];
+      // Pixels outside the region of interest must be cleared by the operation
+      std::fill(dest.begin(), dest.end(), 0xAB);
+      (segmentation.*operation.Method)(&dest[0], &image[0]);
+      ComputeReference(operation, image, frameWidth, frameHeight, roi, barSize, circleRadius, expected);
+      for (int i = 0; i < frameWidth * frameHeight; i++)
+      {
+        if (dest[i] != expected[i])
+        {
+          LOG_ERROR(operation.Name << " differs from the brute-force result at row " << i / frameWidth << ", column " << i % frameWidth
+                    << ": " << static_cast<int>(dest[i]) << " instead of " << static_cast<int>(expected[i])
+                    << " (frame size: " << frameWidth << "x" << frameHeight << ", bar size: " << barSize << ", circle radius: " << circleRadius
+                    << ", region of interest: " << roi[0] << ", " << roi[1] << ", " << roi[2] << ", " << roi[3] << ")");
+          numberOfErrors++;
+          break;
+        }
+      }
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfImages(200);
+  int randomSeed(1);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-images", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfImages, "Number of random images to test (Default: 200).");
+  args.AddArgument("--random-seed", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &randomSeed, "Seed of the random image and parameter generation (Default: 1).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  srand(randomSeed);
+  int numberOfErrors = 0;
+  for (int testIndex = 0; testIndex < numberOfImages; testIndex++)
+  {
+    numberOfErrors += TestRandomImage(testIndex);
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
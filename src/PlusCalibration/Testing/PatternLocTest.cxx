@@ -9,6 +9,7 @@ See License.txt for details.
 #include "PlusFidPatternRecognition.h"
 #include "PlusPatternLocResultFile.h"
 #include "igsioTrackedFrame.h"
+#include "vtkIGSIOAccurateTimer.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkSmartPointer.h"
 #include "vtkIGSIOTrackedFrameList.h"
@@ -48,6 +49,14 @@ void SegmentImageSequence(vtkIGSIOTrackedFrameList* trackedFrameList, std::ofstr
   bool debugOutput = vtkPlusLogger::Instance()->GetLogLevel() >= vtkPlusLogger::LOG_LEVEL_TRACE;
   patternRecognition.GetFidSegmentation()->SetDebugOutput(debugOutput);
 
+  // Segment all frames at once, so that they can be processed in parallel
+  std::vector<PlusPatternRecognitionResult> allSegResults;
+  std::vector<PlusFidPatternRecognition::PatternRecognitionError> errors;
+  double segmentationStartTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  patternRecognition.RecognizePattern(trackedFrameList, allSegResults, errors);
+  LOG_INFO("Segmentation time: " << vtkIGSIOAccurateTimer::GetSystemTime() - segmentationStartTimeSec << " sec (" << trackedFrameList->GetNumberOfTrackedFrames() << " frames, "
+           << patternRecognition.GetNumberOfThreads() << " threads)");
+
   for (unsigned int currentFrameIndex = 0; currentFrameIndex < trackedFrameList->GetNumberOfTrackedFrames(); currentFrameIndex++)
   {
     LOG_DEBUG("Frame: " << currentFrameIndex);
@@ -55,15 +64,12 @@ void SegmentImageSequence(vtkIGSIOTrackedFrameList* trackedFrameList, std::ofstr
     std::ostringstream possibleFiducialsImageFilename;
     possibleFiducialsImageFilename << inputTestcaseName << std::setw(3) << std::setfill('0') << currentFrameIndex << ".bmp" << std::ends;
 
-    PlusPatternRecognitionResult segResults;
-    PlusFidPatternRecognition::PatternRecognitionError error;
-
     if (trackedFrameList->GetTrackedFrame(currentFrameIndex)->GetImageData()->GetVTKScalarPixelType() != VTK_UNSIGNED_CHAR)
     {
       LOG_ERROR("UsFidSegTest only supports 8-bit images");
       continue;
     }
-    patternRecognition.RecognizePattern(trackedFrameList->GetTrackedFrame(currentFrameIndex), segResults, error, currentFrameIndex);
+    PlusPatternRecognitionResult& segResults = allSegResults[currentFrameIndex];
 
     sumFiducialCandidate += segResults.GetNumDots();
     int numFid = 0;
@@ -377,6 +383,7 @@ int main(int argc, char** argv)
   std::string outputFiducialPositionsFileName;
   std::string fiducialGeomString;
 
+  int numberOfThreads = 0;
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
   vtksys::CommandLineArguments args;
@@ -392,6 +399,8 @@ int main(int argc, char** argv)
 
   args.AddArgument("--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputConfigFileName, "Calibration configuration file name");
 
+  args.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of threads used for segmenting the frames (default: as specified in the configuration or the number of processors)");
+
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
 
   if (!args.Parse())
@@ -419,6 +428,10 @@ int main(int argc, char** argv)
 
   PlusFidPatternRecognition patternRecognition;
   patternRecognition.ReadConfiguration(configRootElement);
+  if (numberOfThreads > 0)
+  {
+    patternRecognition.SetNumberOfThreads(numberOfThreads);
+  }
 
   LOG_INFO("Read from metafile");
   std::string inputImageSequencePath = inputTestDataDir + "/" + inputImageSequenceFileName;
@@ -19,6 +19,7 @@ compares the results to a baseline
 #include "vtkMath.h"
 #include "vtkMatrix4x4.h"
 #include "vtkPlusProbeCalibrationAlgo.h"
+#include "vtkIGSIOAccurateTimer.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkSmartPointer.h"
 #include "vtkIGSIOTrackedFrameList.h"
@@ -59,6 +60,7 @@ int main(int argc, char* argv[])
   double inputRotationErrorThreshold(1e-10);
 #endif
 
+  int numberOfThreads = 0;
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
   vtksys::CommandLineArguments args;
@@ -77,6 +79,8 @@ int main(int argc, char* argv[])
 
   args.AddArgument("--output-config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &resultConfigFileName, "Result configuration file name. Optional.");
 
+  args.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of threads used for segmenting the frames (default: as specified in the configuration or the number of processors). Optional.");
+
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
 
   if (!args.Parse())
@@ -119,6 +123,10 @@ int main(int argc, char* argv[])
   PlusFidPatternRecognition patternRecognition;
   PlusFidPatternRecognition::PatternRecognitionError error;
   patternRecognition.ReadConfiguration(configRootElement);
+  if (numberOfThreads > 0)
+  {
+    patternRecognition.SetNumberOfThreads(numberOfThreads);
+  }
 
   // Load and segment calibration image
   LOG_INFO("Read calibration sequence file...");
@@ -131,13 +139,15 @@ int main(int argc, char* argv[])
 
   LOG_INFO("Segment fiducials...");
   int numberOfSuccessfullySegmentedCalibrationImages = 0;
+  double segmentationStartTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
   if (patternRecognition.RecognizePattern(calibrationTrackedFrameList, error, &numberOfSuccessfullySegmentedCalibrationImages) != PLUS_SUCCESS)
   {
     LOG_ERROR("Error occured during segmentation of calibration images!");
     return EXIT_FAILURE;
   }
 
-  LOG_INFO("Segmentation success rate of calibration images: " << numberOfSuccessfullySegmentedCalibrationImages << " out of " << calibrationTrackedFrameList->GetNumberOfTrackedFrames());
+  LOG_INFO("Segmentation success rate of calibration images: " << numberOfSuccessfullySegmentedCalibrationImages << " out of " << calibrationTrackedFrameList->GetNumberOfTrackedFrames()
+           << " (segmentation time: " << vtkIGSIOAccurateTimer::GetSystemTime() - segmentationStartTimeSec << " sec, " << patternRecognition.GetNumberOfThreads() << " threads)");
 
   if (!inputValidationSeqMetafile.empty())
   {
@@ -151,13 +161,15 @@ int main(int argc, char* argv[])
     }
     LOG_INFO("Segment fiducials...");
     int numberOfSuccessfullySegmentedValidationImages = 0;
+    segmentationStartTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
     if (patternRecognition.RecognizePattern(validationTrackedFrameList, error, &numberOfSuccessfullySegmentedValidationImages) != PLUS_SUCCESS)
     {
       LOG_ERROR("Error occured during segmentation of validation images!");
       return EXIT_FAILURE;
     }
 
-    LOG_INFO("Segmentation success rate of validation images: " << numberOfSuccessfullySegmentedValidationImages << " out of " << validationTrackedFrameList->GetNumberOfTrackedFrames());
+    LOG_INFO("Segmentation success rate of validation images: " << numberOfSuccessfullySegmentedValidationImages << " out of " << validationTrackedFrameList->GetNumberOfTrackedFrames()
+             << " (segmentation time: " << vtkIGSIOAccurateTimer::GetSystemTime() - segmentationStartTimeSec << " sec)");
 
     // Calibrate using independent data for validation
     LOG_INFO("Calibrate...");
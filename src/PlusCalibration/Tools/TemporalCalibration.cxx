@@ -20,6 +20,7 @@ See License.txt for details.
 // Local includes
 #include "PlusConfigure.h"
 #include "igsioTrackedFrame.h"
+#include "vtkIGSIOAccurateTimer.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkPlusTemporalCalibrationAlgo.h"
 #include "vtkIGSIOTrackedFrameList.h"
@@ -199,6 +200,7 @@ int main(int argc, char** argv)
   std::vector<int> clipRectOrigin;
   std::vector<int> clipRectSize;
   std::string inputBaselineFileName;
+  std::string lagSearchMethodStr("FFT");
 
   vtksys::CommandLineArguments args;
   args.Initialize(argc, argv);
@@ -212,6 +214,7 @@ int main(int argc, char** argv)
   args.AddArgument("--plot-results", vtksys::CommandLineArguments::NO_ARGUMENT, &plotResults, "Plot results (display position vs. time plots without and with temporal calibration)");
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
   args.AddArgument("--sampling-resolution-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &samplingResolutionSec, "Sampling resolution (in seconds, default is 0.001)");
+  args.AddArgument("--lag-search-method", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &lagSearchMethodStr, "Method for finding the time offset: FFT (default) or EXHAUSTIVE");
   args.AddArgument("--save-intermediate-images", vtksys::CommandLineArguments::NO_ARGUMENT, &saveIntermediateImages, "Save images of intermediate steps (scanlines used, and detected lines)");
   args.AddArgument("--intermediate-file-output-dir", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &intermediateFileOutputDirectory, "Directory into which the intermediate files are written");
   args.AddArgument("--clip-rect-origin", vtksys::CommandLineArguments::MULTI_ARGUMENT, &clipRectOrigin, "Origin of the clipping rectangle");
@@ -312,6 +315,19 @@ int main(int argc, char** argv)
   testTemporalCalibrationObject->SetSaveIntermediateImages(saveIntermediateImages);
   testTemporalCalibrationObject->SetIntermediateFilesOutputDirectory(intermediateFileOutputDirectory);
   testTemporalCalibrationObject->SetMaximumMovingLagSec(maxTimeOffsetSec);
+  if (igsioCommon::IsEqualInsensitive(lagSearchMethodStr, "FFT"))
+  {
+    testTemporalCalibrationObject->SetLagSearchMethod(vtkPlusTemporalCalibrationAlgo::LAG_SEARCH_METHOD_FFT);
+  }
+  else if (igsioCommon::IsEqualInsensitive(lagSearchMethodStr, "EXHAUSTIVE"))
+  {
+    testTemporalCalibrationObject->SetLagSearchMethod(vtkPlusTemporalCalibrationAlgo::LAG_SEARCH_METHOD_EXHAUSTIVE);
+  }
+  else
+  {
+    LOG_ERROR("Invalid lag search method: " << lagSearchMethodStr << ". Valid values: FFT, EXHAUSTIVE");
+    exit(EXIT_FAILURE);
+  }
 
   if (clipRectOrigin.size() > 0 || clipRectSize.size() > 0)
   {
@@ -328,11 +344,13 @@ int main(int argc, char** argv)
   vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR error(vtkPlusTemporalCalibrationAlgo::TEMPORAL_CALIBRATION_ERROR_NONE);
 
   //  Calculate the time-offset
+  double calibrationStartTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
   if (testTemporalCalibrationObject->Update(error) != PLUS_SUCCESS)
   {
     LOG_ERROR("Cannot determine tracker lag, temporal calibration failed");
     exit(EXIT_FAILURE);
   }
+  double calibrationTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - calibrationStartTimeSec;
 
   // Display results
   TemporalCalibrationResult calibResult;
@@ -354,6 +372,7 @@ int main(int argc, char** argv)
     exit(EXIT_FAILURE);
   }
   LOG_INFO("Max calibration error: " << calibResult.maxCalibrationError);
+  LOG_INFO("Computation time: " << calibrationTimeSec << " sec (time offset search: " << testTemporalCalibrationObject->GetLagSearchTimeSec() << " sec)");
 
   // Write results to file
   std::ostringstream trackerLagOutputFilename;
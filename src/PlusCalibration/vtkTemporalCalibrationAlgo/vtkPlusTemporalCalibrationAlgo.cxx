@@ -15,7 +15,10 @@
 #include "vtkTable.h"
 #include "vtkPlusTemporalCalibrationAlgo.h"
 #include "vtkIGSIOTrackedFrameList.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include <vnl/algo/vnl_fft_1d.h>
 #include <algorithm>
+#include <complex>
 #include <fstream>
 #include <iostream>
 
@@ -59,6 +62,69 @@ namespace
     AMPLITUDE
   };
   MetricNormalizationType METRIC_NORMALIZATION = STD;
+
+  //-----------------------------------------------------------------------------
+  /*! Returns the smallest length that is not smaller than numberOfSamples and can be transformed by vnl_fft_1d (only has 2, 3, 5 prime factors) */
+  int GetFftLength(int numberOfSamples)
+  {
+    int fftLength = std::max(numberOfSamples, 1);
+    while (true)
+    {
+      int remainder = fftLength;
+      while (remainder % 2 == 0) { remainder /= 2; }
+      while (remainder % 3 == 0) { remainder /= 3; }
+      while (remainder % 5 == 0) { remainder /= 5; }
+      if (remainder == 1)
+      {
+        return fftLength;
+      }
+      ++fftLength;
+    }
+  }
+
+  //-----------------------------------------------------------------------------
+  /*!
+    Resamples a signal on a uniform grid (startTimeSec + i * stepSizeSec) using linear interpolation.
+    Values outside the signal time range are clamped, the same way as in vtkPiecewiseFunction.
+  */
+  void ResampleSignalUniformly(const std::deque<double>& timestamps, const std::deque<double>& values, double startTimeSec, double stepSizeSec, std::vector<double>& resampledValues)
+  {
+    unsigned int segmentIndex = 0;
+    for (unsigned int i = 0; i < resampledValues.size(); ++i)
+    {
+      double t = startTimeSec + i * stepSizeSec;
+      if (t <= timestamps.front())
+      {
+        resampledValues[i] = values.front();
+        continue;
+      }
+      if (t >= timestamps.back())
+      {
+        resampledValues[i] = values.back();
+        continue;
+      }
+      // grid points are increasing, so the segment search can continue from the previous position
+      while (timestamps[segmentIndex + 1] < t)
+      {
+        ++segmentIndex;
+      }
+      double segmentLength = timestamps[segmentIndex + 1] - timestamps[segmentIndex];
+      double weight = (segmentLength > 0) ? (t - timestamps[segmentIndex]) / segmentLength : 0.0;
+      resampledValues[i] = values[segmentIndex] + weight * (values[segmentIndex + 1] - values[segmentIndex]);
+    }
+  }
+
+  //-----------------------------------------------------------------------------
+  /*! Returns the inverse of the standard deviation (computed from the sum of squared deviations from the mean), or 1.0 if the signal is constant */
+  double GetStdNormalizationFactor(double sumOfSquaredDeviations, int numberOfSamples)
+  {
+    if (numberOfSamples < 2 || sumOfSquaredDeviations <= 0)
+    {
+      return 1.0;
+    }
+    double stdev = std::sqrt(sumOfSquaredDeviations) / std::sqrt(static_cast<double>(numberOfSamples) - 1);
+    return (stdev < 1e-10) ? 1.0 : 1.0 / stdev;
+  }
 }
 
 //-----------------------------------------------------------------------------
@@ -77,6 +143,8 @@ vtkPlusTemporalCalibrationAlgo::vtkPlusTemporalCalibrationAlgo()
   , MaxMovingLagSec(DEFAULT_MAX_MOVING_LAG_SEC)
   , BestCorrelationNormalizationFactor(0.0)
   , FixedSignalValuesNormalizationFactor(0.0)
+  , LagSearchMethod(LAG_SEARCH_METHOD_FFT)
+  , LagSearchTimeSec(0.0)
 {
   this->FixedSignal.frameList = NULL;
   this->MovingSignal.frameList = NULL;
@@ -180,6 +248,24 @@ void vtkPlusTemporalCalibrationAlgo::SetMaximumMovingLagSec(double maxLagSec)
   this->MaxMovingLagSec = maxLagSec;
 }
 
+//-----------------------------------------------------------------------------
+void vtkPlusTemporalCalibrationAlgo::SetLagSearchMethod(LAG_SEARCH_METHOD method)
+{
+  this->LagSearchMethod = method;
+}
+
+//-----------------------------------------------------------------------------
+vtkPlusTemporalCalibrationAlgo::LAG_SEARCH_METHOD vtkPlusTemporalCalibrationAlgo::GetLagSearchMethod() const
+{
+  return this->LagSearchMethod;
+}
+
+//-----------------------------------------------------------------------------
+double vtkPlusTemporalCalibrationAlgo::GetLagSearchTimeSec() const
+{
+  return this->LagSearchTimeSec;
+}
+
 //-----------------------------------------------------------------------------
 void vtkPlusTemporalCalibrationAlgo::SetIntermediateFilesOutputDirectory(const std::string& outputDirectory)
 {
@@ -467,27 +553,15 @@ void vtkPlusTemporalCalibrationAlgo::ComputeCorrelationBetweenFixedAndMovingSign
     LOG_ERROR("Sampling resolution is too small: " << stepSizeSec << " sec");
     return;
   }
-  std::deque<double> slidingSignalTimestamps(this->FixedSignal.signalTimestamps.size());
-  std::deque<double> resampledTrackerPositionMetric;
   corrValues.clear();
   corrTimeOffsets.clear();
   for (double offsetValueSec = minTrackerLagSec; offsetValueSec <= maxTrackerLagSec; offsetValueSec += stepSizeSec)
   {
     //LOG_DEBUG("offsetValueSec = " << offsetValueSec);
     corrTimeOffsets.push_back(offsetValueSec);
-    for (unsigned int i = 0; i < slidingSignalTimestamps.size(); ++i)
-    {
-      slidingSignalTimestamps.at(i) =  this->FixedSignal.signalTimestamps.at(i) + offsetValueSec;
-    }
-
-    NormalizeMetricValues(this->FixedSignal.signalValues, this->FixedSignalValuesNormalizationFactor, slidingSignalTimestamps.front(), slidingSignalTimestamps.back(), this->FixedSignal.signalTimestamps);
-
-    ResampleSignalLinearly(slidingSignalTimestamps, trackerPositionPiecewiseSignal, resampledTrackerPositionMetric);
     double normalizationFactor = 1.0;
-    NormalizeMetricValues(resampledTrackerPositionMetric, normalizationFactor);
+    corrValues.push_back(ComputeAlignmentMetricAtOffset(trackerPositionPiecewiseSignal, offsetValueSec, normalizationFactor));
     normalizationFactors.push_back(normalizationFactor);
-
-    corrValues.push_back(ComputeAlignmentMetric(this->FixedSignal.signalValues, resampledTrackerPositionMetric));
   }
 
   // Find the time offset that has the best alignment metric value
@@ -509,6 +583,210 @@ void vtkPlusTemporalCalibrationAlgo::ComputeCorrelationBetweenFixedAndMovingSign
   LOG_DEBUG("numberOfSamples=" << corrValues.size());
 }
 
+//-----------------------------------------------------------------------------
+double vtkPlusTemporalCalibrationAlgo::ComputeAlignmentMetricAtOffset(const vtkSmartPointer<vtkPiecewiseFunction>& movingSignalFunction, double offsetSec, double& movingSignalNormalizationFactor)
+{
+  std::deque<double> slidingSignalTimestamps(this->FixedSignal.signalTimestamps.size());
+  for (unsigned int i = 0; i < slidingSignalTimestamps.size(); ++i)
+  {
+    slidingSignalTimestamps.at(i) =  this->FixedSignal.signalTimestamps.at(i) + offsetSec;
+  }
+
+  NormalizeMetricValues(this->FixedSignal.signalValues, this->FixedSignalValuesNormalizationFactor, slidingSignalTimestamps.front(), slidingSignalTimestamps.back(), this->FixedSignal.signalTimestamps);
+
+  std::deque<double> resampledTrackerPositionMetric;
+  ResampleSignalLinearly(slidingSignalTimestamps, movingSignalFunction, resampledTrackerPositionMetric);
+  movingSignalNormalizationFactor = 1.0;
+  NormalizeMetricValues(resampledTrackerPositionMetric, movingSignalNormalizationFactor);
+
+  return ComputeAlignmentMetric(this->FixedSignal.signalValues, resampledTrackerPositionMetric);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusTemporalCalibrationAlgo::ComputeCorrelationBetweenFixedAndMovingSignalFft(double maxTrackerLagSec, double fineSearchRangeSec, double& bestCorrelationValue, double& bestCorrelationTimeOffset, double& bestCorrelationNormalizationFactor,
+    std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues, std::deque<double>& corrTimeOffsetsFine, std::deque<double>& corrValuesFine)
+{
+  corrTimeOffsets.clear();
+  corrValues.clear();
+  corrTimeOffsetsFine.clear();
+  corrValuesFine.clear();
+
+  const double stepSizeSec = this->SamplingResolutionSec;
+  if (stepSizeSec < TIMESTAMP_EPSILON_SEC)
+  {
+    LOG_ERROR("Sampling resolution is too small: " << stepSizeSec << " sec");
+    return;
+  }
+  if (this->FixedSignal.signalTimestamps.size() < 2 || this->MovingSignal.signalTimestamps.empty())
+  {
+    LOG_ERROR("Cannot compute correlation between fixed and moving signal: not enough samples");
+    return;
+  }
+
+  // Resample both signals once on a uniform grid. The fixed signal f is sampled in its own time range (N samples),
+  // the moving signal g is sampled in the same range extended by the maximum lag at both ends (N + 2K samples),
+  // so that the moving signal at lag k (-K..K) is g[j + k + K] (j = 0..N-1).
+  const double fixedStartTimeSec = this->FixedSignal.signalTimestamps.front();
+  const int numberOfSamples = static_cast<int>(std::floor((this->FixedSignal.signalTimestamps.back() - fixedStartTimeSec) / stepSizeSec)) + 1;
+  const int maxLagSteps = static_cast<int>(std::floor(maxTrackerLagSec / stepSizeSec + TIMESTAMP_EPSILON_SEC));
+  if (numberOfSamples - maxLagSteps < 2)
+  {
+    LOG_ERROR("Cannot compute correlation between fixed and moving signal: maximum lag (" << maxTrackerLagSec << " sec) is too large compared to the signal length");
+    return;
+  }
+  const int numberOfLags = 2 * maxLagSteps + 1;
+  const int numberOfMovingSamples = numberOfSamples + 2 * maxLagSteps;
+
+  std::vector<double> fixedValues(numberOfSamples);
+  ResampleSignalUniformly(this->FixedSignal.signalTimestamps, this->FixedSignal.signalValues, fixedStartTimeSec, stepSizeSec, fixedValues);
+  std::vector<double> movingValues(numberOfMovingSamples);
+  ResampleSignalUniformly(this->MovingSignal.signalTimestamps, this->MovingSignal.signalValues, fixedStartTimeSec - maxLagSteps * stepSizeSec, stepSizeSec, movingValues);
+
+  // The metric does not depend on the signal offset, so subtract the mean values to keep the sums small
+  double fixedMean = 0;
+  for (int i = 0; i < numberOfSamples; ++i)
+  {
+    fixedMean += fixedValues[i];
+  }
+  fixedMean /= numberOfSamples;
+  double movingMean = 0;
+  for (int i = 0; i < numberOfMovingSamples; ++i)
+  {
+    movingMean += movingValues[i];
+  }
+  movingMean /= numberOfMovingSamples;
+
+  // Cumulative sums for computing the mean and standard deviation of any signal window in constant time
+  std::vector<double> fixedSum(numberOfSamples + 1, 0.0);
+  std::vector<double> fixedSumSquares(numberOfSamples + 1, 0.0);
+  for (int i = 0; i < numberOfSamples; ++i)
+  {
+    fixedValues[i] -= fixedMean;
+    fixedSum[i + 1] = fixedSum[i] + fixedValues[i];
+    fixedSumSquares[i + 1] = fixedSumSquares[i] + fixedValues[i] * fixedValues[i];
+  }
+  std::vector<double> movingSum(numberOfMovingSamples + 1, 0.0);
+  std::vector<double> movingSumSquares(numberOfMovingSamples + 1, 0.0);
+  for (int i = 0; i < numberOfMovingSamples; ++i)
+  {
+    movingValues[i] -= movingMean;
+    movingSum[i + 1] = movingSum[i] + movingValues[i];
+    movingSumSquares[i + 1] = movingSumSquares[i] + movingValues[i] * movingValues[i];
+  }
+
+  // Cross-correlation c[s] = sum_j f[j] * g[j + s] for all s = 0..2K, computed as IFFT(conj(FFT(f)) * FFT(g)).
+  // The FFT is long enough to hold the moving signal, therefore no circular wrap-around affects the used lags.
+  const int fftLength = GetFftLength(numberOfMovingSamples);
+  vnl_fft_1d<double> fft(fftLength);
+  vnl_vector< std::complex<double> > fixedSpectrum(fftLength, std::complex<double>(0.0, 0.0));
+  vnl_vector< std::complex<double> > movingSpectrum(fftLength, std::complex<double>(0.0, 0.0));
+  for (int i = 0; i < numberOfSamples; ++i)
+  {
+    fixedSpectrum[i] = fixedValues[i];
+  }
+  for (int i = 0; i < numberOfMovingSamples; ++i)
+  {
+    movingSpectrum[i] = movingValues[i];
+  }
+  fft.fwd_transform(fixedSpectrum);
+  fft.fwd_transform(movingSpectrum);
+  for (int i = 0; i < fftLength; ++i)
+  {
+    movingSpectrum[i] *= std::conj(fixedSpectrum[i]);
+  }
+  fft.bwd_transform(movingSpectrum);
+  const double fftScale = 1.0 / fftLength;
+
+  // Evaluate the alignment metric of the normalized signals for each lag. Same as the metric computed by ComputeAlignmentMetricAtOffset:
+  // the fixed signal is normalized using the mean and stdev of the samples inside the shifted time range, the resampled moving signal
+  // is normalized using its own mean and stdev.
+  const double fixedTotalSum = fixedSum[numberOfSamples];
+  const double fixedTotalSumSquares = fixedSumSquares[numberOfSamples];
+  // The grid may contain a different number of samples than the original fixed signal, scale the metric to make the values comparable
+  const double metricScale = static_cast<double>(this->FixedSignal.signalTimestamps.size()) / numberOfSamples;
+  std::vector<double> metricValues(numberOfLags);
+  for (int lagIndex = 0; lagIndex < numberOfLags; ++lagIndex)
+  {
+    const int lagSteps = lagIndex - maxLagSteps;
+
+    // Fixed signal window
+    int windowStart = std::max(0, lagSteps);
+    int windowStop = std::min(numberOfSamples - 1, numberOfSamples - 1 + lagSteps);
+    int windowSize = windowStop - windowStart + 1;
+    double fixedWindowMean = (fixedSum[windowStop + 1] - fixedSum[windowStart]) / windowSize;
+    double fixedWindowSumSquaredDeviations = (fixedSumSquares[windowStop + 1] - fixedSumSquares[windowStart]) - windowSize * fixedWindowMean * fixedWindowMean;
+    double fixedNormalizationFactor = GetStdNormalizationFactor(fixedWindowSumSquaredDeviations, windowSize);
+    double fixedSumSquaredDeviations = fixedTotalSumSquares - 2 * fixedWindowMean * fixedTotalSum + numberOfSamples * fixedWindowMean * fixedWindowMean;
+
+    // Moving signal samples at the shifted fixed signal grid points
+    double movingWindowSum = movingSum[lagIndex + numberOfSamples] - movingSum[lagIndex];
+    double movingWindowMean = movingWindowSum / numberOfSamples;
+    double movingSumSquaredDeviations = (movingSumSquares[lagIndex + numberOfSamples] - movingSumSquares[lagIndex]) - movingWindowSum * movingWindowMean;
+    double movingNormalizationFactor = GetStdNormalizationFactor(movingSumSquaredDeviations, numberOfSamples);
+
+    // sum_j (f[j] - fixedWindowMean) * (g[j + lagIndex] - movingWindowMean)
+    double crossProductSum = movingSpectrum[lagIndex].real() * fftScale - movingWindowMean * fixedTotalSum;
+
+    double metric = 0;
+    switch (SIGNAL_ALIGNMENT_METRIC)
+    {
+      case SSD:
+        metric = -(fixedNormalizationFactor * fixedNormalizationFactor * fixedSumSquaredDeviations
+                   + movingNormalizationFactor * movingNormalizationFactor * movingSumSquaredDeviations
+                   - 2 * fixedNormalizationFactor * movingNormalizationFactor * crossProductSum);
+        break;
+      case CORRELATION:
+        metric = fixedNormalizationFactor * movingNormalizationFactor * crossProductSum;
+        break;
+      default:
+        LOG_ERROR("Metric is not supported by FFT-based lag search: " << SIGNAL_ALIGNMENT_METRIC);
+        return;
+    }
+    metricValues[lagIndex] = metric * metricScale;
+    corrTimeOffsets.push_back(lagSteps * stepSizeSec);
+    corrValues.push_back(metricValues[lagIndex]);
+  }
+
+  // Find the best lag on the grid and refine it by fitting a parabola on the neighboring metric values
+  int bestLagIndex = static_cast<int>(std::max_element(metricValues.begin(), metricValues.end()) - metricValues.begin());
+  double subSampleOffset = 0;
+  if (bestLagIndex > 0 && bestLagIndex < numberOfLags - 1)
+  {
+    double previousValue = metricValues[bestLagIndex - 1];
+    double nextValue = metricValues[bestLagIndex + 1];
+    double curvature = previousValue - 2 * metricValues[bestLagIndex] + nextValue;
+    if (curvature < 0)
+    {
+      subSampleOffset = std::max(-0.5, std::min(0.5, 0.5 * (previousValue - nextValue) / curvature));
+    }
+  }
+  bestCorrelationTimeOffset = (bestLagIndex - maxLagSteps + subSampleOffset) * stepSizeSec;
+
+  for (int lagIndex = 0; lagIndex < numberOfLags; ++lagIndex)
+  {
+    if (std::abs(corrTimeOffsets[lagIndex] - bestCorrelationTimeOffset) <= fineSearchRangeSec)
+    {
+      corrTimeOffsetsFine.push_back(corrTimeOffsets[lagIndex]);
+      corrValuesFine.push_back(corrValues[lagIndex]);
+    }
+  }
+
+  // Compute the metric value and normalization factors on the original signal samples at the refined offset
+  vtkSmartPointer<vtkPiecewiseFunction> trackerPositionPiecewiseSignal = vtkSmartPointer<vtkPiecewiseFunction>::New();
+  double midpoint = 0.5;
+  double sharpness = 0;
+  for (unsigned int i = 0; i < this->MovingSignal.signalTimestamps.size(); ++i)
+  {
+    trackerPositionPiecewiseSignal->AddPoint(this->MovingSignal.signalTimestamps.at(i), this->MovingSignal.signalValues.at(i), midpoint, sharpness);
+  }
+  bestCorrelationValue = ComputeAlignmentMetricAtOffset(trackerPositionPiecewiseSignal, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor);
+
+  LOG_DEBUG("bestCorrelationValue=" << bestCorrelationValue);
+  LOG_DEBUG("bestCorrelationTimeOffset=" << bestCorrelationTimeOffset);
+  LOG_DEBUG("bestCorrelationNormalizationFactor=" << bestCorrelationNormalizationFactor);
+  LOG_DEBUG("numberOfSamples=" << numberOfSamples << ", numberOfLags=" << numberOfLags << ", fftLength=" << fftLength);
+}
+
 double vtkPlusTemporalCalibrationAlgo::ComputeAlignmentMetric(const std::deque<double>& signalA, const std::deque<double>& signalB)
 {
   if (signalA.size() != signalB.size())
@@ -699,6 +977,10 @@ PlusStatus vtkPlusTemporalCalibrationAlgo::ComputeMovingSignalLagSec(TEMPORAL_CA
 
   double searchRangeFineStep = imageFramePeriodSec * 3;
 
+  // The FFT-based search can only compute metrics that are based on sums of products
+  bool useFftLagSearch = (this->LagSearchMethod == LAG_SEARCH_METHOD_FFT && SIGNAL_ALIGNMENT_METRIC != SAD);
+  double lagSearchStartTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+
   //  Compute cross correlation with sign convention #1
   LOG_DEBUG("ComputeCorrelationBetweenFixedAndMovingSignal(sign convention #1)");
   double bestCorrelationValue = 0;
@@ -706,10 +988,17 @@ PlusStatus vtkPlusTemporalCalibrationAlgo::ComputeMovingSignalLagSec(TEMPORAL_CA
   double bestCorrelationNormalizationFactor = 1.0;
   std::deque<double> corrTimeOffsets;
   std::deque<double> corrValues;
-  ComputeCorrelationBetweenFixedAndMovingSignal(-this->MaxMovingLagSec, this->MaxMovingLagSec, imageFramePeriodSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsets, corrValues);
   std::deque<double> corrTimeOffsetsFine;
   std::deque<double> corrValuesFine;
-  ComputeCorrelationBetweenFixedAndMovingSignal(bestCorrelationTimeOffset - searchRangeFineStep, bestCorrelationTimeOffset + searchRangeFineStep, this->SamplingResolutionSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsetsFine, corrValuesFine);
+  if (useFftLagSearch)
+  {
+    ComputeCorrelationBetweenFixedAndMovingSignalFft(this->MaxMovingLagSec, searchRangeFineStep, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsets, corrValues, corrTimeOffsetsFine, corrValuesFine);
+  }
+  else
+  {
+    ComputeCorrelationBetweenFixedAndMovingSignal(-this->MaxMovingLagSec, this->MaxMovingLagSec, imageFramePeriodSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsets, corrValues);
+    ComputeCorrelationBetweenFixedAndMovingSignal(bestCorrelationTimeOffset - searchRangeFineStep, bestCorrelationTimeOffset + searchRangeFineStep, this->SamplingResolutionSec, bestCorrelationValue, bestCorrelationTimeOffset, bestCorrelationNormalizationFactor, corrTimeOffsetsFine, corrValuesFine);
+  }
   LOG_DEBUG("Time offset with sign convention #1: " << bestCorrelationTimeOffset);
 
   //  Compute cross correlation with sign convention #2
@@ -724,29 +1013,49 @@ PlusStatus vtkPlusTemporalCalibrationAlgo::ComputeMovingSignalLagSec(TEMPORAL_CA
   double bestCorrelationNormalizationFactorInvertedTracker(1.0);
   std::deque<double> corrTimeOffsetsInvertedTracker;
   std::deque<double> corrValuesInvertedTracker;
-  ComputeCorrelationBetweenFixedAndMovingSignal(
-    -this->MaxMovingLagSec,
-    this->MaxMovingLagSec,
-    imageFramePeriodSec,
-    bestCorrelationValueInvertedTracker,
-    bestCorrelationTimeOffsetInvertedTracker,
-    bestCorrelationNormalizationFactorInvertedTracker,
-    corrTimeOffsetsInvertedTracker,
-    corrValuesInvertedTracker
-  );
   std::deque<double> corrTimeOffsetsInvertedTrackerFine;
   std::deque<double> corrValuesInvertedTrackerFine;
-  ComputeCorrelationBetweenFixedAndMovingSignal(
-    bestCorrelationTimeOffsetInvertedTracker - searchRangeFineStep,
-    bestCorrelationTimeOffsetInvertedTracker + searchRangeFineStep,
-    this->SamplingResolutionSec, bestCorrelationValueInvertedTracker,
-    bestCorrelationTimeOffsetInvertedTracker,
-    bestCorrelationNormalizationFactorInvertedTracker,
-    corrTimeOffsetsInvertedTrackerFine,
-    corrValuesInvertedTrackerFine
-  );
+  if (useFftLagSearch)
+  {
+    ComputeCorrelationBetweenFixedAndMovingSignalFft(
+      this->MaxMovingLagSec,
+      searchRangeFineStep,
+      bestCorrelationValueInvertedTracker,
+      bestCorrelationTimeOffsetInvertedTracker,
+      bestCorrelationNormalizationFactorInvertedTracker,
+      corrTimeOffsetsInvertedTracker,
+      corrValuesInvertedTracker,
+      corrTimeOffsetsInvertedTrackerFine,
+      corrValuesInvertedTrackerFine
+    );
+  }
+  else
+  {
+    ComputeCorrelationBetweenFixedAndMovingSignal(
+      -this->MaxMovingLagSec,
+      this->MaxMovingLagSec,
+      imageFramePeriodSec,
+      bestCorrelationValueInvertedTracker,
+      bestCorrelationTimeOffsetInvertedTracker,
+      bestCorrelationNormalizationFactorInvertedTracker,
+      corrTimeOffsetsInvertedTracker,
+      corrValuesInvertedTracker
+    );
+    ComputeCorrelationBetweenFixedAndMovingSignal(
+      bestCorrelationTimeOffsetInvertedTracker - searchRangeFineStep,
+      bestCorrelationTimeOffsetInvertedTracker + searchRangeFineStep,
+      this->SamplingResolutionSec, bestCorrelationValueInvertedTracker,
+      bestCorrelationTimeOffsetInvertedTracker,
+      bestCorrelationNormalizationFactorInvertedTracker,
+      corrTimeOffsetsInvertedTrackerFine,
+      corrValuesInvertedTrackerFine
+    );
+  }
   LOG_DEBUG("Time offset with sign convention #2: " << bestCorrelationTimeOffsetInvertedTracker);
 
+  this->LagSearchTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - lagSearchStartTimeSec;
+  LOG_DEBUG("Time offset search completed in " << this->LagSearchTimeSec << " sec (" << (useFftLagSearch ? "FFT" : "exhaustive") << " search)");
+
   // Adopt the smallest tracker lag
   if (std::abs(bestCorrelationTimeOffset) < std::abs(bestCorrelationTimeOffsetInvertedTracker))
   {
@@ -894,6 +1203,7 @@ PlusStatus vtkPlusTemporalCalibrationAlgo::ReadConfiguration(vtkXMLDataElement*
   }
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SaveIntermediateImages, calibrationParameters);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MaximumMovingLagSec, calibrationParameters);
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(LagSearchMethod, calibrationParameters, "FFT", LAG_SEARCH_METHOD_FFT, "EXHAUSTIVE", LAG_SEARCH_METHOD_EXHAUSTIVE);
 
   if (calibrationParameters != NULL)
   {
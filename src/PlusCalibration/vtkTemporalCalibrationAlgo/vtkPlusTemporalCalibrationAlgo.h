@@ -25,6 +25,11 @@ class vtkTable;
 
   See more infomation in the \ref AlgorithmTemporalCalibration "user documentation".
 
+  By default the time offset is found by resampling both position signals once on a uniform grid (with SamplingResolutionSec spacing),
+  computing the alignment metric for all offsets at once using FFT-based cross-correlation, and refining the best offset by parabolic
+  interpolation (LagSearchMethod="FFT"). The original method, which resamples and normalizes the moving signal separately for each
+  offset in a coarse and a fine search phase, is still available (LagSearchMethod="EXHAUSTIVE").
+
   \ingroup PlusLibCalibrationAlgorithm
 */
 
@@ -62,6 +67,12 @@ public:
     // (e.g., bottom of water tank)
   };
 
+  enum LAG_SEARCH_METHOD
+  {
+    LAG_SEARCH_METHOD_FFT,       // Compute the alignment metric for all offsets at once, using FFT-based cross-correlation
+    LAG_SEARCH_METHOD_EXHAUSTIVE // Resample and evaluate the moving signal separately at each offset (coarse and fine search)
+  };
+
   struct SignalType
   {
     vtkIGSIOTrackedFrameList* frameList;
@@ -105,6 +116,10 @@ public:
   /*! Sets the maximum allowable time lag between the corresponding tracker and video frames. Default is 2 seconds */
   void SetMaximumMovingLagSec(double maxLagSec);
 
+  /*! Sets the method used for finding the time offset with the best signal alignment. Default is LAG_SEARCH_METHOD_FFT. */
+  void SetLagSearchMethod(LAG_SEARCH_METHOD method);
+  LAG_SEARCH_METHOD GetLagSearchMethod() const;
+
   /*! Enable/disable saving of intermediate images for debugging. Need to call before SetVideoFrames. */
   void SetSaveIntermediateImages(bool saveIntermediateImages);
 
@@ -139,6 +154,9 @@ public:
   PlusStatus GetBestCorrelation(double& videoCorrelation);
   PlusStatus GetMaxCalibrationError(double& maxCalibrationError);
 
+  /*! Returns the time [s] that was spent on searching for the best time offset in the last Update() (signal extraction is not included) */
+  double GetLagSearchTimeSec() const;
+
 protected:
   PlusStatus ComputeMovingSignalLagSec(TEMPORAL_CALIBRATION_ERROR& error);
   PlusStatus ComputePositionSignalValues(SignalType& signal);
@@ -151,6 +169,17 @@ protected:
   PlusStatus NormalizeMetricValues(std::deque<double>& signal, double& normalizationFactor, double startTime, double stopTime, const std::deque<double>& timestamps);
   void ComputeCorrelationBetweenFixedAndMovingSignal(double minTrackerLagSec, double maxTrackerLagSec, double stepSizeSec, double& bestCorrelationValue, double& bestCorrelationTimeOffset, double& bestCorrelationNormalizationFactor, std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues);
 
+  /*!
+    Computes the alignment metric for all offsets between -maxTrackerLagSec and +maxTrackerLagSec (with SamplingResolutionSec step size) using FFT-based cross-correlation
+    of the uniformly resampled signals. The best offset is refined by parabolic interpolation and the alignment metric is recomputed exactly at the refined offset.
+    The correlation values within fineSearchRangeSec distance from the best offset are returned in corrTimeOffsetsFine and corrValuesFine.
+  */
+  void ComputeCorrelationBetweenFixedAndMovingSignalFft(double maxTrackerLagSec, double fineSearchRangeSec, double& bestCorrelationValue, double& bestCorrelationTimeOffset, double& bestCorrelationNormalizationFactor,
+      std::deque<double>& corrTimeOffsets, std::deque<double>& corrValues, std::deque<double>& corrTimeOffsetsFine, std::deque<double>& corrValuesFine);
+
+  /*! Normalizes the fixed signal and the moving signal resampled at the fixed signal timestamps shifted by offsetSec and returns the alignment metric */
+  double ComputeAlignmentMetricAtOffset(const vtkSmartPointer<vtkPiecewiseFunction>& movingSignalFunction, double offsetSec, double& movingSignalNormalizationFactor);
+
   double ComputeAlignmentMetric(const std::deque<double>& signalA, const std::deque<double>& signalB);
 
   PlusStatus ConstructTableSignal(std::deque<double>& x, std::deque<double>& y, vtkTable* table, double timeCorrection);
@@ -203,6 +232,12 @@ protected:
   /*! Maximum allowed tracker lag--if lag is greater, will exit computation */
   double MaxMovingLagSec;
 
+  /*! Method used for finding the time offset with the best signal alignment */
+  LAG_SEARCH_METHOD LagSearchMethod;
+
+  /*! Time [s] spent on the time offset search in the last update */
+  double LagSearchTimeSec;
+
   /*! Normalization factor used for the tracker metric. Used for computing calibration error. */
   double BestCorrelationNormalizationFactor;
   /*! Normalization factor used for the video metric. Used for computing calibration error. */
@@ -0,0 +1,354 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PixelCodec.h"
+#include "PixelCodecKernels.h"
+
+// STL includes
+#include <atomic>
+
+#if defined(PLUS_PIXELCODEC_X86_SIMD) && defined(_MSC_VER)
+  #include <intrin.h>
+#endif
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Scalar implementations, these are used for the pixels that the vectorized kernels do not process
+
+  //----------------------------------------------------------------------------
+  void RGBToBGRScalar(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    for (int i = 0; i < numberOfPixels; i++)
+    {
+      *(d++) = s[2];
+      *(d++) = s[1];
+      *(d++) = s[0];
+      s += 3;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void BGRA32ToRGB24Scalar(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    for (int i = 0; i < numberOfPixels; i++)
+    {
+      *(d++) = s[2];
+      *(d++) = s[1];
+      *(d++) = s[0];
+      s += 4; // ignore alpha channel
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void RGBA32ToRGB24Scalar(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    for (int i = 0; i < numberOfPixels; i++)
+    {
+      *(d++) = *(s++);
+      *(d++) = *(s++);
+      *(d++) = *(s++);
+      s++; // ignore alpha channel
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void RGB24ToGrayScalar(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    for (int i = 0; i < numberOfPixels; i++)
+    {
+      *d = ((unsigned short)(s[0]) + s[1] + s[2]) / 3;
+      d++;
+      s += 3;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void RGBA32ToGrayScalar(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    for (int i = 0; i < numberOfPixels; i++)
+    {
+      *d = ((unsigned short)(s[0]) + s[1] + s[2]) / 3;
+      d++;
+      s += 4;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void YUV422pToRGB24Scalar(int numberOfPixelPairs, bool outputBgr, const unsigned char* s, unsigned char* d)
+  {
+    unsigned char y1, u, y2, v;
+    int Y1, Y2, U, V;
+    unsigned char r, g, b;
+
+    unsigned long srcIndex = 0;
+    unsigned long dstIndex = 0;
+
+    for (int i = 0 ; i < numberOfPixelPairs ; i++)
+    {
+      y1 = s[srcIndex];
+      u = s[srcIndex + 1];
+      y2 = s[srcIndex + 2];
+      v = s[srcIndex + 3];
+
+      Y1 = ICCIRY(y1);
+      U = ICCIRUV(u - 128);
+      Y2 = ICCIRY(y2);
+      V = ICCIRUV(v - 128);
+
+      r = CLIP(GET_R_FROM_YUV(Y1, U, V));
+      g = CLIP(GET_G_FROM_YUV(Y1, U, V));
+      b = CLIP(GET_B_FROM_YUV(Y1, U, V));
+
+      d[dstIndex] = outputBgr ? b : r;
+      d[dstIndex + 1] = g;
+      d[dstIndex + 2] = outputBgr ? r : b;
+
+      dstIndex += 3;
+
+      r = CLIP(GET_R_FROM_YUV(Y2, U, V));
+      g = CLIP(GET_G_FROM_YUV(Y2, U, V));
+      b = CLIP(GET_B_FROM_YUV(Y2, U, V));
+
+      d[dstIndex] = outputBgr ? b : r;
+      d[dstIndex + 1] = g;
+      d[dstIndex + 2] = outputBgr ? r : b;
+
+      dstIndex += 3;
+      srcIndex += 4;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  bool IsCpuFeatureSupported(PixelCodec::InstructionSet instructionSet)
+  {
+    switch (instructionSet)
+    {
+      case PixelCodec::InstructionSet_Scalar:
+        return true;
+#if defined(PLUS_PIXELCODEC_X86_SIMD)
+#if defined(_MSC_VER)
+      case PixelCodec::InstructionSet_SSSE3:
+      {
+        int cpuInfo[4] = {0, 0, 0, 0};
+        __cpuid(cpuInfo, 1);
+        return (cpuInfo[2] & (1 << 9)) != 0;
+      }
+      case PixelCodec::InstructionSet_AVX2:
+      {
+        int cpuInfo[4] = {0, 0, 0, 0};
+        __cpuid(cpuInfo, 0);
+        if (cpuInfo[0] < 7)
+        {
+          return false;
+        }
+        __cpuid(cpuInfo, 1);
+        const bool osSavesYmmRegisters = (cpuInfo[2] & (1 << 27)) != 0 && (cpuInfo[2] & (1 << 28)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+        if (!osSavesYmmRegisters)
+        {
+          return false;
+        }
+        __cpuidex(cpuInfo, 7, 0);
+        return (cpuInfo[1] & (1 << 5)) != 0;
+      }
+#else
+      case PixelCodec::InstructionSet_SSSE3:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("ssse3") != 0;
+      case PixelCodec::InstructionSet_AVX2:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+#endif
+#if defined(PLUS_PIXELCODEC_NEON)
+      case PixelCodec::InstructionSet_NEON:
+        // Advanced SIMD is mandatory on AArch64
+        return true;
+#endif
+      default:
+        return false;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  const PixelCodecKernelTable* GetKernelTable(PixelCodec::InstructionSet instructionSet)
+  {
+    switch (instructionSet)
+    {
+#if defined(PLUS_PIXELCODEC_X86_SIMD)
+      case PixelCodec::InstructionSet_SSSE3:
+        return GetPixelCodecKernelsSSSE3();
+      case PixelCodec::InstructionSet_AVX2:
+        return GetPixelCodecKernelsAVX2();
+#endif
+#if defined(PLUS_PIXELCODEC_NEON)
+      case PixelCodec::InstructionSet_NEON:
+        return GetPixelCodecKernelsNEON();
+#endif
+      default:
+        return NULL;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PixelCodec::InstructionSet GetFastestSupportedInstructionSet()
+  {
+    const PixelCodec::InstructionSet candidates[] = { PixelCodec::InstructionSet_AVX2, PixelCodec::InstructionSet_NEON, PixelCodec::InstructionSet_SSSE3 };
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); ++i)
+    {
+      if (IsCpuFeatureSupported(candidates[i]))
+      {
+        return candidates[i];
+      }
+    }
+    return PixelCodec::InstructionSet_Scalar;
+  }
+
+  //----------------------------------------------------------------------------
+  std::atomic<int>& GetActiveInstructionSet()
+  {
+    static std::atomic<int> activeInstructionSet(GetFastestSupportedInstructionSet());
+    return activeInstructionSet;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns NULL if the scalar implementation is selected */
+  const PixelCodecKernelTable* GetActiveKernelTable()
+  {
+    return GetKernelTable(static_cast<PixelCodec::InstructionSet>(GetActiveInstructionSet().load()));
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PixelCodec::IsInstructionSetSupported(InstructionSet instructionSet)
+{
+  return IsCpuFeatureSupported(instructionSet);
+}
+
+//----------------------------------------------------------------------------
+PixelCodec::InstructionSet PixelCodec::GetInstructionSet()
+{
+  return static_cast<InstructionSet>(GetActiveInstructionSet().load());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PixelCodec::SetInstructionSet(InstructionSet instructionSet)
+{
+  if (!IsInstructionSetSupported(instructionSet))
+  {
+    LOG_ERROR("Instruction set " << GetInstructionSetAsString(instructionSet) << " is not supported on this computer");
+    return PLUS_FAIL;
+  }
+  GetActiveInstructionSet().store(instructionSet);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::string PixelCodec::GetInstructionSetAsString(InstructionSet instructionSet)
+{
+  switch (instructionSet)
+  {
+    case InstructionSet_Scalar:
+      return "Scalar";
+    case InstructionSet_SSSE3:
+      return "SSSE3";
+    case InstructionSet_AVX2:
+      return "AVX2";
+    case InstructionSet_NEON:
+      return "NEON";
+    default:
+      return "Unknown";
+  }
+}
+
+//----------------------------------------------------------------------------
+void PixelCodec::RGBToBGR(int width, int height, unsigned char* s, unsigned char* d)
+{
+  int numberOfPixels = width * height;
+  int processedPixels = 0;
+  const PixelCodecKernelTable* kernels = GetActiveKernelTable();
+  if (kernels != NULL)
+  {
+    processedPixels = kernels->RGBToBGR(numberOfPixels, s, d);
+  }
+  RGBToBGRScalar(numberOfPixels - processedPixels, s + 3 * processedPixels, d + 3 * processedPixels);
+}
+
+//----------------------------------------------------------------------------
+void PixelCodec::BGRA32ToRGB24(int width, int height, unsigned char* s, unsigned char* d)
+{
+  int numberOfPixels = width * height;
+  int processedPixels = 0;
+  const PixelCodecKernelTable* kernels = GetActiveKernelTable();
+  if (kernels != NULL)
+  {
+    processedPixels = kernels->BGRA32ToRGB24(numberOfPixels, s, d);
+  }
+  BGRA32ToRGB24Scalar(numberOfPixels - processedPixels, s + 4 * processedPixels, d + 3 * processedPixels);
+}
+
+//----------------------------------------------------------------------------
+void PixelCodec::RGBA32ToBGR24(int width, int height, unsigned char* s, unsigned char* d)
+{
+  // Swapping the first and third components and dropping the fourth is the same operation in both directions
+  BGRA32ToRGB24(width, height, s, d);
+}
+
+//----------------------------------------------------------------------------
+void PixelCodec::RGBA32ToRGB24(int width, int height, unsigned char* s, unsigned char* d)
+{
+  int numberOfPixels = width * height;
+  int processedPixels = 0;
+  const PixelCodecKernelTable* kernels = GetActiveKernelTable();
+  if (kernels != NULL)
+  {
+    processedPixels = kernels->RGBA32ToRGB24(numberOfPixels, s, d);
+  }
+  RGBA32ToRGB24Scalar(numberOfPixels - processedPixels, s + 4 * processedPixels, d + 3 * processedPixels);
+}
+
+//----------------------------------------------------------------------------
+void PixelCodec::RGB24ToGray(int width, int height, unsigned char* s, unsigned char* d)
+{
+  int numberOfPixels = width * height;
+  int processedPixels = 0;
+  const PixelCodecKernelTable* kernels = GetActiveKernelTable();
+  if (kernels != NULL)
+  {
+    processedPixels = kernels->RGB24ToGray(numberOfPixels, s, d);
+  }
+  RGB24ToGrayScalar(numberOfPixels - processedPixels, s + 3 * processedPixels, d + processedPixels);
+}
+
+//----------------------------------------------------------------------------
+void PixelCodec::RGBA32ToGray(int width, int height, unsigned char* s, unsigned char* d)
+{
+  int numberOfPixels = width * height;
+  int processedPixels = 0;
+  const PixelCodecKernelTable* kernels = GetActiveKernelTable();
+  if (kernels != NULL)
+  {
+    processedPixels = kernels->RGBA32ToGray(numberOfPixels, s, d);
+  }
+  RGBA32ToGrayScalar(numberOfPixels - processedPixels, s + 4 * processedPixels, d + processedPixels);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PixelCodec::YUV422pToRGB24(ComponentOrdering outputOrdering, int width, int height, unsigned char* s, unsigned char* d)
+{
+  bool outputBgr = (outputOrdering == ComponentOrder_BGR);
+  int numberOfPixelPairs = height * (width / 2);
+  int processedPairs = 0;
+  const PixelCodecKernelTable* kernels = GetActiveKernelTable();
+  if (kernels != NULL)
+  {
+    processedPairs = kernels->YUV422pToRGB24(numberOfPixelPairs, outputBgr, s, d);
+  }
+  YUV422pToRGB24Scalar(numberOfPixelPairs - processedPairs, outputBgr, s + 4 * processedPairs, d + 6 * processedPairs);
+  return PLUS_SUCCESS;
+}
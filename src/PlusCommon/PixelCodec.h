@@ -8,6 +8,7 @@ See License.txt for details.
 #define __PixelCodec_h
 
 #include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
 
 #include <iomanip>
 
@@ -41,9 +42,14 @@ static const long VTK_BI_YUY2 = 0x32595559;
 /*!
 \class PixelCodec
 \brief A utility class that contains static functions for converting between various pixel encodings
+
+The most frequently used conversions (component reordering, alpha removal, conversion to grayscale and
+YUY2 decoding) have vectorized implementations. The fastest instruction set that the CPU supports is
+selected at runtime, the results are identical to the scalar implementation.
+
 \ingroup PlusLibCommon
 */
-class PixelCodec
+class vtkPlusCommonExport PixelCodec
 {
 public:
   enum ComponentOrdering
@@ -63,6 +69,29 @@ public:
     PixelEncoding_MJPG
   };
 
+  /*! Instruction sets that the vectorized conversions can use */
+  enum InstructionSet
+  {
+    InstructionSet_Scalar,
+    InstructionSet_SSSE3,
+    InstructionSet_AVX2,
+    InstructionSet_NEON
+  };
+
+  /*! Returns true if the instruction set is compiled in and supported by the CPU */
+  static bool IsInstructionSetSupported(InstructionSet instructionSet);
+
+  /*! Get the instruction set that is used for the conversions. By default the fastest supported instruction set is used. */
+  static InstructionSet GetInstructionSet();
+
+  /*!
+    Set the instruction set that is used for the conversions (e.g., for benchmarking or testing).
+    \return PLUS_FAIL if the instruction set is not supported
+  */
+  static PlusStatus SetInstructionSet(InstructionSet instructionSet);
+
+  static std::string GetInstructionSetAsString(InstructionSet instructionSet);
+
   //----------------------------------------------------------------------------
   static bool IsConvertToGraySupported(int inputCompression)
   {
@@ -245,52 +274,16 @@ public:
   }
 
   //----------------------------------------------------------------------------
-  static inline void RGBToBGR(int width, int height, unsigned char* s, unsigned char* d)
-  {
-    for (int i = 0; i < width * height; i++)
-    {
-      *(d++) = s[2];
-      *(d++) = s[1];
-      *(d++) = s[0];
-      s += 3;
-    }
-  }
+  static void RGBToBGR(int width, int height, unsigned char* s, unsigned char* d);
 
   //----------------------------------------------------------------------------
-  static inline void BGRA32ToRGB24(int width, int height, unsigned char* s, unsigned char* d)
-  {
-    for (int i = 0; i < width * height; i++)
-    {
-      *(d++) = s[2];
-      *(d++) = s[1];
-      *(d++) = s[0];
-      s += 4; // ignore alpha channel
-    }
-  }
+  static void BGRA32ToRGB24(int width, int height, unsigned char* s, unsigned char* d);
 
   //----------------------------------------------------------------------------
-  static inline void RGBA32ToBGR24(int width, int height, unsigned char* s, unsigned char* d)
-  {
-    for (int i = 0; i < width * height; i++)
-    {
-      *(d++) = s[2];
-      *(d++) = s[1];
-      *(d++) = s[0];
-      s += 4; // ignore alpha channel
-    }
-  }
+  static void RGBA32ToBGR24(int width, int height, unsigned char* s, unsigned char* d);
 
   //----------------------------------------------------------------------------
-  static inline void RGBA32ToRGB24(int width, int height, unsigned char* s, unsigned char* d)
-  {
-    for (int i = 0; i < width * height; i++)
-    {
-      *(d++) = *(s++);
-      *(d++) = *(s++);
-      *(d++) = *(s++);
-      s++; // ignore alpha channel
-    }
-  }
+  static void RGBA32ToRGB24(int width, int height, unsigned char* s, unsigned char* d);
 
   //----------------------------------------------------------------------------
   /*!
@@ -298,15 +291,7 @@ public:
   Note that this method computes the intensity (simple averaging of the RGB components).
   This is not equivalent with the perceived luminance of color images (e.g., 0.21R + 0.72G + 0.07B or 0.30R + 0.59G + 0.11B)
   */
-  static inline void RGB24ToGray(int width, int height, unsigned char* s, unsigned char* d)
-  {
-    for (int i = 0; i < width * height; i++)
-    {
-      *d = ((unsigned short)(s[0]) + s[1] + s[2]) / 3;
-      d++;
-      s += 3;
-    }
-  }
+  static void RGB24ToGray(int width, int height, unsigned char* s, unsigned char* d);
 
   //----------------------------------------------------------------------------
   /*!
@@ -314,15 +299,7 @@ public:
   Note that this method computes the intensity (simple averaging of the RGB components).
   This is not equivalent with the perceived luminance of color images (e.g., 0.21R + 0.72G + 0.07B or 0.30R + 0.59G + 0.11B)
   */
-  static inline void RGBA32ToGray(int width, int height, unsigned char* s, unsigned char* d)
-  {
-    for (int i = 0; i < width * height; i++)
-    {
-      *d = ((unsigned short)(s[0]) + s[1] + s[2]) / 3;
-      d++;
-      s += 4;
-    }
-  }
+  static void RGBA32ToGray(int width, int height, unsigned char* s, unsigned char* d);
 
   //----------------------------------------------------------------------------
   /*! Conversion from YUV to RGB space
@@ -384,55 +361,7 @@ public:
   YUY2 coding is typically used for webcams
   source: http://sundararajana.blogspot.ca/2007/12/yuy2-to-rgb24-conversion.html
   */
-  static PlusStatus YUV422pToRGB24(ComponentOrdering outputOrdering, int width, int height, unsigned char* s, unsigned char* d)
-  {
-    unsigned char* p_dest;
-    unsigned char y1, u, y2, v;
-    int Y1, Y2, U, V;
-    unsigned char r, g, b;
-
-    p_dest = d;
-
-    int size = height * (width / 2);
-    unsigned long srcIndex = 0;
-    unsigned long dstIndex = 0;
-
-    for (int i = 0 ; i < size ; i++)
-    {
-      y1 = s[srcIndex];
-      u = s[srcIndex + 1];
-      y2 = s[srcIndex + 2];
-      v = s[srcIndex + 3];
-
-      Y1 = ICCIRY(y1);
-      U = ICCIRUV(u - 128);
-      Y2 = ICCIRY(y2);
-      V = ICCIRUV(v - 128);
-
-      r = CLIP(GET_R_FROM_YUV(Y1, U, V));
-      g = CLIP(GET_G_FROM_YUV(Y1, U, V));
-      b = CLIP(GET_B_FROM_YUV(Y1, U, V));
-
-      p_dest[dstIndex] = outputOrdering == ComponentOrder_BGR ? b : r;
-      p_dest[dstIndex + 1] = g;
-      p_dest[dstIndex + 2] = outputOrdering == ComponentOrder_BGR ? r : b;
-
-      dstIndex += 3;
-
-      r = CLIP(GET_R_FROM_YUV(Y2, U, V));
-      g = CLIP(GET_G_FROM_YUV(Y2, U, V));
-      b = CLIP(GET_B_FROM_YUV(Y2, U, V));
-
-      p_dest[dstIndex] = outputOrdering == ComponentOrder_BGR ? b : r;
-      p_dest[dstIndex + 1] = g;
-      p_dest[dstIndex + 2] = outputOrdering == ComponentOrder_BGR ? r : b;
-
-      dstIndex += 3;
-      srcIndex += 4;
-    }
-
-    return PLUS_SUCCESS;
-  }
+  static PlusStatus YUV422pToRGB24(ComponentOrdering outputOrdering, int width, int height, unsigned char* s, unsigned char* d);
 
   //----------------------------------------------------------------------------
   /*!
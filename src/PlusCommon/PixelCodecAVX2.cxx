@@ -0,0 +1,69 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// This file is compiled with AVX2 code generation enabled, it must only be called if the CPU supports AVX2
+
+#include <immintrin.h>
+
+#include "PixelCodecKernels.txx"
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*!
+    AVX2 intrinsics used by the pixel conversion kernels.
+    AVX2 shuffle, pack and unpack instructions operate within 128-bit lanes, therefore each lane
+    converts its own block of pixels: the lower lane is loaded from p and the upper lane from p + laneStride.
+  */
+  struct AVX2Vector
+  {
+    typedef __m256i Vec;
+    static const int NumberOfLanes = 2;
+
+    static inline Vec Load(const unsigned char* p, int laneStride)
+    {
+      __m128i lower = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+      __m128i upper = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + laneStride));
+      return _mm256_inserti128_si256(_mm256_castsi128_si256(lower), upper, 1);
+    }
+    static inline void Store(unsigned char* p, int laneStride, Vec v)
+    {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_castsi256_si128(v));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + laneStride), _mm256_extracti128_si256(v, 1));
+    }
+    static inline Vec LoadMask(const signed char* mask) { return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask))); }
+    static inline Vec Shuffle(Vec v, Vec mask) { return _mm256_shuffle_epi8(v, mask); }
+    static inline Vec Zero() { return _mm256_setzero_si256(); }
+    static inline Vec Set16(short value) { return _mm256_set1_epi16(value); }
+    static inline Vec Set32(int value) { return _mm256_set1_epi32(value); }
+    static inline Vec And(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+    static inline Vec Or(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+    static inline Vec Add16(Vec a, Vec b) { return _mm256_add_epi16(a, b); }
+    static inline Vec Subtract16(Vec a, Vec b) { return _mm256_sub_epi16(a, b); }
+    static inline Vec Add32(Vec a, Vec b) { return _mm256_add_epi32(a, b); }
+    static inline Vec Subtract32(Vec a, Vec b) { return _mm256_sub_epi32(a, b); }
+    static inline Vec Abs16(Vec a) { return _mm256_abs_epi16(a); }
+    static inline Vec Sign16(Vec a, Vec sign) { return _mm256_sign_epi16(a, sign); }
+    static inline Vec MultiplyHighUnsigned16(Vec a, Vec b) { return _mm256_mulhi_epu16(a, b); }
+    static inline Vec MultiplyAdd16(Vec a, Vec b) { return _mm256_madd_epi16(a, b); }
+    template <int Shift> static inline Vec ShiftLeft16(Vec a) { return _mm256_slli_epi16(a, Shift); }
+    template <int Shift> static inline Vec ShiftRightLogical16(Vec a) { return _mm256_srli_epi16(a, Shift); }
+    template <int Shift> static inline Vec ShiftLeft32(Vec a) { return _mm256_slli_epi32(a, Shift); }
+    template <int Shift> static inline Vec ShiftRightArithmetic32(Vec a) { return _mm256_srai_epi32(a, Shift); }
+    static inline Vec UnpackLow8(Vec a, Vec b) { return _mm256_unpacklo_epi8(a, b); }
+    static inline Vec UnpackHigh8(Vec a, Vec b) { return _mm256_unpackhi_epi8(a, b); }
+    static inline Vec UnpackLow16(Vec a, Vec b) { return _mm256_unpacklo_epi16(a, b); }
+    static inline Vec UnpackHigh16(Vec a, Vec b) { return _mm256_unpackhi_epi16(a, b); }
+    static inline Vec PackSignedSaturate32(Vec a, Vec b) { return _mm256_packs_epi32(a, b); }
+    static inline Vec PackUnsignedSaturate16(Vec a, Vec b) { return _mm256_packus_epi16(a, b); }
+  };
+}
+
+//----------------------------------------------------------------------------
+const PixelCodecKernelTable* GetPixelCodecKernelsAVX2()
+{
+  return GetKernelTable<AVX2Vector>();
+}
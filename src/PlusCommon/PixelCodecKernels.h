@@ -0,0 +1,40 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PixelCodecKernels_h
+#define __PixelCodecKernels_h
+
+/*!
+  \struct PixelCodecKernelTable
+  \brief Vectorized pixel conversion functions of an instruction set. For internal use by PixelCodec only.
+
+  Each function processes the largest multiple of its block size and returns the number of pixels
+  (pixel pairs for YUY2) that it has processed. The caller converts the remaining pixels with the scalar implementation.
+
+  \ingroup PlusLibCommon
+*/
+struct PixelCodecKernelTable
+{
+  /*! Reverses the order of the 3 components of each pixel (also usable for BGR to RGB) */
+  int (*RGBToBGR)(int numberOfPixels, const unsigned char* s, unsigned char* d);
+  /*! Reverses the order of the first 3 components of each pixel and drops the 4th (also usable for RGBA32 to BGR24) */
+  int (*BGRA32ToRGB24)(int numberOfPixels, const unsigned char* s, unsigned char* d);
+  int (*RGBA32ToRGB24)(int numberOfPixels, const unsigned char* s, unsigned char* d);
+  int (*RGB24ToGray)(int numberOfPixels, const unsigned char* s, unsigned char* d);
+  int (*RGBA32ToGray)(int numberOfPixels, const unsigned char* s, unsigned char* d);
+  int (*YUV422pToRGB24)(int numberOfPixelPairs, bool outputBgr, const unsigned char* s, unsigned char* d);
+};
+
+#if defined(PLUS_PIXELCODEC_X86_SIMD)
+const PixelCodecKernelTable* GetPixelCodecKernelsSSSE3();
+const PixelCodecKernelTable* GetPixelCodecKernelsAVX2();
+#endif
+
+#if defined(PLUS_PIXELCODEC_NEON)
+const PixelCodecKernelTable* GetPixelCodecKernelsNEON();
+#endif
+
+#endif
@@ -0,0 +1,321 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*
+  Vectorized pixel conversion kernels for x86, shared by the SSSE3 and AVX2 implementations.
+
+  The kernels are written for a traits class V that wraps the intrinsics of an instruction set
+  (see PixelCodecSSSE3.cxx and PixelCodecAVX2.cxx). All operations work within 128-bit lanes,
+  so each lane converts a block of 16 consecutive pixels. V::Load and V::Store place consecutive
+  blocks into consecutive lanes.
+
+  Component reordering and (de)interleaving is done by byte shuffles: each output vector is
+  combined from the shuffled input vectors using masks that are computed from a byte index mapping.
+
+  Everything is in an anonymous namespace: this file is compiled with different instruction set flags
+  in each including translation unit, so the linker must not merge the instantiations.
+*/
+
+#include "PixelCodecKernels.h"
+
+namespace
+{
+  const int BYTES_PER_LANE = 16;
+  const int PIXELS_PER_LANE = 16;
+
+  //----------------------------------------------------------------------------
+  /*!
+    Shuffle masks for selecting bytes from NumberOfInputs vectors into NumberOfOutputs vectors.
+    SourceIndex(j) returns the index of the input byte that is copied to output byte j.
+  */
+  template <int NumberOfInputs, int NumberOfOutputs>
+  struct ShuffleMasks
+  {
+    signed char Mask[NumberOfOutputs][NumberOfInputs][BYTES_PER_LANE];
+
+    explicit ShuffleMasks(int (*sourceIndex)(int))
+    {
+      for (int outputByte = 0; outputByte < NumberOfOutputs * BYTES_PER_LANE; ++outputByte)
+      {
+        int inputByte = sourceIndex(outputByte);
+        for (int input = 0; input < NumberOfInputs; ++input)
+        {
+          bool inThisInput = (inputByte / BYTES_PER_LANE == input);
+          // pshufb writes zero if the mask byte has its highest bit set
+          Mask[outputByte / BYTES_PER_LANE][input][outputByte % BYTES_PER_LANE] = static_cast<signed char>(inThisInput ? (inputByte % BYTES_PER_LANE) : 0x80);
+        }
+      }
+    }
+  };
+
+  // Byte index mappings for a block of 16 pixels. The mapping is a template argument of the kernels so that each kernel has its own static masks.
+  int RgbToBgrSourceIndex(int j) { return 3 * (j / 3) + 2 - j % 3; }
+  int BgraToRgbSourceIndex(int j) { return 4 * (j / 3) + 2 - j % 3; }
+  int RgbaToRgbSourceIndex(int j) { return 4 * (j / 3) + j % 3; }
+  int Rgb24ToPlanarSourceIndex(int j) { return 3 * (j % PIXELS_PER_LANE) + j / PIXELS_PER_LANE; }
+  int Rgba32ToPlanarSourceIndex(int j) { return 4 * (j % PIXELS_PER_LANE) + j / PIXELS_PER_LANE; }
+  int PlanarToRgb24SourceIndex(int j) { return (j % 3) * PIXELS_PER_LANE + j / 3; }
+
+  //----------------------------------------------------------------------------
+  template <class V, int NumberOfInputs, int NumberOfOutputs>
+  struct ShuffleVectors
+  {
+    typename V::Vec Masks[NumberOfOutputs][NumberOfInputs];
+
+    explicit ShuffleVectors(const ShuffleMasks<NumberOfInputs, NumberOfOutputs>& masks)
+    {
+      for (int output = 0; output < NumberOfOutputs; ++output)
+      {
+        for (int input = 0; input < NumberOfInputs; ++input)
+        {
+          Masks[output][input] = V::LoadMask(masks.Mask[output][input]);
+        }
+      }
+    }
+
+    inline void Apply(const typename V::Vec* inputs, typename V::Vec* outputs) const
+    {
+      for (int output = 0; output < NumberOfOutputs; ++output)
+      {
+        typename V::Vec result = V::Shuffle(inputs[0], Masks[output][0]);
+        for (int input = 1; input < NumberOfInputs; ++input)
+        {
+          result = V::Or(result, V::Shuffle(inputs[input], Masks[output][input]));
+        }
+        outputs[output] = result;
+      }
+    }
+  };
+
+  //----------------------------------------------------------------------------
+  /*! Copy selected bytes of each pixel. Input and output pixels are NumberOfInputs and NumberOfOutputs bytes long. */
+  template <class V, int NumberOfInputs, int NumberOfOutputs, int (*SourceIndex)(int)>
+  int ShuffleKernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    static const ShuffleMasks<NumberOfInputs, NumberOfOutputs> masks(SourceIndex);
+    const ShuffleVectors<V, NumberOfInputs, NumberOfOutputs> shuffle(masks);
+
+    const int inputLaneStride = NumberOfInputs * BYTES_PER_LANE;
+    const int outputLaneStride = NumberOfOutputs * BYTES_PER_LANE;
+    const int pixelsPerBlock = PIXELS_PER_LANE * V::NumberOfLanes;
+    const int numberOfBlocks = numberOfPixels / pixelsPerBlock;
+
+    typename V::Vec inputs[NumberOfInputs];
+    typename V::Vec outputs[NumberOfOutputs];
+    for (int block = 0; block < numberOfBlocks; ++block)
+    {
+      for (int input = 0; input < NumberOfInputs; ++input)
+      {
+        inputs[input] = V::Load(s + input * BYTES_PER_LANE, inputLaneStride);
+      }
+      shuffle.Apply(inputs, outputs);
+      for (int output = 0; output < NumberOfOutputs; ++output)
+      {
+        V::Store(d + output * BYTES_PER_LANE, outputLaneStride, outputs[output]);
+      }
+      s += inputLaneStride * V::NumberOfLanes;
+      d += outputLaneStride * V::NumberOfLanes;
+    }
+    return numberOfBlocks * pixelsPerBlock;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Compute (r+g+b)/3 of 16-bit values. x/3 == (x*0xAAAB)>>17 for all x <= 765. */
+  template <class V>
+  inline typename V::Vec DivideBy3(typename V::Vec x)
+  {
+    return V::template ShiftRightLogical16<1>(V::MultiplyHighUnsigned16(x, V::Set16(static_cast<short>(0xAAAB))));
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Average the first 3 components of each pixel. Input pixels are NumberOfInputs bytes long. */
+  template <class V, int NumberOfInputs, int (*PlanarSourceIndex)(int)>
+  int GrayKernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    static const ShuffleMasks<NumberOfInputs, 3> masks(PlanarSourceIndex);
+    const ShuffleVectors<V, NumberOfInputs, 3> toPlanar(masks);
+
+    const int inputLaneStride = NumberOfInputs * BYTES_PER_LANE;
+    const int pixelsPerBlock = PIXELS_PER_LANE * V::NumberOfLanes;
+    const int numberOfBlocks = numberOfPixels / pixelsPerBlock;
+    const typename V::Vec zero = V::Zero();
+
+    typename V::Vec inputs[NumberOfInputs];
+    typename V::Vec planes[3];
+    for (int block = 0; block < numberOfBlocks; ++block)
+    {
+      for (int input = 0; input < NumberOfInputs; ++input)
+      {
+        inputs[input] = V::Load(s + input * BYTES_PER_LANE, inputLaneStride);
+      }
+      toPlanar.Apply(inputs, planes);
+      typename V::Vec sumLow = V::Add16(V::Add16(V::UnpackLow8(planes[0], zero), V::UnpackLow8(planes[1], zero)), V::UnpackLow8(planes[2], zero));
+      typename V::Vec sumHigh = V::Add16(V::Add16(V::UnpackHigh8(planes[0], zero), V::UnpackHigh8(planes[1], zero)), V::UnpackHigh8(planes[2], zero));
+      V::Store(d, BYTES_PER_LANE, V::PackUnsignedSaturate16(DivideBy3<V>(sumLow), DivideBy3<V>(sumHigh)));
+      s += inputLaneStride * V::NumberOfLanes;
+      d += BYTES_PER_LANE * V::NumberOfLanes;
+    }
+    return numberOfBlocks * pixelsPerBlock;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! ICCIRY: ((y-16)<<8)/219, truncated towards zero. floor(m/219) == ((m*38305)>>16)>>7 for all m <= 61184. */
+  template <class V>
+  inline typename V::Vec ConvertLuma(typename V::Vec y)
+  {
+    typename V::Vec diff = V::Subtract16(y, V::Set16(16));
+    typename V::Vec magnitude = V::template ShiftLeft16<8>(V::Abs16(diff));
+    typename V::Vec quotient = V::template ShiftRightLogical16<7>(V::MultiplyHighUnsigned16(magnitude, V::Set16(static_cast<short>(38305))));
+    return V::Sign16(quotient, diff);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! ICCIRUV: ((c-128)<<8)/224, truncated towards zero. floor(8m/7) == (8m*9363)>>16 for all m <= 128. */
+  template <class V>
+  inline typename V::Vec ConvertChroma(typename V::Vec c)
+  {
+    typename V::Vec diff = V::Subtract16(c, V::Set16(128));
+    typename V::Vec magnitude = V::template ShiftLeft16<3>(V::Abs16(diff));
+    typename V::Vec quotient = V::MultiplyHighUnsigned16(magnitude, V::Set16(9363));
+    return V::Sign16(quotient, diff);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns (cu*U + cv*V + 32768) >> 16 for each (U,V) pair stored in a 32-bit element */
+  template <class V>
+  inline typename V::Vec ChromaProduct(typename V::Vec uv, short cu, short cv)
+  {
+    typename V::Vec coefficients = V::Set32(static_cast<int>((static_cast<unsigned int>(static_cast<unsigned short>(cv)) << 16) | static_cast<unsigned short>(cu)));
+    return V::template ShiftRightArithmetic32<16>(V::Add32(V::MultiplyAdd16(uv, coefficients), V::Set32(32768)));
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Compute the R, G, B offsets of 4 pixel pairs from their (U,V) values (stored in 32-bit elements).
+    The fixed-point coefficients of the scalar implementation (FIX(1.402), FIX(-0.714) and FIX(1.772) do not fit
+    into 16 bits) are split into a multiple of 65536 and a 16-bit remainder, the result is identical:
+      R = Y + (( 91881*V + 32768) >> 16) = Y + V + (( 26345*V + 32768) >> 16)
+      G = Y + ((-22544*U - 46792*V + 32768) >> 16) = Y - V + ((-22544*U + 18744*V + 32768) >> 16)
+      B = Y + ((116129*U + 32768) >> 16) = Y + 2U + ((-14943*U + 32768) >> 16)
+  */
+  template <class V>
+  inline void ComputeChromaOffsets(typename V::Vec uv, typename V::Vec& r, typename V::Vec& g, typename V::Vec& b)
+  {
+    typename V::Vec u = V::template ShiftRightArithmetic32<16>(V::template ShiftLeft32<16>(uv));
+    typename V::Vec v = V::template ShiftRightArithmetic32<16>(uv);
+    r = V::Add32(v, ChromaProduct<V>(uv, 0, 26345));
+    g = V::Subtract32(ChromaProduct<V>(uv, -22544, 18744), v);
+    b = V::Add32(V::Add32(u, u), ChromaProduct<V>(uv, -14943, 0));
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Add the per-pair offsets to the luma of the pixels and saturate to 8 bits */
+  template <class V>
+  inline typename V::Vec ComputeComponent(typename V::Vec lumaLow, typename V::Vec lumaHigh, typename V::Vec offsetLow, typename V::Vec offsetHigh)
+  {
+    typename V::Vec pairOffsets = V::PackSignedSaturate32(offsetLow, offsetHigh);
+    return V::PackUnsignedSaturate16(V::Add16(lumaLow, V::UnpackLow16(pairOffsets, pairOffsets)), V::Add16(lumaHigh, V::UnpackHigh16(pairOffsets, pairOffsets)));
+  }
+
+  //----------------------------------------------------------------------------
+  template <class V>
+  int YUV422pToRGB24Kernel(int numberOfPixelPairs, bool outputBgr, const unsigned char* s, unsigned char* d)
+  {
+    static const ShuffleMasks<3, 3> masks(PlanarToRgb24SourceIndex);
+    const ShuffleVectors<V, 3, 3> toPacked(masks);
+
+    const int inputLaneStride = 2 * BYTES_PER_LANE;
+    const int outputLaneStride = 3 * BYTES_PER_LANE;
+    const int pairsPerBlock = PIXELS_PER_LANE / 2 * V::NumberOfLanes;
+    const int numberOfBlocks = numberOfPixelPairs / pairsPerBlock;
+    const typename V::Vec lowByteMask = V::Set16(0x00FF);
+
+    typename V::Vec planes[3];
+    typename V::Vec outputs[3];
+    for (int block = 0; block < numberOfBlocks; ++block)
+    {
+      // Y0 U0 Y1 V0 Y2 U1 Y3 V1 ...
+      typename V::Vec low = V::Load(s, inputLaneStride);
+      typename V::Vec high = V::Load(s + BYTES_PER_LANE, inputLaneStride);
+
+      typename V::Vec lumaLow = ConvertLuma<V>(V::And(low, lowByteMask));
+      typename V::Vec lumaHigh = ConvertLuma<V>(V::And(high, lowByteMask));
+      typename V::Vec uvLow = ConvertChroma<V>(V::template ShiftRightLogical16<8>(low));
+      typename V::Vec uvHigh = ConvertChroma<V>(V::template ShiftRightLogical16<8>(high));
+
+      typename V::Vec rLow, gLow, bLow, rHigh, gHigh, bHigh;
+      ComputeChromaOffsets<V>(uvLow, rLow, gLow, bLow);
+      ComputeChromaOffsets<V>(uvHigh, rHigh, gHigh, bHigh);
+
+      typename V::Vec r = ComputeComponent<V>(lumaLow, lumaHigh, rLow, rHigh);
+      typename V::Vec g = ComputeComponent<V>(lumaLow, lumaHigh, gLow, gHigh);
+      typename V::Vec b = ComputeComponent<V>(lumaLow, lumaHigh, bLow, bHigh);
+      planes[0] = outputBgr ? b : r;
+      planes[1] = g;
+      planes[2] = outputBgr ? r : b;
+
+      toPacked.Apply(planes, outputs);
+      for (int output = 0; output < 3; ++output)
+      {
+        V::Store(d + output * BYTES_PER_LANE, outputLaneStride, outputs[output]);
+      }
+      s += inputLaneStride * V::NumberOfLanes;
+      d += outputLaneStride * V::NumberOfLanes;
+    }
+    return numberOfBlocks * pairsPerBlock;
+  }
+
+  //----------------------------------------------------------------------------
+  template <class V>
+  int RGBToBGRKernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    return ShuffleKernel<V, 3, 3, RgbToBgrSourceIndex>(numberOfPixels, s, d);
+  }
+
+  //----------------------------------------------------------------------------
+  template <class V>
+  int BGRA32ToRGB24Kernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    return ShuffleKernel<V, 4, 3, BgraToRgbSourceIndex>(numberOfPixels, s, d);
+  }
+
+  //----------------------------------------------------------------------------
+  template <class V>
+  int RGBA32ToRGB24Kernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    return ShuffleKernel<V, 4, 3, RgbaToRgbSourceIndex>(numberOfPixels, s, d);
+  }
+
+  //----------------------------------------------------------------------------
+  template <class V>
+  int RGB24ToGrayKernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    return GrayKernel<V, 3, Rgb24ToPlanarSourceIndex>(numberOfPixels, s, d);
+  }
+
+  //----------------------------------------------------------------------------
+  template <class V>
+  int RGBA32ToGrayKernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    return GrayKernel<V, 4, Rgba32ToPlanarSourceIndex>(numberOfPixels, s, d);
+  }
+
+  //----------------------------------------------------------------------------
+  template <class V>
+  const PixelCodecKernelTable* GetKernelTable()
+  {
+    static const PixelCodecKernelTable table =
+    {
+      RGBToBGRKernel<V>,
+      BGRA32ToRGB24Kernel<V>,
+      RGBA32ToRGB24Kernel<V>,
+      RGB24ToGrayKernel<V>,
+      RGBA32ToGrayKernel<V>,
+      YUV422pToRGB24Kernel<V>
+    };
+    return &table;
+  }
+}
@@ -0,0 +1,218 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// ARM NEON (Advanced SIMD) implementation of the vectorized pixel conversions.
+// The structured load/store instructions (de)interleave the pixel components, so no byte shuffles are needed.
+
+#include "PixelCodecKernels.h"
+
+#include <arm_neon.h>
+
+namespace
+{
+  const int PIXELS_PER_BLOCK = 16;
+
+  //----------------------------------------------------------------------------
+  int RGBToBGRKernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    const int numberOfBlocks = numberOfPixels / PIXELS_PER_BLOCK;
+    for (int block = 0; block < numberOfBlocks; ++block)
+    {
+      uint8x16x3_t input = vld3q_u8(s);
+      uint8x16x3_t output;
+      output.val[0] = input.val[2];
+      output.val[1] = input.val[1];
+      output.val[2] = input.val[0];
+      vst3q_u8(d, output);
+      s += 3 * PIXELS_PER_BLOCK;
+      d += 3 * PIXELS_PER_BLOCK;
+    }
+    return numberOfBlocks * PIXELS_PER_BLOCK;
+  }
+
+  //----------------------------------------------------------------------------
+  int BGRA32ToRGB24Kernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    const int numberOfBlocks = numberOfPixels / PIXELS_PER_BLOCK;
+    for (int block = 0; block < numberOfBlocks; ++block)
+    {
+      uint8x16x4_t input = vld4q_u8(s);
+      uint8x16x3_t output;
+      output.val[0] = input.val[2];
+      output.val[1] = input.val[1];
+      output.val[2] = input.val[0];
+      vst3q_u8(d, output);
+      s += 4 * PIXELS_PER_BLOCK;
+      d += 3 * PIXELS_PER_BLOCK;
+    }
+    return numberOfBlocks * PIXELS_PER_BLOCK;
+  }
+
+  //----------------------------------------------------------------------------
+  int RGBA32ToRGB24Kernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    const int numberOfBlocks = numberOfPixels / PIXELS_PER_BLOCK;
+    for (int block = 0; block < numberOfBlocks; ++block)
+    {
+      uint8x16x4_t input = vld4q_u8(s);
+      uint8x16x3_t output;
+      output.val[0] = input.val[0];
+      output.val[1] = input.val[1];
+      output.val[2] = input.val[2];
+      vst3q_u8(d, output);
+      s += 4 * PIXELS_PER_BLOCK;
+      d += 3 * PIXELS_PER_BLOCK;
+    }
+    return numberOfBlocks * PIXELS_PER_BLOCK;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Compute (r+g+b)/3 of 8 pixels. x/3 == (x*0xAAAB)>>17 for all x <= 765. */
+  inline uint8x8_t Average3(uint8x8_t r, uint8x8_t g, uint8x8_t b)
+  {
+    uint16x8_t sum = vaddw_u8(vaddl_u8(r, g), b);
+    uint32x4_t productLow = vmull_n_u16(vget_low_u16(sum), 0xAAAB);
+    uint32x4_t productHigh = vmull_n_u16(vget_high_u16(sum), 0xAAAB);
+    return vmovn_u16(vshrq_n_u16(vcombine_u16(vshrn_n_u32(productLow, 16), vshrn_n_u32(productHigh, 16)), 1));
+  }
+
+  //----------------------------------------------------------------------------
+  inline uint8x16_t Average3(uint8x16_t r, uint8x16_t g, uint8x16_t b)
+  {
+    return vcombine_u8(Average3(vget_low_u8(r), vget_low_u8(g), vget_low_u8(b)), Average3(vget_high_u8(r), vget_high_u8(g), vget_high_u8(b)));
+  }
+
+  //----------------------------------------------------------------------------
+  int RGB24ToGrayKernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    const int numberOfBlocks = numberOfPixels / PIXELS_PER_BLOCK;
+    for (int block = 0; block < numberOfBlocks; ++block)
+    {
+      uint8x16x3_t input = vld3q_u8(s);
+      vst1q_u8(d, Average3(input.val[0], input.val[1], input.val[2]));
+      s += 3 * PIXELS_PER_BLOCK;
+      d += PIXELS_PER_BLOCK;
+    }
+    return numberOfBlocks * PIXELS_PER_BLOCK;
+  }
+
+  //----------------------------------------------------------------------------
+  int RGBA32ToGrayKernel(int numberOfPixels, const unsigned char* s, unsigned char* d)
+  {
+    const int numberOfBlocks = numberOfPixels / PIXELS_PER_BLOCK;
+    for (int block = 0; block < numberOfBlocks; ++block)
+    {
+      uint8x16x4_t input = vld4q_u8(s);
+      vst1q_u8(d, Average3(input.val[0], input.val[1], input.val[2]));
+      s += 4 * PIXELS_PER_BLOCK;
+      d += PIXELS_PER_BLOCK;
+    }
+    return numberOfBlocks * PIXELS_PER_BLOCK;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns the sign of diff applied to (|diff| << shift) * multiplier >> (16 + postShift), i.e., a division truncated towards zero */
+  template <int Shift, int PostShift>
+  inline int16x8_t DivideTruncate(int16x8_t diff, uint16_t multiplier)
+  {
+    uint16x8_t magnitude = vshlq_n_u16(vreinterpretq_u16_s16(vabsq_s16(diff)), Shift);
+    uint32x4_t productLow = vmull_n_u16(vget_low_u16(magnitude), multiplier);
+    uint32x4_t productHigh = vmull_n_u16(vget_high_u16(magnitude), multiplier);
+    uint16x8_t product = vcombine_u16(vshrn_n_u32(productLow, 16), vshrn_n_u32(productHigh, 16));
+    // shift by a negative amount is a right shift (immediate shifts do not allow a zero shift amount)
+    int16x8_t quotient = vreinterpretq_s16_u16(vshlq_u16(product, vdupq_n_s16(-PostShift)));
+    return vbslq_s16(vcltq_s16(diff, vdupq_n_s16(0)), vnegq_s16(quotient), quotient);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! ICCIRY: ((y-16)<<8)/219. floor(m/219) == ((m*38305)>>16)>>7 for all m <= 61184. */
+  inline int16x8_t ConvertLuma(uint8x8_t y)
+  {
+    return DivideTruncate<8, 7>(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(y)), vdupq_n_s16(16)), 38305);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! ICCIRUV: ((c-128)<<8)/224. floor(8m/7) == (8m*9363)>>16 for all m <= 128. */
+  inline int16x8_t ConvertChroma(uint8x8_t c)
+  {
+    return DivideTruncate<3, 0>(vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(c)), vdupq_n_s16(128)), 9363);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns (product + 32768) >> 16 for 8 products */
+  inline int16x8_t RoundProduct(int32x4_t productLow, int32x4_t productHigh)
+  {
+    const int32x4_t half = vdupq_n_s32(32768);
+    return vcombine_s16(vshrn_n_s32(vaddq_s32(productLow, half), 16), vshrn_n_s32(vaddq_s32(productHigh, half), 16));
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Convert 8 pixel pairs. The fixed-point coefficients of the scalar implementation that do not fit into
+    16 bits are split into a multiple of 65536 and a 16-bit remainder, the result is identical
+    (see PixelCodecKernels.txx for details).
+  */
+  inline void ConvertPixelPairs(uint8x8_t y0, uint8x8_t u, uint8x8_t y1, uint8x8_t v, bool outputBgr, uint8x16_t& first, uint8x16_t& green, uint8x16_t& third)
+  {
+    int16x8_t luma0 = ConvertLuma(y0);
+    int16x8_t luma1 = ConvertLuma(y1);
+    int16x8_t uc = ConvertChroma(u);
+    int16x8_t vc = ConvertChroma(v);
+
+    int16x8_t rOffset = vaddq_s16(vc, RoundProduct(vmull_n_s16(vget_low_s16(vc), 26345), vmull_n_s16(vget_high_s16(vc), 26345)));
+    int16x8_t gOffset = vsubq_s16(RoundProduct(
+                                    vmlal_n_s16(vmull_n_s16(vget_low_s16(uc), -22544), vget_low_s16(vc), 18744),
+                                    vmlal_n_s16(vmull_n_s16(vget_high_s16(uc), -22544), vget_high_s16(vc), 18744)), vc);
+    int16x8_t bOffset = vaddq_s16(vaddq_s16(uc, uc), RoundProduct(vmull_n_s16(vget_low_s16(uc), -14943), vmull_n_s16(vget_high_s16(uc), -14943)));
+
+    uint8x8x2_t r = vzip_u8(vqmovun_s16(vaddq_s16(luma0, rOffset)), vqmovun_s16(vaddq_s16(luma1, rOffset)));
+    uint8x8x2_t g = vzip_u8(vqmovun_s16(vaddq_s16(luma0, gOffset)), vqmovun_s16(vaddq_s16(luma1, gOffset)));
+    uint8x8x2_t b = vzip_u8(vqmovun_s16(vaddq_s16(luma0, bOffset)), vqmovun_s16(vaddq_s16(luma1, bOffset)));
+
+    uint8x16_t red = vcombine_u8(r.val[0], r.val[1]);
+    uint8x16_t blue = vcombine_u8(b.val[0], b.val[1]);
+    first = outputBgr ? blue : red;
+    green = vcombine_u8(g.val[0], g.val[1]);
+    third = outputBgr ? red : blue;
+  }
+
+  //----------------------------------------------------------------------------
+  int YUV422pToRGB24Kernel(int numberOfPixelPairs, bool outputBgr, const unsigned char* s, unsigned char* d)
+  {
+    const int pairsPerBlock = 16;
+    const int numberOfBlocks = numberOfPixelPairs / pairsPerBlock;
+    for (int block = 0; block < numberOfBlocks; ++block)
+    {
+      // Y0 U0 Y1 V0 Y2 U1 Y3 V1 ...
+      uint8x16x4_t input = vld4q_u8(s);
+      uint8x16x3_t output;
+      ConvertPixelPairs(vget_low_u8(input.val[0]), vget_low_u8(input.val[1]), vget_low_u8(input.val[2]), vget_low_u8(input.val[3]), outputBgr,
+                        output.val[0], output.val[1], output.val[2]);
+      vst3q_u8(d, output);
+      ConvertPixelPairs(vget_high_u8(input.val[0]), vget_high_u8(input.val[1]), vget_high_u8(input.val[2]), vget_high_u8(input.val[3]), outputBgr,
+                        output.val[0], output.val[1], output.val[2]);
+      vst3q_u8(d + 48, output);
+      s += 4 * pairsPerBlock;
+      d += 6 * pairsPerBlock;
+    }
+    return numberOfBlocks * pairsPerBlock;
+  }
+}
+
+//----------------------------------------------------------------------------
+const PixelCodecKernelTable* GetPixelCodecKernelsNEON()
+{
+  static const PixelCodecKernelTable table =
+  {
+    RGBToBGRKernel,
+    BGRA32ToRGB24Kernel,
+    RGBA32ToRGB24Kernel,
+    RGB24ToGrayKernel,
+    RGBA32ToGrayKernel,
+    YUV422pToRGB24Kernel
+  };
+  return &table;
+}
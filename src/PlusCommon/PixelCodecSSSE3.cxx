@@ -0,0 +1,56 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// This file is compiled with SSSE3 code generation enabled, it must only be called if the CPU supports SSSE3
+
+#include <tmmintrin.h>
+
+#include "PixelCodecKernels.txx"
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*! SSSE3 intrinsics used by the pixel conversion kernels */
+  struct SSSE3Vector
+  {
+    typedef __m128i Vec;
+    static const int NumberOfLanes = 1;
+
+    static inline Vec Load(const unsigned char* p, int /*laneStride*/) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+    static inline void Store(unsigned char* p, int /*laneStride*/, Vec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+    static inline Vec LoadMask(const signed char* mask) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask)); }
+    static inline Vec Shuffle(Vec v, Vec mask) { return _mm_shuffle_epi8(v, mask); }
+    static inline Vec Zero() { return _mm_setzero_si128(); }
+    static inline Vec Set16(short value) { return _mm_set1_epi16(value); }
+    static inline Vec Set32(int value) { return _mm_set1_epi32(value); }
+    static inline Vec And(Vec a, Vec b) { return _mm_and_si128(a, b); }
+    static inline Vec Or(Vec a, Vec b) { return _mm_or_si128(a, b); }
+    static inline Vec Add16(Vec a, Vec b) { return _mm_add_epi16(a, b); }
+    static inline Vec Subtract16(Vec a, Vec b) { return _mm_sub_epi16(a, b); }
+    static inline Vec Add32(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+    static inline Vec Subtract32(Vec a, Vec b) { return _mm_sub_epi32(a, b); }
+    static inline Vec Abs16(Vec a) { return _mm_abs_epi16(a); }
+    static inline Vec Sign16(Vec a, Vec sign) { return _mm_sign_epi16(a, sign); }
+    static inline Vec MultiplyHighUnsigned16(Vec a, Vec b) { return _mm_mulhi_epu16(a, b); }
+    static inline Vec MultiplyAdd16(Vec a, Vec b) { return _mm_madd_epi16(a, b); }
+    template <int Shift> static inline Vec ShiftLeft16(Vec a) { return _mm_slli_epi16(a, Shift); }
+    template <int Shift> static inline Vec ShiftRightLogical16(Vec a) { return _mm_srli_epi16(a, Shift); }
+    template <int Shift> static inline Vec ShiftLeft32(Vec a) { return _mm_slli_epi32(a, Shift); }
+    template <int Shift> static inline Vec ShiftRightArithmetic32(Vec a) { return _mm_srai_epi32(a, Shift); }
+    static inline Vec UnpackLow8(Vec a, Vec b) { return _mm_unpacklo_epi8(a, b); }
+    static inline Vec UnpackHigh8(Vec a, Vec b) { return _mm_unpackhi_epi8(a, b); }
+    static inline Vec UnpackLow16(Vec a, Vec b) { return _mm_unpacklo_epi16(a, b); }
+    static inline Vec UnpackHigh16(Vec a, Vec b) { return _mm_unpackhi_epi16(a, b); }
+    static inline Vec PackSignedSaturate32(Vec a, Vec b) { return _mm_packs_epi32(a, b); }
+    static inline Vec PackUnsignedSaturate16(Vec a, Vec b) { return _mm_packus_epi16(a, b); }
+  };
+}
+
+//----------------------------------------------------------------------------
+const PixelCodecKernelTable* GetPixelCodecKernelsSSSE3()
+{
+  return GetKernelTable<SSSE3Vector>();
+}
@@ -0,0 +1,396 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusParallelDeflate.h"
+
+// VTK includes
+#include <vtk_zlib.h>
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+
+const size_t PlusParallelDeflate::DEFAULT_CHUNK_SIZE_BYTES = 1024 * 1024;
+
+namespace
+{
+  const size_t MIN_CHUNK_SIZE_BYTES = 64 * 1024;
+  const int DEFLATE_MEMORY_LEVEL = 8;
+}
+
+//----------------------------------------------------------------------------
+PlusParallelDeflate::PlusParallelDeflate(std::ostream& output, ContainerType container, CompressionMethodType compressionMethod /*= COMPRESSION_DEFAULT*/,
+    int numberOfThreads /*= 0*/, size_t chunkSizeBytes /*= DEFAULT_CHUNK_SIZE_BYTES*/)
+  : Output(output)
+  , Container(container)
+  , CompressionLevel(Z_DEFAULT_COMPRESSION)
+  , CompressionStrategy(Z_DEFAULT_STRATEGY)
+  , NumberOfThreads(numberOfThreads)
+  , ChunkSizeBytes(std::max(chunkSizeBytes, MIN_CHUNK_SIZE_BYTES))
+  , CurrentChunk(new Chunk)
+  , CombinedChecksum(0)
+  , UncompressedSizeInBytes(0)
+  , CompressedSizeInBytes(0)
+  , HeaderWritten(false)
+  , Finished(false)
+  , OutputStatus(PLUS_SUCCESS)
+  , StopRequested(false)
+{
+  switch (compressionMethod)
+  {
+    case COMPRESSION_FAST:
+      this->CompressionLevel = Z_BEST_SPEED;
+      break;
+    case COMPRESSION_RLE:
+      this->CompressionLevel = Z_BEST_SPEED;
+      this->CompressionStrategy = Z_RLE;
+      break;
+    case COMPRESSION_DEFAULT:
+    default:
+      break;
+  }
+
+  this->CombinedChecksum = (this->Container == CONTAINER_ZLIB ? adler32(0L, Z_NULL, 0) : crc32(0L, Z_NULL, 0));
+  this->CurrentChunk->Input.reserve(this->ChunkSizeBytes);
+
+  if (this->NumberOfThreads <= 0)
+  {
+    this->NumberOfThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+  if (this->NumberOfThreads > 1)
+  {
+    for (int i = 0; i < this->NumberOfThreads; ++i)
+    {
+      this->WorkerThreads.push_back(std::thread(&PlusParallelDeflate::WorkerThread, this));
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusParallelDeflate::~PlusParallelDeflate()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->QueueMutex);
+    this->StopRequested = true;
+  }
+  this->ChunkQueued.notify_all();
+  for (std::vector<std::thread>::iterator threadIt = this->WorkerThreads.begin(); threadIt != this->WorkerThreads.end(); ++threadIt)
+  {
+    threadIt->join();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::Write(const void* data, size_t sizeInBytes)
+{
+  if (this->Finished)
+  {
+    LOG_ERROR("PlusParallelDeflate::Write failed: compression is already finished");
+    return PLUS_FAIL;
+  }
+  if (!this->HeaderWritten && this->WriteHeader() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  const unsigned char* dataPtr = static_cast<const unsigned char*>(data);
+  while (sizeInBytes > 0)
+  {
+    size_t copiedSizeInBytes = std::min(sizeInBytes, this->ChunkSizeBytes - this->CurrentChunk->Input.size());
+    this->CurrentChunk->Input.insert(this->CurrentChunk->Input.end(), dataPtr, dataPtr + copiedSizeInBytes);
+    dataPtr += copiedSizeInBytes;
+    sizeInBytes -= copiedSizeInBytes;
+    this->UncompressedSizeInBytes += copiedSizeInBytes;
+    if (this->CurrentChunk->Input.size() >= this->ChunkSizeBytes && this->SubmitChunk(false) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+
+  return this->OutputStatus;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::Finish()
+{
+  if (this->Finished)
+  {
+    return this->OutputStatus;
+  }
+  if (!this->HeaderWritten && this->WriteHeader() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  // The last chunk is terminated by a final block, it is written even if it is empty
+  this->SubmitChunk(true);
+  this->WriteTrailer();
+  this->Output.flush();
+  this->Finished = true;
+
+  return this->OutputStatus;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::SubmitChunk(bool isLast)
+{
+  std::shared_ptr<Chunk> chunk = this->CurrentChunk;
+  chunk->IsLast = isLast;
+  this->CurrentChunk = std::shared_ptr<Chunk>(new Chunk);
+  if (!isLast)
+  {
+    this->CurrentChunk->Input.reserve(this->ChunkSizeBytes);
+  }
+
+  if (this->WorkerThreads.empty())
+  {
+    this->CompressChunk(*chunk);
+    chunk->IsCompressed = true;
+    std::lock_guard<std::mutex> lock(this->QueueMutex);
+    this->Chunks.push_back(chunk);
+  }
+  else
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->QueueMutex);
+      this->Chunks.push_back(chunk);
+      this->PendingChunks.push_back(chunk);
+    }
+    this->ChunkQueued.notify_one();
+  }
+
+  return this->WriteCompressedChunks(isLast);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::WriteCompressedChunks(bool waitForAll)
+{
+  // Limit the number of chunks in memory: wait for the oldest one if all the workers have a chunk queued
+  const size_t maxNumberOfQueuedChunks = 2 * static_cast<size_t>(this->NumberOfThreads);
+  while (true)
+  {
+    std::shared_ptr<Chunk> chunk;
+    {
+      std::unique_lock<std::mutex> lock(this->QueueMutex);
+      if (this->Chunks.empty())
+      {
+        break;
+      }
+      if (!this->Chunks.front()->IsCompressed)
+      {
+        if (!waitForAll && this->Chunks.size() <= maxNumberOfQueuedChunks)
+        {
+          break;
+        }
+        this->ChunkCompressed.wait(lock, [this]()
+        {
+          return this->Chunks.front()->IsCompressed;
+        });
+      }
+      chunk = this->Chunks.front();
+      this->Chunks.pop_front();
+    }
+
+    if (chunk->Status != PLUS_SUCCESS)
+    {
+      LOG_ERROR("PlusParallelDeflate: failed to compress data");
+      this->OutputStatus = PLUS_FAIL;
+      continue;
+    }
+
+    // Checksums of the chunks are combined in the same order as the data is written
+    if (this->Container == CONTAINER_ZLIB)
+    {
+      this->CombinedChecksum = adler32_combine(this->CombinedChecksum, chunk->Checksum, static_cast<z_off_t>(chunk->InputSizeInBytes));
+    }
+    else
+    {
+      this->CombinedChecksum = crc32_combine(this->CombinedChecksum, chunk->Checksum, static_cast<z_off_t>(chunk->InputSizeInBytes));
+    }
+    if (!chunk->Output.empty())
+    {
+      this->WriteToOutput(&chunk->Output[0], chunk->Output.size());
+    }
+  }
+
+  return this->OutputStatus;
+}
+
+//----------------------------------------------------------------------------
+void PlusParallelDeflate::CompressChunk(Chunk& chunk) const
+{
+  chunk.InputSizeInBytes = chunk.Input.size();
+  Bytef* inputPtr = (chunk.Input.empty() ? Z_NULL : reinterpret_cast<Bytef*>(&chunk.Input[0]));
+  if (this->Container == CONTAINER_ZLIB)
+  {
+    chunk.Checksum = adler32(adler32(0L, Z_NULL, 0), inputPtr, static_cast<uInt>(chunk.InputSizeInBytes));
+  }
+  else
+  {
+    chunk.Checksum = crc32(crc32(0L, Z_NULL, 0), inputPtr, static_cast<uInt>(chunk.InputSizeInBytes));
+  }
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  // Negative window bits: raw deflate data, the header and trailer of the whole stream are written separately
+  if (deflateInit2(&stream, this->CompressionLevel, Z_DEFLATED, -MAX_WBITS, DEFLATE_MEMORY_LEVEL, this->CompressionStrategy) != Z_OK)
+  {
+    chunk.Status = PLUS_FAIL;
+    return;
+  }
+
+  // A sync flush appends an empty stored block (at most 5 bytes + bit padding) to the compressed data
+  chunk.Output.resize(deflateBound(&stream, static_cast<uLong>(chunk.InputSizeInBytes)) + 16);
+  stream.next_in = inputPtr;
+  stream.avail_in = static_cast<uInt>(chunk.InputSizeInBytes);
+  stream.next_out = reinterpret_cast<Bytef*>(&chunk.Output[0]);
+  stream.avail_out = static_cast<uInt>(chunk.Output.size());
+
+  // Non-final chunks end at a byte boundary, so they can be concatenated
+  int result = deflate(&stream, chunk.IsLast ? Z_FINISH : Z_SYNC_FLUSH);
+  bool success = (chunk.IsLast ? result == Z_STREAM_END : result == Z_OK) && stream.avail_in == 0;
+  chunk.Output.resize(stream.total_out);
+  deflateEnd(&stream);
+
+  chunk.Status = (success ? PLUS_SUCCESS : PLUS_FAIL);
+  // Input is not needed anymore, release the memory before the chunk is written
+  std::vector<unsigned char>().swap(chunk.Input);
+}
+
+//----------------------------------------------------------------------------
+void PlusParallelDeflate::WorkerThread()
+{
+  std::unique_lock<std::mutex> lock(this->QueueMutex);
+  while (true)
+  {
+    this->ChunkQueued.wait(lock, [this]()
+    {
+      return this->StopRequested || !this->PendingChunks.empty();
+    });
+    if (this->PendingChunks.empty())
+    {
+      // stop requested and there is nothing left to compress
+      break;
+    }
+
+    std::shared_ptr<Chunk> chunk = this->PendingChunks.front();
+    this->PendingChunks.pop_front();
+    lock.unlock();
+
+    this->CompressChunk(*chunk);
+
+    lock.lock();
+    chunk->IsCompressed = true;
+    this->ChunkCompressed.notify_all();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::WriteHeader()
+{
+  this->HeaderWritten = true;
+  if (this->Container == CONTAINER_ZLIB)
+  {
+    // RFC 1950: deflate method with 32K window, compression level hint, header checksum is a multiple of 31
+    unsigned char header[2] = { 0x78, 0 };
+    int levelHint = 2;
+    if (this->CompressionLevel == Z_BEST_SPEED || this->CompressionStrategy == Z_RLE)
+    {
+      levelHint = 0;
+    }
+    header[1] = static_cast<unsigned char>(levelHint << 6);
+    header[1] = static_cast<unsigned char>(header[1] + 31 - (header[0] * 256 + header[1]) % 31);
+    return this->WriteToOutput(header, sizeof(header));
+  }
+
+  // RFC 1952: no file name, modification time and flags, unknown operating system
+  unsigned char header[10] = { 0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 0xff };
+  if (this->CompressionLevel == Z_BEST_SPEED)
+  {
+    header[8] = 4;
+  }
+  return this->WriteToOutput(header, sizeof(header));
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::WriteTrailer()
+{
+  unsigned char trailer[8] = { 0 };
+  if (this->Container == CONTAINER_ZLIB)
+  {
+    // Adler-32 checksum, most significant byte first
+    for (int i = 0; i < 4; ++i)
+    {
+      trailer[i] = static_cast<unsigned char>((this->CombinedChecksum >> (24 - 8 * i)) & 0xff);
+    }
+    return this->WriteToOutput(trailer, 4);
+  }
+
+  // CRC-32 and input size modulo 2^32, least significant byte first
+  for (int i = 0; i < 4; ++i)
+  {
+    trailer[i] = static_cast<unsigned char>((this->CombinedChecksum >> (8 * i)) & 0xff);
+    trailer[4 + i] = static_cast<unsigned char>((this->UncompressedSizeInBytes >> (8 * i)) & 0xff);
+  }
+  return this->WriteToOutput(trailer, 8);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::WriteToOutput(const unsigned char* data, size_t sizeInBytes)
+{
+  this->Output.write(reinterpret_cast<const char*>(data), sizeInBytes);
+  if (!this->Output)
+  {
+    if (this->OutputStatus == PLUS_SUCCESS)
+    {
+      LOG_ERROR("PlusParallelDeflate: failed to write compressed data");
+    }
+    this->OutputStatus = PLUS_FAIL;
+    return PLUS_FAIL;
+  }
+  this->CompressedSizeInBytes += sizeInBytes;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusParallelDeflate::GetCompressionMethodAsString(CompressionMethodType compressionMethod)
+{
+  switch (compressionMethod)
+  {
+    case COMPRESSION_FAST:
+      return "FAST";
+    case COMPRESSION_RLE:
+      return "RLE";
+    case COMPRESSION_DEFAULT:
+    default:
+      return "DEFAULT";
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusParallelDeflate::GetCompressionMethodFromString(const std::string& compressionMethodString, CompressionMethodType& compressionMethod)
+{
+  if (igsioCommon::IsEqualInsensitive(compressionMethodString, "DEFAULT"))
+  {
+    compressionMethod = COMPRESSION_DEFAULT;
+  }
+  else if (igsioCommon::IsEqualInsensitive(compressionMethodString, "FAST"))
+  {
+    compressionMethod = COMPRESSION_FAST;
+  }
+  else if (igsioCommon::IsEqualInsensitive(compressionMethodString, "RLE"))
+  {
+    compressionMethod = COMPRESSION_RLE;
+  }
+  else
+  {
+    LOG_ERROR("Unknown compression method: " << compressionMethodString << ". Valid values: DEFAULT, FAST, RLE.");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
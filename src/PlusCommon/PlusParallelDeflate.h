@@ -0,0 +1,146 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusParallelDeflate_h
+#define __PlusParallelDeflate_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+// STL includes
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+\class PlusParallelDeflate
+\brief Streaming deflate compressor that compresses chunks of the input on multiple threads
+
+The input is split into fixed size chunks that are compressed independently on a pool of worker threads
+and written to the output stream in order. Each chunk is terminated by a sync flush, so the concatenated
+chunks form a single deflate stream, and the checksums of the chunks are combined. The output is therefore
+a standard zlib (as used by compressed MetaImage files) or gzip (as used by NRRD gzip encoding) stream that
+can be decompressed by any reader.
+
+Faster compression methods trade compression ratio for speed: COMPRESSION_FAST uses the fastest deflate
+level, COMPRESSION_RLE only encodes runs of identical bytes, which is very fast for the large black areas
+of B-mode images.
+
+\ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport PlusParallelDeflate
+{
+public:
+  enum ContainerType
+  {
+    CONTAINER_ZLIB,
+    CONTAINER_GZIP
+  };
+
+  enum CompressionMethodType
+  {
+    /*! Default zlib compression level (same as the single-threaded sequence writers) */
+    COMPRESSION_DEFAULT,
+    /*! Fastest zlib compression level */
+    COMPRESSION_FAST,
+    /*! Run-length encoding only, fastest with lowest compression ratio */
+    COMPRESSION_RLE
+  };
+
+  /*!
+    Create a compressor that writes to the output stream.
+    If numberOfThreads is 0 then the number of hardware threads is used. If it is 1 then chunks are compressed on the calling thread.
+  */
+  PlusParallelDeflate(std::ostream& output, ContainerType container, CompressionMethodType compressionMethod = COMPRESSION_DEFAULT, int numberOfThreads = 0, size_t chunkSizeBytes = DEFAULT_CHUNK_SIZE_BYTES);
+  ~PlusParallelDeflate();
+
+  /*! Add data to be compressed. Completed chunks are written to the output stream. */
+  PlusStatus Write(const void* data, size_t sizeInBytes);
+
+  /*! Compress the remaining data, write the stream trailer and wait until everything is written. No data can be added after this. */
+  PlusStatus Finish();
+
+  /*! Number of input bytes added so far */
+  unsigned long long GetUncompressedSizeInBytes() const { return this->UncompressedSizeInBytes; }
+
+  /*! Number of bytes written to the output stream so far (including header and trailer) */
+  unsigned long long GetCompressedSizeInBytes() const { return this->CompressedSizeInBytes; }
+
+  int GetNumberOfThreads() const { return this->NumberOfThreads; }
+
+  static std::string GetCompressionMethodAsString(CompressionMethodType compressionMethod);
+  static PlusStatus GetCompressionMethodFromString(const std::string& compressionMethodString, CompressionMethodType& compressionMethod);
+
+  static const size_t DEFAULT_CHUNK_SIZE_BYTES;
+
+protected:
+  /*! Part of the input, compressed independently of the other chunks */
+  struct Chunk
+  {
+    Chunk() : InputSizeInBytes(0), Checksum(0), IsLast(false), IsCompressed(false), Status(PLUS_SUCCESS) {}
+    std::vector<unsigned char> Input;
+    std::vector<unsigned char> Output;
+    /*! Size of the input, kept after the input is released */
+    size_t InputSizeInBytes;
+    unsigned long Checksum;
+    bool IsLast;
+    bool IsCompressed;
+    PlusStatus Status;
+  };
+
+  /*! Compress the chunk into a raw deflate block sequence and compute the checksum of its input */
+  void CompressChunk(Chunk& chunk) const;
+
+  /*! Hand over the current input chunk for compression, write completed chunks */
+  PlusStatus SubmitChunk(bool isLast);
+
+  /*! Write the completed chunks from the beginning of the queue, wait for them if waitForAll is true or the queue is full */
+  PlusStatus WriteCompressedChunks(bool waitForAll);
+
+  PlusStatus WriteHeader();
+  PlusStatus WriteTrailer();
+  PlusStatus WriteToOutput(const unsigned char* data, size_t sizeInBytes);
+
+  void WorkerThread();
+
+  std::ostream& Output;
+  ContainerType Container;
+  int CompressionLevel;
+  int CompressionStrategy;
+  int NumberOfThreads;
+  size_t ChunkSizeBytes;
+
+  std::shared_ptr<Chunk> CurrentChunk;
+  unsigned long CombinedChecksum;
+  unsigned long long UncompressedSizeInBytes;
+  unsigned long long CompressedSizeInBytes;
+  bool HeaderWritten;
+  bool Finished;
+  PlusStatus OutputStatus;
+
+  /*! Members below are protected by QueueMutex */
+  std::mutex QueueMutex;
+  std::condition_variable ChunkQueued;
+  std::condition_variable ChunkCompressed;
+  /*! Chunks in output order, until they are written */
+  std::deque<std::shared_ptr<Chunk> > Chunks;
+  /*! Chunks waiting for a worker thread */
+  std::deque<std::shared_ptr<Chunk> > PendingChunks;
+  bool StopRequested;
+
+  std::vector<std::thread> WorkerThreads;
+
+private:
+  PlusParallelDeflate(const PlusParallelDeflate&);
+  void operator=(const PlusParallelDeflate&);
+};
+
+#endif
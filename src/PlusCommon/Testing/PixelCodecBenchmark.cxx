@@ -0,0 +1,223 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PixelCodecBenchmark.cxx
+  \brief Verifies that the vectorized PixelCodec conversions are identical to the scalar implementation and measures their throughput
+
+  All instruction sets that are supported by the CPU are compared to the scalar implementation on random data
+  (including image sizes that are not multiples of the vector block size). Then the throughput of each
+  conversion is reported in megapixels per second for common frame sizes.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PixelCodec.h"
+#include "vtkIGSIOAccurateTimer.h"
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+  enum ConversionType
+  {
+    CONVERSION_RGBToBGR,
+    CONVERSION_BGRA32ToRGB24,
+    CONVERSION_RGBA32ToRGB24,
+    CONVERSION_RGB24ToGray,
+    CONVERSION_RGBA32ToGray,
+    CONVERSION_YUV422pToRGB24,
+    CONVERSION_YUV422pToBGR24,
+    NUMBER_OF_CONVERSIONS
+  };
+
+  const char* CONVERSION_NAMES[NUMBER_OF_CONVERSIONS] =
+  {
+    "RGBToBGR", "BGRA32ToRGB24", "RGBA32ToRGB24", "RGB24ToGray", "RGBA32ToGray", "YUV422pToRGB24", "YUV422pToBGR24"
+  };
+
+  //----------------------------------------------------------------------------
+  int GetOutputBytesPerPixel(ConversionType conversion)
+  {
+    return (conversion == CONVERSION_RGB24ToGray || conversion == CONVERSION_RGBA32ToGray) ? 1 : 3;
+  }
+
+  //----------------------------------------------------------------------------
+  void Convert(ConversionType conversion, int width, int height, unsigned char* s, unsigned char* d)
+  {
+    switch (conversion)
+    {
+      case CONVERSION_RGBToBGR:
+        PixelCodec::RGBToBGR(width, height, s, d);
+        break;
+      case CONVERSION_BGRA32ToRGB24:
+        PixelCodec::BGRA32ToRGB24(width, height, s, d);
+        break;
+      case CONVERSION_RGBA32ToRGB24:
+        PixelCodec::RGBA32ToRGB24(width, height, s, d);
+        break;
+      case CONVERSION_RGB24ToGray:
+        PixelCodec::RGB24ToGray(width, height, s, d);
+        break;
+      case CONVERSION_RGBA32ToGray:
+        PixelCodec::RGBA32ToGray(width, height, s, d);
+        break;
+      case CONVERSION_YUV422pToRGB24:
+        PixelCodec::YUV422pToRGB24(PixelCodec::ComponentOrder_RGB, width, height, s, d);
+        break;
+      case CONVERSION_YUV422pToBGR24:
+        PixelCodec::YUV422pToRGB24(PixelCodec::ComponentOrder_BGR, width, height, s, d);
+        break;
+      default:
+        LOG_ERROR("Unknown conversion: " << conversion);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  std::vector<PixelCodec::InstructionSet> GetSupportedInstructionSets()
+  {
+    std::vector<PixelCodec::InstructionSet> instructionSets;
+    const PixelCodec::InstructionSet candidates[] = { PixelCodec::InstructionSet_Scalar, PixelCodec::InstructionSet_SSSE3, PixelCodec::InstructionSet_AVX2, PixelCodec::InstructionSet_NEON };
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(candidates[0]); ++i)
+    {
+      if (PixelCodec::IsInstructionSetSupported(candidates[i]))
+      {
+        instructionSets.push_back(candidates[i]);
+      }
+    }
+    return instructionSets;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CompareToScalar(const std::vector<PixelCodec::InstructionSet>& instructionSets)
+  {
+    // Sizes are chosen so that the number of pixels is smaller than, equal to, and not a multiple of the vector block sizes
+    const int sizes[][2] = { {1, 1}, {2, 1}, {15, 1}, {16, 2}, {33, 7}, {64, 3}, {127, 5}, {640, 480} };
+    PlusStatus status = PLUS_SUCCESS;
+    for (size_t sizeIndex = 0; sizeIndex < sizeof(sizes) / sizeof(sizes[0]); ++sizeIndex)
+    {
+      const int width = sizes[sizeIndex][0];
+      const int height = sizes[sizeIndex][1];
+      std::vector<unsigned char> input(width * height * 4);
+      for (size_t i = 0; i < input.size(); ++i)
+      {
+        input[i] = static_cast<unsigned char>(rand() % 256);
+      }
+      for (int conversion = 0; conversion < NUMBER_OF_CONVERSIONS; ++conversion)
+      {
+        const size_t outputSize = width * height * GetOutputBytesPerPixel(static_cast<ConversionType>(conversion));
+        std::vector<unsigned char> expectedOutput(outputSize, 0);
+        PixelCodec::SetInstructionSet(PixelCodec::InstructionSet_Scalar);
+        Convert(static_cast<ConversionType>(conversion), width, height, &input[0], &expectedOutput[0]);
+        for (std::vector<PixelCodec::InstructionSet>::const_iterator it = instructionSets.begin(); it != instructionSets.end(); ++it)
+        {
+          std::vector<unsigned char> output(outputSize, 0);
+          PixelCodec::SetInstructionSet(*it);
+          Convert(static_cast<ConversionType>(conversion), width, height, &input[0], &output[0]);
+          if (output != expectedOutput)
+          {
+            LOG_ERROR(CONVERSION_NAMES[conversion] << " output of " << PixelCodec::GetInstructionSetAsString(*it)
+                      << " implementation differs from the scalar implementation for image size " << width << "x" << height);
+            status = PLUS_FAIL;
+          }
+        }
+      }
+    }
+    return status;
+  }
+
+  //----------------------------------------------------------------------------
+  void MeasureThroughput(const std::vector<PixelCodec::InstructionSet>& instructionSets, double minimumMeasurementTimeSec)
+  {
+    const int sizes[][2] = { {640, 480}, {1280, 720}, {1920, 1080} };
+    for (size_t sizeIndex = 0; sizeIndex < sizeof(sizes) / sizeof(sizes[0]); ++sizeIndex)
+    {
+      const int width = sizes[sizeIndex][0];
+      const int height = sizes[sizeIndex][1];
+      std::vector<unsigned char> input(width * height * 4);
+      for (size_t i = 0; i < input.size(); ++i)
+      {
+        input[i] = static_cast<unsigned char>(rand() % 256);
+      }
+      std::vector<unsigned char> output(width * height * 3);
+      for (int conversion = 0; conversion < NUMBER_OF_CONVERSIONS; ++conversion)
+      {
+        std::ostringstream results;
+        for (std::vector<PixelCodec::InstructionSet>::const_iterator it = instructionSets.begin(); it != instructionSets.end(); ++it)
+        {
+          PixelCodec::SetInstructionSet(*it);
+          int numberOfFrames = 0;
+          double elapsedTimeSec = 0;
+          const double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+          while (elapsedTimeSec < minimumMeasurementTimeSec)
+          {
+            Convert(static_cast<ConversionType>(conversion), width, height, &input[0], &output[0]);
+            numberOfFrames++;
+            elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+          }
+          const double megapixelsPerSec = static_cast<double>(width) * height * numberOfFrames / elapsedTimeSec / 1e6;
+          results << "  " << PixelCodec::GetInstructionSetAsString(*it) << ": " << std::fixed << std::setprecision(1) << megapixelsPerSec << " MPixel/s";
+        }
+        LOG_INFO(CONVERSION_NAMES[conversion] << " " << width << "x" << height << results.str());
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+  double measurementTimeSec = 0.2;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  args.AddArgument("--measurement-time-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &measurementTimeSec, "Minimum time spent measuring each conversion and instruction set (default: 0.2 sec). If 0 then only the correctness is checked.");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments." << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  const PixelCodec::InstructionSet defaultInstructionSet = PixelCodec::GetInstructionSet();
+  LOG_INFO("Default instruction set: " << PixelCodec::GetInstructionSetAsString(defaultInstructionSet));
+
+  std::vector<PixelCodec::InstructionSet> instructionSets = GetSupportedInstructionSets();
+  srand(1234);
+  if (CompareToScalar(instructionSets) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Vectorized pixel conversion results differ from the scalar implementation");
+    exit(EXIT_FAILURE);
+  }
+  LOG_INFO("Vectorized pixel conversion results are identical to the scalar implementation");
+
+  if (measurementTimeSec > 0)
+  {
+    MeasureThroughput(instructionSets, measurementTimeSec);
+  }
+
+  PixelCodec::SetInstructionSet(defaultInstructionSet);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,218 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file SequenceCompressionBenchmark.cxx
+  \brief Measures the speed and compression ratio of writing compressed sequence files
+
+  The input sequence (typically recorded B-mode data) is written with the single-threaded compressed sequence writer
+  and with the multi-threaded chunked writer (vtkPlusSequenceIO::WriteCompressed) using each compression method and
+  number of threads, to MetaImage and NRRD files. Throughput (MB/s of uncompressed image data) and compression ratio
+  are reported. Each file written by the multi-threaded writer is read back: the test fails if the images or
+  timestamps differ from the input.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusSequenceIO.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  const double BYTES_PER_MB = 1024.0 * 1024.0;
+  const double TIMESTAMP_TOLERANCE_SEC = 1e-4;
+
+  //----------------------------------------------------------------------------
+  double GetImageDataSizeInBytes(vtkIGSIOTrackedFrameList* frames)
+  {
+    double sizeInBytes = 0;
+    for (unsigned int frameIndex = 0; frameIndex < frames->GetNumberOfTrackedFrames(); ++frameIndex)
+    {
+      igsioVideoFrame* image = frames->GetTrackedFrame(frameIndex)->GetImageData();
+      if (image->IsImageValid())
+      {
+        sizeInBytes += image->GetFrameSizeInBytes();
+      }
+    }
+    return sizeInBytes;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CompareFrames(vtkIGSIOTrackedFrameList* expectedFrames, vtkIGSIOTrackedFrameList* actualFrames, const std::string& fileName)
+  {
+    if (actualFrames->GetNumberOfTrackedFrames() != expectedFrames->GetNumberOfTrackedFrames())
+    {
+      LOG_ERROR(fileName << ": number of frames is " << actualFrames->GetNumberOfTrackedFrames() << ", expected " << expectedFrames->GetNumberOfTrackedFrames());
+      return PLUS_FAIL;
+    }
+    for (unsigned int frameIndex = 0; frameIndex < expectedFrames->GetNumberOfTrackedFrames(); ++frameIndex)
+    {
+      igsioTrackedFrame* expectedFrame = expectedFrames->GetTrackedFrame(frameIndex);
+      igsioTrackedFrame* actualFrame = actualFrames->GetTrackedFrame(frameIndex);
+      if (fabs(expectedFrame->GetTimestamp() - actualFrame->GetTimestamp()) > TIMESTAMP_TOLERANCE_SEC)
+      {
+        LOG_ERROR(fileName << ": timestamp of frame " << frameIndex << " is " << actualFrame->GetTimestamp() << ", expected " << expectedFrame->GetTimestamp());
+        return PLUS_FAIL;
+      }
+      igsioVideoFrame* expectedImage = expectedFrame->GetImageData();
+      igsioVideoFrame* actualImage = actualFrame->GetImageData();
+      if (!expectedImage->IsImageValid())
+      {
+        continue;
+      }
+      if (!actualImage->IsImageValid()
+          || actualImage->GetFrameSizeInBytes() != expectedImage->GetFrameSizeInBytes()
+          || memcmp(actualImage->GetScalarPointer(), expectedImage->GetScalarPointer(), expectedImage->GetFrameSizeInBytes()) != 0)
+      {
+        LOG_ERROR(fileName << ": image data of frame " << frameIndex << " differs from the input");
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  void ReportResult(const std::string& name, double imageDataSizeInBytes, double elapsedTimeSec, const std::string& filePath)
+  {
+    double fileSizeInBytes = static_cast<double>(vtksys::SystemTools::FileLength(filePath));
+    LOG_INFO(std::left << std::setw(40) << name << std::right << std::fixed << std::setprecision(1)
+             << std::setw(10) << imageDataSizeInBytes / BYTES_PER_MB / elapsedTimeSec << " MB/s"
+             << std::setw(10) << std::setprecision(2) << imageDataSizeInBytes / fileSizeInBytes << "x compression"
+             << std::setw(10) << std::setprecision(1) << fileSizeInBytes / BYTES_PER_MB << " MB");
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+  std::string inputSeqFileName;
+  int maxNumberOfThreads = 0;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  args.AddArgument("--input-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputSeqFileName, "Sequence file that is written with the different compression settings.");
+  args.AddArgument("--max-number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxNumberOfThreads, "Maximum number of compression threads to measure (default: 0 = number of hardware threads).");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments." << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (inputSeqFileName.empty())
+  {
+    std::cerr << "--input-seq-file is required" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> inputFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(inputSeqFileName, inputFrames) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read sequence file: " << inputSeqFileName);
+    exit(EXIT_FAILURE);
+  }
+  const double imageDataSizeInBytes = GetImageDataSizeInBytes(inputFrames);
+  LOG_INFO("Input: " << inputFrames->GetNumberOfTrackedFrames() << " frames, " << imageDataSizeInBytes / BYTES_PER_MB << " MB image data");
+
+  if (maxNumberOfThreads <= 0)
+  {
+    maxNumberOfThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+  }
+  std::vector<int> threadCounts;
+  for (int numberOfThreads = 1; numberOfThreads < maxNumberOfThreads; numberOfThreads *= 2)
+  {
+    threadCounts.push_back(numberOfThreads);
+  }
+  threadCounts.push_back(maxNumberOfThreads);
+
+  int exitCode = EXIT_SUCCESS;
+  const char* extensions[] = { ".igs.mha", ".igs.nrrd" };
+  for (int extensionIndex = 0; extensionIndex < 2; ++extensionIndex)
+  {
+    const std::string extension = extensions[extensionIndex];
+
+    // Reference: single-threaded compressed writing
+    std::string referenceFilePath = vtkPlusConfig::GetInstance()->GetOutputPath("SequenceCompressionBenchmark_Reference" + extension);
+    double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+    if (vtkPlusSequenceIO::Write(referenceFilePath, inputFrames, inputFrames->GetTrackedFrame(0)->GetImageData()->GetImageOrientation(), true) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to write " << referenceFilePath);
+      exitCode = EXIT_FAILURE;
+    }
+    else
+    {
+      ReportResult("Single-threaded zlib (" + extension + ")", imageDataSizeInBytes, vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec, referenceFilePath);
+    }
+
+    const PlusParallelDeflate::CompressionMethodType methods[] =
+    {
+      PlusParallelDeflate::COMPRESSION_DEFAULT, PlusParallelDeflate::COMPRESSION_FAST, PlusParallelDeflate::COMPRESSION_RLE
+    };
+    for (int methodIndex = 0; methodIndex < 3; ++methodIndex)
+    {
+      for (std::vector<int>::iterator threadIt = threadCounts.begin(); threadIt != threadCounts.end(); ++threadIt)
+      {
+        std::ostringstream name;
+        name << PlusParallelDeflate::GetCompressionMethodAsString(methods[methodIndex]) << ", " << *threadIt << " threads (" << extension << ")";
+        std::ostringstream fileName;
+        fileName << "SequenceCompressionBenchmark_" << PlusParallelDeflate::GetCompressionMethodAsString(methods[methodIndex]) << "_" << *threadIt << extension;
+        std::string filePath = vtkPlusConfig::GetInstance()->GetOutputPath(fileName.str());
+
+        startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+        if (vtkPlusSequenceIO::WriteCompressed(filePath, inputFrames, methods[methodIndex], *threadIt) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to write " << filePath);
+          exitCode = EXIT_FAILURE;
+          continue;
+        }
+        ReportResult(name.str(), imageDataSizeInBytes, vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec, filePath);
+
+        vtkSmartPointer<vtkIGSIOTrackedFrameList> writtenFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+        if (vtkPlusSequenceIO::Read(filePath, writtenFrames) != PLUS_SUCCESS
+            || CompareFrames(inputFrames, writtenFrames, filePath) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Compressed file " << filePath << " cannot be read back correctly");
+          exitCode = EXIT_FAILURE;
+        }
+      }
+    }
+  }
+
+  return exitCode;
+}
@@ -0,0 +1,206 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file StreamingSequenceReaderTest.cxx
+  \brief Tests on-demand reading of sequence files with vtkPlusStreamingSequenceReader
+
+  The input sequence is written to uncompressed and compressed MetaImage and NRRD files. Each file is opened with
+  the streaming reader and the frames are requested in replay order, including a restart from the first frame as
+  when a replay loop wraps around. The test fails if any image, timestamp, or frame field differs from the frames
+  read by vtkPlusSequenceIO. The time needed for opening the file is reported for both readers.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkPlusStreamingSequenceReader.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+  const double TIMESTAMP_TOLERANCE_SEC = 1e-4;
+
+  //----------------------------------------------------------------------------
+  PlusStatus CompareFrame(vtkPlusStreamingSequenceReader* reader, unsigned int frameIndex, igsioTrackedFrame* expectedFrame, igsioVideoFrame& actualImage, const std::string& fileName)
+  {
+    if (reader->GetFrame(frameIndex, actualImage) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(fileName << ": failed to read frame " << frameIndex);
+      return PLUS_FAIL;
+    }
+    if (fabs(reader->GetTimestamp(frameIndex) - expectedFrame->GetTimestamp()) > TIMESTAMP_TOLERANCE_SEC)
+    {
+      LOG_ERROR(fileName << ": timestamp of frame " << frameIndex << " is " << reader->GetTimestamp(frameIndex) << ", expected " << expectedFrame->GetTimestamp());
+      return PLUS_FAIL;
+    }
+    igsioVideoFrame* expectedImage = expectedFrame->GetImageData();
+    if (actualImage.GetFrameSizeInBytes() != expectedImage->GetFrameSizeInBytes()
+        || memcmp(actualImage.GetScalarPointer(), expectedImage->GetScalarPointer(), expectedImage->GetFrameSizeInBytes()) != 0)
+    {
+      LOG_ERROR(fileName << ": image data of frame " << frameIndex << " differs from the input");
+      return PLUS_FAIL;
+    }
+    const igsioFieldMapType& actualFields = reader->GetFrameFields(frameIndex);
+    igsioFieldMapType expectedFields = expectedFrame->GetCustomFields();
+    for (igsioFieldMapType::iterator fieldIt = expectedFields.begin(); fieldIt != expectedFields.end(); ++fieldIt)
+    {
+      if (igsioCommon::IsEqualInsensitive(fieldIt->first, "Timestamp") || igsioCommon::IsEqualInsensitive(fieldIt->first, "UnfilteredTimestamp")
+          || igsioCommon::IsEqualInsensitive(fieldIt->first, "FrameNumber"))
+      {
+        continue;
+      }
+      igsioFieldMapType::const_iterator actualFieldIt = actualFields.find(fieldIt->first);
+      if (actualFieldIt == actualFields.end() || actualFieldIt->second.second != fieldIt->second.second)
+      {
+        LOG_ERROR(fileName << ": field " << fieldIt->first << " of frame " << frameIndex << " differs from the input");
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestStreaming(const std::string& filePath, const std::vector<igsioTrackedFrame*>& expectedFrames, unsigned long long prefetchWindowSizeBytes)
+  {
+    double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> loadedFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    vtkPlusSequenceIO::Read(filePath, loadedFrames);
+    double loadTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+    loadedFrames->Clear();
+
+    vtkSmartPointer<vtkPlusStreamingSequenceReader> reader = vtkSmartPointer<vtkPlusStreamingSequenceReader>::New();
+    reader->SetPrefetchWindowSizeBytes(prefetchWindowSizeBytes);
+    startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+    if (reader->Open(filePath) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to open " << filePath << " for streaming");
+      return PLUS_FAIL;
+    }
+    double openTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+    LOG_INFO(filePath << ": open time " << openTimeSec * 1000.0 << " ms (loading all frames: " << loadTimeSec * 1000.0 << " ms)");
+
+    if (reader->GetNumberOfFrames() != expectedFrames.size())
+    {
+      LOG_ERROR(filePath << ": number of frames is " << reader->GetNumberOfFrames() << ", expected " << expectedFrames.size());
+      return PLUS_FAIL;
+    }
+
+    // Replay twice, the second loop restarts from the first frame
+    igsioVideoFrame image;
+    for (int loopIndex = 0; loopIndex < 2; ++loopIndex)
+    {
+      startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+      for (unsigned int frameIndex = 0; frameIndex < reader->GetNumberOfFrames(); ++frameIndex)
+      {
+        if (CompareFrame(reader, frameIndex, expectedFrames[frameIndex], image, filePath) != PLUS_SUCCESS)
+        {
+          return PLUS_FAIL;
+        }
+      }
+      LOG_INFO(filePath << ": replay loop " << loopIndex << " completed in " << (vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec) * 1000.0 << " ms");
+    }
+
+    reader->Close();
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+  std::string inputSeqFileName;
+  int prefetchWindowSizeFrames = 4;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  args.AddArgument("--input-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputSeqFileName, "Sequence file that is written in different formats and read back with the streaming reader.");
+  args.AddArgument("--prefetch-window-size-frames", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &prefetchWindowSizeFrames, "Size of the prefetch window in frames (default: 4).");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments." << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (inputSeqFileName.empty())
+  {
+    std::cerr << "--input-seq-file is required" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> inputFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(inputSeqFileName, inputFrames) != PLUS_SUCCESS || inputFrames->GetNumberOfTrackedFrames() < 1)
+  {
+    LOG_ERROR("Failed to read sequence file: " << inputSeqFileName);
+    exit(EXIT_FAILURE);
+  }
+
+  // Frames with invalid image are not streamed
+  std::vector<igsioTrackedFrame*> expectedFrames;
+  for (unsigned int frameIndex = 0; frameIndex < inputFrames->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    if (inputFrames->GetTrackedFrame(frameIndex)->GetImageData()->IsImageValid())
+    {
+      expectedFrames.push_back(inputFrames->GetTrackedFrame(frameIndex));
+    }
+  }
+  const unsigned long long prefetchWindowSizeBytes = static_cast<unsigned long long>(prefetchWindowSizeFrames) * expectedFrames[0]->GetImageData()->GetFrameSizeInBytes();
+  US_IMAGE_ORIENTATION orientation = inputFrames->GetTrackedFrame(0)->GetImageData()->GetImageOrientation();
+
+  int exitCode = EXIT_SUCCESS;
+  const char* extensions[] = { ".igs.mha", ".igs.nrrd" };
+  for (int extensionIndex = 0; extensionIndex < 2; ++extensionIndex)
+  {
+    const std::string extension = extensions[extensionIndex];
+
+    std::string uncompressedFilePath = vtkPlusConfig::GetInstance()->GetOutputPath("StreamingSequenceReaderTest_Uncompressed" + extension);
+    if (vtkPlusSequenceIO::Write(uncompressedFilePath, inputFrames, orientation, false) != PLUS_SUCCESS
+        || TestStreaming(uncompressedFilePath, expectedFrames, prefetchWindowSizeBytes) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Streaming of uncompressed file " << uncompressedFilePath << " failed");
+      exitCode = EXIT_FAILURE;
+    }
+
+    std::string compressedFilePath = vtkPlusConfig::GetInstance()->GetOutputPath("StreamingSequenceReaderTest_Compressed" + extension);
+    if (vtkPlusSequenceIO::WriteCompressed(compressedFilePath, inputFrames) != PLUS_SUCCESS
+        || TestStreaming(compressedFilePath, expectedFrames, prefetchWindowSizeBytes) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Streaming of compressed file " << compressedFilePath << " failed");
+      exitCode = EXIT_FAILURE;
+    }
+  }
+
+  return exitCode;
+}
@@ -0,0 +1,572 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusCompressedSequenceWriter.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+vtkStandardNewMacro(vtkPlusCompressedSequenceWriter);
+
+namespace
+{
+  const unsigned int COPY_BUFFER_SIZE_BYTES = 1024 * 1024;
+
+  //----------------------------------------------------------------------------
+  std::string GetMetaImageElementType(int pixelType)
+  {
+    switch (pixelType)
+    {
+      case VTK_CHAR:
+      case VTK_SIGNED_CHAR:
+        return "MET_CHAR";
+      case VTK_UNSIGNED_CHAR:
+        return "MET_UCHAR";
+      case VTK_SHORT:
+        return "MET_SHORT";
+      case VTK_UNSIGNED_SHORT:
+        return "MET_USHORT";
+      case VTK_INT:
+        return "MET_INT";
+      case VTK_UNSIGNED_INT:
+        return "MET_UINT";
+      case VTK_FLOAT:
+        return "MET_FLOAT";
+      case VTK_DOUBLE:
+        return "MET_DOUBLE";
+      default:
+        return "";
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetNrrdType(int pixelType)
+  {
+    switch (pixelType)
+    {
+      case VTK_CHAR:
+      case VTK_SIGNED_CHAR:
+        return "int8";
+      case VTK_UNSIGNED_CHAR:
+        return "uint8";
+      case VTK_SHORT:
+        return "int16";
+      case VTK_UNSIGNED_SHORT:
+        return "uint16";
+      case VTK_INT:
+        return "int32";
+      case VTK_UNSIGNED_INT:
+        return "uint32";
+      case VTK_FLOAT:
+        return "float";
+      case VTK_DOUBLE:
+        return "double";
+      default:
+        return "";
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusCompressedSequenceWriter::vtkPlusCompressedSequenceWriter()
+  : CompressionMethod(PlusParallelDeflate::COMPRESSION_DEFAULT)
+  , NumberOfThreads(0)
+  , ChunkSizeBytes(static_cast<unsigned int>(PlusParallelDeflate::DEFAULT_CHUNK_SIZE_BYTES))
+  , Deflate(NULL)
+  , NumberOfFrames(0)
+  , NumberOfPendingBlankFrames(0)
+  , UncompressedSizeInBytes(0)
+  , CompressedSizeInBytes(0)
+  , ImageGeometryKnown(false)
+  , PixelType(VTK_VOID)
+  , NumberOfScalarComponents(0)
+  , ImageType(US_IMG_TYPE_XX)
+  , ImageOrientation(US_IMG_ORIENT_XX)
+  , FrameSizeInBytes(0)
+{
+  this->FrameSize[0] = this->FrameSize[1] = this->FrameSize[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusCompressedSequenceWriter::~vtkPlusCompressedSequenceWriter()
+{
+  if (this->IsOpen())
+  {
+    LOG_WARNING("Compressed sequence file " << this->FileName << " was not closed, discarding it");
+    this->Discard();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCompressedSequenceWriter::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << this->FileName << std::endl;
+  os << indent << "CompressionMethod: " << PlusParallelDeflate::GetCompressionMethodAsString(this->CompressionMethod) << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "ChunkSizeBytes: " << this->ChunkSizeBytes << std::endl;
+  os << indent << "NumberOfFrames: " << this->NumberOfFrames << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusCompressedSequenceWriter::CanWriteFile(const std::string& filename)
+{
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename));
+  return extension == ".mha" || extension == ".mhd" || extension == ".nrrd" || extension == ".nhdr";
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusCompressedSequenceWriter::IsMetaImage() const
+{
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(this->FileName));
+  return extension == ".mha" || extension == ".mhd";
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusCompressedSequenceWriter::IsDetached() const
+{
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(this->FileName));
+  return extension == ".mhd" || extension == ".nhdr";
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusCompressedSequenceWriter::GetDataFileName(const std::string& headerFileName) const
+{
+  if (!this->IsDetached())
+  {
+    return headerFileName + ".tmp";
+  }
+  std::string dataFileRoot = vtksys::SystemTools::GetFilenamePath(headerFileName);
+  if (!dataFileRoot.empty())
+  {
+    dataFileRoot += "/";
+  }
+  dataFileRoot += vtksys::SystemTools::GetFilenameWithoutLastExtension(headerFileName);
+  return dataFileRoot + (this->IsMetaImage() ? ".zraw" : ".raw.gz");
+}
+
+//----------------------------------------------------------------------------
+unsigned long long vtkPlusCompressedSequenceWriter::GetUncompressedSizeInBytes() const
+{
+  return this->Deflate != NULL ? this->Deflate->GetUncompressedSizeInBytes() : this->UncompressedSizeInBytes;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long vtkPlusCompressedSequenceWriter::GetCompressedSizeInBytes() const
+{
+  return this->Deflate != NULL ? this->Deflate->GetCompressedSizeInBytes() : this->CompressedSizeInBytes;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusCompressedSequenceWriter::Open()
+{
+  if (this->IsOpen())
+  {
+    LOG_ERROR("Compressed sequence file " << this->FileName << " is already open");
+    return PLUS_FAIL;
+  }
+  if (!CanWriteFile(this->FileName))
+  {
+    LOG_ERROR("Compressed sequence writer cannot write file " << this->FileName << ". Supported file extensions: .mha, .mhd, .nrrd, .nhdr");
+    return PLUS_FAIL;
+  }
+
+  this->OpenedFileExtension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(this->FileName));
+  this->DataFileName = this->GetDataFileName(this->FileName);
+  this->DataStream.open(this->DataFileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!this->DataStream)
+  {
+    LOG_ERROR("Failed to open " << this->DataFileName << " for writing");
+    this->DataStream.clear();
+    return PLUS_FAIL;
+  }
+
+  this->Deflate = new PlusParallelDeflate(this->DataStream,
+                                          this->IsMetaImage() ? PlusParallelDeflate::CONTAINER_ZLIB : PlusParallelDeflate::CONTAINER_GZIP,
+                                          this->CompressionMethod, this->NumberOfThreads, this->ChunkSizeBytes);
+  this->FrameFieldsText.clear();
+  this->NumberOfFrames = 0;
+  this->NumberOfPendingBlankFrames = 0;
+  this->UncompressedSizeInBytes = 0;
+  this->CompressedSizeInBytes = 0;
+  this->ImageGeometryKnown = false;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusCompressedSequenceWriter::AppendFrames(vtkIGSIOTrackedFrameList* frames)
+{
+  if (frames == NULL)
+  {
+    LOG_ERROR("vtkPlusCompressedSequenceWriter::AppendFrames failed: invalid frame list");
+    return PLUS_FAIL;
+  }
+  for (unsigned int frameIndex = 0; frameIndex < frames->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    if (this->AppendFrame(frames->GetTrackedFrame(frameIndex)) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusCompressedSequenceWriter::AppendFrame(igsioTrackedFrame* frame)
+{
+  if (!this->IsOpen())
+  {
+    LOG_ERROR("vtkPlusCompressedSequenceWriter::AppendFrame failed: file is not open");
+    return PLUS_FAIL;
+  }
+
+  igsioVideoFrame* image = frame->GetImageData();
+  bool isImageValid = (image != NULL && image->IsImageValid());
+  if (isImageValid)
+  {
+    if (this->CheckImageGeometry(frame) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    if (this->Deflate->Write(image->GetScalarPointer(), image->GetFrameSizeInBytes()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to write image data to " << this->DataFileName);
+      return PLUS_FAIL;
+    }
+  }
+  else if (this->ImageGeometryKnown)
+  {
+    if (this->WriteBlankFrames(1) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  else
+  {
+    // the size of the image is not known yet, the blank image is written when the first valid image is received
+    ++this->NumberOfPendingBlankFrames;
+  }
+
+  this->AppendFrameFields(frame, isImageValid);
+  ++this->NumberOfFrames;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusCompressedSequenceWriter::CheckImageGeometry(igsioTrackedFrame* frame)
+{
+  igsioVideoFrame* image = frame->GetImageData();
+  if (image->IsFrameEncoded())
+  {
+    LOG_ERROR("Compressed sequence writer cannot write encoded frames");
+    return PLUS_FAIL;
+  }
+
+  FrameSizeType frameSize = {0, 0, 0};
+  unsigned int numberOfScalarComponents = 0;
+  image->GetFrameSize(frameSize);
+  if (image->GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to get number of scalar components of the image");
+    return PLUS_FAIL;
+  }
+
+  if (!this->ImageGeometryKnown)
+  {
+    if (GetMetaImageElementType(image->GetVTKScalarPixelType()).empty())
+    {
+      LOG_ERROR("Compressed sequence writer does not support pixel type " << image->GetVTKScalarPixelType());
+      return PLUS_FAIL;
+    }
+    this->FrameSize = frameSize;
+    this->NumberOfScalarComponents = numberOfScalarComponents;
+    this->PixelType = image->GetVTKScalarPixelType();
+    this->ImageType = image->GetImageType();
+    this->ImageOrientation = image->GetImageOrientation();
+    this->FrameSizeInBytes = image->GetFrameSizeInBytes();
+    this->ImageGeometryKnown = true;
+
+    PlusStatus status = this->WriteBlankFrames(this->NumberOfPendingBlankFrames);
+    this->NumberOfPendingBlankFrames = 0;
+    return status;
+  }
+
+  if (frameSize[0] != this->FrameSize[0] || frameSize[1] != this->FrameSize[1] || frameSize[2] != this->FrameSize[2]
+      || numberOfScalarComponents != this->NumberOfScalarComponents || image->GetVTKScalarPixelType() != this->PixelType)
+  {
+    LOG_ERROR("Frame size or pixel type changed during recording to " << this->FileName << ": "
+              << frameSize[0] << "x" << frameSize[1] << "x" << frameSize[2] << " (expected "
+              << this->FrameSize[0] << "x" << this->FrameSize[1] << "x" << this->FrameSize[2] << ")");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusCompressedSequenceWriter::WriteBlankFrames(unsigned int numberOfFrames)
+{
+  if (numberOfFrames == 0)
+  {
+    return PLUS_SUCCESS;
+  }
+  std::vector<unsigned char> blankFrame(this->FrameSizeInBytes, 0);
+  for (unsigned int i = 0; i < numberOfFrames; ++i)
+  {
+    if (this->Deflate->Write(&blankFrame[0], blankFrame.size()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to write image data to " << this->DataFileName);
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCompressedSequenceWriter::AppendFrameFields(igsioTrackedFrame* frame, bool isImageValid)
+{
+  std::ostringstream framePrefix;
+  framePrefix << "Seq_Frame" << std::setfill('0') << std::setw(4) << this->NumberOfFrames << "_";
+
+  std::ostringstream fields;
+  igsioFieldMapType frameFields = frame->GetFrameFields();
+  for (igsioFieldMapType::const_iterator fieldIt = frameFields.begin(); fieldIt != frameFields.end(); ++fieldIt)
+  {
+    this->AppendHeaderField(fields, framePrefix.str() + fieldIt->first, fieldIt->second.second);
+  }
+  if (frameFields.find("Timestamp") == frameFields.end())
+  {
+    std::ostringstream timestamp;
+    timestamp << std::fixed << frame->GetTimestamp();
+    this->AppendHeaderField(fields, framePrefix.str() + "Timestamp", timestamp.str());
+  }
+  if (frameFields.find("ImageStatus") == frameFields.end())
+  {
+    this->AppendHeaderField(fields, framePrefix.str() + "ImageStatus", isImageValid ? "OK" : "INVALID");
+  }
+  this->FrameFieldsText += fields.str();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCompressedSequenceWriter::AppendHeaderField(std::ostream& header, const std::string& name, const std::string& value) const
+{
+  header << name << (this->IsMetaImage() ? " = " : ":=") << value << "\n";
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCompressedSequenceWriter::SetCustomField(const std::string& fieldName, const std::string& fieldValue)
+{
+  this->CustomFields[fieldName] = fieldValue;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusCompressedSequenceWriter::GetMetaImageHeader(const std::string& dataFileName) const
+{
+  const bool isData3D = this->FrameSize[2] > 1;
+  std::ostringstream header;
+  header << "ObjectType = Image\n";
+  header << "NDims = " << (isData3D ? 4 : 3) << "\n";
+  header << "AnatomicalOrientation = RAI\n";
+  header << "BinaryData = True\n";
+  header << "BinaryDataByteOrderMSB = False\n";
+  header << "CenterOfRotation = 0 0 0" << (isData3D ? " 0" : "") << "\n";
+  header << "CompressedData = True\n";
+  header << "CompressedDataSize = " << this->CompressedSizeInBytes << "\n";
+  header << "DimSize = " << this->FrameSize[0] << " " << this->FrameSize[1] << " ";
+  if (isData3D)
+  {
+    header << this->FrameSize[2] << " ";
+  }
+  header << this->NumberOfFrames << "\n";
+  header << "ElementNumberOfChannels = " << this->NumberOfScalarComponents << "\n";
+  header << "ElementSpacing = 1 1 1" << (isData3D ? " 1" : "") << "\n";
+  header << "ElementType = " << GetMetaImageElementType(this->PixelType) << "\n";
+  header << "Kinds = domain domain " << (isData3D ? "domain " : "") << "list\n";
+  header << "Offset = 0 0 0" << (isData3D ? " 0" : "") << "\n";
+  header << "TransformMatrix = " << (isData3D ? "1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1" : "1 0 0 0 1 0 0 0 1") << "\n";
+  header << "UltrasoundImageOrientation = " << igsioCommon::GetStringFromUsImageOrientation(this->ImageOrientation) << "\n";
+  header << "UltrasoundImageType = " << igsioCommon::GetStringFromUsImageType(this->ImageType) << "\n";
+  for (std::map<std::string, std::string>::const_iterator fieldIt = this->CustomFields.begin(); fieldIt != this->CustomFields.end(); ++fieldIt)
+  {
+    this->AppendHeaderField(header, fieldIt->first, fieldIt->second);
+  }
+  header << this->FrameFieldsText;
+  // ElementDataFile must be the last field, the pixel data of single-file images starts right after it
+  header << "ElementDataFile = " << (dataFileName.empty() ? "LOCAL" : dataFileName) << "\n";
+  return header.str();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusCompressedSequenceWriter::GetNrrdHeader(const std::string& dataFileName) const
+{
+  const bool isData3D = this->FrameSize[2] > 1;
+  const bool isVector = this->NumberOfScalarComponents > 1;
+  std::ostringstream header;
+  header << "NRRD0004\n";
+  header << "# Complete NRRD file format specification at:\n";
+  header << "# http://teem.sourceforge.net/nrrd/format.html\n";
+  header << "type: " << GetNrrdType(this->PixelType) << "\n";
+  header << "dimension: " << (isData3D ? 4 : 3) + (isVector ? 1 : 0) << "\n";
+  header << "sizes: ";
+  if (isVector)
+  {
+    header << this->NumberOfScalarComponents << " ";
+  }
+  header << this->FrameSize[0] << " " << this->FrameSize[1] << " ";
+  if (isData3D)
+  {
+    header << this->FrameSize[2] << " ";
+  }
+  header << this->NumberOfFrames << "\n";
+  header << "kinds: " << (isVector ? "vector " : "") << "domain domain " << (isData3D ? "domain " : "") << "list\n";
+  header << "endian: little\n";
+  header << "encoding: gzip\n";
+  this->AppendHeaderField(header, "UltrasoundImageOrientation", igsioCommon::GetStringFromUsImageOrientation(this->ImageOrientation));
+  this->AppendHeaderField(header, "UltrasoundImageType", igsioCommon::GetStringFromUsImageType(this->ImageType));
+  for (std::map<std::string, std::string>::const_iterator fieldIt = this->CustomFields.begin(); fieldIt != this->CustomFields.end(); ++fieldIt)
+  {
+    this->AppendHeaderField(header, fieldIt->first, fieldIt->second);
+  }
+  header << this->FrameFieldsText;
+  if (!dataFileName.empty())
+  {
+    header << "data file: " << dataFileName << "\n";
+  }
+  else
+  {
+    // Single-file NRRD: the pixel data starts after the first empty line
+    header << "\n";
+  }
+  return header.str();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusCompressedSequenceWriter::Close()
+{
+  if (!this->IsOpen())
+  {
+    return PLUS_SUCCESS;
+  }
+  if (vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(this->FileName)) != this->OpenedFileExtension)
+  {
+    LOG_ERROR("File format cannot be changed after the file is opened (" << this->OpenedFileExtension << " file was opened, file name is changed to " << this->FileName << "), the file is discarded");
+    this->Discard();
+    return PLUS_FAIL;
+  }
+  if (!this->ImageGeometryKnown)
+  {
+    LOG_ERROR("No valid image was written to " << this->FileName << ", the file is discarded");
+    this->Discard();
+    return PLUS_FAIL;
+  }
+
+  PlusStatus status = this->Deflate->Finish();
+  this->CloseDataFile();
+  if (status != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to write compressed image data to " << this->DataFileName);
+    vtksys::SystemTools::RemoveFile(this->DataFileName);
+    return PLUS_FAIL;
+  }
+
+  // The file name may have changed since the file was opened
+  std::string dataFileNameInHeader;
+  if (this->IsDetached())
+  {
+    std::string dataFileName = this->GetDataFileName(this->FileName);
+    if (dataFileName != this->DataFileName)
+    {
+      if (!vtksys::SystemTools::RenameFile(this->DataFileName.c_str(), dataFileName.c_str()))
+      {
+        LOG_ERROR("Failed to rename " << this->DataFileName << " to " << dataFileName);
+        return PLUS_FAIL;
+      }
+      this->DataFileName = dataFileName;
+    }
+    dataFileNameInHeader = vtksys::SystemTools::GetFilenameName(this->DataFileName);
+  }
+
+  std::ofstream headerStream(this->FileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!headerStream)
+  {
+    LOG_ERROR("Failed to open " << this->FileName << " for writing");
+    return PLUS_FAIL;
+  }
+  headerStream << (this->IsMetaImage() ? this->GetMetaImageHeader(dataFileNameInHeader) : this->GetNrrdHeader(dataFileNameInHeader));
+
+  if (!this->IsDetached())
+  {
+    // Append the compressed pixel data to the header
+    status = this->CopyFileContents(this->DataFileName, headerStream);
+    vtksys::SystemTools::RemoveFile(this->DataFileName);
+  }
+  headerStream.close();
+  if (status != PLUS_SUCCESS || headerStream.fail())
+  {
+    LOG_ERROR("Failed to write compressed sequence file " << this->FileName);
+    return PLUS_FAIL;
+  }
+
+  LOG_DEBUG("Compressed sequence file written: " << this->FileName << " (" << this->NumberOfFrames << " frames, "
+            << this->UncompressedSizeInBytes << " bytes compressed to " << this->CompressedSizeInBytes << " bytes)");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCompressedSequenceWriter::Discard()
+{
+  if (!this->IsOpen())
+  {
+    return;
+  }
+  this->CloseDataFile();
+  vtksys::SystemTools::RemoveFile(this->DataFileName);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCompressedSequenceWriter::CloseDataFile()
+{
+  this->UncompressedSizeInBytes = this->Deflate->GetUncompressedSizeInBytes();
+  this->CompressedSizeInBytes = this->Deflate->GetCompressedSizeInBytes();
+  delete this->Deflate;
+  this->Deflate = NULL;
+  this->DataStream.close();
+  this->DataStream.clear();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusCompressedSequenceWriter::CopyFileContents(const std::string& sourceFileName, std::ostream& destination) const
+{
+  std::ifstream source(sourceFileName.c_str(), std::ios::in | std::ios::binary);
+  if (!source)
+  {
+    LOG_ERROR("Failed to open " << sourceFileName << " for reading");
+    return PLUS_FAIL;
+  }
+  std::vector<char> buffer(COPY_BUFFER_SIZE_BYTES);
+  while (source)
+  {
+    source.read(&buffer[0], buffer.size());
+    destination.write(&buffer[0], source.gcount());
+    if (!destination)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  return PLUS_SUCCESS;
+}
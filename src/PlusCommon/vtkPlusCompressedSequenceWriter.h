@@ -0,0 +1,150 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusCompressedSequenceWriter_h
+#define __vtkPlusCompressedSequenceWriter_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+#include "PlusParallelDeflate.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STL includes
+#include <fstream>
+#include <map>
+#include <string>
+
+class igsioTrackedFrame;
+class vtkIGSIOTrackedFrameList;
+
+/*!
+  \class vtkPlusCompressedSequenceWriter
+  \brief Streaming writer of compressed MetaImage (.mha, .mhd) and NRRD (.nrrd, .nhdr) sequence files
+
+  Frames can be appended in batches while recording. The pixel data is compressed by PlusParallelDeflate on multiple
+  threads as soon as the frames are appended, so compression keeps up with the recording on multi-core computers.
+  The header (which contains the number of frames and the per-frame fields) is written when the file is closed:
+  for single-file formats the compressed pixel data is kept in a temporary file until then.
+
+  All frames must have the same size, pixel type and number of components as the first valid frame. Frames
+  are written in the image orientation they are stored in. Invalid frames are written as black images with
+  ImageStatus=INVALID.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport vtkPlusCompressedSequenceWriter : public vtkObject
+{
+public:
+  static vtkPlusCompressedSequenceWriter* New();
+  vtkTypeMacro(vtkPlusCompressedSequenceWriter, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Returns true if the file can be written by this writer (based on the file extension) */
+  static bool CanWriteFile(const std::string& filename);
+
+  /*! Full path of the output (header) file. It can be changed until the file is closed. */
+  vtkSetStdStringMacro(FileName);
+  vtkGetStdStringMacro(FileName);
+
+  vtkSetMacro(CompressionMethod, PlusParallelDeflate::CompressionMethodType);
+  vtkGetMacro(CompressionMethod, PlusParallelDeflate::CompressionMethodType);
+
+  /*! Number of compression threads. If 0 then the number of hardware threads is used. */
+  vtkSetMacro(NumberOfThreads, int);
+  vtkGetMacro(NumberOfThreads, int);
+
+  /*! Size of the pieces of pixel data that are compressed independently */
+  vtkSetMacro(ChunkSizeBytes, unsigned int);
+  vtkGetMacro(ChunkSizeBytes, unsigned int);
+
+  /*! Start writing a new file. Settings cannot be changed until the file is closed. */
+  PlusStatus Open();
+
+  /*! Compress and write the pixel data of the frames, store their fields for the header */
+  PlusStatus AppendFrames(vtkIGSIOTrackedFrameList* frames);
+  PlusStatus AppendFrame(igsioTrackedFrame* frame);
+
+  /*! Set a field that is written to the header of the file */
+  void SetCustomField(const std::string& fieldName, const std::string& fieldValue);
+
+  /*! Finish compression and write the header. Fails if no valid image was appended. */
+  PlusStatus Close();
+
+  /*! Stop writing and remove the partially written files */
+  void Discard();
+
+  bool IsOpen() const { return this->Deflate != NULL; }
+
+  /*! Number of frames appended to the current (or last closed) file */
+  vtkGetMacro(NumberOfFrames, unsigned int);
+
+  /*! Size of the pixel data before compression */
+  unsigned long long GetUncompressedSizeInBytes() const;
+
+  /*! Size of the compressed pixel data */
+  unsigned long long GetCompressedSizeInBytes() const;
+
+protected:
+  vtkPlusCompressedSequenceWriter();
+  virtual ~vtkPlusCompressedSequenceWriter();
+
+  bool IsMetaImage() const;
+  bool IsDetached() const;
+
+  /*! Name of the file that contains the pixel data. For single-file formats it is a temporary file. */
+  std::string GetDataFileName(const std::string& headerFileName) const;
+
+  /*! Store the image geometry of the first valid frame, check the geometry of the others */
+  PlusStatus CheckImageGeometry(igsioTrackedFrame* frame);
+
+  /*! Write a black image for each invalid frame */
+  PlusStatus WriteBlankFrames(unsigned int numberOfFrames);
+
+  void AppendFrameFields(igsioTrackedFrame* frame, bool isImageValid);
+  void AppendHeaderField(std::ostream& header, const std::string& name, const std::string& value) const;
+
+  std::string GetMetaImageHeader(const std::string& dataFileName) const;
+  std::string GetNrrdHeader(const std::string& dataFileName) const;
+
+  PlusStatus CopyFileContents(const std::string& sourceFileName, std::ostream& destination) const;
+
+  void CloseDataFile();
+
+  std::string FileName;
+  PlusParallelDeflate::CompressionMethodType CompressionMethod;
+  int NumberOfThreads;
+  unsigned int ChunkSizeBytes;
+
+  /*! State of the file that is being written */
+  std::string OpenedFileExtension;
+  std::string DataFileName;
+  std::ofstream DataStream;
+  PlusParallelDeflate* Deflate;
+  std::map<std::string, std::string> CustomFields;
+  /*! Formatted per-frame fields, in the order of the frames */
+  std::string FrameFieldsText;
+  unsigned int NumberOfFrames;
+  unsigned int NumberOfPendingBlankFrames;
+  unsigned long long UncompressedSizeInBytes;
+  unsigned long long CompressedSizeInBytes;
+
+  /*! Geometry of the images, set from the first valid frame */
+  bool ImageGeometryKnown;
+  FrameSizeType FrameSize;
+  int PixelType;
+  unsigned int NumberOfScalarComponents;
+  US_IMAGE_TYPE ImageType;
+  US_IMAGE_ORIENTATION ImageOrientation;
+  unsigned long FrameSizeInBytes;
+
+private:
+  vtkPlusCompressedSequenceWriter(const vtkPlusCompressedSequenceWriter&);
+  void operator=(const vtkPlusCompressedSequenceWriter&);
+};
+
+#endif
@@ -5,6 +5,7 @@
 =========================================================Plus=header=end*/
 
 #include "PlusConfigure.h"
+#include "vtkPlusCompressedSequenceWriter.h"
 #include "vtkPlusSequenceIO.h"
 
 #include <vtkIGSIOSequenceIO.h>
@@ -34,6 +35,32 @@ igsioStatus vtkPlusSequenceIO::Write(const std::string& filename, igsioTrackedFr
   return vtkIGSIOSequenceIO::Write(filename, outputDirectory, frame, orientationInFile, useCompression, enableImageDataWrite);
 }
 
+//----------------------------------------------------------------------------
+igsioStatus vtkPlusSequenceIO::WriteCompressed(const std::string& filename, vtkIGSIOTrackedFrameList* frameList,
+    PlusParallelDeflate::CompressionMethodType compressionMethod /*= PlusParallelDeflate::COMPRESSION_DEFAULT*/, int numberOfThreads /*= 0*/)
+{
+  if (!vtkPlusCompressedSequenceWriter::CanWriteFile(filename))
+  {
+    LOG_ERROR("Compressed writing is not supported for " << filename << ". Supported file extensions: .mha, .mhd, .nrrd, .nhdr");
+    return PLUS_FAIL;
+  }
+
+  vtkNew<vtkPlusCompressedSequenceWriter> writer;
+  writer->SetFileName(vtksys::SystemTools::FileIsFullPath(filename) ? filename : vtkPlusConfig::GetInstance()->GetOutputPath(filename));
+  writer->SetCompressionMethod(compressionMethod);
+  writer->SetNumberOfThreads(numberOfThreads);
+  if (writer->Open() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (writer->AppendFrames(frameList) != PLUS_SUCCESS)
+  {
+    writer->Discard();
+    return PLUS_FAIL;
+  }
+  return writer->Close();
+}
+
 //----------------------------------------------------------------------------
 igsioStatus vtkPlusSequenceIO::Read(const std::string& trackedSequenceDataFileName, vtkIGSIOTrackedFrameList* frameList)
 {
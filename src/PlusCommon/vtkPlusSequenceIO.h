@@ -8,6 +8,7 @@
 #define __vtkPlusSequenceIO_h
 
 #include "igsioCommon.h"
+#include "PlusParallelDeflate.h"
 
 /*!
   \class vtkPlusSequenceIO
@@ -23,6 +24,13 @@ public:
   /*! Write object contents into file */
   static igsioStatus Write(const std::string& filename, vtkIGSIOTrackedFrameList* frameList, US_IMAGE_ORIENTATION orientationInFile = US_IMG_ORIENT_MF, bool useCompression = true, bool EnableImageDataWrite = true);
 
+  /*!
+    Write object contents into a compressed MetaImage or NRRD file. The pixel data is compressed on multiple threads
+    (numberOfThreads=0 uses all hardware threads). Frames are written in the image orientation they are stored in.
+  */
+  static igsioStatus WriteCompressed(const std::string& filename, vtkIGSIOTrackedFrameList* frameList,
+                                     PlusParallelDeflate::CompressionMethodType compressionMethod = PlusParallelDeflate::COMPRESSION_DEFAULT, int numberOfThreads = 0);
+
   /*! Read file contents into the object */
   static igsioStatus Read(const std::string& filename, vtkIGSIOTrackedFrameList* frameList);
 
@@ -0,0 +1,1010 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusStreamingSequenceReader.h"
+
+// IGSIO includes
+#include <igsioVideoFrame.h>
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkObjectFactory.h>
+#include <vtk_zlib.h>
+#include <vtksys/SystemTools.hxx>
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+vtkStandardNewMacro(vtkPlusStreamingSequenceReader);
+
+namespace
+{
+  const unsigned long long DEFAULT_PREFETCH_WINDOW_SIZE_BYTES = 64 * 1024 * 1024;
+  const unsigned int MINIMUM_PREFETCH_WINDOW_SIZE_FRAMES = 2;
+  const unsigned int COMPRESSED_READ_BLOCK_SIZE_BYTES = 256 * 1024;
+  const std::string SEQUENCE_FIELD_FRAME_PREFIX = "Seq_Frame";
+
+  //----------------------------------------------------------------------------
+  int GetPixelTypeFromMetaImageElementType(const std::string& elementType)
+  {
+    if (elementType == "MET_CHAR") { return VTK_CHAR; }
+    if (elementType == "MET_UCHAR") { return VTK_UNSIGNED_CHAR; }
+    if (elementType == "MET_SHORT") { return VTK_SHORT; }
+    if (elementType == "MET_USHORT") { return VTK_UNSIGNED_SHORT; }
+    if (elementType == "MET_INT") { return VTK_INT; }
+    if (elementType == "MET_UINT") { return VTK_UNSIGNED_INT; }
+    if (elementType == "MET_FLOAT") { return VTK_FLOAT; }
+    if (elementType == "MET_DOUBLE") { return VTK_DOUBLE; }
+    return VTK_VOID;
+  }
+
+  //----------------------------------------------------------------------------
+  int GetPixelTypeFromNrrdType(const std::string& nrrdType)
+  {
+    if (nrrdType == "signed char" || nrrdType == "int8" || nrrdType == "int8_t") { return VTK_SIGNED_CHAR; }
+    if (nrrdType == "uchar" || nrrdType == "unsigned char" || nrrdType == "uint8" || nrrdType == "uint8_t") { return VTK_UNSIGNED_CHAR; }
+    if (nrrdType == "short" || nrrdType == "short int" || nrrdType == "signed short" || nrrdType == "signed short int" || nrrdType == "int16" || nrrdType == "int16_t") { return VTK_SHORT; }
+    if (nrrdType == "ushort" || nrrdType == "unsigned short" || nrrdType == "unsigned short int" || nrrdType == "uint16" || nrrdType == "uint16_t") { return VTK_UNSIGNED_SHORT; }
+    if (nrrdType == "int" || nrrdType == "signed int" || nrrdType == "int32" || nrrdType == "int32_t") { return VTK_INT; }
+    if (nrrdType == "uint" || nrrdType == "unsigned int" || nrrdType == "uint32" || nrrdType == "uint32_t") { return VTK_UNSIGNED_INT; }
+    if (nrrdType == "float") { return VTK_FLOAT; }
+    if (nrrdType == "double") { return VTK_DOUBLE; }
+    return VTK_VOID;
+  }
+
+  //----------------------------------------------------------------------------
+  std::vector<unsigned int> SplitNumbers(const std::string& value)
+  {
+    std::vector<unsigned int> numbers;
+    std::istringstream valueStream(value);
+    unsigned int number = 0;
+    while (valueStream >> number)
+    {
+      numbers.push_back(number);
+    }
+    return numbers;
+  }
+
+  //----------------------------------------------------------------------------
+  void StripLineEnding(std::string& line)
+  {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+    {
+      line.erase(line.size() - 1);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  unsigned long long GetPageSize()
+  {
+#ifdef _WIN32
+    SYSTEM_INFO systemInfo;
+    GetSystemInfo(&systemInfo);
+    // Mapping offsets must be a multiple of the allocation granularity
+    return systemInfo.dwAllocationGranularity;
+#else
+    return static_cast<unsigned long long>(sysconf(_SC_PAGESIZE));
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+struct vtkPlusStreamingSequenceReader::DecoderState
+{
+  DecoderState() : Initialized(false), NextFrameIndex(0)
+  {
+    memset(&this->Stream, 0, sizeof(this->Stream));
+  }
+  ~DecoderState()
+  {
+    if (this->Initialized)
+    {
+      inflateEnd(&this->Stream);
+    }
+  }
+  z_stream Stream;
+  bool Initialized;
+  std::ifstream Input;
+  std::vector<unsigned char> InputBuffer;
+  /*! File frame index of the frame that will be decoded next */
+  unsigned int NextFrameIndex;
+};
+
+//----------------------------------------------------------------------------
+vtkPlusStreamingSequenceReader::vtkPlusStreamingSequenceReader()
+  : PrefetchWindowSizeBytes(DEFAULT_PREFETCH_WINDOW_SIZE_BYTES)
+  , ReadFrameFields(true)
+  , DataOffset(0)
+  , Compressed(false)
+  , PixelType(VTK_VOID)
+  , NumberOfScalarComponents(1)
+  , ImageType(US_IMG_BRIGHTNESS)
+  , ImageOrientation(US_IMG_ORIENT_MF)
+  , NumberOfFramesInFile(0)
+  , FrameSizeInBytes(0)
+  , PrefetchWindowSizeFrames(MINIMUM_PREFETCH_WINDOW_SIZE_FRAMES)
+  , MappedData(NULL)
+  , MappedSizeInBytes(0)
+  , MappingOffset(0)
+#ifdef _WIN32
+  , FileHandle(INVALID_HANDLE_VALUE)
+  , MappingHandle(NULL)
+#else
+  , FileDescriptor(-1)
+#endif
+  , ReleasedUntilOffset(0)
+  , PrefetchedUntilOffset(0)
+  , FirstDecodedFrameIndex(0)
+  , RestartRequested(false)
+  , RestartFrameIndex(0)
+  , DecoderFailed(false)
+  , PrefetchStopRequested(false)
+{
+  this->FrameSize[0] = this->FrameSize[1] = this->FrameSize[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusStreamingSequenceReader::~vtkPlusStreamingSequenceReader()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusStreamingSequenceReader::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "FileName: " << this->FileName << std::endl;
+  os << indent << "DataFileName: " << this->DataFileName << std::endl;
+  os << indent << "Compressed: " << (this->Compressed ? "true" : "false") << std::endl;
+  os << indent << "NumberOfFrames: " << this->Frames.size() << std::endl;
+  os << indent << "FrameSize: " << this->FrameSize[0] << "x" << this->FrameSize[1] << "x" << this->FrameSize[2] << std::endl;
+  os << indent << "PrefetchWindowSizeBytes: " << this->PrefetchWindowSizeBytes << std::endl;
+  os << indent << "ReadFrameFields: " << (this->ReadFrameFields ? "true" : "false") << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusStreamingSequenceReader::CanReadFile(const std::string& filename)
+{
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename));
+  return extension == ".mha" || extension == ".mhd" || extension == ".nrrd" || extension == ".nhdr";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusStreamingSequenceReader::Open(const std::string& filename)
+{
+  this->Close();
+
+  if (!CanReadFile(filename))
+  {
+    LOG_ERROR("Streaming sequence reader cannot read file " << filename << ". Supported file extensions: .mha, .mhd, .nrrd, .nhdr");
+    return PLUS_FAIL;
+  }
+
+  std::ifstream headerStream(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!headerStream.is_open())
+  {
+    LOG_ERROR("Failed to open sequence file " << filename << " for reading");
+    return PLUS_FAIL;
+  }
+  this->FileName = filename;
+
+  std::string extension = vtksys::SystemTools::LowerCase(vtksys::SystemTools::GetFilenameLastExtension(filename));
+  PlusStatus headerStatus = (extension == ".mha" || extension == ".mhd") ? this->ReadMetaImageHeader(headerStream) : this->ReadNrrdHeader(headerStream);
+  headerStream.close();
+  if (headerStatus != PLUS_SUCCESS)
+  {
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  this->FrameSizeInBytes = static_cast<unsigned long long>(this->FrameSize[0]) * this->FrameSize[1] * this->FrameSize[2]
+                           * this->NumberOfScalarComponents * vtkDataArray::GetDataTypeSize(this->PixelType);
+  if (this->FrameSizeInBytes == 0)
+  {
+    LOG_ERROR("Sequence file " << filename << " contains empty frames");
+    this->Close();
+    return PLUS_FAIL;
+  }
+  this->PrefetchWindowSizeFrames = std::max<unsigned int>(MINIMUM_PREFETCH_WINDOW_SIZE_FRAMES,
+                                   static_cast<unsigned int>(std::min<unsigned long long>(this->PrefetchWindowSizeBytes / this->FrameSizeInBytes, this->NumberOfFramesInFile)));
+
+  if (this->Compressed)
+  {
+    this->Decoder.reset(new DecoderState);
+    {
+      std::lock_guard<std::mutex> lock(this->PrefetchMutex);
+      this->DecodedFrames.clear();
+      this->FirstDecodedFrameIndex = 0;
+      this->RestartRequested = true;
+      this->RestartFrameIndex = 0;
+      this->DecoderFailed = false;
+      this->PrefetchStopRequested = false;
+    }
+    this->PrefetchThreadHandle = std::thread(&vtkPlusStreamingSequenceReader::PrefetchThread, this);
+  }
+  else if (this->MapDataFile() != PLUS_SUCCESS)
+  {
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  LOG_DEBUG("Sequence file opened for streaming: " << filename << " (" << this->Frames.size() << " frames, "
+            << (this->Compressed ? "compressed" : (this->MappedData != NULL ? "memory mapped" : "uncompressed"))
+            << ", prefetch window: " << this->PrefetchWindowSizeFrames << " frames)");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusStreamingSequenceReader::Close()
+{
+  this->StopPrefetchThread();
+  this->Decoder.reset();
+  this->DecodedFrames.clear();
+  this->UnmapDataFile();
+  this->Frames.clear();
+  this->FileName.clear();
+  this->DataFileName.clear();
+  this->DataOffset = 0;
+  this->Compressed = false;
+  this->FrameSize[0] = this->FrameSize[1] = this->FrameSize[2] = 0;
+  this->PixelType = VTK_VOID;
+  this->NumberOfScalarComponents = 1;
+  this->ImageType = US_IMG_BRIGHTNESS;
+  this->ImageOrientation = US_IMG_ORIENT_MF;
+  this->NumberOfFramesInFile = 0;
+  this->FrameSizeInBytes = 0;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusStreamingSequenceReader::ReadMetaImageHeader(std::ifstream& headerStream)
+{
+  std::vector<igsioFieldMapType> fileFrameFields;
+  std::vector<unsigned int> dimSize;
+  unsigned int numberOfDimensions = 0;
+  bool elementDataFileFound = false;
+  std::string line;
+  while (std::getline(headerStream, line))
+  {
+    StripLineEnding(line);
+    size_t separatorPos = line.find('=');
+    if (separatorPos == std::string::npos)
+    {
+      continue;
+    }
+    std::string name = line.substr(0, separatorPos);
+    std::string value = line.substr(separatorPos + 1);
+    name = igsioCommon::Trim(name);
+    value = igsioCommon::Trim(value);
+
+    if (name.compare(0, SEQUENCE_FIELD_FRAME_PREFIX.size(), SEQUENCE_FIELD_FRAME_PREFIX) == 0)
+    {
+      if (this->AddFrameField(fileFrameFields, name, value) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+    else if (name == "NDims")
+    {
+      igsioCommon::StringToNumber<unsigned int>(value, numberOfDimensions);
+    }
+    else if (name == "DimSize")
+    {
+      dimSize = SplitNumbers(value);
+    }
+    else if (name == "ElementType")
+    {
+      this->PixelType = GetPixelTypeFromMetaImageElementType(value);
+    }
+    else if (name == "ElementNumberOfChannels")
+    {
+      igsioCommon::StringToNumber<unsigned int>(value, this->NumberOfScalarComponents);
+    }
+    else if (name == "CompressedData")
+    {
+      this->Compressed = igsioCommon::IsEqualInsensitive(value, "True");
+    }
+    else if (name == "BinaryDataByteOrderMSB" || name == "ElementByteOrderMSB")
+    {
+      if (igsioCommon::IsEqualInsensitive(value, "True") && this->PixelType != VTK_UNSIGNED_CHAR && this->PixelType != VTK_CHAR)
+      {
+        LOG_ERROR("Streaming of big endian sequence files is not supported: " << this->FileName);
+        return PLUS_FAIL;
+      }
+    }
+    else if (name == "UltrasoundImageOrientation")
+    {
+      this->ImageOrientation = igsioCommon::GetUsImageOrientationFromString(value.c_str());
+    }
+    else if (name == "UltrasoundImageType")
+    {
+      this->ImageType = igsioCommon::GetUsImageTypeFromString(value.c_str());
+    }
+    else if (name == "ElementDataFile")
+    {
+      // ElementDataFile is always the last field of the header
+      if (value == "LOCAL")
+      {
+        this->DataFileName = this->FileName;
+        this->DataOffset = static_cast<unsigned long long>(headerStream.tellg());
+      }
+      else
+      {
+        this->DataFileName = vtksys::SystemTools::CollapseFullPath(value, vtksys::SystemTools::GetFilenamePath(this->FileName));
+        this->DataOffset = 0;
+      }
+      elementDataFileFound = true;
+      break;
+    }
+  }
+
+  if (!elementDataFileFound)
+  {
+    LOG_ERROR("ElementDataFile field is not found in sequence file " << this->FileName);
+    return PLUS_FAIL;
+  }
+  if (this->PixelType == VTK_VOID)
+  {
+    LOG_ERROR("Unsupported or missing ElementType in sequence file " << this->FileName);
+    return PLUS_FAIL;
+  }
+  if ((numberOfDimensions != 3 && numberOfDimensions != 4) || dimSize.size() != numberOfDimensions)
+  {
+    LOG_ERROR("Unsupported NDims or DimSize in sequence file " << this->FileName << " (expected 2D or 3D frames)");
+    return PLUS_FAIL;
+  }
+  this->FrameSize[0] = dimSize[0];
+  this->FrameSize[1] = dimSize[1];
+  this->FrameSize[2] = (numberOfDimensions == 4 ? dimSize[2] : 1);
+  this->NumberOfFramesInFile = dimSize[numberOfDimensions - 1];
+
+  return this->BuildFrameIndex(fileFrameFields);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusStreamingSequenceReader::ReadNrrdHeader(std::ifstream& headerStream)
+{
+  std::string line;
+  if (!std::getline(headerStream, line) || line.compare(0, 4, "NRRD") != 0)
+  {
+    LOG_ERROR("Invalid NRRD file, magic string is not found: " << this->FileName);
+    return PLUS_FAIL;
+  }
+
+  std::vector<igsioFieldMapType> fileFrameFields;
+  std::vector<unsigned int> sizes;
+  std::vector<std::string> kinds;
+  std::string encoding = "raw";
+  std::string dataFile;
+  bool headerEndFound = false;
+  while (std::getline(headerStream, line))
+  {
+    StripLineEnding(line);
+    if (line.empty())
+    {
+      // Empty line separates the header from the data in attached files
+      headerEndFound = true;
+      break;
+    }
+    if (line[0] == '#')
+    {
+      continue;
+    }
+
+    // Key/value pairs are separated by ":=", fields are separated by ": "
+    std::string name;
+    std::string value;
+    size_t separatorPos = line.find(":=");
+    if (separatorPos != std::string::npos)
+    {
+      name = line.substr(0, separatorPos);
+      value = line.substr(separatorPos + 2);
+    }
+    else
+    {
+      separatorPos = line.find(':');
+      if (separatorPos == std::string::npos)
+      {
+        continue;
+      }
+      name = line.substr(0, separatorPos);
+      value = line.substr(separatorPos + 1);
+    }
+    name = igsioCommon::Trim(name);
+    value = igsioCommon::Trim(value);
+
+    if (name.compare(0, SEQUENCE_FIELD_FRAME_PREFIX.size(), SEQUENCE_FIELD_FRAME_PREFIX) == 0)
+    {
+      if (this->AddFrameField(fileFrameFields, name, value) != PLUS_SUCCESS)
+      {
+        return PLUS_FAIL;
+      }
+    }
+    else if (name == "type")
+    {
+      this->PixelType = GetPixelTypeFromNrrdType(value);
+    }
+    else if (name == "sizes")
+    {
+      sizes = SplitNumbers(value);
+    }
+    else if (name == "kinds")
+    {
+      kinds = igsioCommon::SplitStringIntoTokens(value, ' ', false);
+    }
+    else if (name == "encoding")
+    {
+      encoding = value;
+    }
+    else if (name == "endian")
+    {
+      if (value == "big" && this->PixelType != VTK_UNSIGNED_CHAR && this->PixelType != VTK_SIGNED_CHAR)
+      {
+        LOG_ERROR("Streaming of big endian sequence files is not supported: " << this->FileName);
+        return PLUS_FAIL;
+      }
+    }
+    else if (name == "data file" || name == "datafile")
+    {
+      dataFile = value;
+    }
+    else if (name == "UltrasoundImageOrientation")
+    {
+      this->ImageOrientation = igsioCommon::GetUsImageOrientationFromString(value.c_str());
+    }
+    else if (name == "UltrasoundImageType")
+    {
+      this->ImageType = igsioCommon::GetUsImageTypeFromString(value.c_str());
+    }
+  }
+
+  if (dataFile.empty())
+  {
+    if (!headerEndFound)
+    {
+      LOG_ERROR("Data is not found in NRRD file " << this->FileName);
+      return PLUS_FAIL;
+    }
+    this->DataFileName = this->FileName;
+    this->DataOffset = static_cast<unsigned long long>(headerStream.tellg());
+  }
+  else
+  {
+    if (dataFile.find(' ') != std::string::npos || dataFile == "LIST")
+    {
+      LOG_ERROR("Streaming of NRRD files with multiple data files is not supported: " << this->FileName);
+      return PLUS_FAIL;
+    }
+    this->DataFileName = vtksys::SystemTools::CollapseFullPath(dataFile, vtksys::SystemTools::GetFilenamePath(this->FileName));
+    this->DataOffset = 0;
+  }
+
+  if (encoding == "gzip" || encoding == "gz")
+  {
+    this->Compressed = true;
+  }
+  else if (encoding != "raw")
+  {
+    LOG_ERROR("Streaming of NRRD files with " << encoding << " encoding is not supported: " << this->FileName);
+    return PLUS_FAIL;
+  }
+  if (this->PixelType == VTK_VOID)
+  {
+    LOG_ERROR("Unsupported or missing type in NRRD file " << this->FileName);
+    return PLUS_FAIL;
+  }
+
+  // The first axis contains the pixel components if its kind is not a spatial domain
+  size_t firstSpatialAxis = 0;
+  if (!kinds.empty() && kinds.size() == sizes.size() && kinds[0] != "domain" && kinds[0] != "space" && kinds[0] != "list")
+  {
+    this->NumberOfScalarComponents = sizes[0];
+    firstSpatialAxis = 1;
+  }
+  size_t numberOfSpatialAxes = sizes.size() - firstSpatialAxis - 1;
+  if (sizes.size() < firstSpatialAxis + 1 || (numberOfSpatialAxes != 2 && numberOfSpatialAxes != 3))
+  {
+    LOG_ERROR("Unsupported sizes in NRRD file " << this->FileName << " (expected 2D or 3D frames)");
+    return PLUS_FAIL;
+  }
+  this->FrameSize[0] = sizes[firstSpatialAxis];
+  this->FrameSize[1] = sizes[firstSpatialAxis + 1];
+  this->FrameSize[2] = (numberOfSpatialAxes == 3 ? sizes[firstSpatialAxis + 2] : 1);
+  this->NumberOfFramesInFile = sizes[sizes.size() - 1];
+
+  return this->BuildFrameIndex(fileFrameFields);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusStreamingSequenceReader::AddFrameField(std::vector<igsioFieldMapType>& fileFrameFields, const std::string& name, const std::string& value)
+{
+  // Field name format: Seq_Frame0000_FieldName
+  size_t fieldNameStart = name.find('_', SEQUENCE_FIELD_FRAME_PREFIX.size());
+  unsigned int fileFrameIndex = 0;
+  if (fieldNameStart == std::string::npos
+      || igsioCommon::StringToNumber<unsigned int>(name.substr(SEQUENCE_FIELD_FRAME_PREFIX.size(), fieldNameStart - SEQUENCE_FIELD_FRAME_PREFIX.size()), fileFrameIndex) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("Invalid frame field name in sequence file " << this->FileName << ": " << name);
+    return PLUS_SUCCESS;
+  }
+  std::string fieldName = name.substr(fieldNameStart + 1);
+
+  // Only the fields that are needed for building the index are kept if the frame fields are not requested
+  if (!this->ReadFrameFields && fieldName != "Timestamp" && fieldName != "ImageStatus")
+  {
+    return PLUS_SUCCESS;
+  }
+  if (fileFrameIndex >= fileFrameFields.size())
+  {
+    fileFrameFields.resize(fileFrameIndex + 1);
+  }
+  fileFrameFields[fileFrameIndex][fieldName] = std::make_pair(FRAMEFIELD_NONE, value);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusStreamingSequenceReader::BuildFrameIndex(std::vector<igsioFieldMapType>& fileFrameFields)
+{
+  this->Frames.clear();
+  this->Frames.reserve(this->NumberOfFramesInFile);
+  for (unsigned int fileFrameIndex = 0; fileFrameIndex < this->NumberOfFramesInFile && fileFrameIndex < fileFrameFields.size(); ++fileFrameIndex)
+  {
+    igsioFieldMapType& fields = fileFrameFields[fileFrameIndex];
+    igsioFieldMapType::iterator imageStatusIt = fields.find("ImageStatus");
+    if (imageStatusIt != fields.end() && imageStatusIt->second.second == "INVALID")
+    {
+      // Invalid frames are not added to the buffer in non-streaming mode either
+      continue;
+    }
+
+    FrameIndexItem item;
+    item.FileFrameIndex = fileFrameIndex;
+    igsioFieldMapType::iterator timestampIt = fields.find("Timestamp");
+    if (timestampIt == fields.end() || igsioCommon::StringToNumber<double>(timestampIt->second.second, item.Timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to read Timestamp field of frame #" << fileFrameIndex << " in " << this->FileName);
+      return PLUS_FAIL;
+    }
+    if (!this->Frames.empty() && item.Timestamp < this->Frames.back().Timestamp)
+    {
+      LOG_ERROR("Timestamps are not increasing in " << this->FileName << " at frame #" << fileFrameIndex << ", the file cannot be streamed");
+      return PLUS_FAIL;
+    }
+
+    if (this->ReadFrameFields)
+    {
+      // Same special fields are skipped as in vtkPlusBuffer::CopyImagesFromTrackedFrameList
+      for (igsioFieldMapType::iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+      {
+        if (igsioCommon::IsEqualInsensitive(fieldIt->first, "TimeStamp")
+            || igsioCommon::IsEqualInsensitive(fieldIt->first, "UnfilteredTimestamp")
+            || igsioCommon::IsEqualInsensitive(fieldIt->first, "FrameNumber"))
+        {
+          continue;
+        }
+        item.Fields[fieldIt->first] = fieldIt->second;
+      }
+    }
+    // Release the parsed fields early, the index is the only copy that is kept
+    igsioFieldMapType().swap(fields);
+
+    this->Frames.push_back(item);
+  }
+
+  if (this->Frames.empty())
+  {
+    LOG_ERROR("There is no valid frame in sequence file " << this->FileName);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusStreamingSequenceReader::GetFrame(unsigned int frameIndex, igsioVideoFrame& frame)
+{
+  if (frameIndex >= this->Frames.size())
+  {
+    LOG_ERROR("Frame index " << frameIndex << " is out of range (number of frames: " << this->Frames.size() << ")");
+    return PLUS_FAIL;
+  }
+
+  FrameSizeType currentFrameSize = {0, 0, 0};
+  unsigned int currentNumberOfScalarComponents = 0;
+  if (!frame.IsImageValid()
+      || frame.GetFrameSize(currentFrameSize) != PLUS_SUCCESS || currentFrameSize != this->FrameSize
+      || frame.GetVTKScalarPixelType() != this->PixelType
+      || frame.GetNumberOfScalarComponents(currentNumberOfScalarComponents) != PLUS_SUCCESS || currentNumberOfScalarComponents != this->NumberOfScalarComponents)
+  {
+    if (frame.AllocateFrame(this->FrameSize, this->PixelType, this->NumberOfScalarComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate frame for streaming from " << this->FileName);
+      return PLUS_FAIL;
+    }
+  }
+  frame.SetImageType(this->ImageType);
+  frame.SetImageOrientation(this->ImageOrientation);
+
+  unsigned char* destination = static_cast<unsigned char*>(frame.GetScalarPointer());
+  unsigned int fileFrameIndex = this->Frames[frameIndex].FileFrameIndex;
+  return this->Compressed ? this->GetDecodedFrame(fileFrameIndex, destination) : this->GetMappedFrame(fileFrameIndex, destination);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusStreamingSequenceReader::MapDataFile()
+{
+  unsigned long long dataSizeInBytes = this->FrameSizeInBytes * this->NumberOfFramesInFile;
+  unsigned long long fileSizeInBytes = vtksys::SystemTools::FileLength(this->DataFileName);
+  if (fileSizeInBytes < this->DataOffset + dataSizeInBytes)
+  {
+    LOG_ERROR("Sequence data file " << this->DataFileName << " is too short: " << fileSizeInBytes << " bytes, expected at least " << this->DataOffset + dataSizeInBytes);
+    return PLUS_FAIL;
+  }
+
+  // Mapping must start at a page boundary
+  unsigned long long mappingStart = this->DataOffset - this->DataOffset % GetPageSize();
+  this->MappingOffset = this->DataOffset - mappingStart;
+  this->MappedSizeInBytes = this->MappingOffset + dataSizeInBytes;
+  this->ReleasedUntilOffset = 0;
+  this->PrefetchedUntilOffset = 0;
+
+#ifdef _WIN32
+  this->FileHandle = CreateFileA(this->DataFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (this->FileHandle == INVALID_HANDLE_VALUE)
+  {
+    LOG_ERROR("Failed to open sequence data file " << this->DataFileName << " for reading");
+    return PLUS_FAIL;
+  }
+  this->MappingHandle = CreateFileMappingA(this->FileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (this->MappingHandle != NULL)
+  {
+    this->MappedData = static_cast<unsigned char*>(MapViewOfFile(this->MappingHandle, FILE_MAP_READ,
+                       static_cast<DWORD>(mappingStart >> 32), static_cast<DWORD>(mappingStart & 0xFFFFFFFF), static_cast<SIZE_T>(this->MappedSizeInBytes)));
+  }
+#else
+  this->FileDescriptor = open(this->DataFileName.c_str(), O_RDONLY);
+  if (this->FileDescriptor < 0)
+  {
+    LOG_ERROR("Failed to open sequence data file " << this->DataFileName << " for reading");
+    return PLUS_FAIL;
+  }
+  void* mapping = mmap(NULL, static_cast<size_t>(this->MappedSizeInBytes), PROT_READ, MAP_PRIVATE, this->FileDescriptor, static_cast<off_t>(mappingStart));
+  this->MappedData = (mapping == MAP_FAILED ? NULL : static_cast<unsigned char*>(mapping));
+  if (this->MappedData != NULL)
+  {
+    madvise(this->MappedData, static_cast<size_t>(this->MappedSizeInBytes), MADV_SEQUENTIAL);
+  }
+#endif
+
+  if (this->MappedData == NULL)
+  {
+    // Frames are read from the file when requested (e.g., if the address space is too small for the mapping)
+    LOG_WARNING("Failed to memory map sequence data file " << this->DataFileName << ", frames are read from the file instead");
+    this->MappedSizeInBytes = 0;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusStreamingSequenceReader::UnmapDataFile()
+{
+#ifdef _WIN32
+  if (this->MappedData != NULL)
+  {
+    UnmapViewOfFile(this->MappedData);
+  }
+  if (this->MappingHandle != NULL)
+  {
+    CloseHandle(this->MappingHandle);
+    this->MappingHandle = NULL;
+  }
+  if (this->FileHandle != INVALID_HANDLE_VALUE)
+  {
+    CloseHandle(this->FileHandle);
+    this->FileHandle = INVALID_HANDLE_VALUE;
+  }
+#else
+  if (this->MappedData != NULL)
+  {
+    munmap(this->MappedData, static_cast<size_t>(this->MappedSizeInBytes));
+  }
+  if (this->FileDescriptor >= 0)
+  {
+    close(this->FileDescriptor);
+    this->FileDescriptor = -1;
+  }
+#endif
+  this->MappedData = NULL;
+  this->MappedSizeInBytes = 0;
+  this->MappingOffset = 0;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusStreamingSequenceReader::GetMappedFrame(unsigned int fileFrameIndex, unsigned char* destination)
+{
+  unsigned long long frameStart = this->MappingOffset + static_cast<unsigned long long>(fileFrameIndex) * this->FrameSizeInBytes;
+  unsigned long long frameEnd = frameStart + this->FrameSizeInBytes;
+
+  if (this->MappedData == NULL)
+  {
+    // Fallback: read the frame directly from the file
+    unsigned long long fileOffset = this->DataOffset + static_cast<unsigned long long>(fileFrameIndex) * this->FrameSizeInBytes;
+#ifdef _WIN32
+    LARGE_INTEGER position;
+    position.QuadPart = static_cast<LONGLONG>(fileOffset);
+    DWORD bytesRead = 0;
+    if (!SetFilePointerEx(this->FileHandle, position, NULL, FILE_BEGIN)
+        || !ReadFile(this->FileHandle, destination, static_cast<DWORD>(this->FrameSizeInBytes), &bytesRead, NULL)
+        || bytesRead != this->FrameSizeInBytes)
+    {
+      LOG_ERROR("Failed to read frame #" << fileFrameIndex << " from " << this->DataFileName);
+      return PLUS_FAIL;
+    }
+#else
+    unsigned long long bytesRead = 0;
+    while (bytesRead < this->FrameSizeInBytes)
+    {
+      ssize_t result = pread(this->FileDescriptor, destination + bytesRead, static_cast<size_t>(this->FrameSizeInBytes - bytesRead), static_cast<off_t>(fileOffset + bytesRead));
+      if (result <= 0)
+      {
+        LOG_ERROR("Failed to read frame #" << fileFrameIndex << " from " << this->DataFileName);
+        return PLUS_FAIL;
+      }
+      bytesRead += static_cast<unsigned long long>(result);
+    }
+#endif
+    return PLUS_SUCCESS;
+  }
+
+  memcpy(destination, this->MappedData + frameStart, static_cast<size_t>(this->FrameSizeInBytes));
+
+  // Keep only the prefetch window resident: release the pages before the current frame
+  // and ask the operating system to read ahead the pages of the following frames
+  const unsigned long long pageSize = GetPageSize();
+  if (frameStart < this->ReleasedUntilOffset)
+  {
+    // Replay restarted from an earlier frame
+    this->ReleasedUntilOffset = frameStart - frameStart % pageSize;
+    this->PrefetchedUntilOffset = frameStart;
+  }
+  unsigned long long releaseUntil = frameStart - frameStart % pageSize;
+  if (releaseUntil > this->ReleasedUntilOffset)
+  {
+#ifdef _WIN32
+    // Unlocking pages that are not locked removes them from the working set of the process
+    VirtualUnlock(this->MappedData + this->ReleasedUntilOffset, static_cast<SIZE_T>(releaseUntil - this->ReleasedUntilOffset));
+#else
+    madvise(this->MappedData + this->ReleasedUntilOffset, static_cast<size_t>(releaseUntil - this->ReleasedUntilOffset), MADV_DONTNEED);
+#endif
+    this->ReleasedUntilOffset = releaseUntil;
+  }
+#ifndef _WIN32
+  unsigned long long prefetchWindowSizeBytes = this->PrefetchWindowSizeFrames * this->FrameSizeInBytes;
+  if (this->PrefetchedUntilOffset < frameEnd + prefetchWindowSizeBytes / 2)
+  {
+    // Prefetch in large steps: request the next window when half of the previous one is consumed
+    unsigned long long prefetchStart = std::max(this->PrefetchedUntilOffset, frameEnd);
+    prefetchStart -= prefetchStart % pageSize;
+    unsigned long long prefetchEnd = std::min(frameEnd + prefetchWindowSizeBytes, this->MappedSizeInBytes);
+    if (prefetchEnd > prefetchStart)
+    {
+      madvise(this->MappedData + prefetchStart, static_cast<size_t>(prefetchEnd - prefetchStart), MADV_WILLNEED);
+    }
+    this->PrefetchedUntilOffset = prefetchEnd;
+  }
+#endif
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusStreamingSequenceReader::ResetDecoder()
+{
+  DecoderState& decoder = *this->Decoder;
+  if (decoder.Initialized)
+  {
+    inflateEnd(&decoder.Stream);
+    decoder.Initialized = false;
+  }
+  memset(&decoder.Stream, 0, sizeof(decoder.Stream));
+  decoder.NextFrameIndex = 0;
+
+  if (!decoder.Input.is_open())
+  {
+    decoder.Input.open(this->DataFileName.c_str(), std::ios::in | std::ios::binary);
+    if (!decoder.Input.is_open())
+    {
+      LOG_ERROR("Failed to open sequence data file " << this->DataFileName << " for reading");
+      return PLUS_FAIL;
+    }
+  }
+  decoder.Input.clear();
+  decoder.Input.seekg(static_cast<std::streamoff>(this->DataOffset), std::ios::beg);
+  decoder.InputBuffer.resize(COMPRESSED_READ_BLOCK_SIZE_BYTES);
+
+  // Automatic zlib/gzip header detection (compressed MetaImage uses zlib, NRRD uses gzip)
+  if (inflateInit2(&decoder.Stream, 15 + 32) != Z_OK)
+  {
+    LOG_ERROR("Failed to initialize decompression of " << this->DataFileName);
+    return PLUS_FAIL;
+  }
+  decoder.Initialized = true;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusStreamingSequenceReader::DecodeFrame(unsigned char* destination)
+{
+  DecoderState& decoder = *this->Decoder;
+  z_stream& stream = decoder.Stream;
+  stream.next_out = destination;
+  stream.avail_out = static_cast<uInt>(this->FrameSizeInBytes);
+  while (stream.avail_out > 0)
+  {
+    if (stream.avail_in == 0)
+    {
+      decoder.Input.read(reinterpret_cast<char*>(&decoder.InputBuffer[0]), decoder.InputBuffer.size());
+      std::streamsize bytesRead = decoder.Input.gcount();
+      if (bytesRead <= 0)
+      {
+        LOG_ERROR("Unexpected end of compressed data in " << this->DataFileName << " at frame #" << decoder.NextFrameIndex);
+        return PLUS_FAIL;
+      }
+      stream.next_in = &decoder.InputBuffer[0];
+      stream.avail_in = static_cast<uInt>(bytesRead);
+    }
+    int result = inflate(&stream, Z_NO_FLUSH);
+    if (result == Z_STREAM_END)
+    {
+      if (stream.avail_out > 0)
+      {
+        LOG_ERROR("Compressed data in " << this->DataFileName << " ends before frame #" << decoder.NextFrameIndex);
+        return PLUS_FAIL;
+      }
+      break;
+    }
+    if (result != Z_OK && result != Z_BUF_ERROR)
+    {
+      LOG_ERROR("Failed to decompress frame #" << decoder.NextFrameIndex << " of " << this->DataFileName << " (zlib error " << result << ")");
+      return PLUS_FAIL;
+    }
+  }
+  decoder.NextFrameIndex++;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusStreamingSequenceReader::PrefetchThread()
+{
+  std::unique_lock<std::mutex> lock(this->PrefetchMutex);
+  while (true)
+  {
+    this->FrameRequested.wait(lock, [this]()
+    {
+      return this->PrefetchStopRequested || this->RestartRequested
+             || (!this->DecoderFailed && this->Decoder->NextFrameIndex < this->NumberOfFramesInFile && this->DecodedFrames.size() < this->PrefetchWindowSizeFrames);
+    });
+    if (this->PrefetchStopRequested)
+    {
+      return;
+    }
+
+    if (this->RestartRequested)
+    {
+      // Decoding can only start from the beginning of the stream, skip the frames before the requested one
+      this->RestartRequested = false;
+      this->DecoderFailed = false;
+      unsigned int restartFrameIndex = this->RestartFrameIndex;
+      lock.unlock();
+      PlusStatus status = this->ResetDecoder();
+      std::vector<unsigned char> skippedFrame(status == PLUS_SUCCESS && restartFrameIndex > 0 ? this->FrameSizeInBytes : 0);
+      bool interrupted = false;
+      while (status == PLUS_SUCCESS && this->Decoder->NextFrameIndex < restartFrameIndex)
+      {
+        status = this->DecodeFrame(&skippedFrame[0]);
+        std::lock_guard<std::mutex> skipLock(this->PrefetchMutex);
+        if (this->PrefetchStopRequested || this->RestartRequested)
+        {
+          interrupted = true;
+          break;
+        }
+      }
+      lock.lock();
+      if (!interrupted && status != PLUS_SUCCESS)
+      {
+        this->DecoderFailed = true;
+        this->FrameDecoded.notify_all();
+      }
+      continue;
+    }
+
+    std::shared_ptr<std::vector<unsigned char> > frame = std::make_shared<std::vector<unsigned char> >(this->FrameSizeInBytes);
+    lock.unlock();
+    PlusStatus status = this->DecodeFrame(&(*frame)[0]);
+    lock.lock();
+    if (this->PrefetchStopRequested || this->RestartRequested)
+    {
+      // The decoded frame is not needed anymore
+      continue;
+    }
+    if (status != PLUS_SUCCESS)
+    {
+      this->DecoderFailed = true;
+    }
+    else
+    {
+      this->DecodedFrames.push_back(frame);
+    }
+    this->FrameDecoded.notify_all();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusStreamingSequenceReader::GetDecodedFrame(unsigned int fileFrameIndex, unsigned char* destination)
+{
+  std::unique_lock<std::mutex> lock(this->PrefetchMutex);
+  if (fileFrameIndex < this->FirstDecodedFrameIndex)
+  {
+    // The requested frame is already evicted (e.g., replay loop restarted), decoding is restarted
+    LOG_DEBUG("Restart decoding of " << this->DataFileName << " from frame #" << fileFrameIndex);
+    this->DecodedFrames.clear();
+    this->FirstDecodedFrameIndex = fileFrameIndex;
+    this->RestartFrameIndex = fileFrameIndex;
+    this->RestartRequested = true;
+    this->DecoderFailed = false;
+    this->FrameRequested.notify_all();
+  }
+
+  while (true)
+  {
+    // Frames before the requested one will not be needed anymore
+    while (!this->DecodedFrames.empty() && this->FirstDecodedFrameIndex < fileFrameIndex)
+    {
+      this->DecodedFrames.pop_front();
+      this->FirstDecodedFrameIndex++;
+      this->FrameRequested.notify_all();
+    }
+    if (!this->DecodedFrames.empty())
+    {
+      memcpy(destination, &(*this->DecodedFrames.front())[0], static_cast<size_t>(this->FrameSizeInBytes));
+      return PLUS_SUCCESS;
+    }
+    if (this->DecoderFailed || this->PrefetchStopRequested)
+    {
+      LOG_ERROR("Failed to decode frame #" << fileFrameIndex << " of " << this->DataFileName);
+      return PLUS_FAIL;
+    }
+    this->FrameDecoded.wait(lock);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusStreamingSequenceReader::StopPrefetchThread()
+{
+  if (!this->PrefetchThreadHandle.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->PrefetchMutex);
+    this->PrefetchStopRequested = true;
+  }
+  this->FrameRequested.notify_all();
+  this->FrameDecoded.notify_all();
+  this->PrefetchThreadHandle.join();
+  this->PrefetchStopRequested = false;
+}
@@ -0,0 +1,170 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusStreamingSequenceReader_h
+#define __vtkPlusStreamingSequenceReader_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommonExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STL includes
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class igsioVideoFrame;
+
+/*!
+  \class vtkPlusStreamingSequenceReader
+  \brief Reads the frames of a MetaImage (.mha, .mhd) or NRRD (.nrrd, .nhdr) sequence file on demand
+
+  Open() only parses the header and builds an index of the frame timestamps (and optionally the frame fields),
+  the pixel data is not loaded into memory:
+  \li Uncompressed pixel data is memory mapped, each frame is copied from the mapping when it is requested.
+    The pages of the frames that are before the requested frame are released and the pages of the frames
+    in the prefetch window are requested from the operating system in advance.
+  \li Compressed (zlib or gzip) pixel data is decoded by a prefetch thread into a window of frames ahead of
+    the requested frame. Requesting a frame that is before the window (e.g., when a replay loop restarts)
+    restarts decoding from the beginning of the file.
+
+  Frames are expected to be requested in increasing order (except for restarts), as in replay.
+  Frames that have ImageStatus=INVALID are not included in the index.
+
+  \ingroup PlusLibCommon
+*/
+class vtkPlusCommonExport vtkPlusStreamingSequenceReader : public vtkObject
+{
+public:
+  static vtkPlusStreamingSequenceReader* New();
+  vtkTypeMacro(vtkPlusStreamingSequenceReader, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Returns true if the file format can be read by this reader (based on the file extension) */
+  static bool CanReadFile(const std::string& filename);
+
+  /*! Maximum size of the frames that are decoded or prefetched in advance */
+  vtkSetMacro(PrefetchWindowSizeBytes, unsigned long long);
+  vtkGetMacro(PrefetchWindowSizeBytes, unsigned long long);
+
+  /*! Keep all the frame fields in the index. If disabled then only the timestamps are kept. */
+  vtkSetMacro(ReadFrameFields, bool);
+  vtkGetMacro(ReadFrameFields, bool);
+
+  /*! Parse the header and build the frame index */
+  PlusStatus Open(const std::string& filename);
+  void Close();
+
+  unsigned int GetNumberOfFrames() const { return static_cast<unsigned int>(this->Frames.size()); }
+
+  /*! Image properties, valid after the file is opened */
+  FrameSizeType GetFrameSize() const { return this->FrameSize; }
+  int GetPixelType() const { return this->PixelType; }
+  unsigned int GetNumberOfScalarComponents() const { return this->NumberOfScalarComponents; }
+  US_IMAGE_TYPE GetImageType() const { return this->ImageType; }
+  US_IMAGE_ORIENTATION GetImageOrientation() const { return this->ImageOrientation; }
+  bool GetCompressed() const { return this->Compressed; }
+
+  /*! Timestamp of the frame (index among the valid frames) */
+  double GetTimestamp(unsigned int frameIndex) const { return this->Frames[frameIndex].Timestamp; }
+
+  /*! Frame fields of the frame. Empty if ReadFrameFields was disabled when the file was opened. */
+  const igsioFieldMapType& GetFrameFields(unsigned int frameIndex) const { return this->Frames[frameIndex].Fields; }
+
+  /*! Copy the pixel data of the frame into the video frame (allocated if the size does not match) */
+  PlusStatus GetFrame(unsigned int frameIndex, igsioVideoFrame& frame);
+
+protected:
+  vtkPlusStreamingSequenceReader();
+  virtual ~vtkPlusStreamingSequenceReader();
+
+  struct FrameIndexItem
+  {
+    FrameIndexItem() : Timestamp(0.0), FileFrameIndex(0) {}
+    double Timestamp;
+    /*! Position of the frame in the pixel data of the file (invalid frames are included there) */
+    unsigned int FileFrameIndex;
+    igsioFieldMapType Fields;
+  };
+
+  PlusStatus ReadMetaImageHeader(std::ifstream& headerStream);
+  PlusStatus ReadNrrdHeader(std::ifstream& headerStream);
+  PlusStatus AddFrameField(std::vector<igsioFieldMapType>& fileFrameFields, const std::string& name, const std::string& value);
+  PlusStatus BuildFrameIndex(std::vector<igsioFieldMapType>& fileFrameFields);
+
+  PlusStatus MapDataFile();
+  void UnmapDataFile();
+  PlusStatus GetMappedFrame(unsigned int fileFrameIndex, unsigned char* destination);
+
+  /*! Compressed data decoding, used by the prefetch thread */
+  PlusStatus ResetDecoder();
+  PlusStatus DecodeFrame(unsigned char* destination);
+  void PrefetchThread();
+  PlusStatus GetDecodedFrame(unsigned int fileFrameIndex, unsigned char* destination);
+  void StopPrefetchThread();
+
+  unsigned long long PrefetchWindowSizeBytes;
+  bool ReadFrameFields;
+
+  std::string FileName;
+  std::string DataFileName;
+  unsigned long long DataOffset;
+  bool Compressed;
+  FrameSizeType FrameSize;
+  int PixelType;
+  unsigned int NumberOfScalarComponents;
+  US_IMAGE_TYPE ImageType;
+  US_IMAGE_ORIENTATION ImageOrientation;
+  unsigned int NumberOfFramesInFile;
+  unsigned long long FrameSizeInBytes;
+  unsigned int PrefetchWindowSizeFrames;
+  std::vector<FrameIndexItem> Frames;
+
+  /*! Memory mapping of uncompressed data */
+  unsigned char* MappedData;
+  unsigned long long MappedSizeInBytes;
+  unsigned long long MappingOffset;
+#ifdef _WIN32
+  void* FileHandle;
+  void* MappingHandle;
+#else
+  int FileDescriptor;
+#endif
+  /*! Data before this offset (relative to the mapping) has been released */
+  unsigned long long ReleasedUntilOffset;
+  unsigned long long PrefetchedUntilOffset;
+
+  /*! Decoder state, accessed only by the prefetch thread */
+  struct DecoderState;
+  std::unique_ptr<DecoderState> Decoder;
+
+  /*! Members below are protected by PrefetchMutex */
+  std::mutex PrefetchMutex;
+  std::condition_variable FrameDecoded;
+  std::condition_variable FrameRequested;
+  std::deque<std::shared_ptr<std::vector<unsigned char> > > DecodedFrames;
+  /*! File frame index of the first item in DecodedFrames */
+  unsigned int FirstDecodedFrameIndex;
+  bool RestartRequested;
+  unsigned int RestartFrameIndex;
+  bool DecoderFailed;
+  bool PrefetchStopRequested;
+
+  std::thread PrefetchThreadHandle;
+
+private:
+  vtkPlusStreamingSequenceReader(const vtkPlusStreamingSequenceReader&);
+  void operator=(const vtkPlusStreamingSequenceReader&);
+};
+
+#endif
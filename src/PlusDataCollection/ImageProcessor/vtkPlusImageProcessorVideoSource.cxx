@@ -17,6 +17,12 @@ See License.txt for details.
 #include "vtkIGSIOTransformRepository.h"
 #include "vtksys/SystemTools.hxx"
 
+namespace
+{
+  const int DEFAULT_NUMBER_OF_PROCESSING_THREADS = 0;
+  const int DEFAULT_PROCESSING_QUEUE_LENGTH = 4;
+}
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusImageProcessorVideoSource);
@@ -29,6 +35,12 @@ vtkPlusImageProcessorVideoSource::vtkPlusImageProcessorVideoSource()
   , ProcessingAlgorithmAccessMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
   , GracePeriodLogLevel(vtkPlusLogger::LOG_LEVEL_DEBUG)
   , ProcessorAlgorithm(NULL)
+  , NumberOfProcessingThreads(DEFAULT_NUMBER_OF_PROCESSING_THREADS)
+  , ProcessingQueueLength(DEFAULT_PROCESSING_QUEUE_LENGTH)
+  , LastQueuedInputDataTimestamp(UNDEFINED_TIMESTAMP)
+  , StopProcessingRequested(false)
+  , NextSequenceNumberToQueue(0)
+  , NextSequenceNumberToOutput(0)
 {
   this->MissingInputGracePeriodSec = 2.0;
 
@@ -42,6 +54,7 @@ vtkPlusImageProcessorVideoSource::vtkPlusImageProcessorVideoSource()
 //----------------------------------------------------------------------------
 vtkPlusImageProcessorVideoSource::~vtkPlusImageProcessorVideoSource()
 {
+  this->StopProcessingThreads();
   if (this->TransformRepository)
   {
     this->TransformRepository->Delete();
@@ -58,6 +71,8 @@ vtkPlusImageProcessorVideoSource::~vtkPlusImageProcessorVideoSource()
 void vtkPlusImageProcessorVideoSource::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfProcessingThreads: " << this->NumberOfProcessingThreads << std::endl;
+  os << indent << "ProcessingQueueLength: " << this->ProcessingQueueLength << std::endl;
 }
 
 //----------------------------------------------------------------------------
@@ -65,6 +80,18 @@ PlusStatus vtkPlusImageProcessorVideoSource::ReadConfiguration(vtkXMLDataElement
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableProcessing, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfProcessingThreads, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, ProcessingQueueLength, deviceConfig);
+  if (this->NumberOfProcessingThreads < 0)
+  {
+    LOG_WARNING("NumberOfProcessingThreads must be non-negative. Frames are processed in the internal update thread.");
+    this->NumberOfProcessingThreads = 0;
+  }
+  if (this->ProcessingQueueLength < 1)
+  {
+    LOG_WARNING("ProcessingQueueLength must be positive. Using queue length of 1.");
+    this->ProcessingQueueLength = 1;
+  }
 
   // Read transform repository configuration
   if (this->TransformRepository->ReadConfiguration(rootConfigElement) != PLUS_SUCCESS)
@@ -79,6 +106,7 @@ PlusStatus vtkPlusImageProcessorVideoSource::ReadConfiguration(vtkXMLDataElement
     this->ProcessorAlgorithm->Delete();
     this->ProcessorAlgorithm = NULL;
   }
+  this->WorkerProcessors.clear();
   int numberOfNestedElements = deviceConfig->GetNumberOfNestedElements();
   for (int nestedElemIndex = 0; nestedElemIndex < numberOfNestedElements; ++nestedElemIndex)
   {
@@ -96,48 +124,92 @@ PlusStatus vtkPlusImageProcessorVideoSource::ReadConfiguration(vtkXMLDataElement
       break;
     }
 
-    // Verify type
-    const char* processorType = processorElement->GetAttribute("Type");
-    if (processorType == NULL)
+    this->ProcessorAlgorithm = this->CreateProcessor(processorElement, this->TransformRepository);
+    if (this->ProcessorAlgorithm == NULL)
     {
-      LOG_ERROR("Type attribute of Processor element is missing");
       return PLUS_FAIL;
     }
 
-    // Instantiate processor corresponding to the specified type
-    vtkSmartPointer<vtkPlusBoneEnhancer> boneEnhancer = vtkSmartPointer<vtkPlusBoneEnhancer>::New();
-    vtkSmartPointer<vtkPlusTransverseProcessEnhancer> TransverseProcessEnhancer = vtkSmartPointer<vtkPlusTransverseProcessEnhancer>::New();
-    if (!(STRCASECMP(boneEnhancer->GetProcessorTypeName(), processorType)))
-    {
-      boneEnhancer->SetTransformRepository(this->TransformRepository);
-      boneEnhancer->ReadConfiguration(processorElement);
-      this->ProcessorAlgorithm = boneEnhancer;
-      this->ProcessorAlgorithm->Register(this);
-      break;                  // If only one processor is allowed per ImageProcessor class, we can break out when we find it.
-    }
-    else if (!(STRCASECMP(TransverseProcessEnhancer->GetProcessorTypeName(), processorType)))
-    {
-      TransverseProcessEnhancer->SetTransformRepository(this->TransformRepository);
-      TransverseProcessEnhancer->ReadConfiguration(processorElement);
-      this->ProcessorAlgorithm = TransverseProcessEnhancer;
-      this->ProcessorAlgorithm->Register(this);
-      break;
-    }
-    else
+    // In pipelined mode each worker thread uses its own processor and transform repository,
+    // as processing a frame updates the transforms in the repository
+    for (int workerIndex = 0; workerIndex < this->NumberOfProcessingThreads; ++workerIndex)
     {
-      LOG_ERROR("Unknown processor type: " << processorType);
-      return PLUS_FAIL;
+      vtkSmartPointer<vtkIGSIOTransformRepository> workerTransformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+      if (workerTransformRepository->ReadConfiguration(rootConfigElement) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to read transform repository configuration for processing thread " << workerIndex);
+        return PLUS_FAIL;
+      }
+      vtkSmartPointer<vtkPlusTrackedFrameProcessor> workerProcessor = vtkSmartPointer<vtkPlusTrackedFrameProcessor>::Take(this->CreateProcessor(processorElement, workerTransformRepository));
+      if (workerProcessor == NULL)
+      {
+        return PLUS_FAIL;
+      }
+      this->WorkerProcessors.push_back(workerProcessor);
     }
+    break; // If only one processor is allowed per ImageProcessor class, we can break out when we find it.
   }
 
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+vtkPlusTrackedFrameProcessor* vtkPlusImageProcessorVideoSource::CreateProcessor(vtkXMLDataElement* processorElement, vtkIGSIOTransformRepository* transformRepository)
+{
+  // Verify type
+  const char* processorType = processorElement->GetAttribute("Type");
+  if (processorType == NULL)
+  {
+    LOG_ERROR("Type attribute of Processor element is missing");
+    return NULL;
+  }
+
+  // Instantiate processor corresponding to the specified type
+  vtkPlusTrackedFrameProcessor* processor = NULL;
+  vtkSmartPointer<vtkPlusBoneEnhancer> boneEnhancer = vtkSmartPointer<vtkPlusBoneEnhancer>::New();
+  vtkSmartPointer<vtkPlusTransverseProcessEnhancer> TransverseProcessEnhancer = vtkSmartPointer<vtkPlusTransverseProcessEnhancer>::New();
+  if (!(STRCASECMP(boneEnhancer->GetProcessorTypeName(), processorType)))
+  {
+    processor = boneEnhancer;
+  }
+  else if (!(STRCASECMP(TransverseProcessEnhancer->GetProcessorTypeName(), processorType)))
+  {
+    processor = TransverseProcessEnhancer;
+  }
+  else
+  {
+    LOG_ERROR("Unknown processor type: " << processorType);
+    return NULL;
+  }
+
+  processor->SetTransformRepository(transformRepository);
+  processor->ReadConfiguration(processorElement);
+  // The caller owns the returned reference
+  processor->Register(this);
+  return processor;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusImageProcessorVideoSource::WriteConfiguration(vtkXMLDataElement* rootConfig)
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceElement, rootConfig);
   deviceElement->SetAttribute("EnableCapturing", this->EnableProcessing ? "TRUE" : "FALSE");
+  if (this->NumberOfProcessingThreads != DEFAULT_NUMBER_OF_PROCESSING_THREADS)
+  {
+    deviceElement->SetIntAttribute("NumberOfProcessingThreads", this->NumberOfProcessingThreads);
+  }
+  else
+  {
+    deviceElement->RemoveAttribute("NumberOfProcessingThreads");
+  }
+  if (this->ProcessingQueueLength != DEFAULT_PROCESSING_QUEUE_LENGTH)
+  {
+    deviceElement->SetIntAttribute("ProcessingQueueLength", this->ProcessingQueueLength);
+  }
+  else
+  {
+    deviceElement->RemoveAttribute("ProcessingQueueLength");
+  }
 
   // Write processor elements
   if (this->ProcessorAlgorithm != NULL)
@@ -194,11 +266,67 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalConnect()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusImageProcessorVideoSource::InternalDisconnect()
 {
+  this->StopProcessingThreads();
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->ProcessingAlgorithmAccessMutex);
   this->EnableProcessing = false;
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusImageProcessorVideoSource::InternalStartRecording()
+{
+  if (this->NumberOfProcessingThreads <= 0)
+  {
+    return PLUS_SUCCESS;
+  }
+  if (this->WorkerProcessors.size() != static_cast<size_t>(this->NumberOfProcessingThreads))
+  {
+    LOG_ERROR("Processors are not available for " << this->NumberOfProcessingThreads << " processing threads. Check the Processor element in the configuration.");
+    return PLUS_FAIL;
+  }
+
+  this->StopProcessingThreads();
+  this->StopProcessingRequested = false;
+  this->LastQueuedInputDataTimestamp = UNDEFINED_TIMESTAMP;
+  for (int workerIndex = 0; workerIndex < this->NumberOfProcessingThreads; ++workerIndex)
+  {
+    this->WorkerThreads.push_back(std::thread(&vtkPlusImageProcessorVideoSource::ProcessingThread, this, workerIndex));
+  }
+  LOG_DEBUG("Started " << this->NumberOfProcessingThreads << " processing threads. Device ID: " << this->GetDeviceId());
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusImageProcessorVideoSource::InternalStopRecording()
+{
+  this->StopProcessingThreads();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusImageProcessorVideoSource::StopProcessingThreads()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->InputQueueMutex);
+    this->StopProcessingRequested = true;
+    this->InputQueue.clear();
+  }
+  this->InputQueued.notify_all();
+  for (std::vector<std::thread>::iterator threadIt = this->WorkerThreads.begin(); threadIt != this->WorkerThreads.end(); ++threadIt)
+  {
+    if (threadIt->joinable())
+    {
+      threadIt->join();
+    }
+  }
+  this->WorkerThreads.clear();
+
+  std::lock_guard<std::mutex> lock(this->OutputMutex);
+  this->CompletedFrames.clear();
+  this->NextSequenceNumberToQueue = 0;
+  this->NextSequenceNumberToOutput = 0;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
 {
@@ -225,6 +353,19 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
     LOG_DYNAMIC("Processed data is not generated, as no video data is available yet. Device ID: " << this->GetDeviceId(), this->GracePeriodLogLevel);
     return PLUS_SUCCESS;
   }
+
+  if (this->OutputChannels.empty())
+  {
+    LOG_ERROR("No output channels defined");
+    return PLUS_FAIL;
+  }
+
+  if (this->NumberOfProcessingThreads > 0)
+  {
+    // Pipelined mode, frames are processed and added to the output by the processing threads
+    return this->QueueInputFrames();
+  }
+
   double oldestTrackingTimestamp(0);
   if (this->InputChannels[0]->GetOldestTimestamp(oldestTrackingTimestamp) == PLUS_SUCCESS)
   {
@@ -245,11 +386,6 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
 
   LOG_TRACE("Image to be processed: timestamp=" << trackedFrame.GetTimestamp());
 
-  if (this->OutputChannels.empty())
-  {
-    LOG_ERROR("No output channels defined");
-    return PLUS_FAIL;
-  }
   vtkPlusChannel* outputChannel = this->OutputChannels[0];
   double latestFrameAlreadyAddedTimestamp = 0;
   outputChannel->GetMostRecentTimestamp(latestFrameAlreadyAddedTimestamp);
@@ -269,6 +405,20 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
     return PLUS_FAIL;
   }
 
+  vtkIGSIOTrackedFrameList* processedFrames = this->ProcessorAlgorithm->GetOutputFrames();
+  if (processedFrames == NULL || processedFrames->GetNumberOfTrackedFrames() < 1)
+  {
+    LOG_ERROR("Failed to retrieve processed frame");
+    return PLUS_FAIL;
+  }
+
+  return this->AddProcessedFrameToOutput(processedFrames->GetTrackedFrame(0), frameTimestamp);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusImageProcessorVideoSource::AddProcessedFrameToOutput(igsioTrackedFrame* processedTrackedFrame, double frameTimestamp)
+{
+  vtkPlusChannel* outputChannel = this->OutputChannels[0];
   vtkPlusDataSource* aSource(NULL);
   if (outputChannel->GetVideoSource(aSource) != PLUS_SUCCESS)
   {
@@ -276,16 +426,16 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
     return PLUS_FAIL;
   }
 
-  PlusStatus status = PLUS_SUCCESS;
-
-  vtkIGSIOTrackedFrameList* processedFrames = this->ProcessorAlgorithm->GetOutputFrames();
-  if (processedFrames == NULL || processedFrames->GetNumberOfTrackedFrames() < 1)
+  double latestFrameAlreadyAddedTimestamp = 0;
+  if (aSource->GetNumberOfItems() > 0 && aSource->GetLatestTimeStamp(latestFrameAlreadyAddedTimestamp) == ITEM_OK && latestFrameAlreadyAddedTimestamp >= frameTimestamp)
   {
-    LOG_ERROR("Failed to retrieve processed frame");
-    return PLUS_FAIL;
+    // output timestamps must be monotonic
+    LOG_DEBUG("Processed frame is not added to the output, as a frame with the same or later timestamp is already added (" << std::fixed << frameTimestamp << ")");
+    return PLUS_SUCCESS;
   }
 
-  igsioTrackedFrame* processedTrackedFrame = processedFrames->GetTrackedFrame(0);
+  PlusStatus status = PLUS_SUCCESS;
+
   // Generate unique frame number (not used for filtering, so the actual increment value does not matter)
   this->FrameNumber++;
 
@@ -320,6 +470,134 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
   return status;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusImageProcessorVideoSource::QueueInputFrames()
+{
+  // Limit the number of frames that are queued, being processed, or waiting for an earlier frame to complete
+  unsigned long maxNumberOfFramesInProgress = this->ProcessingQueueLength + this->NumberOfProcessingThreads;
+  unsigned long numberOfFramesInProgress = 0;
+  {
+    std::lock_guard<std::mutex> lock(this->OutputMutex);
+    numberOfFramesInProgress = this->NextSequenceNumberToQueue - this->NextSequenceNumberToOutput;
+  }
+  if (numberOfFramesInProgress >= maxNumberOfFramesInProgress)
+  {
+    // the new frames are kept in the input buffer until there is space in the queue
+    return PLUS_SUCCESS;
+  }
+
+  double oldestInputTimestamp(0);
+  if (this->LastQueuedInputDataTimestamp != UNDEFINED_TIMESTAMP
+      && this->InputChannels[0]->GetOldestTimestamp(oldestInputTimestamp) == PLUS_SUCCESS
+      && this->LastQueuedInputDataTimestamp < oldestInputTimestamp)
+  {
+    LOG_WARNING("Image processing cannot keep up with the input. Frames acquired between " << std::fixed << this->LastQueuedInputDataTimestamp << "-" << oldestInputTimestamp
+                << " sec are not processed. Device ID: " << this->GetDeviceId());
+    this->LastQueuedInputDataTimestamp = UNDEFINED_TIMESTAMP;
+  }
+
+  for (unsigned long frameIndex = numberOfFramesInProgress; frameIndex < maxNumberOfFramesInProgress; ++frameIndex)
+  {
+    // Each frame is put in a separate list, as processors take a list as input. Image data is shared with the input buffer (processors do not modify input frames).
+    ProcessingQueueItem item;
+    item.InputFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (this->InputChannels[0]->GetTrackedFrameList(this->LastQueuedInputDataTimestamp, item.InputFrames, 1, true) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Error while getting input frames for processing. Last queued timestamp: " << std::fixed << this->LastQueuedInputDataTimestamp << ". Device ID: " << this->GetDeviceId());
+      this->LastQueuedInputDataTimestamp = UNDEFINED_TIMESTAMP; // forget about the past, try to process frames that are acquired from now on
+      return PLUS_FAIL;
+    }
+    if (item.InputFrames->GetNumberOfTrackedFrames() == 0)
+    {
+      // no more new frames
+      break;
+    }
+    item.SequenceNumber = this->NextSequenceNumberToQueue++;
+    {
+      std::lock_guard<std::mutex> lock(this->InputQueueMutex);
+      this->InputQueue.push_back(item);
+    }
+    this->InputQueued.notify_one();
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusImageProcessorVideoSource::ProcessingThread(int workerIndex)
+{
+  vtkPlusTrackedFrameProcessor* processor = this->WorkerProcessors[workerIndex];
+  while (true)
+  {
+    ProcessingQueueItem item;
+    {
+      std::unique_lock<std::mutex> lock(this->InputQueueMutex);
+      this->InputQueued.wait(lock, [this]()
+      {
+        return this->StopProcessingRequested || !this->InputQueue.empty();
+      });
+      if (this->StopProcessingRequested)
+      {
+        break;
+      }
+      item = this->InputQueue.front();
+      this->InputQueue.pop_front();
+    }
+
+    double frameTimestamp = item.InputFrames->GetTrackedFrame(0)->GetTimestamp();
+    LOG_TRACE("Image to be processed by thread " << workerIndex << ": timestamp=" << frameTimestamp);
+
+    igsioTrackedFrame* processedTrackedFrame = NULL;
+    processor->SetInputFrames(item.InputFrames);
+    if (processor->Update() == PLUS_SUCCESS && processor->GetOutputFrames() != NULL && processor->GetOutputFrames()->GetNumberOfTrackedFrames() > 0)
+    {
+      processedTrackedFrame = processor->GetOutputFrames()->GetTrackedFrame(0);
+    }
+    else
+    {
+      LOG_ERROR("Failed to process frame (timestamp: " << std::fixed << frameTimestamp << "). Device ID: " << this->GetDeviceId());
+    }
+
+    std::lock_guard<std::mutex> lock(this->OutputMutex);
+    if (item.SequenceNumber == this->NextSequenceNumberToOutput)
+    {
+      // All earlier frames are already in the output, so this frame can be added without making a copy
+      if (processedTrackedFrame != NULL)
+      {
+        this->AddProcessedFrameToOutput(processedTrackedFrame, frameTimestamp);
+      }
+      this->NextSequenceNumberToOutput++;
+      this->AddCompletedFramesToOutput();
+    }
+    else
+    {
+      // The processor reuses its output frame list, so the frame is copied until it can be added to the output
+      std::shared_ptr<igsioTrackedFrame> completedFrame;
+      if (processedTrackedFrame != NULL)
+      {
+        completedFrame.reset(new igsioTrackedFrame(*processedTrackedFrame));
+        completedFrame->SetTimestamp(frameTimestamp);
+      }
+      this->CompletedFrames[item.SequenceNumber] = completedFrame;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusImageProcessorVideoSource::AddCompletedFramesToOutput()
+{
+  std::map<unsigned long, std::shared_ptr<igsioTrackedFrame> >::iterator completedFrameIt;
+  while ((completedFrameIt = this->CompletedFrames.find(this->NextSequenceNumberToOutput)) != this->CompletedFrames.end())
+  {
+    if (completedFrameIt->second)
+    {
+      this->AddProcessedFrameToOutput(completedFrameIt->second.get(), completedFrameIt->second->GetTimestamp());
+    }
+    this->CompletedFrames.erase(completedFrameIt);
+    this->NextSequenceNumberToOutput++;
+  }
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusImageProcessorVideoSource::NotifyConfigured()
 {
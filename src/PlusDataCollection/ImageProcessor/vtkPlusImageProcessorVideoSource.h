@@ -10,7 +10,15 @@ See License.txt for details.
 #include "vtkPlusDataCollectionExport.h"
 
 #include "vtkPlusDevice.h"
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <vector>
 
 //class vtkIGSIOTransformRepository;
 class vtkPlusTrackedFrameProcessor;
@@ -19,6 +27,16 @@ class vtkPlusTrackedFrameProcessor;
 \class vtkPlusImageProcessorVideoSource 
 \brief Virtual device that performs real-time image processing on the input channel
 
+By default (NumberOfProcessingThreads="0") the latest input frame is processed in the internal update thread,
+therefore frames that arrive while a frame is being processed are skipped.
+
+If NumberOfProcessingThreads is positive then the device works in pipelined mode: all input frames are queued
+and processed by a pool of worker threads, each of them using its own processor instance (and transform repository).
+Processed frames are added to the output buffer in the order of the input frames, so output timestamps are monotonic.
+At most ProcessingQueueLength frames are waiting for a free worker. If the workers cannot keep up with the input
+then frames are kept in the input buffer until there is space in the queue; frames that are removed from the input
+buffer before they could be queued are skipped.
+
 \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusImageProcessorVideoSource : public vtkPlusDevice
@@ -42,6 +60,14 @@ public:
   vtkGetMacro(EnableProcessing, bool);
   void SetEnableProcessing(bool aValue);
 
+  /*! Number of worker threads in pipelined mode. If 0 then the latest frame is processed in the internal update thread. Takes effect at the next ReadConfiguration. */
+  vtkSetMacro(NumberOfProcessingThreads, int);
+  vtkGetMacro(NumberOfProcessingThreads, int);
+
+  /*! Maximum number of frames waiting for a worker thread in pipelined mode */
+  vtkSetMacro(ProcessingQueueLength, int);
+  vtkGetMacro(ProcessingQueueLength, int);
+
   virtual bool IsTracker() const { return false; }
   virtual bool IsVirtual() const { return true; }
 
@@ -49,6 +75,29 @@ protected:
   virtual PlusStatus InternalConnect();
   virtual PlusStatus InternalDisconnect();
 
+  /*! Starts the worker threads in pipelined mode */
+  virtual PlusStatus InternalStartRecording();
+
+  /*! Stops the worker threads in pipelined mode, frames that are not processed yet are discarded */
+  virtual PlusStatus InternalStopRecording();
+
+  /*! Instantiate a processor from a Processor element. Returns NULL if the type is unknown. */
+  vtkPlusTrackedFrameProcessor* CreateProcessor(vtkXMLDataElement* processorElement, vtkIGSIOTransformRepository* transformRepository);
+
+  /*! Add a processed frame to the video source of the output channel. Frames that are not newer than the latest output frame are ignored. */
+  PlusStatus AddProcessedFrameToOutput(igsioTrackedFrame* processedTrackedFrame, double frameTimestamp);
+
+  /*! Pipelined mode: get the new input frames and add them to the processing queue */
+  PlusStatus QueueInputFrames();
+
+  /*! Pipelined mode: process frames from the queue until StopProcessingThreads is called */
+  void ProcessingThread(int workerIndex);
+
+  /*! Pipelined mode: add completed frames to the output in the order of the input. Must be called with OutputMutex locked. */
+  void AddCompletedFramesToOutput();
+
+  void StopProcessingThreads();
+
   vtkPlusImageProcessorVideoSource();
   virtual ~vtkPlusImageProcessorVideoSource();
 
@@ -69,6 +118,36 @@ protected:
 
   vtkPlusTrackedFrameProcessor* ProcessorAlgorithm;
 
+  int NumberOfProcessingThreads;
+  int ProcessingQueueLength;
+
+  struct ProcessingQueueItem
+  {
+    ProcessingQueueItem() : SequenceNumber(0) {}
+    unsigned long SequenceNumber;
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> InputFrames;
+  };
+
+  /*! Processor instances of the worker threads, each of them has its own transform repository */
+  std::vector< vtkSmartPointer<vtkPlusTrackedFrameProcessor> > WorkerProcessors;
+  std::vector<std::thread> WorkerThreads;
+
+  /*! Timestamp of the most recent input frame that has been queued for processing */
+  double LastQueuedInputDataTimestamp;
+
+  std::mutex InputQueueMutex;
+  /*! Signaled when a frame is added to the input queue or stop is requested */
+  std::condition_variable InputQueued;
+  std::deque<ProcessingQueueItem> InputQueue;
+  bool StopProcessingRequested;
+
+  /*! Protects the completed frames, the output sequence number, and writing of the output buffer in pipelined mode */
+  std::mutex OutputMutex;
+  /*! Processed frames that cannot be added to the output yet, because a frame that was queued before is still being processed. NULL if processing failed. */
+  std::map<unsigned long, std::shared_ptr<igsioTrackedFrame> > CompletedFrames;
+  unsigned long NextSequenceNumberToQueue;
+  unsigned long NextSequenceNumberToOutput;
+
 private:
   vtkPlusImageProcessorVideoSource(const vtkPlusImageProcessorVideoSource&);  // Not implemented.
   void operator=(const vtkPlusImageProcessorVideoSource&);  // Not implemented. 
@@ -0,0 +1,55 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusNewDataNotifier.h"
+
+// STL includes
+#include <chrono>
+
+//----------------------------------------------------------------------------
+PlusNewDataNotifier::PlusNewDataNotifier()
+  : SequenceNumber(0)
+{
+
+}
+
+//----------------------------------------------------------------------------
+PlusNewDataNotifier::~PlusNewDataNotifier()
+{
+
+}
+
+//----------------------------------------------------------------------------
+void PlusNewDataNotifier::Notify()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->SequenceNumber++;
+  }
+  this->NewDataAvailable.notify_all();
+}
+
+//----------------------------------------------------------------------------
+bool PlusNewDataNotifier::WaitForNewData(unsigned long long& lastSequenceNumber, double timeoutSec)
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  if (timeoutSec > 0)
+  {
+    std::chrono::duration<double> timeout(timeoutSec);
+    this->NewDataAvailable.wait_for(lock, timeout, [this, lastSequenceNumber] { return this->SequenceNumber != lastSequenceNumber; });
+  }
+  bool newDataAvailable = (this->SequenceNumber != lastSequenceNumber);
+  lastSequenceNumber = this->SequenceNumber;
+  return newDataAvailable;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long PlusNewDataNotifier::GetSequenceNumber() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->SequenceNumber;
+}
@@ -0,0 +1,59 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusNewDataNotifier_h
+#define __PlusNewDataNotifier_h
+
+#include "vtkPlusDataCollectionExport.h"
+
+// STL includes
+#include <condition_variable>
+#include <mutex>
+
+/*!
+  \class PlusNewDataNotifier
+  \brief Wakes up threads that are waiting for new items in one or more buffers
+
+  The notifier is registered in buffers (see vtkPlusBuffer::AddNewDataNotifier), which call Notify
+  each time a new item is added. Consumers call WaitForNewData instead of polling the buffers
+  periodically, so that they can process new data immediately after it is acquired.
+
+  Each notification increments a sequence number. Consumers keep the sequence number that they saw last,
+  so notifications that arrive while the consumer is busy (not waiting) are not lost.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusNewDataNotifier
+{
+public:
+  PlusNewDataNotifier();
+  virtual ~PlusNewDataNotifier();
+
+  /*! Signal that new data is available and wake up all waiting threads */
+  virtual void Notify();
+
+  /*!
+    Wait until new data is available or timeout elapses
+    \param lastSequenceNumber In: the sequence number returned by the previous call (0 if this is the first call). Out: the current sequence number.
+    \param timeoutSec Maximum time to wait, in seconds
+    \return true if new data became available since lastSequenceNumber, false if the timeout elapsed
+  */
+  bool WaitForNewData(unsigned long long& lastSequenceNumber, double timeoutSec);
+
+  /*! Get the number of notifications so far */
+  unsigned long long GetSequenceNumber() const;
+
+protected:
+  mutable std::mutex Mutex;
+  std::condition_variable NewDataAvailable;
+  unsigned long long SequenceNumber;
+
+private:
+  PlusNewDataNotifier(const PlusNewDataNotifier&);
+  void operator=(const PlusNewDataNotifier&);
+};
+
+#endif
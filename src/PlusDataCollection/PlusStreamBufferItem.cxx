@@ -6,7 +6,20 @@
 
 #include "PlusConfigure.h"
 #include "PlusStreamBufferItem.h"
+#include "vtkDataArray.h"
+#include "vtkImageData.h"
+#include "vtkMath.h"
 #include "vtkMatrix4x4.h"
+#include "vtkPointData.h"
+
+// STL includes
+#include <algorithm>
+
+namespace
+{
+  const double IDENTITY_MATRIX_ELEMENTS[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+  const double IDENTITY_QUATERNION[4] = { 1, 0, 0, 0 };
+}
 
 //----------------------------------------------------------------------------
 //            DataBufferItem
@@ -16,10 +29,11 @@ StreamBufferItem::StreamBufferItem()
   , UnfilteredTimeStamp(0)
   , Index(0)
   , Uid(0)
-  , ValidTransformData(false)
-  , Matrix(vtkSmartPointer<vtkMatrix4x4>::New())
   , Status(TOOL_OK)
+  , ValidTransformData(false)
 {
+  std::copy(IDENTITY_MATRIX_ELEMENTS, IDENTITY_MATRIX_ELEMENTS + 16, this->MatrixElements);
+  std::copy(IDENTITY_QUATERNION, IDENTITY_QUATERNION + 4, this->RotationQuaternion);
 }
 
 //----------------------------------------------------------------------------
@@ -30,7 +44,8 @@ StreamBufferItem::~StreamBufferItem()
 //----------------------------------------------------------------------------
 StreamBufferItem::StreamBufferItem(const StreamBufferItem& dataItem)
 {
-  this->Matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  std::copy(IDENTITY_MATRIX_ELEMENTS, IDENTITY_MATRIX_ELEMENTS + 16, this->MatrixElements);
+  std::copy(IDENTITY_QUATERNION, IDENTITY_QUATERNION + 4, this->RotationQuaternion);
   this->Status = TOOL_OK;
   *this = dataItem;
 }
@@ -51,7 +66,8 @@ StreamBufferItem& StreamBufferItem::operator=(StreamBufferItem const& dataItem)
   this->Uid = dataItem.Uid;
   this->FrameFields = dataItem.FrameFields;
   this->Status = dataItem.Status;
-  this->Matrix->DeepCopy(dataItem.Matrix);
+  std::copy(dataItem.MatrixElements, dataItem.MatrixElements + 16, this->MatrixElements);
+  std::copy(dataItem.RotationQuaternion, dataItem.RotationQuaternion + 4, this->RotationQuaternion);
   this->ValidTransformData = dataItem.ValidTransformData;
 
   return *this;
@@ -121,6 +137,98 @@ PlusStatus StreamBufferItem::DeepCopy(StreamBufferItem* dataItem)
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus StreamBufferItem::ShallowCopy(StreamBufferItem* dataItem)
+{
+  if (dataItem == NULL)
+  {
+    LOG_ERROR("Failed to shallow copy data buffer item - buffer item NULL!");
+    return PLUS_FAIL;
+  }
+
+  if (this == dataItem)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  if (StreamBufferItem::ShareFrame(dataItem->Frame, this->Frame) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  this->FilteredTimeStamp = dataItem->FilteredTimeStamp;
+  this->UnfilteredTimeStamp = dataItem->UnfilteredTimeStamp;
+  this->Index = dataItem->Index;
+  this->Uid = dataItem->Uid;
+  this->FrameFields = dataItem->FrameFields;
+  this->Status = dataItem->Status;
+  std::copy(dataItem->MatrixElements, dataItem->MatrixElements + 16, this->MatrixElements);
+  std::copy(dataItem->RotationQuaternion, dataItem->RotationQuaternion + 4, this->RotationQuaternion);
+  this->ValidTransformData = dataItem->ValidTransformData;
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus StreamBufferItem::ShareFrame(igsioVideoFrame& sourceFrame, igsioVideoFrame& targetFrame)
+{
+  if (&sourceFrame == &targetFrame)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  if (sourceFrame.IsFrameEncoded() || sourceFrame.GetImage() == NULL)
+  {
+    // encoded frames are not modified in place, so a regular copy only copies the reference to the encoded frame
+    targetFrame = sourceFrame;
+    return PLUS_SUCCESS;
+  }
+
+  if (targetFrame.GetImage() == NULL)
+  {
+    // The frame creates its image object when it is allocated. Allocation does not touch the memory and the
+    // allocated scalars are released when the pixel data is shared, so this does not cost memory bandwidth.
+    FrameSizeType frameSize = { 0, 0, 0 };
+    sourceFrame.GetFrameSize(frameSize);
+    unsigned int numberOfScalarComponents(1);
+    sourceFrame.GetNumberOfScalarComponents(numberOfScalarComponents);
+    if (targetFrame.AllocateFrame(frameSize, sourceFrame.GetVTKScalarPixelType(), numberOfScalarComponents) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to share video frame - target frame cannot be allocated");
+      return PLUS_FAIL;
+    }
+  }
+
+  targetFrame.GetImage()->ShallowCopy(sourceFrame.GetImage());
+  targetFrame.SetImageType(sourceFrame.GetImageType());
+  targetFrame.SetImageOrientation(sourceFrame.GetImageOrientation());
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool StreamBufferItem::DetachSharedFrameData()
+{
+  vtkImageData* image = this->Frame.GetImage();
+  if (image == NULL || image->GetPointData() == NULL)
+  {
+    return false;
+  }
+  vtkDataArray* sharedScalars = image->GetPointData()->GetScalars();
+  if (sharedScalars == NULL || sharedScalars->GetReferenceCount() <= 1)
+  {
+    // only this frame refers to the pixel data, it can be overwritten
+    return false;
+  }
+
+  // Somebody else still uses the pixel data. Leave it to them and use a new block for this item.
+  vtkSmartPointer<vtkDataArray> scalars = vtkSmartPointer<vtkDataArray>::Take(sharedScalars->NewInstance());
+  scalars->SetName(sharedScalars->GetName());
+  scalars->SetNumberOfComponents(sharedScalars->GetNumberOfComponents());
+  scalars->SetNumberOfTuples(sharedScalars->GetNumberOfTuples());
+  image->GetPointData()->SetScalars(scalars);
+  return true;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus StreamBufferItem::SetMatrix(vtkMatrix4x4* matrix)
 {
@@ -130,9 +238,36 @@ PlusStatus StreamBufferItem::SetMatrix(vtkMatrix4x4* matrix)
     return PLUS_FAIL;
   }
 
+  return this->SetMatrixElements(&matrix->Element[0][0]);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus StreamBufferItem::SetMatrixElements(const double elements[16], const double rotationQuaternion[4] /*=NULL*/)
+{
+  if (elements == NULL)
+  {
+    LOG_ERROR("Failed to set matrix - input matrix elements are NULL!");
+    return PLUS_FAIL;
+  }
+
   ValidTransformData = true;
 
-  this->Matrix->DeepCopy(matrix);
+  std::copy(elements, elements + 16, this->MatrixElements);
+
+  if (rotationQuaternion != NULL)
+  {
+    std::copy(rotationQuaternion, rotationQuaternion + 4, this->RotationQuaternion);
+  }
+  else
+  {
+    double rotation[3][3] =
+    {
+      { elements[0], elements[1], elements[2] },
+      { elements[4], elements[5], elements[6] },
+      { elements[8], elements[9], elements[10] }
+    };
+    vtkMath::Matrix3x3ToQuaternion(rotation, this->RotationQuaternion);
+  }
 
   return PLUS_SUCCESS;
 }
@@ -146,7 +281,7 @@ PlusStatus StreamBufferItem::GetMatrix(vtkMatrix4x4* outputMatrix)
     return PLUS_FAIL;
   }
 
-  outputMatrix->DeepCopy(this->Matrix);
+  outputMatrix->DeepCopy(this->MatrixElements);
 
   return PLUS_SUCCESS;
 }
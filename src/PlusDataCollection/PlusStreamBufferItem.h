@@ -85,6 +85,26 @@ public:
   /*! Copy stream buffer item */
   PlusStatus DeepCopy(StreamBufferItem* dataItem);
 
+  /*!
+    Copy stream buffer item, but share the pixel data of the video frame instead of copying it.
+    The shared pixel data must not be modified. The buffer allocates new pixel data for its slot
+    if the slot needs to be overwritten while the pixel data is still in use (see DetachSharedFrameData).
+  */
+  PlusStatus ShallowCopy(StreamBufferItem* dataItem);
+
+  /*!
+    Make targetFrame refer to the pixel data of sourceFrame (reference counted, no pixel data is copied).
+    Image type and orientation are copied.
+  */
+  static PlusStatus ShareFrame(igsioVideoFrame& sourceFrame, igsioVideoFrame& targetFrame);
+
+  /*!
+    If the pixel data of the video frame is shared with other frames then replace it by
+    a newly allocated (uninitialized) pixel data block, so that it can be overwritten.
+    Returns true if new pixel data had to be allocated.
+  */
+  bool DetachSharedFrameData();
+
   igsioVideoFrame& GetFrame() { return this->Frame; };
 
   /*! Set tracker matrix */
@@ -92,6 +112,24 @@ public:
   /*! Get tracker matrix */
   PlusStatus GetMatrix(vtkMatrix4x4* outputMatrix);
 
+  /*!
+    Set tracker matrix from 16 elements in row-major order (same layout as vtkMatrix4x4::Element).
+    If the rotation of the matrix is already known as a unit quaternion (w, x, y, z) then it can be passed in rotationQuaternion,
+    otherwise it is computed from the matrix.
+  */
+  PlusStatus SetMatrixElements(const double elements[16], const double rotationQuaternion[4] = NULL);
+  /*!
+    Get the 16 elements of the tracker matrix in row-major order. The elements are stored in the item itself,
+    so no vtkMatrix4x4 has to be created for reading the pose.
+  */
+  const double* GetMatrixElements() const { return this->MatrixElements; }
+
+  /*!
+    Get the rotation part of the tracker matrix as a unit quaternion (w, x, y, z). It is computed when the matrix is set,
+    so that interpolation between items does not have to convert matrices to quaternions on every lookup.
+  */
+  const double* GetRotationQuaternion() const { return this->RotationQuaternion; }
+
   /*! Set tracker item status */
   void SetStatus(ToolStatus status);
   /*! Get tracker item status */
@@ -115,13 +153,22 @@ protected:
   /*! unique identifier assigned by the storage buffer, it is guaranteed to increase monotonously, by one for each frame that is added to the buffer*/
   BufferItemUidType Uid;
 
+  /*!
+    Tracker matrix elements in row-major order. Stored in the item itself (instead of a separately allocated vtkMatrix4x4),
+    so that reading the pose of an item does not need an additional pointer dereference and copying an item does not allocate.
+    Note that the items are not contiguous in the buffer (they are stored in a std::deque, or in separately allocated
+    shared items in lock-free mode), so this does not give a contiguous array of poses.
+  */
+  double MatrixElements[16];
+  /*! Rotation part of MatrixElements as a unit quaternion (w, x, y, z) */
+  double RotationQuaternion[4];
+  ToolStatus Status;
+
   /*! Custom frame fields */
   igsioFieldMapType FrameFields;
 
   bool ValidTransformData;
   igsioVideoFrame Frame;
-  vtkSmartPointer<vtkMatrix4x4> Matrix;
-  ToolStatus Status;
 };
 
 #endif
@@ -0,0 +1,327 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusNewDataNotifier.h"
+#include "PlusVirtualDeviceExecutor.h"
+#include "vtkPlusBuffer.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusDevice.h"
+
+// IGSIO includes
+#include <vtkIGSIORecursiveCriticalSection.h>
+
+// VTK includes
+#include <vtkWindows.h>
+
+// STL includes
+#include <algorithm>
+
+// System includes
+#if defined(__linux__)
+  #include <time.h>
+#endif
+
+//----------------------------------------------------------------------------
+/*! Forwards the notifications of the input channel buffers to the executor */
+class PlusVirtualDeviceExecutor::EntryNotifier : public PlusNewDataNotifier
+{
+public:
+  EntryNotifier(PlusVirtualDeviceExecutor* executor, DeviceEntry* entry)
+    : Executor(executor)
+    , Entry(entry)
+  {
+  }
+
+  virtual void Notify()
+  {
+    this->Executor->OnNewData(this->Entry);
+  }
+
+protected:
+  PlusVirtualDeviceExecutor* Executor;
+  DeviceEntry* Entry;
+};
+
+//----------------------------------------------------------------------------
+PlusVirtualDeviceExecutor::PlusVirtualDeviceExecutor(unsigned int numberOfThreads, double idleUpdatePeriodSec)
+  : IdleUpdatePeriod(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(idleUpdatePeriodSec)))
+  , IdleUpdatePeriodSec(idleUpdatePeriodSec)
+  , StopRequested(false)
+{
+  numberOfThreads = std::max(numberOfThreads, 1u);
+  for (unsigned int i = 0; i < numberOfThreads; ++i)
+  {
+    this->Threads.push_back(std::thread(&PlusVirtualDeviceExecutor::WorkerThread, this));
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusVirtualDeviceExecutor::~PlusVirtualDeviceExecutor()
+{
+  std::vector<vtkPlusDevice*> remainingDevices;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    for (std::vector<std::shared_ptr<DeviceEntry> >::iterator it = this->Entries.begin(); it != this->Entries.end(); ++it)
+    {
+      remainingDevices.push_back((*it)->Device);
+    }
+  }
+  for (std::vector<vtkPlusDevice*>::iterator it = remainingDevices.begin(); it != remainingDevices.end(); ++it)
+  {
+    this->RemoveDevice(*it);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    this->StopRequested = true;
+  }
+  this->ScheduleChanged.notify_all();
+  for (std::vector<std::thread>::iterator it = this->Threads.begin(); it != this->Threads.end(); ++it)
+  {
+    it->join();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusVirtualDeviceExecutor::AddDevice(vtkPlusDevice* device)
+{
+  if (device == NULL)
+  {
+    LOG_ERROR("PlusVirtualDeviceExecutor::AddDevice failed: invalid device");
+    return PLUS_FAIL;
+  }
+
+  std::shared_ptr<DeviceEntry> entry = std::make_shared<DeviceEntry>();
+  entry->Device = device;
+  double acquisitionRate = device->GetAcquisitionRate();
+  entry->MinUpdatePeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(acquisitionRate > 0 ? 1.0 / acquisitionRate : 0.0));
+  entry->LastUpdateTime = Clock::now();
+  // Perform the first update immediately, as the devices may expect it right after recording is started
+  entry->NextUpdateTime = entry->LastUpdateTime;
+  entry->NewDataPending = false;
+  entry->UpdateInProgress = false;
+  entry->Notifier = std::make_shared<EntryNotifier>(this, entry.get());
+
+  for (ChannelContainerConstIterator chanIt = device->GetInputChannelsStart(); chanIt != device->GetInputChannelsEnd(); ++chanIt)
+  {
+    vtkPlusChannel* channel = *chanIt;
+    std::vector<vtkPlusDataSource*> sources;
+    vtkPlusDataSource* videoSource = NULL;
+    if (channel->GetVideoSource(videoSource) == PLUS_SUCCESS && videoSource != NULL)
+    {
+      sources.push_back(videoSource);
+    }
+    for (DataSourceContainerConstIterator it = channel->GetToolsStartConstIterator(); it != channel->GetToolsEndConstIterator(); ++it)
+    {
+      sources.push_back(it->second);
+    }
+    for (DataSourceContainerConstIterator it = channel->GetFieldDataSourcesStartConstIterator(); it != channel->GetFieldDataSourcesEndConstIterator(); ++it)
+    {
+      sources.push_back(it->second);
+    }
+    for (std::vector<vtkPlusDataSource*>::iterator sourceIt = sources.begin(); sourceIt != sources.end(); ++sourceIt)
+    {
+      vtkPlusBuffer* buffer = (*sourceIt != NULL ? (*sourceIt)->GetBuffer() : NULL);
+      if (buffer != NULL && std::find(entry->Buffers.begin(), entry->Buffers.end(), buffer) == entry->Buffers.end())
+      {
+        entry->Buffers.push_back(buffer);
+      }
+    }
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    for (std::vector<std::shared_ptr<DeviceEntry> >::iterator it = this->Entries.begin(); it != this->Entries.end(); ++it)
+    {
+      if ((*it)->Device == device)
+      {
+        LOG_ERROR("PlusVirtualDeviceExecutor::AddDevice failed: device " << device->GetDeviceId() << " is already added");
+        return PLUS_FAIL;
+      }
+    }
+    this->Entries.push_back(entry);
+  }
+
+  // Register notifiers after the entry is added, as notifications may arrive immediately
+  for (std::vector<vtkPlusBuffer*>::iterator it = entry->Buffers.begin(); it != entry->Buffers.end(); ++it)
+  {
+    (*it)->AddNewDataNotifier(entry->Notifier);
+  }
+
+  this->ScheduleChanged.notify_all();
+  LOG_DEBUG("Device " << device->GetDeviceId() << " is updated by the shared virtual device executor (" << entry->Buffers.size() << " input buffers)");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusVirtualDeviceExecutor::RemoveDevice(vtkPlusDevice* device)
+{
+  std::shared_ptr<DeviceEntry> entry;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    for (std::vector<std::shared_ptr<DeviceEntry> >::iterator it = this->Entries.begin(); it != this->Entries.end(); ++it)
+    {
+      if ((*it)->Device == device)
+      {
+        entry = *it;
+        break;
+      }
+    }
+  }
+  if (entry == nullptr)
+  {
+    LOG_ERROR("PlusVirtualDeviceExecutor::RemoveDevice failed: device " << (device != NULL ? device->GetDeviceId() : std::string("(NULL)")) << " is not added");
+    return PLUS_FAIL;
+  }
+
+  // Buffers do not call the notifier after it is removed, so the entry is not accessed by any notification afterwards.
+  // The executor mutex must not be held here, as buffers hold their notifier lock while calling OnNewData.
+  for (std::vector<vtkPlusBuffer*>::iterator it = entry->Buffers.begin(); it != entry->Buffers.end(); ++it)
+  {
+    (*it)->RemoveNewDataNotifier(entry->Notifier);
+  }
+
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  this->ScheduleChanged.wait(lock, [&entry] { return !entry->UpdateInProgress; });
+  this->Entries.erase(std::remove(this->Entries.begin(), this->Entries.end(), entry), this->Entries.end());
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusVirtualDeviceExecutor::GetDeviceStatistics(vtkPlusDevice* device, double& cpuTimeSec, unsigned long& numberOfUpdates) const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  std::map<vtkPlusDevice*, DeviceStatistics>::const_iterator it = this->Statistics.find(device);
+  if (it == this->Statistics.end())
+  {
+    cpuTimeSec = 0.0;
+    numberOfUpdates = 0;
+    return PLUS_FAIL;
+  }
+  cpuTimeSec = it->second.CpuTimeSec;
+  numberOfUpdates = it->second.NumberOfUpdates;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusVirtualDeviceExecutor::GetNumberOfThreads() const
+{
+  return static_cast<unsigned int>(this->Threads.size());
+}
+
+//----------------------------------------------------------------------------
+double PlusVirtualDeviceExecutor::GetIdleUpdatePeriodSec() const
+{
+  return this->IdleUpdatePeriodSec;
+}
+
+//----------------------------------------------------------------------------
+void PlusVirtualDeviceExecutor::OnNewData(DeviceEntry* entry)
+{
+  bool scheduleChanged = false;
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    entry->NewDataPending = true;
+    if (!entry->UpdateInProgress)
+    {
+      // Update as soon as the minimum update period allows, if it is earlier than already scheduled
+      Clock::time_point updateTime = entry->LastUpdateTime + entry->MinUpdatePeriod;
+      if (updateTime < entry->NextUpdateTime)
+      {
+        entry->NextUpdateTime = updateTime;
+        scheduleChanged = true;
+      }
+    }
+    // If the update is in progress then the next update is scheduled when it completes
+  }
+  if (scheduleChanged)
+  {
+    // RemoveDevice waits on the same condition variable, so a single notification could be consumed by it
+    this->ScheduleChanged.notify_all();
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusVirtualDeviceExecutor::WorkerThread()
+{
+  std::unique_lock<std::mutex> lock(this->Mutex);
+  while (!this->StopRequested)
+  {
+    // Find the device that has been due for the longest time
+    std::shared_ptr<DeviceEntry> entry;
+    for (std::vector<std::shared_ptr<DeviceEntry> >::iterator it = this->Entries.begin(); it != this->Entries.end(); ++it)
+    {
+      if (!(*it)->UpdateInProgress && (entry == nullptr || (*it)->NextUpdateTime < entry->NextUpdateTime))
+      {
+        entry = *it;
+      }
+    }
+    if (entry == nullptr)
+    {
+      this->ScheduleChanged.wait(lock);
+      continue;
+    }
+    Clock::time_point now = Clock::now();
+    if (entry->NextUpdateTime > now)
+    {
+      this->ScheduleChanged.wait_until(lock, entry->NextUpdateTime);
+      continue;
+    }
+
+    entry->UpdateInProgress = true;
+    entry->NewDataPending = false;
+    entry->LastUpdateTime = now;
+    vtkPlusDevice* device = entry->Device;
+    lock.unlock();
+
+    const double cpuTimeStartSec = GetThreadCpuTimeSec();
+    {
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(device->UpdateMutex);
+      if (device->IsRecording())
+      {
+        device->InternalUpdate();
+        device->UpdateTime.Modified();
+      }
+    }
+    const double cpuTimeSec = GetThreadCpuTimeSec() - cpuTimeStartSec;
+
+    lock.lock();
+    DeviceStatistics& statistics = this->Statistics[device];
+    statistics.CpuTimeSec += cpuTimeSec;
+    statistics.NumberOfUpdates++;
+    entry->UpdateInProgress = false;
+    entry->NextUpdateTime = entry->LastUpdateTime + (entry->NewDataPending ? entry->MinUpdatePeriod : this->IdleUpdatePeriod);
+    // Wake up RemoveDevice and the workers that wait for a later update time
+    this->ScheduleChanged.notify_all();
+  }
+}
+
+//----------------------------------------------------------------------------
+double PlusVirtualDeviceExecutor::GetThreadCpuTimeSec()
+{
+#if defined(__linux__)
+  struct timespec cpuTime;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpuTime) == 0)
+  {
+    return cpuTime.tv_sec + cpuTime.tv_nsec * 1e-9;
+  }
+#elif defined(_WIN32)
+  FILETIME creationTime, exitTime, kernelTime, userTime;
+  if (GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime))
+  {
+    ULARGE_INTEGER kernel, user;
+    kernel.LowPart = kernelTime.dwLowDateTime;
+    kernel.HighPart = kernelTime.dwHighDateTime;
+    user.LowPart = userTime.dwLowDateTime;
+    user.HighPart = userTime.dwHighDateTime;
+    // FILETIME is in 100 ns units
+    return (kernel.QuadPart + user.QuadPart) * 1e-7;
+  }
+#endif
+  return std::chrono::duration<double>(Clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,120 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusVirtualDeviceExecutor_h
+#define __PlusVirtualDeviceExecutor_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollectionExport.h"
+
+// STL includes
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PlusNewDataNotifier;
+class vtkPlusBuffer;
+class vtkPlusDevice;
+
+/*!
+  \class PlusVirtualDeviceExecutor
+  \brief Calls InternalUpdate of virtual devices from a small pool of shared threads
+
+  By default each device that has StartThreadForInternalUpdates enabled runs its own thread that calls InternalUpdate
+  at AcquisitionRate, even if no new data arrived on its input channels. Virtual devices that are added to this executor
+  are instead updated by the shared worker threads, when new data is added to any of the buffers of their input channels
+  (at most at AcquisitionRate), or after IdleUpdatePeriodSec if no new data arrived.
+
+  A device is never updated by more than one worker thread at a time. Among the devices that are due, the one that
+  has been due for the longest time is updated first. The CPU time spent in InternalUpdate is accounted per device.
+
+  \ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport PlusVirtualDeviceExecutor
+{
+public:
+  /*!
+    \param numberOfThreads Number of worker threads
+    \param idleUpdatePeriodSec Time after which a device is updated even if no new data arrived on its input channels
+  */
+  PlusVirtualDeviceExecutor(unsigned int numberOfThreads, double idleUpdatePeriodSec);
+  ~PlusVirtualDeviceExecutor();
+
+  /*! Start calling InternalUpdate of the device. The device must not run its own internal update thread. */
+  PlusStatus AddDevice(vtkPlusDevice* device);
+
+  /*! Stop calling InternalUpdate of the device. Waits for the completion of the update if it is in progress. */
+  PlusStatus RemoveDevice(vtkPlusDevice* device);
+
+  /*!
+    Get the CPU time spent in InternalUpdate and the number of updates of a device since it was first added.
+    The CPU time is measured by the thread CPU clock where available, otherwise wall time is reported.
+  */
+  PlusStatus GetDeviceStatistics(vtkPlusDevice* device, double& cpuTimeSec, unsigned long& numberOfUpdates) const;
+
+  /*! Get the number of worker threads */
+  unsigned int GetNumberOfThreads() const;
+
+  /*! Get the time after which a device is updated even if no new data arrived on its input channels */
+  double GetIdleUpdatePeriodSec() const;
+
+protected:
+  typedef std::chrono::steady_clock Clock;
+
+  struct DeviceEntry
+  {
+    vtkPlusDevice* Device;
+    /*! Minimum time between updates (1/AcquisitionRate) */
+    Clock::duration MinUpdatePeriod;
+    Clock::time_point LastUpdateTime;
+    Clock::time_point NextUpdateTime;
+    bool NewDataPending;
+    bool UpdateInProgress;
+    /*! Notifier registered in the buffers of the input channels */
+    std::shared_ptr<PlusNewDataNotifier> Notifier;
+    /*! Buffers of the input channels (owned by the data sources of the input devices) */
+    std::vector<vtkPlusBuffer*> Buffers;
+  };
+
+  struct DeviceStatistics
+  {
+    DeviceStatistics() : CpuTimeSec(0.0), NumberOfUpdates(0) {}
+    double CpuTimeSec;
+    unsigned long NumberOfUpdates;
+  };
+
+  /*! Called by the notifiers (from the thread that added the data) when new data arrives to an input channel of the device */
+  void OnNewData(DeviceEntry* entry);
+
+  void WorkerThread();
+
+  /*! CPU time consumed by the calling thread */
+  static double GetThreadCpuTimeSec();
+
+  class EntryNotifier;
+
+  Clock::duration IdleUpdatePeriod;
+  double IdleUpdatePeriodSec;
+
+  mutable std::mutex Mutex;
+  /*! Signalled when the schedule changes (device added, new data arrived, update completed) */
+  std::condition_variable ScheduleChanged;
+  std::vector<std::shared_ptr<DeviceEntry> > Entries;
+  std::map<vtkPlusDevice*, DeviceStatistics> Statistics;
+  bool StopRequested;
+
+  std::vector<std::thread> Threads;
+
+private:
+  PlusVirtualDeviceExecutor(const PlusVirtualDeviceExecutor&);
+  void operator=(const PlusVirtualDeviceExecutor&);
+};
+
+#endif
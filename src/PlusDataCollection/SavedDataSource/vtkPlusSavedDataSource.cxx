@@ -13,9 +13,13 @@ See License.txt for details.
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusSavedDataSource.h"
+#include "vtkPlusStreamingSequenceReader.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtksys/SystemTools.hxx"
 
+// STL includes
+#include <algorithm>
+
 vtkStandardNewMacro(vtkPlusSavedDataSource);
 
 //----------------------------------------------------------------------------
@@ -26,6 +30,9 @@ vtkPlusSavedDataSource::vtkPlusSavedDataSource()
   , LoopStartTime_Local(0.0)
   , LoopStopTime_Local(0.0)
   , LocalVideoBuffer(NULL)
+  , StreamingEnabled(false)
+  , PrefetchWindowMemoryMb(64.0)
+  , StreamingReader(NULL)
   , UseAllFrameFields(false)
   , UseOriginalTimestamps(false)
   , LastAddedFrameUid(0)
@@ -108,8 +115,9 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     {
       currentLoopIndex = floor(elapsedTime / loopTime);
       currentFrameTime_Local = this->LoopStartTime_Local + elapsedTime - loopTime * currentLoopIndex;
+      double oldestTimestamp_Local = 0;
       double latestTimestamp_Local = 0;
-      GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+      this->GetLocalTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
       if (currentFrameTime_Local > latestTimestamp_Local)
       {
         // hold the last frame after the end of the buffer
@@ -119,10 +127,8 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     }
 
     // Get the uid of the frame that has been most recently acquired
-    BufferItemUidType closestFrameUid = 0;
-    GetLocalBuffer()->GetItemUidFromTime(currentFrameTime_Local, closestFrameUid);
-    double closestFrameTime_Local = 0;
-    GetLocalBuffer()->GetTimeStamp(closestFrameUid, closestFrameTime_Local);
+    BufferItemUidType closestFrameUid = this->GetLocalItemUidFromTime(currentFrameTime_Local);
+    double closestFrameTime_Local = this->GetLocalTimeStamp(closestFrameUid);
     if (closestFrameTime_Local > currentFrameTime_Local)
     {
       // the closest frame is newer than the current time, so don't use this item but the one before
@@ -157,7 +163,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     this->FrameNumber++;
 
     StreamBufferItem dataBufferItemToBeAdded;
-    if (GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
+    if (this->GetLocalStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != PLUS_SUCCESS)
     {
       LOG_ERROR("vtkPlusSavedDataSource: Failed to retrieve item from the buffer, UID=" << frameToBeAddedUid);
       status = PLUS_FAIL;
@@ -264,7 +270,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
 
   this->FrameNumber++;
   StreamBufferItem dataBufferItemToBeAdded;
-  if (GetLocalBuffer()->GetStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != ITEM_OK)
+  if (this->GetLocalStreamBufferItem(frameToBeAddedUid, &dataBufferItemToBeAdded) != PLUS_SUCCESS)
   {
     LOG_ERROR("vtkPlusSavedDataSource: Failed to retrieve item from the buffer, UID=" << frameToBeAddedUid);
     return PLUS_FAIL;
@@ -380,28 +386,41 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
     return PLUS_FAIL;
   }
 
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> savedDataBuffer = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-
-  // Read sequence file into tracked frame list
-  vtkIGSIOSequenceIO::Read(foundAbsoluteImagePath, savedDataBuffer);
-
-  if (savedDataBuffer->GetNumberOfTrackedFrames() < 1)
+  PlusStatus status = PLUS_FAIL;
+  if (this->StreamingEnabled && this->SimulatedStream == VIDEO_STREAM && vtkPlusStreamingSequenceReader::CanReadFile(foundAbsoluteImagePath))
   {
-    LOG_ERROR("Failed to connect to saved dataset - there is no frame in the sequence metafile!");
-    return PLUS_FAIL;
+    // Only the frame index is read now, the frames are read from the file when they are replayed
+    status = InternalConnectVideoStreaming(foundAbsoluteImagePath);
   }
-
-  PlusStatus status = PLUS_FAIL;
-  switch (this->SimulatedStream)
+  else
   {
-    case VIDEO_STREAM:
-      status = InternalConnectVideo(savedDataBuffer);
-      break;
-    case TRACKER_STREAM:
-      status = InternalConnectTracker(savedDataBuffer);
-      break;
-    default:
-      LOG_ERROR("Unknown stream type: " << this->SimulatedStream);
+    if (this->StreamingEnabled)
+    {
+      LOG_WARNING("Streaming is only supported for replaying images from MetaImage and NRRD files, the whole sequence file is loaded: " << this->SequenceFile);
+    }
+
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> savedDataBuffer = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+
+    // Read sequence file into tracked frame list
+    vtkIGSIOSequenceIO::Read(foundAbsoluteImagePath, savedDataBuffer);
+
+    if (savedDataBuffer->GetNumberOfTrackedFrames() < 1)
+    {
+      LOG_ERROR("Failed to connect to saved dataset - there is no frame in the sequence metafile!");
+      return PLUS_FAIL;
+    }
+
+    switch (this->SimulatedStream)
+    {
+      case VIDEO_STREAM:
+        status = InternalConnectVideo(savedDataBuffer);
+        break;
+      case TRACKER_STREAM:
+        status = InternalConnectTracker(savedDataBuffer);
+        break;
+      default:
+        LOG_ERROR("Unknown stream type: " << this->SimulatedStream);
+    }
   }
 
   if (status != PLUS_SUCCESS)
@@ -409,28 +428,27 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
     return PLUS_FAIL;
   }
 
-  if (GetLocalBuffer() == NULL)
+  if (!this->IsLocalDataAvailable())
   {
     LOG_ERROR("Local buffer is invalid");
     return PLUS_FAIL;
   }
 
   double oldestTimestamp_Local = 0;
-  GetLocalBuffer()->GetOldestTimeStamp(oldestTimestamp_Local);
   double latestTimestamp_Local = 0;
-  GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+  this->GetLocalTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
 
   // Set the default loop start time and length to match the video buffer start time and length
 
-  this->LoopFirstFrameUid = GetLocalBuffer()->GetOldestItemUidInBuffer();
-  this->LoopLastFrameUid = GetLocalBuffer()->GetLatestItemUidInBuffer();
+  this->LoopFirstFrameUid = this->GetLocalOldestItemUid();
+  this->LoopLastFrameUid = this->GetLocalLatestItemUid();
 
   this->LoopStartTime_Local = oldestTimestamp_Local;
 
   // When we reach the last frame we have to wait one frame period before
   // playing the first frame, so we have to add one frame period to the loop length (loopTime)
   double framePeriodSec = 0;
-  double frameRate = GetLocalBuffer()->GetFrameRate();
+  double frameRate = this->GetLocalFrameRate();
   if (frameRate != 0.0)
   {
     framePeriodSec = 1.0 / frameRate;
@@ -503,26 +521,64 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList
   this->LocalVideoBuffer->CopyImagesFromTrackedFrameList(savedDataBuffer, vtkPlusBuffer::READ_FILTERED_IGNORE_UNFILTERED_TIMESTAMPS, this->UseAllFrameFields);
   savedDataBuffer->Clear();
 
+  return this->SetVideoSourcesInputImageProperties(this->LocalVideoBuffer->GetImageOrientation(), this->LocalVideoBuffer->GetFrameSize(),
+         this->LocalVideoBuffer->GetNumberOfScalarComponents(), this->LocalVideoBuffer->GetPixelType());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::InternalConnectVideoStreaming(const std::string& sequenceFilePath)
+{
+  vtkPlusDataSource* outputDataSource = this->GetOutputDataSource();
+  if (outputDataSource == NULL)
+  {
+    return PLUS_FAIL;
+  }
+
+  DeleteLocalBuffers();
+  this->StreamingReader = vtkPlusStreamingSequenceReader::New();
+  this->StreamingReader->SetReadFrameFields(this->UseAllFrameFields);
+  this->StreamingReader->SetPrefetchWindowSizeBytes(static_cast<unsigned long long>(std::max(0.0, this->PrefetchWindowMemoryMb) * 1024 * 1024));
+  if (this->StreamingReader->Open(sequenceFilePath) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to open sequence file for streaming: " << sequenceFilePath << ". Set StreamingEnabled to FALSE to load the whole file instead.");
+    DeleteLocalBuffers();
+    return PLUS_FAIL;
+  }
+
+  if (outputDataSource->SetImageType(this->StreamingReader->GetImageType()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to set video buffer image type");
+    return PLUS_FAIL;
+  }
+
+  // The frames are provided in the orientation of the file, the video sources reorient them as needed
+  return this->SetVideoSourcesInputImageProperties(this->StreamingReader->GetImageOrientation(), this->StreamingReader->GetFrameSize(),
+         this->StreamingReader->GetNumberOfScalarComponents(), this->StreamingReader->GetPixelType());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::SetVideoSourcesInputImageProperties(US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize, unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType)
+{
   PlusStatus result(PLUS_SUCCESS);
   for (DataSourceContainerIterator it = this->VideoSources.begin(); it != this->VideoSources.end(); ++it)
   {
     vtkPlusDataSource* source(it->second);
 
-    if (source->SetInputImageOrientation(this->LocalVideoBuffer->GetImageOrientation()) != PLUS_SUCCESS)
+    if (source->SetInputImageOrientation(imageOrientation) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetNumberOfScalarComponents(this->LocalVideoBuffer->GetNumberOfScalarComponents()) != PLUS_SUCCESS)
+    if (source->SetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
@@ -531,14 +587,14 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList
 
     source->Clear();
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetPixelType(this->LocalVideoBuffer->GetPixelType()) != PLUS_SUCCESS)
+    if (source->SetPixelType(pixelType) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
@@ -671,6 +727,8 @@ PlusStatus vtkPlusSavedDataSource::ReadConfiguration(vtkXMLDataElement* rootConf
 
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(RepeatEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseOriginalTimestamps, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(StreamingEnabled, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, PrefetchWindowMemoryMb, deviceConfig);
 
   const char* useData = deviceConfig->GetAttribute("UseData");
   if (useData != NULL)
@@ -708,6 +766,11 @@ PlusStatus vtkPlusSavedDataSource::WriteConfiguration(vtkXMLDataElement* rootCon
   XML_WRITE_CSTRING_ATTRIBUTE_IF_NOT_NULL(SequenceFile, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(RepeatEnabled, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(UseOriginalTimestamps, imageAcquisitionConfig);
+  XML_WRITE_BOOL_ATTRIBUTE(StreamingEnabled, imageAcquisitionConfig);
+  if (this->StreamingEnabled)
+  {
+    imageAcquisitionConfig->SetDoubleAttribute("PrefetchWindowMemoryMb", this->PrefetchWindowMemoryMb);
+  }
 
   if (this->UseAllFrameFields)
   {
@@ -769,7 +832,7 @@ void vtkPlusSavedDataSource::GetLoopTimeRange(double& loopStartTime, double& loo
 //-----------------------------------------------------------------------------
 void vtkPlusSavedDataSource::SetLoopTimeRange(double loopStartTime, double loopStopTime)
 {
-  if (!this->GetLocalBuffer())
+  if (!this->IsLocalDataAvailable())
   {
     LOG_ERROR("vtkPlusSavedDataSource::SetLoopTimeRange: Invalid local buffer");
     return;
@@ -788,7 +851,7 @@ void vtkPlusSavedDataSource::SetLoopTimeRange(double loopStartTime, double loopS
 //----------------------------------------------------------------------------
 BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange(double time_Local, double startTime_Local, double stopTime_Local)
 {
-  if (!this->GetLocalBuffer())
+  if (!this->IsLocalDataAvailable())
   {
     LOG_ERROR("vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange: Invalid local buffer");
     return 0;
@@ -805,9 +868,8 @@ BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange(doub
   }
   // time_Local should be also within the local buffer time range
   double oldestTimestamp_Local = 0;
-  this->GetLocalBuffer()->GetOldestTimeStamp(oldestTimestamp_Local);
   double latestTimestamp_Local = 0;
-  this->GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+  this->GetLocalTimeRange(oldestTimestamp_Local, latestTimestamp_Local);
 
   // if the asked time is outside of the loop range then return the closest element in the range
   if (time_Local < oldestTimestamp_Local)
@@ -820,10 +882,8 @@ BufferItemUidType vtkPlusSavedDataSource::GetClosestFrameUidWithinTimeRange(doub
   }
 
   // Get the uid of the frame that has been most recently acquired
-  BufferItemUidType closestFrameUid = 0;
-  this->GetLocalBuffer()->GetItemUidFromTime(time_Local, closestFrameUid);
-  double closestFrameTime_Local = 0;
-  this->GetLocalBuffer()->GetTimeStamp(closestFrameUid, closestFrameTime_Local);
+  BufferItemUidType closestFrameUid = this->GetLocalItemUidFromTime(time_Local);
+  double closestFrameTime_Local = this->GetLocalTimeStamp(closestFrameUid);
 
   // The closest frame is at the boundary, but it may be just outside the range:
   // use the next/previous frame if the closest frame is on the wrong side of the boundary
@@ -864,6 +924,13 @@ void vtkPlusSavedDataSource::DeleteLocalBuffers()
     this->LocalVideoBuffer = NULL;
   }
 
+  if (this->StreamingReader != NULL)
+  {
+    this->StreamingReader->Close();
+    this->StreamingReader->Delete();
+    this->StreamingReader = NULL;
+  }
+
   for (std::map<std::string, vtkPlusBuffer*>::iterator it = this->LocalTrackerBuffers.begin(); it != this->LocalTrackerBuffers.end(); ++it)
   {
     if ((*it).second != NULL)
@@ -898,6 +965,151 @@ vtkPlusBuffer* vtkPlusSavedDataSource::GetLocalBuffer()
   return buff;
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlusSavedDataSource::IsLocalDataAvailable()
+{
+  return this->StreamingReader != NULL || this->GetLocalBuffer() != NULL;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSavedDataSource::GetLocalTimeRange(double& oldestTimestamp_Local, double& latestTimestamp_Local)
+{
+  if (this->StreamingReader != NULL)
+  {
+    oldestTimestamp_Local = this->StreamingReader->GetTimestamp(0);
+    latestTimestamp_Local = this->StreamingReader->GetTimestamp(this->StreamingReader->GetNumberOfFrames() - 1);
+    return;
+  }
+  this->GetLocalBuffer()->GetOldestTimeStamp(oldestTimestamp_Local);
+  this->GetLocalBuffer()->GetLatestTimeStamp(latestTimestamp_Local);
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType vtkPlusSavedDataSource::GetLocalOldestItemUid()
+{
+  if (this->StreamingReader != NULL)
+  {
+    return 1;
+  }
+  return this->GetLocalBuffer()->GetOldestItemUidInBuffer();
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType vtkPlusSavedDataSource::GetLocalLatestItemUid()
+{
+  if (this->StreamingReader != NULL)
+  {
+    return this->StreamingReader->GetNumberOfFrames();
+  }
+  return this->GetLocalBuffer()->GetLatestItemUidInBuffer();
+}
+
+//----------------------------------------------------------------------------
+BufferItemUidType vtkPlusSavedDataSource::GetLocalItemUidFromTime(double time_Local)
+{
+  BufferItemUidType closestFrameUid = 0;
+  if (this->StreamingReader == NULL)
+  {
+    this->GetLocalBuffer()->GetItemUidFromTime(time_Local, closestFrameUid);
+    return closestFrameUid;
+  }
+
+  // Timestamps are increasing, find the closest one with binary search
+  unsigned int lo = 0;
+  unsigned int hi = this->StreamingReader->GetNumberOfFrames() - 1;
+  if (time_Local <= this->StreamingReader->GetTimestamp(lo))
+  {
+    return lo + 1;
+  }
+  if (time_Local >= this->StreamingReader->GetTimestamp(hi))
+  {
+    return hi + 1;
+  }
+  while (hi - lo > 1)
+  {
+    unsigned int mid = lo + (hi - lo) / 2;
+    if (this->StreamingReader->GetTimestamp(mid) <= time_Local)
+    {
+      lo = mid;
+    }
+    else
+    {
+      hi = mid;
+    }
+  }
+  unsigned int closestFrameIndex = (time_Local - this->StreamingReader->GetTimestamp(lo) <= this->StreamingReader->GetTimestamp(hi) - time_Local) ? lo : hi;
+  return closestFrameIndex + 1;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusSavedDataSource::GetLocalTimeStamp(BufferItemUidType uid)
+{
+  double timestamp_Local = 0;
+  if (this->StreamingReader != NULL)
+  {
+    if (uid >= 1 && uid <= this->StreamingReader->GetNumberOfFrames())
+    {
+      timestamp_Local = this->StreamingReader->GetTimestamp(static_cast<unsigned int>(uid - 1));
+    }
+    return timestamp_Local;
+  }
+  this->GetLocalBuffer()->GetTimeStamp(uid, timestamp_Local);
+  return timestamp_Local;
+}
+
+//----------------------------------------------------------------------------
+double vtkPlusSavedDataSource::GetLocalFrameRate()
+{
+  if (this->StreamingReader == NULL)
+  {
+    return this->GetLocalBuffer()->GetFrameRate();
+  }
+
+  // Same as the buffer frame rate: average of the positive frame periods
+  double sumOfFramePeriods = 0;
+  int numberOfFramePeriods = 0;
+  for (unsigned int frameIndex = 1; frameIndex < this->StreamingReader->GetNumberOfFrames(); ++frameIndex)
+  {
+    double framePeriod = this->StreamingReader->GetTimestamp(frameIndex) - this->StreamingReader->GetTimestamp(frameIndex - 1);
+    if (framePeriod > 0)
+    {
+      sumOfFramePeriods += framePeriod;
+      numberOfFramePeriods++;
+    }
+  }
+  if (numberOfFramePeriods < 1 || sumOfFramePeriods == 0)
+  {
+    LOG_WARNING("Failed to compute frame rate. Not enough samples.");
+    return 0;
+  }
+  return numberOfFramePeriods / sumOfFramePeriods;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::GetLocalStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem)
+{
+  if (this->StreamingReader == NULL)
+  {
+    return (this->GetLocalBuffer()->GetStreamBufferItem(uid, bufferItem) == ITEM_OK) ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
+  if (uid < 1 || uid > this->StreamingReader->GetNumberOfFrames())
+  {
+    return PLUS_FAIL;
+  }
+  unsigned int frameIndex = static_cast<unsigned int>(uid - 1);
+  bufferItem->SetUid(uid);
+  bufferItem->SetIndex(frameIndex);
+  bufferItem->SetFilteredTimestamp(this->StreamingReader->GetTimestamp(frameIndex));
+  bufferItem->SetUnfilteredTimestamp(this->StreamingReader->GetTimestamp(frameIndex));
+  const igsioFieldMapType& fields = this->StreamingReader->GetFrameFields(frameIndex);
+  for (igsioFieldMapType::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+  {
+    bufferItem->SetFrameField(fieldIt->first, fieldIt->second.second, fieldIt->second.first);
+  }
+  return this->StreamingReader->GetFrame(frameIndex, bufferItem->GetFrame());
+}
+
 //----------------------------------------------------------------------------
 vtkPlusDataSource* vtkPlusSavedDataSource::GetOutputDataSource()
 {
@@ -12,6 +12,7 @@ See License.txt for details.
 #include "vtkPlusDevice.h"
 
 class vtkPlusBuffer;
+class vtkPlusStreamingSequenceReader;
 
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource;
 
@@ -27,6 +28,12 @@ Attributes:
 \li UseOriginalTimestamps: if true then the original timestamps (recorded originally in the source file)
   will be replayed exactly, otherwise only the timestamp difference will be replayed exactly,
   starting from the current time (TRUE|FALSE)
+\li StreamingEnabled: if true then the video frames are read from the file when they are replayed, instead of
+  loading the whole file at connect. Uncompressed files are memory mapped, compressed files are decoded by a
+  background thread. Only the frame timestamps (and fields) are read at connect. Supported for UseData=IMAGE
+  and IMAGE_AND_TRANSFORM with MetaImage and NRRD files (FALSE|TRUE, default: FALSE)
+\li PrefetchWindowMemoryMb: maximum size of the frames that are read ahead or decoded in advance
+  when StreamingEnabled is true (default: 64)
 
 */
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource : public vtkPlusDevice
@@ -73,7 +80,19 @@ public:
   /*! Read the timestamps from the file and use provide them in the output (instead of the current time) */
   vtkBooleanMacro( UseOriginalTimestamps, bool );
 
-  /*! Get local video buffer */
+  /*! Read the video frames from the file on demand instead of loading the whole file at connect */
+  vtkGetMacro( StreamingEnabled, bool );
+  /*! Read the video frames from the file on demand instead of loading the whole file at connect */
+  vtkSetMacro( StreamingEnabled, bool );
+  /*! Read the video frames from the file on demand instead of loading the whole file at connect */
+  vtkBooleanMacro( StreamingEnabled, bool );
+
+  /*! Maximum size of the frames that are read ahead when streaming is enabled */
+  vtkGetMacro( PrefetchWindowMemoryMb, double );
+  /*! Maximum size of the frames that are read ahead when streaming is enabled */
+  vtkSetMacro( PrefetchWindowMemoryMb, double );
+
+  /*! Get local video buffer (NULL if the video frames are streamed from the file) */
   vtkGetObjectMacro( LocalVideoBuffer, vtkPlusBuffer );
 
   virtual bool IsTracker() const;
@@ -101,6 +120,12 @@ protected:
   /*! Connect to device, in case the output is a tracker stream */
   virtual PlusStatus InternalConnectTracker( vtkIGSIOTrackedFrameList* savedDataBuffer );
 
+  /*! Connect to device, in case the output is a video stream that is read from the file on demand */
+  virtual PlusStatus InternalConnectVideoStreaming( const std::string& sequenceFilePath );
+
+  /*! Set the image properties of the input frames in all video sources */
+  PlusStatus SetVideoSourcesInputImageProperties( US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize, unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType );
+
   /*! Disconnect from device */
   virtual PlusStatus InternalDisconnect();
 
@@ -129,6 +154,19 @@ protected:
 
   void DeleteLocalBuffers();
 
+  /*!
+    Accessors of the local data. If the frames are streamed from the file then the data is retrieved from the
+    streaming reader (with buffer item UID = frame index + 1), otherwise from the local buffer.
+  */
+  bool IsLocalDataAvailable();
+  void GetLocalTimeRange( double& oldestTimestamp_Local, double& latestTimestamp_Local );
+  BufferItemUidType GetLocalOldestItemUid();
+  BufferItemUidType GetLocalLatestItemUid();
+  BufferItemUidType GetLocalItemUidFromTime( double time_Local );
+  double GetLocalTimeStamp( BufferItemUidType uid );
+  double GetLocalFrameRate();
+  PlusStatus GetLocalStreamBufferItem( BufferItemUidType uid, StreamBufferItem* bufferItem );
+
 protected:
   /*! Byte alignment of each row in the framebuffer */
   int FrameBufferRowAlignment;
@@ -152,6 +190,15 @@ protected:
   /*! Local video buffer */
   vtkPlusBuffer* LocalVideoBuffer;
 
+  /*! Read the video frames from the file on demand instead of loading the whole file at connect */
+  bool StreamingEnabled;
+
+  /*! Maximum size of the frames that are read ahead when streaming is enabled */
+  double PrefetchWindowMemoryMb;
+
+  /*! Reader of the video frames if streaming is enabled (the local video buffer is not used then) */
+  vtkPlusStreamingSequenceReader* StreamingReader;
+
   /*! Local buffer for each tracker tool, used for storing data read from sequence metafile */
   std::map<std::string, vtkPlusBuffer*> LocalTrackerBuffers;
 
@@ -0,0 +1,617 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file BatchedFrameLookupTest.cxx
+  \brief Tests that the batched buffer item lookup gives the same results as looking up the items one by one
+
+  Video, tool, and field data buffers are filled with items at different rates. Then:
+  - vtkPlusBuffer::GetStreamBufferItemsFromTimes is called with increasing and with shuffled times (the forward
+    search has to restart when a time is earlier than the previous one), including times before the oldest and after
+    the latest item. Each result must be identical to the result of GetStreamBufferItemFromTime for the same time,
+    and the times out of the buffer range must be reported as not available anymore or not available yet.
+  - vtkPlusChannel::GetTrackedFrameList is called repeatedly and each tracked frame is compared to the frame
+    assembled from GetStreamBufferItemFromTime calls on the data sources of the channel.
+  - A producer thread keeps adding items to a small lock-free buffer, overwriting its slots while the batched lookup
+    is in progress. Each retrieved item must be consistent (timestamp, index, and pixel data belong to the same frame)
+    and must be the closest item to the requested time.
+  The buffer and channel tests are run with the default (mutex protected) and with the lock-free buffer mode.
+*/
+
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusBuffer.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+#include <vtkTransform.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  const unsigned int FRAME_SIZE_PX = 8;
+  const char* TOOL_ID = "ProbeToTracker";
+  const char* COUNTER_FIELD_NAME = "Counter";
+
+  // The auxiliary data covers the whole time range of the video data, with different sampling times
+  const int NUMBER_OF_VIDEO_ITEMS = 60;
+  const double VIDEO_START_SEC = 10.0;
+  const double VIDEO_PERIOD_SEC = 0.1;
+  const int NUMBER_OF_TOOL_ITEMS = 200;
+  const double TOOL_START_SEC = 9.5;
+  const double TOOL_PERIOD_SEC = 0.037;
+  const int NUMBER_OF_FIELD_ITEMS = 150;
+  const double FIELD_START_SEC = 9.5;
+  const double FIELD_PERIOD_SEC = 0.05;
+
+  const double TIMESTAMP_TOLERANCE_SEC = 1e-9;
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddVideoItem(vtkPlusBuffer* buffer, int frameNumber, double timestamp)
+  {
+    std::vector<unsigned char> pixels(FRAME_SIZE_PX * FRAME_SIZE_PX, static_cast<unsigned char>(frameNumber));
+    FrameSizeType frameSize = { FRAME_SIZE_PX, FRAME_SIZE_PX, 1 };
+    std::array<int, 3> clipRectOrigin = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    std::array<int, 3> clipRectSize = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    return buffer->AddItem(&pixels[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber,
+                           clipRectOrigin, clipRectSize, timestamp, timestamp);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Rotation and translation change with the item index, so that the interpolated poses differ from the stored ones */
+  void GetToolMatrix(int itemIndex, vtkMatrix4x4* matrix)
+  {
+    vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
+    transform->Translate(itemIndex, 2.0 * itemIndex, -0.5 * itemIndex);
+    transform->RotateWXYZ(3.0 * itemIndex, 0.2, 0.3, 1.0);
+    matrix->DeepCopy(transform->GetMatrix());
+  }
+
+  //----------------------------------------------------------------------------
+  igsioFieldMapType GetFields(int itemIndex)
+  {
+    std::ostringstream counter;
+    counter << itemIndex;
+    igsioFieldMapType fields;
+    fields[COUNTER_FIELD_NAME] = std::make_pair(FRAMEFIELD_NONE, counter.str());
+    return fields;
+  }
+
+  //----------------------------------------------------------------------------
+  void SetupVideoBuffer(vtkPlusBuffer* buffer, int bufferSize, bool lockFree)
+  {
+    buffer->SetBufferSize(bufferSize);
+    buffer->SetLockFree(lockFree);
+    buffer->SetPixelType(VTK_UNSIGNED_CHAR);
+    buffer->SetNumberOfScalarComponents(1);
+    buffer->SetFrameSize(FRAME_SIZE_PX, FRAME_SIZE_PX, 1);
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus FillBuffers(vtkPlusBuffer* videoBuffer, vtkPlusBuffer* toolBuffer, vtkPlusBuffer* fieldBuffer)
+  {
+    for (int i = 0; i < NUMBER_OF_VIDEO_ITEMS; ++i)
+    {
+      if (AddVideoItem(videoBuffer, i, VIDEO_START_SEC + i * VIDEO_PERIOD_SEC) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add video item " << i);
+        return PLUS_FAIL;
+      }
+    }
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (int i = 0; i < NUMBER_OF_TOOL_ITEMS; ++i)
+    {
+      GetToolMatrix(i, matrix);
+      // A few items are missing, these can not be used for interpolation
+      ToolStatus status = (i % 17 == 5) ? TOOL_MISSING : TOOL_OK;
+      double timestamp = TOOL_START_SEC + i * TOOL_PERIOD_SEC;
+      if (toolBuffer->AddTimeStampedItem(matrix, status, i, timestamp, timestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add tool item " << i);
+        return PLUS_FAIL;
+      }
+    }
+    for (int i = 0; i < NUMBER_OF_FIELD_ITEMS; ++i)
+    {
+      double timestamp = FIELD_START_SEC + i * FIELD_PERIOD_SEC;
+      if (fieldBuffer->AddItem(GetFields(i), i, timestamp, timestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add field item " << i);
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns -1 if the item has no image */
+  int GetFirstPixelValue(igsioVideoFrame& frame)
+  {
+    vtkImageData* image = frame.GetImage();
+    if (image == NULL || image->GetScalarPointer() == NULL)
+    {
+      return -1;
+    }
+    return *static_cast<const unsigned char*>(image->GetScalarPointer());
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns the number of differences between the item retrieved by the batched lookup and by the single lookup */
+  int CompareItems(const std::string& description, ItemStatus status, StreamBufferItem& item, ItemStatus referenceStatus, StreamBufferItem& referenceItem)
+  {
+    if (status != referenceStatus)
+    {
+      LOG_ERROR(description << ": item status is " << status << ", expected " << referenceStatus);
+      return 1;
+    }
+    if (status != ITEM_OK)
+    {
+      return 0;
+    }
+
+    int numberOfErrors = 0;
+    if (item.GetUid() != referenceItem.GetUid() || item.GetIndex() != referenceItem.GetIndex())
+    {
+      LOG_ERROR(description << ": item UID/index is " << item.GetUid() << "/" << item.GetIndex() << ", expected " << referenceItem.GetUid() << "/" << referenceItem.GetIndex());
+      numberOfErrors++;
+    }
+    if (std::abs(item.GetFilteredTimestamp(0) - referenceItem.GetFilteredTimestamp(0)) > TIMESTAMP_TOLERANCE_SEC)
+    {
+      LOG_ERROR(description << ": item timestamp is " << std::fixed << item.GetFilteredTimestamp(0) << ", expected " << referenceItem.GetFilteredTimestamp(0));
+      numberOfErrors++;
+    }
+    if (item.GetStatus() != referenceItem.GetStatus() || item.HasValidTransformData() != referenceItem.HasValidTransformData())
+    {
+      LOG_ERROR(description << ": item tool status is " << item.GetStatus() << ", expected " << referenceItem.GetStatus());
+      numberOfErrors++;
+    }
+    if (item.HasValidTransformData())
+    {
+      for (int i = 0; i < 16; ++i)
+      {
+        if (std::abs(item.GetMatrixElements()[i] - referenceItem.GetMatrixElements()[i]) > 1e-9)
+        {
+          LOG_ERROR(description << ": matrix element " << i << " is " << item.GetMatrixElements()[i] << ", expected " << referenceItem.GetMatrixElements()[i]);
+          numberOfErrors++;
+          break;
+        }
+      }
+    }
+    if (GetFirstPixelValue(item.GetFrame()) != GetFirstPixelValue(referenceItem.GetFrame()))
+    {
+      LOG_ERROR(description << ": pixel value is " << GetFirstPixelValue(item.GetFrame()) << ", expected " << GetFirstPixelValue(referenceItem.GetFrame()));
+      numberOfErrors++;
+    }
+    if (item.GetFrameField(COUNTER_FIELD_NAME) != referenceItem.GetFrameField(COUNTER_FIELD_NAME))
+    {
+      LOG_ERROR(description << ": " << COUNTER_FIELD_NAME << " field is '" << item.GetFrameField(COUNTER_FIELD_NAME) << "', expected '" << referenceItem.GetFrameField(COUNTER_FIELD_NAME) << "'");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    Compares the batched lookup with single lookups for the specified times.
+    Times before oldestTimestamp and after latestTimestamp must not be found.
+  */
+  int CompareBatchedLookup(const std::string& description, vtkPlusBuffer* buffer, const std::vector<double>& times, vtkPlusBuffer::DataItemTemporalInterpolationType interpolation, bool shareFrameData)
+  {
+    double oldestTimestamp = 0;
+    double latestTimestamp = 0;
+    if (buffer->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK || buffer->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+    {
+      LOG_ERROR(description << ": failed to get the time range of the buffer");
+      return 1;
+    }
+
+    std::vector<StreamBufferItem> items;
+    std::vector<ItemStatus> statuses;
+    buffer->GetStreamBufferItemsFromTimes(times, items, statuses, interpolation, shareFrameData);
+    if (items.size() != times.size() || statuses.size() != times.size())
+    {
+      LOG_ERROR(description << ": " << items.size() << " items and " << statuses.size() << " statuses are returned for " << times.size() << " times");
+      return 1;
+    }
+
+    int numberOfErrors = 0;
+    int numberOfFoundItems = 0;
+    for (size_t i = 0; i < times.size(); ++i)
+    {
+      std::ostringstream itemDescription;
+      itemDescription << description << " at time " << std::fixed << times[i];
+      StreamBufferItem referenceItem;
+      ItemStatus referenceStatus = buffer->GetStreamBufferItemFromTime(times[i], &referenceItem, interpolation);
+      numberOfErrors += CompareItems(itemDescription.str(), statuses[i], items[i], referenceStatus, referenceItem);
+
+      // Clearly out of range times (tolerance of the search is much smaller than a frame period)
+      if (times[i] < oldestTimestamp - 0.01 && statuses[i] != ITEM_NOT_AVAILABLE_ANYMORE)
+      {
+        LOG_ERROR(itemDescription.str() << ": status is " << statuses[i] << " before the oldest item (" << oldestTimestamp << "), expected ITEM_NOT_AVAILABLE_ANYMORE");
+        numberOfErrors++;
+      }
+      else if (times[i] > latestTimestamp + 0.01 && statuses[i] != ITEM_NOT_AVAILABLE_YET)
+      {
+        LOG_ERROR(itemDescription.str() << ": status is " << statuses[i] << " after the latest item (" << latestTimestamp << "), expected ITEM_NOT_AVAILABLE_YET");
+        numberOfErrors++;
+      }
+      else if (times[i] >= oldestTimestamp && times[i] <= latestTimestamp && statuses[i] != ITEM_OK)
+      {
+        LOG_ERROR(itemDescription.str() << ": item is not found in the buffer range, status: " << statuses[i]);
+        numberOfErrors++;
+      }
+      if (statuses[i] == ITEM_OK)
+      {
+        numberOfFoundItems++;
+      }
+    }
+    LOG_INFO(description << ": " << numberOfFoundItems << " of " << times.size() << " items found, " << numberOfErrors << " errors");
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Increasing times in the whole time range of the buffers and beyond, including exact item times and repeated times */
+  std::vector<double> GetIncreasingTimes()
+  {
+    std::vector<double> times;
+    const double startTime = std::min(VIDEO_START_SEC, std::min(TOOL_START_SEC, FIELD_START_SEC)) - 0.3;
+    const double stopTime = std::max(VIDEO_START_SEC + NUMBER_OF_VIDEO_ITEMS * VIDEO_PERIOD_SEC,
+                                     std::max(TOOL_START_SEC + NUMBER_OF_TOOL_ITEMS * TOOL_PERIOD_SEC, FIELD_START_SEC + NUMBER_OF_FIELD_ITEMS * FIELD_PERIOD_SEC)) + 0.3;
+    for (double time = startTime; time < stopTime; time += 0.0173)
+    {
+      times.push_back(time);
+    }
+    for (int i = 0; i < NUMBER_OF_VIDEO_ITEMS; i += 3)
+    {
+      times.push_back(VIDEO_START_SEC + i * VIDEO_PERIOD_SEC);
+      times.push_back(VIDEO_START_SEC + i * VIDEO_PERIOD_SEC);
+    }
+    for (int i = 0; i < NUMBER_OF_TOOL_ITEMS; i += 7)
+    {
+      times.push_back(TOOL_START_SEC + i * TOOL_PERIOD_SEC);
+    }
+    std::sort(times.begin(), times.end());
+    return times;
+  }
+
+  //----------------------------------------------------------------------------
+  int RunBufferLookupTest(bool lockFree)
+  {
+    const std::string modeName = lockFree ? "lock-free" : "mutex";
+    vtkSmartPointer<vtkPlusBuffer> videoBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    SetupVideoBuffer(videoBuffer, NUMBER_OF_VIDEO_ITEMS, lockFree);
+    vtkSmartPointer<vtkPlusBuffer> toolBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    toolBuffer->SetBufferSize(NUMBER_OF_TOOL_ITEMS);
+    toolBuffer->SetLockFree(lockFree);
+    vtkSmartPointer<vtkPlusBuffer> fieldBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    fieldBuffer->SetBufferSize(NUMBER_OF_FIELD_ITEMS);
+    fieldBuffer->SetLockFree(lockFree);
+    if (FillBuffers(videoBuffer, toolBuffer, fieldBuffer) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+
+    std::vector<double> increasingTimes = GetIncreasingTimes();
+    std::vector<double> shuffledTimes = increasingTimes;
+    std::mt19937 randomGenerator(1234);
+    std::shuffle(shuffledTimes.begin(), shuffledTimes.end(), randomGenerator);
+
+    int numberOfErrors = 0;
+    for (int order = 0; order < 2; ++order)
+    {
+      const std::vector<double>& times = (order == 0) ? increasingTimes : shuffledTimes;
+      const std::string orderName = (order == 0) ? " increasing" : " shuffled";
+      numberOfErrors += CompareBatchedLookup(modeName + orderName + " video CLOSEST_TIME", videoBuffer, times, vtkPlusBuffer::CLOSEST_TIME, false);
+      numberOfErrors += CompareBatchedLookup(modeName + orderName + " video CLOSEST_TIME shared", videoBuffer, times, vtkPlusBuffer::CLOSEST_TIME, true);
+      numberOfErrors += CompareBatchedLookup(modeName + orderName + " video EXACT_TIME", videoBuffer, times, vtkPlusBuffer::EXACT_TIME, false);
+      numberOfErrors += CompareBatchedLookup(modeName + orderName + " tool INTERPOLATED", toolBuffer, times, vtkPlusBuffer::INTERPOLATED, false);
+      numberOfErrors += CompareBatchedLookup(modeName + orderName + " tool CLOSEST_TIME", toolBuffer, times, vtkPlusBuffer::CLOSEST_TIME, false);
+      numberOfErrors += CompareBatchedLookup(modeName + orderName + " field CLOSEST_TIME", fieldBuffer, times, vtkPlusBuffer::CLOSEST_TIME, false);
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int RunChannelLookupTest(bool lockFree)
+  {
+    const std::string modeName = lockFree ? "lock-free" : "mutex";
+
+    vtkSmartPointer<vtkPlusDataSource> videoSource = vtkSmartPointer<vtkPlusDataSource>::New();
+    videoSource->SetId("Video");
+    videoSource->SetInputImageOrientation(US_IMG_ORIENT_MF);
+    videoSource->SetImageType(US_IMG_BRIGHTNESS);
+    SetupVideoBuffer(videoSource->GetBuffer(), NUMBER_OF_VIDEO_ITEMS, lockFree);
+    vtkSmartPointer<vtkPlusDataSource> tool = vtkSmartPointer<vtkPlusDataSource>::New();
+    tool->SetId(TOOL_ID);
+    tool->SetBufferSize(NUMBER_OF_TOOL_ITEMS);
+    tool->GetBuffer()->SetLockFree(lockFree);
+    vtkSmartPointer<vtkPlusDataSource> fieldSource = vtkSmartPointer<vtkPlusDataSource>::New();
+    fieldSource->SetId("Fields");
+    fieldSource->SetBufferSize(NUMBER_OF_FIELD_ITEMS);
+    fieldSource->GetBuffer()->SetLockFree(lockFree);
+    if (FillBuffers(videoSource->GetBuffer(), tool->GetBuffer(), fieldSource->GetBuffer()) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+
+    vtkSmartPointer<vtkPlusChannel> channel = vtkSmartPointer<vtkPlusChannel>::New();
+    channel->SetChannelId("TrackedVideoStream");
+    channel->SetVideoSource(videoSource);
+    channel->AddTool(tool);
+    channel->AddFieldDataSource(fieldSource);
+
+    // Get the frames in several batches, starting after the oldest video frame
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    double timestampOfLastFrameAlreadyGot = VIDEO_START_SEC;
+    for (int batch = 0; batch < NUMBER_OF_VIDEO_ITEMS; ++batch)
+    {
+      unsigned int numberOfFramesBefore = trackedFrameList->GetNumberOfTrackedFrames();
+      if (channel->GetTrackedFrameList(timestampOfLastFrameAlreadyGot, trackedFrameList, 7) != PLUS_SUCCESS)
+      {
+        LOG_ERROR(modeName + " channel: failed to get tracked frame list");
+        return 1;
+      }
+      if (trackedFrameList->GetNumberOfTrackedFrames() == numberOfFramesBefore)
+      {
+        break;
+      }
+    }
+    if (trackedFrameList->GetNumberOfTrackedFrames() == 0)
+    {
+      LOG_ERROR(modeName + " channel: no tracked frames are returned");
+      return 1;
+    }
+
+    int numberOfErrors = 0;
+    igsioTransformName toolTransformName(TOOL_ID);
+    vtkSmartPointer<vtkMatrix4x4> frameMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (unsigned int frameIndex = 0; frameIndex < trackedFrameList->GetNumberOfTrackedFrames(); ++frameIndex)
+    {
+      igsioTrackedFrame* trackedFrame = trackedFrameList->GetTrackedFrame(frameIndex);
+      std::ostringstream description;
+      description << modeName << " channel frame " << frameIndex;
+
+      // Frames follow each other without gaps, starting after the first video frame
+      int frameNumber = GetFirstPixelValue(*trackedFrame->GetImageData());
+      if (frameNumber != static_cast<int>(frameIndex) + 1)
+      {
+        LOG_ERROR(description.str() << ": video frame " << frameNumber << " is returned, expected " << frameIndex + 1);
+        numberOfErrors++;
+        continue;
+      }
+
+      // Assemble the reference frame the same way as the channel does, but with single lookups
+      double synchronizedTimestamp = VIDEO_START_SEC + frameNumber * VIDEO_PERIOD_SEC;
+      StreamBufferItem videoItem;
+      if (videoSource->GetStreamBufferItemFromTime(synchronizedTimestamp, &videoItem, vtkPlusBuffer::CLOSEST_TIME) != ITEM_OK
+          || GetFirstPixelValue(videoItem.GetFrame()) != frameNumber)
+      {
+        LOG_ERROR(description.str() << ": reference video item is not found");
+        numberOfErrors++;
+        continue;
+      }
+      synchronizedTimestamp = videoItem.GetTimestamp(videoSource->GetLocalTimeOffsetSec());
+      StreamBufferItem toolItem;
+      if (tool->GetStreamBufferItemFromTime(synchronizedTimestamp, &toolItem, vtkPlusBuffer::INTERPOLATED) != ITEM_OK)
+      {
+        LOG_ERROR(description.str() << ": reference tool item is not found");
+        numberOfErrors++;
+        continue;
+      }
+      synchronizedTimestamp = toolItem.GetTimestamp(tool->GetLocalTimeOffsetSec());
+      StreamBufferItem fieldItem;
+      if (fieldSource->GetStreamBufferItemFromTime(synchronizedTimestamp, &fieldItem, vtkPlusBuffer::CLOSEST_TIME) != ITEM_OK)
+      {
+        LOG_ERROR(description.str() << ": reference field item is not found");
+        numberOfErrors++;
+        continue;
+      }
+      synchronizedTimestamp = fieldItem.GetTimestamp(fieldSource->GetLocalTimeOffsetSec());
+
+      ToolStatus frameToolStatus = TOOL_INVALID;
+      if (trackedFrame->GetFrameTransform(toolTransformName, frameMatrix) != PLUS_SUCCESS
+          || trackedFrame->GetFrameTransformStatus(toolTransformName, frameToolStatus) != PLUS_SUCCESS)
+      {
+        LOG_ERROR(description.str() << ": tool transform is missing");
+        numberOfErrors++;
+        continue;
+      }
+      if (frameToolStatus != toolItem.GetStatus())
+      {
+        LOG_ERROR(description.str() << ": tool status is " << frameToolStatus << ", expected " << toolItem.GetStatus());
+        numberOfErrors++;
+      }
+      for (int i = 0; i < 16; ++i)
+      {
+        if (std::abs(frameMatrix->GetElement(i / 4, i % 4) - toolItem.GetMatrixElements()[i]) > 1e-9)
+        {
+          LOG_ERROR(description.str() << ": tool matrix element " << i << " is " << frameMatrix->GetElement(i / 4, i % 4) << ", expected " << toolItem.GetMatrixElements()[i]);
+          numberOfErrors++;
+          break;
+        }
+      }
+      if (trackedFrame->GetFrameField(COUNTER_FIELD_NAME) != fieldItem.GetFrameField(COUNTER_FIELD_NAME))
+      {
+        LOG_ERROR(description.str() << ": " << COUNTER_FIELD_NAME << " field is '" << trackedFrame->GetFrameField(COUNTER_FIELD_NAME) << "', expected '" << fieldItem.GetFrameField(COUNTER_FIELD_NAME) << "'");
+        numberOfErrors++;
+      }
+      if (std::abs(trackedFrame->GetTimestamp() - synchronizedTimestamp) > TIMESTAMP_TOLERANCE_SEC)
+      {
+        LOG_ERROR(description.str() << ": timestamp is " << std::fixed << trackedFrame->GetTimestamp() << ", expected " << synchronizedTimestamp);
+        numberOfErrors++;
+      }
+    }
+    LOG_INFO(modeName << " channel: " << trackedFrameList->GetNumberOfTrackedFrames() << " tracked frames compared, " << numberOfErrors << " errors");
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  void ProducerThread(vtkPlusBuffer* buffer, double periodSec, const std::atomic<bool>* stopRequested, std::atomic<int>* numberOfAddedItems)
+  {
+    for (int frameNumber = 0; !stopRequested->load(); ++frameNumber)
+    {
+      if (AddVideoItem(buffer, frameNumber, VIDEO_START_SEC + frameNumber * periodSec) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Producer failed to add frame " << frameNumber);
+        return;
+      }
+      numberOfAddedItems->store(frameNumber + 1);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  /*!
+    The producer overwrites the slots of the buffer while the batched lookup walks through them.
+    The items can not be compared to single lookups, because the buffer content changes between the calls,
+    but each found item must be an intact copy of the frame that is closest to the requested time.
+  */
+  int RunConcurrentLookupTest(int bufferSize, int numberOfLookups)
+  {
+    const double periodSec = 0.01;
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    SetupVideoBuffer(buffer, bufferSize, true);
+
+    std::atomic<bool> stopRequested(false);
+    std::atomic<int> numberOfAddedItems(0);
+    std::thread producer(ProducerThread, buffer.GetPointer(), periodSec, &stopRequested, &numberOfAddedItems);
+
+    int numberOfErrors = 0;
+    int numberOfFoundItems = 0;
+    int numberOfRequestedItems = 0;
+    std::vector<double> times;
+    std::vector<StreamBufferItem> items;
+    std::vector<ItemStatus> statuses;
+    for (int lookup = 0; lookup < numberOfLookups && numberOfErrors == 0; ++lookup)
+    {
+      double latestTimestamp = 0;
+      if (buffer->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+      {
+        // The producer has not added any items yet
+        std::this_thread::yield();
+        continue;
+      }
+      // Request the newer half of the buffer, with a few times that are not available yet
+      times.clear();
+      for (double time = latestTimestamp - bufferSize * periodSec / 2; time < latestTimestamp + 2 * periodSec; time += 0.3 * periodSec)
+      {
+        times.push_back(time);
+      }
+      bool shareFrameData = (lookup % 2 == 1);
+      buffer->GetStreamBufferItemsFromTimes(times, items, statuses, vtkPlusBuffer::CLOSEST_TIME, shareFrameData);
+      numberOfRequestedItems += times.size();
+
+      for (size_t i = 0; i < times.size(); ++i)
+      {
+        if (statuses[i] == ITEM_NOT_AVAILABLE_ANYMORE || statuses[i] == ITEM_NOT_AVAILABLE_YET)
+        {
+          continue;
+        }
+        if (statuses[i] != ITEM_OK)
+        {
+          LOG_ERROR("Concurrent lookup at time " << std::fixed << times[i] << ": unexpected status " << statuses[i]);
+          numberOfErrors++;
+          continue;
+        }
+        numberOfFoundItems++;
+        double itemTimestamp = items[i].GetFilteredTimestamp(0);
+        double expectedTimestamp = VIDEO_START_SEC + items[i].GetIndex() * periodSec;
+        if (std::abs(itemTimestamp - expectedTimestamp) > TIMESTAMP_TOLERANCE_SEC
+            || GetFirstPixelValue(items[i].GetFrame()) != static_cast<unsigned char>(items[i].GetIndex()))
+        {
+          LOG_ERROR("Concurrent lookup at time " << std::fixed << times[i] << ": inconsistent item, index: " << items[i].GetIndex()
+                    << ", timestamp: " << itemTimestamp << ", pixel value: " << GetFirstPixelValue(items[i].GetFrame()));
+          numberOfErrors++;
+        }
+        else if (std::abs(itemTimestamp - times[i]) > periodSec / 2 + TIMESTAMP_TOLERANCE_SEC)
+        {
+          LOG_ERROR("Concurrent lookup at time " << std::fixed << times[i] << ": item at " << itemTimestamp << " is not the closest one");
+          numberOfErrors++;
+        }
+      }
+    }
+
+    stopRequested.store(true);
+    producer.join();
+
+    if (numberOfFoundItems == 0)
+    {
+      LOG_ERROR("Concurrent lookup did not find any items");
+      numberOfErrors++;
+    }
+    LOG_INFO("Concurrent lock-free lookup: " << numberOfFoundItems << " of " << numberOfRequestedItems << " items found while "
+             << numberOfAddedItems.load() << " items were added, " << numberOfErrors << " errors");
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int concurrentBufferSize(50);
+  int numberOfConcurrentLookups(2000);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--concurrent-buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &concurrentBufferSize, "Size of the buffer that is written while it is read (Default: 50).");
+  args.AddArgument("--number-of-concurrent-lookups", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfConcurrentLookups, "Number of batched lookups while the buffer is written (Default: 2000).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (concurrentBufferSize < 4 || numberOfConcurrentLookups < 1)
+  {
+    std::cerr << "Invalid arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors = 0;
+  numberOfErrors += RunBufferLookupTest(false);
+  numberOfErrors += RunBufferLookupTest(true);
+  numberOfErrors += RunChannelLookupTest(false);
+  numberOfErrors += RunChannelLookupTest(true);
+  numberOfErrors += RunConcurrentLookupTest(concurrentBufferSize, numberOfConcurrentLookups);
+
+  if (numberOfErrors > 0)
+  {
+    std::cout << "Test failed with " << numberOfErrors << " errors" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << "Test completed successfully" << std::endl;
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,332 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file BufferContentionTest.cxx
+  \brief Measures how much concurrent readers delay the producer of a vtkPlusBuffer
+
+  A writer thread adds transforms to the buffer at a fixed rate while N reader threads
+  continuously retrieve items from it. The test is run with the default (mutex protected)
+  and with the lock-free buffer mode and reports the writer jitter (delay compared to the
+  scheduled time and duration of adding an item) for both.
+  Readers verify that each retrieved item is consistent (item index matches the stored matrix),
+  the test fails if a torn item is detected.
+  Finally the lock-free buffer is resized repeatedly while readers access it, the test fails if a reader
+  observes a torn item header or cannot read any item after a resize.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusBuffer.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkMatrix4x4.h"
+#include "vtksys/CommandLineArguments.hxx"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  const double FIRST_TIMESTAMP_SEC = 1.0;
+
+  struct ReaderStatistics
+  {
+    ReaderStatistics() : NumberOfReads(0), NumberOfFailedReads(0), NumberOfTornReads(0) {}
+    int NumberOfReads;
+    int NumberOfFailedReads;
+    int NumberOfTornReads;
+  };
+
+  struct WriterStatistics
+  {
+    std::vector<double> DelaysSec;
+    std::vector<double> AddItemDurationsSec;
+  };
+
+  //----------------------------------------------------------------------------
+  double GetPercentile(std::vector<double> values, double percentile)
+  {
+    if (values.empty())
+    {
+      return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(percentile / 100.0 * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+  }
+
+  //----------------------------------------------------------------------------
+  void ReaderThread(vtkPlusBuffer* buffer, double itemPeriodSec, const std::atomic<bool>* stopRequested, ReaderStatistics* stats)
+  {
+    StreamBufferItem item;
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    unsigned int iteration = 0;
+    while (!stopRequested->load())
+    {
+      double latestTimestamp = 0;
+      double oldestTimestamp = 0;
+      if (buffer->GetLatestTimeStamp(latestTimestamp) != ITEM_OK || buffer->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK)
+      {
+        std::this_thread::yield();
+        continue;
+      }
+      // Request items from the newest quarter of the buffer, older ones may be overwritten by the time they are read
+      double requestedTime = std::max(oldestTimestamp, latestTimestamp - (iteration++ % (buffer->GetBufferSize() / 4 + 1)) * itemPeriodSec);
+      stats->NumberOfReads++;
+      if (buffer->GetStreamBufferItemFromTime(requestedTime, &item, vtkPlusBuffer::CLOSEST_TIME) != ITEM_OK)
+      {
+        stats->NumberOfFailedReads++;
+        continue;
+      }
+      item.GetMatrix(matrix);
+      if (matrix->GetElement(0, 3) != static_cast<double>(item.GetIndex())
+          || fabs(item.GetFilteredTimestamp(0) - (FIRST_TIMESTAMP_SEC + item.GetIndex() * itemPeriodSec)) > 1e-6)
+      {
+        stats->NumberOfTornReads++;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void ResizeReaderThread(vtkPlusBuffer* buffer, double itemPeriodSec, const std::atomic<bool>* stopRequested, std::atomic<long>* latestIndexRead, ReaderStatistics* stats)
+  {
+    while (!stopRequested->load())
+    {
+      // Only item headers are read, they are validated by the slot sequence number, so these reads never log warnings
+      BufferItemUidType uid = buffer->GetLatestItemUidInBuffer();
+      unsigned long index(0);
+      double timestamp(0);
+      if (uid == 0 || buffer->GetIndex(uid, index) != ITEM_OK || buffer->GetTimeStamp(uid, timestamp) != ITEM_OK)
+      {
+        stats->NumberOfFailedReads++;
+        std::this_thread::yield();
+        continue;
+      }
+      stats->NumberOfReads++;
+      if (fabs(timestamp - (FIRST_TIMESTAMP_SEC + index * itemPeriodSec)) > 1e-6)
+      {
+        stats->NumberOfTornReads++;
+        continue;
+      }
+      long previousIndex = latestIndexRead->load();
+      while (static_cast<long>(index) > previousIndex && !latestIndexRead->compare_exchange_weak(previousIndex, static_cast<long>(index)))
+      {
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  int RunContentionTest(bool lockFree, int numberOfReaders, int numberOfItems, int bufferSize, double itemPeriodSec)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetBufferSize(bufferSize);
+    buffer->SetLockFree(lockFree);
+
+    std::atomic<bool> stopRequested(false);
+    std::vector<ReaderStatistics> readerStats(numberOfReaders);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < numberOfReaders; ++i)
+    {
+      readers.push_back(std::thread(ReaderThread, buffer.GetPointer(), itemPeriodSec, &stopRequested, &readerStats[i]));
+    }
+
+    WriterStatistics writerStats;
+    writerStats.DelaysSec.reserve(numberOfItems);
+    writerStats.AddItemDurationsSec.reserve(numberOfItems);
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    const double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    for (int frameNumber = 0; frameNumber < numberOfItems; ++frameNumber)
+    {
+      // Busy wait for the scheduled time, sleeping would add the scheduler jitter to the measurement
+      const double scheduledTime = startTime + frameNumber * itemPeriodSec;
+      double now = vtkIGSIOAccurateTimer::GetSystemTime();
+      while (now < scheduledTime)
+      {
+        now = vtkIGSIOAccurateTimer::GetSystemTime();
+      }
+
+      matrix->SetElement(0, 3, frameNumber);
+      const double timestamp = FIRST_TIMESTAMP_SEC + frameNumber * itemPeriodSec;
+      if (buffer->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add item " << frameNumber << " to the buffer");
+      }
+      const double addItemCompletedTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      writerStats.DelaysSec.push_back(now - scheduledTime);
+      writerStats.AddItemDurationsSec.push_back(addItemCompletedTime - now);
+    }
+
+    stopRequested = true;
+    ReaderStatistics totalReaderStats;
+    for (int i = 0; i < numberOfReaders; ++i)
+    {
+      readers[i].join();
+      totalReaderStats.NumberOfReads += readerStats[i].NumberOfReads;
+      totalReaderStats.NumberOfFailedReads += readerStats[i].NumberOfFailedReads;
+      totalReaderStats.NumberOfTornReads += readerStats[i].NumberOfTornReads;
+    }
+
+    LOG_INFO((lockFree ? "Lock-free" : "Mutex") << " buffer, " << numberOfReaders << " readers:"
+             << std::fixed << std::setprecision(1)
+             << " writer delay p50/p99/max = " << GetPercentile(writerStats.DelaysSec, 50) * 1e6
+             << "/" << GetPercentile(writerStats.DelaysSec, 99) * 1e6
+             << "/" << GetPercentile(writerStats.DelaysSec, 100) * 1e6 << " us,"
+             << " AddTimeStampedItem p50/p99/max = " << GetPercentile(writerStats.AddItemDurationsSec, 50) * 1e6
+             << "/" << GetPercentile(writerStats.AddItemDurationsSec, 99) * 1e6
+             << "/" << GetPercentile(writerStats.AddItemDurationsSec, 100) * 1e6 << " us,"
+             << " reads: " << totalReaderStats.NumberOfReads << " (failed: " << totalReaderStats.NumberOfFailedReads << ")");
+
+    if (totalReaderStats.NumberOfTornReads > 0)
+    {
+      LOG_ERROR("Readers retrieved " << totalReaderStats.NumberOfTornReads << " torn items from the "
+                << (lockFree ? "lock-free" : "mutex") << " buffer");
+      return 1;
+    }
+    return 0;
+  }
+
+  //----------------------------------------------------------------------------
+  int RunResizeTest(int numberOfReaders, int numberOfItems, int bufferSize, int numberOfResizes, double itemPeriodSec)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetBufferSize(bufferSize);
+    buffer->SetLockFree(true);
+
+    std::atomic<bool> stopRequested(false);
+    std::atomic<long> latestIndexRead(-1);
+    std::vector<ReaderStatistics> readerStats(numberOfReaders);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < numberOfReaders; ++i)
+    {
+      readers.push_back(std::thread(ResizeReaderThread, buffer.GetPointer(), itemPeriodSec, &stopRequested, &latestIndexRead, &readerStats[i]));
+    }
+
+    int numberOfErrors = 0;
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    const int itemsPerResize = std::max(1, numberOfItems / (numberOfResizes + 1));
+    int numberOfPerformedResizes = 0;
+    int lastResizeFrameNumber = 0;
+    for (int frameNumber = 0; frameNumber < numberOfItems; ++frameNumber)
+    {
+      if (frameNumber > 0 && frameNumber % itemsPerResize == 0)
+      {
+        // Readers are in the middle of reading the slots that are replaced now
+        numberOfPerformedResizes++;
+        lastResizeFrameNumber = frameNumber;
+        if (buffer->SetBufferSize((frameNumber / itemsPerResize) % 2 ? bufferSize + 1 : bufferSize) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to resize the buffer");
+          numberOfErrors++;
+        }
+      }
+      matrix->SetElement(0, 3, frameNumber);
+      const double timestamp = FIRST_TIMESTAMP_SEC + frameNumber * itemPeriodSec;
+      if (buffer->AddTimeStampedItem(matrix, TOOL_OK, frameNumber, timestamp, timestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add item " << frameNumber << " to the buffer");
+        numberOfErrors++;
+      }
+      vtkIGSIOAccurateTimer::Delay(itemPeriodSec);
+    }
+
+    // Readers must be able to read the items that were added after the last resize
+    const double waitStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (numberOfReaders > 0 && latestIndexRead.load() < lastResizeFrameNumber && vtkIGSIOAccurateTimer::GetSystemTime() - waitStartTime < 1.0)
+    {
+      vtkIGSIOAccurateTimer::Delay(0.001);
+    }
+
+    stopRequested = true;
+    ReaderStatistics totalReaderStats;
+    for (int i = 0; i < numberOfReaders; ++i)
+    {
+      readers[i].join();
+      totalReaderStats.NumberOfReads += readerStats[i].NumberOfReads;
+      totalReaderStats.NumberOfFailedReads += readerStats[i].NumberOfFailedReads;
+      totalReaderStats.NumberOfTornReads += readerStats[i].NumberOfTornReads;
+    }
+
+    LOG_INFO("Lock-free buffer resized " << numberOfPerformedResizes << " times, " << numberOfReaders << " readers:"
+             << " reads: " << totalReaderStats.NumberOfReads << " (failed: " << totalReaderStats.NumberOfFailedReads << ")");
+
+    if (totalReaderStats.NumberOfTornReads > 0)
+    {
+      LOG_ERROR("Readers retrieved " << totalReaderStats.NumberOfTornReads << " torn item headers while the lock-free buffer was resized");
+      numberOfErrors++;
+    }
+    if (numberOfReaders > 0 && latestIndexRead.load() < lastResizeFrameNumber)
+    {
+      LOG_ERROR("Readers could not read any item that was added after the last resize of the lock-free buffer (latest index read: " << latestIndexRead.load() << ", last resize at: " << lastResizeFrameNumber << ")");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfReaders(4);
+  int numberOfItems(5000);
+  int bufferSize(150);
+  double itemPeriodMs(0.5);
+  int numberOfResizes(20);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--number-of-readers", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfReaders, "Number of concurrent reader threads (Default: 4).");
+  args.AddArgument("--number-of-items", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfItems, "Number of items the writer adds to the buffer (Default: 5000).");
+  args.AddArgument("--buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &bufferSize, "Size of the buffer (Default: 150).");
+  args.AddArgument("--item-period-ms", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &itemPeriodMs, "Time between adding items, in milliseconds (Default: 0.5).");
+  args.AddArgument("--number-of-resizes", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfResizes, "Number of times the lock-free buffer is resized while it is read (Default: 20, 0 = no resize test).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (numberOfReaders < 0 || numberOfItems < 1 || bufferSize < 2 || itemPeriodMs <= 0)
+  {
+    std::cerr << "Invalid arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors = 0;
+  numberOfErrors += RunContentionTest(false, numberOfReaders, numberOfItems, bufferSize, itemPeriodMs / 1000.0);
+  numberOfErrors += RunContentionTest(true, numberOfReaders, numberOfItems, bufferSize, itemPeriodMs / 1000.0);
+  if (numberOfResizes > 0)
+  {
+    numberOfErrors += RunResizeTest(numberOfReaders, numberOfItems, bufferSize, numberOfResizes, itemPeriodMs / 1000.0);
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
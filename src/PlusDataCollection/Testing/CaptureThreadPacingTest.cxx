@@ -0,0 +1,191 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file CaptureThreadPacingTest.cxx
+  \brief Measures how accurately the internal update thread of a device keeps the requested acquisition rate
+
+  A FakeTracker device is polled by the internal update thread of vtkPlusDevice at a high rate (1000 Hz by default).
+  After the acquisition the period error statistics (absolute difference between the actual and the requested
+  update period) and the number of missed deadlines are retrieved through the device parameter interface
+  and the achieved update rate is compared to the requested rate.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusDevice.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cmath>
+#include <iomanip>
+#include <string>
+
+namespace
+{
+  const char* PACING_TEST_CONFIGURATION =
+    "<PlusConfiguration version=\"2.1\">"
+    "  <DataCollection StartupDelaySec=\"0\">"
+    "    <DeviceSet Name=\"CaptureThreadPacingTest\" Description=\"FakeTracker polled at a high rate\" />"
+    "    <Device Id=\"TrackerDevice\" Type=\"FakeTracker\" Mode=\"Default\" AcquisitionRate=\"%ACQUISITION_RATE%\" ToolReferenceFrame=\"Tracker\""
+    "      CaptureDeadlinePolicy=\"%DEADLINE_POLICY%\" CaptureThreadCpuAffinity=\"%CPU_AFFINITY%\" CaptureThreadRealTimePriority=\"%REAL_TIME_PRIORITY%\">"
+    "      <DataSources>"
+    "        <DataSource Type=\"Tool\" Id=\"Stylus\" PortName=\"1\" BufferSize=\"%BUFFER_SIZE%\" />"
+    "      </DataSources>"
+    "      <OutputChannels>"
+    "        <OutputChannel Id=\"TrackerStream\">"
+    "          <DataSource Id=\"Stylus\" />"
+    "        </OutputChannel>"
+    "      </OutputChannels>"
+    "    </Device>"
+    "  </DataCollection>"
+    "</PlusConfiguration>";
+
+  //----------------------------------------------------------------------------
+  std::string ReplaceAll(std::string str, const std::string& from, const std::string& to)
+  {
+    size_t pos = 0;
+    while ((pos = str.find(from, pos)) != std::string::npos)
+    {
+      str.replace(pos, from.length(), to);
+      pos += to.length();
+    }
+    return str;
+  }
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+  double acquisitionRate = 1000.0;
+  double testDurationSec = 3.0;
+  std::string deadlinePolicy = "SKIP";
+  int cpuAffinity = -1;
+  int realTimePriority = 0;
+  double maxP99PeriodErrorMs = -1.0;
+  double minRateRatio = 0.9;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  args.AddArgument("--acquisition-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &acquisitionRate, "Acquisition rate of the FakeTracker in Hz (default: 1000).");
+  args.AddArgument("--duration-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &testDurationSec, "Duration of the measurement (default: 3 sec).");
+  args.AddArgument("--deadline-policy", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &deadlinePolicy, "Action when an update deadline is missed: SKIP, CATCH_UP, or RESET (default: SKIP).");
+  args.AddArgument("--cpu-affinity", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &cpuAffinity, "CPU core of the internal update thread (default: -1, no restriction).");
+  args.AddArgument("--real-time-priority", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &realTimePriority, "Real-time priority of the internal update thread (default: 0, normal scheduling).");
+  args.AddArgument("--max-p99-period-error-ms", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxP99PeriodErrorMs, "If specified then the test fails if the 99th percentile of the period error is larger than this value.");
+  args.AddArgument("--min-rate-ratio", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &minRateRatio, "The test fails if the achieved update rate is less than this fraction of the requested rate (default: 0.9).");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments." << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  std::string configString = PACING_TEST_CONFIGURATION;
+  configString = ReplaceAll(configString, "%ACQUISITION_RATE%", igsioCommon::ToString<double>(acquisitionRate));
+  configString = ReplaceAll(configString, "%DEADLINE_POLICY%", deadlinePolicy);
+  configString = ReplaceAll(configString, "%CPU_AFFINITY%", igsioCommon::ToString<int>(cpuAffinity));
+  configString = ReplaceAll(configString, "%REAL_TIME_PRIORITY%", igsioCommon::ToString<int>(realTimePriority));
+  configString = ReplaceAll(configString, "%BUFFER_SIZE%", igsioCommon::ToString<int>(static_cast<int>(acquisitionRate * (testDurationSec + 1.0))));
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(configString.c_str()));
+  if (configRootElement == NULL)
+  {
+    LOG_ERROR("Failed to parse test configuration");
+    exit(EXIT_FAILURE);
+  }
+  vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+
+  vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+  if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Datacollector failed to read configuration");
+    exit(EXIT_FAILURE);
+  }
+
+  vtkPlusDevice* trackerDevice = NULL;
+  if (dataCollector->GetDevice(trackerDevice, "TrackerDevice") != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to locate the device with Id=\"TrackerDevice\"");
+    exit(EXIT_FAILURE);
+  }
+
+  if (dataCollector->Connect() != PLUS_SUCCESS || dataCollector->Start() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Datacollector failed to start");
+    exit(EXIT_FAILURE);
+  }
+
+  LOG_INFO("Measuring internal update thread pacing for " << testDurationSec << " sec at " << acquisitionRate << " Hz acquisition rate (deadline policy: " << deadlinePolicy << ")");
+  vtkIGSIOAccurateTimer::Delay(testDurationSec);
+
+  // Each update of the FakeTracker adds one item to the tool buffer
+  double achievedRate = 0.0;
+  vtkPlusDataSource* tool = NULL;
+  double oldestTimestamp(0), latestTimestamp(0);
+  if (trackerDevice->GetTool("Stylus", tool) == PLUS_SUCCESS && tool->GetNumberOfItems() > 1
+      && tool->GetOldestTimeStamp(oldestTimestamp) == ITEM_OK && tool->GetLatestTimeStamp(latestTimestamp) == ITEM_OK
+      && latestTimestamp > oldestTimestamp)
+  {
+    achievedRate = (tool->GetNumberOfItems() - 1) / (latestTimestamp - oldestTimestamp);
+  }
+
+  std::string p50Ms, p99Ms, maxMs, missedDeadlines;
+  PlusStatus statisticsStatus = PLUS_SUCCESS;
+  if (trackerDevice->GetParameter("CapturePeriodErrorP50Ms", p50Ms) != PLUS_SUCCESS
+      || trackerDevice->GetParameter("CapturePeriodErrorP99Ms", p99Ms) != PLUS_SUCCESS
+      || trackerDevice->GetParameter("CapturePeriodErrorMaxMs", maxMs) != PLUS_SUCCESS
+      || trackerDevice->GetParameter("CaptureMissedDeadlines", missedDeadlines) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Capture period statistics are not available");
+    statisticsStatus = PLUS_FAIL;
+  }
+
+  dataCollector->Stop();
+  dataCollector->Disconnect();
+
+  if (statisticsStatus != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+
+  LOG_INFO("Achieved update rate: " << std::fixed << std::setprecision(1) << achievedRate << " Hz (requested: " << acquisitionRate << " Hz)");
+  LOG_INFO("Period error: p50 = " << p50Ms << " ms, p99 = " << p99Ms << " ms, max = " << maxMs << " ms, missed deadlines: " << missedDeadlines);
+
+  int exitCode = EXIT_SUCCESS;
+  if (achievedRate < acquisitionRate * minRateRatio)
+  {
+    LOG_ERROR("Achieved update rate (" << achievedRate << " Hz) is less than " << minRateRatio * 100 << "% of the requested rate (" << acquisitionRate << " Hz)");
+    exitCode = EXIT_FAILURE;
+  }
+  if (maxP99PeriodErrorMs >= 0 && std::stod(p99Ms) > maxP99PeriodErrorMs)
+  {
+    LOG_ERROR("99th percentile of the period error (" << p99Ms << " ms) is larger than the maximum allowed " << maxP99PeriodErrorMs << " ms");
+    exitCode = EXIT_FAILURE;
+  }
+
+  return exitCode;
+}
@@ -0,0 +1,193 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file DeviceStartupWavesTest.cxx
+  \brief Tests the grouping of devices into startup waves by vtkPlusDataCollector
+
+  Devices are connected through their input channels and the computed waves are compared to the expected ones.
+  The first data collector contains a dependency chain that is listed out of order, an independent device,
+  and devices whose input channels are owned by a device that is not managed by the data collector or by no device at all:
+  these inputs must not delay the device. The second data collector contains a circular dependency: computing the waves
+  must fail.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDevice.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+//----------------------------------------------------------------------------
+/*! Data collector that gives access to the startup waves */
+class vtkStartupWavesDataCollector : public vtkPlusDataCollector
+{
+public:
+  static vtkStartupWavesDataCollector* New();
+  vtkTypeMacro(vtkStartupWavesDataCollector, vtkPlusDataCollector);
+
+  using vtkPlusDataCollector::GetDeviceStartupWaves;
+
+protected:
+  vtkStartupWavesDataCollector() {}
+};
+
+vtkStandardNewMacro(vtkStartupWavesDataCollector);
+
+//----------------------------------------------------------------------------
+/*! Device that does nothing, only its channels are used */
+class vtkStartupWavesDevice : public vtkPlusDevice
+{
+public:
+  static vtkStartupWavesDevice* New();
+  vtkTypeMacro(vtkStartupWavesDevice, vtkPlusDevice);
+
+protected:
+  vtkStartupWavesDevice() {}
+};
+
+vtkStandardNewMacro(vtkStartupWavesDevice);
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Creates a device with one output channel. The device is owned by the data collector if it is specified.
+  vtkPlusDevice* CreateDevice(const std::string& deviceId, vtkPlusDataCollector* dataCollector)
+  {
+    vtkStartupWavesDevice* device = vtkStartupWavesDevice::New();
+    device->SetDeviceId(deviceId);
+    vtkSmartPointer<vtkPlusChannel> outputChannel = vtkSmartPointer<vtkPlusChannel>::New();
+    outputChannel->SetChannelId((deviceId + "Channel").c_str());
+    device->AddOutputChannel(outputChannel);
+    if (dataCollector != NULL && dataCollector->AddDevice(device) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add device " << deviceId);
+    }
+    return device;
+  }
+
+  //----------------------------------------------------------------------------
+  void ConnectDevices(vtkPlusDevice* inputDevice, vtkPlusDevice* device)
+  {
+    device->AddInputChannel(*inputDevice->GetOutputChannelsStart());
+  }
+
+  //----------------------------------------------------------------------------
+  std::string WavesToString(const std::vector<DeviceCollection>& waves)
+  {
+    std::string result;
+    for (std::vector<DeviceCollection>::const_iterator waveIt = waves.begin(); waveIt != waves.end(); ++waveIt)
+    {
+      result += "[";
+      for (DeviceCollectionConstIterator it = waveIt->begin(); it != waveIt->end(); ++it)
+      {
+        result += (it == waveIt->begin() ? "" : " ") + std::string((*it)->GetDeviceId());
+      }
+      result += "]";
+    }
+    return result;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  int exitCode = EXIT_SUCCESS;
+
+  // Input channels that are not provided by the data collector. They must outlive the data collectors.
+  vtkSmartPointer<vtkPlusDevice> externalDevice;
+  externalDevice.TakeReference(CreateDevice("External", NULL));
+  vtkSmartPointer<vtkPlusChannel> ownerlessChannel = vtkSmartPointer<vtkPlusChannel>::New();
+  ownerlessChannel->SetChannelId("OwnerlessChannel");
+
+  {
+    // Dependencies: Mixer <- Filter <- Source, Mixer <- Camera; Tracker and Replay only have inputs from outside
+    vtkSmartPointer<vtkStartupWavesDataCollector> dataCollector = vtkSmartPointer<vtkStartupWavesDataCollector>::New();
+    vtkPlusDevice* source = CreateDevice("Source", dataCollector);
+    vtkPlusDevice* mixer = CreateDevice("Mixer", dataCollector);
+    vtkPlusDevice* filter = CreateDevice("Filter", dataCollector);
+    vtkPlusDevice* camera = CreateDevice("Camera", dataCollector);
+    vtkPlusDevice* tracker = CreateDevice("Tracker", dataCollector);
+    vtkPlusDevice* replay = CreateDevice("Replay", dataCollector);
+    ConnectDevices(source, filter);
+    ConnectDevices(filter, mixer);
+    ConnectDevices(camera, mixer);
+    ConnectDevices(externalDevice, tracker);
+    replay->AddInputChannel(ownerlessChannel);
+    // A device reading its own output does not depend on itself
+    ConnectDevices(camera, camera);
+
+    std::vector<DeviceCollection> waves;
+    const std::string expectedWaves = "[Source Camera Tracker Replay][Filter][Mixer]";
+    if (dataCollector->GetDeviceStartupWaves(waves) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to compute the startup waves of devices without circular dependency");
+      exitCode = EXIT_FAILURE;
+    }
+    else if (WavesToString(waves) != expectedWaves)
+    {
+      LOG_ERROR("Startup waves are " << WavesToString(waves) << ", expected " << expectedWaves);
+      exitCode = EXIT_FAILURE;
+    }
+    else
+    {
+      LOG_INFO("Startup waves: " << WavesToString(waves));
+    }
+  }
+
+  {
+    // Dependencies: First <- Second <- Third <- First; Independent has no inputs
+    vtkSmartPointer<vtkStartupWavesDataCollector> dataCollector = vtkSmartPointer<vtkStartupWavesDataCollector>::New();
+    CreateDevice("Independent", dataCollector);
+    vtkPlusDevice* first = CreateDevice("First", dataCollector);
+    vtkPlusDevice* second = CreateDevice("Second", dataCollector);
+    vtkPlusDevice* third = CreateDevice("Third", dataCollector);
+    ConnectDevices(second, first);
+    ConnectDevices(third, second);
+    ConnectDevices(first, third);
+
+    // An error is logged about the circular dependency, therefore the test result is only indicated by the exit code
+    std::vector<DeviceCollection> waves;
+    if (dataCollector->GetDeviceStartupWaves(waves) == PLUS_SUCCESS)
+    {
+      LOG_ERROR("Startup waves were computed despite the circular dependency: " << WavesToString(waves));
+      exitCode = EXIT_FAILURE;
+    }
+  }
+
+  if (exitCode == EXIT_SUCCESS)
+  {
+    std::cout << "Test completed successfully" << std::endl;
+  }
+  return exitCode;
+}
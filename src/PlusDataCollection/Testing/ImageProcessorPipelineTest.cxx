@@ -0,0 +1,317 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file ImageProcessorPipelineTest.cxx
+  \brief Tests the pipelined (multi-threaded) mode of the ImageProcessor device
+
+  A SavedDataSource device replays an ultrasound sequence and an ImageProcessor device enhances the frames
+  with several processing threads. After acquisition is stopped the output buffer is checked:
+  - output timestamps are strictly increasing (frames are added in input order),
+  - every output frame corresponds to an input frame and no input frame is missing between the first and last output frame,
+  - each output image is identical to the result of processing the corresponding input frame without threads.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusBoneEnhancer.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusDevice.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// STL includes
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+  const char* PIPELINE_TEST_CONFIGURATION =
+    "<PlusConfiguration version=\"2.1\">"
+    "  <DataCollection StartupDelaySec=\"0.5\">"
+    "    <DeviceSet Name=\"ImageProcessorPipelineTest\" Description=\"Saved ultrasound frames enhanced by several processing threads\" />"
+    "    <Device Id=\"VideoDevice\" Type=\"SavedDataSource\" SequenceFile=\"%SEQUENCE_FILE%\" UseData=\"IMAGE\" AcquisitionRate=\"%ACQUISITION_RATE%\" RepeatEnabled=\"TRUE\">"
+    "      <DataSources>"
+    "        <DataSource Type=\"Video\" Id=\"Video\" BufferSize=\"%BUFFER_SIZE%\" />"
+    "      </DataSources>"
+    "      <OutputChannels>"
+    "        <OutputChannel Id=\"VideoStream\" VideoDataSourceId=\"Video\" />"
+    "      </OutputChannels>"
+    "    </Device>"
+    "    <Device Id=\"ImageProcessorDevice\" Type=\"ImageProcessor\" NumberOfProcessingThreads=\"%NUMBER_OF_THREADS%\">"
+    "      <DataSources>"
+    "        <DataSource Type=\"Video\" Id=\"ProcessedVideo\" BufferSize=\"%BUFFER_SIZE%\" />"
+    "      </DataSources>"
+    "      <InputChannels>"
+    "        <InputChannel Id=\"VideoStream\" />"
+    "      </InputChannels>"
+    "      <OutputChannels>"
+    "        <OutputChannel Id=\"ProcessedStream\" VideoDataSourceId=\"ProcessedVideo\" />"
+    "      </OutputChannels>"
+    "    </Device>"
+    "  </DataCollection>"
+    "</PlusConfiguration>";
+
+  //----------------------------------------------------------------------------
+  std::string ReplaceAll(std::string str, const std::string& from, const std::string& to)
+  {
+    size_t pos = 0;
+    while ((pos = str.find(from, pos)) != std::string::npos)
+    {
+      str.replace(pos, from.length(), to);
+      pos += to.length();
+    }
+    return str;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus GetBufferTimestamps(vtkPlusDataSource* source, std::vector<double>& timestamps)
+  {
+    timestamps.clear();
+    if (source->GetNumberOfItems() == 0)
+    {
+      return PLUS_SUCCESS;
+    }
+    for (BufferItemUidType uid = source->GetOldestItemUidInBuffer(); uid <= source->GetLatestItemUidInBuffer(); ++uid)
+    {
+      double timestamp(0);
+      if (source->GetTimeStamp(uid, timestamp) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to get the timestamp of buffer item " << uid);
+        return PLUS_FAIL;
+      }
+      timestamps.push_back(timestamp);
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  bool IsSameImage(vtkImageData* image1, vtkImageData* image2)
+  {
+    if (image1 == NULL || image2 == NULL)
+    {
+      return false;
+    }
+    int* dims1 = image1->GetDimensions();
+    int* dims2 = image2->GetDimensions();
+    if (dims1[0] != dims2[0] || dims1[1] != dims2[1] || dims1[2] != dims2[2]
+        || image1->GetScalarType() != image2->GetScalarType() || image1->GetNumberOfScalarComponents() != image2->GetNumberOfScalarComponents())
+    {
+      return false;
+    }
+    size_t numberOfBytes = static_cast<size_t>(dims1[0]) * dims1[1] * dims1[2] * image1->GetScalarSize() * image1->GetNumberOfScalarComponents();
+    return memcmp(image1->GetScalarPointer(), image2->GetScalarPointer(), numberOfBytes) == 0;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  std::string inputFileName;
+  std::string inputConfigFileName;
+  int numberOfProcessingThreads = 3;
+  double acquisitionRate = 10.0;
+  double durationSec = 5.0;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help");
+  args.AddArgument("--input-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputFileName, "Ultrasound sequence that is replayed as input of the processing.");
+  args.AddArgument("--input-config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputConfigFileName, "Config file that contains the Processor element of the bone enhancer.");
+  args.AddArgument("--number-of-processing-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfProcessingThreads, "Number of processing threads of the ImageProcessor device (default: 3).");
+  args.AddArgument("--acquisition-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &acquisitionRate, "Frame rate of the replayed sequence (default: 10).");
+  args.AddArgument("--duration-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &durationSec, "Duration of the acquisition (default: 5 sec).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (inputFileName.empty() || inputConfigFileName.empty())
+  {
+    LOG_ERROR("The arguments --input-seq-file and --input-config-file are required");
+    exit(EXIT_FAILURE);
+  }
+  if (numberOfProcessingThreads < 2)
+  {
+    LOG_ERROR("At least 2 processing threads are needed for testing the order of the output frames");
+    exit(EXIT_FAILURE);
+  }
+
+  // The bone enhancer parameters are taken from the Processor element of the input config file
+  vtkSmartPointer<vtkXMLDataElement> processorConfigRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(processorConfigRootElement, inputConfigFileName.c_str()) == PLUS_FAIL)
+  {
+    LOG_ERROR("Unable to read configuration from file " << inputConfigFileName);
+    exit(EXIT_FAILURE);
+  }
+  vtkXMLDataElement* processorElement = processorConfigRootElement->LookupElementWithName("Processor");
+  if (processorElement == NULL)
+  {
+    LOG_ERROR("Cannot find Processor element in configuration file " << inputConfigFileName);
+    exit(EXIT_FAILURE);
+  }
+  vtkSmartPointer<vtkPlusBoneEnhancer> referenceProcessor = vtkSmartPointer<vtkPlusBoneEnhancer>::New();
+  if (referenceProcessor->ReadConfiguration(processorElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to read bone enhancer configuration");
+    exit(EXIT_FAILURE);
+  }
+
+  // Both buffers must keep all frames of the acquisition
+  const int bufferSize = static_cast<int>(acquisitionRate * (durationSec + 5.0)) + 50;
+  std::string configString = PIPELINE_TEST_CONFIGURATION;
+  configString = ReplaceAll(configString, "%SEQUENCE_FILE%", inputFileName);
+  configString = ReplaceAll(configString, "%ACQUISITION_RATE%", igsioCommon::ToString<double>(acquisitionRate));
+  configString = ReplaceAll(configString, "%BUFFER_SIZE%", igsioCommon::ToString<int>(bufferSize));
+  configString = ReplaceAll(configString, "%NUMBER_OF_THREADS%", igsioCommon::ToString<int>(numberOfProcessingThreads));
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(configString.c_str()));
+  if (configRootElement == NULL)
+  {
+    LOG_ERROR("Failed to parse test configuration");
+    exit(EXIT_FAILURE);
+  }
+  vtkXMLDataElement* imageProcessorElement = configRootElement->FindNestedElementWithName("DataCollection")->FindNestedElementWithNameAndAttribute("Device", "Id", "ImageProcessorDevice");
+  vtkSmartPointer<vtkXMLDataElement> deviceProcessorElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  deviceProcessorElement->DeepCopy(processorElement);
+  deviceProcessorElement->SetAttribute("Type", referenceProcessor->GetProcessorTypeName());
+  imageProcessorElement->AddNestedElement(deviceProcessorElement);
+  vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+
+  vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+  if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Datacollector failed to read configuration");
+    exit(EXIT_FAILURE);
+  }
+  vtkPlusChannel* inputChannel(NULL);
+  vtkPlusChannel* outputChannel(NULL);
+  vtkPlusDataSource* inputSource(NULL);
+  vtkPlusDataSource* outputSource(NULL);
+  if (dataCollector->GetChannel(inputChannel, "VideoStream") != PLUS_SUCCESS || dataCollector->GetChannel(outputChannel, "ProcessedStream") != PLUS_SUCCESS
+      || inputChannel->GetVideoSource(inputSource) != PLUS_SUCCESS || outputChannel->GetVideoSource(outputSource) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Input or output video stream is not found");
+    exit(EXIT_FAILURE);
+  }
+
+  if (dataCollector->Connect() != PLUS_SUCCESS || dataCollector->Start() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Datacollector failed to start");
+    exit(EXIT_FAILURE);
+  }
+  LOG_INFO("Processing frames at " << acquisitionRate << " fps with " << numberOfProcessingThreads << " threads for " << durationSec << " sec");
+  vtkIGSIOAccurateTimer::Delay(durationSec);
+  dataCollector->Stop();
+
+  int exitCode = EXIT_SUCCESS;
+  std::vector<double> inputTimestamps;
+  std::vector<double> outputTimestamps;
+  if (GetBufferTimestamps(inputSource, inputTimestamps) != PLUS_SUCCESS || GetBufferTimestamps(outputSource, outputTimestamps) != PLUS_SUCCESS)
+  {
+    exitCode = EXIT_FAILURE;
+  }
+  LOG_INFO("Input frames: " << inputTimestamps.size() << ", processed frames: " << outputTimestamps.size());
+  if (outputTimestamps.size() < 2)
+  {
+    LOG_ERROR("Too few frames are processed: " << outputTimestamps.size());
+    exitCode = EXIT_FAILURE;
+  }
+
+  // Output order and completeness: the output frames must be the same sequence as the input frames in the processed time range
+  const double timestampToleranceSec = 1e-6;
+  size_t inputIndex = 0;
+  while (!outputTimestamps.empty() && inputIndex < inputTimestamps.size() && inputTimestamps[inputIndex] < outputTimestamps[0] - timestampToleranceSec)
+  {
+    ++inputIndex;
+  }
+  for (size_t outputIndex = 0; outputIndex < outputTimestamps.size(); ++outputIndex, ++inputIndex)
+  {
+    if (outputIndex > 0 && outputTimestamps[outputIndex] <= outputTimestamps[outputIndex - 1])
+    {
+      LOG_ERROR("Output frames are not in input order: frame " << outputIndex << " timestamp " << std::fixed << outputTimestamps[outputIndex]
+                << " is not later than the previous " << outputTimestamps[outputIndex - 1]);
+      exitCode = EXIT_FAILURE;
+      break;
+    }
+    if (inputIndex >= inputTimestamps.size() || std::fabs(inputTimestamps[inputIndex] - outputTimestamps[outputIndex]) > timestampToleranceSec)
+    {
+      LOG_ERROR("Output frame " << outputIndex << " (timestamp " << std::fixed << outputTimestamps[outputIndex] << ") does not match the next input frame"
+                << (inputIndex < inputTimestamps.size() ? " (timestamp " + igsioCommon::ToString<double>(inputTimestamps[inputIndex]) + ")" : "")
+                << ". Input frames are missing from the output or output frames are duplicated.");
+      exitCode = EXIT_FAILURE;
+      break;
+    }
+  }
+
+  // Output content: each frame must be processed from its own input frame
+  for (size_t outputIndex = 0; outputIndex < outputTimestamps.size() && exitCode == EXIT_SUCCESS; ++outputIndex)
+  {
+    igsioTrackedFrame inputFrame;
+    if (inputChannel->GetTrackedFrame(outputTimestamps[outputIndex], inputFrame) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to get input frame at " << std::fixed << outputTimestamps[outputIndex]);
+      exitCode = EXIT_FAILURE;
+      break;
+    }
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> referenceInputFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    referenceInputFrames->AddTrackedFrame(&inputFrame);
+    referenceProcessor->SetInputFrames(referenceInputFrames);
+    if (referenceProcessor->Update() != PLUS_SUCCESS || referenceProcessor->GetOutputFrames()->GetNumberOfTrackedFrames() != 1)
+    {
+      LOG_ERROR("Reference processing failed for frame at " << std::fixed << outputTimestamps[outputIndex]);
+      exitCode = EXIT_FAILURE;
+      break;
+    }
+
+    StreamBufferItem outputItem;
+    if (outputSource->GetStreamBufferItem(outputSource->GetOldestItemUidInBuffer() + outputIndex, &outputItem) != ITEM_OK)
+    {
+      LOG_ERROR("Failed to get processed frame " << outputIndex);
+      exitCode = EXIT_FAILURE;
+      break;
+    }
+    if (!IsSameImage(outputItem.GetFrame().GetImage(), referenceProcessor->GetOutputFrames()->GetTrackedFrame(0)->GetImageData()->GetImage()))
+    {
+      LOG_ERROR("Processed frame " << outputIndex << " (timestamp " << std::fixed << outputTimestamps[outputIndex] << ") differs from the result of processing its input frame");
+      exitCode = EXIT_FAILURE;
+    }
+  }
+
+  dataCollector->Disconnect();
+
+  if (exitCode == EXIT_SUCCESS)
+  {
+    LOG_INFO("Test completed successfully");
+  }
+  return exitCode;
+}
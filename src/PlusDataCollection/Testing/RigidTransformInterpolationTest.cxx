@@ -0,0 +1,315 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file RigidTransformInterpolationTest.cxx
+  \brief Tests the interpolation of tracker poses in vtkPlusBuffer on synthetic poses
+
+  Poses are added to a tracker buffer and INTERPOLATED lookups between neighboring items are compared to the
+  spherical linear interpolation of the rotations and linear interpolation of the translations. The poses cover:
+  - orientations that are closer than the normalized linear interpolation threshold (2 deg),
+  - orientations that are interpolated by SLERP (5 deg),
+  - orientations whose stored quaternions are in opposite hemispheres, which must be interpolated along the shorter arc,
+  - orientations that are 30 deg apart, where the large angle warning must be logged only if the interpolated
+    orientation is more than 10 deg from both neighbors.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusStreamBufferItem.h"
+#include "vtkPlusBuffer.h"
+
+// VTK includes
+#include <vtkCallbackCommand.h>
+#include <vtkMath.h>
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+  const char* LARGE_ANGLE_WARNING = "Angle difference between interpolated orientations is large";
+
+  // Same as the threshold in vtkPlusBuffer: above this quaternion dot product normalized linear interpolation is used
+  const double NLERP_QUATERNION_DOT_THRESHOLD = 0.9995;
+
+  struct TestPose
+  {
+    double Timestamp;
+    double Quaternion[4]; // unit quaternion (w, x, y, z), in the same hemisphere as the previous pose
+    double Translation[3];
+  };
+
+  std::vector<TestPose> TestPoses;
+
+  int NumberOfLargeAngleWarnings = 0;
+
+  //----------------------------------------------------------------------------
+  void CountLargeAngleWarnings(vtkObject* vtkNotUsed(caller), unsigned long vtkNotUsed(eventId), void* vtkNotUsed(clientData), void* callData)
+  {
+    const char* message = reinterpret_cast<const char*>(callData);
+    if (message != NULL && strstr(message, LARGE_ANGLE_WARNING) != NULL)
+    {
+      NumberOfLargeAngleWarnings++;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void AddTestPose(double timestamp, double w, double x, double y, double z, double tx, double ty, double tz)
+  {
+    TestPose pose;
+    pose.Timestamp = timestamp;
+    double norm = sqrt(w * w + x * x + y * y + z * z);
+    pose.Quaternion[0] = w / norm;
+    pose.Quaternion[1] = x / norm;
+    pose.Quaternion[2] = y / norm;
+    pose.Quaternion[3] = z / norm;
+    pose.Translation[0] = tx;
+    pose.Translation[1] = ty;
+    pose.Translation[2] = tz;
+    TestPoses.push_back(pose);
+  }
+
+  //----------------------------------------------------------------------------
+  void AddTestPoseAxisAngle(double timestamp, const double axis[3], double angleDeg, double tx, double ty, double tz)
+  {
+    double halfAngleRad = vtkMath::RadiansFromDegrees(angleDeg) / 2.0;
+    double axisNorm = vtkMath::Norm(axis);
+    double s = sin(halfAngleRad) / axisNorm;
+    AddTestPose(timestamp, cos(halfAngleRad), axis[0] * s, axis[1] * s, axis[2] * s, tx, ty, tz);
+  }
+
+  //----------------------------------------------------------------------------
+  void GetPoseMatrix(const double quaternion[4], const double translation[3], vtkMatrix4x4* matrix)
+  {
+    double rotation[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+    vtkMath::QuaternionToMatrix3x3(quaternion, rotation);
+    matrix->Identity();
+    for (int i = 0; i < 3; i++)
+    {
+      for (int j = 0; j < 3; j++)
+      {
+        matrix->SetElement(i, j, rotation[i][j]);
+      }
+      matrix->SetElement(i, 3, translation[i]);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Reference spherical linear interpolation of unit quaternions that are in the same hemisphere
+  void Slerp(const double quatA[4], const double quatB[4], double itemBweight, double interpolatedQuat[4])
+  {
+    double dot = quatA[0] * quatB[0] + quatA[1] * quatB[1] + quatA[2] * quatB[2] + quatA[3] * quatB[3];
+    double angleRad = acos(std::min(1.0, dot));
+    double weightA = 1.0 - itemBweight;
+    double weightB = itemBweight;
+    if (angleRad > 1e-12)
+    {
+      weightA = sin((1.0 - itemBweight) * angleRad) / sin(angleRad);
+      weightB = sin(itemBweight * angleRad) / sin(angleRad);
+    }
+    for (int i = 0; i < 4; i++)
+    {
+      interpolatedQuat[i] = weightA * quatA[i] + weightB * quatB[i];
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Returns the dot product of the quaternions that the buffer stored for two neighboring poses
+  double GetStoredQuaternionDot(vtkPlusBuffer* buffer, int poseIndex)
+  {
+    StreamBufferItem itemA;
+    StreamBufferItem itemB;
+    if (buffer->GetStreamBufferItem(buffer->GetOldestItemUidInBuffer() + poseIndex, &itemA) != ITEM_OK
+        || buffer->GetStreamBufferItem(buffer->GetOldestItemUidInBuffer() + poseIndex + 1, &itemB) != ITEM_OK)
+    {
+      LOG_ERROR("Failed to get stored tracker items of pose " << poseIndex << " and " << poseIndex + 1);
+      return 0.0;
+    }
+    const double* quatA = itemA.GetRotationQuaternion();
+    const double* quatB = itemB.GetRotationQuaternion();
+    return quatA[0] * quatB[0] + quatA[1] * quatB[1] + quatA[2] * quatB[2] + quatA[3] * quatB[3];
+  }
+
+  //----------------------------------------------------------------------------
+  // Returns the maximum difference of the interpolated pose matrix elements from the reference interpolation
+  double GetInterpolationError(vtkPlusBuffer* buffer, int poseIndex, double itemBweight)
+  {
+    const TestPose& poseA = TestPoses[poseIndex];
+    const TestPose& poseB = TestPoses[poseIndex + 1];
+    const double time = poseA.Timestamp + itemBweight * (poseB.Timestamp - poseA.Timestamp);
+
+    StreamBufferItem interpolatedItem;
+    vtkSmartPointer<vtkMatrix4x4> interpolatedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (buffer->GetStreamBufferItemFromTime(time, &interpolatedItem, vtkPlusBuffer::INTERPOLATED) != ITEM_OK
+        || interpolatedItem.GetStatus() != TOOL_OK || interpolatedItem.GetMatrix(interpolatedMatrix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to get interpolated tracker item (timestamp=" << std::fixed << time << ")");
+      return 1.0;
+    }
+
+    double expectedQuaternion[4] = { 1, 0, 0, 0 };
+    Slerp(poseA.Quaternion, poseB.Quaternion, itemBweight, expectedQuaternion);
+    double expectedTranslation[3] = { 0, 0, 0 };
+    for (int i = 0; i < 3; i++)
+    {
+      expectedTranslation[i] = poseA.Translation[i] * (1.0 - itemBweight) + poseB.Translation[i] * itemBweight;
+    }
+    vtkSmartPointer<vtkMatrix4x4> expectedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    GetPoseMatrix(expectedQuaternion, expectedTranslation, expectedMatrix);
+
+    double interpolationError = 0;
+    for (int i = 0; i < 4; i++)
+    {
+      for (int j = 0; j < 4; j++)
+      {
+        interpolationError = std::max(interpolationError, fabs(interpolatedMatrix->GetElement(i, j) - expectedMatrix->GetElement(i, j)));
+      }
+    }
+    return interpolationError;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestInterpolation(vtkPlusBuffer* buffer, int poseIndex, double maxInterpolationError, const std::string& description)
+  {
+    int numberOfErrors = 0;
+    const double itemBweights[3] = { 0.25, 0.5, 0.75 };
+    for (int weightIndex = 0; weightIndex < 3; ++weightIndex)
+    {
+      double interpolationError = GetInterpolationError(buffer, poseIndex, itemBweights[weightIndex]);
+      if (interpolationError > maxInterpolationError)
+      {
+        LOG_ERROR(description << ": interpolated pose at weight " << itemBweights[weightIndex] << " differs from the reference interpolation (difference="
+                  << std::scientific << interpolationError << ", threshold=" << maxInterpolationError << ")");
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  double maxInterpolationError(1e-6);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--max-interpolation-error", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxInterpolationError, "Maximum difference of the interpolated matrix elements from the reference interpolation (Default: 1e-6).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  // Warnings must be logged to be counted
+  vtkPlusLogger::Instance()->SetLogLevel(std::max(verboseLevel, static_cast<int>(vtkPlusLogger::LOG_LEVEL_WARNING)));
+
+  const double axis[3] = { 1, 2, 3 };
+  const double zAxis[3] = { 0, 0, 1 };
+  AddTestPoseAxisAngle(10.0, axis, 0.0, 0, 0, 0);
+  AddTestPoseAxisAngle(11.0, axis, 2.0, 10, -5, 2); // normalized linear interpolation from the previous pose
+  AddTestPoseAxisAngle(12.0, axis, 7.0, 12, -5, 4); // SLERP from the previous pose
+  // The rotation matrix is converted to a quaternion by an eigenvector computation, which returns the eigenvector that has
+  // mostly positive components. The next two poses are 20 deg apart, but the quaternion of the first one has three positive
+  // components, while the quaternion of the second one has none, so their stored quaternions are in opposite hemispheres.
+  AddTestPose(13.0, 0.05, 0.05, 0.05, -1.0, 12, 0, 4);
+  AddTestPose(14.0, -0.05, -0.05, -0.05, -1.0, 14, 2, 6);
+  AddTestPoseAxisAngle(15.0, zAxis, 190.0, 14, 2, 6);
+  AddTestPoseAxisAngle(16.0, zAxis, 220.0, 14, 2, 36); // large angle difference from the previous pose
+
+  vtkSmartPointer<vtkCallbackCommand> warningCounter = vtkSmartPointer<vtkCallbackCommand>::New();
+  warningCounter->SetCallback(CountLargeAngleWarnings);
+  unsigned long warningCounterTag = vtkPlusLogger::Instance()->AddObserver(vtkPlusLogger::MessageLogged, warningCounter);
+
+  vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+  buffer->SetBufferSize(static_cast<int>(TestPoses.size()));
+  vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  for (unsigned int poseIndex = 0; poseIndex < TestPoses.size(); ++poseIndex)
+  {
+    const TestPose& pose = TestPoses[poseIndex];
+    GetPoseMatrix(pose.Quaternion, pose.Translation, matrix);
+    if (buffer->AddTimeStampedItem(matrix, TOOL_OK, poseIndex, pose.Timestamp, pose.Timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add pose " << poseIndex << " to the buffer");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  int numberOfErrors = 0;
+
+  // Make sure that the poses exercise the intended branches of the interpolation
+  if (fabs(GetStoredQuaternionDot(buffer, 0)) <= NLERP_QUATERNION_DOT_THRESHOLD)
+  {
+    LOG_ERROR("Poses 0 and 1 are not interpolated by normalized linear interpolation");
+    numberOfErrors++;
+  }
+  if (fabs(GetStoredQuaternionDot(buffer, 1)) > NLERP_QUATERNION_DOT_THRESHOLD)
+  {
+    LOG_ERROR("Poses 1 and 2 are not interpolated by SLERP");
+    numberOfErrors++;
+  }
+  double oppositeHemisphereDot = GetStoredQuaternionDot(buffer, 3);
+  if (oppositeHemisphereDot >= 0)
+  {
+    LOG_ERROR("Stored quaternions of poses 3 and 4 are not in opposite hemispheres (dot=" << oppositeHemisphereDot << ")");
+    numberOfErrors++;
+  }
+
+  numberOfErrors += TestInterpolation(buffer, 0, maxInterpolationError, "Normalized linear interpolation (2 deg)");
+  numberOfErrors += TestInterpolation(buffer, 1, maxInterpolationError, "SLERP (5 deg)");
+  numberOfErrors += TestInterpolation(buffer, 3, maxInterpolationError, "Quaternions in opposite hemispheres (20 deg)");
+  if (NumberOfLargeAngleWarnings != 0)
+  {
+    LOG_ERROR("Large angle warning is logged " << NumberOfLargeAngleWarnings << " times for orientations that are less than 10 deg from a neighbor");
+    numberOfErrors++;
+  }
+
+  // Between orientations that are 30 deg apart the interpolated orientation is 6 and 24 deg from the neighbors at weight 0.2.
+  // The warning is only logged once in a few seconds, so the lookup that must log it is the last one.
+  GetInterpolationError(buffer, 5, 0.2);
+  GetInterpolationError(buffer, 5, 0.8);
+  if (NumberOfLargeAngleWarnings != 0)
+  {
+    LOG_ERROR("Large angle warning is logged " << NumberOfLargeAngleWarnings << " times for orientations that are close to one of the neighbors");
+    numberOfErrors++;
+  }
+  numberOfErrors += TestInterpolation(buffer, 5, maxInterpolationError, "Large angle (30 deg)");
+  if (NumberOfLargeAngleWarnings != 1)
+  {
+    LOG_ERROR("Large angle warning is logged " << NumberOfLargeAngleWarnings << " times for orientations that are 15 deg from both neighbors, expected once");
+    numberOfErrors++;
+  }
+
+  vtkPlusLogger::Instance()->RemoveObserver(warningCounterTag);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,487 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file SavedDataSourceStreamingTest.cxx
+  \brief Tests that vtkPlusSavedDataSource replays the same data with and without StreamingEnabled
+
+  The input sequence is written to an uncompressed and to a compressed MetaImage file. Each file is replayed by
+  a saved data source that loads the whole file and by one that streams the frames from the file
+  (with a small PrefetchWindowMemoryMb, so that frames are read ahead and released during the replay).
+  The devices are updated directly, without the acquisition thread, and the test fails if any of the following differs:
+  - local item UIDs, timestamps, frame rate, and the item UID that is found for a time (GetLocalItemUidFromTime),
+  - pixel data and frame fields of the local items,
+  - the frames that are replayed with current timestamps in a shortened loop, which restarts several times,
+  - the frames and timestamps that are replayed with original timestamps, including a loop restart.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusStreamBufferItem.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusSavedDataSource.h"
+#include "vtkPlusSequenceIO.h"
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cmath>
+#include <cstring>
+#include <string>
+
+//----------------------------------------------------------------------------
+/*! Saved data source that gives access to the local data and can be updated without the acquisition thread */
+class vtkTestSavedDataSource : public vtkPlusSavedDataSource
+{
+public:
+  static vtkTestSavedDataSource* New();
+  vtkTypeMacro(vtkTestSavedDataSource, vtkPlusSavedDataSource);
+
+  using vtkPlusSavedDataSource::InternalUpdate;
+  using vtkPlusSavedDataSource::GetLocalTimeRange;
+  using vtkPlusSavedDataSource::GetLocalOldestItemUid;
+  using vtkPlusSavedDataSource::GetLocalLatestItemUid;
+  using vtkPlusSavedDataSource::GetLocalItemUidFromTime;
+  using vtkPlusSavedDataSource::GetLocalTimeStamp;
+  using vtkPlusSavedDataSource::GetLocalFrameRate;
+  using vtkPlusSavedDataSource::GetLocalStreamBufferItem;
+
+  BufferItemUidType GetLoopFirstFrameUid() { return this->LoopFirstFrameUid; }
+  BufferItemUidType GetLoopLastFrameUid() { return this->LoopLastFrameUid; }
+  BufferItemUidType GetLastAddedFrameUid() { return this->LastAddedFrameUid; }
+  int GetLastAddedLoopIndex() { return this->LastAddedLoopIndex; }
+
+  /*! Start the replay from the first frame of the loop */
+  void RestartReplay(double startTime)
+  {
+    this->LastAddedFrameUid = this->LoopFirstFrameUid - 1;
+    this->LastAddedLoopIndex = 0;
+    vtkPlusDataSource* videoSource = this->GetOutputDataSource();
+    videoSource->Clear();
+    videoSource->SetStartTime(startTime);
+  }
+
+protected:
+  vtkTestSavedDataSource() {}
+};
+
+vtkStandardNewMacro(vtkTestSavedDataSource);
+
+namespace
+{
+  const double TIMESTAMP_TOLERANCE_SEC = 1e-6;
+
+  const char* SAVED_DATA_SOURCE_TEST_CONFIGURATION =
+    "<PlusConfiguration version=\"2.1\">"
+    "  <DataCollection StartupDelaySec=\"0\">"
+    "    <DeviceSet Name=\"SavedDataSourceStreamingTest\" Description=\"Replay of a sequence file\" />"
+    "    <Device Id=\"%DEVICE_ID%\" Type=\"SavedDataSource\" SequenceFile=\"%SEQUENCE_FILE%\" UseData=\"IMAGE_AND_TRANSFORM\""
+    "      RepeatEnabled=\"TRUE\" UseOriginalTimestamps=\"FALSE\" StreamingEnabled=\"%STREAMING_ENABLED%\" PrefetchWindowMemoryMb=\"%PREFETCH_WINDOW_MEMORY_MB%\">"
+    "      <DataSources>"
+    "        <DataSource Type=\"Video\" Id=\"Video\" PortUsImageOrientation=\"MF\" BufferSize=\"%BUFFER_SIZE%\" AveragedItemsForFiltering=\"1\" />"
+    "      </DataSources>"
+    "      <OutputChannels>"
+    "        <OutputChannel Id=\"VideoStream\" VideoDataSourceId=\"Video\" />"
+    "      </OutputChannels>"
+    "    </Device>"
+    "  </DataCollection>"
+    "</PlusConfiguration>";
+
+  //----------------------------------------------------------------------------
+  std::string ReplaceAll(std::string str, const std::string& from, const std::string& to)
+  {
+    size_t pos = 0;
+    while ((pos = str.find(from, pos)) != std::string::npos)
+    {
+      str.replace(pos, from.length(), to);
+      pos += to.length();
+    }
+    return str;
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkTestSavedDataSource> ConnectDevice(const std::string& deviceId, const std::string& sequenceFilePath, bool streamingEnabled, double prefetchWindowMemoryMb, int bufferSize)
+  {
+    std::string configString = SAVED_DATA_SOURCE_TEST_CONFIGURATION;
+    configString = ReplaceAll(configString, "%DEVICE_ID%", deviceId);
+    configString = ReplaceAll(configString, "%SEQUENCE_FILE%", sequenceFilePath);
+    configString = ReplaceAll(configString, "%STREAMING_ENABLED%", streamingEnabled ? "TRUE" : "FALSE");
+    configString = ReplaceAll(configString, "%PREFETCH_WINDOW_MEMORY_MB%", igsioCommon::ToString<double>(prefetchWindowMemoryMb));
+    configString = ReplaceAll(configString, "%BUFFER_SIZE%", igsioCommon::ToString<int>(bufferSize));
+    vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(configString.c_str()));
+    if (configRootElement == NULL)
+    {
+      LOG_ERROR("Failed to parse test configuration");
+      return NULL;
+    }
+
+    vtkSmartPointer<vtkTestSavedDataSource> device = vtkSmartPointer<vtkTestSavedDataSource>::New();
+    device->SetDeviceId(deviceId);
+    if (device->ReadConfiguration(configRootElement) != PLUS_SUCCESS || device->NotifyConfigured() != PLUS_SUCCESS)
+    {
+      LOG_ERROR(deviceId << ": failed to read the configuration");
+      return NULL;
+    }
+    if (device->Connect() != PLUS_SUCCESS)
+    {
+      LOG_ERROR(deviceId << ": failed to connect to " << sequenceFilePath);
+      return NULL;
+    }
+    if (streamingEnabled != (device->GetLocalVideoBuffer() == NULL))
+    {
+      LOG_ERROR(deviceId << ": frames are " << (streamingEnabled ? "loaded" : "streamed") << " from " << sequenceFilePath);
+      return NULL;
+    }
+    return device;
+  }
+
+  //----------------------------------------------------------------------------
+  // Compares pixel data and frame fields. Timestamp fields are not compared, as they are stored in the items.
+  PlusStatus CompareItems(StreamBufferItem& item, StreamBufferItem& expectedItem, const std::string& itemDescription)
+  {
+    igsioVideoFrame& frame = item.GetFrame();
+    igsioVideoFrame& expectedFrame = expectedItem.GetFrame();
+    if (frame.GetFrameSizeInBytes() != expectedFrame.GetFrameSizeInBytes()
+        || memcmp(frame.GetScalarPointer(), expectedFrame.GetScalarPointer(), expectedFrame.GetFrameSizeInBytes()) != 0)
+    {
+      LOG_ERROR(itemDescription << ": image data differs from the loaded frame");
+      return PLUS_FAIL;
+    }
+    igsioFieldMapType fields = item.GetFrameFieldMap();
+    igsioFieldMapType expectedFields = expectedItem.GetFrameFieldMap();
+    for (igsioFieldMapType::iterator fieldIt = expectedFields.begin(); fieldIt != expectedFields.end(); ++fieldIt)
+    {
+      if (igsioCommon::IsEqualInsensitive(fieldIt->first, "Timestamp") || igsioCommon::IsEqualInsensitive(fieldIt->first, "UnfilteredTimestamp")
+          || igsioCommon::IsEqualInsensitive(fieldIt->first, "FrameNumber"))
+      {
+        continue;
+      }
+      igsioFieldMapType::iterator actualFieldIt = fields.find(fieldIt->first);
+      if (actualFieldIt == fields.end() || actualFieldIt->second.second != fieldIt->second.second)
+      {
+        LOG_ERROR(itemDescription << ": field " << fieldIt->first << " differs from the loaded frame");
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestLocalData(vtkTestSavedDataSource* device, vtkTestSavedDataSource* referenceDevice)
+  {
+    int numberOfErrors = 0;
+
+    if (device->GetLocalOldestItemUid() != referenceDevice->GetLocalOldestItemUid() || device->GetLocalLatestItemUid() != referenceDevice->GetLocalLatestItemUid())
+    {
+      LOG_ERROR("Local item UID range is " << device->GetLocalOldestItemUid() << "-" << device->GetLocalLatestItemUid()
+                << ", expected " << referenceDevice->GetLocalOldestItemUid() << "-" << referenceDevice->GetLocalLatestItemUid());
+      return 1;
+    }
+    double oldestTimestamp(0), latestTimestamp(0), expectedOldestTimestamp(0), expectedLatestTimestamp(0);
+    device->GetLocalTimeRange(oldestTimestamp, latestTimestamp);
+    referenceDevice->GetLocalTimeRange(expectedOldestTimestamp, expectedLatestTimestamp);
+    if (fabs(oldestTimestamp - expectedOldestTimestamp) > TIMESTAMP_TOLERANCE_SEC || fabs(latestTimestamp - expectedLatestTimestamp) > TIMESTAMP_TOLERANCE_SEC)
+    {
+      LOG_ERROR("Local time range is " << oldestTimestamp << "-" << latestTimestamp << ", expected " << expectedOldestTimestamp << "-" << expectedLatestTimestamp);
+      numberOfErrors++;
+    }
+    double frameRate = device->GetLocalFrameRate();
+    double expectedFrameRate = referenceDevice->GetLocalFrameRate();
+    if (fabs(frameRate - expectedFrameRate) > 1e-6 * expectedFrameRate)
+    {
+      LOG_ERROR("Local frame rate is " << frameRate << ", expected " << expectedFrameRate);
+      numberOfErrors++;
+    }
+
+    const BufferItemUidType oldestUid = referenceDevice->GetLocalOldestItemUid();
+    const BufferItemUidType latestUid = referenceDevice->GetLocalLatestItemUid();
+    for (BufferItemUidType uid = oldestUid; uid <= latestUid; ++uid)
+    {
+      StreamBufferItem item;
+      StreamBufferItem expectedItem;
+      if (device->GetLocalStreamBufferItem(uid, &item) != PLUS_SUCCESS || referenceDevice->GetLocalStreamBufferItem(uid, &expectedItem) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to get local item UID=" << uid);
+        numberOfErrors++;
+        continue;
+      }
+      double timestamp = device->GetLocalTimeStamp(uid);
+      double expectedTimestamp = referenceDevice->GetLocalTimeStamp(uid);
+      if (item.GetUid() != uid || fabs(timestamp - expectedTimestamp) > TIMESTAMP_TOLERANCE_SEC
+          || fabs(item.GetFilteredTimestamp(0) - expectedItem.GetFilteredTimestamp(0)) > TIMESTAMP_TOLERANCE_SEC)
+      {
+        LOG_ERROR("Local item UID=" << uid << " has UID " << item.GetUid() << " and timestamp " << timestamp << ", expected timestamp " << expectedTimestamp);
+        numberOfErrors++;
+      }
+      if (CompareItems(item, expectedItem, "Local item UID=" + igsioCommon::ToString<BufferItemUidType>(uid)) != PLUS_SUCCESS)
+      {
+        numberOfErrors++;
+      }
+
+      // Times before, at, and after the item, and halfway to the next item
+      double nextTimestamp = (uid < latestUid) ? referenceDevice->GetLocalTimeStamp(uid + 1) : expectedTimestamp + 1.0;
+      double times[] = { expectedTimestamp - 0.25 * (nextTimestamp - expectedTimestamp), expectedTimestamp,
+                         expectedTimestamp + 0.25 * (nextTimestamp - expectedTimestamp), expectedTimestamp + 0.75 * (nextTimestamp - expectedTimestamp)
+                       };
+      for (int timeIndex = 0; timeIndex < 4; ++timeIndex)
+      {
+        BufferItemUidType foundUid = device->GetLocalItemUidFromTime(times[timeIndex]);
+        BufferItemUidType expectedFoundUid = referenceDevice->GetLocalItemUidFromTime(times[timeIndex]);
+        if (foundUid != expectedFoundUid)
+        {
+          LOG_ERROR("Local item UID for time " << std::fixed << times[timeIndex] << " is " << foundUid << ", expected " << expectedFoundUid);
+          numberOfErrors++;
+        }
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  // Replays a loop that does not contain the first and last frames, with current timestamps (one frame per update)
+  int TestReplayWithCurrentTimestamps(vtkTestSavedDataSource* device, vtkTestSavedDataSource* referenceDevice, int numberOfLoops)
+  {
+    int numberOfErrors = 0;
+
+    double oldestTimestamp(0), latestTimestamp(0);
+    referenceDevice->GetLocalTimeRange(oldestTimestamp, latestTimestamp);
+    const BufferItemUidType oldestUid = referenceDevice->GetLocalOldestItemUid();
+    const BufferItemUidType latestUid = referenceDevice->GetLocalLatestItemUid();
+    double loopStartTime = 0.6 * referenceDevice->GetLocalTimeStamp(oldestUid + 1) + 0.4 * referenceDevice->GetLocalTimeStamp(oldestUid + 2);
+    double loopStopTime = 0.4 * referenceDevice->GetLocalTimeStamp(latestUid - 2) + 0.6 * referenceDevice->GetLocalTimeStamp(latestUid - 1);
+    device->SetLoopTimeRange(loopStartTime, loopStopTime);
+    referenceDevice->SetLoopTimeRange(loopStartTime, loopStopTime);
+    if (device->GetLoopFirstFrameUid() != referenceDevice->GetLoopFirstFrameUid() || device->GetLoopLastFrameUid() != referenceDevice->GetLoopLastFrameUid())
+    {
+      LOG_ERROR("Loop is " << device->GetLoopFirstFrameUid() << "-" << device->GetLoopLastFrameUid()
+                << ", expected " << referenceDevice->GetLoopFirstFrameUid() << "-" << referenceDevice->GetLoopLastFrameUid());
+      return 1;
+    }
+
+    device->SetUseOriginalTimestamps(false);
+    referenceDevice->SetUseOriginalTimestamps(false);
+    device->RestartReplay(vtkIGSIOAccurateTimer::GetSystemTime());
+    referenceDevice->RestartReplay(vtkIGSIOAccurateTimer::GetSystemTime());
+    const int numberOfFramesInLoop = referenceDevice->GetLoopLastFrameUid() - referenceDevice->GetLoopFirstFrameUid() + 1;
+    for (int updateIndex = 0; updateIndex < numberOfLoops * numberOfFramesInLoop; ++updateIndex)
+    {
+      if (device->InternalUpdate() != PLUS_SUCCESS || referenceDevice->InternalUpdate() != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Update " << updateIndex << " failed");
+        numberOfErrors++;
+      }
+      BufferItemUidType expectedUid = referenceDevice->GetLoopFirstFrameUid() + updateIndex % numberOfFramesInLoop;
+      int expectedLoopIndex = updateIndex / numberOfFramesInLoop;
+      if (device->GetLastAddedFrameUid() != expectedUid || device->GetLastAddedLoopIndex() != expectedLoopIndex
+          || referenceDevice->GetLastAddedFrameUid() != expectedUid || referenceDevice->GetLastAddedLoopIndex() != expectedLoopIndex)
+      {
+        LOG_ERROR("Update " << updateIndex << " replayed UID " << device->GetLastAddedFrameUid() << " in loop " << device->GetLastAddedLoopIndex()
+                  << " (without streaming: UID " << referenceDevice->GetLastAddedFrameUid() << " in loop " << referenceDevice->GetLastAddedLoopIndex()
+                  << "), expected UID " << expectedUid << " in loop " << expectedLoopIndex);
+        numberOfErrors++;
+      }
+      // Current timestamps (not filtered) must be increasing
+      vtkIGSIOAccurateTimer::Delay(0.002);
+    }
+
+    // Restore the full loop
+    double framePeriod = 1.0 / referenceDevice->GetLocalFrameRate();
+    device->SetLoopTimeRange(oldestTimestamp, latestTimestamp + framePeriod);
+    referenceDevice->SetLoopTimeRange(oldestTimestamp, latestTimestamp + framePeriod);
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  // Replays the full loop and the first part of the next loop with original timestamps in one update
+  int TestReplayWithOriginalTimestamps(vtkTestSavedDataSource* device, vtkTestSavedDataSource* referenceDevice)
+  {
+    int numberOfErrors = 0;
+
+    double loopStartTime(0), loopStopTime(0);
+    referenceDevice->GetLoopTimeRange(loopStartTime, loopStopTime);
+    double actualLoopStartTime(0), actualLoopStopTime(0);
+    device->GetLoopTimeRange(actualLoopStartTime, actualLoopStopTime);
+    if (fabs(actualLoopStartTime - loopStartTime) > TIMESTAMP_TOLERANCE_SEC || fabs(actualLoopStopTime - loopStopTime) > TIMESTAMP_TOLERANCE_SEC)
+    {
+      LOG_ERROR("Loop time range is " << actualLoopStartTime << "-" << actualLoopStopTime << ", expected " << loopStartTime << "-" << loopStopTime);
+      return 1;
+    }
+    const double loopTime = loopStopTime - loopStartTime;
+    const BufferItemUidType firstUid = referenceDevice->GetLoopFirstFrameUid();
+    const BufferItemUidType lastUid = referenceDevice->GetLoopLastFrameUid();
+    const int numberOfFramesInLoop = lastUid - firstUid + 1;
+
+    // The acquisition is in the second loop, halfway between the third and fourth frames
+    const int numberOfFramesInSecondLoop = 3;
+    double elapsedTime = loopTime + 0.5 * (referenceDevice->GetLocalTimeStamp(firstUid + numberOfFramesInSecondLoop - 1)
+                                           + referenceDevice->GetLocalTimeStamp(firstUid + numberOfFramesInSecondLoop)) - loopStartTime;
+
+    // The elapsed time is computed in the update, so the start time is set right before it.
+    // The frames may be decoded in the update, therefore the devices have different start times.
+    device->SetUseOriginalTimestamps(true);
+    referenceDevice->SetUseOriginalTimestamps(true);
+    device->RestartReplay(vtkIGSIOAccurateTimer::GetSystemTime() - elapsedTime);
+    PlusStatus status = device->InternalUpdate();
+    referenceDevice->RestartReplay(vtkIGSIOAccurateTimer::GetSystemTime() - elapsedTime);
+    if (status != PLUS_SUCCESS || referenceDevice->InternalUpdate() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Update with original timestamps failed");
+      numberOfErrors++;
+    }
+
+    vtkPlusDataSource* videoSource = NULL;
+    vtkPlusDataSource* referenceVideoSource = NULL;
+    device->GetVideoSource("Video", videoSource);
+    referenceDevice->GetVideoSource("Video", referenceVideoSource);
+    const double startTime = videoSource->GetStartTime();
+    const double referenceStartTime = referenceVideoSource->GetStartTime();
+    const int expectedNumberOfItems = numberOfFramesInLoop + numberOfFramesInSecondLoop;
+    if (videoSource->GetNumberOfItems() != expectedNumberOfItems || referenceVideoSource->GetNumberOfItems() != expectedNumberOfItems)
+    {
+      LOG_ERROR("Number of replayed frames is " << videoSource->GetNumberOfItems() << " (without streaming: " << referenceVideoSource->GetNumberOfItems()
+                << "), expected " << expectedNumberOfItems);
+      return numberOfErrors + 1;
+    }
+
+    BufferItemUidType outputUid = videoSource->GetOldestItemUidInBuffer();
+    BufferItemUidType referenceOutputUid = referenceVideoSource->GetOldestItemUidInBuffer();
+    for (int itemIndex = 0; itemIndex < expectedNumberOfItems; ++itemIndex, ++outputUid, ++referenceOutputUid)
+    {
+      StreamBufferItem item;
+      StreamBufferItem expectedItem;
+      if (videoSource->GetStreamBufferItem(outputUid, &item) != ITEM_OK || referenceVideoSource->GetStreamBufferItem(referenceOutputUid, &expectedItem) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to get replayed frame " << itemIndex);
+        numberOfErrors++;
+        continue;
+      }
+      int loopIndex = itemIndex / numberOfFramesInLoop;
+      BufferItemUidType localUid = firstUid + itemIndex % numberOfFramesInLoop;
+      // Timestamps relative to the start time
+      double expectedTimestamp = referenceDevice->GetLocalTimeStamp(localUid) + loopIndex * loopTime - loopStartTime;
+      if (fabs(item.GetFilteredTimestamp(0) - startTime - expectedTimestamp) > TIMESTAMP_TOLERANCE_SEC
+          || fabs(expectedItem.GetFilteredTimestamp(0) - referenceStartTime - expectedTimestamp) > TIMESTAMP_TOLERANCE_SEC)
+      {
+        LOG_ERROR("Replayed frame " << itemIndex << " timestamp is " << std::fixed << item.GetFilteredTimestamp(0) - startTime << " (without streaming: "
+                  << expectedItem.GetFilteredTimestamp(0) - referenceStartTime << ") after the start, expected " << expectedTimestamp);
+        numberOfErrors++;
+      }
+      if (CompareItems(item, expectedItem, "Replayed frame " + igsioCommon::ToString<int>(itemIndex)) != PLUS_SUCCESS)
+      {
+        numberOfErrors++;
+      }
+    }
+    return numberOfErrors;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestReplay(const std::string& sequenceFilePath, double prefetchWindowMemoryMb, int numberOfFrames)
+  {
+    // The output buffer contains all frames replayed with original timestamps
+    const int bufferSize = 2 * numberOfFrames;
+    vtkSmartPointer<vtkTestSavedDataSource> referenceDevice = ConnectDevice("LoadedDataSource", sequenceFilePath, false, prefetchWindowMemoryMb, bufferSize);
+    vtkSmartPointer<vtkTestSavedDataSource> device = ConnectDevice("StreamedDataSource", sequenceFilePath, true, prefetchWindowMemoryMb, bufferSize);
+    if (referenceDevice == NULL || device == NULL)
+    {
+      return 1;
+    }
+
+    int numberOfErrors = TestLocalData(device, referenceDevice);
+    numberOfErrors += TestReplayWithCurrentTimestamps(device, referenceDevice, 3);
+    numberOfErrors += TestReplayWithOriginalTimestamps(device, referenceDevice);
+
+    device->Disconnect();
+    referenceDevice->Disconnect();
+    if (numberOfErrors > 0)
+    {
+      LOG_ERROR(sequenceFilePath << ": streamed replay differs from the loaded replay");
+    }
+    else
+    {
+      LOG_INFO(sequenceFilePath << ": streamed replay is the same as the loaded replay");
+    }
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+  std::string inputSeqFileName;
+  double prefetchWindowMemoryMb = 1.0;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  args.AddArgument("--input-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputSeqFileName, "Sequence file that is written uncompressed and compressed and replayed by saved data sources.");
+  args.AddArgument("--prefetch-window-memory-mb", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &prefetchWindowMemoryMb, "PrefetchWindowMemoryMb of the streaming saved data source (default: 1).");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments." << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (inputSeqFileName.empty())
+  {
+    std::cerr << "--input-seq-file is required" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> inputFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(inputSeqFileName, inputFrames) != PLUS_SUCCESS || inputFrames->GetNumberOfTrackedFrames() < 8)
+  {
+    LOG_ERROR("Failed to read sequence file with at least 8 frames: " << inputSeqFileName);
+    exit(EXIT_FAILURE);
+  }
+  const int numberOfFrames = inputFrames->GetNumberOfTrackedFrames();
+  US_IMAGE_ORIENTATION orientation = inputFrames->GetTrackedFrame(0)->GetImageData()->GetImageOrientation();
+
+  int exitCode = EXIT_SUCCESS;
+  for (int compressed = 0; compressed < 2; ++compressed)
+  {
+    std::string sequenceFilePath = vtkPlusConfig::GetInstance()->GetOutputPath(compressed ? "SavedDataSourceStreamingTest_Compressed.igs.mha" : "SavedDataSourceStreamingTest_Uncompressed.igs.mha");
+    if (vtkPlusSequenceIO::Write(sequenceFilePath, inputFrames, orientation, compressed != 0) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to write sequence file: " << sequenceFilePath);
+      exitCode = EXIT_FAILURE;
+      continue;
+    }
+    if (TestReplay(sequenceFilePath, prefetchWindowMemoryMb, numberOfFrames) > 0)
+    {
+      exitCode = EXIT_FAILURE;
+    }
+  }
+
+  if (exitCode == EXIT_SUCCESS)
+  {
+    std::cout << "Test completed successfully" << std::endl;
+  }
+  return exitCode;
+}
@@ -0,0 +1,189 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file SharedFrameOverwriteTest.cxx
+  \brief Tests that video frames shared with a reader are not modified when the writer reuses their buffer slots
+
+  A reader retrieves an item from a small video buffer with shared pixel data and keeps it while the writer
+  adds enough frames to overwrite every slot of the buffer several times. The test fails if the pixels of the
+  held frame change, or if the frames that the writer added afterwards are not stored correctly.
+  The test is run with the default (mutex protected) and with the lock-free buffer mode.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusBuffer.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <vector>
+
+namespace
+{
+  const unsigned int FRAME_SIZE_PX = 16;
+  const double FIRST_TIMESTAMP_SEC = 1.0;
+  const double FRAME_PERIOD_SEC = 0.1;
+
+  //----------------------------------------------------------------------------
+  PlusStatus AddFrame(vtkPlusBuffer* buffer, int frameNumber)
+  {
+    std::vector<unsigned char> pixels(FRAME_SIZE_PX * FRAME_SIZE_PX, static_cast<unsigned char>(frameNumber));
+    FrameSizeType frameSize = { FRAME_SIZE_PX, FRAME_SIZE_PX, 1 };
+    std::array<int, 3> clipRectOrigin = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    std::array<int, 3> clipRectSize = { igsioCommon::NO_CLIP, igsioCommon::NO_CLIP, igsioCommon::NO_CLIP };
+    double timestamp = FIRST_TIMESTAMP_SEC + frameNumber * FRAME_PERIOD_SEC;
+    return buffer->AddItem(&pixels[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameNumber,
+                           clipRectOrigin, clipRectSize, timestamp, timestamp);
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns the number of pixels that differ from the expected value */
+  int CountDifferentPixels(StreamBufferItem& item, int expectedValue)
+  {
+    vtkImageData* image = item.GetFrame().GetImage();
+    if (image == NULL)
+    {
+      return FRAME_SIZE_PX * FRAME_SIZE_PX;
+    }
+    const unsigned char* pixels = static_cast<const unsigned char*>(image->GetScalarPointer());
+    int numberOfDifferentPixels = 0;
+    for (unsigned int i = 0; i < FRAME_SIZE_PX * FRAME_SIZE_PX; ++i)
+    {
+      if (pixels[i] != static_cast<unsigned char>(expectedValue))
+      {
+        numberOfDifferentPixels++;
+      }
+    }
+    return numberOfDifferentPixels;
+  }
+
+  //----------------------------------------------------------------------------
+  int RunOverwriteTest(bool lockFree, int bufferSize, int numberOfWraps)
+  {
+    const char* modeName = lockFree ? "lock-free" : "mutex";
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetBufferSize(bufferSize);
+    buffer->SetLockFree(lockFree);
+    buffer->SetPixelType(VTK_UNSIGNED_CHAR);
+    buffer->SetNumberOfScalarComponents(1);
+    buffer->SetFrameSize(FRAME_SIZE_PX, FRAME_SIZE_PX, 1);
+
+    int frameNumber = 1;
+    for (; frameNumber <= bufferSize; ++frameNumber)
+    {
+      if (AddFrame(buffer, frameNumber) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add frame " << frameNumber << " to the " << modeName << " buffer");
+        return 1;
+      }
+    }
+
+    // Hold the oldest frame, its slot is the first one to be overwritten
+    const int heldFrameNumber = 1;
+    StreamBufferItem heldItem;
+    if (buffer->GetStreamBufferItem(buffer->GetOldestItemUidInBuffer(), &heldItem, true) != ITEM_OK)
+    {
+      LOG_ERROR("Failed to get the oldest item from the " << modeName << " buffer");
+      return 1;
+    }
+
+    int numberOfErrors = 0;
+    for (int wrap = 0; wrap < numberOfWraps; ++wrap)
+    {
+      for (int i = 0; i < bufferSize; ++i, ++frameNumber)
+      {
+        if (AddFrame(buffer, frameNumber) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Failed to add frame " << frameNumber << " to the " << modeName << " buffer");
+          numberOfErrors++;
+        }
+      }
+      int numberOfDifferentPixels = CountDifferentPixels(heldItem, heldFrameNumber);
+      if (numberOfDifferentPixels > 0)
+      {
+        LOG_ERROR("Held frame has been modified in the " << modeName << " buffer after " << wrap + 1 << " wraps (" << numberOfDifferentPixels << " pixels changed)");
+        numberOfErrors++;
+      }
+    }
+
+    // The frames that were written meanwhile must be intact as well
+    for (BufferItemUidType uid = buffer->GetOldestItemUidInBuffer(); uid <= buffer->GetLatestItemUidInBuffer(); ++uid)
+    {
+      StreamBufferItem item;
+      if (buffer->GetStreamBufferItem(uid, &item) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to get item " << uid << " from the " << modeName << " buffer");
+        numberOfErrors++;
+        continue;
+      }
+      if (CountDifferentPixels(item, static_cast<int>(item.GetIndex())) > 0)
+      {
+        LOG_ERROR("Frame " << item.GetIndex() << " is not stored correctly in the " << modeName << " buffer");
+        numberOfErrors++;
+      }
+    }
+
+    LOG_INFO("Held a frame of the " << modeName << " buffer while its slots were overwritten " << numberOfWraps << " times, " << numberOfErrors << " errors");
+    return numberOfErrors;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int bufferSize(5);
+  int numberOfWraps(3);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &bufferSize, "Size of the buffer (Default: 5).");
+  args.AddArgument("--number-of-wraps", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfWraps, "Number of times all slots of the buffer are overwritten while the frame is held (Default: 3).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  // Pixel values are the frame numbers, they must not wrap around
+  if (bufferSize < 1 || numberOfWraps < 1 || bufferSize * (numberOfWraps + 1) > 255)
+  {
+    std::cerr << "Invalid arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors = 0;
+  numberOfErrors += RunOverwriteTest(false, bufferSize, numberOfWraps);
+  numberOfErrors += RunOverwriteTest(true, bufferSize, numberOfWraps);
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
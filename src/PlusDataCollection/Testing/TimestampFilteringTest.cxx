@@ -7,6 +7,12 @@ See License.txt for details.
 /*!
   \file TimestampFilteringTest.cxx
   \brief This program tests the timestamp filtering algorithm.
+
+  Filtered timestamps are computed for the transforms of a recorded sequence file with the selected filtering method
+  and the frame period jitter is compared to that of the unfiltered timestamps.
+  In addition, timestamps of a simulated 1 kHz tracker with random transfer delays are filtered using a large window:
+  the incremental least squares fit must give the same result as a fit that is computed directly from all the items
+  of the window and the robust fit must reject the delayed items.
 */
 
 // Local includes
@@ -14,16 +20,163 @@ See License.txt for details.
 #ifdef PLUS_RENDERING_ENABLED
 #include "PlusPlotter.h"
 #endif
+#include "vtkIGSIOAccurateTimer.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusHTMLGenerator.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 
 // VTK includes
+#include <vtkMatrix4x4.h>
 #include <vtksys/CommandLineArguments.hxx>
 #include <vtksys/SystemTools.hxx>
 #include <vtkTable.h>
 
+// STL includes
+#include <algorithm>
+#include <deque>
+#include <random>
+
+namespace
+{
+  const double SIMULATED_FRAME_PERIOD_SEC = 0.001;
+  const unsigned int SIMULATED_NUMBER_OF_ITEMS = 20000;
+  const unsigned int SIMULATED_AVERAGED_ITEMS_FOR_FILTERING = 2000;
+  const double SIMULATED_JITTER_SEC = 0.0002;
+  const double SIMULATED_DELAYED_ITEM_PROBABILITY = 0.05;
+  const double SIMULATED_MIN_DELAY_SEC = 0.005;
+  const double SIMULATED_MAX_DELAY_SEC = 0.010;
+  const double MAX_INCREMENTAL_FIT_DIFFERENCE_SEC = 1e-9;
+  const double MAX_ROBUST_FIT_RMS_ERROR_SEC = 0.0001;
+
+  //----------------------------------------------------------------------------
+  /*!
+    Filter timestamps of a simulated tracker, which acquires items at a constant rate, but the items arrive with
+    a random jitter and some of them with a large delay. Returns the RMS error of the filtered timestamps
+    (compared to the acquisition time) and the maximum difference from the least squares fit that is computed
+    directly from the items of the filtering window.
+  */
+  PlusStatus FilterSimulatedTimestamps(vtkPlusTimestampedCircularBuffer::TimestampFilteringMethodType method, double& rmsErrorSec, double& maxDifferenceFromDirectFitSec, double& filteringTimePerItemSec)
+  {
+    vtkSmartPointer<vtkPlusBuffer> buffer = vtkSmartPointer<vtkPlusBuffer>::New();
+    buffer->SetAveragedItemsForFiltering(SIMULATED_AVERAGED_ITEMS_FOR_FILTERING);
+    buffer->SetTimestampFilteringMethod(method);
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+
+    std::mt19937 randomGenerator(1234);
+    std::uniform_real_distribution<double> uniformDistribution(0.0, 1.0);
+
+    std::deque<double> windowIndexes;
+    std::deque<double> windowTimestamps;
+    double sumSquaredError = 0;
+    unsigned int numberOfFilteredItems = 0;
+    maxDifferenceFromDirectFitSec = 0;
+    filteringTimePerItemSec = 0;
+    const double startTime = 1000.0;
+    for (unsigned int itemIndex = 0; itemIndex < SIMULATED_NUMBER_OF_ITEMS; ++itemIndex)
+    {
+      double acquisitionTimestamp = startTime + itemIndex * SIMULATED_FRAME_PERIOD_SEC;
+      double unfilteredTimestamp = acquisitionTimestamp + (uniformDistribution(randomGenerator) - 0.5) * SIMULATED_JITTER_SEC;
+      if (uniformDistribution(randomGenerator) < SIMULATED_DELAYED_ITEM_PROBABILITY)
+      {
+        unfilteredTimestamp += SIMULATED_MIN_DELAY_SEC + uniformDistribution(randomGenerator) * (SIMULATED_MAX_DELAY_SEC - SIMULATED_MIN_DELAY_SEC);
+      }
+
+      double addStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (buffer->AddTimeStampedItem(matrix, TOOL_OK, itemIndex, unfilteredTimestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add simulated item " << itemIndex << " to the buffer");
+        return PLUS_FAIL;
+      }
+      filteringTimePerItemSec += vtkIGSIOAccurateTimer::GetSystemTime() - addStartTime;
+      double filteredTimestamp = 0;
+      if (buffer->GetTimeStamp(buffer->GetLatestItemUidInBuffer(), filteredTimestamp) != ITEM_OK)
+      {
+        LOG_ERROR("Failed to get timestamp of simulated item " << itemIndex);
+        return PLUS_FAIL;
+      }
+
+      windowIndexes.push_back(itemIndex);
+      windowTimestamps.push_back(unfilteredTimestamp);
+      if (windowIndexes.size() > SIMULATED_AVERAGED_ITEMS_FOR_FILTERING)
+      {
+        windowIndexes.pop_front();
+        windowTimestamps.pop_front();
+      }
+      if (windowIndexes.size() < SIMULATED_AVERAGED_ITEMS_FOR_FILTERING)
+      {
+        // filtering starts when the window is full
+        continue;
+      }
+
+      if (method == vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_LINEAR_REGRESSION)
+      {
+        double xMean = 0;
+        double yMean = 0;
+        for (unsigned int i = 0; i < windowIndexes.size(); ++i)
+        {
+          xMean += windowIndexes[i];
+          yMean += windowTimestamps[i] - startTime;
+        }
+        xMean /= windowIndexes.size();
+        yMean /= windowIndexes.size();
+        double covarianceXY = 0;
+        double varianceX = 0;
+        for (unsigned int i = 0; i < windowIndexes.size(); ++i)
+        {
+          covarianceXY += (windowIndexes[i] - xMean) * (windowTimestamps[i] - startTime - yMean);
+          varianceX += (windowIndexes[i] - xMean) * (windowIndexes[i] - xMean);
+        }
+        double directFitTimestamp = startTime + yMean + covarianceXY / varianceX * (itemIndex - xMean);
+        maxDifferenceFromDirectFitSec = std::max(maxDifferenceFromDirectFitSec, fabs(filteredTimestamp - directFitTimestamp));
+      }
+
+      sumSquaredError += (filteredTimestamp - acquisitionTimestamp) * (filteredTimestamp - acquisitionTimestamp);
+      numberOfFilteredItems++;
+    }
+    rmsErrorSec = sqrt(sumSquaredError / numberOfFilteredItems);
+    filteringTimePerItemSec /= SIMULATED_NUMBER_OF_ITEMS;
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int TestSimulatedTimestamps()
+  {
+    int numberOfErrors = 0;
+
+    double linearRmsErrorSec = 0;
+    double maxDifferenceFromDirectFitSec = 0;
+    double linearTimePerItemSec = 0;
+    if (FilterSimulatedTimestamps(vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_LINEAR_REGRESSION, linearRmsErrorSec, maxDifferenceFromDirectFitSec, linearTimePerItemSec) != PLUS_SUCCESS)
+    {
+      return 1;
+    }
+    LOG_INFO("Simulated timestamps, linear regression: RMS error: " << linearRmsErrorSec * 1000 << "ms, difference from direct fit: " << maxDifferenceFromDirectFitSec * 1000 << "ms"
+             << ", time per item: " << linearTimePerItemSec * 1e6 << "us");
+    if (maxDifferenceFromDirectFitSec > MAX_INCREMENTAL_FIT_DIFFERENCE_SEC)
+    {
+      LOG_ERROR("Incremental least squares fit differs from the direct fit by " << maxDifferenceFromDirectFitSec << "s (threshold: " << MAX_INCREMENTAL_FIT_DIFFERENCE_SEC << "s)");
+      numberOfErrors++;
+    }
+
+    double robustRmsErrorSec = 0;
+    double robustTimePerItemSec = 0;
+    if (FilterSimulatedTimestamps(vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_ROBUST_REGRESSION, robustRmsErrorSec, maxDifferenceFromDirectFitSec, robustTimePerItemSec) != PLUS_SUCCESS)
+    {
+      return numberOfErrors + 1;
+    }
+    LOG_INFO("Simulated timestamps, robust regression: RMS error: " << robustRmsErrorSec * 1000 << "ms, time per item: " << robustTimePerItemSec * 1e6 << "us");
+    if (robustRmsErrorSec > MAX_ROBUST_FIT_RMS_ERROR_SEC || robustRmsErrorSec > linearRmsErrorSec)
+    {
+      LOG_ERROR("Robust regression did not reject the delayed items (RMS error: " << robustRmsErrorSec * 1000 << "ms, threshold: " << MAX_ROBUST_FIT_RMS_ERROR_SEC * 1000
+                << "ms, linear regression RMS error: " << linearRmsErrorSec * 1000 << "ms)");
+      numberOfErrors++;
+    }
+
+    return numberOfErrors;
+  }
+}
+
 
 int main(int argc, char** argv)
 {
@@ -36,6 +189,7 @@ int main(int argc, char** argv)
   double inputMaxTimestampDifference(0.080);
   double inputMinStdevReductionFactor(3.0);
   std::string inputTransformName;
+  std::string inputFilteringMethod("LINEAR_REGRESSION");
 
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
@@ -47,6 +201,7 @@ int main(int argc, char** argv)
   args.AddArgument("--source-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMetafile, "Input sequence metafile.");
   args.AddArgument("--averaged-items-for-filtering", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputAveragedItemsForFiltering, "Number of averaged items used for filtering (Default: 20).");
   args.AddArgument("--max-timestamp-difference", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMaxTimestampDifference, "The maximum difference between the filtered and nonfiltered timestamps for each frame (Default: 0.08s).");
+  args.AddArgument("--filtering-method", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputFilteringMethod, "Timestamp filtering method: LINEAR_REGRESSION or ROBUST_REGRESSION (Default: LINEAR_REGRESSION).");
   args.AddArgument("--min-stdev-reduction-factor", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMinStdevReductionFactor, "Minimum factor that the filtering should reduces the standard deviation of the frame periods on filtered data (Default: 3.0 ).");
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
 
@@ -72,6 +227,13 @@ int main(int argc, char** argv)
     exit(EXIT_FAILURE);
   }
 
+  vtkPlusTimestampedCircularBuffer::TimestampFilteringMethodType filteringMethod = vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_LINEAR_REGRESSION;
+  if (vtkPlusTimestampedCircularBuffer::GetTimestampFilteringMethodFromString(inputFilteringMethod.c_str(), filteringMethod) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Invalid filtering method: " << inputFilteringMethod);
+    return EXIT_FAILURE;
+  }
+
   igsioTransformName transformName;
   if (transformName.SetTransformName(inputTransformName.c_str()) != PLUS_SUCCESS)
   {
@@ -90,6 +252,8 @@ int main(int argc, char** argv)
   LOG_INFO("Copy buffer to tracker buffer...");
   vtkSmartPointer<vtkPlusBuffer> trackerBuffer = vtkSmartPointer<vtkPlusBuffer>::New();
   trackerBuffer->SetTimeStampReporting(true);
+  trackerBuffer->SetAveragedItemsForFiltering(inputAveragedItemsForFiltering);
+  trackerBuffer->SetTimestampFilteringMethod(filteringMethod);
   // compute filtered timestamps now to test the filtering
   if (trackerBuffer->CopyTransformFromTrackedFrameList(trackerFrameList, vtkPlusBuffer::READ_UNFILTERED_COMPUTE_FILTERED_TIMESTAMPS, transformName) != PLUS_SUCCESS)
   {
@@ -180,6 +344,9 @@ int main(int argc, char** argv)
   }
 
 
+  // 3. Filtering of simulated timestamps with a large window
+  numberOfErrors += TestSimulatedTimestamps();
+
   vtkSmartPointer<vtkTable> timestampReportTable = vtkSmartPointer<vtkTable>::New();
   if (trackerBuffer->GetTimeStampReportTable(timestampReportTable) != PLUS_SUCCESS)
   {
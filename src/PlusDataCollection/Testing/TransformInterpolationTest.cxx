@@ -11,10 +11,13 @@
 #include "vtkMatrix4x4.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusDevice.h"
+#include "vtkIGSIOAccurateTimer.h"
 #include "vtkIGSIOSequenceIO.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtksys/CommandLineArguments.hxx"
 #include "vtksys/SystemTools.hxx"
+#include <algorithm>
+#include <iomanip>
 
 int main(int argc, char **argv)
 {
@@ -26,6 +29,9 @@ int main(int argc, char **argv)
   double inputMaxTranslationDifference(0.5); 
   double inputMaxRotationDifference(1.0); 
   std::string inputTransformName; 
+  int throughputPasses(20);
+  double minLookupsPerSec(0);
+  double maxInterpolationError(1e-6);
 
   int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
 
@@ -37,6 +43,9 @@ int main(int argc, char **argv)
   args.AddArgument("--source-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMetafile, "Input sequence metafile.");
   args.AddArgument("--max-rotation-difference", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMaxRotationDifference, "Maximum rotation difference in degrees (Default: 1 deg).");
   args.AddArgument("--max-translation-difference", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputMaxTranslationDifference, "Maximum translation difference (Default: 0.5 mm).");
+  args.AddArgument("--throughput-passes", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &throughputPasses, "Number of passes over the buffer for measuring the item lookup throughput (Default: 20, 0 = no measurement).");
+  args.AddArgument("--min-lookups-per-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &minLookupsPerSec, "Minimum required item lookup throughput for each interpolation type (Default: 0 = not checked).");
+  args.AddArgument("--max-interpolation-error", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxInterpolationError, "Maximum difference of the interpolated matrix elements from the reference interpolation (Default: 1e-6).");
   args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");  
   
   if ( !args.Parse() )
@@ -162,6 +171,123 @@ int main(int argc, char **argv)
     prevmatrix->DeepCopy(matrix);      
   }
 
+  // Compare interpolated poses to a reference interpolation
+  //****************************
+
+  // The reference interpolates the rotation of the neighbor items by SLERP of their quaternions
+  // and the translation linearly, computed from the vtkMatrix4x4 of the items
+  int numberOfComparedPoses(0);
+  const double localTimeOffsetSec = trackerBuffer->GetLocalTimeOffsetSec();
+  for ( BufferItemUidType uid = trackerBuffer->GetOldestItemUidInBuffer(); uid < trackerBuffer->GetLatestItemUidInBuffer(); ++uid )
+  {
+    StreamBufferItem itemA;
+    StreamBufferItem itemB;
+    if ( trackerBuffer->GetStreamBufferItem(uid, &itemA) != ITEM_OK || trackerBuffer->GetStreamBufferItem(uid + 1, &itemB) != ITEM_OK
+      || itemA.GetStatus() != TOOL_OK || itemB.GetStatus() != TOOL_OK )
+    {
+      continue;
+    }
+    const double itemAtime = itemA.GetFilteredTimestamp(localTimeOffsetSec);
+    const double itemBtime = itemB.GetFilteredTimestamp(localTimeOffsetSec);
+    if ( itemBtime - itemAtime < 1e-6 )
+    {
+      continue;
+    }
+
+    vtkSmartPointer<vtkMatrix4x4> itemAmatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    vtkSmartPointer<vtkMatrix4x4> itemBmatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    itemA.GetMatrix(itemAmatrix);
+    itemB.GetMatrix(itemBmatrix);
+    double matrixA[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    double matrixB[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+    for ( int i = 0; i < 3; i++ )
+    {
+      for ( int j = 0; j < 3; j++ )
+      {
+        matrixA[i][j] = itemAmatrix->GetElement(i, j);
+        matrixB[i][j] = itemBmatrix->GetElement(i, j);
+      }
+    }
+    double matrixAquat[4] = {0, 0, 0, 0};
+    double matrixBquat[4] = {0, 0, 0, 0};
+    vtkMath::Matrix3x3ToQuaternion(matrixA, matrixAquat);
+    vtkMath::Matrix3x3ToQuaternion(matrixB, matrixBquat);
+
+    const double itemBweights[3] = { 0.25, 0.5, 0.75 };
+    for ( int weightIndex = 0; weightIndex < 3; ++weightIndex )
+    {
+      const double time = itemAtime + itemBweights[weightIndex] * (itemBtime - itemAtime);
+      StreamBufferItem interpolatedItem;
+      if ( trackerBuffer->GetStreamBufferItemFromTime(time, &interpolatedItem, vtkPlusBuffer::INTERPOLATED) != ITEM_OK
+        || interpolatedItem.GetStatus() != TOOL_OK || interpolatedItem.GetMatrix(matrix) != PLUS_SUCCESS )
+      {
+        LOG_ERROR("Failed to get interpolated tracker item (timestamp=" << std::fixed << time << ")");
+        numberOfErrors++;
+        continue;
+      }
+
+      const double itemBweight = (time - itemAtime) / (itemBtime - itemAtime);
+      double interpolatedRotationQuat[4] = {0, 0, 0, 0};
+      igsioMath::Slerp(interpolatedRotationQuat, itemBweight, matrixAquat, matrixBquat);
+      double interpolatedRotation[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+      vtkMath::QuaternionToMatrix3x3(interpolatedRotationQuat, interpolatedRotation);
+
+      double interpolationError(0);
+      for ( int i = 0; i < 3; i++ )
+      {
+        for ( int j = 0; j < 3; j++ )
+        {
+          interpolationError = std::max(interpolationError, fabs(matrix->GetElement(i, j) - interpolatedRotation[i][j]));
+        }
+        const double referenceTranslation = itemAmatrix->GetElement(i, 3) * (1.0 - itemBweight) + itemBmatrix->GetElement(i, 3) * itemBweight;
+        interpolationError = std::max(interpolationError, fabs(matrix->GetElement(i, 3) - referenceTranslation));
+      }
+      if ( interpolationError > maxInterpolationError )
+      {
+        LOG_ERROR("Interpolated pose differs from the reference interpolation (difference=" << std::scientific << interpolationError << ", threshold=" << maxInterpolationError
+          << ", itemUid=" << uid << ", timestamp=" << std::fixed << time << ")!");
+        numberOfErrors++;
+      }
+      numberOfComparedPoses++;
+    }
+  }
+  if ( numberOfComparedPoses == 0 )
+  {
+    LOG_ERROR("No interpolated poses could be compared to the reference interpolation");
+    numberOfErrors++;
+  }
+  LOG_INFO("Compared " << numberOfComparedPoses << " interpolated poses to the reference interpolation");
+
+  // Measure lookup throughput
+  //****************************
+
+  const vtkPlusBuffer::DataItemTemporalInterpolationType interpolationTypes[2] = { vtkPlusBuffer::CLOSEST_TIME, vtkPlusBuffer::INTERPOLATED };
+  const char* interpolationTypeNames[2] = { "CLOSEST_TIME", "INTERPOLATED" };
+  for ( int interpolationTypeIndex = 0; throughputPasses > 0 && interpolationTypeIndex < 2; ++interpolationTypeIndex )
+  {
+    StreamBufferItem bufferItem;
+    long numberOfLookups(0);
+    const double measurementStartTime = vtkIGSIOAccurateTimer::GetSystemTime(); 
+    for ( int pass = 0; pass < throughputPasses; ++pass )
+    {
+      for ( double newTime = startTime; newTime < endTime; newTime += 1.0 / (frameRate * 5.0) )
+      {
+        trackerBuffer->GetStreamBufferItemFromTime(newTime, &bufferItem, interpolationTypes[interpolationTypeIndex]);
+        numberOfLookups++;
+      }
+    }
+    const double elapsedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - measurementStartTime; 
+    if ( elapsedTimeSec > 0 )
+    {
+      LOG_INFO("GetStreamBufferItemFromTime throughput (" << interpolationTypeNames[interpolationTypeIndex] << "): " << std::fixed << std::setprecision(0) << numberOfLookups / elapsedTimeSec << " lookups/sec (" << numberOfLookups << " lookups in " << std::setprecision(3) << elapsedTimeSec << " sec)");
+    }
+    if ( minLookupsPerSec > 0 && numberOfLookups < minLookupsPerSec * elapsedTimeSec )
+    {
+      LOG_ERROR("GetStreamBufferItemFromTime throughput (" << interpolationTypeNames[interpolationTypeIndex] << ") is lower than the minimum (" << std::fixed << std::setprecision(0) << numberOfLookups / elapsedTimeSec << " < " << minLookupsPerSec << " lookups/sec)");
+      numberOfErrors++;
+    }
+  }
+
   if ( numberOfErrors != 0 )
   {
     LOG_INFO("Test failed!");
@@ -0,0 +1,191 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file VirtualDeviceExecutorTest.cxx
+  \brief Tests that the shared virtual device executor updates devices when new data arrives
+
+  A virtual device that counts its updates is added to a PlusVirtualDeviceExecutor. First transforms are added to its
+  input channel faster than the acquisition rate of the device: the test fails if the device is updated much less often
+  or more often than its acquisition rate. Then no data is added: the test fails if the device is updated more often than
+  the idle update period allows. Finally the device is removed and the reported number of updates is checked.
+*/
+
+#include "PlusConfigure.h"
+#include "PlusVirtualDeviceExecutor.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusDevice.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <algorithm>
+#include <atomic>
+
+//----------------------------------------------------------------------------
+/*! Virtual device that only counts how many times it is updated */
+class vtkCountingVirtualDevice : public vtkPlusDevice
+{
+public:
+  static vtkCountingVirtualDevice* New();
+  vtkTypeMacro(vtkCountingVirtualDevice, vtkPlusDevice);
+
+  virtual bool IsVirtual() const { return true; }
+
+  virtual PlusStatus InternalUpdate()
+  {
+    this->NumberOfUpdates++;
+    return PLUS_SUCCESS;
+  }
+
+  int GetNumberOfUpdates() const { return this->NumberOfUpdates.load(); }
+
+protected:
+  vtkCountingVirtualDevice() : NumberOfUpdates(0) {}
+
+  std::atomic<int> NumberOfUpdates;
+};
+
+vtkStandardNewMacro(vtkCountingVirtualDevice);
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  double inputRate = 200.0;
+  double deviceRate = 50.0;
+  double phaseDurationSec = 2.0;
+  double idleUpdatePeriodSec = 0.5;
+  int numberOfThreads = 2;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help");
+  args.AddArgument("--input-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputRate, "Rate of items added to the input channel (default: 200).");
+  args.AddArgument("--device-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &deviceRate, "Acquisition rate of the virtual device (default: 50).");
+  args.AddArgument("--phase-duration", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &phaseDurationSec, "Duration of the active and of the idle phase in seconds (default: 2).");
+  args.AddArgument("--idle-update-period", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &idleUpdatePeriodSec, "Idle update period of the executor in seconds (default: 0.5).");
+  args.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of executor threads (default: 2).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments." << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  vtkSmartPointer<vtkPlusDataSource> tool = vtkSmartPointer<vtkPlusDataSource>::New();
+  tool->SetId("Stylus");
+  tool->SetBufferSize(static_cast<int>(inputRate * phaseDurationSec) + 10);
+
+  vtkSmartPointer<vtkPlusChannel> inputChannel = vtkSmartPointer<vtkPlusChannel>::New();
+  inputChannel->SetChannelId("TrackerStream");
+  inputChannel->AddTool(tool);
+
+  vtkSmartPointer<vtkCountingVirtualDevice> device = vtkSmartPointer<vtkCountingVirtualDevice>::New();
+  device->SetDeviceId("CountingDevice");
+  device->SetAcquisitionRate(deviceRate);
+  device->AddInputChannel(inputChannel);
+  if (device->StartRecording() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start the virtual device");
+    exit(EXIT_FAILURE);
+  }
+
+  int exitCode = EXIT_SUCCESS;
+  {
+    PlusVirtualDeviceExecutor executor(numberOfThreads, idleUpdatePeriodSec);
+    if (executor.AddDevice(device) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add the device to the executor");
+      exit(EXIT_FAILURE);
+    }
+
+    // Active phase: input data arrives faster than the device acquisition rate
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    const int numberOfItems = static_cast<int>(inputRate * phaseDurationSec);
+    const double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    for (int i = 0; i < numberOfItems; ++i)
+    {
+      double timestamp = startTime + i / inputRate;
+      double waitTimeSec = timestamp - vtkIGSIOAccurateTimer::GetSystemTime();
+      if (waitTimeSec > 0)
+      {
+        vtkIGSIOAccurateTimer::Delay(waitTimeSec);
+      }
+      tool->AddTimeStampedItem(matrix, TOOL_OK, i, timestamp, timestamp);
+    }
+    const int activeUpdates = device->GetNumberOfUpdates();
+    const double expectedActiveUpdates = std::min(inputRate, deviceRate) * phaseDurationSec;
+    LOG_INFO("Active phase: " << activeUpdates << " updates (expected about " << expectedActiveUpdates << ")");
+    if (activeUpdates < expectedActiveUpdates * 0.5 || activeUpdates > expectedActiveUpdates * 1.1 + 2)
+    {
+      LOG_ERROR("Number of updates while new data arrives (" << activeUpdates << ") is too different from the expected " << expectedActiveUpdates);
+      exitCode = EXIT_FAILURE;
+    }
+
+    // Idle phase: no new data, the device is only updated at the idle update period
+    vtkIGSIOAccurateTimer::Delay(phaseDurationSec);
+    const int idleUpdates = device->GetNumberOfUpdates() - activeUpdates;
+    const double maxIdleUpdates = phaseDurationSec / idleUpdatePeriodSec + 2;
+    LOG_INFO("Idle phase: " << idleUpdates << " updates (expected at most " << maxIdleUpdates << ")");
+    if (idleUpdates > maxIdleUpdates)
+    {
+      LOG_ERROR("Device is updated too often without new data: " << idleUpdates << " updates, maximum expected: " << maxIdleUpdates);
+      exitCode = EXIT_FAILURE;
+    }
+
+    if (executor.RemoveDevice(device) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to remove the device from the executor");
+      exitCode = EXIT_FAILURE;
+    }
+    const int totalUpdates = device->GetNumberOfUpdates();
+
+    double cpuTimeSec(0.0);
+    unsigned long reportedUpdates(0);
+    if (executor.GetDeviceStatistics(device, cpuTimeSec, reportedUpdates) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Device statistics are not available");
+      exitCode = EXIT_FAILURE;
+    }
+    else
+    {
+      LOG_INFO("Reported: " << reportedUpdates << " updates, " << cpuTimeSec << " sec CPU time");
+      if (reportedUpdates != static_cast<unsigned long>(totalUpdates))
+      {
+        LOG_ERROR("Reported number of updates (" << reportedUpdates << ") differs from the actual number of updates (" << totalUpdates << ")");
+        exitCode = EXIT_FAILURE;
+      }
+    }
+
+    vtkIGSIOAccurateTimer::Delay(2 * idleUpdatePeriodSec);
+    if (device->GetNumberOfUpdates() != totalUpdates)
+    {
+      LOG_ERROR("Device is updated after it has been removed from the executor");
+      exitCode = EXIT_FAILURE;
+    }
+  }
+
+  device->StopRecording();
+  return exitCode;
+}
@@ -0,0 +1,416 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file VirtualVolumeReconstructorTest.cxx
+  \brief Tests the insertion thread and the volume snapshots of vtkPlusVirtualVolumeReconstructor
+
+  The frames of the input sequence are queued in small lists for insertion by the insertion thread. The test checks that:
+  - all the queued frames are inserted when SetEnableReconstruction(false) returns: the volume must be identical to
+    the volume that is reconstructed by inserting the same frame lists directly,
+  - Reset() discards the queued frames: the volume must remain empty,
+  - GetReconstructedVolume reuses the snapshot while the volume is not modified, and extracts a new snapshot
+    when a frame is inserted or when hole filling is switched on or off,
+  - the InsertionBacklogFrames and InsertedFramesPerSecond parameters report sensible values.
+*/
+
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkIGSIOSequenceIO.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkIGSIOTransformRepository.h"
+#include "vtkPlusVirtualVolumeReconstructor.h"
+#include "vtkPlusVolumeReconstructor.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+//----------------------------------------------------------------------------
+/*! Volume reconstructor that gives access to the frame queue and the snapshot volume */
+class vtkTestVirtualVolumeReconstructor : public vtkPlusVirtualVolumeReconstructor
+{
+public:
+  static vtkTestVirtualVolumeReconstructor* New();
+  vtkTypeMacro(vtkTestVirtualVolumeReconstructor, vtkPlusVirtualVolumeReconstructor);
+
+  using vtkPlusVirtualVolumeReconstructor::AddFrames;
+  using vtkPlusVirtualVolumeReconstructor::QueueFrames;
+  using vtkPlusVirtualVolumeReconstructor::StartInsertionThread;
+  using vtkPlusVirtualVolumeReconstructor::StopInsertionThread;
+
+  /*! Configure the volume reconstructor and set the volume extent to contain all the frames */
+  PlusStatus SetUpVolume(vtkXMLDataElement* configRootElement, const igsioTransformName& imageToReferenceTransformName, vtkIGSIOTrackedFrameList* trackedFrameList)
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
+    if (this->VolumeReconstructor->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read the volume reconstruction configuration");
+      return PLUS_FAIL;
+    }
+    if (configRootElement->FindNestedElementWithName("CoordinateDefinitions") != NULL
+        && this->TransformRepository->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read transforms from CoordinateDefinitions");
+      return PLUS_FAIL;
+    }
+    this->VolumeReconstructor->SetImageCoordinateFrame(imageToReferenceTransformName.From());
+    this->VolumeReconstructor->SetReferenceCoordinateFrame(imageToReferenceTransformName.To());
+    std::string errorDetail;
+    if (this->VolumeReconstructor->SetOutputExtentFromFrameList(trackedFrameList, this->TransformRepository, errorDetail) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to set the output extent of the volume: " << errorDetail);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  unsigned long GetVolumeModifiedCount()
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
+    return this->VolumeModifiedCount;
+  }
+
+  vtkSmartPointer<vtkImageData> GetSnapshotVolume()
+  {
+    std::lock_guard<std::mutex> snapshotLock(this->SnapshotMutex);
+    return this->SnapshotVolume;
+  }
+
+protected:
+  vtkTestVirtualVolumeReconstructor() {}
+};
+
+vtkStandardNewMacro(vtkTestVirtualVolumeReconstructor);
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*! The frame lists are cleared when they are inserted, so each insertion needs a new copy */
+  std::vector<vtkSmartPointer<vtkIGSIOTrackedFrameList> > CopyFrameLists(vtkIGSIOTrackedFrameList* trackedFrameList, int framesPerList)
+  {
+    std::vector<vtkSmartPointer<vtkIGSIOTrackedFrameList> > frameLists;
+    for (unsigned int frameIndex = 0; frameIndex < trackedFrameList->GetNumberOfTrackedFrames(); ++frameIndex)
+    {
+      if (frameIndex % framesPerList == 0)
+      {
+        frameLists.push_back(vtkSmartPointer<vtkIGSIOTrackedFrameList>::New());
+      }
+      frameLists.back()->AddTrackedFrame(trackedFrameList->GetTrackedFrame(frameIndex));
+    }
+    return frameLists;
+  }
+
+  //----------------------------------------------------------------------------
+  bool IsSameVolume(vtkImageData* volume, vtkImageData* expectedVolume)
+  {
+    int* dimensions = volume->GetDimensions();
+    int* expectedDimensions = expectedVolume->GetDimensions();
+    if (dimensions[0] != expectedDimensions[0] || dimensions[1] != expectedDimensions[1] || dimensions[2] != expectedDimensions[2]
+        || volume->GetScalarType() != expectedVolume->GetScalarType()
+        || volume->GetNumberOfScalarComponents() != expectedVolume->GetNumberOfScalarComponents())
+    {
+      LOG_ERROR("Volume geometry or pixel type differs from the expected one");
+      return false;
+    }
+    size_t volumeSizeBytes = static_cast<size_t>(volume->GetNumberOfPoints()) * volume->GetNumberOfScalarComponents() * volume->GetScalarSize();
+    return memcmp(volume->GetScalarPointer(), expectedVolume->GetScalarPointer(), volumeSizeBytes) == 0;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus GetVolume(vtkPlusVirtualVolumeReconstructor* reconstructor, vtkImageData* volume, bool applyHoleFilling = true)
+  {
+    std::string errorMessage;
+    if (reconstructor->GetReconstructedVolume(volume, errorMessage, applyHoleFilling) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to get the reconstructed volume: " << errorMessage);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  double GetNumericParameter(vtkPlusVirtualVolumeReconstructor* reconstructor, const char* key)
+  {
+    std::string valueString;
+    double value = -1.0;
+    if (reconstructor->GetParameter(key, valueString) != PLUS_SUCCESS || igsioCommon::StringToDouble(valueString.c_str(), value) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to get numeric parameter " << key << " (value: '" << valueString << "')");
+      return -1.0;
+    }
+    return value;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string inputConfigFileName;
+  std::string inputSeqFileName;
+  std::string inputImageToReferenceTransformName;
+  int framesPerList(5);
+  double queuingDurationSec(1.5);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputConfigFileName, "Configuration file name, containing the VolumeReconstruction element");
+  args.AddArgument("--source-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputSeqFileName, "Input sequence file name, containing the tracked frames");
+  args.AddArgument("--image-to-reference-transform", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputImageToReferenceTransformName, "Image to reference transform name used for the reconstruction");
+  args.AddArgument("--frames-per-list", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &framesPerList, "Number of frames in each list that is queued for insertion (Default: 5).");
+  args.AddArgument("--queuing-duration-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &queuingDurationSec, "Duration of the continuous queuing for the insertion rate measurement (Default: 1.5).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  igsioTransformName imageToReferenceTransformName;
+  if (inputConfigFileName.empty() || inputSeqFileName.empty() || framesPerList < 1
+      || imageToReferenceTransformName.SetTransformName(inputImageToReferenceTransformName.c_str()) != PLUS_SUCCESS)
+  {
+    std::cerr << "Invalid arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(configRootElement, inputConfigFileName.c_str()) == PLUS_FAIL)
+  {
+    LOG_ERROR("Unable to read configuration from file " << inputConfigFileName);
+    exit(EXIT_FAILURE);
+  }
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkIGSIOSequenceIO::Read(inputSeqFileName, trackedFrameList) != PLUS_SUCCESS || trackedFrameList->GetNumberOfTrackedFrames() == 0)
+  {
+    LOG_ERROR("Unable to load input sequence file " << inputSeqFileName);
+    exit(EXIT_FAILURE);
+  }
+  const int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
+
+  int numberOfErrors = 0;
+
+  // Reference volumes: empty, and with all the frame lists inserted directly
+  vtkSmartPointer<vtkTestVirtualVolumeReconstructor> emptyReconstructor = vtkSmartPointer<vtkTestVirtualVolumeReconstructor>::New();
+  vtkSmartPointer<vtkTestVirtualVolumeReconstructor> referenceReconstructor = vtkSmartPointer<vtkTestVirtualVolumeReconstructor>::New();
+  if (emptyReconstructor->SetUpVolume(configRootElement, imageToReferenceTransformName, trackedFrameList) != PLUS_SUCCESS
+      || referenceReconstructor->SetUpVolume(configRootElement, imageToReferenceTransformName, trackedFrameList) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+  std::vector<vtkSmartPointer<vtkIGSIOTrackedFrameList> > frameLists = CopyFrameLists(trackedFrameList, framesPerList);
+  for (std::vector<vtkSmartPointer<vtkIGSIOTrackedFrameList> >::iterator listIt = frameLists.begin(); listIt != frameLists.end(); ++listIt)
+  {
+    if (referenceReconstructor->AddFrames(*listIt) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to insert frames into the reference volume");
+      exit(EXIT_FAILURE);
+    }
+  }
+  vtkSmartPointer<vtkImageData> emptyVolume = vtkSmartPointer<vtkImageData>::New();
+  vtkSmartPointer<vtkImageData> referenceVolume = vtkSmartPointer<vtkImageData>::New();
+  if (GetVolume(emptyReconstructor, emptyVolume) != PLUS_SUCCESS || GetVolume(referenceReconstructor, referenceVolume) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+  if (IsSameVolume(referenceVolume, emptyVolume))
+  {
+    LOG_ERROR("No frames were inserted into the reference volume");
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkTestVirtualVolumeReconstructor> reconstructor = vtkSmartPointer<vtkTestVirtualVolumeReconstructor>::New();
+  if (reconstructor->SetUpVolume(configRootElement, imageToReferenceTransformName, trackedFrameList) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+  reconstructor->StartInsertionThread();
+
+  // Stopping the reconstruction waits until all the queued frames are inserted
+  {
+    reconstructor->SetEnableReconstruction(true);
+    frameLists = CopyFrameLists(trackedFrameList, framesPerList);
+    for (std::vector<vtkSmartPointer<vtkIGSIOTrackedFrameList> >::iterator listIt = frameLists.begin(); listIt != frameLists.end(); ++listIt)
+    {
+      reconstructor->QueueFrames(*listIt);
+    }
+    double backlogFrames = GetNumericParameter(reconstructor, vtkPlusVirtualVolumeReconstructor::PARAMETER_INSERTION_BACKLOG_FRAMES);
+    if (backlogFrames < 0 || backlogFrames > numberOfFrames)
+    {
+      LOG_ERROR("Insertion backlog after queuing " << numberOfFrames << " frames is " << backlogFrames);
+      numberOfErrors++;
+    }
+    reconstructor->SetEnableReconstruction(false);
+
+    backlogFrames = GetNumericParameter(reconstructor, vtkPlusVirtualVolumeReconstructor::PARAMETER_INSERTION_BACKLOG_FRAMES);
+    if (backlogFrames != 0)
+    {
+      LOG_ERROR("Insertion backlog is " << backlogFrames << " after the reconstruction is stopped, expected 0");
+      numberOfErrors++;
+    }
+    if (reconstructor->GetVolumeModifiedCount() != referenceReconstructor->GetVolumeModifiedCount())
+    {
+      LOG_ERROR(reconstructor->GetVolumeModifiedCount() << " frames are inserted when the reconstruction is stopped, expected " << referenceReconstructor->GetVolumeModifiedCount());
+      numberOfErrors++;
+    }
+    vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+    if (GetVolume(reconstructor, volume) != PLUS_SUCCESS || !IsSameVolume(volume, referenceVolume))
+    {
+      LOG_ERROR("Volume differs from the reference volume after the reconstruction is stopped");
+      numberOfErrors++;
+    }
+    LOG_INFO("Queued frames are inserted when the reconstruction is stopped");
+  }
+
+  // Reset discards the queued frames
+  {
+    reconstructor->SetEnableReconstruction(true);
+    frameLists = CopyFrameLists(trackedFrameList, framesPerList);
+    for (std::vector<vtkSmartPointer<vtkIGSIOTrackedFrameList> >::iterator listIt = frameLists.begin(); listIt != frameLists.end(); ++listIt)
+    {
+      reconstructor->QueueFrames(*listIt);
+    }
+    reconstructor->Reset();
+
+    double backlogFrames = GetNumericParameter(reconstructor, vtkPlusVirtualVolumeReconstructor::PARAMETER_INSERTION_BACKLOG_FRAMES);
+    if (backlogFrames != 0)
+    {
+      LOG_ERROR("Insertion backlog is " << backlogFrames << " after reset, expected 0");
+      numberOfErrors++;
+    }
+    // Give time to the insertion thread to insert any frames that were not discarded
+    unsigned long volumeModifiedCountAfterReset = reconstructor->GetVolumeModifiedCount();
+    vtkIGSIOAccurateTimer::Delay(0.5);
+    if (reconstructor->GetVolumeModifiedCount() != volumeModifiedCountAfterReset)
+    {
+      LOG_ERROR("Frames are inserted after reset");
+      numberOfErrors++;
+    }
+    reconstructor->SetEnableReconstruction(false);
+    vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+    if (GetVolume(reconstructor, volume) != PLUS_SUCCESS || !IsSameVolume(volume, emptyVolume))
+    {
+      LOG_ERROR("Volume is not empty after reset");
+      numberOfErrors++;
+    }
+    LOG_INFO("Queued frames are discarded on reset");
+  }
+
+  // Snapshot is reused until the volume is modified or the hole filling option changes
+  {
+    vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+    GetVolume(referenceReconstructor, volume, true);
+    vtkSmartPointer<vtkImageData> holeFilledSnapshot = referenceReconstructor->GetSnapshotVolume();
+    GetVolume(referenceReconstructor, volume, true);
+    if (referenceReconstructor->GetSnapshotVolume() != holeFilledSnapshot || !IsSameVolume(volume, referenceVolume))
+    {
+      LOG_ERROR("Snapshot is not reused when the volume is not modified");
+      numberOfErrors++;
+    }
+
+    GetVolume(referenceReconstructor, volume, false);
+    vtkSmartPointer<vtkImageData> notHoleFilledSnapshot = referenceReconstructor->GetSnapshotVolume();
+    if (notHoleFilledSnapshot == holeFilledSnapshot)
+    {
+      LOG_ERROR("Snapshot is not extracted again when hole filling is disabled");
+      numberOfErrors++;
+    }
+    GetVolume(referenceReconstructor, volume, false);
+    if (referenceReconstructor->GetSnapshotVolume() != notHoleFilledSnapshot)
+    {
+      LOG_ERROR("Snapshot without hole filling is not reused when the volume is not modified");
+      numberOfErrors++;
+    }
+    GetVolume(referenceReconstructor, volume, true);
+    if (referenceReconstructor->GetSnapshotVolume() == notHoleFilledSnapshot || !IsSameVolume(volume, referenceVolume))
+    {
+      LOG_ERROR("Snapshot is not extracted again when hole filling is enabled");
+      numberOfErrors++;
+    }
+
+    unsigned long volumeModifiedCount = referenceReconstructor->GetVolumeModifiedCount();
+    vtkSmartPointer<vtkImageData> snapshotBeforeInsertion = referenceReconstructor->GetSnapshotVolume();
+    frameLists = CopyFrameLists(trackedFrameList, framesPerList);
+    referenceReconstructor->AddFrames(frameLists.front());
+    if (referenceReconstructor->GetVolumeModifiedCount() == volumeModifiedCount)
+    {
+      LOG_ERROR("Volume modified count is not changed by inserting frames");
+      numberOfErrors++;
+    }
+    GetVolume(referenceReconstructor, volume, true);
+    if (referenceReconstructor->GetSnapshotVolume() == snapshotBeforeInsertion)
+    {
+      LOG_ERROR("Snapshot is not extracted again after frames are inserted");
+      numberOfErrors++;
+    }
+    LOG_INFO("Snapshots are reused while the volume is not modified");
+  }
+
+  // Insertion rate is measured while frames are queued continuously for longer than the averaging period
+  {
+    reconstructor->Reset();
+    reconstructor->SetEnableReconstruction(true);
+    int numberOfQueuedFrames = 0;
+    const double queuingStartTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (vtkIGSIOAccurateTimer::GetSystemTime() - queuingStartTimeSec < queuingDurationSec)
+    {
+      frameLists = CopyFrameLists(trackedFrameList, framesPerList);
+      reconstructor->QueueFrames(frameLists.front());
+      numberOfQueuedFrames += frameLists.front()->GetNumberOfTrackedFrames();
+      vtkIGSIOAccurateTimer::Delay(0.05);
+    }
+    reconstructor->SetEnableReconstruction(false);
+
+    double insertedFramesPerSecond = GetNumericParameter(reconstructor, vtkPlusVirtualVolumeReconstructor::PARAMETER_INSERTED_FRAMES_PER_SECOND);
+    if (insertedFramesPerSecond <= 0 || insertedFramesPerSecond > numberOfQueuedFrames)
+    {
+      LOG_ERROR("Inserted frames per second is " << insertedFramesPerSecond << " after queuing " << numberOfQueuedFrames << " frames in " << queuingDurationSec << " seconds");
+      numberOfErrors++;
+    }
+    double backlogFrames = GetNumericParameter(reconstructor, vtkPlusVirtualVolumeReconstructor::PARAMETER_INSERTION_BACKLOG_FRAMES);
+    if (backlogFrames != 0)
+    {
+      LOG_ERROR("Insertion backlog is " << backlogFrames << " after the reconstruction is stopped, expected 0");
+      numberOfErrors++;
+    }
+    LOG_INFO("Inserted frames per second: " << insertedFramesPerSecond);
+  }
+
+  reconstructor->StopInsertionThread();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,274 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkVirtualCaptureAsyncWriterTest.cxx
+  \brief Tests recording of frames with vtkPlusVirtualCapture when writing to disk is slow
+
+  Frames are added to the input channel at a fixed rate while the capture device writes them through a throttled
+  writer (each write is delayed to simulate a slow disk). First the writer queue is large enough to hold all the
+  frames that are waiting for the writer: the test fails if any frame is missing from the written file.
+  Then the writer queue is limited to a few frames: the test fails if no frames are reported as dropped or if the
+  number of written frames is not the same as the number of recorded frames.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkPlusVirtualCapture.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//----------------------------------------------------------------------------
+/*! Capture device that simulates a slow disk by delaying each write */
+class vtkThrottledVirtualCapture : public vtkPlusVirtualCapture
+{
+public:
+  static vtkThrottledVirtualCapture* New();
+  vtkTypeMacro(vtkThrottledVirtualCapture, vtkPlusVirtualCapture);
+
+  vtkSetMacro(WriteDelaySec, double);
+
+protected:
+  vtkThrottledVirtualCapture() : WriteDelaySec(0.0) {}
+
+  virtual PlusStatus WriteFrameBatch(vtkIGSIOSequenceIOBase* writer, vtkIGSIOTrackedFrameList* frames)
+  {
+    vtkIGSIOAccurateTimer::Delay(this->WriteDelaySec);
+    return this->Superclass::WriteFrameBatch(writer, frames);
+  }
+
+  double WriteDelaySec;
+};
+
+vtkStandardNewMacro(vtkThrottledVirtualCapture);
+
+namespace
+{
+  const unsigned int FRAME_SIZE_PX = 64;
+
+  struct CaptureResult
+  {
+    CaptureResult() : NumberOfProducedFrames(0), NumberOfRecordedFrames(0), NumberOfDroppedFrames(0), FirstFrameTimestamp(0.0), FramePeriodSec(0.0) {}
+    int NumberOfProducedFrames;
+    long int NumberOfRecordedFrames;
+    long int NumberOfDroppedFrames;
+    std::string OutputFileName;
+    double FirstFrameTimestamp;
+    double FramePeriodSec;
+  };
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunCapture(const std::string& outputFileName, double writerQueueMaxMemoryMb, double writeDelaySec, double frameRate, double acquisitionTimeSec, CaptureResult& result)
+  {
+    vtkSmartPointer<vtkPlusDataSource> videoSource = vtkSmartPointer<vtkPlusDataSource>::New();
+    videoSource->SetId("Video");
+    videoSource->SetBufferSize(static_cast<int>(frameRate * (acquisitionTimeSec + 5.0)));
+    videoSource->SetInputImageOrientation(US_IMG_ORIENT_MF);
+    videoSource->SetImageType(US_IMG_BRIGHTNESS);
+    videoSource->SetPixelType(VTK_UNSIGNED_CHAR);
+    videoSource->SetNumberOfScalarComponents(1);
+    videoSource->SetInputFrameSize(FRAME_SIZE_PX, FRAME_SIZE_PX, 1);
+
+    vtkSmartPointer<vtkPlusChannel> inputChannel = vtkSmartPointer<vtkPlusChannel>::New();
+    inputChannel->SetChannelId("VideoStream");
+    inputChannel->SetVideoSource(videoSource);
+
+    vtkSmartPointer<vtkThrottledVirtualCapture> capture = vtkSmartPointer<vtkThrottledVirtualCapture>::New();
+    capture->SetDeviceId("CaptureDevice");
+    capture->SetBaseFilename(outputFileName);
+    capture->SetRequestedFrameRate(frameRate * 10.0); // record all the input frames
+    capture->SetEnableAsyncWriting(true);
+    capture->SetWriterQueueMaxMemoryMb(writerQueueMaxMemoryMb);
+    capture->SetWriteDelaySec(writeDelaySec);
+    capture->AddInputChannel(inputChannel);
+    if (capture->NotifyConfigured() != PLUS_SUCCESS || capture->Connect() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to connect capture device");
+      return PLUS_FAIL;
+    }
+
+    // The capture device is not started, its update is called from this thread after each added frame
+    std::vector<unsigned char> image(FRAME_SIZE_PX * FRAME_SIZE_PX);
+    FrameSizeType frameSize = {FRAME_SIZE_PX, FRAME_SIZE_PX, 1};
+    result.FramePeriodSec = 1.0 / frameRate;
+    result.FirstFrameTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+    result.NumberOfProducedFrames = static_cast<int>(acquisitionTimeSec * frameRate);
+    capture->SetEnableCapturing(true);
+    for (int frameIndex = 0; frameIndex < result.NumberOfProducedFrames; ++frameIndex)
+    {
+      double timestamp = result.FirstFrameTimestamp + frameIndex * result.FramePeriodSec;
+      double waitTimeSec = timestamp - vtkIGSIOAccurateTimer::GetSystemTime();
+      if (waitTimeSec > 0)
+      {
+        vtkIGSIOAccurateTimer::Delay(waitTimeSec);
+      }
+      std::fill(image.begin(), image.end(), static_cast<unsigned char>(frameIndex));
+      if (videoSource->AddItem(&image[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameIndex, timestamp, timestamp) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to add frame " << frameIndex << " to the input buffer");
+        return PLUS_FAIL;
+      }
+      if (capture->InternalUpdate() != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Capture device update failed");
+        return PLUS_FAIL;
+      }
+    }
+
+    // Record the remaining frames of the input buffer
+    for (int i = 0; i < 3; ++i)
+    {
+      vtkIGSIOAccurateTimer::Delay(2.0 / capture->GetAcquisitionRate());
+      capture->InternalUpdate();
+    }
+    capture->SetEnableCapturing(false);
+
+    result.NumberOfRecordedFrames = capture->GetTotalFramesRecorded();
+    result.NumberOfDroppedFrames = capture->GetNumberOfDroppedFrames();
+
+    // Closing the file waits until all queued frames are written
+    double closeStartTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+    if (capture->CloseFile(NULL, &result.OutputFileName) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to close the output file");
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Writing of the queued frames completed in " << vtkIGSIOAccurateTimer::GetSystemTime() - closeStartTimeSec << " sec after the end of the acquisition");
+    capture->Disconnect();
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus ReadRecordedFrames(const CaptureResult& result, vtkIGSIOTrackedFrameList* frames)
+  {
+    if (vtkPlusSequenceIO::Read(result.OutputFileName, frames) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read recorded file " << result.OutputFileName);
+      return PLUS_FAIL;
+    }
+    LOG_INFO("Produced frames: " << result.NumberOfProducedFrames << ", recorded: " << result.NumberOfRecordedFrames
+             << ", dropped: " << result.NumberOfDroppedFrames << ", written: " << frames->GetNumberOfTrackedFrames());
+    if (frames->GetNumberOfTrackedFrames() != result.NumberOfRecordedFrames)
+    {
+      LOG_ERROR("Number of written frames (" << frames->GetNumberOfTrackedFrames() << ") differs from the number of recorded frames (" << result.NumberOfRecordedFrames << ")");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int GetFrameIndex(const CaptureResult& result, igsioTrackedFrame* frame)
+  {
+    return static_cast<int>(floor((frame->GetTimestamp() - result.FirstFrameTimestamp) / result.FramePeriodSec + 0.5));
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  double frameRate = 50.0;
+  double acquisitionTimeSec = 2.0;
+  double writeDelaySec = 0.05;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help");
+  args.AddArgument("--frame-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &frameRate, "Rate of frames added to the input channel (default: 50).");
+  args.AddArgument("--acquisition-time", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &acquisitionTimeSec, "Length of the acquisition in seconds (default: 2).");
+  args.AddArgument("--write-delay", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &writeDelaySec, "Simulated disk delay of writing a list of frames in seconds (default: 0.05).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  // The capture device saves the device set configuration next to the recorded file
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  configRootElement->SetName("PlusConfiguration");
+  vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+
+  int exitCode = EXIT_SUCCESS;
+
+  // Slow writer, but the queue can hold all the frames: no frame may be lost
+  LOG_INFO("Recording with throttled writer, writer queue has room for all frames");
+  CaptureResult result;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> writtenFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (RunCapture("AsyncWriterTest.nrrd", 64.0, writeDelaySec, frameRate, acquisitionTimeSec, result) != PLUS_SUCCESS
+      || ReadRecordedFrames(result, writtenFrames) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+  if (result.NumberOfDroppedFrames != 0)
+  {
+    LOG_ERROR(result.NumberOfDroppedFrames << " frames were dropped although the writer queue had room for them");
+    exitCode = EXIT_FAILURE;
+  }
+  if (writtenFrames->GetNumberOfTrackedFrames() == 0)
+  {
+    LOG_ERROR("No frames were written");
+    exit(EXIT_FAILURE);
+  }
+  for (unsigned int frameIndex = 1; frameIndex < writtenFrames->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    int previousInputFrameIndex = GetFrameIndex(result, writtenFrames->GetTrackedFrame(frameIndex - 1));
+    int inputFrameIndex = GetFrameIndex(result, writtenFrames->GetTrackedFrame(frameIndex));
+    if (inputFrameIndex != previousInputFrameIndex + 1)
+    {
+      LOG_ERROR("Frames are missing from the recording between input frame " << previousInputFrameIndex << " and " << inputFrameIndex);
+      exitCode = EXIT_FAILURE;
+    }
+  }
+  int lastInputFrameIndex = GetFrameIndex(result, writtenFrames->GetTrackedFrame(writtenFrames->GetNumberOfTrackedFrames() - 1));
+  if (lastInputFrameIndex != result.NumberOfProducedFrames - 1)
+  {
+    LOG_ERROR("Last recorded frame is input frame " << lastInputFrameIndex << ", expected " << result.NumberOfProducedFrames - 1);
+    exitCode = EXIT_FAILURE;
+  }
+
+  // Slow writer and the queue can hold only a few frames: frames are dropped, but the written file must be consistent
+  LOG_INFO("Recording with throttled writer, writer queue is too small");
+  const double smallQueueMaxMemoryMb = 4.0 * FRAME_SIZE_PX * FRAME_SIZE_PX / (1024.0 * 1024.0);
+  CaptureResult overflowResult;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> overflowWrittenFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (RunCapture("AsyncWriterOverflowTest.nrrd", smallQueueMaxMemoryMb, writeDelaySec * 4.0, frameRate, acquisitionTimeSec, overflowResult) != PLUS_SUCCESS
+      || ReadRecordedFrames(overflowResult, overflowWrittenFrames) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+  if (overflowResult.NumberOfDroppedFrames == 0)
+  {
+    LOG_ERROR("No dropped frames were reported although the writer could not keep up with the recording");
+    exitCode = EXIT_FAILURE;
+  }
+
+  return exitCode;
+}
@@ -15,6 +15,9 @@ See License.txt for details.
 #include "vtkPlusVirtualCapture.h"
 #include "vtksys/SystemTools.hxx"
 
+// STL includes
+#include <algorithm>
+
 #ifdef PLUS_USE_VTKVIDEOIO_MKV
 //  #include "vtkPlusMkvSequenceIO.h"
 #endif
@@ -30,6 +33,22 @@ namespace
   static const double WARNING_RECORDING_LAG_SEC = 1.0; // if the recording lags more than this then a warning message will be displayed
   static const double MAX_ALLOWED_RECORDING_LAG_SEC = 3.0; // if the recording lags more than this then it'll skip frames to catch up
   static const unsigned int DISABLE_FRAME_BUFFER = std::numeric_limits<unsigned int>::max();
+  static const double DROPPED_FRAMES_LOG_INTERVAL_SEC = 1.0; // minimum time between two dropped frames error messages
+
+  //----------------------------------------------------------------------------
+  size_t GetImageSizeInBytes(vtkIGSIOTrackedFrameList* frames)
+  {
+    size_t sizeInBytes = 0;
+    for (unsigned int frameIndex = 0; frameIndex < frames->GetNumberOfTrackedFrames(); ++frameIndex)
+    {
+      igsioVideoFrame* image = frames->GetTrackedFrame(frameIndex)->GetImageData();
+      if (image != NULL && image->IsImageValid())
+      {
+        sizeInBytes += image->GetFrameSizeInBytes();
+      }
+    }
+    return sizeInBytes;
+  }
 }
 
 //----------------------------------------------------------------------------
@@ -47,6 +66,9 @@ vtkPlusVirtualCapture::vtkPlusVirtualCapture()
   , BaseFilename("TrackedImageSequence.nrrd")
   , Writer(NULL)
   , EnableFileCompression(false)
+  , EnableParallelCompression(true)
+  , CompressionMethod(PlusParallelDeflate::COMPRESSION_DEFAULT)
+  , NumberOfCompressionThreads(0)
   , IsHeaderPrepared(false)
   , TotalFramesRecorded(0)
   , EnableCapturingOnStart(false)
@@ -56,6 +78,15 @@ vtkPlusVirtualCapture::vtkPlusVirtualCapture()
   , WriterAccessMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
   , GracePeriodLogLevel(vtkPlusLogger::LOG_LEVEL_DEBUG)
   , EncodingFourCC("VP90")
+  , EnableAsyncWriting(true)
+  , WriterQueueMaxMemoryMb(512.0)
+  , WriterQueueSizeInBytes(0)
+  , WriterBusy(false)
+  , WriterFailed(false)
+  , WriterStopRequested(false)
+  , NumberOfDroppedFrames(0)
+  , WriterQueueOverflow(false)
+  , LastDroppedFramesLogTimeSec(0.0)
 {
   this->AcquisitionRate = 30.0;
   this->MissingInputGracePeriodSec = 2.0;
@@ -73,6 +104,9 @@ vtkPlusVirtualCapture::~vtkPlusVirtualCapture()
     this->CloseFile();
   }
 
+  this->StopWriterThread();
+  this->WriterTrackedFrameList = NULL;
+
   if (RecordedFrames != NULL)
   {
     this->RecordedFrames->Delete();
@@ -109,6 +143,14 @@ PlusStatus vtkPlusVirtualCapture::ReadConfiguration(vtkXMLDataElement* rootConfi
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, RequestedFrameRate, deviceConfig);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, FrameBufferSize, deviceConfig);
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(EncodingFourCC, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableAsyncWriting, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, WriterQueueMaxMemoryMb, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableParallelCompression, deviceConfig);
+  XML_READ_ENUM3_ATTRIBUTE_OPTIONAL(CompressionMethod, deviceConfig,
+                                    "DEFAULT", PlusParallelDeflate::COMPRESSION_DEFAULT,
+                                    "FAST", PlusParallelDeflate::COMPRESSION_FAST,
+                                    "RLE", PlusParallelDeflate::COMPRESSION_RLE);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfCompressionThreads, deviceConfig);
 
   return PLUS_SUCCESS;
 }
@@ -121,6 +163,11 @@ PlusStatus vtkPlusVirtualCapture::WriteConfiguration(vtkXMLDataElement* rootConf
   deviceElement->SetAttribute("EnableFileCompression", this->EnableFileCompression ? "TRUE" : "FALSE");
   deviceElement->SetAttribute("EnableCaptureOnStart", this->EnableCapturingOnStart ? "TRUE" : "FALSE");
   deviceElement->SetDoubleAttribute("RequestedFrameRate", this->GetRequestedFrameRate());
+  deviceElement->SetAttribute("EnableAsyncWriting", this->EnableAsyncWriting ? "TRUE" : "FALSE");
+  deviceElement->SetDoubleAttribute("WriterQueueMaxMemoryMb", this->WriterQueueMaxMemoryMb);
+  deviceElement->SetAttribute("EnableParallelCompression", this->EnableParallelCompression ? "TRUE" : "FALSE");
+  deviceElement->SetAttribute("CompressionMethod", PlusParallelDeflate::GetCompressionMethodAsString(this->CompressionMethod).c_str());
+  deviceElement->SetIntAttribute("NumberOfCompressionThreads", this->NumberOfCompressionThreads);
 
   return PLUS_SUCCESS;
 }
@@ -134,6 +181,11 @@ PlusStatus vtkPlusVirtualCapture::InternalConnect()
     return PLUS_FAIL;
   }
 
+  if (this->EnableAsyncWriting)
+  {
+    this->StartWriterThread();
+  }
+
   if (this->GetEnableCapturingOnStart())
   {
     this->SetEnableCapturing(true);
@@ -149,25 +201,9 @@ PlusStatus vtkPlusVirtualCapture::InternalDisconnect()
 {
   this->EnableCapturing = false;
 
-  // If outstanding frames to be written, deal with them
-  if (this->RecordedFrames->GetNumberOfTrackedFrames() != 0 && this->IsHeaderPrepared)
-  {
-    if (this->Writer->AppendImagesToHeader() != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Unable to append image data to header.");
-      this->Disconnect();
-      return PLUS_FAIL;
-    }
-    if (this->Writer->WriteImages() != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Unable to append images. Stopping recording at timestamp: " << this->LastAlreadyRecordedFrameTimestamp);
-      this->Disconnect();
-      return PLUS_FAIL;
-    }
-
-    this->ClearRecordedFrames();
-  }
+  // Outstanding frames are written and the queued frames are flushed when the file is closed
   PlusStatus status = this->CloseFile();
+  this->StopWriterThread();
   return status;
 }
 
@@ -185,25 +221,30 @@ PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
       // default to nrrd
       ext = ".nrrd";
     }
-    else if (vtkIGSIOMetaImageSequenceIO::CanWriteFile(this->BaseFilename) && this->GetEnableFileCompression())
-    {
-      // they've requested mhd/mha with compression, no can do, yet
-      LOG_WARNING("Compressed saving of metaimage file requested. This is not supported. Reverting to uncompressed metaimage file.");
-      this->SetEnableFileCompression(false);
-    }
     this->CurrentFilename = filenameRoot + "_" + vtksys::SystemTools::GetCurrentDateTime("%Y%m%d_%H%M%S") + ext;
-    aFilename = this->CurrentFilename.c_str();
   }
   else
   {
-    if (vtkIGSIOMetaImageSequenceIO::CanWriteFile(aFilename) && this->GetEnableFileCompression())
-    {
-      // they've requested mhd/mha with compression, no can do, yet
-      LOG_WARNING("Compressed saving of metaimage file requested. This is not supported. Reverting to uncompressed metaimage file.");
-      this->SetEnableFileCompression(false);
-    }
     this->CurrentFilename = aFilename;
   }
+  aFilename = this->CurrentFilename.c_str();
+
+  // Parallel compression requires images, recordings of tracking data only are written by the sequence writer
+  this->CompressedWriter = NULL;
+  bool hasVideoSource = !this->InputChannels.empty() && this->InputChannels[0]->HasVideoSource();
+  if (this->EnableFileCompression && this->EnableParallelCompression && hasVideoSource && vtkPlusCompressedSequenceWriter::CanWriteFile(aFilename))
+  {
+    this->CompressedWriter = vtkSmartPointer<vtkPlusCompressedSequenceWriter>::New();
+    this->CompressedWriter->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(aFilename));
+    this->CompressedWriter->SetCompressionMethod(this->CompressionMethod);
+    this->CompressedWriter->SetNumberOfThreads(this->NumberOfCompressionThreads);
+  }
+  else if (vtkIGSIOMetaImageSequenceIO::CanWriteFile(aFilename) && this->GetEnableFileCompression())
+  {
+    // they've requested mhd/mha with compression, only the parallel compressed writer can write it while recording
+    LOG_WARNING("Compressed saving of metaimage file requested. This is only supported with EnableParallelCompression and video input. Reverting to uncompressed metaimage file.");
+    this->SetEnableFileCompression(false);
+  }
 
   this->Writer = vtkIGSIOSequenceIO::CreateSequenceHandlerForFile(aFilename);
   if (!this->Writer)
@@ -212,7 +253,7 @@ PlusStatus vtkPlusVirtualCapture::OpenFile(const char* aFilename)
     return PLUS_FAIL;
   }
   this->Writer->SetUseCompression(this->EnableFileCompression);
-  this->Writer->SetTrackedFrameList(this->RecordedFrames);
+  this->ResetWriterTrackedFrameList();
   // Need to set the filename before finalizing header, because the pixel data file name depends on the file extension
   this->Writer->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(aFilename));
 
@@ -235,6 +276,10 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
   {
     // Need to set the filename before finalizing header, because the pixel data file name depends on the file extension
     this->Writer->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(aFilename));
+    if (this->CompressedWriter != NULL)
+    {
+      this->CompressedWriter->SetFileName(vtkPlusConfig::GetInstance()->GetOutputPath(aFilename));
+    }
     this->CurrentFilename = aFilename;
   }
 
@@ -244,17 +289,43 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
     this->WriteFrames(true);
   }
 
-  this->Writer->UpdateDimensionsCustomStrings(this->TotalFramesRecorded, this->GetIsData3D());
-  this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionSizeString());
-  this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionKindsString());
-  this->Writer->FinalizeHeader();
+  PlusStatus status = this->WaitForQueuedFramesWritten();
+  if (status != PLUS_SUCCESS)
+  {
+    LOG_ERROR(this->GetDeviceId() << ": Failed to write all recorded frames to " << this->CurrentFilename << ". Number of dropped frames: " << this->GetNumberOfDroppedFrames());
+  }
+  this->ResetWriterTrackedFrameList();
 
-  if (resultFilename != NULL)
+  if (this->CompressedWriter != NULL)
   {
-    (*resultFilename) = this->Writer->GetFileName();
+    for (std::map<std::string, std::string>::iterator fieldIt = this->CustomHeaderFields.begin(); fieldIt != this->CustomHeaderFields.end(); ++fieldIt)
+    {
+      this->CompressedWriter->SetCustomField(fieldIt->first, fieldIt->second);
+    }
+    if (this->CompressedWriter->Close() != PLUS_SUCCESS)
+    {
+      LOG_ERROR(this->GetDeviceId() << ": Failed to write compressed file " << this->CompressedWriter->GetFileName());
+      status = PLUS_FAIL;
+    }
+    if (resultFilename != NULL)
+    {
+      (*resultFilename) = this->CompressedWriter->GetFileName();
+    }
   }
+  else
+  {
+    this->Writer->UpdateDimensionsCustomStrings(this->TotalFramesRecorded, this->GetIsData3D());
+    this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionSizeString());
+    this->Writer->UpdateFieldInImageHeader(this->Writer->GetDimensionKindsString());
+    this->Writer->FinalizeHeader();
+
+    if (resultFilename != NULL)
+    {
+      (*resultFilename) = this->Writer->GetFileName();
+    }
 
-  this->Writer->Close();
+    this->Writer->Close();
+  }
 
   std::string fullPath = vtkPlusConfig::GetInstance()->GetOutputPath(this->CurrentFilename);
   std::string path = vtksys::SystemTools::GetFilenamePath(fullPath);
@@ -262,16 +333,25 @@ PlusStatus vtkPlusVirtualCapture::CloseFile(const char* aFilename /* = NULL */,
   std::string configFileName = path + "/" + filename + "_config.xml";
   igsioCommon::XML::PrintXML(configFileName.c_str(), vtkPlusConfig::GetInstance()->GetDeviceSetConfigurationData());
 
+  LOG_DEBUG("Recorded video frames: " << this->FrameCopyCounter.NumberOfSharedFrames << " shared, "
+            << this->FrameCopyCounter.NumberOfCopiedFrames << " copied (" << this->FrameCopyCounter.NumberOfCopiedBytes << " bytes)");
+
   this->IsHeaderPrepared = false;
   this->TotalFramesRecorded = 0;
+  this->FrameCopyCounter = vtkPlusChannel::FrameCopyCounter();
   this->RecordedFrames->Clear();
+  {
+    std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+    this->NumberOfDroppedFrames = 0;
+    this->WriterFailed = false;
+  }
 
   if (this->OpenFile() != PLUS_SUCCESS)
   {
     return PLUS_FAIL;
   }
 
-  return PLUS_SUCCESS;
+  return status;
 }
 
 //----------------------------------------------------------------------------
@@ -502,15 +582,29 @@ PlusStatus vtkPlusVirtualCapture::Reset()
 
     this->SetEnableCapturing(false);
 
+    this->DiscardQueuedFrames();
+    this->ResetWriterTrackedFrameList();
+
     if (this->IsHeaderPrepared)
     {
-      this->Writer->Discard();
+      if (this->CompressedWriter != NULL)
+      {
+        this->CompressedWriter->Discard();
+      }
+      else
+      {
+        this->Writer->Discard();
+      }
     }
 
     this->ClearRecordedFrames();
-    this->Writer->GetTrackedFrameList()->Clear();
     this->IsHeaderPrepared = false;
     this->TotalFramesRecorded = 0;
+    {
+      std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+      this->NumberOfDroppedFrames = 0;
+      this->WriterFailed = false;
+    }
   }
 
   if (this->OpenFile() != PLUS_SUCCESS)
@@ -576,6 +670,8 @@ PlusStatus vtkPlusVirtualCapture::TakeSnapshot()
     return PLUS_FAIL;
   }
 
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+
   // Add tracked frame to the list
   // Snapshots are triggered manually, so the additional copying in AddTrackedFrame compared to TakeTrackedFrame is not relevant.
   if (this->RecordedFrames->AddTrackedFrame(&trackedFrame, vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
@@ -598,15 +694,32 @@ PlusStatus vtkPlusVirtualCapture::TakeSnapshot()
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::SetCustomHeaderField(const std::string& fieldName, const std::string& fieldValue)
 {
-  return this->Writer->GetTrackedFrameList()->SetCustomString(fieldName, fieldValue);
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->WriterAccessMutex);
+
+  // The frame list is handed over to the writer thread when it is written, so store the field for the next lists, too
+  this->CustomHeaderFields[fieldName] = fieldValue;
+  return this->RecordedFrames->SetCustomString(fieldName, fieldValue);
 }
 
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualCapture::WriteFrames(bool force)
 {
+  bool writerFailed = false;
+  {
+    std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+    writerFailed = this->WriterFailed;
+  }
+  if (writerFailed)
+  {
+    LOG_ERROR("Writing of recorded frames failed. Stopping recording at timestamp: " << LastAlreadyRecordedFrameTimestamp);
+    this->StopRecording();
+    return PLUS_FAIL;
+  }
+
   if (!this->IsHeaderPrepared && this->RecordedFrames->GetNumberOfTrackedFrames() != 0)
   {
-    if (this->Writer->PrepareHeader() != PLUS_SUCCESS)
+    PlusStatus prepareStatus = (this->CompressedWriter != NULL ? this->CompressedWriter->Open() : this->Writer->PrepareHeader());
+    if (prepareStatus != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to prepare header");
       this->StopRecording();
@@ -625,15 +738,14 @@ PlusStatus vtkPlusVirtualCapture::WriteFrames(bool force)
   if (force || !this->IsFrameBuffered() ||
       (this->IsFrameBuffered() && this->RecordedFrames->GetNumberOfTrackedFrames() > this->GetFrameBufferSize()))
   {
-    if (this->Writer->AppendImagesToHeader() != PLUS_SUCCESS)
+    if (this->WriterThread.joinable())
     {
-      LOG_ERROR("Unable to append image data to header.");
-      this->StopRecording();
-      return PLUS_FAIL;
+      return this->QueueRecordedFrames(force);
     }
-    if (this->Writer->WriteImages() != PLUS_SUCCESS)
+
+    if (this->WriteFrameBatch(this->Writer, this->RecordedFrames) != PLUS_SUCCESS)
     {
-      LOG_ERROR("Unable to append images. Stopping recording at timestamp: " << LastAlreadyRecordedFrameTimestamp);
+      LOG_ERROR("Stopping recording at timestamp: " << LastAlreadyRecordedFrameTimestamp);
       this->StopRecording();
       return PLUS_FAIL;
     }
@@ -644,6 +756,214 @@ PlusStatus vtkPlusVirtualCapture::WriteFrames(bool force)
   return PLUS_SUCCESS;
 }
 
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::WriteFrameBatch(vtkIGSIOSequenceIOBase* writer, vtkIGSIOTrackedFrameList* frames)
+{
+  if (this->CompressedWriter != NULL)
+  {
+    // The compressed writer is only replaced when the file is opened, after all the queued frames are written
+    return this->CompressedWriter->AppendFrames(frames);
+  }
+
+  writer->SetTrackedFrameList(frames);
+  if (writer->AppendImagesToHeader() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to append image data to header.");
+    return PLUS_FAIL;
+  }
+  if (writer->WriteImages() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to append images.");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::QueueRecordedFrames(bool waitForSpace)
+{
+  // Swap in a new list, so that sampling can continue while the writer thread writes the completed one
+  WriterQueueItem item;
+  item.Writer = this->Writer;
+  item.Frames.TakeReference(this->RecordedFrames);
+  item.SizeInBytes = GetImageSizeInBytes(item.Frames);
+  this->RecordedFrames = this->CreateRecordedFrameList();
+
+  const size_t maxSizeInBytes = static_cast<size_t>(std::max(this->WriterQueueMaxMemoryMb, 0.0) * 1024.0 * 1024.0);
+  const int numberOfFrames = item.Frames->GetNumberOfTrackedFrames();
+  {
+    std::unique_lock<std::mutex> lock(this->WriterQueueMutex);
+    // A list is always accepted if nothing is in flight, otherwise a list larger than the limit could never be written
+    if (waitForSpace)
+    {
+      this->QueueSpaceAvailable.wait(lock, [this, &item, maxSizeInBytes]()
+      {
+        return this->WriterQueueSizeInBytes == 0 || this->WriterQueueSizeInBytes + item.SizeInBytes <= maxSizeInBytes || this->WriterFailed;
+      });
+    }
+    else if (this->WriterQueueSizeInBytes > 0 && this->WriterQueueSizeInBytes + item.SizeInBytes > maxSizeInBytes)
+    {
+      this->NumberOfDroppedFrames += numberOfFrames;
+      long int numberOfDroppedFrames = this->NumberOfDroppedFrames;
+      size_t queueSizeInBytes = this->WriterQueueSizeInBytes;
+      lock.unlock();
+
+      this->TotalFramesRecorded -= numberOfFrames;
+      double currentTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (!this->WriterQueueOverflow || currentTimeSec - this->LastDroppedFramesLogTimeSec >= DROPPED_FRAMES_LOG_INTERVAL_SEC)
+      {
+        LOG_ERROR(this->GetDeviceId() << ": Writing to disk cannot keep up with the recording, writer queue is full ("
+                  << queueSizeInBytes / (1024.0 * 1024.0) << " MB). Total number of dropped frames: " << numberOfDroppedFrames
+                  << ". Increase WriterQueueMaxMemoryMb or reduce the requested frame rate to avoid this.");
+        this->LastDroppedFramesLogTimeSec = currentTimeSec;
+      }
+      this->WriterQueueOverflow = true;
+      return PLUS_SUCCESS;
+    }
+
+    this->WriterQueue.push_back(item);
+    this->WriterQueueSizeInBytes += item.SizeInBytes;
+  }
+  this->FramesQueued.notify_one();
+
+  if (this->WriterQueueOverflow)
+  {
+    LOG_INFO(this->GetDeviceId() << ": Writer queue has space again. Number of dropped frames: " << this->GetNumberOfDroppedFrames());
+    this->WriterQueueOverflow = false;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+vtkIGSIOTrackedFrameList* vtkPlusVirtualCapture::CreateRecordedFrameList()
+{
+  vtkIGSIOTrackedFrameList* frames = vtkIGSIOTrackedFrameList::New();
+  frames->SetValidationRequirements(REQUIRE_UNIQUE_TIMESTAMP);
+  for (std::map<std::string, std::string>::iterator fieldIt = this->CustomHeaderFields.begin(); fieldIt != this->CustomHeaderFields.end(); ++fieldIt)
+  {
+    frames->SetCustomString(fieldIt->first, fieldIt->second);
+  }
+  return frames;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::StartWriterThread()
+{
+  if (this->WriterThread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+    this->WriterStopRequested = false;
+  }
+  this->WriterThread = std::thread(&vtkPlusVirtualCapture::WritingThread, this);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::StopWriterThread()
+{
+  if (!this->WriterThread.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+    this->WriterStopRequested = true;
+  }
+  this->FramesQueued.notify_one();
+  // The thread writes all the queued frames before it exits
+  this->WriterThread.join();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::WritingThread()
+{
+  std::unique_lock<std::mutex> lock(this->WriterQueueMutex);
+  while (true)
+  {
+    this->FramesQueued.wait(lock, [this]()
+    {
+      return this->WriterStopRequested || !this->WriterQueue.empty();
+    });
+    if (this->WriterQueue.empty())
+    {
+      // stop requested and there is nothing left to write
+      break;
+    }
+
+    WriterQueueItem item = this->WriterQueue.front();
+    this->WriterQueue.pop_front();
+    this->WriterBusy = true;
+    bool writerFailed = this->WriterFailed;
+    lock.unlock();
+
+    // Write without holding the lock, so that the capture thread can keep queuing frames
+    PlusStatus status = PLUS_FAIL;
+    if (!writerFailed)
+    {
+      status = this->WriteFrameBatch(item.Writer, item.Frames);
+    }
+
+    lock.lock();
+    if (status != PLUS_SUCCESS)
+    {
+      // Once a write failed the file is incomplete, the rest of the queued frames are discarded
+      this->WriterFailed = true;
+      this->NumberOfDroppedFrames += item.Frames->GetNumberOfTrackedFrames();
+    }
+    this->WriterTrackedFrameList = item.Frames;
+    this->WriterQueueSizeInBytes -= item.SizeInBytes;
+    this->WriterBusy = false;
+    this->QueueSpaceAvailable.notify_all();
+  }
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualCapture::WaitForQueuedFramesWritten()
+{
+  std::unique_lock<std::mutex> lock(this->WriterQueueMutex);
+  this->QueueSpaceAvailable.wait(lock, [this]()
+  {
+    return this->WriterQueue.empty() && !this->WriterBusy;
+  });
+  return this->WriterFailed ? PLUS_FAIL : PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::DiscardQueuedFrames()
+{
+  std::unique_lock<std::mutex> lock(this->WriterQueueMutex);
+  while (!this->WriterQueue.empty())
+  {
+    this->WriterQueueSizeInBytes -= this->WriterQueue.front().SizeInBytes;
+    this->WriterQueue.pop_front();
+  }
+  this->QueueSpaceAvailable.wait(lock, [this]()
+  {
+    return !this->WriterBusy;
+  });
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualCapture::ResetWriterTrackedFrameList()
+{
+  if (this->Writer != NULL)
+  {
+    this->Writer->SetTrackedFrameList(this->RecordedFrames);
+  }
+  std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+  this->WriterTrackedFrameList = this->RecordedFrames;
+}
+
+//-----------------------------------------------------------------------------
+long int vtkPlusVirtualCapture::GetNumberOfDroppedFrames()
+{
+  std::lock_guard<std::mutex> lock(this->WriterQueueMutex);
+  return this->NumberOfDroppedFrames;
+}
+
 //-----------------------------------------------------------------------------
 int vtkPlusVirtualCapture::OutputChannelCount() const
 {
@@ -673,7 +993,7 @@ PlusStatus vtkPlusVirtualCapture::GetInputTrackedFrameListSampled(double& lastAl
     return PLUS_FAIL;
   }
 
-  return this->OutputChannels[0]->GetTrackedFrameListSampled(lastAlreadyRecordedFrameTimestamp, nextFrameToBeRecordedTimestamp, recordedFrames, requestedFramePeriodSec, maxProcessingTimeSec);
+  return this->OutputChannels[0]->GetTrackedFrameListSampled(lastAlreadyRecordedFrameTimestamp, nextFrameToBeRecordedTimestamp, recordedFrames, requestedFramePeriodSec, maxProcessingTimeSec, true, &this->FrameCopyCounter);
 }
 
 //-----------------------------------------------------------------------------
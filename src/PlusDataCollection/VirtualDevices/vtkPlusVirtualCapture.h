@@ -10,13 +10,31 @@ See License.txt for details.
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusDevice.h"
 #include "vtkIGSIOSequenceIOBase.h"
+#include "vtkPlusCompressedSequenceWriter.h"
+
+// STL includes
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 
 //class vtkIGSIOTrackedFrameList;
 
 /*!
 \class vtkPlusVirtualCapture
-\brief
+\brief Records the frames of the input channel to a sequence file
+
+By default the frames are written to disk by a dedicated writer thread (EnableAsyncWriting="TRUE"): the capture
+thread only samples the input channel into a frame list and hands over the completed list to the writer thread
+through a queue, so slow disk writes do not delay the sampling. The total size of the images that are waiting
+to be written is limited by WriterQueueMaxMemoryMb. If the limit would be exceeded then the sampled frames are
+discarded and counted in NumberOfDroppedFrames.
+
+If EnableFileCompression is enabled then MetaImage and NRRD files are compressed while recording, on multiple
+threads (EnableParallelCompression="TRUE", NumberOfCompressionThreads). CompressionMethod="FAST" or "RLE" can be
+used to trade compression ratio for speed.
 
 \ingroup PlusLibDataCollection
 */
@@ -78,6 +96,18 @@ public:
   vtkGetMacro(EnableFileCompression, bool);
   void SetEnableFileCompression(bool aFileCompression);
 
+  /*! Compress MetaImage and NRRD files on multiple threads while recording. Takes effect when the next file is opened. */
+  vtkSetMacro(EnableParallelCompression, bool);
+  vtkGetMacro(EnableParallelCompression, bool);
+
+  /*! Compression method of parallel compression. Takes effect when the next file is opened. */
+  vtkSetMacro(CompressionMethod, PlusParallelDeflate::CompressionMethodType);
+  vtkGetMacro(CompressionMethod, PlusParallelDeflate::CompressionMethodType);
+
+  /*! Number of parallel compression threads. If 0 then the number of hardware threads is used. */
+  vtkSetMacro(NumberOfCompressionThreads, int);
+  vtkGetMacro(NumberOfCompressionThreads, int);
+
   vtkGetStdStringMacro(EncodingFourCC);
   vtkSetStdStringMacro(EncodingFourCC)
 
@@ -89,6 +119,17 @@ public:
   vtkSetMacro(FrameBufferSize, unsigned int);
   vtkGetMacro(FrameBufferSize, unsigned int);
 
+  /*! Write frames to disk in a dedicated writer thread. Takes effect at the next connect. */
+  vtkSetMacro(EnableAsyncWriting, bool);
+  vtkGetMacro(EnableAsyncWriting, bool);
+
+  /*! Maximum total size of the images that are queued for writing (in megabytes) */
+  vtkSetMacro(WriterQueueMaxMemoryMb, double);
+  vtkGetMacro(WriterQueueMaxMemoryMb, double);
+
+  /*! Number of frames that were discarded in the current file because the writer queue was full or writing failed */
+  long int GetNumberOfDroppedFrames();
+
   virtual vtkPlusDataCollector* GetDataCollector() { return this->DataCollector; }
 
   virtual bool IsTracker() const { return false; }
@@ -112,10 +153,32 @@ protected:
 
   /*!
     Copy frames to memory buffer or disk.
-    If force flag is true then data is written to disk immediately.
+    If force flag is true then data is written to disk immediately (or queued for writing, waiting for space in the writer queue).
   */
   virtual PlusStatus WriteFrames(bool force = false);
 
+  /*! Append the frames to the file of the writer. Called from the writer thread if asynchronous writing is enabled. */
+  virtual PlusStatus WriteFrameBatch(vtkIGSIOSequenceIOBase* writer, vtkIGSIOTrackedFrameList* frames);
+
+  /*! Hand over RecordedFrames to the writer thread and start a new list. If waitForSpace is false and the queue is full then the frames are dropped. */
+  PlusStatus QueueRecordedFrames(bool waitForSpace);
+
+  /*! Create an empty frame list for recording, with the custom header fields set */
+  vtkIGSIOTrackedFrameList* CreateRecordedFrameList();
+
+  void StartWriterThread();
+  void StopWriterThread();
+  void WritingThread();
+
+  /*! Block until all queued frames are written. Returns PLUS_FAIL if writing of any frame failed since the last reset. */
+  PlusStatus WaitForQueuedFramesWritten();
+
+  /*! Remove queued frames without writing them and wait for the writer thread to become idle */
+  void DiscardQueuedFrames();
+
+  /*! Use the current recorded frame list in the writer again (e.g., for updating the header). The writer thread must be idle. */
+  void ResetWriterTrackedFrameList();
+
 protected:
   /*! Recorded tracked frame list */
   vtkIGSIOTrackedFrameList* RecordedFrames;
@@ -158,6 +221,12 @@ protected:
   /*! When closing the file, re-read the data from file, and write it compressed */
   bool EnableFileCompression;
 
+  /*! Writer that compresses the frames while recording, used instead of Writer if parallel compression is enabled */
+  vtkSmartPointer<vtkPlusCompressedSequenceWriter> CompressedWriter;
+  bool EnableParallelCompression;
+  PlusParallelDeflate::CompressionMethodType CompressionMethod;
+  int NumberOfCompressionThreads;
+
   /*! FourCC code represending the codec to use when writing the file*/
   std::string EncodingFourCC;
 
@@ -167,6 +236,9 @@ protected:
   /*! Record the number of frames captured */
   long int TotalFramesRecorded;  // hard drive will probably fill up before a regular int is hit, but still...
 
+  /*! Number of recorded video frames that were shared with or copied from the input channel buffers */
+  vtkPlusChannel::FrameCopyCounter FrameCopyCounter;
+
   /*! Whether to start capturing on connect */
   bool EnableCapturingOnStart;
 
@@ -180,6 +252,41 @@ protected:
   /*! Mutex instance simultaneous access of writer (writer may be accessed from command processing thread and also the internal update thread) */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> WriterAccessMutex;
 
+  /*! Custom header fields, set in each recorded frame list */
+  std::map<std::string, std::string> CustomHeaderFields;
+
+  /*! Frame list that is waiting to be written by the writer thread */
+  struct WriterQueueItem
+  {
+    WriterQueueItem() : Writer(NULL), SizeInBytes(0) {}
+    vtkIGSIOSequenceIOBase* Writer;
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> Frames;
+    size_t SizeInBytes;
+  };
+
+  bool EnableAsyncWriting;
+  double WriterQueueMaxMemoryMb;
+
+  /*! Members below are protected by WriterQueueMutex */
+  std::mutex WriterQueueMutex;
+  std::condition_variable FramesQueued;
+  std::condition_variable QueueSpaceAvailable;
+  std::deque<WriterQueueItem> WriterQueue;
+  /*! Total size of the queued images and the images that are being written */
+  size_t WriterQueueSizeInBytes;
+  bool WriterBusy;
+  bool WriterFailed;
+  bool WriterStopRequested;
+  long int NumberOfDroppedFrames;
+  /*! Frame list that the writer refers to, kept alive until the writer is switched to another list */
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> WriterTrackedFrameList;
+
+  std::thread WriterThread;
+
+  /*! Accessed only by the thread that queues the frames */
+  bool WriterQueueOverflow;
+  double LastDroppedFramesLogTimeSec;
+
   vtkPlusLogger::LogLevelType GracePeriodLogLevel;
 
   PlusStatus GetInputTrackedFrame(igsioTrackedFrame& aFrame);
@@ -14,13 +14,20 @@ See License.txt for details.
 #include "vtkIGSIOTransformRepository.h"
 #include "vtkPlusVirtualVolumeReconstructor.h"
 #include "vtkPlusVolumeReconstructor.h"
+#include "vtkImageData.h"
 #include "vtksys/SystemTools.hxx"
 
+#include <sstream>
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusVirtualVolumeReconstructor);
 
 static const int MAX_ALLOWED_RECONSTRUCTION_LAG_SEC = 3.0; // if the reconstruction lags more than this then it'll skip frames to catch up
+static const double INSERTION_RATE_AVERAGING_PERIOD_SEC = 1.0; // length of the period that the inserted frames per second is averaged over
+
+const char* vtkPlusVirtualVolumeReconstructor::PARAMETER_INSERTED_FRAMES_PER_SECOND = "InsertedFramesPerSecond";
+const char* vtkPlusVirtualVolumeReconstructor::PARAMETER_INSERTION_BACKLOG_FRAMES = "InsertionBacklogFrames";
 
 //----------------------------------------------------------------------------
 vtkPlusVirtualVolumeReconstructor::vtkPlusVirtualVolumeReconstructor()
@@ -34,6 +41,15 @@ vtkPlusVirtualVolumeReconstructor::vtkPlusVirtualVolumeReconstructor()
   , TotalFramesRecorded(0)
   , EnableReconstruction(false)
   , VolumeReconstructorAccessMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
+  , VolumeModifiedCount(0)
+  , InsertionBacklogFrames(0)
+  , InsertionBusy(false)
+  , InsertionStopRequested(true)
+  , InsertedFramesPerSecond(0.0)
+  , InsertedFramesInRateWindow(0)
+  , InsertionRateWindowStartTimeSec(0.0)
+  , SnapshotVolumeModifiedCount(0)
+  , SnapshotHoleFilled(false)
 {
   // The data capture thread will be used to regularly read the frames and write to disk
   this->StartThreadForInternalUpdates = true;
@@ -45,6 +61,7 @@ vtkPlusVirtualVolumeReconstructor::vtkPlusVirtualVolumeReconstructor()
 //----------------------------------------------------------------------------
 vtkPlusVirtualVolumeReconstructor::~vtkPlusVirtualVolumeReconstructor()
 {
+  this->StopInsertionThread();
 }
 
 //----------------------------------------------------------------------------
@@ -109,6 +126,8 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalConnect()
 
   m_LastUpdateTime = vtkIGSIOAccurateTimer::GetSystemTime();
 
+  this->StartInsertionThread();
+
   return PLUS_SUCCESS;
 }
 
@@ -116,6 +135,7 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalConnect()
 PlusStatus vtkPlusVirtualVolumeReconstructor::InternalDisconnect()
 {
   SetEnableReconstruction(false);
+  this->StopInsertionThread();
   return PLUS_SUCCESS;
 }
 
@@ -165,13 +185,6 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalUpdate()
     LOG_WARNING("RequestedFrameRate is invalid, use default: " << 1 / requestedFramePeriodSec);
   }
 
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
-  if (!this->EnableReconstruction)
-  {
-    // While this thread was waiting for the unlock, capturing was disabled, so cancel the update now
-    return PLUS_SUCCESS;
-  }
-
   if (this->OutputChannels.empty())
   {
     LOG_ERROR("No output channels defined");
@@ -179,6 +192,7 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalUpdate()
   }
   vtkPlusChannel* outputChannel = this->OutputChannels[0];
 
+  // Only sample the frames here, they are inserted into the volume by the insertion thread
   vtkSmartPointer<vtkIGSIOTrackedFrameList> recordedFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
   if (outputChannel->GetTrackedFrameListSampled(m_LastAlreadyRecordedFrameTimestamp, m_NextFrameToBeRecordedTimestamp, recordedFrames, requestedFramePeriodSec, maxProcessingTimeSec) != PLUS_SUCCESS)
   {
@@ -186,20 +200,10 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalUpdate()
   }
   int nbFramesRecorded = recordedFrames->GetNumberOfTrackedFrames();
 
-  if (this->AddFrames(recordedFrames) != PLUS_SUCCESS)
-  {
-    LOG_ERROR(this->GetDeviceId() << ": Unable to add " << nbFramesRecorded << " frames for volume reconstruction");
-    return PLUS_FAIL;
-  }
+  this->QueueFrames(recordedFrames);
 
   this->TotalFramesRecorded += nbFramesRecorded;
 
-  // Check whether the reconstruction needed more time than the sampling interval
-  double recordingTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
-  if (recordingTimeSec > GetSamplingPeriodSec())
-  {
-    LOG_WARNING("Volume reconstruction of the acquired " << nbFramesRecorded << " frames takes too long time (" << recordingTimeSec << "sec instead of the allocated " << GetSamplingPeriodSec() << "sec). This can cause slow-down of the application and non-uniform sampling. Reduce the image acquisition rate, output size, or image clip rectangle size to resolve the problem.");
-  }
   double recordingLagSec = vtkIGSIOAccurateTimer::GetSystemTime() - m_NextFrameToBeRecordedTimestamp;
 
   if (recordingLagSec > MAX_ALLOWED_RECONSTRUCTION_LAG_SEC)
@@ -255,20 +259,28 @@ void vtkPlusVirtualVolumeReconstructor::SetEnableReconstruction(bool aValue)
     m_TimeWaited = 0.0;
     m_LastAlreadyRecordedFrameTimestamp = UNDEFINED_TIMESTAMP;
     m_NextFrameToBeRecordedTimestamp = 0.0;
+    std::lock_guard<std::mutex> lock(this->InsertionQueueMutex);
     this->EnableReconstruction = true;
   }
   else
   {
     // stopping/suspending...
-    this->EnableReconstruction = aValue;
+    {
+      std::lock_guard<std::mutex> lock(this->InsertionQueueMutex);
+      this->EnableReconstruction = aValue;
+    }
+    // Frames that were recorded before stopping are still inserted, so that the volume contains all of them
+    this->WaitForQueuedFramesInserted();
   }
 }
 
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualVolumeReconstructor::Reset()
 {
+  this->DiscardQueuedFrames();
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
   this->VolumeReconstructor->Reset();
+  this->VolumeModifiedCount++;
   return PLUS_SUCCESS;
 }
 
@@ -347,37 +359,66 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::GetReconstructedVolumeFromFile(con
 PlusStatus vtkPlusVirtualVolumeReconstructor::GetReconstructedVolume(vtkImageData* reconstructedVolume, std::string& outErrorMessage, bool applyHoleFilling/*=true*/)
 {
   outErrorMessage.clear();
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
-  bool oldFillHoles = this->VolumeReconstructor->GetFillHoles();
-  if (!applyHoleFilling)
-  {
-    this->VolumeReconstructor->SetFillHoles(false);
-  }
-  PlusStatus status = this->VolumeReconstructor->ExtractGrayLevels(reconstructedVolume);
-  if (!applyHoleFilling)
+
+  vtkSmartPointer<vtkImageData> snapshotVolume;
+  unsigned long snapshotVolumeModifiedCount = 0;
+  bool snapshotHoleFilled = false;
   {
-    this->VolumeReconstructor->SetFillHoles(oldFillHoles);
+    std::lock_guard<std::mutex> snapshotLock(this->SnapshotMutex);
+    snapshotVolume = this->SnapshotVolume;
+    snapshotVolumeModifiedCount = this->SnapshotVolumeModifiedCount;
+    snapshotHoleFilled = this->SnapshotHoleFilled;
   }
 
-  if (status != PLUS_SUCCESS)
   {
-    outErrorMessage = "Extracting gray levels failed";
-    LOG_ERROR(outErrorMessage);
-    return PLUS_FAIL;
+    // The insertion thread locks the reconstructor for one frame at a time, so this lock is acquired quickly even during live reconstruction
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
+    if (snapshotVolume.GetPointer() == NULL || snapshotVolumeModifiedCount != this->VolumeModifiedCount || snapshotHoleFilled != applyHoleFilling)
+    {
+      // The volume has changed since the last snapshot, extract a new one into a separate buffer
+      vtkSmartPointer<vtkImageData> newSnapshotVolume = vtkSmartPointer<vtkImageData>::New();
+      bool oldFillHoles = this->VolumeReconstructor->GetFillHoles();
+      if (!applyHoleFilling)
+      {
+        this->VolumeReconstructor->SetFillHoles(false);
+      }
+      PlusStatus status = this->VolumeReconstructor->ExtractGrayLevels(newSnapshotVolume);
+      if (!applyHoleFilling)
+      {
+        this->VolumeReconstructor->SetFillHoles(oldFillHoles);
+      }
+
+      if (status != PLUS_SUCCESS)
+      {
+        outErrorMessage = "Extracting gray levels failed";
+        LOG_ERROR(outErrorMessage);
+        return PLUS_FAIL;
+      }
+
+      snapshotVolume = newSnapshotVolume;
+      std::lock_guard<std::mutex> snapshotLock(this->SnapshotMutex);
+      this->SnapshotVolume = newSnapshotVolume;
+      this->SnapshotVolumeModifiedCount = this->VolumeModifiedCount;
+      this->SnapshotHoleFilled = applyHoleFilling;
+    }
   }
+
+  // The published snapshot is never modified, so it can be copied without locking the volume reconstructor
+  reconstructedVolume->DeepCopy(snapshotVolume);
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusVirtualVolumeReconstructor::AddFrames(vtkIGSIOTrackedFrameList* trackedFrameList)
+PlusStatus vtkPlusVirtualVolumeReconstructor::AddFrames(vtkIGSIOTrackedFrameList* trackedFrameList, int* numberOfFramesAddedToVolume/*=NULL*/)
 {
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
-
   PlusStatus status = PLUS_SUCCESS;
   const int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
-  int numberOfFramesAddedToVolume = 0;
+  int numberOfFramesAdded = 0;
   for (int frameIndex = 0; frameIndex < numberOfFrames; frameIndex += this->VolumeReconstructor->GetSkipInterval())
   {
+    // Lock only for the insertion of this frame, so that volume snapshots can be taken while the list is being inserted
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
+
     LOG_TRACE("Adding frame to volume reconstructor: " << frameIndex);
     igsioTrackedFrame* frame = trackedFrameList->GetTrackedFrame(frameIndex);
     if (this->TransformRepository->SetTransforms(*frame) != PLUS_SUCCESS)
@@ -398,16 +439,218 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::AddFrames(vtkIGSIOTrackedFrameList
     }
     if (insertedIntoVolume)
     {
-      numberOfFramesAddedToVolume++;
+      numberOfFramesAdded++;
+      this->VolumeModifiedCount++;
     }
   }
   trackedFrameList->Clear();
 
-  LOG_DEBUG("Number of frames added to the volume: " << numberOfFramesAddedToVolume << " out of " << numberOfFrames);
+  LOG_DEBUG("Number of frames added to the volume: " << numberOfFramesAdded << " out of " << numberOfFrames);
+  if (numberOfFramesAddedToVolume != NULL)
+  {
+    *numberOfFramesAddedToVolume = numberOfFramesAdded;
+  }
 
   return status;
 }
 
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::QueueFrames(vtkIGSIOTrackedFrameList* trackedFrameList)
+{
+  InsertionQueueItem item;
+  item.Frames = trackedFrameList;
+  item.QueuedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  const int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
+  if (numberOfFrames == 0)
+  {
+    return;
+  }
+
+  int numberOfSkippedFrames = 0;
+  {
+    std::lock_guard<std::mutex> lock(this->InsertionQueueMutex);
+    if (!this->EnableReconstruction || this->InsertionStopRequested)
+    {
+      // Reconstruction was disabled while the frames were sampled
+      return;
+    }
+    if (!this->InsertionQueue.empty() && item.QueuedTimeSec - this->InsertionQueue.front().QueuedTimeSec > MAX_ALLOWED_RECONSTRUCTION_LAG_SEC)
+    {
+      // Insertion cannot keep up with the acquisition, skip the frames that are waiting for insertion to catch up
+      for (std::deque<InsertionQueueItem>::iterator itemIt = this->InsertionQueue.begin(); itemIt != this->InsertionQueue.end(); ++itemIt)
+      {
+        numberOfSkippedFrames += itemIt->Frames->GetNumberOfTrackedFrames();
+      }
+      this->InsertionQueue.clear();
+      this->InsertionBacklogFrames -= numberOfSkippedFrames;
+    }
+    this->InsertionQueue.push_back(item);
+    this->InsertionBacklogFrames += numberOfFrames;
+  }
+  this->FramesQueued.notify_one();
+
+  if (numberOfSkippedFrames > 0)
+  {
+    LOG_ERROR("Volume reconstruction cannot keep up with the acquisition. Skip " << numberOfSkippedFrames << " frames waiting for insertion to catch up. Reduce the image acquisition rate, output size, or image clip rectangle size to resolve the problem.");
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::DiscardQueuedFrames()
+{
+  std::unique_lock<std::mutex> lock(this->InsertionQueueMutex);
+  for (std::deque<InsertionQueueItem>::iterator itemIt = this->InsertionQueue.begin(); itemIt != this->InsertionQueue.end(); ++itemIt)
+  {
+    this->InsertionBacklogFrames -= itemIt->Frames->GetNumberOfTrackedFrames();
+  }
+  this->InsertionQueue.clear();
+  this->FramesInserted.wait(lock, [this]()
+  {
+    return !this->InsertionBusy;
+  });
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::WaitForQueuedFramesInserted()
+{
+  std::unique_lock<std::mutex> lock(this->InsertionQueueMutex);
+  this->FramesInserted.wait(lock, [this]()
+  {
+    // If the insertion thread is not running then the queue will not be emptied
+    return (this->InsertionQueue.empty() && !this->InsertionBusy) || this->InsertionStopRequested;
+  });
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::StartInsertionThread()
+{
+  if (this->InsertionThreadHandle.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->InsertionQueueMutex);
+    this->InsertionStopRequested = false;
+    this->InsertedFramesPerSecond = 0.0;
+    this->InsertedFramesInRateWindow = 0;
+    this->InsertionRateWindowStartTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  }
+  this->InsertionThreadHandle = std::thread(&vtkPlusVirtualVolumeReconstructor::InsertionThread, this);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::StopInsertionThread()
+{
+  if (!this->InsertionThreadHandle.joinable())
+  {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(this->InsertionQueueMutex);
+    this->InsertionStopRequested = true;
+  }
+  this->FramesQueued.notify_one();
+  this->FramesInserted.notify_all();
+  // The thread inserts all the queued frames before it exits
+  this->InsertionThreadHandle.join();
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::InsertionThread()
+{
+  std::unique_lock<std::mutex> lock(this->InsertionQueueMutex);
+  while (true)
+  {
+    this->FramesQueued.wait(lock, [this]()
+    {
+      return this->InsertionStopRequested || !this->InsertionQueue.empty();
+    });
+    if (this->InsertionQueue.empty())
+    {
+      // stop requested and there is nothing left to insert
+      break;
+    }
+
+    InsertionQueueItem item = this->InsertionQueue.front();
+    this->InsertionQueue.pop_front();
+    this->InsertionBusy = true;
+    lock.unlock();
+
+    // Insert without holding the queue lock, so that the device thread can keep queuing frames
+    const int numberOfFrames = item.Frames->GetNumberOfTrackedFrames();
+    int numberOfFramesAddedToVolume = 0;
+    if (this->AddFrames(item.Frames, &numberOfFramesAddedToVolume) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(this->GetDeviceId() << ": Unable to add " << numberOfFrames << " frames for volume reconstruction");
+    }
+
+    lock.lock();
+    this->InsertionBacklogFrames -= numberOfFrames;
+    this->InsertedFramesInRateWindow += numberOfFramesAddedToVolume;
+    double currentTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+    double rateWindowLengthSec = currentTimeSec - this->InsertionRateWindowStartTimeSec;
+    if (rateWindowLengthSec >= INSERTION_RATE_AVERAGING_PERIOD_SEC)
+    {
+      this->InsertedFramesPerSecond = this->InsertedFramesInRateWindow / rateWindowLengthSec;
+      this->InsertedFramesInRateWindow = 0;
+      this->InsertionRateWindowStartTimeSec = currentTimeSec;
+    }
+    this->InsertionBusy = false;
+    this->FramesInserted.notify_all();
+  }
+}
+
+//-----------------------------------------------------------------------------
+double vtkPlusVirtualVolumeReconstructor::GetInsertedFramesPerSecond() const
+{
+  std::lock_guard<std::mutex> lock(this->InsertionQueueMutex);
+  double rateWindowLengthSec = vtkIGSIOAccurateTimer::GetSystemTime() - this->InsertionRateWindowStartTimeSec;
+  if (rateWindowLengthSec >= INSERTION_RATE_AVERAGING_PERIOD_SEC)
+  {
+    // No frames have been inserted since the end of the last averaging period, so the rate decreases
+    return this->InsertedFramesInRateWindow / rateWindowLengthSec;
+  }
+  return this->InsertedFramesPerSecond;
+}
+
+//-----------------------------------------------------------------------------
+int vtkPlusVirtualVolumeReconstructor::GetInsertionBacklogFrames() const
+{
+  std::lock_guard<std::mutex> lock(this->InsertionQueueMutex);
+  return this->InsertionBacklogFrames;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusVirtualVolumeReconstructor::GetParameter(const std::string& key) const
+{
+  std::string value;
+  if (this->GetParameter(key, value) != PLUS_SUCCESS)
+  {
+    return "";
+  }
+  return value;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVolumeReconstructor::GetParameter(const std::string& key, std::string& outValue) const
+{
+  std::ostringstream value;
+  if (igsioCommon::IsEqualInsensitive(key, PARAMETER_INSERTED_FRAMES_PER_SECOND))
+  {
+    value << this->GetInsertedFramesPerSecond();
+  }
+  else if (igsioCommon::IsEqualInsensitive(key, PARAMETER_INSERTION_BACKLOG_FRAMES))
+  {
+    value << this->GetInsertionBacklogFrames();
+  }
+  else
+  {
+    return Superclass::GetParameter(key, outValue);
+  }
+  outValue = value.str();
+  return PLUS_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 double vtkPlusVirtualVolumeReconstructor::GetSamplingPeriodSec()
 {
@@ -10,13 +10,28 @@ See License.txt for details.
 #include "vtkPlusDataCollectionExport.h"
 
 #include "vtkPlusDevice.h"
+
+// STL includes
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <thread>
 
+class vtkImageData;
 class vtkPlusVolumeReconstructor;
 
 /*!
 \class vtkPlusVirtualVolumeReconstructor
-\brief
+\brief Inserts the frames of the input channel into a volume
+
+The device thread only samples the input channel and queues the sampled frame lists. The frames are inserted
+into the volume by a dedicated insertion thread, which distributes the slice pasting over the volume reconstructor
+threads (see NumberOfThreads in the VolumeReconstruction element). The volume reconstructor is locked only for
+the insertion of one frame at a time, so volume snapshot requests do not have to wait for the whole queued batch.
+
+Snapshots are double-buffered: each snapshot is extracted into a new image, which is published only when it is complete.
+The published snapshot is reused while no frame is inserted into the volume.
 
 \ingroup PlusLibDataCollection
 */
@@ -81,6 +96,25 @@ public:
 
   vtkGetMacro(TotalFramesRecorded, long int);
 
+  /*! Number of frames inserted into the volume per second, averaged over the last second. This method is safe to be called from any thread. */
+  double GetInsertedFramesPerSecond() const;
+
+  /*! Number of frames that are queued for insertion into the volume. This method is safe to be called from any thread. */
+  int GetInsertionBacklogFrames() const;
+
+  /*!
+    Block until all the queued frames are inserted into the volume.
+    This method is safe to be called from any thread (except the insertion thread).
+  */
+  void WaitForQueuedFramesInserted();
+
+  /*! Provides the InsertedFramesPerSecond and InsertionBacklogFrames status values in addition to the base class parameters */
+  virtual std::string GetParameter(const std::string& key) const;
+  virtual PlusStatus GetParameter(const std::string& key, std::string& outValue) const;
+
+  static const char* PARAMETER_INSERTED_FRAMES_PER_SECOND;
+  static const char* PARAMETER_INSERTION_BACKLOG_FRAMES;
+
 protected:
 
   /*! Read main configuration from xml data */
@@ -113,7 +147,18 @@ protected:
   virtual PlusStatus InternalConnect();
   virtual PlusStatus InternalDisconnect();
 
-  PlusStatus AddFrames(vtkIGSIOTrackedFrameList* trackedFrameList);
+  /*! Insert frames into the volume. The volume reconstructor is locked separately for each frame. */
+  PlusStatus AddFrames(vtkIGSIOTrackedFrameList* trackedFrameList, int* numberOfFramesAddedToVolume = NULL);
+
+  /*! Queue frames for insertion by the insertion thread. Frames are not queued if reconstruction is disabled. */
+  void QueueFrames(vtkIGSIOTrackedFrameList* trackedFrameList);
+
+  /*! Remove all queued frames and wait until the insertion thread completes the frames that it is currently inserting */
+  void DiscardQueuedFrames();
+
+  void StartInsertionThread();
+  void StopInsertionThread();
+  void InsertionThread();
 
   /*! Get the sampling period length (in seconds). Frames are copied from the devices to the data collection buffer once in every sampling period. */
   double GetSamplingPeriodSec();
@@ -155,6 +200,38 @@ protected:
   /*! Mutex instance simultaneous access of writer (writer may be accessed from command processing thread and also the internal update thread) */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> VolumeReconstructorAccessMutex;
 
+  /*! Incremented on each change of the volume contents. Protected by VolumeReconstructorAccessMutex. */
+  unsigned long VolumeModifiedCount;
+
+  /*! Frame list that is waiting to be inserted by the insertion thread */
+  struct InsertionQueueItem
+  {
+    InsertionQueueItem() : QueuedTimeSec(0.0) {}
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> Frames;
+    double QueuedTimeSec;
+  };
+
+  /*! Members below are protected by InsertionQueueMutex */
+  mutable std::mutex InsertionQueueMutex;
+  std::condition_variable FramesQueued;
+  std::condition_variable FramesInserted;
+  std::deque<InsertionQueueItem> InsertionQueue;
+  /*! Number of queued frames and frames of the list that is being inserted */
+  int InsertionBacklogFrames;
+  bool InsertionBusy;
+  bool InsertionStopRequested;
+  double InsertedFramesPerSecond;
+  int InsertedFramesInRateWindow;
+  double InsertionRateWindowStartTimeSec;
+
+  std::thread InsertionThreadHandle;
+
+  /*! Latest complete volume snapshot, never modified after it is published. Members below are protected by SnapshotMutex. */
+  std::mutex SnapshotMutex;
+  vtkSmartPointer<vtkImageData> SnapshotVolume;
+  unsigned long SnapshotVolumeModifiedCount;
+  bool SnapshotHoleFilled;
+
 private:
   vtkPlusVirtualVolumeReconstructor(const vtkPlusVirtualVolumeReconstructor&);   // Not implemented.
   void operator=(const vtkPlusVirtualVolumeReconstructor&);   // Not implemented.
@@ -8,6 +8,7 @@ See License.txt for details.
 #include "PlusConfigure.h"
 #include "igsioMath.h"
 #include "igsioTrackedFrame.h"
+#include "PlusNewDataNotifier.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusDevice.h"
 #include "vtkPlusSequenceIO.h"
@@ -25,8 +26,73 @@ See License.txt for details.
 // vtkAddon includes
 #include <vtkStreamingVolumeCodec.h>
 
+// STL includes
+#include <algorithm>
+
 static const double NEGLIGIBLE_TIME_DIFFERENCE = 0.00001; // in seconds, used for comparing between exact timestamps
 static const double ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG = 10; // if the interpolated orientation differs from both the interpolated orientation by more than this threshold then display a warning
+static const double NLERP_QUATERNION_DOT_THRESHOLD = 0.9995; // if the cosine of the half angle between the orientations is larger than this then normalized linear interpolation is used instead of SLERP (the difference is negligible)
+
+//----------------------------------------------------------------------------
+// Interpolate between two rigid transforms given by unit quaternions and translations.
+// The rotation is interpolated with SLERP (NLERP for nearly identical orientations), the translation linearly.
+// Returns the rotation angle between the two orientations in degrees.
+static double InterpolateRigidTransform(const double quatA[4], const double translationA[3], const double quatB[4], const double translationB[3], double itemBweight,
+                                        double interpolatedQuat[4], double interpolatedElements[16])
+{
+  double dot = quatA[0] * quatB[0] + quatA[1] * quatB[1] + quatA[2] * quatB[2] + quatA[3] * quatB[3];
+  // q and -q represent the same rotation, interpolate along the shorter arc
+  const double signB = (dot < 0) ? -1.0 : 1.0;
+  dot = std::min(dot * signB, 1.0);
+
+  double weightA = 1.0 - itemBweight;
+  double weightB = itemBweight;
+  if (dot < NLERP_QUATERNION_DOT_THRESHOLD)
+  {
+    const double theta = acos(dot);
+    const double sinTheta = sin(theta);
+    weightA = sin((1.0 - itemBweight) * theta) / sinTheta;
+    weightB = sin(itemBweight * theta) / sinTheta;
+  }
+  weightB *= signB;
+
+  double norm = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    interpolatedQuat[i] = weightA * quatA[i] + weightB * quatB[i];
+    norm += interpolatedQuat[i] * interpolatedQuat[i];
+  }
+  norm = sqrt(norm);
+  for (int i = 0; i < 4; i++)
+  {
+    interpolatedQuat[i] /= norm;
+  }
+
+  const double w = interpolatedQuat[0];
+  const double x = interpolatedQuat[1];
+  const double y = interpolatedQuat[2];
+  const double z = interpolatedQuat[3];
+  double* m = interpolatedElements;
+  m[0] = 1 - 2 * (y * y + z * z);
+  m[1] = 2 * (x * y - w * z);
+  m[2] = 2 * (x * z + w * y);
+  m[4] = 2 * (x * y + w * z);
+  m[5] = 1 - 2 * (x * x + z * z);
+  m[6] = 2 * (y * z - w * x);
+  m[8] = 2 * (x * z - w * y);
+  m[9] = 2 * (y * z + w * x);
+  m[10] = 1 - 2 * (x * x + y * y);
+  for (int i = 0; i < 3; i++)
+  {
+    m[i * 4 + 3] = translationA[i] * (1.0 - itemBweight) + translationB[i] * itemBweight;
+  }
+  m[12] = 0;
+  m[13] = 0;
+  m[14] = 0;
+  m[15] = 1;
+
+  return vtkMath::DegreesFromRadians(2.0 * acos(dot));
+}
 
 vtkStandardNewMacro(vtkPlusBuffer);
 
@@ -155,6 +221,88 @@ double vtkPlusBuffer::GetLocalTimeOffsetSec()
   return this->StreamBuffer->GetLocalTimeOffsetSec();
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::SetLockFree(bool lockFree)
+{
+  if (this->StreamBuffer->GetLockFree() == lockFree)
+  {
+    return PLUS_SUCCESS;
+  }
+  if (this->StreamBuffer->SetLockFree(lockFree) != PLUS_SUCCESS)
+  {
+    LOCAL_LOG_ERROR("Failed to change lock-free mode of the buffer");
+    return PLUS_FAIL;
+  }
+  return this->AllocateMemoryForFrames();
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusBuffer::GetLockFree()
+{
+  return this->StreamBuffer->GetLockFree();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::AddNewDataNotifier(std::shared_ptr<PlusNewDataNotifier> notifier)
+{
+  if (notifier == nullptr)
+  {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(this->NewDataNotifiersMutex);
+  for (std::vector< std::weak_ptr<PlusNewDataNotifier> >::iterator it = this->NewDataNotifiers.begin(); it != this->NewDataNotifiers.end(); ++it)
+  {
+    if (it->lock() == notifier)
+    {
+      // already registered
+      return;
+    }
+  }
+  this->NewDataNotifiers.push_back(notifier);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::RemoveNewDataNotifier(std::shared_ptr<PlusNewDataNotifier> notifier)
+{
+  std::lock_guard<std::mutex> lock(this->NewDataNotifiersMutex);
+  for (std::vector< std::weak_ptr<PlusNewDataNotifier> >::iterator it = this->NewDataNotifiers.begin(); it != this->NewDataNotifiers.end();)
+  {
+    std::shared_ptr<PlusNewDataNotifier> registeredNotifier = it->lock();
+    if (registeredNotifier == nullptr || registeredNotifier == notifier)
+    {
+      it = this->NewDataNotifiers.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::CommitNewItem(int bufferIndex)
+{
+  if (this->StreamBuffer->CommitNewItem(bufferIndex) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  std::lock_guard<std::mutex> lock(this->NewDataNotifiersMutex);
+  for (std::vector< std::weak_ptr<PlusNewDataNotifier> >::iterator it = this->NewDataNotifiers.begin(); it != this->NewDataNotifiers.end();)
+  {
+    std::shared_ptr<PlusNewDataNotifier> notifier = it->lock();
+    if (notifier == nullptr)
+    {
+      // the consumer has been deleted
+      it = this->NewDataNotifiers.erase(it);
+      continue;
+    }
+    notifier->Notify();
+    ++it;
+  }
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 int vtkPlusBuffer::GetBufferSize()
 {
@@ -382,7 +530,7 @@ PlusStatus vtkPlusBuffer::AddItem(const igsioFieldMapType& fields,
     std::string name(it->first);
   }
 
-  return PLUS_SUCCESS;
+  return this->CommitNewItem(bufferIndex);
 }
 
 //----------------------------------------------------------------------------
@@ -533,7 +681,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr,
     }
   }
 
-  return PLUS_SUCCESS;
+  return this->CommitNewItem(bufferIndex);
 }
 
 //----------------------------------------------------------------------------
@@ -624,7 +772,7 @@ PlusStatus vtkPlusBuffer::AddItem(void* imageDataPtr, const FrameSizeType& frame
 
   newObjectInBuffer->SetFrameField("FrameSizeInBytes", igsioCommon::ToString<unsigned int>(inputFrameSizeInBytes));
 
-  return PLUS_SUCCESS;
+  return this->CommitNewItem(bufferIndex);
 }
 
 //----------------------------------------------------------------------------
@@ -698,6 +846,10 @@ PlusStatus vtkPlusBuffer::AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus st
     }
   }
 
+  if (this->CommitNewItem(bufferIndex) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
   return itemStatus;
 }
 
@@ -719,6 +871,25 @@ ItemStatus vtkPlusBuffer::GetTimeStamp(BufferItemUidType uid, double& timestamp)
   return this->StreamBuffer->GetTimeStamp(uid, timestamp);
 }
 
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusBuffer::GetTimeStamps(BufferItemUidType firstUid, BufferItemUidType lastUid, std::vector<double>& timestamps)
+{
+  timestamps.clear();
+  StreamItemCircularBuffer::ReaderLock readerLock(this->StreamBuffer);
+  igsioLockGuard<StreamItemCircularBuffer::ReaderLock> dataBufferGuardedLock(&readerLock);
+  for (BufferItemUidType uid = firstUid; uid <= lastUid; ++uid)
+  {
+    double timestamp(0);
+    ItemStatus status = this->StreamBuffer->GetTimeStamp(uid, timestamp);
+    if (status != ITEM_OK)
+    {
+      return status;
+    }
+    timestamps.push_back(timestamp);
+  }
+  return ITEM_OK;
+}
+
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusBuffer::GetIndex(BufferItemUidType uid, unsigned long& index)
 {
@@ -744,6 +915,18 @@ int vtkPlusBuffer::GetAveragedItemsForFiltering()
   return this->StreamBuffer->GetAveragedItemsForFiltering();
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusBuffer::SetTimestampFilteringMethod(vtkPlusTimestampedCircularBuffer::TimestampFilteringMethodType method)
+{
+  this->StreamBuffer->SetTimestampFilteringMethod(method);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusTimestampedCircularBuffer::TimestampFilteringMethodType vtkPlusBuffer::GetTimestampFilteringMethod()
+{
+  return this->StreamBuffer->GetTimestampFilteringMethod();
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusBuffer::SetStartTime(double startTime)
 {
@@ -763,7 +946,7 @@ PlusStatus vtkPlusBuffer::GetTimeStampReportTable(vtkTable* timeStampReportTable
 }
 
 //----------------------------------------------------------------------------
-ItemStatus vtkPlusBuffer::GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem)
+ItemStatus vtkPlusBuffer::GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem, bool shareFrameData /*=false*/)
 {
   if (bufferItem == NULL)
   {
@@ -771,6 +954,25 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItem(BufferItemUidType uid, StreamBuffe
     return ITEM_UNKNOWN_ERROR;
   }
 
+  if (this->StreamBuffer->GetLockFree())
+  {
+    // Keep a reference to the item while copying it, so that the producer does not reuse it meanwhile
+    std::shared_ptr<StreamBufferItem> pinnedItem;
+    ItemStatus itemStatus = this->StreamBuffer->PinBufferItemFromUid(uid, pinnedItem);
+    if (itemStatus != ITEM_OK)
+    {
+      LOCAL_LOG_WARNING("Failed to retrieve data item");
+      return itemStatus;
+    }
+    PlusStatus copyStatus = shareFrameData ? bufferItem->ShallowCopy(pinnedItem.get()) : bufferItem->DeepCopy(pinnedItem.get());
+    if (copyStatus != PLUS_SUCCESS)
+    {
+      LOCAL_LOG_WARNING("Failed to copy data item");
+      return ITEM_UNKNOWN_ERROR;
+    }
+    return ITEM_OK;
+  }
+
   igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
 
   StreamBufferItem* dataItem = NULL;
@@ -781,7 +983,11 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItem(BufferItemUidType uid, StreamBuffe
     return itemStatus;
   }
 
-  if (bufferItem->DeepCopy(dataItem) != PLUS_SUCCESS)
+  // Sharing only adds a reference to the pixel data, the buffer lock is needed only while the reference is taken.
+  // The shared pixel data is never overwritten: before the producer reuses the slot it detaches the slot from
+  // pixel data that is still referenced elsewhere (see StreamBufferItem::DetachSharedFrameData).
+  PlusStatus copyStatus = shareFrameData ? bufferItem->ShallowCopy(dataItem) : bufferItem->DeepCopy(dataItem);
+  if (copyStatus != PLUS_SUCCESS)
   {
     LOCAL_LOG_WARNING("Failed to copy data item");
     return ITEM_UNKNOWN_ERROR;
@@ -1155,11 +1361,75 @@ bool vtkPlusBuffer::GetTimeStampReporting()
 }
 
 //----------------------------------------------------------------------------
-// Returns the two buffer items that are closest previous and next buffer items relative to the specified time.
-// itemA is the closest item
-PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBufferItem& itemA, StreamBufferItem& itemB)
+ItemStatus vtkPlusBuffer::GetItemPose(BufferItemUidType uid, ItemPose& pose)
 {
-  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  // In LockFree mode the reference keeps the item alive while it is read, otherwise the caller has locked the buffer
+  std::shared_ptr<StreamBufferItem> pinnedItem;
+  StreamBufferItem* item = NULL;
+  ItemStatus status = ITEM_OK;
+  if (this->StreamBuffer->GetLockFree())
+  {
+    status = this->StreamBuffer->PinBufferItemFromUid(uid, pinnedItem);
+    item = pinnedItem.get();
+  }
+  else
+  {
+    status = this->StreamBuffer->GetBufferItemPointerFromUid(uid, item);
+  }
+  if (status != ITEM_OK)
+  {
+    return status;
+  }
+
+  pose.Uid = uid;
+  pose.FilteredTimeStamp = item->GetFilteredTimestamp(this->StreamBuffer->GetLocalTimeOffsetSec());
+  pose.UnfilteredTimeStamp = item->GetUnfilteredTimestamp(0.0);   // 0.0 because timestamps in the buffer are in local time
+  pose.Status = item->GetStatus();
+  std::copy(item->GetRotationQuaternion(), item->GetRotationQuaternion() + 4, pose.RotationQuaternion);
+  const double* elements = item->GetMatrixElements();
+  pose.Translation[0] = elements[3];
+  pose.Translation[1] = elements[7];
+  pose.Translation[2] = elements[11];
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBufferItem& itemA, StreamBufferItem& itemB, BufferItemUidType* searchStartUid /*=NULL*/)
+{
+  StreamItemCircularBuffer::ReaderLock readerLock(this->StreamBuffer);
+  igsioLockGuard<StreamItemCircularBuffer::ReaderLock> dataBufferGuardedLock(&readerLock);
+
+  ItemPose poseA;
+  ItemPose poseB;
+  if (this->GetPrevNextItemPoseFromTime(time, poseA, poseB, searchStartUid) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (this->GetStreamBufferItem(poseA.Uid, &itemA) != ITEM_OK)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << poseA.Uid);
+    return PLUS_FAIL;
+  }
+  if (poseB.Uid == poseA.Uid)
+  {
+    itemB.DeepCopy(&itemA);
+    return PLUS_SUCCESS;
+  }
+  if (this->GetStreamBufferItem(poseB.Uid, &itemB) != ITEM_OK)
+  {
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << poseB.Uid);
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+// Returns the poses of the two buffer items that are closest previous and next buffer items relative to the specified time.
+// poseA is the closest item
+PlusStatus vtkPlusBuffer::GetPrevNextItemPoseFromTime(double time, ItemPose& poseA, ItemPose& poseB, BufferItemUidType* searchStartUid /*=NULL*/)
+{
+  StreamItemCircularBuffer::ReaderLock readerLock(this->StreamBuffer);
+  igsioLockGuard<StreamItemCircularBuffer::ReaderLock> dataBufferGuardedLock(&readerLock);
 
   // The returned item is computed by interpolation between itemA and itemB in time. The itemA is the closest item to the requested time.
   // Accept itemA (the closest item) as is if it is very close to the requested time.
@@ -1170,7 +1440,7 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
 
   // itemA is the item that is the closest to the requested time, get its UID and time
   BufferItemUidType itemAuid(0);
-  ItemStatus status = this->StreamBuffer->GetItemUidFromTime(time, itemAuid);
+  ItemStatus status = this->FindItemUidFromTime(time, itemAuid, searchStartUid);
   if (status != ITEM_OK)
   {
     switch (status)
@@ -1186,7 +1456,7 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
     }
     return PLUS_FAIL;
   }
-  status = this->GetStreamBufferItem(itemAuid, &itemA);
+  status = this->GetItemPose(itemAuid, poseA);
   if (status != ITEM_OK)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << itemAuid);
@@ -1194,26 +1464,20 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
   }
 
   // If tracker is out of view, etc. then we don't have a valid before and after the requested time, so we cannot do interpolation
-  if (itemA.GetStatus() != TOOL_OK)
+  if (poseA.Status != TOOL_OK)
   {
     // tracker is out of view, ...
     LOCAL_LOG_DEBUG("vtkPlusBuffer: Cannot do data interpolation. The closest item to the requested time (time: " << std::fixed << time << ", uid: " << itemAuid << ") is invalid.");
     return PLUS_FAIL;
   }
 
-  double itemAtime(0);
-  status = this->StreamBuffer->GetTimeStamp(itemAuid, itemAtime);
-  if (status != ITEM_OK)
-  {
-    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer timestamp (time: " << std::fixed << time << ", uid: " << itemAuid << ")");
-    return PLUS_FAIL;
-  }
+  const double itemAtime = poseA.FilteredTimeStamp;
 
   // If the time difference is negligible then don't interpolate, just return the closest item
   if (fabs(itemAtime - time) < NEGLIGIBLE_TIME_DIFFERENCE)
   {
     //No need for interpolation, it's very close to the closest element
-    itemB.DeepCopy(&itemA);
+    poseB = poseA;
     return PLUS_SUCCESS;
   }
 
@@ -1243,28 +1507,21 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
     return PLUS_FAIL;
   }
   // Get item B details
-  double itemBtime(0);
-  status = this->StreamBuffer->GetTimeStamp(itemBuid, itemBtime);
+  status = this->GetItemPose(itemBuid, poseB);
   if (status != ITEM_OK)
   {
-    LOCAL_LOG_ERROR("Cannot do interpolation: Failed to get data buffer timestamp with Uid: " << itemBuid);
+    LOCAL_LOG_ERROR("Cannot do interpolation: Failed to get data buffer item with Uid: " << itemBuid);
     return PLUS_FAIL;
   }
+  const double itemBtime = poseB.FilteredTimeStamp;
   // If the next closest item is too far, then we don't do interpolation
   if (fabs(itemBtime - time) > this->GetMaxAllowedTimeDifference())
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Cannot perform interpolation, time difference compared to itemB is too big " << std::fixed << fabs(itemBtime - time) << " ( itemBtime: " << itemBtime << ", requested time: " << time << ").");
     return PLUS_FAIL;
   }
-  // Get the item
-  status = this->GetStreamBufferItem(itemBuid, &itemB);
-  if (status != ITEM_OK)
-  {
-    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << itemBuid);
-    return PLUS_FAIL;
-  }
   // If there is no valid element on the other side of the requested time, then we cannot do an interpolation
-  if (itemB.GetStatus() != TOOL_OK)
+  if (poseB.Status != TOOL_OK)
   {
     LOCAL_LOG_DEBUG("vtkPlusBuffer: Cannot get a second element (uid=" << itemBuid << ") on the other side of the requested time (" << std::fixed << time << ")");
     return PLUS_FAIL;
@@ -1275,24 +1532,86 @@ PlusStatus vtkPlusBuffer::GetPrevNextBufferItemFromTime(double time, StreamBuffe
 
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusBuffer::GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation)
+{
+  return this->FindStreamBufferItemFromTime(time, bufferItem, interpolation, NULL, false);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusBuffer::GetStreamBufferItemsFromTimes(const std::vector<double>& times, std::vector<StreamBufferItem>& items, std::vector<ItemStatus>& statuses, DataItemTemporalInterpolationType interpolation, bool shareFrameData /*=false*/)
+{
+  items.resize(times.size());
+  statuses.assign(times.size(), ITEM_UNKNOWN_ERROR);
+
+  // The lock is recursive, so the item retrieval methods only increment the lock count
+  StreamItemCircularBuffer::ReaderLock readerLock(this->StreamBuffer);
+  igsioLockGuard<StreamItemCircularBuffer::ReaderLock> dataBufferGuardedLock(&readerLock);
+
+  PlusStatus result = PLUS_SUCCESS;
+  BufferItemUidType searchStartUid = 0;
+  for (size_t i = 0; i < times.size(); ++i)
+  {
+    statuses[i] = this->FindStreamBufferItemFromTime(times[i], &items[i], interpolation, &searchStartUid, shareFrameData);
+    if (statuses[i] != ITEM_OK)
+    {
+      result = PLUS_FAIL;
+    }
+  }
+  return result;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusBuffer::FindStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation, BufferItemUidType* searchStartUid, bool shareFrameData)
 {
   switch (interpolation)
   {
     case EXACT_TIME:
-      return GetStreamBufferItemFromExactTime(time, bufferItem);
+      return GetStreamBufferItemFromExactTime(time, bufferItem, searchStartUid, shareFrameData);
     case INTERPOLATED:
-      return GetInterpolatedStreamBufferItemFromTime(time, bufferItem);
+      return GetInterpolatedStreamBufferItemFromTime(time, bufferItem, searchStartUid);
     case CLOSEST_TIME:
-      return GetStreamBufferItemFromClosestTime(time, bufferItem);
+      return GetStreamBufferItemFromClosestTime(time, bufferItem, searchStartUid, shareFrameData);
     default:
       LOCAL_LOG_WARNING("Unknown interpolation type: " << interpolation << ". Defaulting to exact time request.");
-      return GetStreamBufferItemFromExactTime(time, bufferItem);
+      return GetStreamBufferItemFromExactTime(time, bufferItem, searchStartUid, shareFrameData);
   }
 }
 
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusBuffer::FindItemUidFromTime(double time, BufferItemUidType& uid, BufferItemUidType* searchStartUid)
+{
+  ItemStatus status = ITEM_OK;
+  if (searchStartUid == NULL || *searchStartUid == 0)
+  {
+    status = this->StreamBuffer->GetItemUidFromTime(time, uid);
+  }
+  else
+  {
+    status = this->StreamBuffer->GetItemUidFromTimeForward(time, *searchStartUid, uid);
+  }
+  if (status == ITEM_OK && searchStartUid != NULL)
+  {
+    *searchStartUid = uid;
+  }
+  return status;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusBuffer::ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value)
 {
+  if (this->StreamBuffer->GetLockFree())
+  {
+    // Published items are shared with readers, so modify a copy and publish that instead
+    igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+    std::shared_ptr<StreamBufferItem> pinnedItem;
+    if (this->StreamBuffer->PinBufferItemFromUid(uid, pinnedItem) != ITEM_OK)
+    {
+      return PLUS_FAIL;
+    }
+    std::shared_ptr<StreamBufferItem> modifiedItem = std::make_shared<StreamBufferItem>(*pinnedItem);
+    modifiedItem->SetFrameField(key, value);
+    return this->StreamBuffer->ReplaceBufferItem(uid, modifiedItem) == ITEM_OK ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
   StreamBufferItem* item;
   auto itemStatus = this->StreamBuffer->GetBufferItemPointerFromUid(uid, item);
   if (itemStatus == ITEM_OK)
@@ -1303,9 +1622,9 @@ PlusStatus vtkPlusBuffer::ModifyBufferItemFrameField(BufferItemUidType uid, cons
 }
 
 //----------------------------------------------------------------------------
-ItemStatus vtkPlusBuffer::GetStreamBufferItemFromExactTime(double time, StreamBufferItem* bufferItem)
+ItemStatus vtkPlusBuffer::GetStreamBufferItemFromExactTime(double time, StreamBufferItem* bufferItem, BufferItemUidType* searchStartUid /*=NULL*/, bool shareFrameData /*=false*/)
 {
-  ItemStatus status = GetStreamBufferItemFromClosestTime(time, bufferItem);
+  ItemStatus status = GetStreamBufferItemFromClosestTime(time, bufferItem, searchStartUid, shareFrameData);
   if (status != ITEM_OK)
   {
     LOCAL_LOG_WARNING("vtkPlusBuffer: Failed to get data buffer timestamp (time: " << std::fixed << time << ")");
@@ -1324,12 +1643,13 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItemFromExactTime(double time, StreamBu
 }
 
 //----------------------------------------------------------------------------
-ItemStatus vtkPlusBuffer::GetStreamBufferItemFromClosestTime(double time, StreamBufferItem* bufferItem)
+ItemStatus vtkPlusBuffer::GetStreamBufferItemFromClosestTime(double time, StreamBufferItem* bufferItem, BufferItemUidType* searchStartUid /*=NULL*/, bool shareFrameData /*=false*/)
 {
-  igsioLockGuard<StreamItemCircularBuffer> dataBufferGuardedLock(this->StreamBuffer);
+  StreamItemCircularBuffer::ReaderLock readerLock(this->StreamBuffer);
+  igsioLockGuard<StreamItemCircularBuffer::ReaderLock> dataBufferGuardedLock(&readerLock);
 
   BufferItemUidType itemUid(0);
-  ItemStatus status = this->StreamBuffer->GetItemUidFromTime(time, itemUid);
+  ItemStatus status = this->FindItemUidFromTime(time, itemUid, searchStartUid);
   if (status != ITEM_OK)
   {
     switch (status)
@@ -1346,7 +1666,7 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItemFromClosestTime(double time, Stream
     return status;
   }
 
-  status = this->GetStreamBufferItem(itemUid, bufferItem);
+  status = this->GetStreamBufferItem(itemUid, bufferItem, shareFrameData);
   if (status != ITEM_OK)
   {
     LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get buffer item with Uid: " << itemUid);
@@ -1362,16 +1682,19 @@ ItemStatus vtkPlusBuffer::GetStreamBufferItemFromClosestTime(double time, Stream
 // The rotation is interpolated with SLERP interpolation, and the
 // position is interpolated with linear interpolation.
 // The flags correspond to the closest element.
-ItemStatus vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem)
+ItemStatus vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, BufferItemUidType* searchStartUid /*=NULL*/)
 {
-  StreamBufferItem itemA;
-  StreamBufferItem itemB;
+  // Keep the buffer locked (if it is not LockFree) until the result is assembled, so that the neighbor items are not overwritten meanwhile
+  StreamItemCircularBuffer::ReaderLock readerLock(this->StreamBuffer);
+  igsioLockGuard<StreamItemCircularBuffer::ReaderLock> dataBufferGuardedLock(&readerLock);
 
-  if (GetPrevNextBufferItemFromTime(time, itemA, itemB) != PLUS_SUCCESS)
+  ItemPose poseA;
+  ItemPose poseB;
+  if (GetPrevNextItemPoseFromTime(time, poseA, poseB, searchStartUid) != PLUS_SUCCESS)
   {
     // cannot get two neighbors, so cannot do interpolation
     // it may be normal (e.g., when tracker out of view), so don't return with an error
-    ItemStatus status = GetStreamBufferItemFromClosestTime(time, bufferItem);
+    ItemStatus status = GetStreamBufferItemFromClosestTime(time, bufferItem, searchStartUid);
     // Update the timestamp to match the requested time
     bufferItem->SetFilteredTimestamp(time);
     bufferItem->SetUnfilteredTimestamp(time);
@@ -1384,33 +1707,27 @@ ItemStatus vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime(double time, S
     return ITEM_OK;
   }
 
-  if (itemA.GetUid() == itemB.GetUid())
+  // The result has the fields and flags of the closest item
+  ItemStatus status = this->GetStreamBufferItem(poseA.Uid, bufferItem);
+  if (status != ITEM_OK)
   {
-    // exact match, no need for interpolation
-    bufferItem->DeepCopy(&itemA);
-    return ITEM_OK;
+    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer item with Uid: " << poseA.Uid);
+    return status;
   }
 
-  //============== Get item weights ==================
-
-  double itemAtime(0);
-  if (this->StreamBuffer->GetTimeStamp(itemA.GetUid(), itemAtime) != ITEM_OK)
+  if (poseA.Uid == poseB.Uid)
   {
-    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer timestamp (time: " << std::fixed << time << ", uid: " << itemA.GetUid() << ")");
-    return ITEM_UNKNOWN_ERROR;
+    // exact match, no need for interpolation
+    return ITEM_OK;
   }
 
-  double itemBtime(0);
-  if (this->StreamBuffer->GetTimeStamp(itemB.GetUid(), itemBtime) != ITEM_OK)
-  {
-    LOCAL_LOG_ERROR("vtkPlusBuffer: Failed to get data buffer timestamp (time: " << std::fixed << time << ", uid: " << itemB.GetUid() << ")");
-    return ITEM_UNKNOWN_ERROR;
-  }
+  //============== Get item weights ==================
 
+  const double itemAtime = poseA.FilteredTimeStamp;
+  const double itemBtime = poseB.FilteredTimeStamp;
   if (fabs(itemAtime - itemBtime) < NEGLIGIBLE_TIME_DIFFERENCE)
   {
     // exact time match, no need for interpolation
-    bufferItem->DeepCopy(&itemA);
     bufferItem->SetFilteredTimestamp(time);
     bufferItem->SetUnfilteredTimestamp(time);
     return ITEM_OK;
@@ -1419,75 +1736,26 @@ ItemStatus vtkPlusBuffer::GetInterpolatedStreamBufferItemFromTime(double time, S
   double itemAweight = fabs(itemBtime - time) / fabs(itemAtime - itemBtime);
   double itemBweight = 1 - itemAweight;
 
-  //============== Get transform matrices ==================
-
-  vtkSmartPointer<vtkMatrix4x4> itemAmatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  if (itemA.GetMatrix(itemAmatrix) != PLUS_SUCCESS)
-  {
-    LOCAL_LOG_ERROR("Failed to get item A matrix");
-    return ITEM_UNKNOWN_ERROR;
-  }
-  double matrixA[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  double xyzA[3] = {0, 0, 0};
-  for (int i = 0; i < 3; i++)
-  {
-    matrixA[i][0] = itemAmatrix->GetElement(i, 0);
-    matrixA[i][1] = itemAmatrix->GetElement(i, 1);
-    matrixA[i][2] = itemAmatrix->GetElement(i, 2);
-    xyzA[i] = itemAmatrix->GetElement(i, 3);
-  }
+  //============== Interpolate transform ==================
 
-  vtkSmartPointer<vtkMatrix4x4> itemBmatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  if (itemB.GetMatrix(itemBmatrix) != PLUS_SUCCESS)
-  {
-    LOCAL_LOG_ERROR("Failed to get item B matrix");
-    return ITEM_UNKNOWN_ERROR;
-  }
-  double matrixB[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  double xyzB[3] = {0, 0, 0};
-  for (int i = 0; i < 3; i++)
-  {
-    matrixB[i][0] = itemBmatrix->GetElement(i, 0);
-    matrixB[i][1] = itemBmatrix->GetElement(i, 1);
-    matrixB[i][2] = itemBmatrix->GetElement(i, 2);
-    xyzB[i] = itemBmatrix->GetElement(i, 3);
-  }
-
-  //============== Interpolate rotation ==================
-
-  double matrixAquat[4] = {0, 0, 0, 0};
-  vtkMath::Matrix3x3ToQuaternion(matrixA, matrixAquat);
-  double matrixBquat[4] = {0, 0, 0, 0};
-  vtkMath::Matrix3x3ToQuaternion(matrixB, matrixBquat);
-  double interpolatedRotationQuat[4] = {0, 0, 0, 0};
-  igsioMath::Slerp(interpolatedRotationQuat, itemBweight, matrixAquat, matrixBquat);
-  double interpolatedRotation[3][3] = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
-  vtkMath::QuaternionToMatrix3x3(interpolatedRotationQuat, interpolatedRotation);
-
-  vtkSmartPointer<vtkMatrix4x4> interpolatedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  for (int i = 0; i < 3; i++)
-  {
-    interpolatedMatrix->Element[i][0] = interpolatedRotation[i][0];
-    interpolatedMatrix->Element[i][1] = interpolatedRotation[i][1];
-    interpolatedMatrix->Element[i][2] = interpolatedRotation[i][2];
-    interpolatedMatrix->Element[i][3] = xyzA[i] * itemAweight + xyzB[i] * itemBweight;
-  }
+  double interpolatedRotationQuat[4] = {1, 0, 0, 0};
+  double interpolatedMatrixElements[16] = {0};
+  double angleDiffAB = InterpolateRigidTransform(poseA.RotationQuaternion, poseA.Translation, poseB.RotationQuaternion, poseB.Translation, itemBweight,
+                       interpolatedRotationQuat, interpolatedMatrixElements);
 
   //============== Interpolate time ==================
 
-  double itemAunfilteredTimestamp = itemA.GetUnfilteredTimestamp(0.0);   // 0.0 because timestamps in the buffer are in local time
-  double itemBunfilteredTimestamp = itemB.GetUnfilteredTimestamp(0.0);   // 0.0 because timestamps in the buffer are in local time
-  double interpolatedUnfilteredTimestamp = itemAunfilteredTimestamp * itemAweight + itemBunfilteredTimestamp * itemBweight;
+  double interpolatedUnfilteredTimestamp = poseA.UnfilteredTimeStamp * itemAweight + poseB.UnfilteredTimeStamp * itemBweight;
 
   //============== Write interpolated results into the bufferItem ==================
 
-  bufferItem->DeepCopy(&itemA);
-  bufferItem->SetMatrix(interpolatedMatrix);
+  bufferItem->SetMatrixElements(interpolatedMatrixElements, interpolatedRotationQuat);
   bufferItem->SetFilteredTimestamp(time - this->StreamBuffer->GetLocalTimeOffsetSec());   // global = local + offset => local = global - offset
   bufferItem->SetUnfilteredTimestamp(interpolatedUnfilteredTimestamp);
 
-  double angleDiffA = igsioMath::GetOrientationDifference(interpolatedMatrix, itemAmatrix);
-  double angleDiffB = igsioMath::GetOrientationDifference(interpolatedMatrix, itemBmatrix);
+  // SLERP rotates at constant angular velocity, so the angle from each neighbor is proportional to the weight of the other one
+  double angleDiffA = angleDiffAB * itemBweight;
+  double angleDiffB = angleDiffAB * itemAweight;
   if (fabs(angleDiffA) > ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG && fabs(angleDiffB) > ANGLE_INTERPOLATION_WARNING_THRESHOLD_DEG)
   {
     static vtkIGSIOLogHelper helper(5.f, 5000, vtkPlusLogger::LOG_LEVEL_WARNING);
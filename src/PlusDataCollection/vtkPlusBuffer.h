@@ -26,6 +26,12 @@ See Copyright.txt or http://www.kitware.com/Copyright.htm for details.
 // VTK includes
 #include <vtkObject.h>
 
+// STL includes
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class PlusNewDataNotifier;
 class vtkPlusDevice;
 enum ToolStatus;
 
@@ -61,6 +67,24 @@ public:
   /*! Get the size of the buffer */
   virtual int GetBufferSize();
 
+  /*!
+    Enable lock-free single producer/multiple consumer mode of the buffer.
+    In this mode consumers (e.g., channels, broadcasting, recording) read items without taking the buffer lock,
+    therefore they cannot delay the acquisition thread. Changing the mode clears the buffer.
+  */
+  virtual PlusStatus SetLockFree(bool lockFree);
+  /*! Returns true if the buffer operates in lock-free mode */
+  virtual bool GetLockFree();
+
+  /*!
+    Register a notifier that is signaled each time a new item is added to the buffer.
+    The buffer only keeps a weak reference, the notifier is automatically unregistered when it is deleted.
+    Adding the same notifier multiple times has no effect.
+  */
+  virtual void AddNewDataNotifier(std::shared_ptr<PlusNewDataNotifier> notifier);
+  /*! Unregister a notifier that was added by AddNewDataNotifier */
+  virtual void RemoveNewDataNotifier(std::shared_ptr<PlusNewDataNotifier> notifier);
+
   /*!
     Add a frame plus a timestamp to the buffer with frame index.
     If the timestamp is  less than or equal to the previous timestamp,
@@ -151,8 +175,11 @@ public:
   */
   PlusStatus AddTimeStampedItem(vtkMatrix4x4* matrix, ToolStatus status, unsigned long frameNumber, double unfilteredTimestamp, double filteredTimestamp = UNDEFINED_TIMESTAMP, const igsioFieldMapType* customFields = NULL);
 
-  /*! Get a frame with the specified frame uid from the buffer */
-  virtual ItemStatus GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem);
+  /*!
+    Get a frame with the specified frame uid from the buffer
+    \param shareFrameData If true then the pixel data is not copied but shared with the buffer (see StreamBufferItem::ShallowCopy)
+  */
+  virtual ItemStatus GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem, bool shareFrameData = false);
   /*! Get the most recent frame from the buffer */
   virtual ItemStatus GetLatestStreamBufferItem(StreamBufferItem* bufferItem)
   {
@@ -165,6 +192,19 @@ public:
   };
   /*! Get a frame that was acquired at the specified time from buffer */
   virtual ItemStatus GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation);
+
+  /*!
+    Get a frame for each of the specified times, which must be in increasing order.
+    The result is the same as calling GetStreamBufferItemFromTime for each time, but the buffer is locked only once
+    (not at all in LockFree mode) and the search for each item continues from the item that was found for the previous time,
+    therefore the buffer is walked through only once.
+    \param items Output items, one for each time. Items that are already in the vector are reused.
+    \param statuses Output status of each item
+    \param shareFrameData If true then the pixel data is not copied but shared with the buffer (see StreamBufferItem::ShallowCopy),
+      used only with EXACT_TIME and CLOSEST_TIME interpolation.
+    \return PLUS_FAIL if any of the items could not be retrieved
+  */
+  virtual PlusStatus GetStreamBufferItemsFromTimes(const std::vector<double>& times, std::vector<StreamBufferItem>& items, std::vector<ItemStatus>& statuses, DataItemTemporalInterpolationType interpolation, bool shareFrameData = false);
   virtual PlusStatus ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value);
 
   /*! Get latest timestamp in the buffer */
@@ -176,6 +216,12 @@ public:
   /*! Get buffer item timestamp */
   virtual ItemStatus GetTimeStamp(BufferItemUidType uid, double& timestamp);
 
+  /*!
+    Get the timestamps of the items from firstUid to lastUid (inclusive). The buffer is locked only once.
+    If an item is not available then the timestamps of the items before it are returned with the status of the missing item.
+  */
+  virtual ItemStatus GetTimeStamps(BufferItemUidType firstUid, BufferItemUidType lastUid, std::vector<double>& timestamps);
+
   /*! Returns true if the latest item contains valid video data */
   virtual bool GetLatestItemHasValidVideoData();
 
@@ -258,6 +304,11 @@ public:
 
   virtual int GetAveragedItemsForFiltering();
 
+  /*! Set method used for timestamp filtering (least squares or robust line fit) */
+  virtual void SetTimestampFilteringMethod(vtkPlusTimestampedCircularBuffer::TimestampFilteringMethodType method);
+  /*! Get method used for timestamp filtering */
+  virtual vtkPlusTimestampedCircularBuffer::TimestampFilteringMethodType GetTimestampFilteringMethod();
+
   /*! Set recording start time */
   virtual void SetStartTime(double startTime);
   /*! Get recording start time */
@@ -330,21 +381,59 @@ protected:
   */
   virtual bool CheckFrameFormat(const FrameSizeType& frameSizeInPx, igsioCommon::VTKScalarPixelType pixelType, US_IMAGE_TYPE imgType, int numberOfScalarComponents);
 
+  /*!
+    Get the UID of the item that is the closest to the specified time.
+    If searchStartUid is not NULL and not 0 then the search starts from that item (see vtkPlusTimestampedCircularBuffer::GetItemUidFromTimeForward)
+    and on success it is updated to the found item.
+  */
+  ItemStatus FindItemUidFromTime(double time, BufferItemUidType& uid, BufferItemUidType* searchStartUid);
+
+  /*! Implementation of GetStreamBufferItemFromTime, with optional search start item (see FindItemUidFromTime) */
+  ItemStatus FindStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, DataItemTemporalInterpolationType interpolation, BufferItemUidType* searchStartUid, bool shareFrameData);
+
+  /*! Pose and timestamps of a buffer item, as needed for interpolation */
+  struct ItemPose
+  {
+    BufferItemUidType Uid;
+    /*! Filtered timestamp in global time */
+    double FilteredTimeStamp;
+    /*! Unfiltered timestamp in local time */
+    double UnfilteredTimeStamp;
+    ToolStatus Status;
+    /*! Rotation as a unit quaternion (w, x, y, z) */
+    double RotationQuaternion[4];
+    double Translation[3];
+  };
+
+  /*!
+    Read the pose of an item directly from the buffer, without copying the item.
+    The buffer must be locked by the caller (if it is not in LockFree mode).
+  */
+  ItemStatus GetItemPose(BufferItemUidType uid, ItemPose& pose);
+
+  /*! Returns the poses of the closest previous and next buffer items relative to the specified time. poseA is the closest item */
+  PlusStatus GetPrevNextItemPoseFromTime(double time, ItemPose& poseA, ItemPose& poseB, BufferItemUidType* searchStartUid = NULL);
+
   /*! Returns the two buffer items that are closest previous and next buffer items relative to the specified time. itemA is the closest item */
-  PlusStatus GetPrevNextBufferItemFromTime(double time, StreamBufferItem& itemA, StreamBufferItem& itemB);
+  PlusStatus GetPrevNextBufferItemFromTime(double time, StreamBufferItem& itemA, StreamBufferItem& itemB, BufferItemUidType* searchStartUid = NULL);
 
   /*!
   Interpolate the matrix for the given timestamp from the two nearest transforms in the buffer.
   The rotation is interpolated with SLERP interpolation, and the position is interpolated with linear interpolation.
   The flags correspond to the closest element.
+  The poses of the two neighbor items are read directly from the buffer using the quaternions that were computed
+  when the items were added, only the closest item is copied into the output.
   */
-  virtual ItemStatus GetInterpolatedStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem);
+  virtual ItemStatus GetInterpolatedStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, BufferItemUidType* searchStartUid = NULL);
 
   /*! Get tracker buffer item from an exact timestamp */
-  virtual ItemStatus GetStreamBufferItemFromExactTime(double time, StreamBufferItem* bufferItem);
+  virtual ItemStatus GetStreamBufferItemFromExactTime(double time, StreamBufferItem* bufferItem, BufferItemUidType* searchStartUid = NULL, bool shareFrameData = false);
 
   /*! Get tracker buffer item from the closest timestamp */
-  virtual ItemStatus GetStreamBufferItemFromClosestTime(double time, StreamBufferItem* bufferItem);
+  virtual ItemStatus GetStreamBufferItemFromClosestTime(double time, StreamBufferItem* bufferItem, BufferItemUidType* searchStartUid = NULL, bool shareFrameData = false);
+
+  /*! Commit the item that was prepared in the stream buffer and signal the registered new data notifiers */
+  PlusStatus CommitNewItem(int bufferIndex);
 
 protected:
   /*! Image frame size in pixel */
@@ -371,6 +460,10 @@ protected:
 
   char* DescriptiveName;
 
+  /*! Notifiers that are signaled when a new item is added */
+  std::vector< std::weak_ptr<PlusNewDataNotifier> > NewDataNotifiers;
+  std::mutex NewDataNotifiersMutex;
+
 private:
   vtkPlusBuffer(const vtkPlusBuffer&);
   void operator=(const vtkPlusBuffer&);
@@ -9,6 +9,7 @@ See License.txt for details.
 #ifdef PLUS_RENDERING_ENABLED
 #include "PlusPlotter.h"
 #endif
+#include "PlusNewDataNotifier.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
@@ -39,6 +40,7 @@ vtkPlusChannel::vtkPlusChannel(void)
   , RfProcessor(NULL)
   , BlankImage(vtkImageData::New())
   , SaveRfProcessingParameters(false)
+  , NewDataNotifier(std::make_shared<PlusNewDataNotifier>())
 {
   // Default size for brightness frame
   this->BrightnessFrameSize[0] = 640;
@@ -529,70 +531,120 @@ void vtkPlusChannel::SetVideoSource(vtkPlusDataSource* aSource)
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame& aTrackedFrame, bool enableImageData/*=true*/)
+PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame& aTrackedFrame, bool enableImageData/*=true*/, bool shareImageData/*=false*/, FrameCopyCounter* copyCounter/*=NULL*/)
 {
-  int numberOfErrors(0);
-  double synchronizedTimestamp(0);
+  std::vector<double> timestamps(1, timestamp);
+  std::vector<igsioTrackedFrame*> trackedFrames(1, &aTrackedFrame);
+  std::vector<PlusStatus> frameStatuses;
+  return this->GetTrackedFrames(timestamps, trackedFrames, frameStatuses, enableImageData, shareImageData, copyCounter);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::GetTrackedFrames(const std::vector<double>& timestamps, const std::vector<igsioTrackedFrame*>& trackedFrames, std::vector<PlusStatus>& frameStatuses, bool enableImageData, bool shareImageData, FrameCopyCounter* copyCounter)
+{
+  if (trackedFrames.size() != timestamps.size())
+  {
+    LOG_ERROR("Number of tracked frames (" << trackedFrames.size() << ") does not match the number of requested timestamps (" << timestamps.size() << ")");
+    frameStatuses.assign(timestamps.size(), PLUS_FAIL);
+    return PLUS_FAIL;
+  }
+  frameStatuses.assign(timestamps.size(), PLUS_SUCCESS);
+
+  // Each data source is synchronized to the timestamp of the item that was retrieved from the previous data source
+  std::vector<double> synchronizedTimestamps(timestamps);
+
+  // Indices of the frames that can still be retrieved, their tracking and field data is requested in one batch from each buffer
+  std::vector<size_t> frameIndices;
+  frameIndices.reserve(timestamps.size());
+
+  // Storage is reused for all the data sources
+  std::vector<double> requestedTimestamps;
+  std::vector<StreamBufferItem> bufferItems;
+  std::vector<ItemStatus> itemStatuses;
 
-  // Get frame UID
   if (this->HasVideoSource() && enableImageData)
   {
     if (this->VideoSource->GetNumberOfItems() < 1)
     {
       LOG_ERROR("Couldn't get tracked frame from video source, frames are not available yet");
+      frameStatuses.assign(timestamps.size(), PLUS_FAIL);
       return PLUS_FAIL;
     }
-    BufferItemUidType frameUID = 0;
-    ItemStatus status = this->VideoSource->GetItemUidFromTime(timestamp, frameUID);
-    if (status != ITEM_OK)
+
+    this->VideoSource->GetStreamBufferItemsFromTimes(timestamps, bufferItems, itemStatuses, vtkPlusBuffer::CLOSEST_TIME, shareImageData);
+    for (size_t i = 0; i < timestamps.size(); ++i)
     {
-      if (status == ITEM_NOT_AVAILABLE_ANYMORE)
+      if (itemStatuses[i] != ITEM_OK)
       {
-        LOG_ERROR("Couldn't get frame UID from time (" << std::fixed << timestamp <<
-                  ") - item not available anymore!");
+        if (itemStatuses[i] == ITEM_NOT_AVAILABLE_ANYMORE)
+        {
+          LOG_ERROR("Couldn't get video buffer item from time (" << std::fixed << timestamps[i] <<
+                    ") - item not available anymore!");
+        }
+        else if (itemStatuses[i] == ITEM_NOT_AVAILABLE_YET)
+        {
+          LOG_ERROR("Couldn't get video buffer item from time (" << std::fixed << timestamps[i] <<
+                    ") - item not available yet!");
+        }
+        else
+        {
+          LOG_ERROR("Couldn't get video buffer item from time (" << std::fixed << timestamps[i] << ")!");
+        }
+        frameStatuses[i] = PLUS_FAIL;
+        continue;
       }
-      else if (status == ITEM_NOT_AVAILABLE_YET)
+
+      StreamBufferItem& videoItem = bufferItems[i];
+      igsioTrackedFrame& aTrackedFrame = *trackedFrames[i];
+
+      // The buffer item is either a private copy or it shares the pixel data with the buffer,
+      // so in both cases the tracked frame can just refer to its pixel data
+      if (StreamBufferItem::ShareFrame(videoItem.GetFrame(), *aTrackedFrame.GetImageData()) != PLUS_SUCCESS)
       {
-        LOG_ERROR("Couldn't get frame UID from time (" << std::fixed << timestamp <<
-                  ") - item not available yet!");
+        LOG_ERROR("Couldn't set image data of tracked frame from video buffer item " << videoItem.GetUid());
+        frameStatuses[i] = PLUS_FAIL;
+        continue;
       }
-      else
+      if (copyCounter != NULL)
       {
-        LOG_ERROR("Couldn't get frame UID from time (" << std::fixed << timestamp << ")!");
+        if (shareImageData)
+        {
+          copyCounter->NumberOfSharedFrames++;
+        }
+        else
+        {
+          copyCounter->NumberOfCopiedFrames++;
+          copyCounter->NumberOfCopiedBytes += videoItem.GetFrame().GetFrameSizeInBytes();
+        }
       }
 
-      return PLUS_FAIL;
-    }
-
-    StreamBufferItem CurrentStreamBufferItem;
-    if (this->VideoSource->GetStreamBufferItem(frameUID, &CurrentStreamBufferItem) != ITEM_OK)
-    {
-      LOG_ERROR("Couldn't get video buffer item by frame UID: " << frameUID);
-      return PLUS_FAIL;
-    }
-
-    // Copy frame
-    igsioVideoFrame frame = CurrentStreamBufferItem.GetFrame();
-    aTrackedFrame.SetImageData(frame);
+      // Copy all custom fields
+      igsioFieldMapType fieldMap = videoItem.GetFrameFieldMap();
+      for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
+      {
+        aTrackedFrame.SetFrameField((*fieldIterator).first, (*fieldIterator).second.second, fieldIterator->second.first);
+      }
 
-    // Copy all custom fields
-    igsioFieldMapType fieldMap = CurrentStreamBufferItem.GetFrameFieldMap();
-    for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
-    {
-      aTrackedFrame.SetFrameField((*fieldIterator).first, (*fieldIterator).second.second, fieldIterator->second.first);
+      double videoTimestamp = videoItem.GetTimestamp(this->VideoSource->GetLocalTimeOffsetSec());
+      if (videoTimestamp != 0)
+      {
+        synchronizedTimestamps[i] = videoTimestamp;
+      }
+      frameIndices.push_back(i);
     }
-
-    synchronizedTimestamp = CurrentStreamBufferItem.GetTimestamp(this->VideoSource->GetLocalTimeOffsetSec());
+    // Release the references to the pixel data of the video buffer as soon as possible
+    bufferItems.clear();
   }
-
-  if (synchronizedTimestamp == 0)
+  else
   {
-    synchronizedTimestamp = timestamp;
+    for (size_t i = 0; i < timestamps.size(); ++i)
+    {
+      frameIndices.push_back(i);
+    }
   }
 
-  // Add main tool timestamp
-  aTrackedFrame.SetTimestamp(synchronizedTimestamp);
-
+  // The tracked frame copies the matrix elements, so the same matrix can be used for all the tools and frames
+  vtkSmartPointer<vtkMatrix4x4> toolMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
   for (DataSourceContainerConstIterator it = this->GetToolsStartIterator(); it != this->GetToolsEndIterator(); ++it)
   {
     vtkPlusDataSource* aTool = it->second;
@@ -600,107 +652,132 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(double timestamp, igsioTrackedFrame&
     if (!toolTransformName.IsValid())
     {
       LOG_ERROR("Tool transform name is invalid!");
-      numberOfErrors++;
+      for (std::vector<size_t>::const_iterator frameIt = frameIndices.begin(); frameIt != frameIndices.end(); ++frameIt)
+      {
+        frameStatuses[*frameIt] = PLUS_FAIL;
+      }
       continue;
     }
 
-    StreamBufferItem bufferItem;
-    ItemStatus result = aTool->GetStreamBufferItemFromTime(synchronizedTimestamp, &bufferItem, vtkPlusBuffer::INTERPOLATED);
-    if (result != ITEM_OK)
+    requestedTimestamps.clear();
+    for (std::vector<size_t>::const_iterator frameIt = frameIndices.begin(); frameIt != frameIndices.end(); ++frameIt)
+    {
+      requestedTimestamps.push_back(synchronizedTimestamps[*frameIt]);
+    }
+    aTool->GetStreamBufferItemsFromTimes(requestedTimestamps, bufferItems, itemStatuses, vtkPlusBuffer::INTERPOLATED);
+
+    for (size_t j = 0; j < frameIndices.size(); ++j)
     {
-      double latestTimestamp(0);
-      if (aTool->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+      size_t i = frameIndices[j];
+      StreamBufferItem& bufferItem = bufferItems[j];
+      igsioTrackedFrame& aTrackedFrame = *trackedFrames[i];
+      if (itemStatuses[j] != ITEM_OK)
       {
-        LOG_ERROR("Failed to get latest timestamp!");
-        numberOfErrors++;
+        double latestTimestamp(0);
+        if (aTool->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+        {
+          LOG_ERROR("Failed to get latest timestamp!");
+        }
+
+        double oldestTimestamp(0);
+        if (aTool->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK)
+        {
+          LOG_ERROR("Failed to get oldest timestamp!");
+        }
+
+        LOG_ERROR(aTool->GetId() << ": Failed to get tracker item from buffer by time: " << std::fixed << requestedTimestamps[j] << " (Latest timestamp: " << latestTimestamp << "   Oldest timestamp: " << oldestTimestamp << ").");
+        frameStatuses[i] = PLUS_FAIL;
+        continue;
       }
 
-      double oldestTimestamp(0);
-      if (aTool->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK)
+      if (bufferItem.GetMatrix(toolMatrix) != PLUS_SUCCESS)
       {
-        LOG_ERROR("Failed to get oldest timestamp!");
-        numberOfErrors++;
+        LOG_ERROR("Failed to get matrix from buffer item for tool " << aTool->GetId());
+        frameStatuses[i] = PLUS_FAIL;
+        continue;
       }
 
-      LOG_ERROR(aTool->GetId() << ": Failed to get tracker item from buffer by time: " << std::fixed << synchronizedTimestamp << " (Latest timestamp: " << latestTimestamp << "   Oldest timestamp: " << oldestTimestamp << ").");
-      numberOfErrors++;
-      continue;
-    }
-
-    vtkSmartPointer<vtkMatrix4x4> dMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-    if (bufferItem.GetMatrix(dMatrix) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to get matrix from buffer item for tool " << aTool->GetId());
-      numberOfErrors++;
-      continue;
-    }
+      if (aTrackedFrame.SetFrameTransform(toolTransformName, toolMatrix) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to set transform for tool " << aTool->GetId());
+        frameStatuses[i] = PLUS_FAIL;
+        continue;
+      }
 
-    if (aTrackedFrame.SetFrameTransform(toolTransformName, dMatrix) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to set transform for tool " << aTool->GetId());
-      numberOfErrors++;
-      continue;
-    }
+      if (aTrackedFrame.SetFrameTransformStatus(toolTransformName, bufferItem.GetStatus()) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to set transform status for tool " << aTool->GetId());
+        frameStatuses[i] = PLUS_FAIL;
+        continue;
+      }
 
-    if (aTrackedFrame.SetFrameTransformStatus(toolTransformName, bufferItem.GetStatus()) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Failed to set transform status for tool " << aTool->GetId());
-      numberOfErrors++;
-      continue;
-    }
+      // Copy all custom fields
+      igsioFieldMapType fieldMap = bufferItem.GetFrameFieldMap();
+      for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
+      {
+        aTrackedFrame.SetFrameField(fieldIterator->first, fieldIterator->second.second, fieldIterator->second.first);
+      }
 
-    // Copy all custom fields
-    igsioFieldMapType fieldMap = bufferItem.GetFrameFieldMap();
-    igsioFieldMapType::iterator fieldIterator;
-    for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
-    {
-      aTrackedFrame.SetFrameField(fieldIterator->first, fieldIterator->second.second, fieldIterator->second.first);
+      synchronizedTimestamps[i] = bufferItem.GetTimestamp(aTool->GetLocalTimeOffsetSec());
     }
-
-    synchronizedTimestamp = bufferItem.GetTimestamp(aTool->GetLocalTimeOffsetSec());
   }
 
   for (DataSourceContainerConstIterator it = this->GetFieldDataSourcesStartIterator(); it != this->GetFieldDataSourcesEndIterator(); ++it)
   {
     vtkPlusDataSource* aSource = it->second;
 
-    StreamBufferItem bufferItem;
-    ItemStatus result = aSource->GetStreamBufferItemFromTime(synchronizedTimestamp, &bufferItem, vtkPlusBuffer::CLOSEST_TIME);
-    if (result != ITEM_OK)
+    requestedTimestamps.clear();
+    for (std::vector<size_t>::const_iterator frameIt = frameIndices.begin(); frameIt != frameIndices.end(); ++frameIt)
+    {
+      requestedTimestamps.push_back(synchronizedTimestamps[*frameIt]);
+    }
+    aSource->GetStreamBufferItemsFromTimes(requestedTimestamps, bufferItems, itemStatuses, vtkPlusBuffer::CLOSEST_TIME);
+
+    for (size_t j = 0; j < frameIndices.size(); ++j)
     {
-      double latestTimestamp(0);
-      if (aSource->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+      size_t i = frameIndices[j];
+      StreamBufferItem& bufferItem = bufferItems[j];
+      if (itemStatuses[j] != ITEM_OK)
       {
-        LOG_ERROR("Failed to get latest timestamp!");
-        numberOfErrors++;
+        double latestTimestamp(0);
+        if (aSource->GetLatestTimeStamp(latestTimestamp) != ITEM_OK)
+        {
+          LOG_ERROR("Failed to get latest timestamp!");
+        }
+
+        double oldestTimestamp(0);
+        if (aSource->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK)
+        {
+          LOG_ERROR("Failed to get oldest timestamp!");
+        }
+
+        LOG_ERROR(aSource->GetId() << ": Failed to get tracker item from buffer by time: " << std::fixed << requestedTimestamps[j] << " (Latest timestamp: " << latestTimestamp << "   Oldest timestamp: " << oldestTimestamp << ").");
+        frameStatuses[i] = PLUS_FAIL;
+        continue;
       }
 
-      double oldestTimestamp(0);
-      if (aSource->GetOldestTimeStamp(oldestTimestamp) != ITEM_OK)
+      // Copy all custom fields
+      igsioFieldMapType fieldMap = bufferItem.GetFrameFieldMap();
+      for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
       {
-        LOG_ERROR("Failed to get oldest timestamp!");
-        numberOfErrors++;
+        trackedFrames[i]->SetFrameField(fieldIterator->first, fieldIterator->second.second, fieldIterator->second.first);
       }
 
-      LOG_ERROR(aSource->GetId() << ": Failed to get tracker item from buffer by time: " << std::fixed << synchronizedTimestamp << " (Latest timestamp: " << latestTimestamp << "   Oldest timestamp: " << oldestTimestamp << ").");
-      numberOfErrors++;
-      continue;
+      synchronizedTimestamps[i] = bufferItem.GetTimestamp(aSource->GetLocalTimeOffsetSec());
     }
+  }
 
-    // Copy all custom fields
-    igsioFieldMapType fieldMap = bufferItem.GetFrameFieldMap();
-    for (igsioFieldMapType::const_iterator fieldIterator = fieldMap.begin(); fieldIterator != fieldMap.end(); fieldIterator++)
+  PlusStatus status = PLUS_SUCCESS;
+  for (size_t i = 0; i < timestamps.size(); ++i)
+  {
+    // Copy frame timestamp
+    trackedFrames[i]->SetTimestamp(synchronizedTimestamps[i]);
+    if (frameStatuses[i] != PLUS_SUCCESS)
     {
-      aTrackedFrame.SetFrameField(fieldIterator->first, fieldIterator->second.second, fieldIterator->second.first);
+      status = PLUS_FAIL;
     }
-
-    synchronizedTimestamp = bufferItem.GetTimestamp(aSource->GetLocalTimeOffsetSec());
   }
-
-  // Copy frame timestamp
-  aTrackedFrame.SetTimestamp(synchronizedTimestamp);
-
-  return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
+  return status;
 }
 
 //----------------------------------------------------------------------------
@@ -714,7 +791,7 @@ PlusStatus vtkPlusChannel::GetTrackedFrame(igsioTrackedFrame& trackedFrame)
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusChannel::GetTrackedFrameList(double& aTimestampOfLastFrameAlreadyGot, vtkIGSIOTrackedFrameList* aTrackedFrameList, int aMaxNumberOfFramesToAdd)
+PlusStatus vtkPlusChannel::GetTrackedFrameList(double& aTimestampOfLastFrameAlreadyGot, vtkIGSIOTrackedFrameList* aTrackedFrameList, int aMaxNumberOfFramesToAdd, bool shareImageData/*=false*/, FrameCopyCounter* copyCounter/*=NULL*/)
 {
   LOG_TRACE("vtkPlusDevice::GetTrackedFrameList(" << aTimestampOfLastFrameAlreadyGot << ", " << aMaxNumberOfFramesToAdd << ")");
 
@@ -943,113 +1020,121 @@ PlusStatus vtkPlusChannel::GetTrackedFrameList(double& aTimestampOfLastFrameAlre
     timestampFrom = mostRecentTimestamp;
   }
 
-  for (int i = 0; i < numberOfFramesToAdd; ++i)
+  // Get the timestamps of all the frames to add, then assemble the frames in one batch
+  std::vector<double> frameTimestamps;
+  if (numberOfFramesToAdd > 0 && this->GetFrameTimestamps(timestampFrom, numberOfFramesToAdd, frameTimestamps) != PLUS_SUCCESS)
   {
-    // Only add this frame if it has not been already added
-    if (timestampFrom > aTimestampOfLastFrameAlreadyGot || aTimestampOfLastFrameAlreadyGot == UNDEFINED_TIMESTAMP)
+    return PLUS_FAIL;
+  }
+
+  // Only add frames that have not been already added
+  std::vector<double> timestampsToAdd;
+  timestampsToAdd.reserve(frameTimestamps.size());
+  for (std::vector<double>::const_iterator it = frameTimestamps.begin(); it != frameTimestamps.end(); ++it)
+  {
+    if (*it > aTimestampOfLastFrameAlreadyGot || aTimestampOfLastFrameAlreadyGot == UNDEFINED_TIMESTAMP)
     {
-      // Get tracked frame from buffer
-      igsioTrackedFrame* trackedFrame = new igsioTrackedFrame;
+      timestampsToAdd.push_back(*it);
+    }
+  }
 
-      if (this->GetTrackedFrame(timestampFrom, *trackedFrame) != PLUS_SUCCESS)
-      {
-        delete trackedFrame;
-        LOG_ERROR("Unable to get tracked frame by time: " << std::fixed << timestampFrom);
-        return PLUS_FAIL;
-      }
+  std::vector<igsioTrackedFrame*> trackedFrames(timestampsToAdd.size());
+  for (size_t i = 0; i < trackedFrames.size(); ++i)
+  {
+    trackedFrames[i] = new igsioTrackedFrame;
+  }
+  std::vector<PlusStatus> frameStatuses;
+  this->GetTrackedFrames(timestampsToAdd, trackedFrames, frameStatuses, true, shareImageData, copyCounter);
 
-      // Add tracked frame to the list
-      aTimestampOfLastFrameAlreadyGot = trackedFrame->GetTimestamp();
-      if (aTrackedFrameList->TakeTrackedFrame(trackedFrame, vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
+  for (size_t i = 0; i < trackedFrames.size(); ++i)
+  {
+    if (frameStatuses[i] != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to get tracked frame by time: " << std::fixed << timestampsToAdd[i]);
+      for (size_t j = i; j < trackedFrames.size(); ++j)
       {
-        LOG_ERROR("Unable to add tracked frame to the list!");
-        return PLUS_FAIL;
+        delete trackedFrames[j];
       }
+      return PLUS_FAIL;
     }
 
-    // Get next timestamp
-    if (this->GetVideoDataAvailable() && i < numberOfFramesToAdd - 1)
+    // Add tracked frame to the list
+    aTimestampOfLastFrameAlreadyGot = trackedFrames[i]->GetTimestamp();
+    if (aTrackedFrameList->TakeTrackedFrame(trackedFrames[i], vtkIGSIOTrackedFrameList::SKIP_INVALID_FRAME) != PLUS_SUCCESS)
     {
-      BufferItemUidType videoUid(0);
-      if (this->VideoSource->GetItemUidFromTime(timestampFrom, videoUid) != ITEM_OK)
-      {
-        LOG_ERROR("Failed to get video buffer item UID from time: " << std::fixed << timestampFrom);
-        return PLUS_FAIL;
-      }
-
-      if (videoUid >= this->VideoSource->GetLatestItemUidInBuffer())
-      {
-        LOG_WARNING("Requested video uid (" << videoUid + 1 << ") is not in the buffer yet!");
-        break;
-      }
-
-      // Get the timestamp of the next item in the buffer
-      if (this->VideoSource->GetTimeStamp(++videoUid, timestampFrom) != ITEM_OK)
+      LOG_ERROR("Unable to add tracked frame to the list!");
+      for (size_t j = i + 1; j < trackedFrames.size(); ++j)
       {
-        LOG_ERROR("Unable to get timestamp from video buffer by UID: " << videoUid);
-        return PLUS_FAIL;
+        delete trackedFrames[j];
       }
+      return PLUS_FAIL;
     }
-    else if (this->GetTrackingEnabled() && i < numberOfFramesToAdd - 1)
-    {
-      vtkPlusDataSource* masterTool = NULL;
-      if (this->GetTimestampMasterTool(masterTool) != PLUS_SUCCESS)
-      {
-        LOG_ERROR("Failed to get tracked frame list - there is no active tool!");
-        return PLUS_FAIL;
-      }
+  }
 
-      BufferItemUidType trackerUid(0);
-      if (masterTool->GetItemUidFromTime(timestampFrom, trackerUid) != ITEM_OK)
-      {
-        LOG_ERROR("Failed to get tracker buffer item UID from time: " << std::fixed << timestampFrom);
-        return PLUS_FAIL;
-      }
+  return status;
+}
 
-      if (trackerUid >= masterTool->GetLatestItemUidInBuffer())
-      {
-        LOG_ERROR("Requested tracker uid (" << trackerUid + 1 << ") is not in the buffer yet!");
-        break;
-      }
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusChannel::GetFrameTimestamps(double timestampFrom, int numberOfFrames, std::vector<double>& timestamps)
+{
+  timestamps.clear();
 
-      // Get the timestamp of the next item in the buffer
-      if (masterTool->GetTimeStamp(++trackerUid, timestampFrom) != ITEM_OK)
-      {
-        LOG_WARNING("Unable to get timestamp from tracker buffer by UID: " << trackerUid);
-        return PLUS_FAIL;
-      }
-    }
-    else if (this->GetFieldDataAvailable() && i < numberOfFramesToAdd - 1)
+  // The frame timestamps are determined by the video buffer, the timestamp master tool, or the first field data source
+  vtkPlusDataSource* frameSource = NULL;
+  if (this->GetVideoDataAvailable())
+  {
+    frameSource = this->VideoSource;
+  }
+  else if (this->GetTrackingEnabled())
+  {
+    if (this->GetTimestampMasterTool(frameSource) != PLUS_SUCCESS)
     {
-      vtkPlusDataSource* firstFieldDataSource = this->FieldDataSources.begin()->second;
+      LOG_ERROR("Failed to get tracked frame list - there is no active tool!");
+      return PLUS_FAIL;
+    }
+  }
+  else if (this->GetFieldDataAvailable())
+  {
+    frameSource = this->FieldDataSources.begin()->second;
+  }
 
-      BufferItemUidType fieldUid(0);
-      if (firstFieldDataSource->GetItemUidFromTime(timestampFrom, fieldUid) != ITEM_OK)
-      {
-        LOG_ERROR("Failed to get tracker buffer item UID from time: " << std::fixed << timestampFrom);
-        return PLUS_FAIL;
-      }
+  // The first frame is requested at the specified time, the next ones at the timestamps of the next items in the buffer
+  timestamps.push_back(timestampFrom);
+  if (frameSource == NULL || numberOfFrames < 2)
+  {
+    return PLUS_SUCCESS;
+  }
 
-      if (fieldUid >= firstFieldDataSource->GetLatestItemUidInBuffer())
-      {
-        LOG_ERROR("Requested tracker uid (" << fieldUid + 1 << ") is not in the buffer yet!");
-        break;
-      }
+  BufferItemUidType firstUid(0);
+  if (frameSource->GetItemUidFromTime(timestampFrom, firstUid) != ITEM_OK)
+  {
+    LOG_ERROR("Failed to get " << frameSource->GetId() << " buffer item UID from time: " << std::fixed << timestampFrom);
+    return PLUS_FAIL;
+  }
 
-      // Get the timestamp of the next item in the buffer
-      if (firstFieldDataSource->GetTimeStamp(++fieldUid, timestampFrom) != ITEM_OK)
-      {
-        LOG_WARNING("Unable to get timestamp from field data buffer by UID: " << fieldUid);
-        return PLUS_FAIL;
-      }
-    }
+  BufferItemUidType lastUid = firstUid + numberOfFrames - 1;
+  if (lastUid > frameSource->GetLatestItemUidInBuffer())
+  {
+    LOG_WARNING("Requested " << frameSource->GetId() << " uid (" << lastUid << ") is not in the buffer yet!");
+    lastUid = frameSource->GetLatestItemUidInBuffer();
+  }
+  if (lastUid <= firstUid)
+  {
+    return PLUS_SUCCESS;
   }
 
-  return status;
+  std::vector<double> nextTimestamps;
+  if (frameSource->GetTimeStamps(firstUid + 1, lastUid, nextTimestamps) != ITEM_OK)
+  {
+    LOG_ERROR("Unable to get timestamps from " << frameSource->GetId() << " buffer by UID: " << firstUid + 1 << "-" << lastUid);
+    return PLUS_FAIL;
+  }
+  timestamps.insert(timestamps.end(), nextTimestamps.begin(), nextTimestamps.end());
+  return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
-PlusStatus vtkPlusChannel::GetTrackedFrameListSampled(double& aTimestampOfLastFrameAlreadyGot, double& aTimestampOfNextFrameToBeAdded, vtkIGSIOTrackedFrameList* aTrackedFrameList, double aSamplingPeriodSec, double maxTimeLimitSec/*=-1*/)
+PlusStatus vtkPlusChannel::GetTrackedFrameListSampled(double& aTimestampOfLastFrameAlreadyGot, double& aTimestampOfNextFrameToBeAdded, vtkIGSIOTrackedFrameList* aTrackedFrameList, double aSamplingPeriodSec, double maxTimeLimitSec/*=-1*/, bool shareImageData/*=false*/, FrameCopyCounter* copyCounter/*=NULL*/)
 {
   LOG_TRACE("vtkPlusDataCollector::GetTrackedFrameListSampled: aTimestampOfLastFrameAlreadyGot=" << aTimestampOfLastFrameAlreadyGot << ", aTimestampOfNextFrameToBeAdded=" << aTimestampOfNextFrameToBeAdded << ", aSamplingPeriodSec=" << aSamplingPeriodSec);
 
@@ -1107,7 +1192,7 @@ PlusStatus vtkPlusChannel::GetTrackedFrameListSampled(double& aTimestampOfLastFr
     }
     // Get tracked frame from buffer (actually copies pixel and field data)
     igsioTrackedFrame* trackedFrame = new igsioTrackedFrame;
-    if (GetTrackedFrame(closestTimestamp, *trackedFrame) != PLUS_SUCCESS)
+    if (GetTrackedFrame(closestTimestamp, *trackedFrame, true, shareImageData, copyCounter) != PLUS_SUCCESS)
     {
       LOG_WARNING("vtkPlusChannel::GetTrackedFrameListSampled: Unable retrieve frame from the devices for time: " << std::fixed << aTimestampOfNextFrameToBeAdded << ", probably the item is not available in the buffers anymore. Frames may be lost.");
       delete trackedFrame;
@@ -1261,6 +1346,33 @@ PlusStatus vtkPlusChannel::GetOldestTimestamp(double& ts)
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+bool vtkPlusChannel::WaitForNewData(unsigned long long& lastDataSequenceNumber, double timeoutSec)
+{
+  // Register the notifier in the buffers each time, as sources (or their buffers) may change after the channel is set up.
+  // Registration of an already registered notifier is a quick no-op.
+  if (this->VideoSource != NULL && this->VideoSource->GetBuffer() != NULL)
+  {
+    this->VideoSource->GetBuffer()->AddNewDataNotifier(this->NewDataNotifier);
+  }
+  for (DataSourceContainerIterator it = this->Tools.begin(); it != this->Tools.end(); ++it)
+  {
+    if (it->second != NULL && it->second->GetBuffer() != NULL)
+    {
+      it->second->GetBuffer()->AddNewDataNotifier(this->NewDataNotifier);
+    }
+  }
+  for (DataSourceContainerIterator it = this->FieldDataSources.begin(); it != this->FieldDataSources.end(); ++it)
+  {
+    if (it->second != NULL && it->second->GetBuffer() != NULL)
+    {
+      it->second->GetBuffer()->AddNewDataNotifier(this->NewDataNotifier);
+    }
+  }
+
+  return this->NewDataNotifier->WaitForNewData(lastDataSequenceNumber, timeoutSec);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusChannel::GetMostRecentTimestamp(double& ts)
 {
@@ -14,7 +14,11 @@
 #include "vtkDataObject.h"
 #include "vtkPlusRfProcessor.h"
 
+// STL includes
+#include <memory>
+
 //class igsioTrackedFrame; 
+class PlusNewDataNotifier;
 class vtkPlusHTMLGenerator;
 class vtkPlusDataSource;
 class vtkPlusDevice;
@@ -38,6 +42,23 @@ public:
   typedef CustomAttributeMap::iterator CustomAttributeMapIterator;
   typedef CustomAttributeMap::const_iterator CustomAttributeMapConstIterator;
 
+public:
+  /*!
+    Counts how the pixel data of video frames got to a consumer of the channel.
+    Each consumer that wants to measure its memory bandwidth use keeps its own counter
+    and passes it to GetTrackedFrame/GetTrackedFrameList/GetTrackedFrameListSampled.
+  */
+  struct FrameCopyCounter
+  {
+    FrameCopyCounter() : NumberOfCopiedFrames(0), NumberOfSharedFrames(0), NumberOfCopiedBytes(0) {}
+    /*! Number of video frames whose pixel data was copied from the buffer */
+    unsigned long long NumberOfCopiedFrames;
+    /*! Number of video frames whose pixel data was shared with the buffer (not copied) */
+    unsigned long long NumberOfSharedFrames;
+    /*! Total size of the copied pixel data */
+    unsigned long long NumberOfCopiedBytes;
+  };
+
 public:
   static vtkPlusChannel* New();
   vtkTypeMacro(vtkPlusChannel, vtkObject);
@@ -108,8 +129,11 @@ public:
     \param timestamp Timestamp of the requested tracked frame
     \param trackedFrame Target tracked frame
     \param enableImageData Enable returning of image data. Tracking data will be interpolated at the timestamp of the image data.
+    \param shareImageData If true then the image data of the tracked frame refers to the pixel data in the video buffer
+      instead of a copy. The pixel data remains valid as long as the tracked frame exists, but it must not be modified.
+    \param copyCounter If not NULL then the number of copied and shared frames is added to this counter.
   */
-  virtual PlusStatus GetTrackedFrame(double timestamp, igsioTrackedFrame& trackedFrame, bool enableImageData = true);
+  virtual PlusStatus GetTrackedFrame(double timestamp, igsioTrackedFrame& trackedFrame, bool enableImageData = true, bool shareImageData = false, FrameCopyCounter* copyCounter = NULL);
   virtual PlusStatus GetTrackedFrame(igsioTrackedFrame& trackedFrame);
 
   /*!
@@ -119,8 +143,10 @@ public:
     \param aTrackedFrameList Tracked frame list used to get the newly acquired frames into. The new frames are appended to the tracked frame.
     \param aSamplingPeriodSec Sampling period time for getting the frames in seconds (timestamps are in seconds too)
     \param maxTimeLimitSec Maximum time spent in the function (in sec)
+    \param shareImageData If true then the image data of the returned frames is shared with the video buffer (see GetTrackedFrame)
+    \param copyCounter If not NULL then the number of copied and shared frames is added to this counter.
   */
-  virtual PlusStatus GetTrackedFrameListSampled(double& aTimestampOfLastFrameAlreadyGot, double& aTimestampOfNextFrameToBeAdded, vtkIGSIOTrackedFrameList* aTrackedFrameList, double aSamplingPeriodSec, double maxTimeLimitSec = -1);
+  virtual PlusStatus GetTrackedFrameListSampled(double& aTimestampOfLastFrameAlreadyGot, double& aTimestampOfNextFrameToBeAdded, vtkIGSIOTrackedFrameList* aTrackedFrameList, double aSamplingPeriodSec, double maxTimeLimitSec = -1, bool shareImageData = false, FrameCopyCounter* copyCounter = NULL);
 
   /*!
     Get all the tracked frame list from devices since time specified
@@ -130,8 +156,10 @@ public:
       Out: the timestamp of the most recent frame that is returned.
     \param aTrackedFrameList Tracked frame list used to get the newly acquired frames into. The new frames are appended to the tracked frame.
     \param aMaxNumberOfFramesToAdd Maximum this number of frames will be added (can be used for limiting the time spent in this method)
+    \param shareImageData If true then the image data of the returned frames is shared with the video buffer (see GetTrackedFrame)
+    \param copyCounter If not NULL then the number of copied and shared frames is added to this counter.
   */
-  PlusStatus GetTrackedFrameList(double& aTimestampOfLastFrameAlreadyGot, vtkIGSIOTrackedFrameList* aTrackedFrameList, int aMaxNumberOfFramesToAdd);
+  PlusStatus GetTrackedFrameList(double& aTimestampOfLastFrameAlreadyGot, vtkIGSIOTrackedFrameList* aTrackedFrameList, int aMaxNumberOfFramesToAdd, bool shareImageData = false, FrameCopyCounter* copyCounter = NULL);
 
   /*! Get the closest tracked frame timestamp to the specified time */
   virtual double GetClosestTrackedFrameTimestampByTime(double time);
@@ -142,6 +170,16 @@ public:
   /*! Return the oldest synchronized timestamp in the buffers */
   virtual PlusStatus GetOldestTimestamp(double& ts);
 
+  /*!
+    Wait until a new item is added to any of the video, tool, or field data buffers of the channel.
+    It allows consumers to process new data immediately, without polling the channel periodically.
+    \param lastDataSequenceNumber In: the value returned by the previous call (0 if this is the first call).
+      Out: the current value. Data that arrives between two calls is not missed.
+    \param timeoutSec Maximum time to wait, in seconds
+    \return true if new data is available, false if the timeout elapsed
+  */
+  virtual bool WaitForNewData(unsigned long long& lastDataSequenceNumber, double timeoutSec);
+
   virtual PlusStatus Clear();
 
   virtual void ShallowCopy(vtkDataObject*);
@@ -174,6 +212,23 @@ protected:
   /*! Get number of tracked frames between two given timestamps (inclusive) */
   virtual int GetNumberOfFramesBetweenTimestamps(double aTimestampFrom, double aTimestampTo);
 
+  /*!
+    Get tracked frames at multiple timestamps at once. The result is the same as calling GetTrackedFrame for each timestamp,
+    but each buffer is locked once and walked through once for all the frames (instead of a search for each frame),
+    and the transform names and matrix are created once for all the frames.
+    \param timestamps Timestamps of the requested tracked frames, in increasing order
+    \param trackedFrames Target tracked frames, one for each timestamp
+    \param frameStatuses Output status of each tracked frame
+    \return PLUS_FAIL if any of the tracked frames could not be retrieved
+  */
+  virtual PlusStatus GetTrackedFrames(const std::vector<double>& timestamps, const std::vector<igsioTrackedFrame*>& trackedFrames, std::vector<PlusStatus>& frameStatuses, bool enableImageData, bool shareImageData, FrameCopyCounter* copyCounter);
+
+  /*!
+    Get the timestamps of at most numberOfFrames consecutive frames, starting from timestampFrom.
+    The frame timestamps are determined by the video buffer, the timestamp master tool, or the first field data source.
+  */
+  virtual PlusStatus GetFrameTimestamps(double timestampFrom, int numberOfFrames, std::vector<double>& timestamps);
+
 protected:
   DataSourceContainer       FieldDataSources;
   DataSourceContainer       Tools;
@@ -199,6 +254,9 @@ protected:
 
   CustomAttributeMap CustomAttributes;
 
+  /*! Signaled by the buffers of the data sources of the channel when a new item is added */
+  std::shared_ptr<PlusNewDataNotifier> NewDataNotifier;
+
   vtkPlusChannel(void);
   virtual ~vtkPlusChannel(void);
 
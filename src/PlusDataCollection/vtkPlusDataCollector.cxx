@@ -6,6 +6,7 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusVirtualDeviceExecutor.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataCollector.h"
@@ -25,7 +26,13 @@ See License.txt for details.
 #endif
 
 // STD includes
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <map>
 #include <set>
+#include <sstream>
 
 // VTK includes
 #include <vtkObjectFactory.h>
@@ -40,6 +47,10 @@ vtkStandardNewMacro(vtkPlusDataCollector);
 vtkPlusDataCollector::vtkPlusDataCollector()
   : vtkObject()
   , StartupDelaySec(0.0)
+  , ParallelDeviceStartup(false)
+  , DeviceStartupTimeoutSec(0.0)
+  , VirtualDeviceExecutorThreads(0)
+  , VirtualDeviceIdleUpdatePeriodSec(0.5)
   , DeviceFactory(vtkSmartPointer<vtkPlusDeviceFactory>::New())
   , Connected(false)
   , Started(false)
@@ -105,6 +116,54 @@ PlusStatus vtkPlusDataCollector::ReadConfiguration(vtkXMLDataElement* aConfig)
     LOG_DEBUG("StartupDelaySec: " << std::fixed << startupDelaySec);
   }
 
+  const char* parallelDeviceStartup = dataCollectionElement->GetAttribute("ParallelDeviceStartup");
+  if (parallelDeviceStartup != NULL)
+  {
+    if (STRCASECMP(parallelDeviceStartup, "TRUE") == 0)
+    {
+      this->SetParallelDeviceStartup(true);
+    }
+    else if (STRCASECMP(parallelDeviceStartup, "FALSE") == 0)
+    {
+      this->SetParallelDeviceStartup(false);
+    }
+    else
+    {
+      LOG_WARNING("Unable to recognize ParallelDeviceStartup attribute: " << parallelDeviceStartup << " - changed to FALSE by default!");
+      this->SetParallelDeviceStartup(false);
+    }
+  }
+
+  double deviceStartupTimeoutSec(0.0);
+  if (dataCollectionElement->GetScalarAttribute("DeviceStartupTimeoutSec", deviceStartupTimeoutSec))
+  {
+    if (deviceStartupTimeoutSec < 0.0)
+    {
+      LOG_WARNING("DeviceStartupTimeoutSec must not be negative - changed to 0 (no warning)");
+      deviceStartupTimeoutSec = 0.0;
+    }
+    this->SetDeviceStartupTimeoutSec(deviceStartupTimeoutSec);
+  }
+
+  int virtualDeviceExecutorThreads(0);
+  if (dataCollectionElement->GetScalarAttribute("VirtualDeviceExecutorThreads", virtualDeviceExecutorThreads))
+  {
+    this->SetVirtualDeviceExecutorThreads(std::max(virtualDeviceExecutorThreads, 0));
+  }
+
+  double virtualDeviceIdleUpdatePeriodSec(0.0);
+  if (dataCollectionElement->GetScalarAttribute("VirtualDeviceIdleUpdatePeriodSec", virtualDeviceIdleUpdatePeriodSec))
+  {
+    if (virtualDeviceIdleUpdatePeriodSec > 0.0)
+    {
+      this->SetVirtualDeviceIdleUpdatePeriodSec(virtualDeviceIdleUpdatePeriodSec);
+    }
+    else
+    {
+      LOG_WARNING("VirtualDeviceIdleUpdatePeriodSec must be positive - using default " << this->VirtualDeviceIdleUpdatePeriodSec << " sec");
+    }
+  }
+
   std::set<std::string> existingDeviceIds;
 
   for (int i = 0; i < dataCollectionElement->GetNumberOfNestedElements(); ++i)
@@ -281,6 +340,32 @@ PlusStatus vtkPlusDataCollector::WriteConfiguration(vtkXMLDataElement* aConfig)
   }
 
   dataCollectionConfig->SetDoubleAttribute("StartupDelaySec", GetStartupDelaySec());
+  if (this->ParallelDeviceStartup)
+  {
+    dataCollectionConfig->SetAttribute("ParallelDeviceStartup", "TRUE");
+  }
+  else
+  {
+    dataCollectionConfig->RemoveAttribute("ParallelDeviceStartup");
+  }
+  if (this->DeviceStartupTimeoutSec > 0.0)
+  {
+    dataCollectionConfig->SetDoubleAttribute("DeviceStartupTimeoutSec", this->DeviceStartupTimeoutSec);
+  }
+  else
+  {
+    dataCollectionConfig->RemoveAttribute("DeviceStartupTimeoutSec");
+  }
+  if (this->VirtualDeviceExecutorThreads > 0)
+  {
+    dataCollectionConfig->SetIntAttribute("VirtualDeviceExecutorThreads", this->VirtualDeviceExecutorThreads);
+    dataCollectionConfig->SetDoubleAttribute("VirtualDeviceIdleUpdatePeriodSec", this->VirtualDeviceIdleUpdatePeriodSec);
+  }
+  else
+  {
+    dataCollectionConfig->RemoveAttribute("VirtualDeviceExecutorThreads");
+    dataCollectionConfig->RemoveAttribute("VirtualDeviceIdleUpdatePeriodSec");
+  }
 
   PlusStatus status = PLUS_SUCCESS;
 
@@ -318,21 +403,18 @@ PlusStatus vtkPlusDataCollector::Start()
 {
   LOG_TRACE("vtkPlusDataCollector::Start()");
 
-  PlusStatus status = PLUS_SUCCESS;
-
   const double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
 
-  for (DeviceCollectionIterator it = Devices.begin(); it != Devices.end(); ++ it)
+  PlusStatus status = this->ExecuteDeviceOperation("start", [startTime](vtkPlusDevice * device)
   {
-    vtkPlusDevice* device = *it;
-
-    if (device->StartRecording() != PLUS_SUCCESS)
+    PlusStatus deviceStatus = device->StartRecording();
+    if (deviceStatus != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to start data acquisition for device " << device->GetDeviceId() << ".");
-      status = PLUS_FAIL;
     }
     device->SetStartTime(startTime);
-  }
+    return deviceStatus;
+  });
 
   LOG_DEBUG("vtkPlusDataCollector::Start -- wait " << std::fixed << this->StartupDelaySec << " sec for buffer init...");
 
@@ -358,18 +440,20 @@ PlusStatus vtkPlusDataCollector::Connect()
 {
   LOG_TRACE("vtkPlusDataCollector::Connect()");
 
-  PlusStatus status = PLUS_SUCCESS;
-
-  for (DeviceCollectionIterator it = Devices.begin(); it != Devices.end(); ++ it)
+  if (this->VirtualDeviceExecutorThreads > 0 && this->VirtualDeviceExecutor == nullptr)
   {
-    vtkPlusDevice* device = *it;
+    this->VirtualDeviceExecutor = std::make_shared<PlusVirtualDeviceExecutor>(this->VirtualDeviceExecutorThreads, this->VirtualDeviceIdleUpdatePeriodSec);
+  }
 
-    if (device->Connect() != PLUS_SUCCESS)
+  PlusStatus status = this->ExecuteDeviceOperation("connect", [](vtkPlusDevice * device)
+  {
+    PlusStatus deviceStatus = device->Connect();
+    if (deviceStatus != PLUS_SUCCESS)
     {
       LOG_ERROR("Unable to connect device: " << device->GetDeviceId() << ".");
-      status = PLUS_FAIL;
     }
-  }
+    return deviceStatus;
+  });
 
   if (status != PLUS_SUCCESS)
   {
@@ -405,12 +489,210 @@ PlusStatus vtkPlusDataCollector::Disconnect()
     }
   }
 
+  if (this->VirtualDeviceExecutor != nullptr)
+  {
+    std::ostringstream report;
+    for (DeviceCollectionIterator it = Devices.begin(); it != Devices.end(); ++it)
+    {
+      double cpuTimeSec(0.0);
+      unsigned long numberOfUpdates(0);
+      if (this->VirtualDeviceExecutor->GetDeviceStatistics(*it, cpuTimeSec, numberOfUpdates) == PLUS_SUCCESS)
+      {
+        report << std::endl << "  " << (*it)->GetDeviceId() << ": " << numberOfUpdates << " updates, " << std::fixed << std::setprecision(3) << cpuTimeSec << " sec CPU time";
+      }
+    }
+    if (!report.str().empty())
+    {
+      LOG_INFO("Shared virtual device executor (" << this->VirtualDeviceExecutor->GetNumberOfThreads() << " threads) statistics:" << report.str());
+    }
+    // Devices that are still updated by the executor keep it alive until they stop recording
+    this->VirtualDeviceExecutor.reset();
+  }
+
   Connected = false;
   LOG_DEBUG("vtkPlusDataCollector::Disconnect: All devices have been disconnected");
 
   return status;
 }
 
+//----------------------------------------------------------------------------
+std::shared_ptr<PlusVirtualDeviceExecutor> vtkPlusDataCollector::GetVirtualDeviceExecutor() const
+{
+  return this->VirtualDeviceExecutor;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDataCollector::GetDeviceStartupWaves(std::vector<DeviceCollection>& waves) const
+{
+  waves.clear();
+
+  // Wave index of each device: 0 if it does not depend on other devices,
+  // otherwise one more than the highest wave index of the devices owning its input channels
+  std::map<vtkPlusDevice*, unsigned int> deviceWave;
+  DeviceCollection remainingDevices(this->Devices);
+  while (!remainingDevices.empty())
+  {
+    DeviceCollection blockedDevices;
+    for (DeviceCollectionConstIterator it = remainingDevices.begin(); it != remainingDevices.end(); ++it)
+    {
+      vtkPlusDevice* device = *it;
+      unsigned int wave = 0;
+      bool dependenciesResolved = true;
+      for (ChannelContainerConstIterator chanIt = device->GetInputChannelsStart(); chanIt != device->GetInputChannelsEnd(); ++chanIt)
+      {
+        vtkPlusDevice* ownerDevice = (*chanIt)->GetOwnerDevice();
+        if (ownerDevice == NULL || ownerDevice == device
+            || std::find(this->Devices.begin(), this->Devices.end(), ownerDevice) == this->Devices.end())
+        {
+          // not managed by this data collector, no need to wait for it
+          continue;
+        }
+        std::map<vtkPlusDevice*, unsigned int>::iterator ownerWave = deviceWave.find(ownerDevice);
+        if (ownerWave == deviceWave.end())
+        {
+          dependenciesResolved = false;
+          break;
+        }
+        wave = std::max(wave, ownerWave->second + 1);
+      }
+      if (!dependenciesResolved)
+      {
+        blockedDevices.push_back(device);
+        continue;
+      }
+      deviceWave[device] = wave;
+      if (waves.size() <= wave)
+      {
+        waves.resize(wave + 1);
+      }
+      waves[wave].push_back(device);
+    }
+
+    if (blockedDevices.size() == remainingDevices.size())
+    {
+      std::string deviceIds;
+      for (DeviceCollectionConstIterator it = blockedDevices.begin(); it != blockedDevices.end(); ++it)
+      {
+        deviceIds += (deviceIds.empty() ? "" : ", ") + std::string((*it)->GetDeviceId());
+      }
+      LOG_ERROR("Circular input channel dependency between devices: " << deviceIds);
+      return PLUS_FAIL;
+    }
+    remainingDevices.swap(blockedDevices);
+  }
+
+  // Restore configuration order within each wave (devices may have been added in a later pass)
+  for (std::vector<DeviceCollection>::iterator waveIt = waves.begin(); waveIt != waves.end(); ++waveIt)
+  {
+    DeviceCollection orderedWave;
+    for (DeviceCollectionConstIterator it = this->Devices.begin(); it != this->Devices.end(); ++it)
+    {
+      if (std::find(waveIt->begin(), waveIt->end(), *it) != waveIt->end())
+      {
+        orderedWave.push_back(*it);
+      }
+    }
+    waveIt->swap(orderedWave);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDataCollector::ExecuteDeviceOperation(const std::string& operationName, const std::function<PlusStatus(vtkPlusDevice*)>& operation)
+{
+  std::vector<DeviceCollection> waves;
+  if (this->ParallelDeviceStartup)
+  {
+    if (this->GetDeviceStartupWaves(waves) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+  }
+  else
+  {
+    // Serial processing in configuration order, as a single wave
+    waves.push_back(this->Devices);
+  }
+
+  const double operationStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  std::ostringstream report;
+  PlusStatus status = PLUS_SUCCESS;
+
+  for (unsigned int waveIndex = 0; waveIndex < waves.size() && status == PLUS_SUCCESS; ++waveIndex)
+  {
+    const DeviceCollection& wave = waves[waveIndex];
+    const double waveStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    std::vector<double> elapsedTimeSec(wave.size(), 0.0);
+    std::vector<PlusStatus> deviceStatus(wave.size(), PLUS_SUCCESS);
+    std::vector<bool> timedOut(wave.size(), false);
+
+    if (this->ParallelDeviceStartup && wave.size() > 1)
+    {
+      std::vector<std::future<void>> results;
+      for (unsigned int i = 0; i < wave.size(); ++i)
+      {
+        vtkPlusDevice* device = wave[i];
+        results.push_back(std::async(std::launch::async, [&operation, device, i, &elapsedTimeSec, &deviceStatus]()
+        {
+          const double deviceStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+          deviceStatus[i] = operation(device);
+          elapsedTimeSec[i] = vtkIGSIOAccurateTimer::GetSystemTime() - deviceStartTime;
+        }));
+      }
+      for (unsigned int i = 0; i < wave.size(); ++i)
+      {
+        if (this->DeviceStartupTimeoutSec > 0.0)
+        {
+          // All devices of the wave started at about the same time, so they share the deadline
+          const double remainingSec = std::max(0.0, waveStartTime + this->DeviceStartupTimeoutSec - vtkIGSIOAccurateTimer::GetSystemTime());
+          if (results[i].wait_for(std::chrono::duration<double>(remainingSec)) == std::future_status::timeout)
+          {
+            LOG_WARNING("Device " << wave[i]->GetDeviceId() << " did not " << operationName << " within " << this->DeviceStartupTimeoutSec << " sec. Waiting for the call to return.");
+            timedOut[i] = true;
+          }
+        }
+        // The call cannot be cancelled, so it has to be waited for even after a timeout
+        results[i].get();
+      }
+    }
+    else
+    {
+      for (unsigned int i = 0; i < wave.size(); ++i)
+      {
+        const double deviceStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+        deviceStatus[i] = operation(wave[i]);
+        elapsedTimeSec[i] = vtkIGSIOAccurateTimer::GetSystemTime() - deviceStartTime;
+        if (this->DeviceStartupTimeoutSec > 0.0 && elapsedTimeSec[i] > this->DeviceStartupTimeoutSec)
+        {
+          LOG_WARNING("Device " << wave[i]->GetDeviceId() << " did not " << operationName << " within " << this->DeviceStartupTimeoutSec << " sec.");
+          timedOut[i] = true;
+        }
+      }
+    }
+
+    report << std::endl << "  Wave " << waveIndex << ": " << std::fixed << std::setprecision(3) << vtkIGSIOAccurateTimer::GetSystemTime() - waveStartTime << " sec";
+    for (unsigned int i = 0; i < wave.size(); ++i)
+    {
+      report << std::endl << "    " << wave[i]->GetDeviceId() << ": " << std::fixed << std::setprecision(3) << elapsedTimeSec[i] << " sec";
+      if (timedOut[i])
+      {
+        report << " (exceeded " << this->DeviceStartupTimeoutSec << " sec)";
+      }
+      if (deviceStatus[i] != PLUS_SUCCESS)
+      {
+        report << " (failed)";
+        status = PLUS_FAIL;
+      }
+    }
+  }
+
+  LOG_INFO("Device " << operationName << " " << (this->ParallelDeviceStartup ? "(parallel)" : "(serial)")
+           << " completed in " << std::fixed << std::setprecision(3) << vtkIGSIOAccurateTimer::GetSystemTime() - operationStartTime << " sec" << report.str());
+
+  return status;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusDataCollector::PrintSelf(ostream& os, vtkIndent indent)
 {
@@ -15,7 +15,12 @@ See License.txt for details.
 // VTK includes
 #include <vtkObject.h>
 
+// STL includes
+#include <functional>
+#include <memory>
+
 //class igsioTrackedFrame; 
+class PlusVirtualDeviceExecutor;
 class vtkPlusChannel;
 class vtkPlusDeviceFactory;
 //class vtkIGSIOTrackedFrameList;
@@ -154,13 +159,73 @@ public:
   /*! Get startup delay in sec to give some time to the buffers for proper initialization */
   vtkGetMacro(StartupDelaySec, double);
 
+  /*!
+    If enabled then Connect and Start process the devices concurrently, in dependency waves:
+    a device is only processed after all devices that own its input channels have been processed.
+    Disabled by default, as some device SDKs require all calls to be made from the same thread.
+  */
+  vtkSetMacro(ParallelDeviceStartup, bool);
+  vtkGetMacro(ParallelDeviceStartup, bool);
+  vtkBooleanMacro(ParallelDeviceStartup, bool);
+
+  /*!
+    Time in sec a single device is expected to spend in Connect or StartRecording (0 = no limit).
+    A warning is logged for devices that take longer. Device calls cannot be cancelled, so it does not make the operation fail.
+  */
+  vtkSetMacro(DeviceStartupTimeoutSec, double);
+  vtkGetMacro(DeviceStartupTimeoutSec, double);
+
+  /*!
+    Set the number of threads of the executor that is shared by virtual devices (0 = disabled).
+    If enabled, virtual devices that would start their own internal update thread are updated by the shared threads instead,
+    when new data arrives on their input channels. Takes effect at the next Connect.
+  */
+  vtkSetMacro(VirtualDeviceExecutorThreads, int);
+  vtkGetMacro(VirtualDeviceExecutorThreads, int);
+
+  /*! Set the time after which virtual devices on the shared executor are updated even if no new data arrived (in sec) */
+  vtkSetMacro(VirtualDeviceIdleUpdatePeriodSec, double);
+  vtkGetMacro(VirtualDeviceIdleUpdatePeriodSec, double);
+
+  /*! Get the executor that is shared by virtual devices. Returns nullptr if it is disabled or the data collector is not connected. */
+  std::shared_ptr<PlusVirtualDeviceExecutor> GetVirtualDeviceExecutor() const;
+
 protected:
   vtkPlusDataCollector();
   virtual ~vtkPlusDataCollector();
 
+  /*!
+    Group the devices into waves. Devices in a wave only depend (through their input channels) on devices in earlier waves.
+    Devices keep their configuration order within a wave.
+  */
+  PlusStatus GetDeviceStartupWaves(std::vector<DeviceCollection>& waves) const;
+
+  /*!
+    Execute an operation on all devices, wave by wave, and log the time spent on each device.
+    If ParallelDeviceStartup is enabled then devices in the same wave are processed concurrently,
+    otherwise devices are processed one by one in configuration order.
+    Processing stops after the first wave that contains a failed device.
+    \param operationName Name of the operation, used in the log messages
+    \param operation Operation to execute on each device
+  */
+  PlusStatus ExecuteDeviceOperation(const std::string& operationName, const std::function<PlusStatus(vtkPlusDevice*)>& operation);
+
   /*! The timestamp filtering methods require some time to initialize. Synchronization will ignore data that are acquired during startup delay. */
   double StartupDelaySec;
 
+  /*! Connect and start devices concurrently in dependency waves */
+  bool ParallelDeviceStartup;
+
+  /*! Time after which a warning is logged if a device is still in Connect or StartRecording (0 = no limit) */
+  double DeviceStartupTimeoutSec;
+
+  /*! Number of threads of the executor shared by virtual devices (0 = each virtual device has its own thread) */
+  int VirtualDeviceExecutorThreads;
+  /*! Time after which virtual devices on the shared executor are updated even if no new data arrived */
+  double VirtualDeviceIdleUpdatePeriodSec;
+  /*! Executor shared by virtual devices, exists while the data collector is connected */
+  std::shared_ptr<PlusVirtualDeviceExecutor> VirtualDeviceExecutor;
+
   vtkSmartPointer<vtkPlusDeviceFactory> DeviceFactory;
 
   DeviceCollection Devices;
@@ -401,6 +401,37 @@ PlusStatus vtkPlusDataSource::ReadConfiguration(vtkXMLDataElement* sourceElement
     LOG_DEBUG("AveragedItemsForFiltering is not defined in source element \"" << this->GetId() << "\". Using default value: " << this->GetBuffer()->GetAveragedItemsForFiltering());
   }
 
+  const char* timestampFilteringMethod = sourceElement->GetAttribute("TimestampFilteringMethod");
+  if (timestampFilteringMethod != NULL)
+  {
+    vtkPlusTimestampedCircularBuffer::TimestampFilteringMethodType method = vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_LINEAR_REGRESSION;
+    if (vtkPlusTimestampedCircularBuffer::GetTimestampFilteringMethodFromString(timestampFilteringMethod, method) == PLUS_SUCCESS)
+    {
+      this->GetBuffer()->SetTimestampFilteringMethod(method);
+    }
+    else
+    {
+      LOG_WARNING("Unable to recognize TimestampFilteringMethod attribute: " << timestampFilteringMethod << " - expected LINEAR_REGRESSION or ROBUST_REGRESSION");
+    }
+  }
+
+  const char* lockFreeBuffer = sourceElement->GetAttribute("LockFreeBuffer");
+  if (lockFreeBuffer != NULL)
+  {
+    if (STRCASECMP(lockFreeBuffer, "TRUE") == 0)
+    {
+      this->GetBuffer()->SetLockFree(true);
+    }
+    else if (STRCASECMP(lockFreeBuffer, "FALSE") == 0)
+    {
+      this->GetBuffer()->SetLockFree(false);
+    }
+    else
+    {
+      LOG_WARNING("Unable to recognize LockFreeBuffer attribute: " << lockFreeBuffer << " - expected TRUE or FALSE");
+    }
+  }
+
   std::string descName;
   if (!aDescriptiveNameForBuffer.empty())
   {
@@ -462,6 +493,17 @@ PlusStatus vtkPlusDataSource::WriteConfiguration(vtkXMLDataElement* aSourceEleme
     aSourceElement->SetIntAttribute("AveragedItemsForFiltering", this->GetBuffer()->GetAveragedItemsForFiltering());
   }
 
+  if (this->GetBuffer()->GetTimestampFilteringMethod() != vtkPlusTimestampedCircularBuffer::TIMESTAMP_FILTERING_LINEAR_REGRESSION
+      || aSourceElement->GetAttribute("TimestampFilteringMethod") != NULL)
+  {
+    aSourceElement->SetAttribute("TimestampFilteringMethod", vtkPlusTimestampedCircularBuffer::GetTimestampFilteringMethodAsString(this->GetBuffer()->GetTimestampFilteringMethod()));
+  }
+
+  if (this->GetBuffer()->GetLockFree() || aSourceElement->GetAttribute("LockFreeBuffer") != NULL)
+  {
+    aSourceElement->SetAttribute("LockFreeBuffer", this->GetBuffer()->GetLockFree() ? "TRUE" : "FALSE");
+  }
+
   // Write custom properties
   if (this->CustomProperties.size() > 0)
   {
@@ -808,9 +850,9 @@ bool vtkPlusDataSource::GetLatestItemHasValidFieldData()
 }
 
 //-----------------------------------------------------------------------------
-ItemStatus vtkPlusDataSource::GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem)
+ItemStatus vtkPlusDataSource::GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem, bool shareFrameData /*=false*/)
 {
-  return this->GetBuffer()->GetStreamBufferItem(uid, bufferItem);
+  return this->GetBuffer()->GetStreamBufferItem(uid, bufferItem, shareFrameData);
 }
 
 //-----------------------------------------------------------------------------
@@ -831,6 +873,12 @@ ItemStatus vtkPlusDataSource::GetStreamBufferItemFromTime(double time, StreamBuf
   return this->GetBuffer()->GetStreamBufferItemFromTime(time, bufferItem, interpolation);
 }
 
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusDataSource::GetStreamBufferItemsFromTimes(const std::vector<double>& times, std::vector<StreamBufferItem>& items, std::vector<ItemStatus>& statuses, vtkPlusBuffer::DataItemTemporalInterpolationType interpolation, bool shareFrameData /*=false*/)
+{
+  return this->GetBuffer()->GetStreamBufferItemsFromTimes(times, items, statuses, interpolation, shareFrameData);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDataSource::ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value)
 {
@@ -873,6 +921,12 @@ ItemStatus vtkPlusDataSource::GetTimeStamp(BufferItemUidType uid, double& timest
   return this->GetBuffer()->GetTimeStamp(uid, timestamp);
 }
 
+//-----------------------------------------------------------------------------
+ItemStatus vtkPlusDataSource::GetTimeStamps(BufferItemUidType firstUid, BufferItemUidType lastUid, std::vector<double>& timestamps)
+{
+  return this->GetBuffer()->GetTimeStamps(firstUid, lastUid, timestamps);
+}
+
 //-----------------------------------------------------------------------------
 void vtkPlusDataSource::SetLocalTimeOffsetSec(double offsetSec)
 {
@@ -133,13 +133,15 @@ public:
   virtual bool GetLatestItemHasValidFieldData();
 
   /*! Get a frame with the specified frame uid from the buffer */
-  virtual ItemStatus GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem);
+  virtual ItemStatus GetStreamBufferItem(BufferItemUidType uid, StreamBufferItem* bufferItem, bool shareFrameData = false);
   /*! Get the most recent frame from the buffer */
   virtual ItemStatus GetLatestStreamBufferItem(StreamBufferItem* bufferItem);
   /*! Get the oldest frame from buffer */
   virtual ItemStatus GetOldestStreamBufferItem(StreamBufferItem* bufferItem);
   /*! Get a frame that was acquired at the specified time from buffer */
   virtual ItemStatus GetStreamBufferItemFromTime(double time, StreamBufferItem* bufferItem, vtkPlusBuffer::DataItemTemporalInterpolationType interpolation);
+  /*! Get a frame for each of the specified times (in increasing order) from the buffer, walking through the buffer only once */
+  virtual PlusStatus GetStreamBufferItemsFromTimes(const std::vector<double>& times, std::vector<StreamBufferItem>& items, std::vector<ItemStatus>& statuses, vtkPlusBuffer::DataItemTemporalInterpolationType interpolation, bool shareFrameData = false);
   /*! Update a field in the specified stream buffer item */
   virtual PlusStatus ModifyBufferItemFrameField(BufferItemUidType uid, const std::string& key, const std::string& value);
 
@@ -177,6 +179,9 @@ public:
   /*! Get video buffer item timestamp */
   virtual ItemStatus GetTimeStamp(BufferItemUidType uid, double& timestamp);
 
+  /*! Get the timestamps of the video buffer items from firstUid to lastUid (inclusive) */
+  virtual ItemStatus GetTimeStamps(BufferItemUidType firstUid, BufferItemUidType lastUid, std::vector<double>& timestamps);
+
   /*! Set the local time offset in seconds (global = local + offset) */
   virtual void SetLocalTimeOffsetSec(double offsetSec);
   /*! Get the local time offset in seconds (global = local + offset) */
@@ -6,8 +6,10 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusVirtualDeviceExecutor.h"
 #include "vtkPlusBuffer.h"
 #include "vtkPlusChannel.h"
+#include "vtkPlusDataCollector.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusDevice.h"
 #include "vtkIGSIORecursiveCriticalSection.h"
@@ -26,11 +28,22 @@ See License.txt for details.
 #include <vtksys/SystemTools.hxx>
 
 // STD includes
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <iomanip>
 #include <set>
+#include <thread>
 
 // System includes
 #include <ctype.h>
 #include <time.h>
+#if defined(__linux__)
+  #include <errno.h>
+  #include <pthread.h>
+  #include <sched.h>
+#endif
 
 #if ( _MSC_VER >= 1300 ) // Visual studio .NET
 #pragma warning ( disable : 4311 )
@@ -114,11 +127,33 @@ vtkStandardNewMacro(vtkPlusDevice);
 
 const int vtkPlusDevice::VIRTUAL_DEVICE_FRAME_RATE = 50;
 static const int FRAME_RATE_AVERAGING = 10;
+const unsigned int vtkPlusDevice::CAPTURE_PERIOD_STATISTICS_SIZE = 10000;
+const int vtkPlusDevice::CAPTURE_MAX_CATCH_UP_PERIODS = 10;
 const std::string vtkPlusDevice::BMODE_PORT_NAME = "B";
 const std::string vtkPlusDevice::RFMODE_PORT_NAME = "Rf";
 const std::string vtkPlusDevice::PARAMETERS_XML_ELEMENT_TAG = "Parameters";
 const std::string vtkPlusDevice::PARAMETER_XML_ELEMENT_TAG = "Parameter";
 
+//----------------------------------------------------------------------------
+// Number of CPU cores the internal update thread can be restricted to: limited by the size of the
+// affinity mask of the platform (cpu_set_t or DWORD_PTR) and by the number of CPUs in the system
+static int GetNumberOfSelectableCpuCores()
+{
+#if defined(__linux__)
+  int numberOfCores = CPU_SETSIZE;
+#elif defined(_WIN32)
+  int numberOfCores = static_cast<int>(sizeof(DWORD_PTR) * CHAR_BIT);
+#else
+  int numberOfCores = INT_MAX;
+#endif
+  const unsigned int numberOfCpus = std::thread::hardware_concurrency();
+  if (numberOfCpus > 0)
+  {
+    numberOfCores = std::min(numberOfCores, static_cast<int>(numberOfCpus));
+  }
+  return numberOfCores;
+}
+
 //----------------------------------------------------------------------------
 vtkPlusDevice::vtkPlusDevice()
   : ThreadAlive(false)
@@ -141,6 +176,12 @@ vtkPlusDevice::vtkPlusDevice()
   , StartThreadForInternalUpdates(false)
   , LocalTimeOffsetSec(0.0)
   , MissingInputGracePeriodSec(0.0)
+  , CaptureDeadlinePolicy(CAPTURE_DEADLINE_SKIP)
+  , CaptureThreadCpuAffinity(-1)
+  , CaptureThreadRealTimePriority(0)
+  , CaptureStatisticsMutex(vtkIGSIORecursiveCriticalSection::New())
+  , CapturePeriodErrorsNextIndex(0)
+  , CaptureMissedDeadlines(0)
   , RequireImageOrientationInConfiguration(false)
   , RequirePortNameInDeviceSetConfiguration(false)
 {
@@ -187,6 +228,7 @@ vtkPlusDevice::~vtkPlusDevice()
   DELETE_IF_NOT_NULL(this->Threader);
 
   DELETE_IF_NOT_NULL(this->UpdateMutex);
+  DELETE_IF_NOT_NULL(this->CaptureStatisticsMutex);
 
   LOCAL_LOG_TRACE("vtkPlusDevice::~vtkPlusDevice() completed");
 }
@@ -577,17 +619,53 @@ PlusStatus vtkPlusDevice::SetParameter(const std::string& key, const std::string
 //----------------------------------------------------------------------------
 std::string vtkPlusDevice::GetParameter(const std::string& key) const
 {
-  if (this->Parameters.find(key) != this->Parameters.end())
-  {
-    return this->Parameters.find(key)->second;
-  }
-
-  return "";
+  std::string value;
+  vtkPlusDevice::GetParameter(key, value);
+  return value;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusDevice::GetParameter(const std::string& key, std::string& outValue) const
 {
+  if (igsioCommon::IsEqualInsensitive(key, "InternalUpdateCpuTimeSec"))
+  {
+    double cpuTimeSec(0.0);
+    unsigned long numberOfUpdates(0);
+    if (this->SharedExecutor == nullptr || this->SharedExecutor->GetDeviceStatistics(const_cast<vtkPlusDevice*>(this), cpuTimeSec, numberOfUpdates) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(6) << cpuTimeSec;
+    outValue = ss.str();
+    return PLUS_SUCCESS;
+  }
+
+  if (igsioCommon::IsEqualInsensitive(key, "CapturePeriodErrorP50Ms")
+      || igsioCommon::IsEqualInsensitive(key, "CapturePeriodErrorP99Ms")
+      || igsioCommon::IsEqualInsensitive(key, "CapturePeriodErrorMaxMs")
+      || igsioCommon::IsEqualInsensitive(key, "CaptureMissedDeadlines"))
+  {
+    double p50Sec(0.0), p99Sec(0.0), maxSec(0.0);
+    unsigned long missedDeadlines(0);
+    if (this->GetCapturePeriodErrorStatistics(p50Sec, p99Sec, maxSec, missedDeadlines) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    std::ostringstream ss;
+    if (igsioCommon::IsEqualInsensitive(key, "CaptureMissedDeadlines"))
+    {
+      ss << missedDeadlines;
+    }
+    else
+    {
+      double valueSec = igsioCommon::IsEqualInsensitive(key, "CapturePeriodErrorP50Ms") ? p50Sec : (igsioCommon::IsEqualInsensitive(key, "CapturePeriodErrorP99Ms") ? p99Sec : maxSec);
+      ss << std::fixed << std::setprecision(3) << valueSec * 1000.0;
+    }
+    outValue = ss.str();
+    return PLUS_SUCCESS;
+  }
+
   if (this->Parameters.find(key) != this->Parameters.end())
   {
     outValue = this->Parameters.find(key)->second;
@@ -610,6 +688,9 @@ void vtkPlusDevice::DeepCopy(const vtkPlusDevice& device)
   this->RequireImageOrientationInConfiguration = device.RequireImageOrientationInConfiguration;
   this->RequirePortNameInDeviceSetConfiguration = device.RequirePortNameInDeviceSetConfiguration;
   this->Parameters = device.Parameters;
+  this->CaptureDeadlinePolicy = device.CaptureDeadlinePolicy;
+  this->CaptureThreadCpuAffinity = device.CaptureThreadCpuAffinity;
+  this->CaptureThreadRealTimePriority = device.CaptureThreadRealTimePriority;
   // Don't set data collector, because that will be done if the copied device is added to a data collector
 
   // VTK functions aren't const clean, this is necessary =/
@@ -1091,6 +1172,25 @@ PlusStatus vtkPlusDevice::ReadConfiguration(vtkXMLDataElement* rootXMLElement)
     }
   }
 
+  // Internal update thread scheduling
+  XML_READ_ENUM3_ATTRIBUTE_OPTIONAL(CaptureDeadlinePolicy, deviceXMLElement,
+                                    "SKIP", CAPTURE_DEADLINE_SKIP,
+                                    "CATCH_UP", CAPTURE_DEADLINE_CATCH_UP,
+                                    "RESET", CAPTURE_DEADLINE_RESET);
+  int captureThreadCpuAffinity = this->CaptureThreadCpuAffinity;
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, CaptureThreadCpuAffinity, captureThreadCpuAffinity, deviceXMLElement);
+  if (captureThreadCpuAffinity < -1 || captureThreadCpuAffinity >= GetNumberOfSelectableCpuCores())
+  {
+    LOCAL_LOG_WARNING("CaptureThreadCpuAffinity must be -1 or a CPU core index between 0 and " << GetNumberOfSelectableCpuCores() - 1
+                      << ", the configured value (" << captureThreadCpuAffinity << ") is ignored. The internal update thread CPU affinity is not restricted.");
+    this->CaptureThreadCpuAffinity = -1;
+  }
+  else
+  {
+    this->CaptureThreadCpuAffinity = captureThreadCpuAffinity;
+  }
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, CaptureThreadRealTimePriority, deviceXMLElement);
+
   double localTimeOffsetSec = 0;
   if (deviceXMLElement->GetScalarAttribute("LocalTimeOffsetSec", localTimeOffsetSec))
   {
@@ -1201,6 +1301,19 @@ PlusStatus vtkPlusDevice::WriteConfiguration(vtkXMLDataElement* config)
     deviceDataElement->SetDoubleAttribute("LocalTimeOffsetSec", this->GetLocalTimeOffsetSec());
   }
 
+  if (this->CaptureDeadlinePolicy != CAPTURE_DEADLINE_SKIP)
+  {
+    deviceDataElement->SetAttribute("CaptureDeadlinePolicy", this->CaptureDeadlinePolicy == CAPTURE_DEADLINE_CATCH_UP ? "CATCH_UP" : "RESET");
+  }
+  if (this->CaptureThreadCpuAffinity >= 0)
+  {
+    deviceDataElement->SetIntAttribute("CaptureThreadCpuAffinity", this->CaptureThreadCpuAffinity);
+  }
+  if (this->CaptureThreadRealTimePriority > 0)
+  {
+    deviceDataElement->SetIntAttribute("CaptureThreadRealTimePriority", this->CaptureThreadRealTimePriority);
+  }
+
   // Parameters writing
   XML_FIND_NESTED_ELEMENT_CREATE_IF_MISSING(parameterList, deviceDataElement, PARAMETERS_XML_ELEMENT_TAG.c_str());
 
@@ -1296,13 +1409,32 @@ PlusStatus vtkPlusDevice::StartRecording()
   }
 
   this->RecordingStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> statisticsLock(this->CaptureStatisticsMutex);
+    this->CapturePeriodErrorsSec.clear();
+    this->CapturePeriodErrorsNextIndex = 0;
+    this->CaptureMissedDeadlines = 0;
+  }
   this->Recording = 1;
 
   if (this->StartThreadForInternalUpdates)
   {
-    this->ThreadId =
-      this->Threader->SpawnThread((vtkThreadFunctionType)\
-                                  &vtkDataCaptureThread, this);
+    // Virtual devices are updated when new data arrives on their input channels if the data collector provides a shared executor
+    std::shared_ptr<PlusVirtualDeviceExecutor> executor;
+    if (this->IsVirtual() && !this->InputChannels.empty() && this->DataCollector != NULL)
+    {
+      executor = this->DataCollector->GetVirtualDeviceExecutor();
+    }
+    if (executor != nullptr && executor->AddDevice(this) == PLUS_SUCCESS)
+    {
+      this->SharedExecutor = executor;
+    }
+    else
+    {
+      this->ThreadId =
+        this->Threader->SpawnThread((vtkThreadFunctionType)\
+                                    &vtkDataCaptureThread, this);
+    }
   }
 
   this->Modified();
@@ -1325,7 +1457,13 @@ PlusStatus vtkPlusDevice::StopRecording()
 
   this->Recording = 0;
 
-  if (this->GetStartThreadForInternalUpdates())
+  if (this->SharedExecutor != nullptr)
+  {
+    LOCAL_LOG_DEBUG("Remove device from the shared virtual device executor");
+    this->SharedExecutor->RemoveDevice(this);
+    this->SharedExecutor.reset();
+  }
+  else if (this->GetStartThreadForInternalUpdates())
   {
     LOCAL_LOG_DEBUG("Wait for internal update thread to terminate");
     // Let's give a chance to the thread to stop before we kill the connection
@@ -1350,6 +1488,132 @@ PlusStatus vtkPlusDevice::StopRecording()
   return PLUS_SUCCESS;
 }
 
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Sleep until an absolute deadline. Waking up at an absolute time (instead of sleeping for a relative duration)
+  // prevents the time spent between computing and starting the delay from accumulating as drift.
+  void SleepUntil(const std::chrono::steady_clock::time_point& deadline)
+  {
+#if defined(__linux__)
+    // steady_clock is CLOCK_MONOTONIC on Linux
+    const long long deadlineNs = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    struct timespec deadlineSpec;
+    deadlineSpec.tv_sec = static_cast<time_t>(deadlineNs / 1000000000LL);
+    deadlineSpec.tv_nsec = static_cast<long>(deadlineNs % 1000000000LL);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadlineSpec, NULL) == EINTR)
+    {
+      // interrupted by a signal, continue sleeping until the deadline
+    }
+#else
+    const double remainingSec = std::chrono::duration<double>(deadline - std::chrono::steady_clock::now()).count();
+    if (remainingSec > 0)
+    {
+      vtkIGSIOAccurateTimer::Delay(remainingSec);
+    }
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDevice::ApplyCaptureThreadSchedulingSettings()
+{
+  // The setter does not validate the core index, an index outside of the affinity mask must not be used
+  bool setCpuAffinity = (this->CaptureThreadCpuAffinity >= 0);
+  if (setCpuAffinity && this->CaptureThreadCpuAffinity >= GetNumberOfSelectableCpuCores())
+  {
+    LOCAL_LOG_WARNING("Internal update thread CPU affinity is not set: core " << this->CaptureThreadCpuAffinity << " does not exist");
+    setCpuAffinity = false;
+  }
+#if defined(__linux__)
+  if (setCpuAffinity)
+  {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(this->CaptureThreadCpuAffinity, &cpuSet);
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuSet);
+    if (result != 0)
+    {
+      LOCAL_LOG_WARNING("Failed to set internal update thread CPU affinity to core " << this->CaptureThreadCpuAffinity << " (error code: " << result << ")");
+    }
+  }
+  if (this->CaptureThreadRealTimePriority > 0)
+  {
+    struct sched_param param;
+    param.sched_priority = std::min(std::max(this->CaptureThreadRealTimePriority, sched_get_priority_min(SCHED_FIFO)), sched_get_priority_max(SCHED_FIFO));
+    int result = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    if (result != 0)
+    {
+      LOCAL_LOG_WARNING("Failed to set internal update thread real-time priority to " << param.sched_priority << " (error code: " << result << "). The process may lack the CAP_SYS_NICE capability.");
+    }
+  }
+#elif defined(_WIN32)
+  if (setCpuAffinity)
+  {
+    if (SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << this->CaptureThreadCpuAffinity) == 0)
+    {
+      LOCAL_LOG_WARNING("Failed to set internal update thread CPU affinity to core " << this->CaptureThreadCpuAffinity << " (error code: " << GetLastError() << ")");
+    }
+  }
+  if (this->CaptureThreadRealTimePriority > 0)
+  {
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL))
+    {
+      LOCAL_LOG_WARNING("Failed to set internal update thread priority to time critical (error code: " << GetLastError() << ")");
+    }
+  }
+#else
+  if (setCpuAffinity || this->CaptureThreadRealTimePriority > 0)
+  {
+    LOCAL_LOG_WARNING("Internal update thread CPU affinity and real-time priority are not supported on this platform");
+  }
+#endif
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusDevice::AddCapturePeriodSample(double periodErrorSec, bool deadlineMissed)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> statisticsLock(this->CaptureStatisticsMutex);
+  if (this->CapturePeriodErrorsSec.size() < CAPTURE_PERIOD_STATISTICS_SIZE)
+  {
+    this->CapturePeriodErrorsSec.push_back(fabs(periodErrorSec));
+  }
+  else
+  {
+    this->CapturePeriodErrorsSec[this->CapturePeriodErrorsNextIndex] = fabs(periodErrorSec);
+  }
+  this->CapturePeriodErrorsNextIndex = (this->CapturePeriodErrorsNextIndex + 1) % CAPTURE_PERIOD_STATISTICS_SIZE;
+  if (deadlineMissed)
+  {
+    this->CaptureMissedDeadlines++;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusDevice::GetCapturePeriodErrorStatistics(double& p50Sec, double& p99Sec, double& maxSec, unsigned long& missedDeadlines) const
+{
+  std::vector<double> periodErrorsSec;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> statisticsLock(this->CaptureStatisticsMutex);
+    periodErrorsSec = this->CapturePeriodErrorsSec;
+    missedDeadlines = this->CaptureMissedDeadlines;
+  }
+  if (periodErrorsSec.empty())
+  {
+    p50Sec = p99Sec = maxSec = 0.0;
+    return PLUS_FAIL;
+  }
+
+  const size_t p50Index = (periodErrorsSec.size() - 1) * 50 / 100;
+  const size_t p99Index = (periodErrorsSec.size() - 1) * 99 / 100;
+  std::nth_element(periodErrorsSec.begin(), periodErrorsSec.begin() + p50Index, periodErrorsSec.end());
+  p50Sec = periodErrorsSec[p50Index];
+  std::nth_element(periodErrorsSec.begin() + p50Index, periodErrorsSec.begin() + p99Index, periodErrorsSec.end());
+  p99Sec = periodErrorsSec[p99Index];
+  maxSec = *std::max_element(periodErrorsSec.begin() + p99Index, periodErrorsSec.end());
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 // this function runs in an alternate thread to asynchronously acquire data
 void* vtkPlusDevice::vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data)
@@ -1361,6 +1625,15 @@ void* vtkPlusDevice::vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data)
   unsigned long updatecount = 0;
   self->ThreadAlive = true;
 
+  self->ApplyCaptureThreadSchedulingSettings();
+
+  // Updates are scheduled at absolute deadlines (start + n * period), so that overruns do not accumulate drift
+  const double periodSec = 1.0 / rate;
+  const std::chrono::steady_clock::duration period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(periodSec));
+  std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point previousUpdateStart = deadline;
+  bool previousDeadlineMissed = false;
+
   while (self->IsRecording() && self->GetCorrectlyConfigured())
   {
     double newtime = vtkIGSIOAccurateTimer::GetSystemTime();
@@ -1372,6 +1645,13 @@ void* vtkPlusDevice::vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data)
       self->InternalUpdateRate = (FRAME_RATE_AVERAGING / difftime);
     }
 
+    const std::chrono::steady_clock::time_point updateStart = std::chrono::steady_clock::now();
+    if (updatecount > 0)
+    {
+      self->AddCapturePeriodSample(std::chrono::duration<double>(updateStart - previousUpdateStart).count() - periodSec, previousDeadlineMissed);
+    }
+    previousUpdateStart = updateStart;
+
     {
       // Lock before update
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(self->UpdateMutex);
@@ -1384,11 +1664,31 @@ void* vtkPlusDevice::vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data)
       self->UpdateTime.Modified();
     }
 
-    double delay = (newtime + 1.0 / rate - vtkIGSIOAccurateTimer::GetSystemTime());
-    if (delay > 0)
+    deadline += period;
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    previousDeadlineMissed = (now > deadline);
+    if (previousDeadlineMissed)
     {
-      vtkIGSIOAccurateTimer::Delay(delay);
+      switch (self->CaptureDeadlinePolicy)
+      {
+      case CAPTURE_DEADLINE_CATCH_UP:
+        if (now - deadline > CAPTURE_MAX_CATCH_UP_PERIODS * period)
+        {
+          // Too far behind, give up on the missed updates
+          deadline = now;
+        }
+        break;
+      case CAPTURE_DEADLINE_RESET:
+        deadline = now;
+        break;
+      case CAPTURE_DEADLINE_SKIP:
+      default:
+        // Move to the first deadline of the original schedule that is still ahead
+        deadline += ((now - deadline) / period + 1) * period;
+        break;
+      }
     }
+    SleepUntil(deadline);
 
     updatecount++;
   }
@@ -2309,6 +2609,18 @@ ChannelContainerIterator vtkPlusDevice::GetOutputChannelsEnd()
   return this->OutputChannels.end();
 }
 
+//----------------------------------------------------------------------------
+ChannelContainerConstIterator vtkPlusDevice::GetInputChannelsStart() const
+{
+  return this->InputChannels.begin();
+}
+
+//----------------------------------------------------------------------------
+ChannelContainerConstIterator vtkPlusDevice::GetInputChannelsEnd() const
+{
+  return this->InputChannels.end();
+}
+
 //------------------------------------------------------------------------------
 PlusStatus vtkPlusDevice::GetToolReferenceFrameFromTrackedFrame(igsioTrackedFrame& aFrame, std::string& aToolReferenceFrameName)
 {
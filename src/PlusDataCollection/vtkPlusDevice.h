@@ -22,8 +22,11 @@ See License.txt for details.
 #include <set>
 
 // STL includes
+#include <memory>
 #include <string>
+#include <vector>
 
+class PlusVirtualDeviceExecutor;
 class vtkPlusBuffer;
 class vtkPlusDataCollector;
 class vtkPlusDataSource;
@@ -162,6 +165,45 @@ public:
   /*! Get the internal update rate for this tracking system.  This is the number of buffer entry items sent by the device per second (per tool). */
   double GetInternalUpdateRate() const;
 
+  /*! Action of the internal update thread when an update completes after the deadline of the next update */
+  enum CaptureDeadlinePolicyType
+  {
+    CAPTURE_DEADLINE_SKIP,      /*!< Drop the missed updates and continue at the next deadline of the original schedule */
+    CAPTURE_DEADLINE_CATCH_UP,  /*!< Perform the missed updates immediately to keep the average rate (at most CAPTURE_MAX_CATCH_UP_PERIODS behind) */
+    CAPTURE_DEADLINE_RESET      /*!< Perform the next update immediately and restart the schedule from there */
+  };
+
+  /*! Set the action of the internal update thread when a deadline is missed */
+  vtkSetMacro(CaptureDeadlinePolicy, CaptureDeadlinePolicyType);
+  /*! Get the action of the internal update thread when a deadline is missed */
+  vtkGetMacro(CaptureDeadlinePolicy, CaptureDeadlinePolicyType);
+
+  /*!
+    Set the index of the CPU core the internal update thread runs on (-1 = no restriction).
+    Indices that exceed the number of CPUs or the size of the platform affinity mask are ignored.
+  */
+  vtkSetMacro(CaptureThreadCpuAffinity, int);
+  /*! Get the index of the CPU core the internal update thread runs on (-1 = no restriction) */
+  vtkGetMacro(CaptureThreadCpuAffinity, int);
+
+  /*!
+    Set the real-time priority of the internal update thread (0 = normal scheduling).
+    On Linux this is the SCHED_FIFO priority (1-99, requires CAP_SYS_NICE), on Windows any positive value selects time critical priority.
+  */
+  vtkSetMacro(CaptureThreadRealTimePriority, int);
+  /*! Get the real-time priority of the internal update thread (0 = normal scheduling) */
+  vtkGetMacro(CaptureThreadRealTimePriority, int);
+
+  /*!
+    Get statistics of the absolute difference between the actual and the requested period of the internal update thread,
+    computed from the most recent CAPTURE_PERIOD_STATISTICS_SIZE updates. Also available through GetParameter with the keys
+    CapturePeriodErrorP50Ms, CapturePeriodErrorP99Ms, CapturePeriodErrorMaxMs and CaptureMissedDeadlines.
+    If the device is updated by the shared virtual device executor of the data collector then no statistics are recorded,
+    instead the CPU time spent in InternalUpdate is available through GetParameter with the key InternalUpdateCpuTimeSec.
+    \return PLUS_FAIL if no periods have been measured yet
+  */
+  PlusStatus GetCapturePeriodErrorStatistics(double& p50Sec, double& p99Sec, double& maxSec, unsigned long& missedDeadlines) const;
+
   /*! Get the data source object for the specified Id name, checks both video and tools */
   PlusStatus GetDataSource(const char* aSourceId, vtkPlusDataSource*& aSource);
   PlusStatus GetDataSource(const std::string& aSourceId, vtkPlusDataSource*& aSource);
@@ -396,6 +438,10 @@ public:
   /*! Add an input channel */
   PlusStatus AddInputChannel(vtkPlusChannel* aChannel);
 
+  /*! Allow iteration over the input channels (e.g., to determine which devices this device depends on) */
+  ChannelContainerConstIterator GetInputChannelsStart() const;
+  ChannelContainerConstIterator GetInputChannelsEnd() const;
+
   /*!
   Perform any completion tasks once configured
   */
@@ -445,6 +491,12 @@ public:
 protected:
   static void* vtkDataCaptureThread(vtkMultiThreader::ThreadInfo* data);
 
+  /*! Apply the CPU affinity and real-time priority settings to the calling (internal update) thread */
+  void ApplyCaptureThreadSchedulingSettings();
+
+  /*! Record the period of an internal update thread iteration for the jitter statistics */
+  void AddCapturePeriodSample(double periodErrorSec, bool deadlineMissed);
+
   /*! Should be overridden to connect to the hardware */
   virtual PlusStatus InternalConnect();
 
@@ -605,7 +657,28 @@ protected:
   /*! Map to store general purpose device parameters  */
   std::map<std::string, std::string> Parameters;
 
+  /*! Action of the internal update thread when a deadline is missed */
+  CaptureDeadlinePolicyType CaptureDeadlinePolicy;
+  /*! CPU core of the internal update thread (-1 = no restriction) */
+  int CaptureThreadCpuAffinity;
+  /*! Real-time priority of the internal update thread (0 = normal scheduling) */
+  int CaptureThreadRealTimePriority;
+
+  /*! Mutex protecting the capture period statistics, which are written by the internal update thread */
+  vtkIGSIORecursiveCriticalSection* CaptureStatisticsMutex;
+  /*! Circular buffer of the most recent absolute period errors of the internal update thread */
+  std::vector<double> CapturePeriodErrorsSec;
+  /*! Position in CapturePeriodErrorsSec where the next sample is written */
+  unsigned int CapturePeriodErrorsNextIndex;
+  /*! Number of deadlines missed by the internal update thread since recording started */
+  unsigned long CaptureMissedDeadlines;
+
+  /*! If set, then InternalUpdate is called by this shared executor instead of an own internal update thread */
+  std::shared_ptr<PlusVirtualDeviceExecutor> SharedExecutor;
+
   static const int VIRTUAL_DEVICE_FRAME_RATE;
+  static const unsigned int CAPTURE_PERIOD_STATISTICS_SIZE;
+  static const int CAPTURE_MAX_CATCH_UP_PERIODS;
 
 protected:
   /*
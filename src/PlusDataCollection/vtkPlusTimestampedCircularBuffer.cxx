@@ -12,8 +12,44 @@ See License.txt for details.
 #include "vtkTable.h"
 #include "vtkVariantArray.h"
 
+#include <algorithm>
+#include <thread>
+
 vtkStandardNewMacro(vtkPlusTimestampedCircularBuffer);
 
+namespace
+{
+  /*! Maximum number of replaced items kept for reuse in LockFree mode */
+  const unsigned int LOCK_FREE_MAX_RECYCLED_ITEMS = 4;
+
+  //----------------------------------------------------------------------------
+  /*! Median of the values (the order of the values is changed) */
+  double ComputeMedian(std::vector<double>& values)
+  {
+    const size_t middle = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + middle, values.end());
+    double median = values[middle];
+    if (values.size() % 2 == 0)
+    {
+      median = 0.5 * (median + *std::max_element(values.begin(), values.begin() + middle));
+    }
+    return median;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusTimestampedCircularBuffer::LockFreeSlot::LockFreeSlot()
+  : Sequence(0)
+  , FilteredTimeStamp(0.0)
+  , UnfilteredTimeStamp(0.0)
+  , Index(0)
+  , ValidVideoData(false)
+  , ValidTransformData(false)
+  , ValidFieldData(false)
+  , Item(std::make_shared<StreamBufferItem>())
+{
+}
+
 //----------------------------------------------------------------------------
 vtkPlusTimestampedCircularBuffer::vtkPlusTimestampedCircularBuffer()
   : Mutex(vtkIGSIORecursiveCriticalSection::New())
@@ -22,7 +58,15 @@ vtkPlusTimestampedCircularBuffer::vtkPlusTimestampedCircularBuffer()
   , CurrentTimeStamp(0.0)
   , LocalTimeOffsetSec(0.0)
   , LatestItemUid(0)
+  , LockFree(false)
+  , LockFreeBufferSize(0)
+  , ActiveLockFreeReaders(0)
+  , LockFreeSlotsChanging(false)
+  , PublishedLatestItemUid(0)
+  , StagedItemUid(0)
+  , StagedBufferIndex(-1)
   , AveragedItemsForFiltering(20)
+  , TimestampFilteringMethod(TIMESTAMP_FILTERING_LINEAR_REGRESSION)
   , MaxAllowedFilteringTimeDifference(0.5)
   , TimeStampReportTable(NULL)
   , TimeStampReporting(false)
@@ -35,12 +79,23 @@ vtkPlusTimestampedCircularBuffer::vtkPlusTimestampedCircularBuffer()
   this->FilterContainerTimestampVector.set_size(0);
   this->FilterContainersOldestIndex = 0;
   this->FilterContainersNumberOfValidElements = 0;
+  this->FilterSumX = 0;
+  this->FilterSumY = 0;
+  this->FilterSumXX = 0;
+  this->FilterSumXY = 0;
+  this->FilterSumsReferenceIndex = 0;
+  this->FilterSumsReferenceTimestamp = 0;
+  this->RobustFilteringSlopes.reserve(ROBUST_FILTERING_MAX_SAMPLES * (ROBUST_FILTERING_MAX_SAMPLES - 1) / 2);
+  this->RobustFilteringResiduals.reserve(ROBUST_FILTERING_MAX_SAMPLES);
 }
 
 //----------------------------------------------------------------------------
 vtkPlusTimestampedCircularBuffer::~vtkPlusTimestampedCircularBuffer()
 {
   this->BufferItemContainer.clear();
+  this->LockFreeSlots.clear();
+  this->StagedItem.reset();
+  this->RecycledItems.clear();
 
   this->NumberOfItems = 0;
   if (this->Mutex != NULL)
@@ -67,6 +122,182 @@ void vtkPlusTimestampedCircularBuffer::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "CurrentTimeStamp: " << this->CurrentTimeStamp << "\n";
   os << indent << "Local time offset: " << this->LocalTimeOffsetSec << "\n";
   os << indent << "Latest Item Uid: " << this->LatestItemUid << "\n";
+  os << indent << "LockFree: " << (this->LockFree ? "TRUE" : "FALSE") << "\n";
+  os << indent << "AveragedItemsForFiltering: " << this->AveragedItemsForFiltering << "\n";
+  os << indent << "TimestampFilteringMethod: " << GetTimestampFilteringMethodAsString(this->TimestampFilteringMethod) << "\n";
+}
+
+//----------------------------------------------------------------------------
+const char* vtkPlusTimestampedCircularBuffer::GetTimestampFilteringMethodAsString(TimestampFilteringMethodType method)
+{
+  switch (method)
+  {
+    case TIMESTAMP_FILTERING_LINEAR_REGRESSION:
+      return "LINEAR_REGRESSION";
+    case TIMESTAMP_FILTERING_ROBUST_REGRESSION:
+      return "ROBUST_REGRESSION";
+  }
+  return "UNKNOWN";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTimestampedCircularBuffer::GetTimestampFilteringMethodFromString(const char* methodString, TimestampFilteringMethodType& method)
+{
+  if (methodString == NULL)
+  {
+    return PLUS_FAIL;
+  }
+  if (STRCASECMP(methodString, "LINEAR_REGRESSION") == 0)
+  {
+    method = TIMESTAMP_FILTERING_LINEAR_REGRESSION;
+    return PLUS_SUCCESS;
+  }
+  if (STRCASECMP(methodString, "ROBUST_REGRESSION") == 0)
+  {
+    method = TIMESTAMP_FILTERING_ROBUST_REGRESSION;
+    return PLUS_SUCCESS;
+  }
+  return PLUS_FAIL;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusTimestampedCircularBuffer::GetNumberOfItems()
+{
+  if (this->LockFree)
+  {
+    BufferItemUidType latestUid = this->PublishedLatestItemUid.load(std::memory_order_acquire);
+    return static_cast<int>(latestUid - this->GetPublishedOldestItemUid(latestUid) + 1);
+  }
+  return this->NumberOfItems;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTimestampedCircularBuffer::SetLockFree(bool lockFree)
+{
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
+
+  if (this->LockFree == lockFree)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  const int bufferSize = this->GetBufferSize();
+  if (lockFree)
+  {
+    // Move the (already allocated) items into the slots, so that frames do not have to be allocated again
+    this->BeginLockFreeSlotsChange();
+    this->LockFreeSlots.clear();
+    for (int i = 0; i < bufferSize; ++i)
+    {
+      std::unique_ptr<LockFreeSlot> slot(new LockFreeSlot);
+      slot->Item = std::make_shared<StreamBufferItem>(this->BufferItemContainer[i]);
+      this->LockFreeSlots.push_back(std::move(slot));
+    }
+    this->LockFreeBufferSize.store(bufferSize, std::memory_order_release);
+    this->EndLockFreeSlotsChange();
+    this->BufferItemContainer.clear();
+  }
+  else
+  {
+    this->BufferItemContainer.clear();
+    for (int i = 0; i < bufferSize; ++i)
+    {
+      this->BufferItemContainer.push_back(*std::atomic_load(&this->LockFreeSlots[i]->Item));
+    }
+    this->BeginLockFreeSlotsChange();
+    this->LockFreeSlots.clear();
+    this->LockFreeBufferSize.store(0, std::memory_order_release);
+    this->EndLockFreeSlotsChange();
+    this->StagedItem.reset();
+    this->RecycledItems.clear();
+  }
+
+  this->LockFree = lockFree;
+  this->WritePointer = 0;
+  this->NumberOfItems = 0;
+  this->CurrentTimeStamp = 0.0;
+  this->LatestItemUid = 0;
+  this->PublishedLatestItemUid.store(0, std::memory_order_release);
+  this->StagedBufferIndex = -1;
+  this->Modified();
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::ResetLockFreeSlots(int bufferSize, bool keepItems)
+{
+  // the caller must have locked the buffer
+  this->BeginLockFreeSlotsChange();
+  std::vector< std::unique_ptr<LockFreeSlot> > oldSlots;
+  oldSlots.swap(this->LockFreeSlots);
+  for (int i = 0; i < bufferSize; ++i)
+  {
+    std::unique_ptr<LockFreeSlot> slot(new LockFreeSlot);
+    std::shared_ptr<StreamBufferItem> oldItem;
+    if (keepItems && i < static_cast<int>(oldSlots.size()))
+    {
+      oldItem = std::atomic_load(&oldSlots[i]->Item);
+    }
+    if (oldItem != nullptr && oldItem.use_count() == 2)
+    {
+      // keep the item objects (and their allocated frames), only invalidate the contents.
+      // Items that readers have pinned are left to the readers (the new slot gets a new item), as they may still read them.
+      slot->Item = oldItem;
+    }
+    this->LockFreeSlots.push_back(std::move(slot));
+  }
+  // Reset the published range before readers are let in, so that they do not look up old UIDs in the new slots
+  this->PublishedLatestItemUid.store(0, std::memory_order_release);
+  this->LockFreeBufferSize.store(bufferSize, std::memory_order_release);
+  this->EndLockFreeSlotsChange();
+  this->StagedItem.reset();
+  this->StagedBufferIndex = -1;
+  this->RecycledItems.clear();
+}
+
+//----------------------------------------------------------------------------
+vtkPlusTimestampedCircularBuffer::LockFreeReadScope::LockFreeReadScope(vtkPlusTimestampedCircularBuffer* buffer)
+  : Buffer(buffer)
+{
+  // The counter is incremented before checking the flag, and BeginLockFreeSlotsChange sets the flag before checking the counter,
+  // so either the reader sees the flag and backs off or the writer sees the reader and waits for it
+  for (;;)
+  {
+    this->Buffer->ActiveLockFreeReaders.fetch_add(1);
+    if (!this->Buffer->LockFreeSlotsChanging.load())
+    {
+      return;
+    }
+    this->Buffer->ActiveLockFreeReaders.fetch_sub(1);
+    while (this->Buffer->LockFreeSlotsChanging.load())
+    {
+      std::this_thread::yield();
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusTimestampedCircularBuffer::LockFreeReadScope::~LockFreeReadScope()
+{
+  this->Buffer->ActiveLockFreeReaders.fetch_sub(1);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::BeginLockFreeSlotsChange()
+{
+  // the caller must have locked the buffer
+  this->LockFreeSlotsChanging.store(true);
+  while (this->ActiveLockFreeReaders.load() > 0)
+  {
+    std::this_thread::yield();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::EndLockFreeSlotsChange()
+{
+  this->LockFreeSlotsChanging.store(false);
 }
 
 //----------------------------------------------------------------------------
@@ -80,9 +311,53 @@ PlusStatus vtkPlusTimestampedCircularBuffer::PrepareForNewItem(const double time
     return PLUS_FAIL;
   }
 
+  if (this->LockFree)
+  {
+    if (this->LockFreeSlots.empty())
+    {
+      LOG_ERROR("Failed to prepare for new item - buffer size is 0");
+      return PLUS_FAIL;
+    }
+    // The item is written into a staging item, which becomes visible to readers in CommitNewItem.
+    // The UID is only consumed when the item is committed.
+    newFrameUid = this->LatestItemUid + 1;
+    bufferIndex = this->WritePointer;
+    if (this->StagedItem == nullptr)
+    {
+      // Reuse an old item that no reader refers to anymore, to avoid memory allocation.
+      // Only the buffer refers to recycled items, so their use count cannot increase.
+      for (std::vector< std::shared_ptr<StreamBufferItem> >::iterator it = this->RecycledItems.begin(); it != this->RecycledItems.end(); ++it)
+      {
+        if (it->use_count() == 1)
+        {
+          std::atomic_thread_fence(std::memory_order_acquire);
+          this->StagedItem = *it;
+          this->RecycledItems.erase(it);
+          break;
+        }
+      }
+      if (this->StagedItem == nullptr)
+      {
+        // All recycled items are in use by readers, create a new one with the same frame format as the item that will be replaced
+        this->StagedItem = std::make_shared<StreamBufferItem>(*std::atomic_load(&this->LockFreeSlots[bufferIndex]->Item));
+      }
+    }
+    // Pixel data of recycled items may still be shared with consumers
+    this->StagedItem->DetachSharedFrameData();
+    this->StagedItemUid = newFrameUid;
+    this->StagedBufferIndex = bufferIndex;
+    return PLUS_SUCCESS;
+  }
+
   // Increase frame unique ID
   newFrameUid = ++this->LatestItemUid;
   bufferIndex = this->WritePointer;
+
+  // Consumers may still use the pixel data of the item that is about to be overwritten
+  if (bufferIndex < static_cast<int>(this->BufferItemContainer.size()))
+  {
+    this->BufferItemContainer[bufferIndex].DetachSharedFrameData();
+  }
   this->CurrentTimeStamp = timestamp;
 
   this->NumberOfItems++;
@@ -99,6 +374,165 @@ PlusStatus vtkPlusTimestampedCircularBuffer::PrepareForNewItem(const double time
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTimestampedCircularBuffer::CommitNewItem(const int bufferIndex)
+{
+  if (!this->LockFree)
+  {
+    // items are written in place
+    return PLUS_SUCCESS;
+  }
+
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
+
+  if (this->StagedItem == nullptr || bufferIndex != this->StagedBufferIndex)
+  {
+    LOG_ERROR("Failed to commit new item - PrepareForNewItem has not been called (buffer index: " << bufferIndex << ")");
+    return PLUS_FAIL;
+  }
+
+  const BufferItemUidType uid = this->StagedItemUid;
+  StreamBufferItem* item = this->StagedItem.get();
+  LockFreeSlot& slot = *this->LockFreeSlots[bufferIndex];
+
+  // Mark the slot as being written, readers that see an odd sequence number or a sequence number change will retry
+  slot.Sequence.store(2 * uid + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::shared_ptr<StreamBufferItem> replacedItem = std::atomic_exchange(&slot.Item, this->StagedItem);
+  slot.FilteredTimeStamp.store(item->GetFilteredTimestamp(0), std::memory_order_relaxed);
+  slot.UnfilteredTimeStamp.store(item->GetUnfilteredTimestamp(0), std::memory_order_relaxed);
+  slot.Index.store(item->GetIndex(), std::memory_order_relaxed);
+  slot.ValidVideoData.store(item->HasValidVideoData(), std::memory_order_relaxed);
+  slot.ValidTransformData.store(item->HasValidTransformData(), std::memory_order_relaxed);
+  slot.ValidFieldData.store(item->HasValidFieldData(), std::memory_order_relaxed);
+  slot.Sequence.store(2 * uid, std::memory_order_release);
+
+  this->LatestItemUid = uid;
+  this->CurrentTimeStamp = item->GetFilteredTimestamp(0);
+  this->NumberOfItems = std::min<int>(this->NumberOfItems + 1, this->GetBufferSize());
+  if (++this->WritePointer >= this->GetBufferSize())
+  {
+    this->WritePointer = 0;
+  }
+  this->PublishedLatestItemUid.store(uid, std::memory_order_release);
+
+  this->StagedItem.reset();
+  this->StagedBufferIndex = -1;
+  if (this->RecycledItems.size() < LOCK_FREE_MAX_RECYCLED_ITEMS)
+  {
+    this->RecycledItems.push_back(replacedItem);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::ReadLockFreeSlotHeader(const BufferItemUidType uid, LockFreeSlotHeader& header)
+{
+  LockFreeReadScope readScope(this);
+  if (this->LockFreeSlots.empty() || uid == 0)
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  LockFreeSlot& slot = this->GetLockFreeSlot(uid);
+  for (int attempt = 0; attempt < LOCK_FREE_MAX_READ_ATTEMPTS; ++attempt)
+  {
+    BufferItemUidType sequenceBefore = slot.Sequence.load(std::memory_order_acquire);
+    if (sequenceBefore > 2 * uid + 1)
+    {
+      // the slot already stores a newer item
+      return ITEM_NOT_AVAILABLE_ANYMORE;
+    }
+    if (sequenceBefore != 2 * uid)
+    {
+      // the producer is writing this item right now
+      continue;
+    }
+    header.FilteredTimeStamp = slot.FilteredTimeStamp.load(std::memory_order_relaxed);
+    header.UnfilteredTimeStamp = slot.UnfilteredTimeStamp.load(std::memory_order_relaxed);
+    header.Index = slot.Index.load(std::memory_order_relaxed);
+    header.ValidVideoData = slot.ValidVideoData.load(std::memory_order_relaxed);
+    header.ValidTransformData = slot.ValidTransformData.load(std::memory_order_relaxed);
+    header.ValidFieldData = slot.ValidFieldData.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.Sequence.load(std::memory_order_relaxed) == sequenceBefore)
+    {
+      return ITEM_OK;
+    }
+  }
+  return ITEM_NOT_AVAILABLE_ANYMORE;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::PinBufferItemFromUid(const BufferItemUidType uid, std::shared_ptr<StreamBufferItem>& item)
+{
+  item.reset();
+  if (!this->LockFree)
+  {
+    LOG_ERROR("Buffer items can only be pinned in LockFree mode");
+    return ITEM_UNKNOWN_ERROR;
+  }
+  LockFreeReadScope readScope(this);
+  if (this->LockFreeSlots.empty())
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  BufferItemUidType latestUid = this->PublishedLatestItemUid.load(std::memory_order_acquire);
+  if (uid > latestUid)
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  if (uid < this->GetPublishedOldestItemUid(latestUid))
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  LockFreeSlot& slot = this->GetLockFreeSlot(uid);
+  for (int attempt = 0; attempt < LOCK_FREE_MAX_READ_ATTEMPTS; ++attempt)
+  {
+    BufferItemUidType sequenceBefore = slot.Sequence.load(std::memory_order_acquire);
+    if (sequenceBefore > 2 * uid + 1)
+    {
+      return ITEM_NOT_AVAILABLE_ANYMORE;
+    }
+    if (sequenceBefore != 2 * uid)
+    {
+      continue;
+    }
+    item = std::atomic_load(&slot.Item);
+    if (slot.Sequence.load(std::memory_order_acquire) == sequenceBefore)
+    {
+      return ITEM_OK;
+    }
+    item.reset();
+  }
+  return ITEM_NOT_AVAILABLE_ANYMORE;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::ReplaceBufferItem(const BufferItemUidType uid, const std::shared_ptr<StreamBufferItem>& item)
+{
+  // the caller must have locked the buffer
+  if (!this->LockFree || item == nullptr)
+  {
+    return ITEM_UNKNOWN_ERROR;
+  }
+  if (uid > this->LatestItemUid)
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  if (uid < this->GetPublishedOldestItemUid(this->LatestItemUid))
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  LockFreeSlot& slot = this->GetLockFreeSlot(uid);
+  slot.Sequence.store(2 * uid + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::atomic_store(&slot.Item, item);
+  slot.ValidFieldData.store(item->HasValidFieldData(), std::memory_order_relaxed);
+  slot.Sequence.store(2 * uid, std::memory_order_release);
+  return ITEM_OK;
+}
+
 //----------------------------------------------------------------------------
 // Sets the buffer size, and copies the maximum number of the most current old
 // frames and timestamps
@@ -117,6 +551,20 @@ PlusStatus vtkPlusTimestampedCircularBuffer::SetBufferSize(int newBufferSize)
     return PLUS_SUCCESS;
   }
 
+  if (this->LockFree)
+  {
+    // Readers access the slots without locking, therefore the slots are replaced while readers are kept out
+    // (see ResetLockFreeSlots) and the contents are not preserved
+    this->ResetLockFreeSlots(newBufferSize, true);
+    this->WritePointer = 0;
+    this->NumberOfItems = 0;
+    this->CurrentTimeStamp = 0.0;
+    this->LatestItemUid = 0;
+    this->PublishedLatestItemUid.store(0, std::memory_order_release);
+    this->Modified();
+    return PLUS_SUCCESS;
+  }
+
   if (this->GetBufferSize() == 0)
   {
     for (int i = 0; i < newBufferSize; i++)
@@ -170,6 +618,22 @@ PlusStatus vtkPlusTimestampedCircularBuffer::SetBufferSize(int newBufferSize)
 ItemStatus vtkPlusTimestampedCircularBuffer::GetBufferItemPointerFromUid(const BufferItemUidType uid, StreamBufferItem*& itemPtr)
 {
   // the caller must have locked the buffer
+  if (this->LockFree)
+  {
+    // Only the producer (that has locked the buffer) may access the published items directly
+    if (uid > this->LatestItemUid)
+    {
+      itemPtr = NULL;
+      return ITEM_NOT_AVAILABLE_YET;
+    }
+    if (uid < this->GetPublishedOldestItemUid(this->LatestItemUid))
+    {
+      itemPtr = NULL;
+      return ITEM_NOT_AVAILABLE_ANYMORE;
+    }
+    itemPtr = std::atomic_load(&this->GetLockFreeSlot(uid).Item).get();
+    return ITEM_OK;
+  }
   BufferItemUidType oldestUid = this->LatestItemUid - (this->NumberOfItems - 1);
   if (uid < oldestUid)
   {
@@ -203,12 +667,27 @@ StreamBufferItem* vtkPlusTimestampedCircularBuffer::GetBufferItemPointerFromBuff
     LOG_ERROR("Failed to get buffer item with buffer index - index is out of range (bufferIndex: " << bufferIndex << ").");
     return NULL;
   }
+  if (this->LockFree)
+  {
+    if (bufferIndex == this->StagedBufferIndex && this->StagedItem != nullptr)
+    {
+      return this->StagedItem.get();
+    }
+    return std::atomic_load(&this->LockFreeSlots[bufferIndex]->Item).get();
+  }
   return &this->BufferItemContainer[bufferIndex];
 }
 
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetFilteredTimeStamp(const BufferItemUidType uid, double& filteredTimestamp)
 {
+  if (this->LockFree)
+  {
+    LockFreeSlotHeader header;
+    ItemStatus status = this->GetLockFreeItemHeader(uid, header);
+    filteredTimestamp = (status == ITEM_OK) ? header.FilteredTimeStamp + this->LocalTimeOffsetSec : 0;
+    return status;
+  }
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   StreamBufferItem* itemPtr = NULL;
   ItemStatus status = GetBufferItemPointerFromUid(uid, itemPtr);
@@ -224,6 +703,13 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetFilteredTimeStamp(const BufferIt
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetUnfilteredTimeStamp(const BufferItemUidType uid, double& unfilteredTimestamp)
 {
+  if (this->LockFree)
+  {
+    LockFreeSlotHeader header;
+    ItemStatus status = this->GetLockFreeItemHeader(uid, header);
+    unfilteredTimestamp = (status == ITEM_OK) ? header.UnfilteredTimeStamp + this->LocalTimeOffsetSec : 0;
+    return status;
+  }
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   StreamBufferItem* itemPtr = NULL;
   ItemStatus status = GetBufferItemPointerFromUid(uid, itemPtr);
@@ -239,6 +725,11 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetUnfilteredTimeStamp(const Buffer
 //----------------------------------------------------------------------------
 bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidVideoData()
 {
+  if (this->LockFree)
+  {
+    LockFreeSlotHeader header;
+    return this->GetLockFreeItemHeader(this->PublishedLatestItemUid.load(std::memory_order_acquire), header) == ITEM_OK && header.ValidVideoData;
+  }
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   if (this->NumberOfItems < 1)
   {
@@ -251,6 +742,11 @@ bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidVideoData()
 //----------------------------------------------------------------------------
 bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidTransformData()
 {
+  if (this->LockFree)
+  {
+    LockFreeSlotHeader header;
+    return this->GetLockFreeItemHeader(this->PublishedLatestItemUid.load(std::memory_order_acquire), header) == ITEM_OK && header.ValidTransformData;
+  }
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   if (this->NumberOfItems < 1)
   {
@@ -263,6 +759,11 @@ bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidTransformData()
 //----------------------------------------------------------------------------
 bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidFieldData()
 {
+  if (this->LockFree)
+  {
+    LockFreeSlotHeader header;
+    return this->GetLockFreeItemHeader(this->PublishedLatestItemUid.load(std::memory_order_acquire), header) == ITEM_OK && header.ValidFieldData;
+  }
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   if (this->NumberOfItems < 1)
   {
@@ -275,6 +776,13 @@ bool vtkPlusTimestampedCircularBuffer::GetLatestItemHasValidFieldData()
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetIndex(const BufferItemUidType uid, unsigned long& index)
 {
+  if (this->LockFree)
+  {
+    LockFreeSlotHeader header;
+    ItemStatus status = this->GetLockFreeItemHeader(uid, header);
+    index = (status == ITEM_OK) ? header.Index : 0;
+    return status;
+  }
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   StreamBufferItem* itemPtr = NULL;
   ItemStatus status = GetBufferItemPointerFromUid(uid, itemPtr);
@@ -290,6 +798,25 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetIndex(const BufferItemUidType ui
 //----------------------------------------------------------------------------
 ItemStatus vtkPlusTimestampedCircularBuffer::GetBufferIndexFromTime(const double time, int& bufferIndex)
 {
+  if (this->LockFree)
+  {
+    bufferIndex = -1;
+    BufferItemUidType itemUid = 0;
+    ItemStatus itemStatus = this->GetItemUidFromTime(time, itemUid);
+    if (itemStatus != ITEM_OK)
+    {
+      LOG_WARNING("Buffer item is not in the buffer (time: " << std::fixed << time << ")!");
+      return itemStatus;
+    }
+    const int bufferSize = this->LockFreeBufferSize.load(std::memory_order_acquire);
+    if (bufferSize <= 0)
+    {
+      return ITEM_NOT_AVAILABLE_ANYMORE;
+    }
+    bufferIndex = (itemUid - 1) % bufferSize;
+    return ITEM_OK;
+  }
+
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
   bufferIndex = -1;
 
@@ -314,6 +841,11 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetBufferIndexFromTime(const double
 // that best matches the given timestamp
 ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTime(const double time, BufferItemUidType& uid)
 {
+  if (this->LockFree)
+  {
+    return this->GetLockFreeItemUidFromTime(time, uid);
+  }
+
   igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
 
   if (this->NumberOfItems == 1)
@@ -394,11 +926,235 @@ ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTime(const double tim
 
 }
 
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::GetItemUidFromTimeForward(const double time, const BufferItemUidType searchStartUid, BufferItemUidType& uid)
+{
+  if (this->LockFree)
+  {
+    return this->GetLockFreeItemUidFromTimeForward(time, searchStartUid, uid);
+  }
+
+  igsioLockGuard< vtkPlusTimestampedCircularBuffer > bufferGuardedLock(this);
+
+  BufferItemUidType oldestUid = this->LatestItemUid - (this->NumberOfItems - 1);
+  if (this->NumberOfItems < 2 || searchStartUid < oldestUid || searchStartUid > this->LatestItemUid)
+  {
+    return this->GetItemUidFromTime(time, uid);
+  }
+
+  double tlo = this->GetFilteredTimeStampOfItemInBuffer(searchStartUid);
+  if (time < tlo)
+  {
+    // The requested item is before the start item, it has to be searched in the whole buffer
+    return this->GetItemUidFromTime(time, uid);
+  }
+  if (time > this->GetFilteredTimeStampOfItemInBuffer(this->LatestItemUid) + this->NegligibleTimeDifferenceSec)
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+
+  // Step forward until the requested time is between two items (same result as the binary search in GetItemUidFromTime)
+  for (BufferItemUidType lo = searchStartUid; lo < this->LatestItemUid; ++lo)
+  {
+    double thi = this->GetFilteredTimeStampOfItemInBuffer(lo + 1);
+    if (time < thi)
+    {
+      uid = (time - tlo > thi - time) ? lo + 1 : lo;
+      return ITEM_OK;
+    }
+    tlo = thi;
+  }
+  uid = this->LatestItemUid;
+  return ITEM_OK;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::GetLockFreeItemHeader(const BufferItemUidType uid, LockFreeSlotHeader& header)
+{
+  BufferItemUidType latestUid = this->PublishedLatestItemUid.load(std::memory_order_acquire);
+  if (uid > latestUid || latestUid == 0)
+  {
+    return ITEM_NOT_AVAILABLE_YET;
+  }
+  if (uid < this->GetPublishedOldestItemUid(latestUid))
+  {
+    return ITEM_NOT_AVAILABLE_ANYMORE;
+  }
+  return this->ReadLockFreeSlotHeader(uid, header);
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::GetLockFreeItemUidFromTime(const double time, BufferItemUidType& uid)
+{
+  // Same search as in the locked case, but on a snapshot of the published UID range.
+  // If the producer overwrites an item that the search visits, the search is restarted on the new range.
+  for (int attempt = 0; attempt < LOCK_FREE_MAX_READ_ATTEMPTS; ++attempt)
+  {
+    BufferItemUidType hi = this->PublishedLatestItemUid.load(std::memory_order_acquire);
+    if (hi == 0)
+    {
+      return ITEM_NOT_AVAILABLE_YET;
+    }
+    BufferItemUidType lo = this->GetPublishedOldestItemUid(hi);
+    if (lo == hi)
+    {
+      // There is only one item, it's the closest one to any timestamp
+      uid = hi;
+      return ITEM_OK;
+    }
+
+    LockFreeSlotHeader header;
+    if (this->ReadLockFreeSlotHeader(lo, header) != ITEM_OK)
+    {
+      continue;
+    }
+    double tlo = header.FilteredTimeStamp + this->LocalTimeOffsetSec;
+    if (this->ReadLockFreeSlotHeader(hi, header) != ITEM_OK)
+    {
+      continue;
+    }
+    double thi = header.FilteredTimeStamp + this->LocalTimeOffsetSec;
+
+    // If the timestamp is slightly out of range then still accept it
+    // (due to errors in conversions there could be slight differences)
+    if (time < tlo - this->NegligibleTimeDifferenceSec)
+    {
+      return ITEM_NOT_AVAILABLE_ANYMORE;
+    }
+    else if (time > thi + this->NegligibleTimeDifferenceSec)
+    {
+      return ITEM_NOT_AVAILABLE_YET;
+    }
+
+    bool tornRead = false;
+    while (hi - lo > 1)
+    {
+      BufferItemUidType mid = (lo + hi) / 2;
+      if (this->ReadLockFreeSlotHeader(mid, header) != ITEM_OK)
+      {
+        tornRead = true;
+        break;
+      }
+      double tmid = header.FilteredTimeStamp + this->LocalTimeOffsetSec;
+      if (time < tmid)
+      {
+        hi = mid;
+        thi = tmid;
+      }
+      else
+      {
+        lo = mid;
+        tlo = tmid;
+      }
+    }
+    if (tornRead)
+    {
+      continue;
+    }
+
+    uid = (time - tlo > thi - time) ? hi : lo;
+    return ITEM_OK;
+  }
+
+  // The producer kept overwriting the items that we tried to read, the requested time is probably too old
+  return ITEM_NOT_AVAILABLE_ANYMORE;
+}
+
+//----------------------------------------------------------------------------
+ItemStatus vtkPlusTimestampedCircularBuffer::GetLockFreeItemUidFromTimeForward(const double time, const BufferItemUidType searchStartUid, BufferItemUidType& uid)
+{
+  // Same search as in the locked case, but on a snapshot of the published UID range.
+  // If the producer overwrites an item that the search visits, the search is restarted on the new range.
+  for (int attempt = 0; attempt < LOCK_FREE_MAX_READ_ATTEMPTS; ++attempt)
+  {
+    BufferItemUidType latestUid = this->PublishedLatestItemUid.load(std::memory_order_acquire);
+    if (latestUid == 0 || searchStartUid < this->GetPublishedOldestItemUid(latestUid) || searchStartUid >= latestUid)
+    {
+      return this->GetLockFreeItemUidFromTime(time, uid);
+    }
+
+    LockFreeSlotHeader header;
+    if (this->ReadLockFreeSlotHeader(searchStartUid, header) != ITEM_OK)
+    {
+      continue;
+    }
+    double tlo = header.FilteredTimeStamp + this->LocalTimeOffsetSec;
+    if (time < tlo)
+    {
+      // The requested item is before the start item, it has to be searched in the whole buffer
+      return this->GetLockFreeItemUidFromTime(time, uid);
+    }
+    if (this->ReadLockFreeSlotHeader(latestUid, header) != ITEM_OK)
+    {
+      continue;
+    }
+    if (time > header.FilteredTimeStamp + this->LocalTimeOffsetSec + this->NegligibleTimeDifferenceSec)
+    {
+      return ITEM_NOT_AVAILABLE_YET;
+    }
+
+    bool tornRead = false;
+    BufferItemUidType lo = searchStartUid;
+    for (; lo < latestUid; ++lo)
+    {
+      if (this->ReadLockFreeSlotHeader(lo + 1, header) != ITEM_OK)
+      {
+        tornRead = true;
+        break;
+      }
+      double thi = header.FilteredTimeStamp + this->LocalTimeOffsetSec;
+      if (time < thi)
+      {
+        uid = (time - tlo > thi - time) ? lo + 1 : lo;
+        return ITEM_OK;
+      }
+      tlo = thi;
+    }
+    if (tornRead)
+    {
+      continue;
+    }
+
+    uid = latestUid;
+    return ITEM_OK;
+  }
+
+  // The producer kept overwriting the items that we tried to read, fall back to the search in the whole buffer
+  return this->GetLockFreeItemUidFromTime(time, uid);
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusTimestampedCircularBuffer::DeepCopy(vtkPlusTimestampedCircularBuffer* buffer)
 {
   buffer->Lock();
   this->Lock();
+  this->LockFree = buffer->LockFree;
+  if (this->LockFree)
+  {
+    // Slots are copied as a snapshot, items are copied, so the two buffers do not share any data
+    this->BeginLockFreeSlotsChange();
+    this->LockFreeSlots.clear();
+    for (size_t i = 0; i < buffer->LockFreeSlots.size(); ++i)
+    {
+      std::unique_ptr<LockFreeSlot> slot(new LockFreeSlot);
+      LockFreeSlot& sourceSlot = *buffer->LockFreeSlots[i];
+      slot->Sequence.store(sourceSlot.Sequence.load());
+      slot->FilteredTimeStamp.store(sourceSlot.FilteredTimeStamp.load());
+      slot->UnfilteredTimeStamp.store(sourceSlot.UnfilteredTimeStamp.load());
+      slot->Index.store(sourceSlot.Index.load());
+      slot->ValidVideoData.store(sourceSlot.ValidVideoData.load());
+      slot->ValidTransformData.store(sourceSlot.ValidTransformData.load());
+      slot->ValidFieldData.store(sourceSlot.ValidFieldData.load());
+      slot->Item = std::make_shared<StreamBufferItem>(*std::atomic_load(&sourceSlot.Item));
+      this->LockFreeSlots.push_back(std::move(slot));
+    }
+    this->LockFreeBufferSize.store(static_cast<int>(this->LockFreeSlots.size()), std::memory_order_release);
+    this->PublishedLatestItemUid.store(buffer->PublishedLatestItemUid.load());
+    this->EndLockFreeSlotsChange();
+    this->StagedItem.reset();
+    this->StagedBufferIndex = -1;
+    this->RecycledItems.clear();
+  }
   this->WritePointer = buffer->WritePointer;
   this->NumberOfItems = buffer->NumberOfItems;
   this->CurrentTimeStamp = buffer->CurrentTimeStamp;
@@ -410,6 +1166,13 @@ void vtkPlusTimestampedCircularBuffer::DeepCopy(vtkPlusTimestampedCircularBuffer
   this->FilterContainersOldestIndex = buffer->FilterContainersOldestIndex;
   this->FilterContainerTimestampVector = buffer->FilterContainerTimestampVector;
   this->FilterContainerIndexVector = buffer->FilterContainerIndexVector;
+  this->TimestampFilteringMethod = buffer->TimestampFilteringMethod;
+  this->FilterSumX = buffer->FilterSumX;
+  this->FilterSumY = buffer->FilterSumY;
+  this->FilterSumXX = buffer->FilterSumXX;
+  this->FilterSumXY = buffer->FilterSumXY;
+  this->FilterSumsReferenceIndex = buffer->FilterSumsReferenceIndex;
+  this->FilterSumsReferenceTimestamp = buffer->FilterSumsReferenceTimestamp;
 
   this->BufferItemContainer = buffer->BufferItemContainer;
   this->Unlock();
@@ -424,6 +1187,15 @@ void vtkPlusTimestampedCircularBuffer::Clear()
   this->NumberOfItems = 0;
   this->CurrentTimeStamp = 0;
   this->LatestItemUid = 0;
+  if (this->LockFree)
+  {
+    // Readers may access the slots meanwhile, therefore the slots are only invalidated, not reallocated
+    this->PublishedLatestItemUid.store(0, std::memory_order_release);
+    for (size_t i = 0; i < this->LockFreeSlots.size(); ++i)
+    {
+      this->LockFreeSlots[i]->Sequence.store(0, std::memory_order_release);
+    }
+  }
   this->Unlock();
 }
 
@@ -544,11 +1316,39 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
   // We store the last AveragedItemsForFiltering unfiltered timestamp and item indexes, because these are used for computing the filtered timestamp.
   if (this->AveragedItemsForFiltering > 1)
   {
+    if (this->FilterContainersNumberOfValidElements == 0)
+    {
+      // First item, values in the running sums are relative to this item
+      this->FilterSumsReferenceIndex = itemIndex;
+      this->FilterSumsReferenceTimestamp = inUnfilteredTimestamp;
+      this->FilterSumX = 0;
+      this->FilterSumY = 0;
+      this->FilterSumXX = 0;
+      this->FilterSumXY = 0;
+    }
+    else if (this->FilterContainersNumberOfValidElements == this->AveragedItemsForFiltering)
+    {
+      // The oldest item is overwritten, remove it from the running sums
+      double x = this->FilterContainerIndexVector(this->FilterContainersOldestIndex) - this->FilterSumsReferenceIndex;
+      double y = this->FilterContainerTimestampVector(this->FilterContainersOldestIndex) - this->FilterSumsReferenceTimestamp;
+      this->FilterSumX -= x;
+      this->FilterSumY -= y;
+      this->FilterSumXX -= x * x;
+      this->FilterSumXY -= x * y;
+    }
+
     this->FilterContainerIndexVector(this->FilterContainersOldestIndex) = itemIndex;
     this->FilterContainerTimestampVector[this->FilterContainersOldestIndex] = inUnfilteredTimestamp;
     this->FilterContainersNumberOfValidElements++;
     this->FilterContainersOldestIndex++;
 
+    double x = itemIndex - this->FilterSumsReferenceIndex;
+    double y = inUnfilteredTimestamp - this->FilterSumsReferenceTimestamp;
+    this->FilterSumX += x;
+    this->FilterSumY += y;
+    this->FilterSumXX += x * x;
+    this->FilterSumXY += x * y;
+
     if (this->FilterContainersNumberOfValidElements > this->AveragedItemsForFiltering)
     {
       this->FilterContainersNumberOfValidElements = this->AveragedItemsForFiltering;
@@ -557,6 +1357,10 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
     if (this->FilterContainersOldestIndex >= this->AveragedItemsForFiltering)
     {
       this->FilterContainersOldestIndex = 0;
+      // All the items in the containers have been replaced since the last recomputation.
+      // Recomputing the sums (once in every AveragedItemsForFiltering items, so the cost per item is still constant)
+      // prevents accumulation of rounding errors and keeps the reference close to the current items.
+      this->RecomputeFilterSums();
     }
   }
 
@@ -577,7 +1381,6 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
   // Get rid of the small spikes and get a smooth straight line by fitting a line (timestamp = itemIndex * framePeriod + timeOffset) to the
   // itemIndex vs. unfiltered timestamp function and compute the current filtered timestamp
   // by extrapolation of this line to the current item index.
-  // The line parameters computed by linear regression.
   //
   // timestamp = framePeriod * itemIndex+ timeOffset
   //   x = itemIndex
@@ -585,26 +1388,25 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
   //   a = framePeriod
   //   b = timeOffset
   //
-  // Ordinary least squares estimation:
-  //   y(i) = a * x(i) + b;
-  //   a = sum( (x(i)-xMean) * (y(i)-yMean) ) / sum( (x(i)-xMean) * (x(i)-xMean) )
-  //   b = yMean - a*xMean
-  //
+  // The line parameters are computed by linear regression (see ComputeLinearRegressionFilteredTimeStamp)
+  // or, if occasional large transfer delays are expected, by robust regression (see ComputeRobustRegressionFilteredTimeStamp).
 
-  double xMean = this->FilterContainerIndexVector.mean();
-  double yMean = this->FilterContainerTimestampVector.mean();
-  double covarianceXY = 0;
-  double varianceX = 0;
-  for (int i = this->FilterContainerTimestampVector.size() - 1; i >= 0; i--)
+  bool lineFound = false;
+  switch (this->TimestampFilteringMethod)
   {
-    double xiMinusXmean = (this->FilterContainerIndexVector(i) - xMean);
-    covarianceXY += xiMinusXmean * (this->FilterContainerTimestampVector(i) - yMean);
-    varianceX += xiMinusXmean * xiMinusXmean;
+    case TIMESTAMP_FILTERING_ROBUST_REGRESSION:
+      lineFound = ComputeRobustRegressionFilteredTimeStamp(itemIndex, inUnfilteredTimestamp, outFilteredTimestamp);
+      break;
+    case TIMESTAMP_FILTERING_LINEAR_REGRESSION:
+    default:
+      lineFound = ComputeLinearRegressionFilteredTimeStamp(itemIndex, outFilteredTimestamp);
+      break;
+  }
+  if (!lineFound)
+  {
+    // All the items have the same index, the line cannot be determined
+    outFilteredTimestamp = inUnfilteredTimestamp;
   }
-  double a = covarianceXY / varianceX;
-  double b = yMean - a * xMean;
-
-  outFilteredTimestamp = a * itemIndex + b;
 
   if (this->TimeStampLogging)
   {
@@ -628,6 +1430,127 @@ PlusStatus vtkPlusTimestampedCircularBuffer::CreateFilteredTimeStampForItem(unsi
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::RecomputeFilterSums()
+{
+  this->FilterSumX = 0;
+  this->FilterSumY = 0;
+  this->FilterSumXX = 0;
+  this->FilterSumXY = 0;
+  if (this->FilterContainersNumberOfValidElements == 0)
+  {
+    return;
+  }
+
+  // Use the latest item as reference, the items that are added until the next recomputation are close to it
+  unsigned int latestIndex = (this->FilterContainersOldestIndex + this->AveragedItemsForFiltering - 1) % this->AveragedItemsForFiltering;
+  this->FilterSumsReferenceIndex = this->FilterContainerIndexVector(latestIndex);
+  this->FilterSumsReferenceTimestamp = this->FilterContainerTimestampVector(latestIndex);
+
+  // Valid elements are at the beginning of the containers until the containers are filled
+  for (unsigned int i = 0; i < this->FilterContainersNumberOfValidElements; ++i)
+  {
+    double x = this->FilterContainerIndexVector(i) - this->FilterSumsReferenceIndex;
+    double y = this->FilterContainerTimestampVector(i) - this->FilterSumsReferenceTimestamp;
+    this->FilterSumX += x;
+    this->FilterSumY += y;
+    this->FilterSumXX += x * x;
+    this->FilterSumXY += x * y;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusTimestampedCircularBuffer::ComputeLinearRegressionFilteredTimeStamp(unsigned long itemIndex, double& outFilteredTimestamp)
+{
+  // Ordinary least squares estimation:
+  //   y(i) = a * x(i) + b;
+  //   a = sum( (x(i)-xMean) * (y(i)-yMean) ) / sum( (x(i)-xMean) * (x(i)-xMean) )
+  //   b = yMean - a*xMean
+  //
+  // The sums are computed from the running sums, which are updated at each new item:
+  //   sum( (x(i)-xMean) * (y(i)-yMean) ) = sum( x(i)*y(i) ) - sum( x(i) ) * sum( y(i) ) / n
+  //   sum( (x(i)-xMean) * (x(i)-xMean) ) = sum( x(i)*x(i) ) - sum( x(i) ) * sum( x(i) ) / n
+  //
+  // x and y are relative to the reference item, therefore the cancellation in the subtractions does not cause loss of precision.
+
+  const double n = this->FilterContainersNumberOfValidElements;
+  double varianceX = this->FilterSumXX - this->FilterSumX * this->FilterSumX / n;
+  if (varianceX <= 0)
+  {
+    return false;
+  }
+  double covarianceXY = this->FilterSumXY - this->FilterSumX * this->FilterSumY / n;
+  double xMean = this->FilterSumX / n;
+  double yMean = this->FilterSumY / n;
+  double a = covarianceXY / varianceX;
+
+  outFilteredTimestamp = this->FilterSumsReferenceTimestamp + yMean + a * ((itemIndex - this->FilterSumsReferenceIndex) - xMean);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusTimestampedCircularBuffer::ComputeRobustRegressionFilteredTimeStamp(unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp)
+{
+  // Theil-Sen estimation:
+  //   a = median( (y(j)-y(i)) / (x(j)-x(i)) ) for all i<j pairs
+  //   b = median( y(i) - a * x(i) )
+  //
+  // Delayed items (that have too large unfiltered timestamp) do not influence the result unless
+  // they make up almost half of the window. The number of pairs grows quadratically with the number of items,
+  // therefore at most ROBUST_FILTERING_MAX_SAMPLES evenly spaced items of the window are used
+  // (the oldest and the latest item are always included). x and y are relative to the current item.
+
+  const unsigned int numberOfItems = this->FilterContainersNumberOfValidElements;
+  unsigned int numberOfSamples = numberOfItems;
+  if (numberOfSamples > ROBUST_FILTERING_MAX_SAMPLES)
+  {
+    numberOfSamples = ROBUST_FILTERING_MAX_SAMPLES;
+  }
+  if (numberOfSamples < 2)
+  {
+    return false;
+  }
+
+  double x[ROBUST_FILTERING_MAX_SAMPLES];
+  double y[ROBUST_FILTERING_MAX_SAMPLES];
+  for (unsigned int sampleIndex = 0; sampleIndex < numberOfSamples; ++sampleIndex)
+  {
+    // Position of the sample in the window (0 = oldest), the window is full so the oldest item is at FilterContainersOldestIndex
+    unsigned int position = static_cast<unsigned int>(static_cast<unsigned long long>(sampleIndex) * (numberOfItems - 1) / (numberOfSamples - 1));
+    unsigned int containerIndex = (this->FilterContainersOldestIndex + position) % this->AveragedItemsForFiltering;
+    x[sampleIndex] = this->FilterContainerIndexVector(containerIndex) - static_cast<double>(itemIndex);
+    y[sampleIndex] = this->FilterContainerTimestampVector(containerIndex) - inUnfilteredTimestamp;
+  }
+
+  this->RobustFilteringSlopes.clear();
+  for (unsigned int i = 0; i < numberOfSamples; ++i)
+  {
+    for (unsigned int j = i + 1; j < numberOfSamples; ++j)
+    {
+      if (x[j] != x[i])
+      {
+        this->RobustFilteringSlopes.push_back((y[j] - y[i]) / (x[j] - x[i]));
+      }
+    }
+  }
+  if (this->RobustFilteringSlopes.empty())
+  {
+    return false;
+  }
+  double a = ComputeMedian(this->RobustFilteringSlopes);
+
+  this->RobustFilteringResiduals.clear();
+  for (unsigned int i = 0; i < numberOfSamples; ++i)
+  {
+    this->RobustFilteringResiduals.push_back(y[i] - a * x[i]);
+  }
+  double b = ComputeMedian(this->RobustFilteringResiduals);
+
+  // x = 0 for the current item
+  outFilteredTimestamp = inUnfilteredTimestamp + b;
+  return true;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusTimestampedCircularBuffer::GetTimeStampReportTable(vtkTable* timeStampReportTable)
 {
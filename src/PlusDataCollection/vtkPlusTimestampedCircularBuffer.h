@@ -10,7 +10,10 @@
 #include "PlusConfigure.h"
 #include "PlusStreamBufferItem.h"
 #include "vtkObject.h"
+#include <atomic>
 #include <deque>
+#include <memory>
+#include <vector>
 
 #include "vnl/vnl_matrix.h"
 #include "vnl/vnl_vector.h"
@@ -37,6 +40,13 @@ enum ItemStatus { ITEM_OK, ITEM_NOT_AVAILABLE_YET, ITEM_NOT_AVAILABLE_ANYMORE, I
 class vtkPlusTimestampedCircularBuffer: public vtkObject
 {
 public:
+  /*! Method for computing the filtered timestamps */
+  enum TimestampFilteringMethodType
+  {
+    TIMESTAMP_FILTERING_LINEAR_REGRESSION, /*!< Least squares line fit, sensitive to outliers (delayed items) */
+    TIMESTAMP_FILTERING_ROBUST_REGRESSION  /*!< Theil-Sen line fit on a decimated window, rejects outliers (delayed items) */
+  };
+
   static vtkPlusTimestampedCircularBuffer* New();
   void PrintSelf( ostream& os, vtkIndent indent );
 
@@ -45,7 +55,7 @@ public:
    video frames that it will hold.  The default is 30.
   */
   virtual PlusStatus SetBufferSize( int n );
-  virtual inline int GetBufferSize() { return this->BufferItemContainer.size(); };
+  virtual inline int GetBufferSize() { return this->LockFree ? this->LockFreeBufferSize.load( std::memory_order_acquire ) : this->BufferItemContainer.size(); };
 
   /*!
     Get the number of items in the list (this is not the same as
@@ -53,7 +63,42 @@ public:
     have been added to the list).  This will never be greater than
     the BufferSize.
   */
-  vtkGetMacro( NumberOfItems, int );
+  virtual int GetNumberOfItems();
+
+  /*!
+    Enable lock-free single producer/multiple consumer mode.
+    In this mode readers never take the buffer mutex. Each slot has a sequence number that is odd while the
+    producer is publishing an item into the slot and 2*UID when the item is complete. Readers validate
+    the sequence number before and after reading the slot header (timestamps, index, flags) and retry
+    if the read was torn. The item payload is published as an immutable reference-counted object,
+    which readers pin while copying it, so the producer never overwrites an item that is being read.
+    Only one thread may add items to the buffer at a time (the producer still takes the mutex).
+    Pinning an item uses std::atomic_load/std::atomic_exchange on std::shared_ptr. Standard libraries may implement
+    these with a small internal lock (libstdc++ uses a pool of spinlocks) that is only held while the reference is
+    updated, so readers never wait for the buffer mutex or for the producer copying an item, but the mode is not
+    lock-free in the strict sense.
+    Changing the buffer size replaces the slots: readers that access the slots meanwhile wait until the new slots
+    are in place (see LockFreeReadScope) and then find an empty buffer. Items that were pinned earlier remain valid.
+    Changing the mode clears the buffer, therefore it should only be done at configuration time.
+  */
+  virtual PlusStatus SetLockFree( bool lockFree );
+  vtkGetMacro( LockFree, bool );
+  vtkBooleanMacro( LockFree, bool );
+
+  /*!
+    Adapter that allows using igsioLockGuard for read-only access to the buffer.
+    It locks the buffer mutex only if the buffer is not in LockFree mode.
+  */
+  class ReaderLock
+  {
+  public:
+    ReaderLock( vtkPlusTimestampedCircularBuffer* buffer ) : Buffer( buffer ), Locked( false ) {}
+    void Lock() { this->Locked = !this->Buffer->GetLockFree(); if ( this->Locked ) { this->Buffer->Lock(); } }
+    void Unlock() { if ( this->Locked ) { this->Buffer->Unlock(); this->Locked = false; } }
+  protected:
+    vtkPlusTimestampedCircularBuffer* Buffer;
+    bool Locked;
+  };
 
   /*!
     Given a timestamp, compute the nearest frame UID
@@ -61,9 +106,21 @@ public:
   */
   virtual ItemStatus GetItemUidFromTime( const double time, BufferItemUidType& uid );
 
+  /*!
+    Given a timestamp, compute the nearest frame UID by stepping forward from the item searchStartUid.
+    Gives the same result as GetItemUidFromTime, but it is faster when items are requested for increasing times
+    that are close to each other, because only the items between the previous and the current result are visited.
+    If searchStartUid is not in the buffer or it was acquired after the requested time then a binary search is performed.
+  */
+  virtual ItemStatus GetItemUidFromTimeForward( const double time, const BufferItemUidType searchStartUid, BufferItemUidType& uid );
+
   /*! Get the most recent frame UID that is already in the buffer */
   virtual BufferItemUidType GetLatestItemUidInBuffer()
   {
+    if ( this->LockFree )
+    {
+      return this->PublishedLatestItemUid.load( std::memory_order_acquire );
+    }
     this->Lock();
     BufferItemUidType latestUid = this->LatestItemUid;
     this->Unlock();
@@ -73,6 +130,10 @@ public:
   /*! Get the oldest frame UID in the buffer  */
   virtual BufferItemUidType GetOldestItemUidInBuffer()
   {
+    if ( this->LockFree )
+    {
+      return this->GetPublishedOldestItemUid( this->PublishedLatestItemUid.load( std::memory_order_acquire ) );
+    }
     this->Lock();
     // LatestItemUid - ( NumberOfItems - 1 ) is the oldest element in the buffer
     BufferItemUidType oldestUid = this->LatestItemUid - ( this->NumberOfItems - 1 );
@@ -88,6 +149,16 @@ public:
 
   virtual ItemStatus GetOldestTimeStamp( double& timestamp )
   {
+    if ( this->LockFree )
+    {
+      // The oldest item may be overwritten at any moment, in that case the timestamp read fails and we retry with the new oldest item
+      ItemStatus status = ITEM_NOT_AVAILABLE_ANYMORE;
+      for ( int attempt = 0; attempt < LOCK_FREE_MAX_READ_ATTEMPTS && status == ITEM_NOT_AVAILABLE_ANYMORE; ++attempt )
+      {
+        status = this->GetTimeStamp( this->GetOldestItemUidInBuffer(), timestamp );
+      }
+      return status;
+    }
     // The oldest item may be removed from the buffer at any moment
     // therefore we need to retrieve its UID and timestamp within a single lock
     this->Lock();
@@ -166,14 +237,40 @@ public:
   */
   virtual ItemStatus GetBufferItemPointerFromUid( const BufferItemUidType uid, StreamBufferItem*& itemPtr );
 
+  /*!
+    Get a reference to a buffer item without locking the buffer (LockFree mode only).
+    The returned item is kept alive by the reference even if the slot is overwritten meanwhile.
+    The item is shared with other readers, therefore it must not be modified.
+  */
+  virtual ItemStatus PinBufferItemFromUid( const BufferItemUidType uid, std::shared_ptr<StreamBufferItem>& item );
+
+  /*!
+    Replace an already published item by a modified copy (LockFree mode only).
+    The caller must have locked the buffer (same as for adding a new item).
+  */
+  virtual ItemStatus ReplaceBufferItem( const BufferItemUidType uid, const std::shared_ptr<StreamBufferItem>& item );
+
+  /*!
+    Reserve the UID and buffer index for a new item.
+    INTERNAL USE ONLY! Need to lock buffer until the item is committed by CommitNewItem.
+  */
   virtual PlusStatus PrepareForNewItem( const double timestamp, BufferItemUidType& newFrameUid, int& bufferIndex );
 
+  /*!
+    Make the item that was filled after PrepareForNewItem visible to readers.
+    In LockFree mode the item is written into a staging item, which is published by this call.
+    In the default mode items are written in place, therefore this call has no effect.
+  */
+  virtual PlusStatus CommitNewItem( const int bufferIndex );
+
   /*!
     Create filtered and unfiltered timestamp for accurate timing of the buffer item.
     The timing may be inaccurate because the timestamp is attached to the item when Plus receives it
     and so the timestamp is affected by data transfer speed (which may slightly vary).
     A line is fitted to the index and timestamp of the last (AveragedItemsForFiltering) items.
     The filtered timestamp is the time value that corresponds to the frame index according to the fitted line.
+    The computation time does not depend on AveragedItemsForFiltering: the least squares fit is updated incrementally
+    and the robust fit uses a fixed number of items of the window.
     If the filtered timestamp is very different from the non-filtered timestamp then
     filteredTimestampProbablyValid will be false and it is recommended not to use that item,
     because its timestamp is probably incorrect.
@@ -201,6 +298,16 @@ public:
   /*! Get number of items used for timestamp filtering (with LSQR mimimizer) */
   vtkGetMacro( AveragedItemsForFiltering, int );
 
+  /*! Set method used for timestamp filtering. Default is TIMESTAMP_FILTERING_LINEAR_REGRESSION. */
+  vtkSetMacro( TimestampFilteringMethod, TimestampFilteringMethodType );
+  /*! Get method used for timestamp filtering */
+  vtkGetMacro( TimestampFilteringMethod, TimestampFilteringMethodType );
+
+  /*! Convert timestamp filtering method to string (LINEAR_REGRESSION or ROBUST_REGRESSION) */
+  static const char* GetTimestampFilteringMethodAsString( TimestampFilteringMethodType method );
+  /*! Convert string (LINEAR_REGRESSION or ROBUST_REGRESSION, case insensitive) to timestamp filtering method */
+  static PlusStatus GetTimestampFilteringMethodFromString( const char* methodString, TimestampFilteringMethodType& method );
+
   /*! Set recording start time */
   vtkSetMacro( StartTime, double );
   /*! Get recording start time */
@@ -210,6 +317,106 @@ protected:
   vtkPlusTimestampedCircularBuffer();
   ~vtkPlusTimestampedCircularBuffer();
 
+  /*! Maximum number of items of the filtering window that are used for the robust line fit */
+  static const unsigned int ROBUST_FILTERING_MAX_SAMPLES = 31;
+
+  /*! Maximum number of times a lock-free reader retries when the slot was modified while it was read */
+  static const int LOCK_FREE_MAX_READ_ATTEMPTS = 8;
+
+  /*! Slot of the buffer in LockFree mode */
+  struct LockFreeSlot
+  {
+    LockFreeSlot();
+    /*! 2*UID of the stored item if the slot is stable, odd number while the slot is being written */
+    std::atomic<BufferItemUidType> Sequence;
+    std::atomic<double> FilteredTimeStamp;
+    std::atomic<double> UnfilteredTimeStamp;
+    std::atomic<unsigned long> Index;
+    std::atomic<bool> ValidVideoData;
+    std::atomic<bool> ValidTransformData;
+    std::atomic<bool> ValidFieldData;
+    /*! Published item, it can be only accessed by std::atomic_load/atomic_store/atomic_exchange */
+    std::shared_ptr<StreamBufferItem> Item;
+  };
+
+  /*! Header of a lock-free slot that a reader copied out of the slot */
+  struct LockFreeSlotHeader
+  {
+    double FilteredTimeStamp;
+    double UnfilteredTimeStamp;
+    unsigned long Index;
+    bool ValidVideoData;
+    bool ValidTransformData;
+    bool ValidFieldData;
+  };
+
+  /*!
+    Marks a reader that accesses LockFreeSlots without locking the buffer. While any scope is active the slots
+    cannot be replaced, and while the slots are replaced no new scope can be entered (the constructor waits).
+    Readers must not access LockFreeSlots outside of a scope.
+  */
+  class LockFreeReadScope
+  {
+  public:
+    LockFreeReadScope( vtkPlusTimestampedCircularBuffer* buffer );
+    ~LockFreeReadScope();
+  protected:
+    vtkPlusTimestampedCircularBuffer* Buffer;
+  };
+
+  /*! Wait until no reader accesses the slots and block new readers. Caller must have locked the buffer. */
+  void BeginLockFreeSlotsChange();
+  /*! Allow readers to access the slots again, after BeginLockFreeSlotsChange */
+  void EndLockFreeSlotsChange();
+
+  /*! Get the slot that stores (or will store) the item with the given UID. Readers must be in a LockFreeReadScope. */
+  LockFreeSlot& GetLockFreeSlot( const BufferItemUidType uid ) { return *this->LockFreeSlots[( uid - 1 ) % this->LockFreeSlots.size()]; }
+
+  /*! Oldest UID in the buffer computed from the latest published UID */
+  BufferItemUidType GetPublishedOldestItemUid( const BufferItemUidType latestUid )
+  {
+    const BufferItemUidType bufferSize = this->LockFreeBufferSize.load( std::memory_order_acquire );
+    return ( latestUid > bufferSize ) ? latestUid - bufferSize + 1 : 1;
+  }
+
+  /*!
+    Read the header of the slot of the item with the given UID. The read is retried if the producer modified the slot meanwhile.
+    Returns ITEM_NOT_AVAILABLE_ANYMORE if the item has been overwritten.
+  */
+  ItemStatus ReadLockFreeSlotHeader( const BufferItemUidType uid, LockFreeSlotHeader& header );
+
+  /*! Read the header of a published item without locking the buffer */
+  ItemStatus GetLockFreeItemHeader( const BufferItemUidType uid, LockFreeSlotHeader& header );
+
+  /*! Lock-free implementation of GetItemUidFromTime */
+  ItemStatus GetLockFreeItemUidFromTime( const double time, BufferItemUidType& uid );
+
+  /*! Lock-free implementation of GetItemUidFromTimeForward */
+  ItemStatus GetLockFreeItemUidFromTimeForward( const double time, const BufferItemUidType searchStartUid, BufferItemUidType& uid );
+
+  /*! Filtered timestamp of an item that is in the buffer. Caller must have locked the buffer. */
+  double GetFilteredTimeStampOfItemInBuffer( const BufferItemUidType uid )
+  {
+    int bufferIndex = ( this->WritePointer - 1 ) - ( this->LatestItemUid - uid );
+    if ( bufferIndex < 0 )
+    {
+      bufferIndex += this->BufferItemContainer.size();
+    }
+    return this->BufferItemContainer[bufferIndex].GetFilteredTimestamp( this->LocalTimeOffsetSec );
+  }
+
+  /*! Create empty slots (discards all items). Caller must have locked the buffer. Waits for the readers that access the slots. */
+  void ResetLockFreeSlots( int bufferSize, bool keepItems );
+
+  /*! Recompute the running sums of the incremental least squares fit from the filter containers. Caller must have locked the buffer. */
+  void RecomputeFilterSums();
+
+  /*! Compute filtered timestamp by least squares line fit from the running sums. Returns false if the line cannot be determined. */
+  bool ComputeLinearRegressionFilteredTimeStamp( unsigned long itemIndex, double& outFilteredTimestamp );
+
+  /*! Compute filtered timestamp by Theil-Sen line fit on a decimated filtering window. Returns false if the line cannot be determined. */
+  bool ComputeRobustRegressionFilteredTimeStamp( unsigned long itemIndex, double inUnfilteredTimestamp, double& outFilteredTimestamp );
+
 protected:
   vtkIGSIORecursiveCriticalSection* Mutex;
 
@@ -231,6 +438,32 @@ protected:
 
   std::deque<StreamBufferItem> BufferItemContainer;
 
+  /*! If enabled then items are stored in LockFreeSlots and readers do not lock the buffer */
+  bool LockFree;
+
+  /*! Item storage in LockFree mode */
+  std::vector< std::unique_ptr<LockFreeSlot> > LockFreeSlots;
+
+  /*! Number of slots, it can be read without accessing LockFreeSlots */
+  std::atomic<int> LockFreeBufferSize;
+
+  /*! Number of readers in a LockFreeReadScope */
+  std::atomic<int> ActiveLockFreeReaders;
+
+  /*! Set while LockFreeSlots is replaced */
+  std::atomic<bool> LockFreeSlotsChanging;
+
+  /*! UID of the latest item that readers may access in LockFree mode */
+  std::atomic<BufferItemUidType> PublishedLatestItemUid;
+
+  /*! Item that the producer fills between PrepareForNewItem and CommitNewItem in LockFree mode */
+  std::shared_ptr<StreamBufferItem> StagedItem;
+  BufferItemUidType StagedItemUid;
+  int StagedBufferIndex;
+
+  /*! Items that have been replaced in their slots. They are reused for staging once no reader refers to them. */
+  std::vector< std::shared_ptr<StreamBufferItem> > RecycledItems;
+
   /*! Matrix used for storing the last number of AveragedItemsForFiltering frame index */
   vnl_vector<double> FilterContainerIndexVector;
 
@@ -246,6 +479,26 @@ protected:
   /*! Number of averaged items used for filtering - read from config files */
   unsigned int AveragedItemsForFiltering;
 
+  /*! Method used for computing the filtered timestamp from the items in the filter containers */
+  TimestampFilteringMethodType TimestampFilteringMethod;
+
+  /*!
+    Running sums of the valid elements of the filter containers for the incremental least squares fit.
+    Index and timestamp values are relative to FilterSumsReferenceIndex and FilterSumsReferenceTimestamp
+    to preserve precision. The sums are recomputed from the containers each time the containers are
+    filled over, so that rounding errors cannot accumulate.
+  */
+  double FilterSumX;
+  double FilterSumY;
+  double FilterSumXX;
+  double FilterSumXY;
+  double FilterSumsReferenceIndex;
+  double FilterSumsReferenceTimestamp;
+
+  /*! Preallocated work arrays for the robust line fit */
+  std::vector<double> RobustFilteringSlopes;
+  std::vector<double> RobustFilteringResiduals;
+
   /*!
     Maximum time difference that is allowed between filtered and the non-filtered timestamp (in seconds).
     If the filtered value differs too much from the non-filtered one, then it rejects the filtering result.
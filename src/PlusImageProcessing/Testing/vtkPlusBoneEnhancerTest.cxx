@@ -0,0 +1,249 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusBoneEnhancerTest.cxx
+  \brief Compares the fused processing mode of vtkPlusBoneEnhancer to the VTK filter chain reference mode
+
+  The input sequence is processed in both modes with the same parameters, one frame at a time.
+  The outputs are compared on the bone outline pixels only (pixels that are non-zero in either output),
+  as the background is zero in both modes and would hide any difference. The test fails if the reference
+  contains no outline pixels, or if the percentage of outline pixels that differ is larger than the allowed maximum.
+  The processing latency of each frame is measured and reported for both modes. Wall-clock latency depends on the load
+  of the machine, therefore it is only checked if a limit is specified (for manual benchmarking).
+*/
+
+#include "PlusConfigure.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusBoneEnhancer.h"
+#include <vtkPlusSequenceIO.h>
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <algorithm>
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <igsioVideoFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Processes the frames one by one and measures the latency of each frame.
+  // The first frame allocates the internal images, therefore it is not included in the latency statistics.
+  PlusStatus ProcessSequence(vtkIGSIOTrackedFrameList* inputFrames, vtkXMLDataElement* processorElement,
+                             vtkPlusBoneEnhancer::ProcessingModeType processingMode, vtkIGSIOTrackedFrameList* outputFrames,
+                             double& meanFrameTimeSec, double& maxFrameTimeSec)
+  {
+    vtkSmartPointer<vtkPlusBoneEnhancer> enhancer = vtkSmartPointer<vtkPlusBoneEnhancer>::New();
+    if (enhancer->ReadConfiguration(processorElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to read bone enhancer configuration");
+      return PLUS_FAIL;
+    }
+    enhancer->SetProcessingMode(processingMode);
+
+    meanFrameTimeSec = 0.0;
+    maxFrameTimeSec = 0.0;
+    int numberOfMeasuredFrames = 0;
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> singleFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    enhancer->SetInputFrames(singleFrameList);
+    for (unsigned int frameIndex = 0; frameIndex < inputFrames->GetNumberOfTrackedFrames(); ++frameIndex)
+    {
+      singleFrameList->Clear();
+      singleFrameList->AddTrackedFrame(inputFrames->GetTrackedFrame(frameIndex));
+
+      double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (enhancer->Update() != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Processing frame " << frameIndex << " failed");
+        return PLUS_FAIL;
+      }
+      double frameTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+      if (frameIndex > 0)
+      {
+        meanFrameTimeSec += frameTimeSec;
+        maxFrameTimeSec = std::max(maxFrameTimeSec, frameTimeSec);
+        ++numberOfMeasuredFrames;
+      }
+
+      if (outputFrames->AddTrackedFrameList(enhancer->GetOutputFrames()) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Unable to store output frame " << frameIndex);
+        return PLUS_FAIL;
+      }
+    }
+    if (numberOfMeasuredFrames > 0)
+    {
+      meanFrameTimeSec /= numberOfMeasuredFrames;
+    }
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  std::string inputFileName;
+  std::string inputConfigFileName;
+  double maxDifferentPixelPercent = 1.0;
+  double maxFusedToFilterChainTimeRatio = 0.0;
+  double maxFusedFrameTimeMs = 0.0;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help");
+  args.AddArgument("--input-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputFileName, "The filename for the input ultrasound sequence to process.");
+  args.AddArgument("--input-config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputConfigFileName, "The filename for input config file.");
+  args.AddArgument("--max-different-pixel-percent", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxDifferentPixelPercent, "Maximum allowed percentage of bone outline pixels that differ between the fused and filter chain modes (default: 1.0).");
+  args.AddArgument("--max-fused-to-filter-chain-time-ratio", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxFusedToFilterChainTimeRatio, "Maximum allowed ratio of the average frame latency of the fused mode and the filter chain mode. Not checked if 0 (default: 0).");
+  args.AddArgument("--max-fused-frame-time-ms", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxFusedFrameTimeMs, "Maximum allowed average frame latency of the fused mode in milliseconds. Not checked if 0 (default: 0).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (inputFileName.empty() || inputConfigFileName.empty())
+  {
+    LOG_ERROR("The arguments --input-seq-file and --input-config-file are required");
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> inputFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(inputFileName, inputFrames) == PLUS_FAIL)
+  {
+    LOG_ERROR("Unable to read input sequence " << inputFileName);
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(configRootElement, inputConfigFileName.c_str()) == PLUS_FAIL)
+  {
+    LOG_ERROR("Unable to read configuration from file " << inputConfigFileName);
+    exit(EXIT_FAILURE);
+  }
+  vtkXMLDataElement* processorElement = configRootElement->LookupElementWithName("Processor");
+  if (processorElement == NULL)
+  {
+    LOG_ERROR("Cannot find Processor element in configuration file " << inputConfigFileName);
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> referenceFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> fusedFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  double referenceFrameTimeSec = 0;
+  double referenceMaxFrameTimeSec = 0;
+  double fusedFrameTimeSec = 0;
+  double fusedMaxFrameTimeSec = 0;
+  if (ProcessSequence(inputFrames, processorElement, vtkPlusBoneEnhancer::PROCESSING_MODE_FILTER_CHAIN, referenceFrames, referenceFrameTimeSec, referenceMaxFrameTimeSec) != PLUS_SUCCESS
+      || ProcessSequence(inputFrames, processorElement, vtkPlusBoneEnhancer::PROCESSING_MODE_FUSED, fusedFrames, fusedFrameTimeSec, fusedMaxFrameTimeSec) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+
+  LOG_INFO("Frame latency - filter chain: " << referenceFrameTimeSec * 1000.0 << " ms average, " << referenceMaxFrameTimeSec * 1000.0 << " ms maximum; fused: "
+           << fusedFrameTimeSec * 1000.0 << " ms average, " << fusedMaxFrameTimeSec * 1000.0 << " ms maximum; speedup "
+           << (fusedFrameTimeSec > 0 ? referenceFrameTimeSec / fusedFrameTimeSec : 1.0) << "x");
+
+  int exitCode = EXIT_SUCCESS;
+  if (maxFusedToFilterChainTimeRatio > 0 && fusedFrameTimeSec > referenceFrameTimeSec * maxFusedToFilterChainTimeRatio)
+  {
+    LOG_ERROR("Average frame latency of the fused mode (" << fusedFrameTimeSec * 1000.0 << " ms) exceeds " << maxFusedToFilterChainTimeRatio
+              << " times the latency of the filter chain mode (" << referenceFrameTimeSec * 1000.0 << " ms)");
+    exitCode = EXIT_FAILURE;
+  }
+  if (maxFusedFrameTimeMs > 0 && fusedFrameTimeSec * 1000.0 > maxFusedFrameTimeMs)
+  {
+    LOG_ERROR("Average frame latency of the fused mode (" << fusedFrameTimeSec * 1000.0 << " ms) exceeds the allowed maximum (" << maxFusedFrameTimeMs << " ms)");
+    exitCode = EXIT_FAILURE;
+  }
+
+  if (referenceFrames->GetNumberOfTrackedFrames() != fusedFrames->GetNumberOfTrackedFrames())
+  {
+    LOG_ERROR("Number of output frames differ: " << referenceFrames->GetNumberOfTrackedFrames() << " (filter chain) vs. " << fusedFrames->GetNumberOfTrackedFrames() << " (fused)");
+    exit(EXIT_FAILURE);
+  }
+
+  int totalReferenceOutlinePixels = 0;
+  int totalOutlinePixels = 0;
+  int totalDifferentPixels = 0;
+  for (unsigned int frameIndex = 0; frameIndex < referenceFrames->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    vtkImageData* referenceImage = referenceFrames->GetTrackedFrame(frameIndex)->GetImageData()->GetImage();
+    vtkImageData* fusedImage = fusedFrames->GetTrackedFrame(frameIndex)->GetImageData()->GetImage();
+    int* referenceDims = referenceImage->GetDimensions();
+    int* fusedDims = fusedImage->GetDimensions();
+    if (referenceDims[0] != fusedDims[0] || referenceDims[1] != fusedDims[1]
+        || referenceImage->GetScalarType() != VTK_UNSIGNED_CHAR || fusedImage->GetScalarType() != VTK_UNSIGNED_CHAR)
+    {
+      LOG_ERROR("Frame " << frameIndex << ": output image size or type differ");
+      exitCode = EXIT_FAILURE;
+      continue;
+    }
+
+    const int numberOfPixels = referenceDims[0] * referenceDims[1];
+    const unsigned char* referencePtr = static_cast<unsigned char*>(referenceImage->GetScalarPointer());
+    const unsigned char* fusedPtr = static_cast<unsigned char*>(fusedImage->GetScalarPointer());
+    int numberOfReferenceOutlinePixels = 0;
+    int numberOfOutlinePixels = 0;
+    int numberOfDifferentPixels = 0;
+    for (int pixelIndex = 0; pixelIndex < numberOfPixels; ++pixelIndex)
+    {
+      if (referencePtr[pixelIndex] != 0)
+      {
+        ++numberOfReferenceOutlinePixels;
+      }
+      if (referencePtr[pixelIndex] != 0 || fusedPtr[pixelIndex] != 0)
+      {
+        ++numberOfOutlinePixels;
+      }
+      if (referencePtr[pixelIndex] != fusedPtr[pixelIndex])
+      {
+        ++numberOfDifferentPixels;
+      }
+    }
+    LOG_DEBUG("Frame " << frameIndex << ": " << numberOfDifferentPixels << " of " << numberOfOutlinePixels << " outline pixels differ");
+    totalReferenceOutlinePixels += numberOfReferenceOutlinePixels;
+    totalOutlinePixels += numberOfOutlinePixels;
+    totalDifferentPixels += numberOfDifferentPixels;
+  }
+
+  if (totalReferenceOutlinePixels == 0)
+  {
+    LOG_ERROR("The filter chain output contains no bone outline pixels, the outputs cannot be compared");
+    return EXIT_FAILURE;
+  }
+
+  double differentPixelPercent = 100.0 * totalDifferentPixels / totalOutlinePixels;
+  LOG_INFO(totalDifferentPixels << " of " << totalOutlinePixels << " outline pixels (" << differentPixelPercent << "%) differ between the fused and filter chain results");
+  if (differentPixelPercent > maxDifferentPixelPercent)
+  {
+    LOG_ERROR(differentPixelPercent << "% of the outline pixels differ between the fused and filter chain results (maximum allowed: " << maxDifferentPixelPercent << "%)");
+    exitCode = EXIT_FAILURE;
+  }
+
+  return exitCode;
+}
@@ -0,0 +1,145 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusRfToBrightnessConvertBenchmark.cxx
+  \brief Measures the throughput of real RF to brightness conversion with the different Hilbert transform and compression methods
+
+  A synthetic real RF frame is converted repeatedly with the FIR and FFT Hilbert transform, with exact and lookup
+  table based dynamic range compression. The time of the first conversion (which includes the FFT plan and lookup
+  table setup) is reported separately from the average time of the subsequent conversions.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusRfToBrightnessConvert.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cmath>
+#include <cstdlib>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*! Generate real RF data: sine wave modulated by a random envelope */
+  void GenerateRfData(vtkImageData* rfImage, int numberOfSamples, int numberOfScanlines)
+  {
+    rfImage->SetExtent(0, numberOfSamples - 1, 0, numberOfScanlines - 1, 0, 0);
+    rfImage->AllocateScalars(VTK_SHORT, 1);
+    short* rfPtr = static_cast<short*>(rfImage->GetScalarPointer());
+    srand(12345);
+    for (int scanline = 0; scanline < numberOfScanlines; ++scanline)
+    {
+      for (int sample = 0; sample < numberOfSamples; ++sample)
+      {
+        *(rfPtr++) = static_cast<short>((rand() % 4000) * sin(2 * vtkMath::Pi() * 0.12 * sample));
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunBenchmark(const std::string& name, vtkImageData* rfImage, vtkPlusRfToBrightnessConvert::HilbertTransformMethodType hilbertTransformMethod,
+                          bool useBrightnessLookupTable, int numberOfThreads, int numberOfRepetitions, double referenceFrameTimeSec, double& frameTimeSec)
+  {
+    vtkSmartPointer<vtkPlusRfToBrightnessConvert> converter = vtkSmartPointer<vtkPlusRfToBrightnessConvert>::New();
+    converter->SetImageType(US_IMG_RF_REAL);
+    converter->SetHilbertTransformMethod(hilbertTransformMethod);
+    converter->SetUseBrightnessLookupTable(useBrightnessLookupTable);
+    if (numberOfThreads > 0)
+    {
+      converter->SetNumberOfThreads(numberOfThreads);
+    }
+    converter->SetInputData(rfImage);
+
+    // First frame: includes FFT plan and lookup table setup
+    double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+    converter->Update();
+    double firstFrameTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+    if (converter->GetOutput()->GetScalarType() != VTK_UNSIGNED_CHAR)
+    {
+      LOG_ERROR(name << ": brightness conversion failed");
+      return PLUS_FAIL;
+    }
+
+    startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+    for (int repetition = 0; repetition < numberOfRepetitions; ++repetition)
+    {
+      // Force re-execution of the filter on the same input
+      converter->Modified();
+      converter->Update();
+    }
+    frameTimeSec = (vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec) / numberOfRepetitions;
+
+    int* dims = rfImage->GetDimensions();
+    double megaSamplesPerSec = (frameTimeSec > 0 ? dims[0] * dims[1] / frameTimeSec / 1e6 : 0.0);
+    LOG_INFO(name << ": first frame " << firstFrameTimeSec * 1000.0 << " ms, " << frameTimeSec * 1000.0 << " ms/frame, "
+             << megaSamplesPerSec << " MSamples/s, speedup " << (frameTimeSec > 0 && referenceFrameTimeSec > 0 ? referenceFrameTimeSec / frameTimeSec : 1.0) << "x");
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  int numberOfSamples = 2048;
+  int numberOfScanlines = 256;
+  int numberOfThreads = 0;
+  int numberOfRepetitions = 20;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help");
+  args.AddArgument("--number-of-samples", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfSamples, "Number of samples in a scanline (default: 2048).");
+  args.AddArgument("--number-of-scanlines", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfScanlines, "Number of scanlines (default: 256).");
+  args.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of threads (default: number of processors).");
+  args.AddArgument("--repetitions", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfRepetitions, "Number of times the frame is converted (default: 20).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (numberOfRepetitions < 1)
+  {
+    numberOfRepetitions = 1;
+  }
+
+  vtkSmartPointer<vtkImageData> rfImage = vtkSmartPointer<vtkImageData>::New();
+  GenerateRfData(rfImage, numberOfSamples, numberOfScanlines);
+  LOG_INFO("Converting " << numberOfScanlines << " scanlines of " << numberOfSamples << " samples (FFT length: "
+           << vtkPlusRfToBrightnessConvert::GetFftLength(numberOfSamples) << ") " << numberOfRepetitions << " times");
+
+  double referenceFrameTimeSec = 0;
+  double frameTimeSec = 0;
+  if (RunBenchmark("FIR Hilbert transform, exact compression (reference)", rfImage, vtkPlusRfToBrightnessConvert::HILBERT_TRANSFORM_FIR, false, numberOfThreads, numberOfRepetitions, 0, referenceFrameTimeSec) != PLUS_SUCCESS
+      || RunBenchmark("FIR Hilbert transform, lookup table compression", rfImage, vtkPlusRfToBrightnessConvert::HILBERT_TRANSFORM_FIR, true, numberOfThreads, numberOfRepetitions, referenceFrameTimeSec, frameTimeSec) != PLUS_SUCCESS
+      || RunBenchmark("FFT Hilbert transform, exact compression", rfImage, vtkPlusRfToBrightnessConvert::HILBERT_TRANSFORM_FFT, false, numberOfThreads, numberOfRepetitions, referenceFrameTimeSec, frameTimeSec) != PLUS_SUCCESS
+      || RunBenchmark("FFT Hilbert transform, lookup table compression", rfImage, vtkPlusRfToBrightnessConvert::HILBERT_TRANSFORM_FFT, true, numberOfThreads, numberOfRepetitions, referenceFrameTimeSec, frameTimeSec) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusRfToBrightnessConvertTest.cxx
+  \brief Compares the FFT-based envelope detection and the brightness lookup table of vtkPlusRfToBrightnessConvert to the FIR filter based computation
+
+  Synthetic real RF data (echoes of Gaussian pulses with noise) is converted to brightness with the FIR Hilbert transform
+  and exact dynamic range compression (reference). The FFT Hilbert transform result must be close to the reference
+  (the FIR filter is only an approximation of the Hilbert transform, so they are not identical), and the results
+  computed with the brightness lookup table must not differ by more than one gray level from the exact computation.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusRfToBrightnessConvert.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMath.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  /*! Generate real RF data: each scanline contains a few echoes of a Gaussian modulated sine pulse and uniform noise */
+  void GenerateRfData(vtkImageData* rfImage, int numberOfSamples, int numberOfScanlines)
+  {
+    rfImage->SetExtent(0, numberOfSamples - 1, 0, numberOfScanlines - 1, 0, 0);
+    rfImage->AllocateScalars(VTK_SHORT, 1);
+    short* rfPtr = static_cast<short*>(rfImage->GetScalarPointer());
+    srand(12345);
+    const double pulseFrequency = 0.12; // cycles per sample
+    const double pulseWidthSamples = 15.0;
+    const int numberOfEchoes = 6;
+    for (int scanline = 0; scanline < numberOfScanlines; ++scanline)
+    {
+      for (int sample = 0; sample < numberOfSamples; ++sample)
+      {
+        double envelope = 0.0;
+        for (int echo = 0; echo < numberOfEchoes; ++echo)
+        {
+          double echoPosition = (echo + 0.5) * numberOfSamples / numberOfEchoes + (scanline % 10) * 5;
+          double echoAmplitude = 3000.0 / (echo + 1);
+          envelope += echoAmplitude * exp(-(sample - echoPosition) * (sample - echoPosition) / (2 * pulseWidthSamples * pulseWidthSamples));
+        }
+        double noise = rand() % 200 - 100;
+        *(rfPtr++) = static_cast<short>(envelope * sin(2 * vtkMath::Pi() * pulseFrequency * sample) + noise);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus ConvertToBrightness(vtkImageData* rfImage, vtkPlusRfToBrightnessConvert::HilbertTransformMethodType hilbertTransformMethod,
+                                 bool useBrightnessLookupTable, std::vector<unsigned char>& brightness)
+  {
+    vtkSmartPointer<vtkPlusRfToBrightnessConvert> converter = vtkSmartPointer<vtkPlusRfToBrightnessConvert>::New();
+    converter->SetImageType(US_IMG_RF_REAL);
+    converter->SetHilbertTransformMethod(hilbertTransformMethod);
+    converter->SetUseBrightnessLookupTable(useBrightnessLookupTable);
+    converter->SetInputData(rfImage);
+    converter->Update();
+    vtkImageData* output = converter->GetOutput();
+    int* dims = output->GetDimensions();
+    int* inputDims = rfImage->GetDimensions();
+    if (output->GetScalarType() != VTK_UNSIGNED_CHAR || dims[0] != inputDims[0] || dims[1] != inputDims[1])
+    {
+      LOG_ERROR("Unexpected brightness image type or size");
+      return PLUS_FAIL;
+    }
+    unsigned char* outputPtr = static_cast<unsigned char*>(output->GetScalarPointer());
+    brightness.assign(outputPtr, outputPtr + dims[0] * dims[1]);
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Compute mean and maximum absolute difference of the samples in the [firstSample, lastSample] range of each scanline */
+  void GetDifference(const std::vector<unsigned char>& image1, const std::vector<unsigned char>& image2, int numberOfSamples,
+                     int firstSample, int lastSample, double& meanDifference, int& maxDifference)
+  {
+    double sumDifference = 0.0;
+    int numberOfComparedSamples = 0;
+    maxDifference = 0;
+    int numberOfScanlines = static_cast<int>(image1.size()) / numberOfSamples;
+    for (int scanline = 0; scanline < numberOfScanlines; ++scanline)
+    {
+      for (int sample = firstSample; sample <= lastSample; ++sample)
+      {
+        int difference = abs(image1[scanline * numberOfSamples + sample] - image2[scanline * numberOfSamples + sample]);
+        sumDifference += difference;
+        maxDifference = std::max(maxDifference, difference);
+        numberOfComparedSamples++;
+      }
+    }
+    meanDifference = (numberOfComparedSamples > 0 ? sumDifference / numberOfComparedSamples : 0.0);
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  int numberOfSamples = 1000;
+  int numberOfScanlines = 65;
+  double maxMeanDifference = 2.0;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help");
+  args.AddArgument("--number-of-samples", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfSamples, "Number of samples in a scanline (default: 1000).");
+  args.AddArgument("--number-of-scanlines", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfScanlines, "Number of scanlines (default: 65).");
+  args.AddArgument("--max-mean-difference", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxMeanDifference, "Maximum allowed mean difference between the FIR and FFT results (default: 2.0).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  vtkSmartPointer<vtkImageData> rfImage = vtkSmartPointer<vtkImageData>::New();
+  GenerateRfData(rfImage, numberOfSamples, numberOfScanlines);
+
+  std::vector<unsigned char> firExact;
+  std::vector<unsigned char> firLookupTable;
+  std::vector<unsigned char> fftExact;
+  std::vector<unsigned char> fftLookupTable;
+  if (ConvertToBrightness(rfImage, vtkPlusRfToBrightnessConvert::HILBERT_TRANSFORM_FIR, false, firExact) != PLUS_SUCCESS
+      || ConvertToBrightness(rfImage, vtkPlusRfToBrightnessConvert::HILBERT_TRANSFORM_FIR, true, firLookupTable) != PLUS_SUCCESS
+      || ConvertToBrightness(rfImage, vtkPlusRfToBrightnessConvert::HILBERT_TRANSFORM_FFT, false, fftExact) != PLUS_SUCCESS
+      || ConvertToBrightness(rfImage, vtkPlusRfToBrightnessConvert::HILBERT_TRANSFORM_FFT, true, fftLookupTable) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Brightness conversion failed");
+    exit(EXIT_FAILURE);
+  }
+
+  int exitCode = EXIT_SUCCESS;
+
+  // The FIR filter output is zero at the beginning and end of the scanlines, compare only the rest
+  vtkSmartPointer<vtkPlusRfToBrightnessConvert> defaultConverter = vtkSmartPointer<vtkPlusRfToBrightnessConvert>::New();
+  int firstValidSample = defaultConverter->GetNumberOfHilbertFilterCoeffs() / 2 + 1;
+  int lastValidSample = numberOfSamples - defaultConverter->GetNumberOfHilbertFilterCoeffs() / 2;
+  double meanDifference = 0;
+  int maxDifference = 0;
+  GetDifference(fftExact, firExact, numberOfSamples, firstValidSample, lastValidSample, meanDifference, maxDifference);
+  LOG_INFO("FFT vs. FIR Hilbert transform: mean difference = " << meanDifference << ", max difference = " << maxDifference);
+  if (meanDifference > maxMeanDifference)
+  {
+    LOG_ERROR("Mean difference between FFT and FIR Hilbert transform results (" << meanDifference << ") is larger than " << maxMeanDifference);
+    exitCode = EXIT_FAILURE;
+  }
+
+  GetDifference(firLookupTable, firExact, numberOfSamples, 0, numberOfSamples - 1, meanDifference, maxDifference);
+  LOG_INFO("Brightness lookup table vs. exact compression (FIR): mean difference = " << meanDifference << ", max difference = " << maxDifference);
+  if (maxDifference > 1)
+  {
+    LOG_ERROR("Brightness lookup table result differs from exact compression by " << maxDifference << " (FIR)");
+    exitCode = EXIT_FAILURE;
+  }
+
+  GetDifference(fftLookupTable, fftExact, numberOfSamples, 0, numberOfSamples - 1, meanDifference, maxDifference);
+  LOG_INFO("Brightness lookup table vs. exact compression (FFT): mean difference = " << meanDifference << ", max difference = " << maxDifference);
+  if (maxDifference > 1)
+  {
+    LOG_ERROR("Brightness lookup table result differs from exact compression by " << maxDifference << " (FFT)");
+    exitCode = EXIT_FAILURE;
+  }
+
+  return exitCode;
+}
@@ -0,0 +1,251 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusUsScanConvertCurvilinearBenchmark.cxx
+  \brief Measures the performance of curvilinear scan conversion and verifies the results of the optimized modes
+
+  The input is a scanline sequence and a configuration file (the same as the inputs of the ScanConvert tool).
+  The reference is double precision interpolation on a single thread (equivalent to the original implementation).
+  Multi-threaded double precision results must be identical to the reference, fixed-point results may differ by
+  at most one gray level. Interpolation table setup time is reported with and without the on-disk table cache.
+*/
+
+#include "PlusConfigure.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkPlusUsScanConvertCurvilinear.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// IGSIO includes
+#include <igsioTrackedFrame.h>
+#include <vtkIGSIOTrackedFrameList.h>
+
+// STL includes
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+  struct BenchmarkResult
+  {
+    BenchmarkResult() : TableSetupTimeSec(0), FrameTimeSec(0), TableLoadedFromCache(false) {}
+    double TableSetupTimeSec;
+    double FrameTimeSec;
+    bool TableLoadedFromCache;
+    /*! Scan converted images of all the input frames */
+    std::vector< std::vector<double> > Outputs;
+  };
+
+  //----------------------------------------------------------------------------
+  void GetImageValues(vtkImageData* image, std::vector<double>& values)
+  {
+    vtkIdType numberOfValues = image->GetNumberOfPoints() * image->GetNumberOfScalarComponents();
+    values.resize(numberOfValues);
+    for (vtkIdType i = 0; i < numberOfValues; ++i)
+    {
+      values[i] = image->GetPointData()->GetScalars()->GetComponent(i / image->GetNumberOfScalarComponents(), i % image->GetNumberOfScalarComponents());
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunScanConversion(vtkXMLDataElement* scanConversionElement, vtkIGSIOTrackedFrameList* inputFrameList,
+                               vtkPlusUsScanConvertCurvilinear::InterpolationModeType interpolationMode, int numberOfThreads,
+                               const std::string& cacheDirectory, int numberOfRepetitions, BenchmarkResult& result)
+  {
+    vtkSmartPointer<vtkPlusUsScanConvertCurvilinear> scanConverter = vtkSmartPointer<vtkPlusUsScanConvertCurvilinear>::New();
+    if (scanConverter->ReadConfiguration(scanConversionElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read scan conversion configuration");
+      return PLUS_FAIL;
+    }
+    scanConverter->SetInterpolationMode(interpolationMode);
+    scanConverter->SetInterpolationTableCacheDirectory(cacheDirectory);
+    if (numberOfThreads > 0)
+    {
+      scanConverter->SetNumberOfThreads(numberOfThreads);
+    }
+
+    // First frame: includes interpolation table setup
+    scanConverter->SetInputData(inputFrameList->GetTrackedFrame(0)->GetImageData()->GetImage());
+    scanConverter->Update();
+    result.TableSetupTimeSec = scanConverter->GetInterpolationTableSetupTimeSec();
+    result.TableLoadedFromCache = scanConverter->GetInterpolationTableLoadedFromCache();
+
+    const int numberOfFrames = inputFrameList->GetNumberOfTrackedFrames();
+    result.Outputs.resize(numberOfFrames);
+    double totalTimeSec = 0;
+    for (int repetition = 0; repetition < numberOfRepetitions; ++repetition)
+    {
+      for (int frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
+      {
+        scanConverter->SetInputData(inputFrameList->GetTrackedFrame(frameIndex)->GetImageData()->GetImage());
+        const double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+        scanConverter->Update();
+        totalTimeSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+        if (repetition == 0)
+        {
+          GetImageValues(scanConverter->GetOutput(), result.Outputs[frameIndex]);
+        }
+      }
+    }
+    result.FrameTimeSec = totalTimeSec / (numberOfRepetitions * numberOfFrames);
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns the maximum absolute difference between the outputs, or -1 if the image sizes are different */
+  double GetMaximumDifference(const BenchmarkResult& result, const BenchmarkResult& reference)
+  {
+    double maxDifference = 0;
+    if (result.Outputs.size() != reference.Outputs.size())
+    {
+      return -1;
+    }
+    for (size_t frameIndex = 0; frameIndex < result.Outputs.size(); ++frameIndex)
+    {
+      if (result.Outputs[frameIndex].size() != reference.Outputs[frameIndex].size())
+      {
+        return -1;
+      }
+      for (size_t i = 0; i < result.Outputs[frameIndex].size(); ++i)
+      {
+        maxDifference = std::max(maxDifference, fabs(result.Outputs[frameIndex][i] - reference.Outputs[frameIndex][i]));
+      }
+    }
+    return maxDifference;
+  }
+
+  //----------------------------------------------------------------------------
+  void PrintResult(const std::string& name, const BenchmarkResult& result, const BenchmarkResult& reference)
+  {
+    LOG_INFO(name << ": table setup " << result.TableSetupTimeSec * 1000.0 << " ms" << (result.TableLoadedFromCache ? " (loaded from cache)" : "")
+             << ", " << result.FrameTimeSec * 1000.0 << " ms/frame"
+             << ", speedup " << (result.FrameTimeSec > 0 ? reference.FrameTimeSec / result.FrameTimeSec : 0.0) << "x"
+             << ", max difference from reference " << GetMaximumDifference(result, reference));
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp = false;
+  std::string inputFileName;
+  std::string configFileName;
+  int numberOfThreads = 0;
+  int numberOfRepetitions = 5;
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help");
+  args.AddArgument("--input-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputFileName, "Sequence file containing the scanlines to scan convert.");
+  args.AddArgument("--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &configFileName, "Configuration file containing a curvilinear ScanConversion element.");
+  args.AddArgument("--number-of-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfThreads, "Number of threads used in multi-threaded modes (default: number of processors).");
+  args.AddArgument("--repetitions", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfRepetitions, "Number of times each frame is scan converted (default: 5).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Error parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    return EXIT_SUCCESS;
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (inputFileName.empty() || configFileName.empty())
+  {
+    std::cerr << "--input-seq-file and --config-file are required" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(configRootElement, configFileName.c_str()) == PLUS_FAIL)
+  {
+    LOG_ERROR("Unable to read configuration from file " << configFileName);
+    exit(EXIT_FAILURE);
+  }
+  vtkXMLDataElement* scanConversionElement = configRootElement->FindNestedElementWithName("ScanConversion");
+  if (scanConversionElement == NULL)
+  {
+    LOG_ERROR("Cannot find ScanConversion element in configuration file " << configFileName);
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> inputFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkPlusSequenceIO::Read(inputFileName, inputFrameList) != PLUS_SUCCESS || inputFrameList->GetNumberOfTrackedFrames() < 1)
+  {
+    LOG_ERROR("Failed to read scanlines from " << inputFileName);
+    exit(EXIT_FAILURE);
+  }
+
+  // Start with an empty cache directory
+  std::string cacheDirectory = vtkPlusConfig::GetInstance()->GetOutputPath("ScanConvertCurvilinearBenchmarkCache");
+  vtksys::SystemTools::RemoveADirectory(cacheDirectory);
+
+  BenchmarkResult reference;
+  BenchmarkResult doubleMultiThreaded;
+  BenchmarkResult fixedPointMultiThreaded;
+  BenchmarkResult cacheWrite;
+  BenchmarkResult cacheRead;
+  if (RunScanConversion(scanConversionElement, inputFrameList, vtkPlusUsScanConvertCurvilinear::INTERPOLATION_DOUBLE, 1, "", numberOfRepetitions, reference) != PLUS_SUCCESS
+      || RunScanConversion(scanConversionElement, inputFrameList, vtkPlusUsScanConvertCurvilinear::INTERPOLATION_DOUBLE, numberOfThreads, "", numberOfRepetitions, doubleMultiThreaded) != PLUS_SUCCESS
+      || RunScanConversion(scanConversionElement, inputFrameList, vtkPlusUsScanConvertCurvilinear::INTERPOLATION_FIXED_POINT, numberOfThreads, "", numberOfRepetitions, fixedPointMultiThreaded) != PLUS_SUCCESS
+      || RunScanConversion(scanConversionElement, inputFrameList, vtkPlusUsScanConvertCurvilinear::INTERPOLATION_FIXED_POINT, numberOfThreads, cacheDirectory, 1, cacheWrite) != PLUS_SUCCESS
+      || RunScanConversion(scanConversionElement, inputFrameList, vtkPlusUsScanConvertCurvilinear::INTERPOLATION_FIXED_POINT, numberOfThreads, cacheDirectory, 1, cacheRead) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Scan conversion failed");
+    exit(EXIT_FAILURE);
+  }
+
+  LOG_INFO("Scan converted " << inputFrameList->GetNumberOfTrackedFrames() << " frames " << numberOfRepetitions << " times");
+  PrintResult("Double precision, single thread (reference)", reference, reference);
+  PrintResult("Double precision, multi-threaded", doubleMultiThreaded, reference);
+  PrintResult("Fixed-point, multi-threaded", fixedPointMultiThreaded, reference);
+  PrintResult("Fixed-point, table computed and written to cache", cacheWrite, reference);
+  PrintResult("Fixed-point, table read from cache", cacheRead, reference);
+
+  int exitCode = EXIT_SUCCESS;
+  if (GetMaximumDifference(doubleMultiThreaded, reference) != 0)
+  {
+    LOG_ERROR("Multi-threaded double precision scan conversion result differs from the reference");
+    exitCode = EXIT_FAILURE;
+  }
+  double fixedPointDifference = GetMaximumDifference(fixedPointMultiThreaded, reference);
+  if (fixedPointDifference < 0 || fixedPointDifference > 1)
+  {
+    LOG_ERROR("Fixed-point scan conversion result differs from the reference by " << fixedPointDifference << " (maximum allowed difference is 1)");
+    exitCode = EXIT_FAILURE;
+  }
+  if (cacheWrite.TableLoadedFromCache || !cacheRead.TableLoadedFromCache)
+  {
+    LOG_ERROR("Interpolation table cache is not used as expected");
+    exitCode = EXIT_FAILURE;
+  }
+  if (GetMaximumDifference(cacheRead, fixedPointMultiThreaded) != 0 || GetMaximumDifference(cacheWrite, fixedPointMultiThreaded) != 0)
+  {
+    LOG_ERROR("Scan conversion result with cached interpolation table differs from the result with computed table");
+    exitCode = EXIT_FAILURE;
+  }
+
+  return exitCode;
+}
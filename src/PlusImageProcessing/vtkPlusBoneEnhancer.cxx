@@ -26,7 +26,9 @@ See License.txt for details.
 #include <vtkIGSIOTrackedFrameList.h>
 
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 //----------------------------------------------------------------------------
 vtkStandardNewMacro(vtkPlusBoneEnhancer);
@@ -58,8 +60,10 @@ vtkPlusBoneEnhancer::vtkPlusBoneEnhancer()
   LinesImage(NULL),
   ProcessedLinesImage(NULL),
   FirstFrame(true),
+  ProcessingMode(PROCESSING_MODE_FILTER_CHAIN),
 
-  SaveIntermediateResults(false)
+  SaveIntermediateResults(false),
+  LinesImageSampleOffsetsNumberOfComponents(0)
 {
 
   this->GaussianSmooth = vtkSmartPointer<vtkImageGaussianSmooth>::New();    // Used to smooth the image
@@ -104,6 +108,14 @@ vtkPlusBoneEnhancer::vtkPlusBoneEnhancer()
   this->LinesImage->SetExtent(0, 0, 0, 0, 0, 0);
   this->ProcessedLinesImage->SetExtent(0, 0, 0, 0, 0, 0);
 
+  // Intermediate images of the fused processing mode, allocated in ProcessImageExtents
+  this->ThresholdedLinesImage = vtkSmartPointer<vtkImageData>::New();
+  this->SmoothedLinesImage = vtkSmartPointer<vtkImageData>::New();
+  this->EdgeBinaryImage = vtkSmartPointer<vtkImageData>::New();
+  this->ErodedImage = vtkSmartPointer<vtkImageData>::New();
+  this->FanImage = vtkSmartPointer<vtkImageData>::New();
+  std::fill(this->LinesImageSampleOffsetsInputExtent, this->LinesImageSampleOffsetsInputExtent + 6, 0);
+
   this->IntermediateImageMap.clear();
 }
 
@@ -119,6 +131,7 @@ vtkPlusBoneEnhancer::~vtkPlusBoneEnhancer()
 void vtkPlusBoneEnhancer::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "ProcessingMode: " << (this->ProcessingMode == PROCESSING_MODE_FILTER_CHAIN ? "FILTER_CHAIN" : "FUSED") << std::endl;
 }
 
 //----------------------------------------------------------------------------
@@ -240,9 +253,14 @@ PlusStatus vtkPlusBoneEnhancer::ReadConfiguration(vtkSmartPointer<vtkXMLDataElem
   XML_READ_SCALAR_ATTRIBUTE_REQUIRED(int, NumberOfScanLines, processingElement);
   XML_READ_SCALAR_ATTRIBUTE_REQUIRED(int, NumberOfSamplesPerScanLine, processingElement);
 
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(ProcessingMode, processingElement, "FUSED", PROCESSING_MODE_FUSED, "FILTER_CHAIN", PROCESSING_MODE_FILTER_CHAIN);
+
   int rfImageExtent[6] = { 0, this->NumberOfSamplesPerScanLine - 1, 0, this->NumberOfScanLines - 1, 0, 0 };
   this->ScanConverter->SetInputImageExtent(rfImageExtent);
 
+  // Scan line geometry may have changed, sample positions have to be recomputed
+  this->LinesImageSampleOffsets.clear();
+
   return PLUS_SUCCESS;
 }
 
@@ -256,6 +274,14 @@ PlusStatus vtkPlusBoneEnhancer::WriteConfiguration(vtkSmartPointer<vtkXMLDataEle
   processingElement->SetAttribute("Type", this->GetProcessorTypeName());
   processingElement->SetIntAttribute("NumberOfScanLines", NumberOfScanLines);
   processingElement->SetIntAttribute("NumberOfSamplesPerScanLine", NumberOfSamplesPerScanLine);
+  if (this->ProcessingMode == PROCESSING_MODE_FUSED)
+  {
+    processingElement->SetAttribute("ProcessingMode", "FUSED");
+  }
+  else
+  {
+    XML_REMOVE_ATTRIBUTE("ProcessingMode", processingElement);
+  }
 
   XML_FIND_NESTED_ELEMENT_CREATE_IF_MISSING(scanConversionElement, processingElement, "ScanConversion");
   this->ScanConverter->WriteConfiguration(scanConversionElement);
@@ -307,6 +333,21 @@ PlusStatus vtkPlusBoneEnhancer::ProcessImageExtents()
   int dims[3] = { 0, 0, 0 };
   this->LinesImage->GetDimensions(dims);
 
+  // Intermediate images and work buffers of the fused processing mode
+  vtkImageData* fusedImages[] = { this->ThresholdedLinesImage, this->SmoothedLinesImage, this->EdgeBinaryImage, this->ErodedImage, this->ConversionImage };
+  for (unsigned int imageIndex = 0; imageIndex < sizeof(fusedImages) / sizeof(fusedImages[0]); ++imageIndex)
+  {
+    fusedImages[imageIndex]->SetExtent(linesImageExtent);
+    fusedImages[imageIndex]->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+  }
+  const int numberOfPixels = dims[0] * dims[1];
+  this->SmoothingBuffer.resize(numberOfPixels);
+  this->SmoothingRowSums.resize(dims[0]);
+  this->MorphologyPrefixCounts.resize((dims[0] + 1) * dims[1]);
+  this->IslandVisited.resize(numberOfPixels);
+  this->IslandPixels.clear();
+  this->IslandPixels.reserve(numberOfPixels);
+
   return PLUS_SUCCESS;
 }
 
@@ -363,6 +404,64 @@ void vtkPlusBoneEnhancer::FillLinesImage(vtkSmartPointer<vtkImageData> inputImag
   }
 }
 
+//----------------------------------------------------------------------------
+// Fills the lines image by a single lookup for each pixel. Input pixel offsets are
+// computed along the scan lines the same way as in FillLinesImage, only when the
+// input image geometry changes.
+void vtkPlusBoneEnhancer::FillLinesImageFused(vtkImageData* inputImageData)
+{
+  int* linesImageExtent = this->ScanConverter->GetInputImageExtent();
+  int lineLengthPx = linesImageExtent[1] - linesImageExtent[0] + 1;
+  int numScanLines = linesImageExtent[3] - linesImageExtent[2] + 1;
+
+  int* inputExtent = inputImageData->GetExtent();
+  int numberOfComponents = inputImageData->GetNumberOfScalarComponents();
+  if (this->LinesImageSampleOffsets.size() != static_cast<size_t>(lineLengthPx * numScanLines)
+      || !std::equal(inputExtent, inputExtent + 6, this->LinesImageSampleOffsetsInputExtent)
+      || numberOfComponents != this->LinesImageSampleOffsetsNumberOfComponents)
+  {
+    this->LinesImageSampleOffsets.resize(lineLengthPx * numScanLines);
+    std::copy(inputExtent, inputExtent + 6, this->LinesImageSampleOffsetsInputExtent);
+    this->LinesImageSampleOffsetsNumberOfComponents = numberOfComponents;
+
+    vtkIdType increments[3] = { 0, 0, 0 };
+    inputImageData->GetIncrements(increments);
+    int* offset = &this->LinesImageSampleOffsets[0];
+    for (int scanLine = 0; scanLine < numScanLines; ++scanLine)
+    {
+      double start[4] = { 0, 0, 0, 0 };
+      double end[4] = { 0, 0, 0, 0 };
+      ScanConverter->GetScanLineEndPoints(scanLine, start, end);
+
+      double directionVectorX = static_cast<double>(end[0] - start[0]) / (lineLengthPx - 1);
+      double directionVectorY = static_cast<double>(end[1] - start[1]) / (lineLengthPx - 1);
+      for (int pointIndex = 0; pointIndex < lineLengthPx; ++pointIndex, ++offset)
+      {
+        int pixelCoordX = start[0] + directionVectorX * pointIndex;
+        int pixelCoordY = start[1] + directionVectorY * pointIndex;
+        if (pixelCoordX < inputExtent[0] || pixelCoordX > inputExtent[1]
+            || pixelCoordY < inputExtent[2] || pixelCoordY > inputExtent[3])
+        {
+          *offset = -1; // outside of the specified extent
+          continue;
+        }
+        *offset = static_cast<int>((pixelCoordX - inputExtent[0]) * increments[0]
+                                   + (pixelCoordY - inputExtent[2]) * increments[1]
+                                   + (0 - inputExtent[4]) * increments[2]);
+      }
+    }
+  }
+
+  const unsigned char* inputPtr = static_cast<unsigned char*>(inputImageData->GetScalarPointer());
+  unsigned char* linesPtr = static_cast<unsigned char*>(this->LinesImage->GetScalarPointer());
+  const int* offsets = &this->LinesImageSampleOffsets[0];
+  const int numberOfPixels = lineLengthPx * numScanLines;
+  for (int pixelIndex = 0; pixelIndex < numberOfPixels; ++pixelIndex)
+  {
+    linesPtr[pixelIndex] = (offsets[pixelIndex] < 0 ? 0 : inputPtr[offsets[pixelIndex]]);
+  }
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusBoneEnhancer::VectorImageToUchar(vtkSmartPointer<vtkImageData> inputImage)
 {
@@ -401,7 +500,12 @@ void vtkPlusBoneEnhancer::MarkShadowOutline(vtkSmartPointer<vtkImageData> inputI
 {
   int dims[3] = { 0, 0, 0 };
   inputImage->GetDimensions(dims);
+  this->MarkShadowOutline(static_cast<unsigned char*>(inputImage->GetScalarPointer()), dims);
+}
 
+//----------------------------------------------------------------------------
+void vtkPlusBoneEnhancer::MarkShadowOutline(unsigned char* imagePtr, int dims[3])
+{
   int keepInfoCounter;
   bool foundBone;
   unsigned char* vOutput;
@@ -423,9 +527,10 @@ void vtkPlusBoneEnhancer::MarkShadowOutline(vtkSmartPointer<vtkImageData> inputI
     keepInfoCounter = this->BoneOutlineDepthPx + this->BonePushBackPx;
     foundBone = false;
 
+    unsigned char* rowPtr = imagePtr + y * dims[0];
     for (int x = dims[0] - 1; x >= 0; --x)
     {
-      vOutput = static_cast<unsigned char*>(inputImage->GetScalarPointer(x, y, 0));
+      vOutput = rowPtr + x;
 
       //If an image is detected
       if (*vOutput != 0)
@@ -530,65 +635,64 @@ void vtkPlusBoneEnhancer::MarkShadowOutline(vtkSmartPointer<vtkImageData> inputI
 //a way of threasholding based on the standard deviation of a row
 void vtkPlusBoneEnhancer::ThresholdViaStdDeviation(vtkSmartPointer<vtkImageData> inputImage)
 {
-  int fatLayerToCut = 20; //The area of fat too close to the transducer should not be considered
-
-  float vInput = 0;
-  unsigned char* vOutput = 0;
-
   int dims[3] = { 0, 0, 0 };
   inputImage->GetDimensions(dims);
+  unsigned char* imagePtr = static_cast<unsigned char*>(inputImage->GetScalarPointer());
 
-  int max;
-
-  //values used to calculate the standard deviation
-  int pixelSum;
-  int squearSum;
-  float pixelAverage;
-  float meanDiffSum;
-  float meanDiffAverage;
-  float thresholdValue;
-
+  float thresholdValue = 0;
   for (int y = dims[1] - 1; y >= 0; --y)
   {
-    max = 0;
-
-    pixelSum = 0;
-    squearSum = 0;
-    pixelAverage = 0;
+    unsigned char* rowPtr = imagePtr + y * dims[0];
 
-    //determine the average, sum, and max of the row
-    for (int x = dims[0] - 1; x >= fatLayerToCut; --x)
+    //if a pixel's value is too low, remove it
+    if (GetStdDeviationThreshold(rowPtr, dims[0], thresholdValue))
     {
-      vInput = inputImage->GetScalarComponentAsFloat(x, y, 0, 0);
-      pixelSum += vInput;
-      squearSum += vInput * vInput;
-
-      if (vInput > max)
+      for (int x = dims[0] - 1; x >= 0; --x)
       {
-        max = vInput;
+        if (rowPtr[x] < thresholdValue && rowPtr[x] != 0)
+        {
+          rowPtr[x] = 0;
+        }
       }
     }
-    pixelAverage = pixelSum / (dims[0] - fatLayerToCut);
+  }
+}
 
-    //determine the standard deviation of the row
-    meanDiffSum = squearSum + (dims[0] - fatLayerToCut) * pixelAverage * pixelAverage + (-2 * pixelAverage * pixelSum);
-    meanDiffAverage = meanDiffSum / (dims[0] - fatLayerToCut);
-    thresholdValue = max - 3 * pow(meanDiffAverage, 0.5f);
+//----------------------------------------------------------------------------
+bool vtkPlusBoneEnhancer::GetStdDeviationThreshold(const unsigned char* row, int rowLength, float& thresholdValue)
+{
+  int fatLayerToCut = 20; //The area of fat too close to the transducer should not be considered
 
+  float vInput = 0;
+  int max = 0;
 
-    //if a pixel's value is too low, remove it
-    if (pixelSum != 0)
+  //values used to calculate the standard deviation
+  int pixelSum = 0;
+  int squearSum = 0;
+  float pixelAverage = 0;
+  float meanDiffSum;
+  float meanDiffAverage;
+
+  //determine the average, sum, and max of the row
+  for (int x = rowLength - 1; x >= fatLayerToCut; --x)
+  {
+    vInput = row[x];
+    pixelSum += vInput;
+    squearSum += vInput * vInput;
+
+    if (vInput > max)
     {
-      for (int x = dims[0] - 1; x >= 0; --x)
-      {
-        vOutput = static_cast<unsigned char*>(inputImage->GetScalarPointer(x, y, 0));
-        if (*vOutput < thresholdValue && *vOutput != 0)
-        {
-          *vOutput = 0;
-        }
-      }
+      max = vInput;
     }
   }
+  pixelAverage = pixelSum / (rowLength - fatLayerToCut);
+
+  //determine the standard deviation of the row
+  meanDiffSum = squearSum + (rowLength - fatLayerToCut) * pixelAverage * pixelAverage + (-2 * pixelAverage * pixelSum);
+  meanDiffAverage = meanDiffSum / (rowLength - fatLayerToCut);
+  thresholdValue = max - 3 * pow(meanDiffAverage, 0.5f);
+
+  return pixelSum != 0;
 }
 
 //----------------------------------------------------------------------------
@@ -625,12 +729,27 @@ void vtkPlusBoneEnhancer::ImageConjunction(vtkSmartPointer<vtkImageData> InputIm
 // Processes a given frame and marks potential bone areas.
 PlusStatus vtkPlusBoneEnhancer::ProcessFrame(igsioTrackedFrame* inputFrame, igsioTrackedFrame* outputFrame)
 {
-  //Process the input into a linear image
-  vtkSmartPointer<vtkImageData> intermediateImage = this->UnprocessedFrameToLinearImage(inputFrame);
-  //Remove noise and mark all possible bones
-  this->RemoveNoise(intermediateImage);
+  if (this->ProcessingMode == PROCESSING_MODE_FILTER_CHAIN)
+  {
+    //Process the input into a linear image
+    vtkSmartPointer<vtkImageData> intermediateImage = this->UnprocessedFrameToLinearImage(inputFrame);
+    //Remove noise and mark all possible bones
+    this->RemoveNoise(intermediateImage);
+    //Reconvert the image back into a fan-image and return it
+    this->LinearToFanImage(intermediateImage, outputFrame);
+    return PLUS_SUCCESS;
+  }
+
+  // Fused mode: the lines image and the bone outline are computed in preallocated images without copying
+  this->UpdateLinesImage(inputFrame);
+  this->ComputeBoneOutline(this->LinesImage);
+
   //Reconvert the image back into a fan-image and return it
-  this->LinearToFanImage(intermediateImage, outputFrame);
+  this->ProcessedLinesImage->ShallowCopy(this->BinaryImageForMorphology);
+  this->ScanConverter->SetInputData(this->ProcessedLinesImage);
+  this->ScanConverter->SetOutput(this->FanImage);
+  this->ScanConverter->Update();
+  outputFrame->GetImageData()->DeepCopyFrom(this->FanImage);
   return PLUS_SUCCESS;
 }
 
@@ -651,7 +770,20 @@ void vtkPlusBoneEnhancer::LinearToFanImage(vtkSmartPointer<vtkImageData> inputIm
 // takes an unprocessed frame image and returns it as a linear image
 vtkSmartPointer<vtkImageData> vtkPlusBoneEnhancer::UnprocessedFrameToLinearImage(igsioTrackedFrame* inputFrame)
 {
-  if (this->FirstFrame == true)
+  this->UpdateLinesImage(inputFrame);
+
+  //an image used to transport output between filters
+  vtkSmartPointer<vtkImageData> intermediateImage = vtkSmartPointer<vtkImageData>::New();
+  intermediateImage->DeepCopy(this->LinesImage);
+
+  return intermediateImage;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBoneEnhancer::UpdateLinesImage(igsioTrackedFrame* inputFrame)
+{
+  int* linesImageExtent = this->ScanConverter->GetInputImageExtent();
+  if (this->FirstFrame == true || !std::equal(linesImageExtent, linesImageExtent + 6, this->LinesImage->GetExtent()))
   {
     //set up variables for future loops
     this->ProcessImageExtents();
@@ -660,8 +792,6 @@ vtkSmartPointer<vtkImageData> vtkPlusBoneEnhancer::UnprocessedFrameToLinearImage
   this->BoneAreasInfo.clear();
 
   igsioVideoFrame* inputImage = inputFrame->GetImageData();
-  //an image used to transport output between filters
-  vtkSmartPointer<vtkImageData> intermediateImage = vtkSmartPointer<vtkImageData>::New();
 
   //Convert the image to a readable non-fan image
   this->ScanConverter->SetInputData(inputImage->GetImage());
@@ -670,22 +800,65 @@ vtkSmartPointer<vtkImageData> vtkPlusBoneEnhancer::UnprocessedFrameToLinearImage
   {
     this->AddIntermediateFromFilter("_01Lines_1PreFillLines", this->ScanConverter);
   }
-  this->FillLinesImage(inputImage->GetImage());
+  if (this->ProcessingMode == PROCESSING_MODE_FUSED && inputImage->GetImage()->GetScalarType() == VTK_UNSIGNED_CHAR)
+  {
+    this->FillLinesImageFused(inputImage->GetImage());
+  }
+  else
+  {
+    this->FillLinesImage(inputImage->GetImage());
+  }
+  this->LinesImage->Modified();
   if (this->SaveIntermediateResults)
   {
     this->AddIntermediateImage("_01Lines_2FilterEnd", this->LinesImage);
   }
-  intermediateImage->DeepCopy(this->LinesImage);
-
-  return intermediateImage;
 }
 
 //----------------------------------------------------------------------------
-// Takes an Ultrasound image and removes all noise, then marks all potential 
+// Takes an Ultrasound image and removes all noise, then marks all potential
 // bone areas using a white outline.
 void vtkPlusBoneEnhancer::RemoveNoise(vtkSmartPointer<vtkImageData> inputImage)
 {
+  this->ComputeBoneOutline(inputImage);
+  inputImage->DeepCopy(this->BinaryImageForMorphology);
+}
 
+//----------------------------------------------------------------------------
+void vtkPlusBoneEnhancer::ComputeBoneOutline(vtkImageData* linesImage)
+{
+  // The fused implementation works on the preallocated unsigned char images of the lines image size
+  int* linesImageExtent = this->LinesImage->GetExtent();
+  if (this->ProcessingMode == PROCESSING_MODE_FUSED
+      && linesImage->GetScalarType() == VTK_UNSIGNED_CHAR
+      && linesImage->GetNumberOfScalarComponents() == 1
+      && std::equal(linesImageExtent, linesImageExtent + 6, linesImage->GetExtent()))
+  {
+    this->RemoveNoiseFused(linesImage);
+  }
+  else
+  {
+    this->RemoveNoiseFilterChain(linesImage);
+  }
+
+  //Detect each possible bone area, then subject it to various tests to confirm if it is valid
+  this->MarkShadowOutline(this->BinaryImageForMorphology);
+  this->BinaryImageForMorphology->Modified();
+  if (this->SaveIntermediateResults)
+  {
+    this->AddIntermediateImage("_09PostFilters_1ShadowOutline", this->BinaryImageForMorphology);
+  }
+
+  // Save all stored intermediate images to mha files in output
+  if (this->SaveIntermediateResults)
+  {
+    this->SaveAllIntermediateResultsToFile();
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBoneEnhancer::RemoveNoiseFilterChain(vtkImageData* inputImage)
+{
   //Threashold the image based on the standard deviation of a pixel's columns
   this->ThresholdViaStdDeviation(inputImage);
   if (this->SaveIntermediateResults)
@@ -741,21 +914,392 @@ void vtkPlusBoneEnhancer::RemoveNoise(vtkSmartPointer<vtkImageData> inputImage)
   {
     this->AddIntermediateImage("_08Dilation_1FilterEnd", this->BinaryImageForMorphology);
   }
+}
 
-  //Detect each possible bone area, then subject it to various tests to confirm if it is valid
-  this->MarkShadowOutline(this->BinaryImageForMorphology);
+//----------------------------------------------------------------------------
+// Same steps as RemoveNoiseFilterChain, each implemented as a single pass over
+// preallocated images. Sobel edge detection, conversion to unsigned char and
+// binarization are combined into one pass.
+void vtkPlusBoneEnhancer::RemoveNoiseFused(vtkImageData* linesImage)
+{
+  int dims[3] = { 0, 0, 0 };
+  linesImage->GetDimensions(dims);
+  const int width = dims[0];
+  const int height = dims[1];
+
+  //Threashold the image based on the standard deviation of a pixel's columns, while copying it
+  const unsigned char* linesPtr = static_cast<unsigned char*>(linesImage->GetScalarPointer());
+  unsigned char* thresholdedPtr = static_cast<unsigned char*>(this->ThresholdedLinesImage->GetScalarPointer());
+  float thresholdValue = 0;
+  for (int y = 0; y < height; ++y)
+  {
+    const unsigned char* inputRow = linesPtr + y * width;
+    unsigned char* outputRow = thresholdedPtr + y * width;
+    if (GetStdDeviationThreshold(inputRow, width, thresholdValue))
+    {
+      for (int x = 0; x < width; ++x)
+      {
+        outputRow[x] = (inputRow[x] < thresholdValue ? 0 : inputRow[x]);
+      }
+    }
+    else
+    {
+      memcpy(outputRow, inputRow, width);
+    }
+  }
   if (this->SaveIntermediateResults)
   {
-    this->AddIntermediateImage("_09PostFilters_1ShadowOutline", this->BinaryImageForMorphology);
+    this->AddIntermediateImage("_02Threshold_1FilterEnd", this->ThresholdedLinesImage);
   }
 
-  // Save all stored intermediate images to mha files in output
+  //Use gaussian smoothing
+  this->GaussianSmoothFused(this->ThresholdedLinesImage, this->SmoothedLinesImage);
   if (this->SaveIntermediateResults)
   {
-    this->SaveAllIntermediateResultsToFile();
+    this->AddIntermediateImage("_03Gaussian_1FilterEnd", this->SmoothedLinesImage);
+  }
+
+  //Edge detection and binarization. Edge image is only needed if intermediate results are saved.
+  this->EdgeDetectAndBinarizeFused(this->SmoothedLinesImage, this->EdgeBinaryImage, this->SaveIntermediateResults ? this->ConversionImage.GetPointer() : NULL);
+  if (this->SaveIntermediateResults)
+  {
+    this->AddIntermediateImage("_04EdgeDetector_1FilterEnd", this->ConversionImage);
+    this->AddIntermediateImage("_05BinaryImageForMorphology_1FilterEnd", this->EdgeBinaryImage);
+  }
+
+  //Remove small clusters of pixels
+  this->RemoveIslandsFused(this->EdgeBinaryImage);
+  if (this->SaveIntermediateResults)
+  {
+    this->AddIntermediateImage("_06Island_1FilterEnd", this->EdgeBinaryImage);
+  }
+
+  //Erode the image
+  this->DilateErodeFused(this->EdgeBinaryImage, this->ErodedImage, this->ErosionKernelSize, 255, 0);
+  if (this->SaveIntermediateResults)
+  {
+    this->AddIntermediateImage("_07Erosion_1FilterEnd", this->ErodedImage);
+  }
+
+  //Dilate the image
+  this->DilateErodeFused(this->ErodedImage, this->BinaryImageForMorphology, this->DilationKernelSize, 0, 255);
+  if (this->SaveIntermediateResults)
+  {
+    this->AddIntermediateImage("_08Dilation_1FilterEnd", this->BinaryImageForMorphology);
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBoneEnhancer::UpdateGaussianKernelTable(GaussianKernelTable& table, int length, double stdDev, int radius)
+{
+  if (table.Length == length && table.StdDev == stdDev && table.Radius == radius)
+  {
+    return;
+  }
+  table.Length = length;
+  table.StdDev = stdDev;
+  table.Radius = radius;
+  table.Weights.clear();
+  table.WeightsOffset.resize(length);
+  table.FirstTap.resize(length);
+  table.NumberOfTaps.resize(length);
+
+  // The kernel is truncated at the image boundaries and normalized over the remaining taps,
+  // as in vtkImageGaussianSmooth. All positions in the interior share the same kernel.
+  int interiorWeightsOffset = -1;
+  for (int position = 0; position < length; ++position)
+  {
+    int firstTap = std::max(-radius, -position);
+    int lastTap = std::min(radius, length - 1 - position);
+    table.FirstTap[position] = firstTap;
+    table.NumberOfTaps[position] = lastTap - firstTap + 1;
+    bool interior = (firstTap == -radius && lastTap == radius);
+    if (interior && interiorWeightsOffset >= 0)
+    {
+      table.WeightsOffset[position] = interiorWeightsOffset;
+      continue;
+    }
+    size_t kernelStart = table.Weights.size();
+    table.WeightsOffset[position] = static_cast<int>(kernelStart);
+    if (interior)
+    {
+      interiorWeightsOffset = table.WeightsOffset[position];
+    }
+    if (stdDev == 0.0)
+    {
+      table.Weights.push_back(1.0);
+      continue;
+    }
+    double sum = 0.0;
+    for (int tap = firstTap; tap <= lastTap; ++tap)
+    {
+      double weight = exp(-static_cast<double>(tap * tap) / (stdDev * stdDev * 2.0));
+      table.Weights.push_back(weight);
+      sum += weight;
+    }
+    for (size_t weightIndex = kernelStart; weightIndex < table.Weights.size(); ++weightIndex)
+    {
+      table.Weights[weightIndex] /= sum;
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBoneEnhancer::GaussianSmoothFused(vtkImageData* inputImage, vtkImageData* outputImage)
+{
+  int dims[3] = { 0, 0, 0 };
+  inputImage->GetDimensions(dims);
+  const int width = dims[0];
+  const int height = dims[1];
+
+  int radius = static_cast<int>(this->GaussianStdDev * this->GaussianKernelSize);
+  UpdateGaussianKernelTable(this->GaussianKernelTables[0], width, this->GaussianStdDev, radius);
+  UpdateGaussianKernelTable(this->GaussianKernelTables[1], height, this->GaussianStdDev, radius);
+
+  const unsigned char* inputPtr = static_cast<unsigned char*>(inputImage->GetScalarPointer());
+  unsigned char* outputPtr = static_cast<unsigned char*>(outputImage->GetScalarPointer());
+  unsigned char* bufferPtr = &this->SmoothingBuffer[0];
+  double* rowSums = &this->SmoothingRowSums[0];
+
+  // Smooth along the Y axis first, then along the X axis, storing the intermediate result
+  // as unsigned char, in the same order as vtkImageGaussianSmooth does.
+  // Whole rows are accumulated at once so that the input is read sequentially.
+  const GaussianKernelTable& yKernels = this->GaussianKernelTables[1];
+  for (int y = 0; y < height; ++y)
+  {
+    const double* weights = &yKernels.Weights[yKernels.WeightsOffset[y]];
+    const unsigned char* firstRow = inputPtr + (y + yKernels.FirstTap[y]) * width;
+    std::fill(rowSums, rowSums + width, 0.0);
+    for (int tap = 0; tap < yKernels.NumberOfTaps[y]; ++tap)
+    {
+      const double weight = weights[tap];
+      const unsigned char* row = firstRow + tap * width;
+      for (int x = 0; x < width; ++x)
+      {
+        rowSums[x] += weight * row[x];
+      }
+    }
+    unsigned char* bufferRow = bufferPtr + y * width;
+    for (int x = 0; x < width; ++x)
+    {
+      bufferRow[x] = static_cast<unsigned char>(rowSums[x]);
+    }
+  }
+
+  const GaussianKernelTable& xKernels = this->GaussianKernelTables[0];
+  for (int y = 0; y < height; ++y)
+  {
+    const unsigned char* bufferRow = bufferPtr + y * width;
+    unsigned char* outputRow = outputPtr + y * width;
+    for (int x = 0; x < width; ++x)
+    {
+      const double* weights = &xKernels.Weights[xKernels.WeightsOffset[x]];
+      const unsigned char* firstPixel = bufferRow + x + xKernels.FirstTap[x];
+      const int numberOfTaps = xKernels.NumberOfTaps[x];
+      double sum = 0.0;
+      for (int tap = 0; tap < numberOfTaps; ++tap)
+      {
+        sum += weights[tap] * firstPixel[tap];
+      }
+      outputRow[x] = static_cast<unsigned char>(sum);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBoneEnhancer::EdgeDetectAndBinarizeFused(vtkImageData* inputImage, vtkImageData* outputImage, vtkImageData* edgeImage)
+{
+  int dims[3] = { 0, 0, 0 };
+  inputImage->GetDimensions(dims);
+  const int width = dims[0];
+  const int height = dims[1];
+
+  // Gradient scaling of vtkImageSobel2D
+  double spacing[3] = { 1.0, 1.0, 1.0 };
+  inputImage->GetSpacing(spacing);
+  const double gradientScaleX = 0.125 / spacing[0];
+  const double gradientScaleY = 0.125 / spacing[1];
+
+  // Threshold of ImageBinarizer
+  const unsigned char lowerThreshold = 55;
+
+  const unsigned char* inputPtr = static_cast<unsigned char*>(inputImage->GetScalarPointer());
+  unsigned char* outputPtr = static_cast<unsigned char*>(outputImage->GetScalarPointer());
+  unsigned char* edgePtr = (edgeImage != NULL ? static_cast<unsigned char*>(edgeImage->GetScalarPointer()) : NULL);
+  for (int y = 0; y < height; ++y)
+  {
+    // Pixels at the image boundary are used in place of the missing neighbors
+    const unsigned char* previousRow = inputPtr + (y > 0 ? y - 1 : y) * width;
+    const unsigned char* currentRow = inputPtr + y * width;
+    const unsigned char* nextRow = inputPtr + (y < height - 1 ? y + 1 : y) * width;
+    unsigned char* outputRow = outputPtr + y * width;
+    unsigned char* edgeRow = (edgePtr != NULL ? edgePtr + y * width : NULL);
+    for (int x = 0; x < width; ++x)
+    {
+      const int previousX = (x > 0 ? x - 1 : x);
+      const int nextX = (x < width - 1 ? x + 1 : x);
+      double sumX = -previousRow[previousX] - 2.0 * currentRow[previousX] - nextRow[previousX]
+                    + previousRow[nextX] + 2.0 * currentRow[nextX] + nextRow[nextX];
+      double sumY = -previousRow[previousX] - 2.0 * previousRow[x] - previousRow[nextX]
+                    + nextRow[previousX] + 2.0 * nextRow[x] + nextRow[nextX];
+
+      // Conversion of the gradient components to unsigned char as in VectorImageToUchar (negative values wrap around)
+      unsigned char edgeDetectorOutput0 = static_cast<unsigned char>(static_cast<int>(static_cast<float>(sumX * gradientScaleX)));
+      unsigned char edgeDetectorOutput1 = static_cast<unsigned char>(static_cast<int>(static_cast<float>(sumY * gradientScaleY)));
+      float output = (float)(edgeDetectorOutput0 + edgeDetectorOutput1) / (float)2;
+      unsigned char edge = (unsigned char)std::max(0, std::min(255, (int)output));
+
+      if (edgeRow != NULL)
+      {
+        edgeRow[x] = edge;
+      }
+      outputRow[x] = (edge >= lowerThreshold ? 255 : 0);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBoneEnhancer::RemoveIslandsFused(vtkImageData* image)
+{
+  if (this->IslandAreaThreshold <= 0)
+  {
+    // Same as IslandRemover with zero area threshold: no island is removed
+    return;
+  }
+
+  int dims[3] = { 0, 0, 0 };
+  image->GetDimensions(dims);
+  const int width = dims[0];
+  const int height = dims[1];
+  unsigned char* imagePtr = static_cast<unsigned char*>(image->GetScalarPointer());
+  std::fill(this->IslandVisited.begin(), this->IslandVisited.end(), 0);
+
+  for (int seedIndex = 0; seedIndex < width * height; ++seedIndex)
+  {
+    if (imagePtr[seedIndex] != 255 || this->IslandVisited[seedIndex])
+    {
+      continue;
+    }
+
+    // Collect the pixels of the island. IslandPixels is used as the queue of the
+    // flood fill, its capacity is reserved for the whole image.
+    this->IslandPixels.clear();
+    this->IslandPixels.push_back(seedIndex);
+    this->IslandVisited[seedIndex] = 1;
+    for (size_t queueIndex = 0; queueIndex < this->IslandPixels.size(); ++queueIndex)
+    {
+      const int pixelIndex = this->IslandPixels[queueIndex];
+      const int x = pixelIndex % width;
+      const int y = pixelIndex / width;
+      for (int neighborY = std::max(y - 1, 0); neighborY <= std::min(y + 1, height - 1); ++neighborY)
+      {
+        for (int neighborX = std::max(x - 1, 0); neighborX <= std::min(x + 1, width - 1); ++neighborX)
+        {
+          const int neighborIndex = neighborY * width + neighborX;
+          if (imagePtr[neighborIndex] == 255 && !this->IslandVisited[neighborIndex])
+          {
+            this->IslandVisited[neighborIndex] = 1;
+            this->IslandPixels.push_back(neighborIndex);
+          }
+        }
+      }
+    }
+
+    if (static_cast<int>(this->IslandPixels.size()) < this->IslandAreaThreshold)
+    {
+      for (std::vector<int>::iterator pixelIt = this->IslandPixels.begin(); pixelIt != this->IslandPixels.end(); ++pixelIt)
+      {
+        imagePtr[*pixelIt] = 0;
+      }
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusBoneEnhancer::DilateErodeFused(vtkImageData* inputImage, vtkImageData* outputImage, const int kernelSize[2], unsigned char erodeValue, unsigned char dilateValue)
+{
+  int dims[3] = { 0, 0, 0 };
+  inputImage->GetDimensions(dims);
+  const int width = dims[0];
+  const int height = dims[1];
+
+  // Ellipsoid kernel mask as generated by vtkImageDilateErode3D, stored as the first and last
+  // x offset of each kernel row (rows are contiguous in an ellipse, first > last if a row is empty)
+  const int kernelWidth = std::max(kernelSize[0], 1);
+  const int kernelHeight = std::max(kernelSize[1], 1);
+  const int kernelMiddle[2] = { kernelWidth / 2, kernelHeight / 2 };
+  const double kernelCenter[2] = { (kernelWidth - 1) * 0.5, (kernelHeight - 1) * 0.5 };
+  const double kernelRadius[2] = { kernelWidth * 0.5, kernelHeight * 0.5 };
+  this->MorphologyKernelRowFirst.resize(kernelHeight);
+  this->MorphologyKernelRowLast.resize(kernelHeight);
+  for (int kernelY = 0; kernelY < kernelHeight; ++kernelY)
+  {
+    double distanceY = (kernelY - kernelCenter[1]) / kernelRadius[1];
+    this->MorphologyKernelRowFirst[kernelY] = 1;
+    this->MorphologyKernelRowLast[kernelY] = 0;
+    bool rowEmpty = true;
+    for (int kernelX = 0; kernelX < kernelWidth; ++kernelX)
+    {
+      double distanceX = (kernelX - kernelCenter[0]) / kernelRadius[0];
+      if (distanceX * distanceX + distanceY * distanceY > 1.0)
+      {
+        continue;
+      }
+      if (rowEmpty)
+      {
+        this->MorphologyKernelRowFirst[kernelY] = kernelX - kernelMiddle[0];
+        rowEmpty = false;
+      }
+      this->MorphologyKernelRowLast[kernelY] = kernelX - kernelMiddle[0];
+    }
+  }
+
+  // Number of dilateValue pixels before each position of each row, so that presence of a
+  // dilateValue pixel under a kernel row can be checked in constant time
+  const unsigned char* inputPtr = static_cast<unsigned char*>(inputImage->GetScalarPointer());
+  unsigned char* outputPtr = static_cast<unsigned char*>(outputImage->GetScalarPointer());
+  int* prefixCountsPtr = &this->MorphologyPrefixCounts[0];
+  for (int y = 0; y < height; ++y)
+  {
+    const unsigned char* inputRow = inputPtr + y * width;
+    int* prefixCounts = prefixCountsPtr + y * (width + 1);
+    prefixCounts[0] = 0;
+    for (int x = 0; x < width; ++x)
+    {
+      prefixCounts[x + 1] = prefixCounts[x] + (inputRow[x] == dilateValue ? 1 : 0);
+    }
+  }
+
+  for (int y = 0; y < height; ++y)
+  {
+    const unsigned char* inputRow = inputPtr + y * width;
+    unsigned char* outputRow = outputPtr + y * width;
+    for (int x = 0; x < width; ++x)
+    {
+      outputRow[x] = inputRow[x];
+      if (inputRow[x] != erodeValue)
+      {
+        continue;
+      }
+      // Kernel pixels outside of the image are ignored
+      for (int kernelY = 0; kernelY < kernelHeight; ++kernelY)
+      {
+        const int neighborY = y + kernelY - kernelMiddle[1];
+        if (neighborY < 0 || neighborY >= height)
+        {
+          continue;
+        }
+        const int firstX = std::max(x + this->MorphologyKernelRowFirst[kernelY], 0);
+        const int lastX = std::min(x + this->MorphologyKernelRowLast[kernelY], width - 1);
+        const int* prefixCounts = prefixCountsPtr + neighborY * (width + 1);
+        if (firstX <= lastX && prefixCounts[lastX + 1] - prefixCounts[firstX] > 0)
+        {
+          outputRow[x] = dilateValue;
+          break;
+        }
+      }
+    }
   }
-  
-  inputImage->DeepCopy(this->BinaryImageForMorphology);
 }
 
 
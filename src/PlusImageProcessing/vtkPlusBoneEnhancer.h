@@ -16,6 +16,9 @@ See License.txt for details.
 #include <vtkSmartPointer.h>
 #include <vtkSetGet.h>
 
+// STL includes
+#include <vector>
+
 class vtkImageData;
 class vtkImageThreshold;
 class vtkImageGaussianSmooth;
@@ -32,6 +35,15 @@ class vtkPlusUsScanConvert;
 class vtkPlusImageProcessingExport vtkPlusBoneEnhancer : public vtkPlusTrackedFrameProcessor
 {
 public:
+  /*! Implementation of the image processing steps */
+  enum ProcessingModeType
+  {
+    /*! Each step is a single pass over preallocated buffers, no image is allocated per frame. Faster, but the output is not bit-exact with the filter chain. */
+    PROCESSING_MODE_FUSED,
+    /*! Chain of VTK filters, the reference implementation (default) */
+    PROCESSING_MODE_FILTER_CHAIN
+  };
+
   static vtkPlusBoneEnhancer* New();
   vtkTypeMacro(vtkPlusBoneEnhancer, vtkPlusTrackedFrameProcessor);
   virtual void PrintSelf(ostream& os, vtkIndent indent);
@@ -87,6 +99,10 @@ public:
   vtkSetVector2Macro(DilationKernelSize, int);
   vtkGetVector2Macro(DilationKernelSize, int);
 
+  /*! Set/get the implementation of the image processing steps. Default is PROCESSING_MODE_FILTER_CHAIN. */
+  vtkSetMacro(ProcessingMode, ProcessingModeType);
+  vtkGetMacro(ProcessingMode, ProcessingModeType);
+
   void ThresholdViaStdDeviation(vtkSmartPointer<vtkImageData> inputImage);
 
   vtkImageData* GetProcessedLinesImage() { return (this->ProcessedLinesImage); }
@@ -110,6 +126,42 @@ protected:
   void FillLinesImage(vtkSmartPointer<vtkImageData> inputImageData);
   void VectorImageToUchar(vtkSmartPointer<vtkImageData> inputImage);
 
+  /*! Fill LinesImage from the frame image, allocate the intermediate images if the lines image geometry has changed */
+  void UpdateLinesImage(igsioTrackedFrame* inputFrame);
+
+  /*! Compute the bone outline in BinaryImageForMorphology from a lines image using the current processing mode */
+  void ComputeBoneOutline(vtkImageData* linesImage);
+
+  /*! Reference implementation of the noise removal steps, using the VTK filter chain. Modifies linesImage. */
+  void RemoveNoiseFilterChain(vtkImageData* linesImage);
+
+  /*! Fused implementation of the noise removal steps. Does not modify linesImage. */
+  void RemoveNoiseFused(vtkImageData* linesImage);
+
+  /*! Fill LinesImage using a precomputed input pixel offset for each lines image pixel. Input must be unsigned char. */
+  void FillLinesImageFused(vtkImageData* inputImageData);
+
+  /*! Separable Gaussian smoothing of an unsigned char image, equivalent to vtkImageGaussianSmooth with dimensionality 2 */
+  void GaussianSmoothFused(vtkImageData* inputImage, vtkImageData* outputImage);
+
+  /*! Sobel edge detection, conversion to unsigned char and binarization in a single pass */
+  void EdgeDetectAndBinarizeFused(vtkImageData* inputImage, vtkImageData* outputImage, vtkImageData* edgeImage);
+
+  /*! Remove 8-connected islands of 255 valued pixels that are smaller than IslandAreaThreshold, in place */
+  void RemoveIslandsFused(vtkImageData* image);
+
+  /*!
+    Binary erosion or dilation with the same ellipsoid kernel as vtkImageDilateErode3D.
+    Pixels of erodeValue are set to dilateValue if any pixel under the kernel has dilateValue.
+  */
+  void DilateErodeFused(vtkImageData* inputImage, vtkImageData* outputImage, const int kernelSize[2], unsigned char erodeValue, unsigned char dilateValue);
+
+  /*! Compute the threshold value of a row for ThresholdViaStdDeviation. Returns false if the row is empty. */
+  static bool GetStdDeviationThreshold(const unsigned char* row, int rowLength, float& thresholdValue);
+
+  /*! Mark shadow outline in an unsigned char image with the given dimensions */
+  void MarkShadowOutline(unsigned char* imagePtr, int dims[3]);
+
   void ImageConjunction(vtkSmartPointer<vtkImageData> inputImage, vtkSmartPointer<vtkImageData> maskImage);
 
   void AddIntermediateImage(char* fileNamePostfix, vtkSmartPointer<vtkImageData> image);
@@ -165,6 +217,46 @@ protected:
   std::vector<std::map<std::string, int> > BoneAreasInfo;
   bool FirstFrame;
 
+  ProcessingModeType ProcessingMode;
+
+  /*! Preallocated intermediate images of the fused processing mode */
+  vtkSmartPointer<vtkImageData> ThresholdedLinesImage;
+  vtkSmartPointer<vtkImageData> SmoothedLinesImage;
+  vtkSmartPointer<vtkImageData> EdgeBinaryImage;
+  vtkSmartPointer<vtkImageData> ErodedImage;
+  vtkSmartPointer<vtkImageData> FanImage;
+
+  /*! Offset of the input image pixel for each lines image pixel, -1 if outside of the input image */
+  std::vector<int> LinesImageSampleOffsets;
+  int LinesImageSampleOffsetsInputExtent[6];
+  int LinesImageSampleOffsetsNumberOfComponents;
+
+  /*! Truncated and normalized Gaussian kernels for each position along an image axis */
+  struct GaussianKernelTable
+  {
+    GaussianKernelTable() : Length(0), StdDev(0.0), Radius(-1) {}
+    std::vector<double> Weights;
+    std::vector<int> WeightsOffset;
+    std::vector<int> FirstTap;
+    std::vector<int> NumberOfTaps;
+    int Length;
+    double StdDev;
+    int Radius;
+  };
+  GaussianKernelTable GaussianKernelTables[2];
+
+  /*! Recompute the kernels of a table if the axis length or the kernel parameters have changed */
+  static void UpdateGaussianKernelTable(GaussianKernelTable& table, int length, double stdDev, int radius);
+
+  /*! Work buffers of the fused processing mode, sized once per lines image geometry */
+  std::vector<unsigned char> SmoothingBuffer;
+  std::vector<double> SmoothingRowSums;
+  std::vector<int> MorphologyPrefixCounts;
+  std::vector<int> MorphologyKernelRowFirst;
+  std::vector<int> MorphologyKernelRowLast;
+  std::vector<unsigned char> IslandVisited;
+  std::vector<int> IslandPixels;
+
 private:
   vtkPlusBoneEnhancer(const vtkPlusBoneEnhancer&);  // Not implemented.
   void operator=(const vtkPlusBoneEnhancer&);  // Not implemented.
@@ -15,24 +15,57 @@ See License.txt for details.
 #include "vtkStreamingDemandDrivenPipeline.h"
 #include "vtkMath.h"
 
+#include <algorithm>
+#include <limits>
 #include <math.h>
+#include <string.h>
 
 vtkStandardNewMacro(vtkPlusRfToBrightnessConvert);
 
 const double MIN_BRIGHTNESS_VALUE = 0.0;
 const double MAX_BRIGHTNESS_VALUE = 255.0;
 
+// The lookup table is indexed by the sign, exponent, and 7 most significant mantissa bits of a float
+const int BRIGHTNESS_LOOKUP_TABLE_INDEX_SHIFT = 16;
+const int BRIGHTNESS_LOOKUP_TABLE_SIZE = 1 << (32 - BRIGHTNESS_LOOKUP_TABLE_INDEX_SHIFT);
+
 //----------------------------------------------------------------------------
 vtkPlusRfToBrightnessConvert::vtkPlusRfToBrightnessConvert()
 {
   this->ImageType = US_IMG_TYPE_XX;
   this->BrightnessScale = 10.0;
   this->NumberOfHilbertFilterCoeffs = 64;
+  this->HilbertTransformMethod = HILBERT_TRANSFORM_FIR;
+  this->FftPlan = NULL;
+  this->UseBrightnessLookupTable = false;
+  this->BrightnessLookupTableScale = 0.0;
 }
 
 //----------------------------------------------------------------------------
 vtkPlusRfToBrightnessConvert::~vtkPlusRfToBrightnessConvert()
 {
+  delete this->FftPlan;
+  this->FftPlan = NULL;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusRfToBrightnessConvert::RequestData(vtkInformation* request,
+    vtkInformationVector** inputVector,
+    vtkInformationVector* outputVector)
+{
+  // FFT plan and lookup table are shared between the threads, therefore they are updated here, before the threads are started
+  if (this->ImageType == US_IMG_RF_REAL && this->HilbertTransformMethod == HILBERT_TRANSFORM_FFT)
+  {
+    vtkInformation* inInfo = inputVector[0]->GetInformationObject(0);
+    int inExt[6] = {0};
+    inInfo->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), inExt);
+    this->UpdateFftPlan(inExt[1] - inExt[0] + 1);
+  }
+  if (this->UseBrightnessLookupTable)
+  {
+    this->UpdateBrightnessLookupTable();
+  }
+  return this->Superclass::RequestData(request, inputVector, outputVector);
 }
 
 //----------------------------------------------------------------------------
@@ -240,6 +273,50 @@ void vtkPlusRfToBrightnessConvert::ThreadedLineByLineHilbertTransform(int inExt[
     return;
   }
 
+  if (this->ImageType == US_IMG_RF_REAL && this->HilbertTransformMethod == HILBERT_TRANSFORM_FFT)
+  {
+    if (this->FftPlan == NULL || this->FftPlan->size() < numberOfRfSamplesInScanline)
+    {
+      LOG_ERROR("FFT plan is not available for scanlines of " << numberOfRfSamplesInScanline << " samples");
+      return;
+    }
+    // Two scanlines are transformed at once, as the real and imaginary part of a complex signal
+    vnl_vector< std::complex<double> > fftBuffer(this->FftPlan->size());
+    for (int idx2 = outExt[4]; idx2 <= outExt[5]; ++idx2)
+    {
+      for (int idx1 = outExt[2]; !this->AbortExecute && idx1 <= outExt[3]; idx1 += 2)
+      {
+        if (threadId == 0)
+        {
+          // it is the first thread, report progress
+          if (!(count % target))
+          {
+            this->UpdateProgress(count / (50.0 * target));
+          }
+          count += 2;
+        }
+        // RF data: IIIII..., IIIII...
+        ScalarType* firstInputSignal = inPtr;
+        unsigned char* firstAmpl = outPtr;
+        inPtr += numberOfRfSamplesInScanline + inInc1;
+        outPtr += numberOfBmodeSamplesInScanline + outInc1;
+        ScalarType* secondInputSignal = NULL;
+        unsigned char* secondAmpl = NULL;
+        if (idx1 < outExt[3])
+        {
+          secondInputSignal = inPtr;
+          secondAmpl = outPtr;
+          inPtr += numberOfRfSamplesInScanline + inInc1;
+          outPtr += numberOfBmodeSamplesInScanline + outInc1;
+        }
+        ComputeAmplitudeFftHilbertTransform(firstAmpl, secondAmpl, firstInputSignal, secondInputSignal, numberOfRfSamplesInScanline, fftBuffer);
+      }
+      inPtr += inInc2;
+      outPtr += outInc2;
+    }
+    return;
+  }
+
   ScalarType* hilbertTransformBuffer = new ScalarType[numberOfRfSamplesInScanline + 1];
   for (int idx2 = outExt[4]; idx2 <= outExt[5]; ++idx2)
   {
@@ -306,6 +383,14 @@ void vtkPlusRfToBrightnessConvert::ThreadedLineByLineHilbertTransform(int inExt[
 void vtkPlusRfToBrightnessConvert::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "BrightnessScale: " << this->BrightnessScale << std::endl;
+  os << indent << "NumberOfHilbertFilterCoeffs: " << this->NumberOfHilbertFilterCoeffs << std::endl;
+  os << indent << "HilbertTransformMethod: " << (this->HilbertTransformMethod == HILBERT_TRANSFORM_FFT ? "FFT" : "FIR") << std::endl;
+  if (this->FftPlan != NULL)
+  {
+    os << indent << "FFT length: " << this->FftPlan->size() << std::endl;
+  }
+  os << indent << "UseBrightnessLookupTable: " << (this->UseBrightnessLookupTable ? "TRUE" : "FALSE") << std::endl;
 }
 
 //-----------------------------------------------------------------------------
@@ -315,6 +400,8 @@ PlusStatus vtkPlusRfToBrightnessConvert::ReadConfiguration(vtkXMLDataElement* rf
   XML_VERIFY_ELEMENT(rfToBrightnessElement, "RfToBrightnessConversion");
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfHilbertFilterCoeffs, rfToBrightnessElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, BrightnessScale, rfToBrightnessElement);
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(HilbertTransformMethod, rfToBrightnessElement, "FIR", HILBERT_TRANSFORM_FIR, "FFT", HILBERT_TRANSFORM_FFT);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseBrightnessLookupTable, rfToBrightnessElement);
   return PLUS_SUCCESS;
 }
 
@@ -327,6 +414,8 @@ PlusStatus vtkPlusRfToBrightnessConvert::WriteConfiguration(vtkXMLDataElement* r
 
   rfToBrightnessElement->SetDoubleAttribute("NumberOfHilbertFilterCoeffs", this->NumberOfHilbertFilterCoeffs);
   rfToBrightnessElement->SetDoubleAttribute("BrightnessScale", this->BrightnessScale);
+  rfToBrightnessElement->SetAttribute("HilbertTransformMethod", this->HilbertTransformMethod == HILBERT_TRANSFORM_FFT ? "FFT" : "FIR");
+  XML_WRITE_BOOL_ATTRIBUTE(UseBrightnessLookupTable, rfToBrightnessElement);
 
   return PLUS_SUCCESS;
 }
@@ -420,10 +509,7 @@ void vtkPlusRfToBrightnessConvert::ComputeAmplitudeILineQLine(unsigned char* amp
   {
     double xt = inputSignal[i];
     double xht = inputSignalHilbertTransformed[i];
-    double brightnessValue = sqrt(sqrt(sqrt(xt * xt + xht * xht))) * this->BrightnessScale;
-    if (brightnessValue > MAX_BRIGHTNESS_VALUE) { brightnessValue = MAX_BRIGHTNESS_VALUE; }
-    if (brightnessValue < MIN_BRIGHTNESS_VALUE) { brightnessValue = MIN_BRIGHTNESS_VALUE; }
-    ampl[i] = brightnessValue;
+    ampl[i] = CompressAmplitude(xt * xt + xht * xht);
     /*
     If needed, the phase could be computed as follows:
     phase[i] = atan2(xht ,xt);
@@ -450,9 +536,147 @@ void vtkPlusRfToBrightnessConvert::ComputeAmplitudeIqLine(unsigned char* ampl, S
   {
     double xt = inputSignal[inputIndex++];
     double xht = inputSignal[inputIndex++];
-    double outputValue = sqrt(sqrt(sqrt(xt * xt + xht * xht))) * this->BrightnessScale;
-    if (outputValue > MAX_BRIGHTNESS_VALUE) { outputValue = MAX_BRIGHTNESS_VALUE; }
-    if (outputValue < MIN_BRIGHTNESS_VALUE) { outputValue = MIN_BRIGHTNESS_VALUE; }
-    ampl[outputIndex++] = outputValue;
+    ampl[outputIndex++] = CompressAmplitude(xt * xt + xht * xht);
+  }
+}
+
+//-----------------------------------------------------------------------------
+template<typename ScalarType>
+void vtkPlusRfToBrightnessConvert::ComputeAmplitudeFftHilbertTransform(unsigned char* firstAmpl, unsigned char* secondAmpl,
+    ScalarType* firstInputSignal, ScalarType* secondInputSignal, int npt, vnl_vector< std::complex<double> >& fftBuffer)
+{
+  const int fftLength = static_cast<int>(fftBuffer.size());
+  for (int i = 0; i < npt; i++)
+  {
+    fftBuffer[i] = std::complex<double>(firstInputSignal[i], secondInputSignal != NULL ? secondInputSignal[i] : 0.0);
+  }
+  // Pad by zeros
+  for (int i = npt; i < fftLength; i++)
+  {
+    fftBuffer[i] = 0.0;
+  }
+
+  this->FftPlan->fwd_transform(fftBuffer);
+
+  // The Hilbert transform multiplies positive frequency components by -i and negative frequency components by +i.
+  // It is a real linear operator, so the real and imaginary part of the result is the Hilbert transform
+  // of the first and second signal, respectively.
+  // The result is scaled by 1/fftLength, because the inverse transform is not normalized.
+  const double scale = 1.0 / fftLength;
+  fftBuffer[0] = 0.0;
+  for (int k = 1; k < fftLength; k++)
+  {
+    if (2 * k == fftLength)
+    {
+      // Nyquist frequency
+      fftBuffer[k] = 0.0;
+      continue;
+    }
+    std::complex<double> value = fftBuffer[k] * scale;
+    fftBuffer[k] = (2 * k < fftLength) ? std::complex<double>(value.imag(), -value.real()) : std::complex<double>(-value.imag(), value.real());
+  }
+
+  this->FftPlan->bwd_transform(fftBuffer);
+
+  for (int i = 0; i < npt; i++)
+  {
+    double xt = firstInputSignal[i];
+    double xht = fftBuffer[i].real();
+    firstAmpl[i] = CompressAmplitude(xt * xt + xht * xht);
+  }
+  if (secondInputSignal != NULL)
+  {
+    for (int i = 0; i < npt; i++)
+    {
+      double xt = secondInputSignal[i];
+      double xht = fftBuffer[i].imag();
+      secondAmpl[i] = CompressAmplitude(xt * xt + xht * xht);
+    }
+  }
+}
+
+//-----------------------------------------------------------------------------
+int vtkPlusRfToBrightnessConvert::GetFftLength(int numberOfSamples)
+{
+  int fftLength = std::max(numberOfSamples, 1);
+  while (true)
+  {
+    int remainder = fftLength;
+    while (remainder % 2 == 0) { remainder /= 2; }
+    while (remainder % 3 == 0) { remainder /= 3; }
+    while (remainder % 5 == 0) { remainder /= 5; }
+    if (remainder == 1)
+    {
+      return fftLength;
+    }
+    fftLength++;
+  }
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusRfToBrightnessConvert::UpdateFftPlan(int numberOfSamples)
+{
+  int fftLength = GetFftLength(numberOfSamples);
+  if (this->FftPlan != NULL && this->FftPlan->size() == fftLength)
+  {
+    // the current plan can be reused
+    return;
+  }
+  LOG_DEBUG("Create FFT plan for " << numberOfSamples << " samples (FFT length: " << fftLength << ")");
+  delete this->FftPlan;
+  this->FftPlan = new vnl_fft_1d<double>(fftLength);
+}
+
+//-----------------------------------------------------------------------------
+void vtkPlusRfToBrightnessConvert::UpdateBrightnessLookupTable()
+{
+  if (!this->BrightnessLookupTable.empty() && this->BrightnessLookupTableScale == this->BrightnessScale)
+  {
+    // already up-to-date
+    return;
+  }
+
+  this->BrightnessLookupTable.resize(BRIGHTNESS_LOOKUP_TABLE_SIZE);
+  for (int index = 0; index < BRIGHTNESS_LOOKUP_TABLE_SIZE; index++)
+  {
+    // Compute the brightness at the center of the range of values that map to this table entry
+    unsigned int bits = (static_cast<unsigned int>(index) << BRIGHTNESS_LOOKUP_TABLE_INDEX_SHIFT) | (1u << (BRIGHTNESS_LOOKUP_TABLE_INDEX_SHIFT - 1));
+    float squaredAmplitude = 0;
+    memcpy(&squaredAmplitude, &bits, sizeof(squaredAmplitude));
+    double brightnessValue = MIN_BRIGHTNESS_VALUE;
+    if (index >= BRIGHTNESS_LOOKUP_TABLE_SIZE / 2)
+    {
+      // negative values (sign bit is set), squared amplitude cannot be negative
+      brightnessValue = MIN_BRIGHTNESS_VALUE;
+    }
+    else if (!(squaredAmplitude <= std::numeric_limits<float>::max()))
+    {
+      // infinity or NaN
+      brightnessValue = MAX_BRIGHTNESS_VALUE;
+    }
+    else
+    {
+      brightnessValue = sqrt(sqrt(sqrt(static_cast<double>(squaredAmplitude)))) * this->BrightnessScale;
+    }
+    if (brightnessValue > MAX_BRIGHTNESS_VALUE) { brightnessValue = MAX_BRIGHTNESS_VALUE; }
+    if (brightnessValue < MIN_BRIGHTNESS_VALUE) { brightnessValue = MIN_BRIGHTNESS_VALUE; }
+    this->BrightnessLookupTable[index] = static_cast<unsigned char>(brightnessValue);
+  }
+  this->BrightnessLookupTableScale = this->BrightnessScale;
+}
+
+//-----------------------------------------------------------------------------
+unsigned char vtkPlusRfToBrightnessConvert::CompressAmplitude(double squaredAmplitude) const
+{
+  if (this->UseBrightnessLookupTable)
+  {
+    float squaredAmplitudeFloat = static_cast<float>(squaredAmplitude);
+    unsigned int bits = 0;
+    memcpy(&bits, &squaredAmplitudeFloat, sizeof(bits));
+    return this->BrightnessLookupTable[bits >> BRIGHTNESS_LOOKUP_TABLE_INDEX_SHIFT];
   }
+  double brightnessValue = sqrt(sqrt(sqrt(squaredAmplitude))) * this->BrightnessScale;
+  if (brightnessValue > MAX_BRIGHTNESS_VALUE) { brightnessValue = MAX_BRIGHTNESS_VALUE; }
+  if (brightnessValue < MIN_BRIGHTNESS_VALUE) { brightnessValue = MIN_BRIGHTNESS_VALUE; }
+  return static_cast<unsigned char>(brightnessValue);
 }
@@ -10,6 +10,11 @@
 #include "vtkPlusImageProcessingExport.h"
 #include "vtkThreadedImageAlgorithm.h"
 
+#include <vnl/vnl_vector.h>
+#include <vnl/algo/vnl_fft_1d.h>
+
+#include <complex>
+
 /*!
 \class vtkPlusRfToBrightnessConvert
 \brief This class converts ultrasound RF data to brightness values
@@ -28,6 +33,18 @@ A log function is also frequently used for dynamic range compression. The sqrt(s
 chosen because it provides a somewhat more linear mapping than log(.) function for the input data
 range (16 bits).
 
+For real RF data (US_IMG_RF_REAL) the Hilbert transform can be computed either by a FIR filter
+(HilbertTransformMethod="FIR", default) or in the frequency domain (HilbertTransformMethod="FFT").
+The FFT method computes the analytic signal of two scanlines at once (one as the real, the other
+as the imaginary part of a complex signal) and reuses the FFT plan between frames while the scanline
+length does not change. Its cost is O(N*log(N)) per scanline instead of O(N*NumberOfHilbertFilterCoeffs)
+and it does not leave zero-padded regions at the beginning and end of the scanlines.
+
+If UseBrightnessLookupTable is enabled then the dynamic range compression function is evaluated
+by a lookup table indexed by the exponent and high mantissa bits of the squared amplitude instead of
+computing three square roots per pixel. The result may differ from the exact computation by at most
+one gray level.
+
 The input image type must be VTK_SHORT (signed 16-bit) and the output image type
 is always VTK_UNSIGNED_CHAR (unsigned 8-bit).
 
@@ -56,6 +73,24 @@ public:
   vtkSetMacro(BrightnessScale, double);
   vtkGetMacro(BrightnessScale, double);
 
+  enum HilbertTransformMethodType
+  {
+    HILBERT_TRANSFORM_FIR,
+    HILBERT_TRANSFORM_FFT
+  };
+
+  /*! Method of computing the Hilbert transform of real RF data (US_IMG_RF_REAL) */
+  vtkSetMacro(HilbertTransformMethod, HilbertTransformMethodType);
+  vtkGetMacro(HilbertTransformMethod, HilbertTransformMethodType);
+
+  /*! Use a lookup table for dynamic range compression instead of computing the compression function for each pixel */
+  vtkSetMacro(UseBrightnessLookupTable, bool);
+  vtkGetMacro(UseBrightnessLookupTable, bool);
+  vtkBooleanMacro(UseBrightnessLookupTable, bool);
+
+  /*! Returns the smallest length that is not smaller than numberOfSamples and can be transformed by the FFT (only has 2, 3, 5 prime factors) */
+  static int GetFftLength(int numberOfSamples);
+
 protected:
   vtkPlusRfToBrightnessConvert();
   ~vtkPlusRfToBrightnessConvert();
@@ -64,6 +99,11 @@ protected:
                                  vtkInformationVector**,
                                  vtkInformationVector* outputVector);
 
+  /*! Prepares the FFT plan and the brightness lookup table (if needed) before the threaded execution */
+  virtual int RequestData(vtkInformation* request,
+                          vtkInformationVector** inputVector,
+                          vtkInformationVector* outputVector) VTK_OVERRIDE;
+
   void ThreadedRequestData( vtkInformation *request,
                             vtkInformationVector **inputVector,
                             vtkInformationVector *outputVector,
@@ -89,6 +129,24 @@ protected:
   template<typename ScalarType>
   void ComputeAmplitudeIqLine(unsigned char *ampl, ScalarType *inputSignal, const int npt);
 
+  /*!
+    Compute amplitude of two real RF scanlines using FFT-based Hilbert transform. npt is the number of samples in a scanline.
+    If secondInputSignal is NULL then only the first scanline is processed.
+    \param fftBuffer Work buffer, its size must be equal to the FFT plan size
+  */
+  template<typename ScalarType>
+  void ComputeAmplitudeFftHilbertTransform(unsigned char* firstAmpl, unsigned char* secondAmpl, ScalarType* firstInputSignal, ScalarType* secondInputSignal,
+      int npt, vnl_vector< std::complex<double> >& fftBuffer);
+
+  /*! Create a new FFT plan if the current one cannot be used for scanlines of the specified length */
+  void UpdateFftPlan(int numberOfSamples);
+
+  /*! Recompute the brightness lookup table if the brightness scale has changed */
+  void UpdateBrightnessLookupTable();
+
+  /*! Convert squared amplitude (I*I+Q*Q) to brightness value by dynamic range compression */
+  unsigned char CompressAmplitude(double squaredAmplitude) const;
+
   /*! Scaling of the brightness output. Higher value means brighter image. */
   double BrightnessScale;
 
@@ -101,6 +159,19 @@ protected:
   /*! Image type (RF_IQ_LINE, RF_I_LINE_Q_LINE, ...) */
   US_IMAGE_TYPE ImageType;
 
+  HilbertTransformMethodType HilbertTransformMethod;
+
+  /*! FFT plan used with HILBERT_TRANSFORM_FFT, kept between frames. Only read during the threaded execution. */
+  vnl_fft_1d<double>* FftPlan;
+
+  bool UseBrightnessLookupTable;
+
+  /*! Brightness values indexed by the upper 16 bits of the single precision floating-point squared amplitude */
+  std::vector<unsigned char> BrightnessLookupTable;
+
+  /*! Brightness scale that was used for computing BrightnessLookupTable */
+  double BrightnessLookupTableScale;
+
 private:
   vtkPlusRfToBrightnessConvert(const vtkPlusRfToBrightnessConvert&);  // Not implemented.
   void operator=(const vtkPlusRfToBrightnessConvert&);  // Not implemented.
@@ -32,6 +32,8 @@ vtkStandardNewMacro(vtkPlusTransverseProcessEnhancer);
 //----------------------------------------------------------------------------
 vtkPlusTransverseProcessEnhancer::vtkPlusTransverseProcessEnhancer() : vtkPlusBoneEnhancer()
 {
+  // The shadow area comparison is tuned to the output of the filter chain
+  this->ProcessingMode = PROCESSING_MODE_FILTER_CHAIN;
 }
 
 //----------------------------------------------------------------------------
@@ -39,6 +41,21 @@ vtkPlusTransverseProcessEnhancer::~vtkPlusTransverseProcessEnhancer()
 {
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusTransverseProcessEnhancer::ReadConfiguration(vtkSmartPointer<vtkXMLDataElement> processingElement)
+{
+  if (this->Superclass::ReadConfiguration(processingElement) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (this->ProcessingMode != PROCESSING_MODE_FILTER_CHAIN)
+  {
+    LOG_WARNING("ProcessingMode=FUSED is not supported by " << this->GetProcessorTypeName() << ", FILTER_CHAIN is used instead");
+    this->ProcessingMode = PROCESSING_MODE_FILTER_CHAIN;
+  }
+  return PLUS_SUCCESS;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusTransverseProcessEnhancer::PrintSelf(ostream& os, vtkIndent indent)
 {
@@ -31,6 +31,9 @@ public:
 
   virtual const char* GetProcessorTypeName() { return "vtkPlusTransverseProcessEnhancer"; };
 
+  /*! Read configuration from xml data. The fused processing mode is not supported, the filter chain is always used. */
+  virtual PlusStatus ReadConfiguration(vtkSmartPointer<vtkXMLDataElement> processingElement);
+
   /*! Process input frame to localize transverse process bone surfaces */
   PlusStatus ProcessFrame(igsioTrackedFrame* inputFrame, igsioTrackedFrame* outputFrame);
 
@@ -17,6 +17,7 @@ non-commercial terms in your toolbox and distribute it."
 
 #include "vtkPlusUsScanConvertCurvilinear.h"
 
+#include "vtkIGSIOAccurateTimer.h"
 #include "vtkXMLDataElement.h"
 
 #include "vtkMath.h"
@@ -32,8 +33,90 @@ non-commercial terms in your toolbox and distribute it."
 #include <string.h>
 #include <ctype.h>
 
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+#include <vtksys/SystemTools.hxx>
+
 vtkStandardNewMacro( vtkPlusUsScanConvertCurvilinear );
 
+namespace
+{
+  /*! Identifies interpolation table cache files. Increment the version if the file content or the table computation changes. */
+  const char INTERPOLATION_TABLE_FILE_MAGIC[8] = "PLUSLUT";
+  const int INTERPOLATION_TABLE_FILE_VERSION = 1;
+  const unsigned int INTERPOLATION_TABLE_BYTE_ORDER_MARK = 0x01020304;
+
+  //----------------------------------------------------------------------------
+  /*! 64-bit FNV-1a hash, used for generating cache file names */
+  unsigned long long ComputeFnv1aHash( const std::string& text )
+  {
+    unsigned long long hash = 14695981039346656037ULL;
+    for ( std::string::const_iterator it = text.begin(); it != text.end(); ++it )
+    {
+      hash ^= static_cast<unsigned char>( *it );
+      hash *= 1099511628211ULL;
+    }
+    return hash;
+  }
+
+  //----------------------------------------------------------------------------
+  template <class T>
+  void WriteArray( std::ostream& stream, const std::vector<T>& values )
+  {
+    if ( !values.empty() )
+    {
+      stream.write( reinterpret_cast<const char*>( &values[0] ), values.size() * sizeof( T ) );
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  template <class T>
+  bool ReadArray( std::istream& stream, std::vector<T>& values, size_t numberOfValues )
+  {
+    values.resize( numberOfValues );
+    if ( numberOfValues > 0 )
+    {
+      stream.read( reinterpret_cast<char*>( &values[0] ), numberOfValues * sizeof( T ) );
+    }
+    return stream.good();
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Returns true if all values are in the [0, maxValue] range */
+  bool IsIndexArrayValid( const std::vector<short>& values, int maxValue )
+  {
+    for ( std::vector<short>::const_iterator it = values.begin(); it != values.end(); ++it )
+    {
+      if ( *it < 0 || *it > maxValue )
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusUsScanConvertCurvilinear::InterpolationTable::Clear()
+{
+  this->Mode = INTERPOLATION_DOUBLE;
+  this->IntensityScaling = 1.0;
+  this->OutputImageSizePixelsX = 0;
+  this->NumberOfSamples = 0;
+  this->OutputColumn.clear();
+  this->OutputRow.clear();
+  this->InputSample.clear();
+  this->InputLine.clear();
+  for ( int i = 0; i < 4; i++ )
+  {
+    this->Weights[i].clear();
+    this->FixedPointWeights[i].clear();
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkPlusUsScanConvertCurvilinear::vtkPlusUsScanConvertCurvilinear()
 {
@@ -43,8 +126,21 @@ vtkPlusUsScanConvertCurvilinear::vtkPlusUsScanConvertCurvilinear()
   this->ThetaStartDeg = -30.0;
   this->ThetaStopDeg = 30.0;
   this->OutputIntensityScaling = 1.0;
+  this->InterpolationMode = INTERPOLATION_DOUBLE;
+  this->InterpolationTableSetupTimeSec = 0.0;
+  this->InterpolationTableLoadedFromCache = false;
+
+  this->ResetInterpolationParameters();
+}
+
+//----------------------------------------------------------------------------
+vtkPlusUsScanConvertCurvilinear::~vtkPlusUsScanConvertCurvilinear()
+{
+}
 
-  // Values that are used for computing the InterpolatedPointArray
+//----------------------------------------------------------------------------
+void vtkPlusUsScanConvertCurvilinear::ResetInterpolationParameters()
+{
   this->InterpInputImageExtent[0] = 0;
   this->InterpInputImageExtent[1] = -1;
   this->InterpInputImageExtent[2] = 0;
@@ -67,11 +163,7 @@ vtkPlusUsScanConvertCurvilinear::vtkPlusUsScanConvertCurvilinear()
   this->InterpTransducerCenterPixel[0] = 0.0;
   this->InterpTransducerCenterPixel[1] = 0.0;
   this->InterpIntensityScaling = 0.0;
-}
-
-//----------------------------------------------------------------------------
-vtkPlusUsScanConvertCurvilinear::~vtkPlusUsScanConvertCurvilinear()
-{
+  this->InterpInterpolationMode = INTERPOLATION_DOUBLE;
 }
 
 //----------------------------------------------------------------------------
@@ -89,7 +181,7 @@ void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
     {
       modifiedScanConversionParams = true;
     }
-    if ( this->OutputImageExtent[i] != outputImageExtent[i] )
+    if ( this->InterpOutputImageExtent[i] != outputImageExtent[i] )
     {
       modifiedScanConversionParams = true;
     }
@@ -107,14 +199,15 @@ void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
        || ( this->InterpThetaStopDeg != thetaStopDeg )
        || ( this->InterpTransducerCenterPixel[0] != transducerCenterPixel[0] )
        || ( this->InterpTransducerCenterPixel[1] != transducerCenterPixel[1] )
-       || ( this->InterpIntensityScaling != intensityScaling ) )
+       || ( this->InterpIntensityScaling != intensityScaling )
+       || ( this->InterpInterpolationMode != this->InterpolationMode ) )
   {
     modifiedScanConversionParams = true;
   }
 
   if ( !modifiedScanConversionParams )
   {
-    // scan conversion parameters haven't been modified since the InterpolatedPointArray was last computed
+    // scan conversion parameters haven't been modified since the interpolation table was last computed
     // there is no need to recompute, just return
     return;
   }
@@ -123,7 +216,7 @@ void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
   for ( int i = 0; i < 6; i++ )
   {
     this->InterpInputImageExtent[i] = inputImageExtent[i];
-    this->OutputImageExtent[i] = outputImageExtent[i];
+    this->InterpOutputImageExtent[i] = outputImageExtent[i];
   }
   for ( int i = 0; i < 3; i++ )
   {
@@ -136,26 +229,72 @@ void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
   this->InterpTransducerCenterPixel[0] = transducerCenterPixel[0];
   this->InterpTransducerCenterPixel[1] = transducerCenterPixel[1];
   this->InterpIntensityScaling = intensityScaling;
+  this->InterpInterpolationMode = this->InterpolationMode;
+
+  const double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  this->InterpolationTableLoadedFromCache = false;
+  if ( !this->InterpolationTableCacheDirectory.empty() && this->ReadInterpolationTableFromCache() == PLUS_SUCCESS )
+  {
+    this->InterpolationTableLoadedFromCache = true;
+  }
+  else
+  {
+    if ( this->ComputeInterpolationTable() != PLUS_SUCCESS )
+    {
+      LOG_ERROR( "Failed to compute the scan conversion interpolation table" );
+      // Forget the parameters so that the computation is attempted again at the next update
+      this->ResetInterpolationParameters();
+      return;
+    }
+    if ( !this->InterpolationTableCacheDirectory.empty() )
+    {
+      this->WriteInterpolationTableToCache();
+    }
+  }
+  this->InterpolationTableSetupTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+  LOG_DEBUG( "Scan conversion interpolation table with " << this->Table.GetNumberOfPoints() << " points "
+             << ( this->InterpolationTableLoadedFromCache ? "loaded" : "computed" ) << " in " << this->InterpolationTableSetupTimeSec * 1000.0 << " ms" );
+}
 
-  // Compute the interpolated point array now
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusUsScanConvertCurvilinear::ComputeInterpolationTable()
+{
+  this->Table.Clear();
+
+  int numberOfSamples = this->InterpInputImageExtent[1] - this->InterpInputImageExtent[0] + 1;
+  int numberOfLines = this->InterpInputImageExtent[3] - this->InterpInputImageExtent[2] + 1;
+  int outputImageSizePixelsX = this->InterpOutputImageExtent[1] - this->InterpOutputImageExtent[0] + 1;
+  int outputImageSizePixelsY = this->InterpOutputImageExtent[3] - this->InterpOutputImageExtent[2] + 1;
+
+  // Pixel positions are stored as 16-bit integers
+  const int maxIndex = std::numeric_limits<short>::max();
+  if ( numberOfSamples > maxIndex || numberOfLines > maxIndex || outputImageSizePixelsX > maxIndex || outputImageSizePixelsY > maxIndex )
+  {
+    LOG_ERROR( "Scan conversion input (" << numberOfSamples << "x" << numberOfLines << ") or output image size ("
+               << outputImageSizePixelsX << "x" << outputImageSizePixelsY << ") is too large, maximum size is " << maxIndex );
+    return PLUS_FAIL;
+  }
 
-  this->InterpolatedPointArray.clear();
+  this->Table.Mode = this->InterpInterpolationMode;
+  this->Table.IntensityScaling = this->InterpIntensityScaling;
+  this->Table.OutputImageSizePixelsX = outputImageSizePixelsX;
+  this->Table.NumberOfSamples = numberOfSamples;
 
-  int numberOfSamples = inputImageExtent[1] - inputImageExtent[0] + 1;
-  int numberOfLines = inputImageExtent[3] - inputImageExtent[2] + 1;
-  double radiusDeltaMm = ( radiusStopMm - radiusStartMm ) / numberOfSamples;
-  double thetaStartRad = vtkMath::RadiansFromDegrees( thetaStartDeg );
+  double radiusStartMm = this->InterpRadiusStartMm;
+  double radiusDeltaMm = ( this->InterpRadiusStopMm - radiusStartMm ) / numberOfSamples;
+  double thetaStartRad = vtkMath::RadiansFromDegrees( this->InterpThetaStartDeg );
   double thetaDeltaRad = 0;
   if ( numberOfLines > 1 )
   {
-    thetaDeltaRad = vtkMath::RadiansFromDegrees( ( thetaStopDeg - thetaStartDeg ) / ( numberOfLines - 1 ) );
+    thetaDeltaRad = vtkMath::RadiansFromDegrees( ( this->InterpThetaStopDeg - this->InterpThetaStartDeg ) / ( numberOfLines - 1 ) );
   }
-  int outputImageSizePixelsX = outputImageExtent[1] - outputImageExtent[0] + 1;
-  int outputImageSizePixelsY = outputImageExtent[3] - outputImageExtent[2] + 1;
+  double intensityScaling = this->InterpIntensityScaling;
+  bool fixedPoint = ( this->InterpInterpolationMode == INTERPOLATION_FIXED_POINT );
+  const double fixedPointOne = 1 << FIXED_POINT_WEIGHT_BITS;
 
   // Increments in image coordinates in mm
-  double dx = outputImageSpacing[0];
-  double dz = outputImageSpacing[1];
+  double dx = this->InterpOutputImageSpacing[0];
+  double dz = this->InterpOutputImageSpacing[1];
 
   // Starting depth in image coordinates in mm
   double z = radiusStartMm - this->InterpTransducerCenterPixel[1] * dz;
@@ -178,20 +317,50 @@ void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
            ( index_line >= 0 ) && ( index_line + 1 < numberOfLines ) )
       {
         // The sample is inside the input image, so it can be computed
-        InterpolatedPoint ip;
         double samp_val = samp - index_samp; // Sub-sample fraction for interpolation
         double line_val = line - index_line; // Sub-line fraction for interpolation
 
         //  Calculate the coefficients
-        ip.weightCoefficients[0] = ( 1 - samp_val ) * ( 1 - line_val ) * intensityScaling;
-        ip.weightCoefficients[1] =    samp_val * ( 1 - line_val ) * intensityScaling;
-        ip.weightCoefficients[2] = ( 1 - samp_val ) * line_val   * intensityScaling;
-        ip.weightCoefficients[3] =    samp_val * line_val   * intensityScaling;
-
-        ip.inputPixelIndex = index_samp + index_line * numberOfSamples;
-        ip.outputPixelIndex = j + outputImageSizePixelsX * i;
-
-        this->InterpolatedPointArray.push_back( ip );
+        if ( fixedPoint )
+        {
+          // Round the weights and make sure that they add up to exactly 1.0 by adjusting the largest one
+          double weights[4] =
+          {
+            ( 1 - samp_val ) * ( 1 - line_val ),
+            samp_val * ( 1 - line_val ),
+            ( 1 - samp_val ) * line_val,
+            samp_val * line_val
+          };
+          int fixedPointWeights[4] = {0};
+          int sumOfWeights = 0;
+          int largestWeightIndex = 0;
+          for ( int w = 0; w < 4; w++ )
+          {
+            fixedPointWeights[w] = static_cast<int>( floor( weights[w] * fixedPointOne + 0.5 ) );
+            sumOfWeights += fixedPointWeights[w];
+            if ( fixedPointWeights[w] > fixedPointWeights[largestWeightIndex] )
+            {
+              largestWeightIndex = w;
+            }
+          }
+          fixedPointWeights[largestWeightIndex] += ( 1 << FIXED_POINT_WEIGHT_BITS ) - sumOfWeights;
+          for ( int w = 0; w < 4; w++ )
+          {
+            this->Table.FixedPointWeights[w].push_back( static_cast<unsigned short>( fixedPointWeights[w] ) );
+          }
+        }
+        else
+        {
+          this->Table.Weights[0].push_back( ( 1 - samp_val ) * ( 1 - line_val ) * intensityScaling );
+          this->Table.Weights[1].push_back(    samp_val * ( 1 - line_val ) * intensityScaling );
+          this->Table.Weights[2].push_back( ( 1 - samp_val ) * line_val   * intensityScaling );
+          this->Table.Weights[3].push_back(    samp_val * line_val   * intensityScaling );
+        }
+
+        this->Table.InputSample.push_back( static_cast<short>( index_samp ) );
+        this->Table.InputLine.push_back( static_cast<short>( index_line ) );
+        this->Table.OutputColumn.push_back( static_cast<short>( j ) );
+        this->Table.OutputRow.push_back( static_cast<short>( i ) );
       }
 
       x = x + dx;
@@ -199,6 +368,209 @@ void vtkPlusUsScanConvertCurvilinear::ComputeInterpolatedPointArray(
     z = z + dz;
   }
 
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusUsScanConvertCurvilinear::GetInterpolationTableCacheKey()
+{
+  std::ostringstream key;
+  key << std::setprecision( 17 ) << this->GetTransducerGeometry()
+      << " InterpolationMode=" << this->InterpInterpolationMode
+      << " InputImageExtent=";
+  for ( int i = 0; i < 6; i++ )
+  {
+    key << this->InterpInputImageExtent[i] << ( i < 5 ? "," : "" );
+  }
+  key << " OutputImageExtent=";
+  for ( int i = 0; i < 6; i++ )
+  {
+    key << this->InterpOutputImageExtent[i] << ( i < 5 ? "," : "" );
+  }
+  key << " OutputImageSpacing=" << this->InterpOutputImageSpacing[0] << "," << this->InterpOutputImageSpacing[1] << "," << this->InterpOutputImageSpacing[2]
+      << " Radius=" << this->InterpRadiusStartMm << "," << this->InterpRadiusStopMm
+      << " Theta=" << this->InterpThetaStartDeg << "," << this->InterpThetaStopDeg
+      << " TransducerCenterPixel=" << this->InterpTransducerCenterPixel[0] << "," << this->InterpTransducerCenterPixel[1];
+  if ( this->InterpInterpolationMode == INTERPOLATION_DOUBLE )
+  {
+    // intensity scaling is only included in double precision weights
+    key << " IntensityScaling=" << this->InterpIntensityScaling;
+  }
+  return key.str();
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusUsScanConvertCurvilinear::GetInterpolationTableCacheFilePath()
+{
+  std::string cacheDirectory = this->InterpolationTableCacheDirectory;
+  if ( !vtksys::SystemTools::FileIsFullPath( cacheDirectory.c_str() ) )
+  {
+    cacheDirectory = vtkPlusConfig::GetInstance()->GetOutputPath( cacheDirectory );
+  }
+  std::ostringstream fileName;
+  fileName << "ScanConvertCurvilinear_" << std::hex << std::setw( 16 ) << std::setfill( '0' ) << ComputeFnv1aHash( this->GetInterpolationTableCacheKey() ) << ".lut";
+  return cacheDirectory + "/" + fileName.str();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusUsScanConvertCurvilinear::ReadInterpolationTableFromCache()
+{
+  std::string filePath = this->GetInterpolationTableCacheFilePath();
+  std::ifstream file( filePath.c_str(), std::ios::in | std::ios::binary );
+  if ( !file.is_open() )
+  {
+    LOG_DEBUG( "Scan conversion interpolation table is not found in cache: " << filePath );
+    return PLUS_FAIL;
+  }
+
+  // Header
+  char magic[sizeof( INTERPOLATION_TABLE_FILE_MAGIC )] = {0};
+  int version = 0;
+  unsigned int byteOrderMark = 0;
+  file.read( magic, sizeof( magic ) );
+  file.read( reinterpret_cast<char*>( &version ), sizeof( version ) );
+  file.read( reinterpret_cast<char*>( &byteOrderMark ), sizeof( byteOrderMark ) );
+  if ( !file.good() || memcmp( magic, INTERPOLATION_TABLE_FILE_MAGIC, sizeof( magic ) ) != 0
+       || version != INTERPOLATION_TABLE_FILE_VERSION || byteOrderMark != INTERPOLATION_TABLE_BYTE_ORDER_MARK )
+  {
+    LOG_WARNING( "Ignoring scan conversion interpolation table cache file " << filePath << ": invalid header" );
+    return PLUS_FAIL;
+  }
+
+  // The full key is stored in the file to detect file name hash collisions
+  std::string expectedKey = this->GetInterpolationTableCacheKey();
+  unsigned int keyLength = 0;
+  file.read( reinterpret_cast<char*>( &keyLength ), sizeof( keyLength ) );
+  if ( !file.good() || keyLength != expectedKey.size() )
+  {
+    LOG_DEBUG( "Scan conversion interpolation table cache file " << filePath << " was created for different parameters" );
+    return PLUS_FAIL;
+  }
+  std::string key( keyLength, ' ' );
+  file.read( &key[0], keyLength );
+  if ( !file.good() || key != expectedKey )
+  {
+    LOG_DEBUG( "Scan conversion interpolation table cache file " << filePath << " was created for different parameters" );
+    return PLUS_FAIL;
+  }
+
+  // Table
+  this->Table.Clear();
+  int outputImageSizePixelsX = 0;
+  int numberOfSamples = 0;
+  unsigned long long numberOfPoints = 0;
+  file.read( reinterpret_cast<char*>( &outputImageSizePixelsX ), sizeof( outputImageSizePixelsX ) );
+  file.read( reinterpret_cast<char*>( &numberOfSamples ), sizeof( numberOfSamples ) );
+  file.read( reinterpret_cast<char*>( &numberOfPoints ), sizeof( numberOfPoints ) );
+  int outputImageSizePixelsY = this->InterpOutputImageExtent[3] - this->InterpOutputImageExtent[2] + 1;
+  int numberOfLines = this->InterpInputImageExtent[3] - this->InterpInputImageExtent[2] + 1;
+  bool valid = file.good()
+               && outputImageSizePixelsX == this->InterpOutputImageExtent[1] - this->InterpOutputImageExtent[0] + 1
+               && numberOfSamples == this->InterpInputImageExtent[1] - this->InterpInputImageExtent[0] + 1
+               && numberOfPoints <= static_cast<unsigned long long>( outputImageSizePixelsX ) * outputImageSizePixelsY;
+  size_t numberOfTablePoints = valid ? static_cast<size_t>( numberOfPoints ) : 0;
+  valid = valid
+          && ReadArray( file, this->Table.OutputColumn, numberOfTablePoints )
+          && ReadArray( file, this->Table.OutputRow, numberOfTablePoints )
+          && ReadArray( file, this->Table.InputSample, numberOfTablePoints )
+          && ReadArray( file, this->Table.InputLine, numberOfTablePoints );
+  for ( int i = 0; i < 4 && valid; i++ )
+  {
+    if ( this->InterpInterpolationMode == INTERPOLATION_FIXED_POINT )
+    {
+      valid = ReadArray( file, this->Table.FixedPointWeights[i], numberOfTablePoints );
+    }
+    else
+    {
+      valid = ReadArray( file, this->Table.Weights[i], numberOfTablePoints );
+    }
+  }
+  // Make sure that a corrupted file does not lead to reading or writing outside of the images
+  valid = valid
+          && IsIndexArrayValid( this->Table.OutputColumn, outputImageSizePixelsX - 1 )
+          && IsIndexArrayValid( this->Table.OutputRow, outputImageSizePixelsY - 1 )
+          && IsIndexArrayValid( this->Table.InputSample, numberOfSamples - 2 )
+          && IsIndexArrayValid( this->Table.InputLine, numberOfLines - 2 );
+  if ( !valid )
+  {
+    LOG_WARNING( "Ignoring scan conversion interpolation table cache file " << filePath << ": file is corrupted" );
+    this->Table.Clear();
+    return PLUS_FAIL;
+  }
+  this->Table.Mode = this->InterpInterpolationMode;
+  this->Table.IntensityScaling = this->InterpIntensityScaling;
+  this->Table.OutputImageSizePixelsX = outputImageSizePixelsX;
+  this->Table.NumberOfSamples = numberOfSamples;
+
+  LOG_DEBUG( "Scan conversion interpolation table is loaded from cache: " << filePath );
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusUsScanConvertCurvilinear::WriteInterpolationTableToCache()
+{
+  std::string filePath = this->GetInterpolationTableCacheFilePath();
+  std::string directory = vtksys::SystemTools::GetFilenamePath( filePath );
+  if ( !vtksys::SystemTools::MakeDirectory( directory.c_str() ) )
+  {
+    LOG_WARNING( "Unable to create scan conversion interpolation table cache directory: " << directory );
+    return PLUS_FAIL;
+  }
+
+  // Write to a temporary file first and then rename it, so that other processes never see a partially written file
+  std::string temporaryFilePath = filePath + ".tmp";
+  {
+    std::ofstream file( temporaryFilePath.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+    if ( !file.is_open() )
+    {
+      LOG_WARNING( "Unable to write scan conversion interpolation table cache file: " << temporaryFilePath );
+      return PLUS_FAIL;
+    }
+
+    std::string key = this->GetInterpolationTableCacheKey();
+    unsigned int keyLength = static_cast<unsigned int>( key.size() );
+    unsigned long long numberOfPoints = this->Table.GetNumberOfPoints();
+    file.write( INTERPOLATION_TABLE_FILE_MAGIC, sizeof( INTERPOLATION_TABLE_FILE_MAGIC ) );
+    file.write( reinterpret_cast<const char*>( &INTERPOLATION_TABLE_FILE_VERSION ), sizeof( INTERPOLATION_TABLE_FILE_VERSION ) );
+    file.write( reinterpret_cast<const char*>( &INTERPOLATION_TABLE_BYTE_ORDER_MARK ), sizeof( INTERPOLATION_TABLE_BYTE_ORDER_MARK ) );
+    file.write( reinterpret_cast<const char*>( &keyLength ), sizeof( keyLength ) );
+    file.write( key.c_str(), keyLength );
+    file.write( reinterpret_cast<const char*>( &this->Table.OutputImageSizePixelsX ), sizeof( this->Table.OutputImageSizePixelsX ) );
+    file.write( reinterpret_cast<const char*>( &this->Table.NumberOfSamples ), sizeof( this->Table.NumberOfSamples ) );
+    file.write( reinterpret_cast<const char*>( &numberOfPoints ), sizeof( numberOfPoints ) );
+    WriteArray( file, this->Table.OutputColumn );
+    WriteArray( file, this->Table.OutputRow );
+    WriteArray( file, this->Table.InputSample );
+    WriteArray( file, this->Table.InputLine );
+    for ( int i = 0; i < 4; i++ )
+    {
+      if ( this->InterpInterpolationMode == INTERPOLATION_FIXED_POINT )
+      {
+        WriteArray( file, this->Table.FixedPointWeights[i] );
+      }
+      else
+      {
+        WriteArray( file, this->Table.Weights[i] );
+      }
+    }
+    if ( !file.good() )
+    {
+      LOG_WARNING( "Failed to write scan conversion interpolation table cache file: " << temporaryFilePath );
+      file.close();
+      vtksys::SystemTools::RemoveFile( temporaryFilePath );
+      return PLUS_FAIL;
+    }
+  }
+
+  if ( !vtksys::SystemTools::RenameFile( temporaryFilePath.c_str(), filePath.c_str() ) )
+  {
+    LOG_WARNING( "Failed to rename scan conversion interpolation table cache file " << temporaryFilePath << " to " << filePath );
+    vtksys::SystemTools::RemoveFile( temporaryFilePath );
+    return PLUS_FAIL;
+  }
+
+  LOG_DEBUG( "Scan conversion interpolation table is saved to cache: " << filePath );
+  return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
@@ -288,22 +660,71 @@ void vtkPlusUsScanConvertExecute( vtkPlusUsScanConvertCurvilinear* self,
                                   vtkImageData* outData, T* outPtr,
                                   int interpolationTableExt[6], int id )
 {
-  T* envelope_data = inPtr; // The envelope detected and log-compressed data
-  int numberOfSamples = inData->GetExtent()[1] - inData->GetExtent()[0] + 1; // Number of samples in one envelope line
-
+  const T* envelope_data = inPtr; // The envelope detected and log-compressed data
   T* image = outPtr; // The resulting image
 
-  std::vector<vtkPlusUsScanConvertCurvilinear::InterpolatedPoint>::const_iterator firstPoint = self->GetInterpolatedPointArray().begin() + interpolationTableExt[0];
-  std::vector<vtkPlusUsScanConvertCurvilinear::InterpolatedPoint>::const_iterator afterLastPoint = self->GetInterpolatedPointArray().begin() + interpolationTableExt[1] + 1;
-  for ( std::vector<vtkPlusUsScanConvertCurvilinear::InterpolatedPoint>::const_iterator it = firstPoint; it != afterLastPoint; ++it )
+  const vtkPlusUsScanConvertCurvilinear::InterpolationTable& table = self->GetInterpolationTable();
+  const int numberOfSamples = table.NumberOfSamples; // Number of samples in one envelope line
+  const int outputImageSizePixelsX = table.OutputImageSizePixelsX;
+  const short* outputColumn = &table.OutputColumn[0];
+  const short* outputRow = &table.OutputRow[0];
+  const short* inputSample = &table.InputSample[0];
+  const short* inputLine = &table.InputLine[0];
+  const int firstPoint = interpolationTableExt[0];
+  const int lastPoint = interpolationTableExt[1];
+
+  if ( table.Mode == vtkPlusUsScanConvertCurvilinear::INTERPOLATION_FIXED_POINT )
+  {
+    const unsigned short* w0 = &table.FixedPointWeights[0][0];
+    const unsigned short* w1 = &table.FixedPointWeights[1][0];
+    const unsigned short* w2 = &table.FixedPointWeights[2][0];
+    const unsigned short* w3 = &table.FixedPointWeights[3][0];
+    const int weightBits = vtkPlusUsScanConvertCurvilinear::FIXED_POINT_WEIGHT_BITS;
+    const double intensityScaling = table.IntensityScaling;
+    if ( std::numeric_limits<T>::is_integer && sizeof( T ) <= 2 && intensityScaling == 1.0 )
+    {
+      // Integer arithmetic: the weights sum up to 1<<weightBits, so the sum fits into 32 bits for 8 and 16-bit pixels
+      for ( int i = firstPoint; i <= lastPoint; ++i )
+      {
+        const T* env_pointer = envelope_data + inputLine[i] * numberOfSamples + inputSample[i]; // Pointer to the envelope data
+        int value = w0[i] * static_cast<int>( env_pointer[0] ) // (+0, +0)
+                    + w1[i] * static_cast<int>( env_pointer[1] ) // (+1, +0)
+                    + w2[i] * static_cast<int>( env_pointer[numberOfSamples] ) // (+0, +1)
+                    + w3[i] * static_cast<int>( env_pointer[numberOfSamples + 1] ); // (+1, +1)
+        image[outputRow[i] * outputImageSizePixelsX + outputColumn[i]] = static_cast<T>( ( value + ( 1 << ( weightBits - 1 ) ) ) >> weightBits ); // with rounding
+      }
+    }
+    else
+    {
+      const double weightScaling = intensityScaling / ( 1 << weightBits );
+      for ( int i = firstPoint; i <= lastPoint; ++i )
+      {
+        const T* env_pointer = envelope_data + inputLine[i] * numberOfSamples + inputSample[i]; // Pointer to the envelope data
+        image[outputRow[i] * outputImageSizePixelsX + outputColumn[i]] = static_cast<T>(
+              ( w0[i] * static_cast<double>( env_pointer[0] ) // (+0, +0)
+                + w1[i] * static_cast<double>( env_pointer[1] ) // (+1, +0)
+                + w2[i] * static_cast<double>( env_pointer[numberOfSamples] ) // (+0, +1)
+                + w3[i] * static_cast<double>( env_pointer[numberOfSamples + 1] ) ) * weightScaling // (+1, +1)
+              + 0.5 ); // for rounding
+      }
+    }
+  }
+  else
   {
-    T* env_pointer = ( T* ) & ( envelope_data[it->inputPixelIndex] ); // Pointer to the envelope data
-    image[it->outputPixelIndex] =
-      it->weightCoefficients[0] * env_pointer[0] // (+0, +0)
-      + it->weightCoefficients[1] * env_pointer[1] // (+1, +0)
-      + it->weightCoefficients[2] * env_pointer[numberOfSamples] // (+0, +1)
-      + it->weightCoefficients[3] * env_pointer[numberOfSamples + 1] // (+1, +1)
-      + 0.5; // for rounding
+    const double* w0 = &table.Weights[0][0];
+    const double* w1 = &table.Weights[1][0];
+    const double* w2 = &table.Weights[2][0];
+    const double* w3 = &table.Weights[3][0];
+    for ( int i = firstPoint; i <= lastPoint; ++i )
+    {
+      const T* env_pointer = envelope_data + inputLine[i] * numberOfSamples + inputSample[i]; // Pointer to the envelope data
+      image[outputRow[i] * outputImageSizePixelsX + outputColumn[i]] =
+        w0[i] * env_pointer[0] // (+0, +0)
+        + w1[i] * env_pointer[1] // (+1, +0)
+        + w2[i] * env_pointer[numberOfSamples] // (+0, +1)
+        + w3[i] * env_pointer[numberOfSamples + 1] // (+1, +1)
+        + 0.5; // for rounding
+    }
   }
 }
 
@@ -317,6 +738,12 @@ void vtkPlusUsScanConvertCurvilinear::ThreadedRequestData(
   int outExt[6], int id )
 {
 
+  if ( this->Table.GetNumberOfPoints() == 0 )
+  {
+    // nothing to interpolate, the output is already filled with zeros
+    return;
+  }
+
   void* inPtr = inData[0][0]->GetScalarPointer();
   void* outPtr = outData[0]->GetScalarPointer();
 
@@ -354,7 +781,10 @@ void vtkPlusUsScanConvertCurvilinear::PrintSelf( ostream& os, vtkIndent indent )
   os << indent << "ThetaStartDeg: " << this->ThetaStartDeg << "\n";
   os << indent << "ThetaStopDeg: " << this->ThetaStopDeg << "\n";
   os << indent << "OutputIntensityScaling: " << this->OutputIntensityScaling << "\n";
-  os << indent << "InterpolatedPointArraySize: " << this->InterpolatedPointArray.size() << "\n";
+  os << indent << "InterpolationMode: " << ( this->InterpolationMode == INTERPOLATION_FIXED_POINT ? "FIXED_POINT" : "DOUBLE" ) << "\n";
+  os << indent << "InterpolationTableCacheDirectory: " << this->InterpolationTableCacheDirectory << "\n";
+  os << indent << "InterpolationTableSize: " << this->Table.GetNumberOfPoints() << "\n";
+  os << indent << "InterpolationTableSetupTimeSec: " << this->InterpolationTableSetupTimeSec << ( this->InterpolationTableLoadedFromCache ? " (loaded from cache)" : "" ) << "\n";
 
 }
 
@@ -371,7 +801,7 @@ int vtkPlusUsScanConvertCurvilinear::SplitExtent( int splitExt[6], int startExt[
 
   // Starting extent
   int min = 0;
-  int max = this->InterpolatedPointArray.size() - 1;
+  int max = static_cast<int>( this->Table.GetNumberOfPoints() ) - 1;
 
   splitExt[0] = min;
   splitExt[1] = max;
@@ -447,6 +877,9 @@ PlusStatus vtkPlusUsScanConvertCurvilinear::ReadConfiguration( vtkXMLDataElement
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL( double, ThetaStartDeg, scanConversionElement );
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL( double, ThetaStopDeg, scanConversionElement );
 
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL( InterpolationMode, scanConversionElement, "DOUBLE", INTERPOLATION_DOUBLE, "FIXED_POINT", INTERPOLATION_FIXED_POINT );
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL( InterpolationTableCacheDirectory, scanConversionElement );
+
   return PLUS_SUCCESS;
 }
 
@@ -465,6 +898,9 @@ PlusStatus vtkPlusUsScanConvertCurvilinear::WriteConfiguration( vtkXMLDataElemen
   scanConversionElement->SetDoubleAttribute( "ThetaStartDeg", this->ThetaStartDeg );
   scanConversionElement->SetDoubleAttribute( "ThetaStopDeg", this->ThetaStopDeg );
 
+  scanConversionElement->SetAttribute( "InterpolationMode", this->InterpolationMode == INTERPOLATION_FIXED_POINT ? "FIXED_POINT" : "DOUBLE" );
+  XML_WRITE_STRING_ATTRIBUTE_REMOVE_IF_EMPTY( InterpolationTableCacheDirectory, scanConversionElement );
+
   return PLUS_SUCCESS;
 }
 
@@ -13,6 +13,13 @@ See License.txt for details.
 /*!
 \class vtkPlusUsScanConvertCurvilinear
 \brief This class performs scan conversion from scan lines for curvilinear probes
+
+Each output pixel is interpolated from 4 input pixels. The input pixel positions and weights are
+computed once for each transducer geometry and stored in a lookup table (InterpolationTable).
+The table can be stored on disk (see InterpolationTableCacheDirectory) so that it does not have to be
+recomputed when the application is restarted. The interpolation is performed on multiple threads,
+each thread processes a range of the lookup table.
+
 \ingroup PlusLibImageProcessingAlgo
 */
 class vtkPlusImageProcessingExport vtkPlusUsScanConvertCurvilinear : public vtkPlusUsScanConvert
@@ -36,22 +43,72 @@ public:
   /*! Get the scan converted image */
   virtual vtkImageData* GetOutput();
 
-  struct InterpolatedPoint
+  enum InterpolationModeType
+  {
+    /*! Double precision weights (default, reproduces the output of earlier Plus versions exactly) */
+    INTERPOLATION_DOUBLE,
+    /*! 16-bit fixed-point weights, integer arithmetic for 8 and 16-bit images. The output may differ by 1 gray level from INTERPOLATION_DOUBLE. */
+    INTERPOLATION_FIXED_POINT
+  };
+
+  /*! Number of fractional bits of the fixed-point weights. The 4 weights of a pixel sum up to 1<<FIXED_POINT_WEIGHT_BITS. */
+  static const int FIXED_POINT_WEIGHT_BITS = 15;
+
+  /*!
+    Lookup table for computing the output image, stored as structure of arrays.
+    The i-th output pixel (OutputColumn[i], OutputRow[i]) is computed from the input pixels
+    (InputSample[i]+0/1, InputLine[i]+0/1) using the i-th weights.
+  */
+  struct InterpolationTable
   {
-    /*! Weighting coefficients that used to construct the output pixel from 4 input pixels */
-    double weightCoefficients[4];
-    /*! Position of the first input pixel that is used to construct the output point (in the sample line matrix). The 3 others are one row/column away. */
-    int inputPixelIndex;
-    // Position of the output pixel (in the image matrix) */
-    int outputPixelIndex;
+    InterpolationTable() : Mode(INTERPOLATION_DOUBLE), IntensityScaling(1.0), OutputImageSizePixelsX(0), NumberOfSamples(0) {}
+    void Clear();
+    size_t GetNumberOfPoints() const { return this->OutputColumn.size(); }
+
+    /*! Interpolation arithmetic that the table is computed for */
+    InterpolationModeType Mode;
+    /*! Intensity scaling factor from envelope to image */
+    double IntensityScaling;
+
+    /*! Number of columns of the output image */
+    int OutputImageSizePixelsX;
+    /*! Number of samples in a scanline of the input image */
+    int NumberOfSamples;
+
+    std::vector<short> OutputColumn;
+    std::vector<short> OutputRow;
+    std::vector<short> InputSample;
+    std::vector<short> InputLine;
+
+    /*! Weights of the (+0,+0), (+1,+0), (+0,+1), (+1,+1) input pixels, including intensity scaling. Used in INTERPOLATION_DOUBLE mode. */
+    std::vector<double> Weights[4];
+    /*! Weights of the (+0,+0), (+1,+0), (+0,+1), (+1,+1) input pixels, without intensity scaling. Used in INTERPOLATION_FIXED_POINT mode. */
+    std::vector<unsigned short> FixedPointWeights[4];
   };
 
-  /*! Retrieve the InterpolatedPointArray (used internally by the thread function) */
-  const std::vector<InterpolatedPoint>& GetInterpolatedPointArray()
+  /*! Retrieve the interpolation table (used internally by the thread function) */
+  const InterpolationTable& GetInterpolationTable() const
   {
-    return this->InterpolatedPointArray;
+    return this->Table;
   };
 
+  /*! Set the interpolation arithmetic. Default is INTERPOLATION_DOUBLE. */
+  vtkSetMacro(InterpolationMode, InterpolationModeType);
+  vtkGetMacro(InterpolationMode, InterpolationModeType);
+
+  /*!
+    Directory where computed interpolation tables are stored and looked up. Relative paths are relative to the output directory.
+    If empty (default) then interpolation tables are not stored on disk.
+  */
+  vtkSetStdStringMacro(InterpolationTableCacheDirectory);
+  vtkGetStdStringMacro(InterpolationTableCacheDirectory);
+
+  /*! Time spent with computing (or loading from the cache) the current interpolation table */
+  vtkGetMacro(InterpolationTableSetupTimeSec, double);
+
+  /*! True if the current interpolation table was loaded from the cache directory */
+  vtkGetMacro(InterpolationTableLoadedFromCache, bool);
+
   /*! Initialize the parameters used in reconstruction. These are for the cases when video source can obtain them from the hardware */
   vtkSetMacro(RadiusStartMm, double);
   vtkGetMacro(RadiusStartMm, double);
@@ -109,8 +166,17 @@ protected:
   /*! Intensity scaling factor from envelope to image */
   double OutputIntensityScaling;
 
-  /*! Each element of this array defines the computation of a pixel in the output (scan converted) image.  */
-  std::vector<InterpolatedPoint> InterpolatedPointArray;
+  /*! Interpolation arithmetic */
+  InterpolationModeType InterpolationMode;
+
+  /*! Each element of this table defines the computation of a pixel in the output (scan converted) image.  */
+  InterpolationTable Table;
+
+  /*! Directory of the interpolation table cache files. Empty if caching is disabled. */
+  std::string InterpolationTableCacheDirectory;
+
+  double InterpolationTableSetupTimeSec;
+  bool InterpolationTableLoadedFromCache;
 
   int InterpInputImageExtent[6];
   double InterpRadiusStartMm;
@@ -121,16 +187,36 @@ protected:
   double InterpOutputImageSpacing[3];
   double InterpTransducerCenterPixel[2];
   double InterpIntensityScaling;
+  InterpolationModeType InterpInterpolationMode;
 
   /*!
-    Computes the InterpolatedPointArray from the method arguments. The array is not recomputed if
-    the input arguments are the same as last time.
+    Computes the interpolation table from the method arguments. The table is not recomputed if
+    the input arguments are the same as last time. If a cache directory is set then the table is loaded
+    from there if available, and saved there after it is computed.
   */
   void ComputeInterpolatedPointArray(
     int* inputImageExtent, double radiusStartMm, double radiusStopMm, double thetaStartDeg, double thetaStopDeg,
     int* outputImageExtent, double* outputImageSpacing, double* transducerCenterPixel, double intensityScaling
   );
 
+  /*! Set the Interp* parameters to values that do not match any scan conversion parameters, so that the interpolation table is recomputed */
+  void ResetInterpolationParameters();
+
+  /*! Fill the interpolation table from the Interp* parameters */
+  PlusStatus ComputeInterpolationTable();
+
+  /*! Returns a string that uniquely identifies the Interp* parameters, used as interpolation table cache key */
+  std::string GetInterpolationTableCacheKey();
+
+  /*! Full path of the interpolation table cache file of the current Interp* parameters */
+  std::string GetInterpolationTableCacheFilePath();
+
+  /*! Read the interpolation table of the current Interp* parameters from the cache directory */
+  PlusStatus ReadInterpolationTableFromCache();
+
+  /*! Write the interpolation table of the current Interp* parameters to the cache directory */
+  PlusStatus WriteInterpolationTableToCache();
+
 private:
   vtkPlusUsScanConvertCurvilinear(const vtkPlusUsScanConvertCurvilinear&);  // Not implemented.
   void operator=(const vtkPlusUsScanConvertCurvilinear&);  // Not implemented.
@@ -0,0 +1,103 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusIgtlMessageCache.h"
+
+// STL includes
+#include <sstream>
+
+//----------------------------------------------------------------------------
+double PlusIgtlMessageCache::Statistics::GetHitRate() const
+{
+  if (this->NumberOfLookups == 0)
+  {
+    return 0.0;
+  }
+  return static_cast<double>(this->NumberOfHits) / this->NumberOfLookups;
+}
+
+//----------------------------------------------------------------------------
+double PlusIgtlMessageCache::Statistics::GetAveragePackTimeSec() const
+{
+  if (this->NumberOfPackCalls == 0)
+  {
+    return 0.0;
+  }
+  return this->TotalPackTimeSec / this->NumberOfPackCalls;
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlMessageCache::PlusIgtlMessageCache()
+{
+
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlMessageCache::BeginFrame()
+{
+  this->Messages.clear();
+  this->CacheStatistics.NumberOfFrames++;
+}
+
+//----------------------------------------------------------------------------
+igtl::MessageBase::Pointer PlusIgtlMessageCache::FindMessage(const std::string& key)
+{
+  this->CacheStatistics.NumberOfLookups++;
+  MessageMapType::iterator messageIt = this->Messages.find(key);
+  if (messageIt == this->Messages.end())
+  {
+    return NULL;
+  }
+  this->CacheStatistics.NumberOfHits++;
+  return messageIt->second;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlMessageCache::AddMessage(const std::string& key, igtl::MessageBase::Pointer message)
+{
+  if (message.IsNull())
+  {
+    return;
+  }
+  this->Messages[key] = message;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlMessageCache::AddPackTime(double packTimeSec)
+{
+  this->CacheStatistics.NumberOfPackCalls++;
+  this->CacheStatistics.TotalPackTimeSec += packTimeSec;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusIgtlMessageCache::GetMessageKey(const std::string& messageType, int headerVersion, const std::string& name, const std::string& encoding/*=""*/)
+{
+  std::ostringstream key;
+  key << messageType << "|" << headerVersion << "|" << name << "|" << encoding;
+  return key.str();
+}
+
+//----------------------------------------------------------------------------
+const PlusIgtlMessageCache::Statistics& PlusIgtlMessageCache::GetStatistics() const
+{
+  return this->CacheStatistics;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlMessageCache::ResetStatistics()
+{
+  this->CacheStatistics = Statistics();
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlMessageCache::PrintSelf(ostream& os, vtkIndent indent)
+{
+  os << indent << "Number of frames: " << this->CacheStatistics.NumberOfFrames << std::endl;
+  os << indent << "Average pack time per client and frame: " << this->CacheStatistics.GetAveragePackTimeSec() * 1000.0 << " ms" << std::endl;
+  os << indent << "Cache lookups: " << this->CacheStatistics.NumberOfLookups << std::endl;
+  os << indent << "Cache hit rate: " << this->CacheStatistics.GetHitRate() * 100.0 << "%" << std::endl;
+}
@@ -0,0 +1,92 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIgtlMessageCache_h
+#define __PlusIgtlMessageCache_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusOpenIGTLinkExport.h"
+
+// IGTL includes
+#include <igtlMessageBase.h>
+
+// STL includes
+#include <map>
+#include <string>
+
+/*!
+  \class PlusIgtlMessageCache
+  \brief Stores the IGTL messages packed from one tracked frame so that they can be sent to multiple clients
+
+  Messages are identified by a key made of the message type, header version, device or transform names
+  and encoding. If several clients request the same message then it is packed (serialized, CRC computed)
+  only once and the same message buffer is sent to all of them. Messages must not be modified after
+  they are added to the cache.
+
+  The cache is only valid for a single tracked frame, call BeginFrame before packing messages from a new frame.
+  The class is not thread-safe, the caller is responsible for synchronizing access.
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport PlusIgtlMessageCache
+{
+public:
+  /*! Pack time and cache usage statistics */
+  struct Statistics
+  {
+    Statistics() : NumberOfFrames(0), NumberOfPackCalls(0), TotalPackTimeSec(0), NumberOfLookups(0), NumberOfHits(0) {}
+    /*! Number of tracked frames that messages were packed from */
+    unsigned long long NumberOfFrames;
+    /*! Number of times messages were packed for a client */
+    unsigned long long NumberOfPackCalls;
+    /*! Total time spent with packing messages (including cache lookups) */
+    double TotalPackTimeSec;
+    /*! Number of messages that were looked up in the cache */
+    unsigned long long NumberOfLookups;
+    /*! Number of messages that were found in the cache and so did not have to be packed again */
+    unsigned long long NumberOfHits;
+    /*! Ratio of the lookups that were found in the cache (0 if there were no lookups) */
+    double GetHitRate() const;
+    /*! Average time needed to pack all messages of a frame for a client */
+    double GetAveragePackTimeSec() const;
+  };
+
+  PlusIgtlMessageCache();
+
+  /*! Remove all messages of the previous tracked frame */
+  void BeginFrame();
+
+  /*!
+    Get a previously packed message
+    \return NULL if the message is not in the cache
+  */
+  igtl::MessageBase::Pointer FindMessage(const std::string& key);
+
+  /*! Add a packed message to the cache */
+  void AddMessage(const std::string& key, igtl::MessageBase::Pointer message);
+
+  /*! Add the time spent with packing the messages for a client */
+  void AddPackTime(double packTimeSec);
+
+  /*! Create a cache key from the message type, header version and a name that identifies the message content */
+  static std::string GetMessageKey(const std::string& messageType, int headerVersion, const std::string& name, const std::string& encoding = "");
+
+  const Statistics& GetStatistics() const;
+  void ResetStatistics();
+
+  void PrintSelf(ostream& os, vtkIndent indent);
+
+protected:
+  typedef std::map<std::string, igtl::MessageBase::Pointer> MessageMapType;
+
+  /*! Messages packed from the current tracked frame */
+  MessageMapType Messages;
+
+  Statistics CacheStatistics;
+};
+
+#endif
@@ -47,6 +47,46 @@ See License.txt for details.
 
 vtkStandardNewMacro(vtkPlusIgtlMessageFactory);
 
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Add the message to the output list if it has already been packed from the same frame for another client
+  bool AddCachedMessage(PlusIgtlMessageCache* messageCache, const std::string& key, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+  {
+    if (messageCache == NULL)
+    {
+      return false;
+    }
+    igtl::MessageBase::Pointer message = messageCache->FindMessage(key);
+    if (message.IsNull())
+    {
+      return false;
+    }
+    igtlMessages.push_back(message);
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void AddMessageToCache(PlusIgtlMessageCache* messageCache, const std::string& key, igtl::MessageBase::Pointer message)
+  {
+    if (messageCache != NULL)
+    {
+      messageCache->AddMessage(key, message);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetTransformNamesKey(const std::vector<igsioTransformName>& transformNames)
+  {
+    std::string key;
+    for (std::vector<igsioTransformName>::const_iterator nameIt = transformNames.begin(); nameIt != transformNames.end(); ++nameIt)
+    {
+      key += nameIt->GetTransformName() + ",";
+    }
+    return key;
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkPlusIgtlMessageFactory::vtkPlusIgtlMessageFactory()
   : IgtlFactory(igtl::MessageFactory::New())
@@ -140,7 +180,7 @@ igtl::MessageBase::Pointer vtkPlusIgtlMessageFactory::CreateSendMessage(const st
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlClientInfo& clientInfo, std::vector<igtl::MessageBase::Pointer>& igtlMessages, igsioTrackedFrame& trackedFrame,
-    bool packValidTransformsOnly, vtkIGSIOTransformRepository* transformRepository/*=NULL*/)
+    bool packValidTransformsOnly, vtkIGSIOTransformRepository* transformRepository/*=NULL*/, PlusIgtlMessageCache* messageCache/*=NULL*/)
 {
   int numberOfErrors(0);
   igtlMessages.clear();
@@ -173,7 +213,7 @@ PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlC
 
     if (typeid(*igtlMessage) == typeid(igtl::ImageMessage))
     {
-      numberOfErrors += PackImageMessage(clientInfo, *transformRepository, messageType, igtlMessage, trackedFrame, igtlMessages, clientId);
+      numberOfErrors += PackImageMessage(clientInfo, *transformRepository, messageType, igtlMessage, trackedFrame, igtlMessages, clientId, messageCache);
     }
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
     else if (typeid(*igtlMessage) == typeid(igtl::VideoMessage))
@@ -183,15 +223,15 @@ PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlC
 #endif
     else if (typeid(*igtlMessage) == typeid(igtl::TransformMessage))
     {
-      numberOfErrors += PackTransformMessage(clientInfo, *transformRepository, packValidTransformsOnly, igtlMessage, trackedFrame, igtlMessages);
+      numberOfErrors += PackTransformMessage(clientInfo, *transformRepository, packValidTransformsOnly, igtlMessage, trackedFrame, igtlMessages, messageCache);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::TrackingDataMessage))
     {
-      numberOfErrors += PackTrackingDataMessage(clientInfo, trackedFrame, *transformRepository, packValidTransformsOnly, igtlMessage, igtlMessages);
+      numberOfErrors += PackTrackingDataMessage(clientInfo, trackedFrame, *transformRepository, packValidTransformsOnly, igtlMessage, igtlMessages, messageCache);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::PositionMessage))
     {
-      numberOfErrors += PackPositionMessage(clientInfo, *transformRepository, igtlMessage, trackedFrame, igtlMessages);
+      numberOfErrors += PackPositionMessage(clientInfo, *transformRepository, igtlMessage, trackedFrame, igtlMessages, messageCache);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::PlusTrackedFrameMessage))
     {
@@ -199,11 +239,11 @@ PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlC
     }
     else if (typeid(*igtlMessage) == typeid(igtl::PlusUsMessage))
     {
-      numberOfErrors += PackUsMessage(igtlMessage, trackedFrame, igtlMessages);
+      numberOfErrors += PackUsMessage(igtlMessage, clientInfo, trackedFrame, igtlMessages, messageCache);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::StringMessage))
     {
-      numberOfErrors += PackStringMessage(clientInfo, trackedFrame, igtlMessage, igtlMessages);
+      numberOfErrors += PackStringMessage(clientInfo, trackedFrame, igtlMessage, igtlMessages, messageCache);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::CommandMessage))
     {
@@ -230,7 +270,7 @@ int vtkPlusIgtlMessageFactory::PackCommandMessage(igtl::MessageBase::Pointer igt
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackStringMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackStringMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages, PlusIgtlMessageCache* messageCache)
 {
   for (std::vector<std::string>::const_iterator stringNameIterator = clientInfo.StringNames.begin(); stringNameIterator != clientInfo.StringNames.end(); ++stringNameIterator)
   {
@@ -240,17 +280,28 @@ int vtkPlusIgtlMessageFactory::PackStringMessage(const PlusIgtlClientInfo& clien
       // no value is available, do not send anything
       continue;
     }
+    std::string cacheKey = PlusIgtlMessageCache::GetMessageKey(igtlMessage->GetMessageType(), clientInfo.GetClientHeaderVersion(), *stringNameIterator);
+    if (AddCachedMessage(messageCache, cacheKey, igtlMessages))
+    {
+      continue;
+    }
     igtl::StringMessage::Pointer stringMessage = dynamic_cast<igtl::StringMessage*>(igtlMessage->Clone().GetPointer());
     vtkPlusIgtlMessageCommon::PackStringMessage(stringMessage, *stringNameIterator, stringValue, trackedFrame.GetTimestamp());
     igtlMessages.push_back(stringMessage.GetPointer());
+    AddMessageToCache(messageCache, cacheKey, stringMessage.GetPointer());
   }
   return 0; // message type does not produce errors
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackUsMessage(igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackUsMessage(igtl::MessageBase::Pointer igtlMessage, const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, PlusIgtlMessageCache* messageCache)
 {
   int numberOfErrors(0);
+  std::string cacheKey = PlusIgtlMessageCache::GetMessageKey(igtlMessage->GetMessageType(), clientInfo.GetClientHeaderVersion(), "");
+  if (AddCachedMessage(messageCache, cacheKey, igtlMessages))
+  {
+    return numberOfErrors;
+  }
   igtl::PlusUsMessage::Pointer usMessage = dynamic_cast<igtl::PlusUsMessage*>(igtlMessage->Clone().GetPointer());
   if (vtkPlusIgtlMessageCommon::PackUsMessage(usMessage, trackedFrame) != PLUS_SUCCESS)
   {
@@ -259,12 +310,15 @@ int vtkPlusIgtlMessageFactory::PackUsMessage(igtl::MessageBase::Pointer igtlMess
     return numberOfErrors;
   }
   igtlMessages.push_back(usMessage.GetPointer());
+  AddMessageToCache(messageCache, cacheKey, usMessage.GetPointer());
   return numberOfErrors;
 }
 
 //----------------------------------------------------------------------------
 int vtkPlusIgtlMessageFactory::PackTrackedFrameMessage(igtl::MessageBase::Pointer igtlMessage, const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
 {
+  // Not cached: the requested transforms of the client are written into the tracked frame, so
+  // the packed message depends on which clients were served before this one.
   int numberOfErrors(0);
   igtl::PlusTrackedFrameMessage::Pointer trackedFrameMessage = dynamic_cast<igtl::PlusTrackedFrameMessage*>(igtlMessage->Clone().GetPointer());
 
@@ -300,7 +354,7 @@ int vtkPlusIgtlMessageFactory::PackTrackedFrameMessage(igtl::MessageBase::Pointe
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, PlusIgtlMessageCache* messageCache)
 {
   for (std::vector<igsioTransformName>::const_iterator transformNameIterator = clientInfo.TransformNames.begin(); transformNameIterator != clientInfo.TransformNames.end(); ++transformNameIterator)
   {
@@ -311,6 +365,12 @@ int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& cli
       pushing high frame-rate data from tracking devices.
     */
     igsioTransformName transformName = (*transformNameIterator);
+    std::string cacheKey = PlusIgtlMessageCache::GetMessageKey(igtlMessage->GetMessageType(), clientInfo.GetClientHeaderVersion(), transformName.GetTransformName());
+    if (AddCachedMessage(messageCache, cacheKey, igtlMessages))
+    {
+      continue;
+    }
+
     igtl::Matrix4x4 igtlMatrix;
     vtkPlusIgtlMessageCommon::GetIgtlMatrix(igtlMatrix, &transformRepository, transformName);
 
@@ -325,13 +385,14 @@ int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& cli
     igtl::PositionMessage::Pointer positionMessage = dynamic_cast<igtl::PositionMessage*>(igtlMessage->Clone().GetPointer());
     vtkPlusIgtlMessageCommon::PackPositionMessage(positionMessage, transformName, status, position, quaternion, trackedFrame.GetTimestamp());
     igtlMessages.push_back(positionMessage.GetPointer());
+    AddMessageToCache(messageCache, cacheKey, positionMessage.GetPointer());
   }
 
   return 0; // no errors possible with this message type
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages, PlusIgtlMessageCache* messageCache)
 {
   if (clientInfo.GetTDATARequested() && clientInfo.GetLastTDATASentTimeStamp() + clientInfo.GetTDATAResolution() < trackedFrame.GetTimestamp())
   {
@@ -355,15 +416,21 @@ int vtkPlusIgtlMessageFactory::PackTrackingDataMessage(const PlusIgtlClientInfo&
       names.push_back(transformName);
     }
 
+    std::string cacheKey = PlusIgtlMessageCache::GetMessageKey(igtlMessage->GetMessageType(), clientInfo.GetClientHeaderVersion(), GetTransformNamesKey(names));
+    if (AddCachedMessage(messageCache, cacheKey, igtlMessages))
+    {
+      return 0;
+    }
     igtl::TrackingDataMessage::Pointer trackingDataMessage = dynamic_cast<igtl::TrackingDataMessage*>(igtlMessage->Clone().GetPointer());
     vtkPlusIgtlMessageCommon::PackTrackingDataMessage(trackingDataMessage, names, transformRepository, trackedFrame.GetTimestamp());
     igtlMessages.push_back(trackingDataMessage.GetPointer());
+    AddMessageToCache(messageCache, cacheKey, trackingDataMessage.GetPointer());
   }
   return 0; // no errors possible for this message type
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackTransformMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackTransformMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, PlusIgtlMessageCache* messageCache)
 {
   for (std::vector<igsioTransformName>::const_iterator transformNameIterator = clientInfo.TransformNames.begin(); transformNameIterator != clientInfo.TransformNames.end(); ++transformNameIterator)
   {
@@ -378,6 +445,12 @@ int vtkPlusIgtlMessageFactory::PackTransformMessage(const PlusIgtlClientInfo& cl
       continue;
     }
 
+    std::string cacheKey = PlusIgtlMessageCache::GetMessageKey(igtlMessage->GetMessageType(), clientInfo.GetClientHeaderVersion(), transformName.GetTransformName());
+    if (AddCachedMessage(messageCache, cacheKey, igtlMessages))
+    {
+      continue;
+    }
+
     igtl::Matrix4x4 igtlMatrix;
     vtkPlusIgtlMessageCommon::GetIgtlMatrix(igtlMatrix, &transformRepository, transformName);
     igtl::TransformMessage::Pointer transformMessage = dynamic_cast<igtl::TransformMessage*>(igtlMessage->Clone().GetPointer()); 
@@ -396,13 +469,14 @@ int vtkPlusIgtlMessageFactory::PackTransformMessage(const PlusIgtlClientInfo& cl
     }
     vtkPlusIgtlMessageCommon::PackTransformMessage(transformMessage, transformName, igtlMatrix, status, trackedFrame.GetTimestamp());
     igtlMessages.push_back(transformMessage.GetPointer());
+    AddMessageToCache(messageCache, cacheKey, transformMessage.GetPointer());
   }
 
   return 0; // no errors possible in this message type
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId)
+int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId, PlusIgtlMessageCache* messageCache)
 {
   int numberOfErrors = 0;
   for (std::vector<PlusIgtlClientInfo::ImageStream>::const_iterator imageStreamIterator = clientInfo.ImageStreams.begin(); imageStreamIterator != clientInfo.ImageStreams.end(); ++imageStreamIterator)
@@ -412,6 +486,13 @@ int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& client
     // Set transform name to [Name]To[CoordinateFrame]
     igsioTransformName imageTransformName = igsioTransformName(imageStream.Name, imageStream.EmbeddedTransformToFrame);
 
+    // The frame converter only decodes the input frame, the image message is always sent uncompressed
+    std::string cacheKey = PlusIgtlMessageCache::GetMessageKey(messageType, clientInfo.GetClientHeaderVersion(), imageTransformName.GetTransformName(), "RAW");
+    if (AddCachedMessage(messageCache, cacheKey, igtlMessages))
+    {
+      continue;
+    }
+
     vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
     ToolStatus status;
     if (transformRepository.GetTransform(imageTransformName, matrix.Get(), &status) != PLUS_SUCCESS)
@@ -453,12 +534,14 @@ int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& client
       continue;
     }
     igtlMessages.push_back(imageMessage.GetPointer());
+    AddMessageToCache(messageCache, cacheKey, imageMessage.GetPointer());
   }
   return numberOfErrors;
 }
 
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
 //----------------------------------------------------------------------------
+// Video messages are not cached, the encoder of each client has its own state (e.g., key frame requests)
 int vtkPlusIgtlMessageFactory::PackVideoMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId)
 {
   int numberOfErrors = 0;
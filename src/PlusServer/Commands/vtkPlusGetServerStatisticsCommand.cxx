@@ -0,0 +1,97 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommandProcessor.h"
+#include "vtkPlusGetServerStatisticsCommand.h"
+#include "vtkPlusOpenIGTLinkServer.h"
+
+vtkStandardNewMacro(vtkPlusGetServerStatisticsCommand);
+
+namespace
+{
+  static const std::string GET_SERVER_STATISTICS_CMD = "GetServerStatistics";
+
+  //----------------------------------------------------------------------------
+  void AddMetaData(igtl::MessageBase::MetaDataMap& metaData, const std::string& key, const std::string& value)
+  {
+    metaData[key] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, value);
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusGetServerStatisticsCommand::vtkPlusGetServerStatisticsCommand()
+{
+  // It handles only one command, set its name by default
+  this->SetName(GET_SERVER_STATISTICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusGetServerStatisticsCommand::~vtkPlusGetServerStatisticsCommand()
+{
+
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetServerStatisticsCommand::SetNameToGetServerStatistics()
+{
+  this->SetName(GET_SERVER_STATISTICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetServerStatisticsCommand::GetCommandNames(std::list<std::string>& cmdNames)
+{
+  cmdNames.clear();
+  cmdNames.push_back(GET_SERVER_STATISTICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusGetServerStatisticsCommand::GetDescription(const std::string& commandName)
+{
+  std::string desc;
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, GET_SERVER_STATISTICS_CMD))
+  {
+    desc += GET_SERVER_STATISTICS_CMD;
+    desc += ": Get message packing and per-client send queue statistics of the server.";
+  }
+  return desc;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetServerStatisticsCommand::Execute()
+{
+  vtkPlusOpenIGTLinkServer* server = (this->CommandProcessor != NULL ? this->CommandProcessor->GetPlusServer() : NULL);
+  if (server == NULL)
+  {
+    this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", "Invalid server.");
+    return PLUS_FAIL;
+  }
+
+  igtl::MessageBase::MetaDataMap metaData;
+
+  PlusIgtlMessageCache::Statistics cacheStatistics = server->GetMessageCacheStatistics();
+  AddMetaData(metaData, "MessagePackTimeMs", std::to_string(cacheStatistics.GetAveragePackTimeSec() * 1000.0));
+  AddMetaData(metaData, "MessageCacheHitRate", std::to_string(cacheStatistics.GetHitRate()));
+
+  std::map<int, PlusIgtlClientSendQueue::Statistics> clientStatistics;
+  server->GetClientSendQueueStatistics(clientStatistics);
+  AddMetaData(metaData, "NumberOfClients", std::to_string(clientStatistics.size()));
+  for (std::map<int, PlusIgtlClientSendQueue::Statistics>::iterator clientIt = clientStatistics.begin(); clientIt != clientStatistics.end(); ++clientIt)
+  {
+    std::string prefix = std::string("Client") + std::to_string(clientIt->first);
+    const PlusIgtlClientSendQueue::Statistics& statistics = clientIt->second;
+    AddMetaData(metaData, prefix + "QueueLength", std::to_string(statistics.QueueLength));
+    AddMetaData(metaData, prefix + "MaxQueueLength", std::to_string(statistics.MaxQueueLength));
+    AddMetaData(metaData, prefix + "SentFrames", std::to_string(statistics.NumberOfSentFrames));
+    AddMetaData(metaData, prefix + "DroppedFrames", std::to_string(statistics.NumberOfDroppedFrames));
+    AddMetaData(metaData, prefix + "DroppedVideoFrames", std::to_string(statistics.NumberOfDroppedVideoFrames));
+    AddMetaData(metaData, prefix + "AverageSendLatencyMs", std::to_string(statistics.GetAverageSendLatencySec() * 1000.0));
+    AddMetaData(metaData, prefix + "MaxSendLatencyMs", std::to_string(statistics.MaxSendLatencySec * 1000.0));
+  }
+
+  this->QueueCommandResponse(PLUS_SUCCESS, "Success.", "", &metaData);
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,53 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusGetServerStatisticsCommand_h
+#define __vtkPlusGetServerStatisticsCommand_h
+
+#include "vtkPlusServerExport.h"
+
+#include "vtkPlusCommand.h"
+
+/*!
+  \class vtkPlusGetServerStatisticsCommand
+  \brief This command returns the data sending statistics of the server
+
+  The reply metadata contains message packing statistics (pack time, message cache hit rate) and
+  the send queue statistics of each connected client (queue length, dropped frames, send latency).
+  Per-client values are prefixed by "Client[ClientId]", e.g., "Client3DroppedFrames".
+
+  \ingroup PlusLibPlusServer
+ */
+class vtkPlusServerExport vtkPlusGetServerStatisticsCommand : public vtkPlusCommand
+{
+public:
+
+  static vtkPlusGetServerStatisticsCommand* New();
+  vtkTypeMacro(vtkPlusGetServerStatisticsCommand, vtkPlusCommand);
+  virtual vtkPlusCommand* Clone() { return New(); }
+
+  /*! Executes the command  */
+  virtual PlusStatus Execute();
+
+  /*! Get all the command names that this class can execute */
+  virtual void GetCommandNames(std::list<std::string>& cmdNames);
+
+  /*! Gets the description for the specified command name. */
+  virtual std::string GetDescription(const std::string& commandName);
+
+  void SetNameToGetServerStatistics();
+
+protected:
+  vtkPlusGetServerStatisticsCommand();
+  virtual ~vtkPlusGetServerStatisticsCommand();
+
+private:
+  vtkPlusGetServerStatisticsCommand(const vtkPlusGetServerStatisticsCommand&);
+  void operator=(const vtkPlusGetServerStatisticsCommand&);
+};
+
+
+#endif
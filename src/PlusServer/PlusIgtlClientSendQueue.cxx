@@ -0,0 +1,357 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusIgtlClientSendQueue.h"
+
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
+namespace
+{
+  // Minimum time between two warnings about frames dropped for a client
+  const double DROPPED_FRAMES_LOG_INTERVAL_SEC = 5.0;
+}
+
+//----------------------------------------------------------------------------
+double PlusIgtlClientSendQueue::Statistics::GetAverageSendLatencySec() const
+{
+  if (this->NumberOfSentFrames == 0)
+  {
+    return 0.0;
+  }
+  return this->TotalSendLatencySec / this->NumberOfSentFrames;
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlClientSendQueue::PlusIgtlClientSendQueue(int clientId, igtl::ClientSocket::Pointer clientSocket, unsigned int maxQueueLength, OverflowPolicyType overflowPolicy,
+    int numberOfRetryAttempts, double delayBetweenRetryAttemptsSec)
+  : ClientId(clientId)
+  , ClientSocket(clientSocket)
+  , MaxQueueLength(std::max<unsigned int>(maxQueueLength, 1))
+  , OverflowPolicy(overflowPolicy)
+  , NumberOfRetryAttempts(numberOfRetryAttempts)
+  , DelayBetweenRetryAttemptsSec(delayBetweenRetryAttemptsSec)
+  , NumberOfQueuedFrames(0)
+  , NumberOfQueuedVideoFrames(0)
+  , StopRequested(false)
+  , Connected(true)
+  , LastDroppedFramesLogTimeSec(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlClientSendQueue::~PlusIgtlClientSendQueue()
+{
+  this->Stop();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlClientSendQueue::Start()
+{
+  std::lock_guard<std::mutex> lock(this->QueueMutex);
+  if (this->Thread.joinable())
+  {
+    // already running
+    return PLUS_SUCCESS;
+  }
+  this->StopRequested = false;
+  this->Thread = std::thread(&PlusIgtlClientSendQueue::SenderThread, this);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientSendQueue::Stop()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->QueueMutex);
+    this->StopRequested = true;
+    this->Queue.clear();
+    this->NumberOfQueuedFrames = 0;
+    this->NumberOfQueuedVideoFrames = 0;
+  }
+  this->ItemQueued.notify_all();
+  this->SpaceAvailable.notify_all();
+  if (this->Thread.joinable() && this->Thread.get_id() != std::this_thread::get_id())
+  {
+    this->Thread.join();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlClientSendQueue::QueueFrameMessages(const std::vector<igtl::MessageBase::Pointer>& messages)
+{
+  if (messages.empty())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  QueueItem item;
+  item.Messages = messages;
+  for (std::vector<igtl::MessageBase::Pointer>::const_iterator messageIt = messages.begin(); messageIt != messages.end(); ++messageIt)
+  {
+    if (IsVideoMessage(*messageIt))
+    {
+      item.HasVideo = true;
+      break;
+    }
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(this->QueueMutex);
+    this->MakeSpaceForFrame(lock, item.HasVideo);
+    if (this->StopRequested || !this->Connected)
+    {
+      return PLUS_FAIL;
+    }
+    item.QueueTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+    this->Queue.push_back(item);
+    this->NumberOfQueuedFrames++;
+    if (item.HasVideo)
+    {
+      this->NumberOfQueuedVideoFrames++;
+    }
+    this->QueueStatistics.MaxQueueLength = std::max(this->QueueStatistics.MaxQueueLength, this->NumberOfQueuedFrames);
+  }
+  this->ItemQueued.notify_one();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlClientSendQueue::QueueControlMessage(igtl::MessageBase::Pointer message)
+{
+  if (message.IsNull())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  QueueItem item;
+  item.Messages.push_back(message);
+  item.IsControl = true;
+  {
+    std::lock_guard<std::mutex> lock(this->QueueMutex);
+    if (this->StopRequested || !this->Connected)
+    {
+      return PLUS_FAIL;
+    }
+    item.QueueTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+    this->Queue.push_back(item);
+  }
+  this->ItemQueued.notify_one();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientSendQueue::IsConnected() const
+{
+  std::lock_guard<std::mutex> lock(this->QueueMutex);
+  return this->Connected;
+}
+
+//----------------------------------------------------------------------------
+int PlusIgtlClientSendQueue::GetClientId() const
+{
+  return this->ClientId;
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlClientSendQueue::Statistics PlusIgtlClientSendQueue::GetStatistics() const
+{
+  std::lock_guard<std::mutex> lock(this->QueueMutex);
+  Statistics statistics = this->QueueStatistics;
+  statistics.QueueLength = this->NumberOfQueuedFrames;
+  return statistics;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusIgtlClientSendQueue::GetOverflowPolicyAsString(OverflowPolicyType policy)
+{
+  switch (policy)
+  {
+    case DROP_OLDEST:
+      return "DROP_OLDEST";
+    case DROP_VIDEO_KEEP_TRANSFORMS:
+      return "DROP_VIDEO_KEEP_TRANSFORMS";
+    case BLOCK:
+      return "BLOCK";
+  }
+  return "UNKNOWN";
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientSendQueue::IsVideoMessage(igtl::MessageBase* message)
+{
+  if (message == NULL)
+  {
+    return false;
+  }
+  std::string messageType = message->GetMessageType();
+  return messageType == "IMAGE" || messageType == "VIDEO" || messageType == "USMESSAGE" || messageType == "TRACKEDFRAME";
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientSendQueue::MakeSpaceForFrame(std::unique_lock<std::mutex>& lock, bool newFrameHasVideo)
+{
+  switch (this->OverflowPolicy)
+  {
+    case BLOCK:
+      this->SpaceAvailable.wait(lock, [this]()
+      {
+        return this->NumberOfQueuedFrames < this->MaxQueueLength || this->StopRequested || !this->Connected;
+      });
+      break;
+
+    case DROP_VIDEO_KEEP_TRANSFORMS:
+      if (newFrameHasVideo)
+      {
+        // Discard image messages of the oldest frames, the rest of their messages are small and still sent
+        for (std::deque<QueueItem>::iterator itemIt = this->Queue.begin(); itemIt != this->Queue.end() && this->NumberOfQueuedVideoFrames >= this->MaxQueueLength;)
+        {
+          if (itemIt->IsControl || !itemIt->HasVideo)
+          {
+            ++itemIt;
+            continue;
+          }
+          std::vector<igtl::MessageBase::Pointer> keptMessages;
+          for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = itemIt->Messages.begin(); messageIt != itemIt->Messages.end(); ++messageIt)
+          {
+            if (!IsVideoMessage(*messageIt))
+            {
+              keptMessages.push_back(*messageIt);
+            }
+          }
+          itemIt->HasVideo = false;
+          this->NumberOfQueuedVideoFrames--;
+          this->QueueStatistics.NumberOfDroppedVideoFrames++;
+          if (keptMessages.empty())
+          {
+            itemIt = this->Queue.erase(itemIt);
+            this->NumberOfQueuedFrames--;
+            continue;
+          }
+          itemIt->Messages.swap(keptMessages);
+          ++itemIt;
+        }
+        this->LogDroppedFrames();
+      }
+      while (this->NumberOfQueuedFrames >= this->MaxQueueLength * TRANSFORM_QUEUE_LENGTH_FACTOR && this->DropOldestFrame())
+      {
+      }
+      break;
+
+    case DROP_OLDEST:
+    default:
+      while (this->NumberOfQueuedFrames >= this->MaxQueueLength && this->DropOldestFrame())
+      {
+      }
+      break;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientSendQueue::DropOldestFrame()
+{
+  for (std::deque<QueueItem>::iterator itemIt = this->Queue.begin(); itemIt != this->Queue.end(); ++itemIt)
+  {
+    if (itemIt->IsControl)
+    {
+      continue;
+    }
+    if (itemIt->HasVideo)
+    {
+      this->NumberOfQueuedVideoFrames--;
+    }
+    this->NumberOfQueuedFrames--;
+    this->Queue.erase(itemIt);
+    this->QueueStatistics.NumberOfDroppedFrames++;
+    this->LogDroppedFrames();
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientSendQueue::LogDroppedFrames()
+{
+  double currentTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  if (currentTimeSec - this->LastDroppedFramesLogTimeSec < DROPPED_FRAMES_LOG_INTERVAL_SEC)
+  {
+    return;
+  }
+  this->LastDroppedFramesLogTimeSec = currentTimeSec;
+  LOG_WARNING("Client " << this->ClientId << " cannot keep up with the sent data (overflow policy: " << GetOverflowPolicyAsString(this->OverflowPolicy)
+              << "). Dropped frames: " << this->QueueStatistics.NumberOfDroppedFrames << ", frames with dropped images: " << this->QueueStatistics.NumberOfDroppedVideoFrames);
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientSendQueue::SenderThread()
+{
+  std::unique_lock<std::mutex> lock(this->QueueMutex);
+  while (true)
+  {
+    this->ItemQueued.wait(lock, [this]()
+    {
+      return this->StopRequested || !this->Queue.empty();
+    });
+    if (this->StopRequested)
+    {
+      break;
+    }
+
+    QueueItem item;
+    std::swap(item, this->Queue.front());
+    this->Queue.pop_front();
+    if (!item.IsControl)
+    {
+      this->NumberOfQueuedFrames--;
+      if (item.HasVideo)
+      {
+        this->NumberOfQueuedVideoFrames--;
+      }
+    }
+    lock.unlock();
+    this->SpaceAvailable.notify_all();
+
+    // Send the messages without holding the lock, so that the server can keep queuing new frames
+    bool sendFailed = false;
+    for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = item.Messages.begin(); messageIt != item.Messages.end(); ++messageIt)
+    {
+      igtl::MessageBase::Pointer igtlMessage = (*messageIt);
+      int retValue = 0;
+      RETRY_UNTIL_TRUE((retValue = this->ClientSocket->Send(igtlMessage->GetBufferPointer(), igtlMessage->GetBufferSize())) != 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
+      if (retValue == 0)
+      {
+        auto ts = igtl::TimeStamp::New();
+        igtlMessage->GetTimeStamp(ts);
+        LOG_INFO("Client disconnected - could not send " << igtlMessage->GetMessageType() << " message to client (device name: " << igtlMessage->GetDeviceName()
+                 << "  Timestamp: " << std::fixed << ts->GetTimeStamp() << ").");
+        sendFailed = true;
+        break;
+      }
+    }
+    double sendLatencySec = vtkIGSIOAccurateTimer::GetSystemTime() - item.QueueTimeSec;
+
+    lock.lock();
+    if (sendFailed)
+    {
+      // The server disconnects the client, nothing else can be sent
+      this->Connected = false;
+      this->Queue.clear();
+      this->NumberOfQueuedFrames = 0;
+      this->NumberOfQueuedVideoFrames = 0;
+      break;
+    }
+    if (!item.IsControl)
+    {
+      this->QueueStatistics.NumberOfSentFrames++;
+      this->QueueStatistics.TotalSendLatencySec += sendLatencySec;
+      this->QueueStatistics.MaxSendLatencySec = std::max(this->QueueStatistics.MaxSendLatencySec, sendLatencySec);
+    }
+  }
+  lock.unlock();
+  // Wake up the server if it is waiting for space in the queue
+  this->SpaceAvailable.notify_all();
+}
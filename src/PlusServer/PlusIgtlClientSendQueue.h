@@ -0,0 +1,164 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIgtlClientSendQueue_h
+#define __PlusIgtlClientSendQueue_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusServerExport.h"
+
+// IGTL includes
+#include <igtlClientSocket.h>
+#include <igtlMessageBase.h>
+
+// STL includes
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*!
+  \class PlusIgtlClientSendQueue
+  \brief Bounded message queue and sender thread of a client connected to vtkPlusOpenIGTLinkServer
+
+  Messages of a tracked frame are added to the queue of each client and the client's own thread sends
+  them through the socket, so that a slow client does not delay the server or the other clients.
+  If the client cannot keep up with the incoming frames then the queue gets full and the overflow policy
+  decides what happens:
+  - DROP_OLDEST: the oldest queued frame is discarded.
+  - DROP_VIDEO_KEEP_TRANSFORMS: image messages of the oldest queued frame that contains images are
+    discarded, transform and other small messages are kept (up to TRANSFORM_QUEUE_LENGTH_FACTOR times
+    the queue length, above that the oldest frame is discarded).
+  - BLOCK: the caller waits until there is space in the queue (no data is lost, but the server slows down
+    to the speed of the slowest client).
+
+  Control messages (command responses, keep alive messages) are never discarded.
+
+  \ingroup PlusLibPlusServer
+*/
+class vtkPlusServerExport PlusIgtlClientSendQueue
+{
+public:
+  enum OverflowPolicyType
+  {
+    DROP_OLDEST,
+    DROP_VIDEO_KEEP_TRANSFORMS,
+    BLOCK
+  };
+
+  /*! Send queue statistics */
+  struct Statistics
+  {
+    Statistics() : QueueLength(0), MaxQueueLength(0), NumberOfSentFrames(0), NumberOfDroppedFrames(0), NumberOfDroppedVideoFrames(0), TotalSendLatencySec(0), MaxSendLatencySec(0) {}
+    /*! Number of frames currently waiting in the queue */
+    unsigned int QueueLength;
+    /*! Largest number of frames that were waiting in the queue */
+    unsigned int MaxQueueLength;
+    /*! Number of frames that have been sent to the client */
+    unsigned long long NumberOfSentFrames;
+    /*! Number of frames that were discarded because the queue was full */
+    unsigned long long NumberOfDroppedFrames;
+    /*! Number of frames whose image messages were discarded (but the other messages were sent) because the queue was full */
+    unsigned long long NumberOfDroppedVideoFrames;
+    /*! Sum of time elapsed between queuing and completing sending of each sent frame */
+    double TotalSendLatencySec;
+    /*! Maximum of time elapsed between queuing and completing sending of a frame */
+    double MaxSendLatencySec;
+    /*! Average time elapsed between queuing and completing sending of a frame */
+    double GetAverageSendLatencySec() const;
+  };
+
+  /*! Maximum number of transform-only frames in the queue with DROP_VIDEO_KEEP_TRANSFORMS policy, relative to the queue length */
+  static const unsigned int TRANSFORM_QUEUE_LENGTH_FACTOR = 4;
+
+  PlusIgtlClientSendQueue(int clientId, igtl::ClientSocket::Pointer clientSocket, unsigned int maxQueueLength, OverflowPolicyType overflowPolicy,
+                          int numberOfRetryAttempts, double delayBetweenRetryAttemptsSec);
+  /*! Stops the sender thread */
+  ~PlusIgtlClientSendQueue();
+
+  /*! Start the sender thread */
+  PlusStatus Start();
+
+  /*! Stop the sender thread. Messages that have not been sent yet are discarded. */
+  void Stop();
+
+  /*!
+    Add messages generated from a tracked frame to the queue. The messages must not be modified after this call.
+    \return PLUS_FAIL if the client is disconnected or the queue is stopped
+  */
+  PlusStatus QueueFrameMessages(const std::vector<igtl::MessageBase::Pointer>& messages);
+
+  /*!
+    Add a control message (command response, keep alive, etc.) to the queue. Control messages are never discarded.
+    \return PLUS_FAIL if the client is disconnected or the queue is stopped
+  */
+  PlusStatus QueueControlMessage(igtl::MessageBase::Pointer message);
+
+  /*! Returns false if sending failed, i.e. the client is disconnected */
+  bool IsConnected() const;
+
+  int GetClientId() const;
+
+  Statistics GetStatistics() const;
+
+  static std::string GetOverflowPolicyAsString(OverflowPolicyType policy);
+
+protected:
+  struct QueueItem
+  {
+    QueueItem() : QueueTimeSec(0), IsControl(false), HasVideo(false) {}
+    std::vector<igtl::MessageBase::Pointer> Messages;
+    double QueueTimeSec;
+    /*! Control items are not counted in the queue length and never dropped */
+    bool IsControl;
+    bool HasVideo;
+  };
+
+  /*! Image data carrying messages, these are the ones that are dropped with DROP_VIDEO_KEEP_TRANSFORMS policy */
+  static bool IsVideoMessage(igtl::MessageBase* message);
+
+  /*! Make space for a new frame according to the overflow policy. Must be called with QueueMutex locked. */
+  void MakeSpaceForFrame(std::unique_lock<std::mutex>& lock, bool newFrameHasVideo);
+
+  /*! Remove the oldest frame item. Must be called with QueueMutex locked. */
+  bool DropOldestFrame();
+
+  void LogDroppedFrames();
+
+  void SenderThread();
+
+  int ClientId;
+  igtl::ClientSocket::Pointer ClientSocket;
+  unsigned int MaxQueueLength;
+  OverflowPolicyType OverflowPolicy;
+  int NumberOfRetryAttempts;
+  double DelayBetweenRetryAttemptsSec;
+
+  mutable std::mutex QueueMutex;
+  /*! Signaled when an item is added to the queue or stop is requested */
+  std::condition_variable ItemQueued;
+  /*! Signaled when an item is removed from the queue, the sender thread stops, or the client is disconnected */
+  std::condition_variable SpaceAvailable;
+  std::deque<QueueItem> Queue;
+  unsigned int NumberOfQueuedFrames;
+  unsigned int NumberOfQueuedVideoFrames;
+  bool StopRequested;
+  bool Connected;
+  Statistics QueueStatistics;
+  double LastDroppedFramesLogTimeSec;
+
+  std::thread Thread;
+
+private:
+  PlusIgtlClientSendQueue(const PlusIgtlClientSendQueue&);
+  void operator=(const PlusIgtlClientSendQueue&);
+};
+
+#endif
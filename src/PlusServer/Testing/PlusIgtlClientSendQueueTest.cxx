@@ -0,0 +1,290 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusIgtlClientSendQueueTest.cxx
+  \brief Checks that a stalled client does not delay the other clients
+
+  Two clients are connected through sockets, each of them has its own send queue.
+  Both queues get the same image and transform messages for each frame. One client
+  reads all messages, the other does not read anything until all frames are queued.
+  The test verifies that
+  - queuing a frame never waits for the stalled client,
+  - the reading client receives every frame and none of its frames are dropped,
+  - the overflow policy discards frames (or their images) of the stalled client only.
+  The test runs with DROP_OLDEST and DROP_VIDEO_KEEP_TRANSFORMS policies.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlClientSendQueue.h"
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// IGSIO includes
+#include <vtkIGSIOAccurateTimer.h>
+
+// OpenIGTLink includes
+#include <igtlClientSocket.h>
+#include <igtlImageMessage.h>
+#include <igtlMessageHeader.h>
+#include <igtlServerSocket.h>
+#include <igtlTransformMessage.h>
+
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace
+{
+  const int CONNECTION_TIMEOUT_MSEC = 5000;
+  const int RECEIVE_TIMEOUT_MSEC = 500;
+
+  struct ReceivedMessageCounts
+  {
+    ReceivedMessageCounts() : NumberOfImages(0), NumberOfTransforms(0) {}
+    std::atomic<int> NumberOfImages;
+    std::atomic<int> NumberOfTransforms;
+  };
+
+  //----------------------------------------------------------------------------
+  // Reads messages until the expected number of frames arrive, the deadline is reached or the connection is closed.
+  // The transform is the last message of each frame.
+  void ReceiveMessages(igtl::ClientSocket::Pointer clientSocket, int expectedNumberOfFrames, double deadlineSec, const std::atomic<bool>& stopRequested, ReceivedMessageCounts& counts)
+  {
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    while (!stopRequested && vtkIGSIOAccurateTimer::GetSystemTime() < deadlineSec
+           && (expectedNumberOfFrames < 0 || counts.NumberOfTransforms < expectedNumberOfFrames))
+    {
+      headerMsg->InitPack();
+      bool timeout(false);
+      igtlUint64 numOfBytesReceived = clientSocket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize(), timeout);
+      if (timeout)
+      {
+        continue;
+      }
+      if (numOfBytesReceived == 0 || headerMsg->Unpack() != igtl::MessageHeader::UNPACK_HEADER)
+      {
+        break;
+      }
+      clientSocket->Skip(headerMsg->GetBodySizeToRead(), 1);
+      if (strcmp(headerMsg->GetDeviceType(), "IMAGE") == 0)
+      {
+        counts.NumberOfImages++;
+      }
+      else if (strcmp(headerMsg->GetDeviceType(), "TRANSFORM") == 0)
+      {
+        counts.NumberOfTransforms++;
+      }
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  igtl::MessageBase::Pointer CreateImageMessage(int frameIndex, int imageSize)
+  {
+    igtl::ImageMessage::Pointer imageMessage = igtl::ImageMessage::New();
+    imageMessage->SetDeviceName("Image");
+    int dimensions[3] = { imageSize, imageSize, 1 };
+    imageMessage->SetDimensions(dimensions);
+    imageMessage->SetScalarType(igtl::ImageMessage::TYPE_UINT8);
+    imageMessage->AllocateScalars();
+    memset(imageMessage->GetScalarPointer(), frameIndex % 256, imageMessage->GetImageSize());
+    imageMessage->Pack();
+    return imageMessage.GetPointer();
+  }
+
+  //----------------------------------------------------------------------------
+  igtl::MessageBase::Pointer CreateTransformMessage(int frameIndex)
+  {
+    igtl::TransformMessage::Pointer transformMessage = igtl::TransformMessage::New();
+    transformMessage->SetDeviceName("StylusToTracker");
+    igtl::Matrix4x4 matrix;
+    igtl::IdentityMatrix(matrix);
+    matrix[0][3] = static_cast<float>(frameIndex);
+    transformMessage->SetMatrix(matrix);
+    transformMessage->Pack();
+    return transformMessage.GetPointer();
+  }
+
+  //----------------------------------------------------------------------------
+  // Connect a client socket to the server and return the server side socket of the connection
+  igtl::ClientSocket::Pointer ConnectClient(igtl::ServerSocket::Pointer serverSocket, int port, igtl::ClientSocket::Pointer& clientSocket)
+  {
+    clientSocket = igtl::ClientSocket::New();
+    if (clientSocket->ConnectToServer("127.0.0.1", port) != 0)
+    {
+      LOG_ERROR("Failed to connect to server at port " << port);
+      return igtl::ClientSocket::Pointer();
+    }
+    clientSocket->SetReceiveTimeout(RECEIVE_TIMEOUT_MSEC);
+    igtl::ClientSocket::Pointer serverSideSocket = serverSocket->WaitForConnection(CONNECTION_TIMEOUT_MSEC);
+    if (serverSideSocket.IsNull())
+    {
+      LOG_ERROR("Server did not accept the client connection");
+    }
+    return serverSideSocket;
+  }
+
+  //----------------------------------------------------------------------------
+  int RunSlowClientTest(igtl::ServerSocket::Pointer serverSocket, int port, PlusIgtlClientSendQueue::OverflowPolicyType policy,
+                        int queueLength, int numberOfFrames, int imageSize, double frameIntervalSec, double maxQueueTimeMs)
+  {
+    const std::string policyName = PlusIgtlClientSendQueue::GetOverflowPolicyAsString(policy);
+    LOG_INFO("Testing " << policyName << " policy with a stalled client");
+
+    igtl::ClientSocket::Pointer fastClientSocket;
+    igtl::ClientSocket::Pointer fastServerSideSocket = ConnectClient(serverSocket, port, fastClientSocket);
+    igtl::ClientSocket::Pointer slowClientSocket;
+    igtl::ClientSocket::Pointer slowServerSideSocket = ConnectClient(serverSocket, port, slowClientSocket);
+    if (fastServerSideSocket.IsNull() || slowServerSideSocket.IsNull())
+    {
+      return 1;
+    }
+
+    PlusIgtlClientSendQueue fastQueue(1, fastServerSideSocket, queueLength, policy, 1, 0.01);
+    PlusIgtlClientSendQueue slowQueue(2, slowServerSideSocket, queueLength, policy, 1, 0.01);
+    fastQueue.Start();
+    slowQueue.Start();
+
+    std::atomic<bool> stopRequested(false);
+    ReceivedMessageCounts fastCounts;
+    const double receiveDeadlineSec = vtkIGSIOAccurateTimer::GetSystemTime() + numberOfFrames * frameIntervalSec + 10.0;
+    std::thread fastReceiver(ReceiveMessages, fastClientSocket, numberOfFrames, receiveDeadlineSec, std::cref(stopRequested), std::ref(fastCounts));
+
+    double maxQueueTimeSec = 0;
+    for (int frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
+    {
+      // The same packed messages are queued for all clients, as in the server
+      std::vector<igtl::MessageBase::Pointer> messages;
+      messages.push_back(CreateImageMessage(frameIndex, imageSize));
+      messages.push_back(CreateTransformMessage(frameIndex));
+
+      const double queueStartTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (fastQueue.QueueFrameMessages(messages) != PLUS_SUCCESS || slowQueue.QueueFrameMessages(messages) != PLUS_SUCCESS)
+      {
+        LOG_ERROR(policyName << ": failed to queue frame " << frameIndex);
+        break;
+      }
+      maxQueueTimeSec = std::max(maxQueueTimeSec, vtkIGSIOAccurateTimer::GetSystemTime() - queueStartTimeSec);
+      vtkIGSIOAccurateTimer::Delay(frameIntervalSec);
+    }
+
+    fastReceiver.join();
+    PlusIgtlClientSendQueue::Statistics fastStatistics = fastQueue.GetStatistics();
+    PlusIgtlClientSendQueue::Statistics slowStatistics = slowQueue.GetStatistics();
+
+    // Let the stalled client read, so that its sender thread is not blocked in sending when the queue is stopped
+    ReceivedMessageCounts slowCounts;
+    std::thread slowReceiver(ReceiveMessages, slowClientSocket, -1, vtkIGSIOAccurateTimer::GetSystemTime() + 10.0, std::cref(stopRequested), std::ref(slowCounts));
+    fastQueue.Stop();
+    slowQueue.Stop();
+    stopRequested = true;
+    slowReceiver.join();
+    fastClientSocket->CloseSocket();
+    slowClientSocket->CloseSocket();
+    fastServerSideSocket->CloseSocket();
+    slowServerSideSocket->CloseSocket();
+
+    LOG_INFO(policyName << ": reading client received " << fastCounts.NumberOfImages << " images and " << fastCounts.NumberOfTransforms << " transforms, "
+             << "stalled client dropped " << slowStatistics.NumberOfDroppedFrames << " frames and images of " << slowStatistics.NumberOfDroppedVideoFrames << " frames, "
+             << "maximum time to queue a frame: " << maxQueueTimeSec * 1000.0 << " ms");
+
+    int numberOfErrors = 0;
+    if (fastCounts.NumberOfImages != numberOfFrames || fastCounts.NumberOfTransforms != numberOfFrames)
+    {
+      LOG_ERROR(policyName << ": reading client received " << fastCounts.NumberOfImages << " images and " << fastCounts.NumberOfTransforms
+                << " transforms, expected " << numberOfFrames << " of each");
+      numberOfErrors++;
+    }
+    if (fastStatistics.NumberOfDroppedFrames != 0 || fastStatistics.NumberOfDroppedVideoFrames != 0)
+    {
+      LOG_ERROR(policyName << ": frames of the reading client were dropped (" << fastStatistics.NumberOfDroppedFrames << " frames, images of "
+                << fastStatistics.NumberOfDroppedVideoFrames << " frames)");
+      numberOfErrors++;
+    }
+    if (slowStatistics.NumberOfDroppedFrames + slowStatistics.NumberOfDroppedVideoFrames == 0)
+    {
+      LOG_ERROR(policyName << ": no frames of the stalled client were dropped, the test data does not fill up the socket buffers. Increase the number of frames or the image size.");
+      numberOfErrors++;
+    }
+    if (policy == PlusIgtlClientSendQueue::DROP_VIDEO_KEEP_TRANSFORMS && slowStatistics.NumberOfDroppedVideoFrames == 0)
+    {
+      LOG_ERROR(policyName << ": images of the stalled client were not dropped");
+      numberOfErrors++;
+    }
+    if (maxQueueTimeSec * 1000.0 > maxQueueTimeMs)
+    {
+      LOG_ERROR(policyName << ": queuing a frame took " << maxQueueTimeSec * 1000.0 << " ms, more than the allowed " << maxQueueTimeMs << " ms");
+      numberOfErrors++;
+    }
+    return numberOfErrors;
+  }
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+  int listeningPort = 18953;
+  int queueLength = 10;
+  int numberOfFrames = 200;
+  int imageSize = 512;
+  double frameIntervalSec = 0.01;
+  double maxQueueTimeMs = 100.0;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  args.AddArgument("--listening-port", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &listeningPort, "Port used for connecting the test clients (default: 18953).");
+  args.AddArgument("--queue-length", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &queueLength, "Send queue length of each client (default: 10).");
+  args.AddArgument("--number-of-frames", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfFrames, "Number of frames sent to the clients (default: 200).");
+  args.AddArgument("--image-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &imageSize, "Width and height of the sent images in pixels (default: 512).");
+  args.AddArgument("--frame-interval-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &frameIntervalSec, "Time between queuing two frames (default: 0.01).");
+  args.AddArgument("--max-queue-time-ms", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxQueueTimeMs, "The test fails if queuing a frame takes longer than this (default: 100).");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments." << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+  if (serverSocket->CreateServer(listeningPort) < 0)
+  {
+    LOG_ERROR("Cannot create a server socket at port " << listeningPort);
+    exit(EXIT_FAILURE);
+  }
+
+  int numberOfErrors = 0;
+  numberOfErrors += RunSlowClientTest(serverSocket, listeningPort, PlusIgtlClientSendQueue::DROP_OLDEST, queueLength, numberOfFrames, imageSize, frameIntervalSec, maxQueueTimeMs);
+  numberOfErrors += RunSlowClientTest(serverSocket, listeningPort, PlusIgtlClientSendQueue::DROP_VIDEO_KEEP_TRANSFORMS, queueLength, numberOfFrames, imageSize, frameIntervalSec, maxQueueTimeMs);
+  serverSocket->CloseSocket();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed with " << numberOfErrors << " errors");
+    exit(EXIT_FAILURE);
+  }
+
+  LOG_INFO("Test completed successfully");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusServerLatencyTest.cxx
+  \brief Measures the time between acquiring a transform and receiving it through the OpenIGTLink server
+
+  A FakeTracker device acquires transforms and a PlusServer broadcasts them to a client
+  that is connected through a socket. The latency of each received TRANSFORM message is
+  computed as the difference between the receive time and the acquisition timestamp
+  stored in the message header.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusOpenIGTLinkServer.h"
+#include "vtkIGSIOTransformRepository.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// OpenIGTLink includes
+#include <igtlClientSocket.h>
+#include <igtlMessageHeader.h>
+
+// STL includes
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+  const char* LATENCY_TEST_CONFIGURATION =
+    "<PlusConfiguration version=\"2.1\">"
+    "  <DataCollection StartupDelaySec=\"0.5\">"
+    "    <DeviceSet Name=\"PlusServerLatencyTest\" Description=\"FakeTracker transforms broadcasted by PlusServer\" />"
+    "    <Device Id=\"TrackerDevice\" Type=\"FakeTracker\" Mode=\"Default\" AcquisitionRate=\"%ACQUISITION_RATE%\" ToolReferenceFrame=\"Tracker\">"
+    "      <DataSources>"
+    "        <DataSource Type=\"Tool\" Id=\"Stylus\" PortName=\"1\" />"
+    "      </DataSources>"
+    "      <OutputChannels>"
+    "        <OutputChannel Id=\"TrackerStream\">"
+    "          <DataSource Id=\"Stylus\" />"
+    "        </OutputChannel>"
+    "      </OutputChannels>"
+    "    </Device>"
+    "  </DataCollection>"
+    "  <PlusOpenIGTLinkServer ListeningPort=\"%LISTENING_PORT%\" OutputChannelId=\"TrackerStream\" SendValidTransformsOnly=\"true\">"
+    "    <DefaultClientInfo>"
+    "      <MessageTypes>"
+    "        <Message Type=\"TRANSFORM\" />"
+    "      </MessageTypes>"
+    "      <TransformNames>"
+    "        <Transform Name=\"StylusToTracker\" />"
+    "      </TransformNames>"
+    "    </DefaultClientInfo>"
+    "  </PlusOpenIGTLinkServer>"
+    "</PlusConfiguration>";
+
+  //----------------------------------------------------------------------------
+  std::string ReplaceAll(std::string str, const std::string& from, const std::string& to)
+  {
+    size_t pos = 0;
+    while ((pos = str.find(from, pos)) != std::string::npos)
+    {
+      str.replace(pos, from.length(), to);
+      pos += to.length();
+    }
+    return str;
+  }
+
+  //----------------------------------------------------------------------------
+  double GetPercentile(const std::vector<double>& sortedValues, double percentile)
+  {
+    if (sortedValues.empty())
+    {
+      return 0.0;
+    }
+    size_t index = static_cast<size_t>(percentile / 100.0 * (sortedValues.size() - 1) + 0.5);
+    return sortedValues[std::min(index, sortedValues.size() - 1)];
+  }
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+  int listeningPort = 18951;
+  double acquisitionRate = 100.0;
+  double testDurationSec = 5.0;
+  double maxMedianLatencyMs = -1.0;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+  args.AddArgument("--listening-port", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &listeningPort, "Port of the OpenIGTLink server (default: 18951).");
+  args.AddArgument("--acquisition-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &acquisitionRate, "Acquisition rate of the FakeTracker in Hz (default: 100).");
+  args.AddArgument("--duration-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &testDurationSec, "Duration of the measurement (default: 5 sec).");
+  args.AddArgument("--max-median-latency-ms", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &maxMedianLatencyMs, "If specified then the test fails if the median latency is larger than this value.");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments." << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  std::string configString = LATENCY_TEST_CONFIGURATION;
+  configString = ReplaceAll(configString, "%ACQUISITION_RATE%", igsioCommon::ToString<double>(acquisitionRate));
+  configString = ReplaceAll(configString, "%LISTENING_PORT%", igsioCommon::ToString<int>(listeningPort));
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(configString.c_str()));
+  if (configRootElement == NULL)
+  {
+    LOG_ERROR("Failed to parse test configuration");
+    exit(EXIT_FAILURE);
+  }
+  vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+
+  vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+  if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Datacollector failed to read configuration");
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  if (transformRepository->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Transform repository failed to read configuration");
+    exit(EXIT_FAILURE);
+  }
+
+  if (dataCollector->Connect() != PLUS_SUCCESS || dataCollector->Start() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Datacollector failed to start");
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkPlusOpenIGTLinkServer> server = vtkSmartPointer<vtkPlusOpenIGTLinkServer>::New();
+  if (server->Start(dataCollector, transformRepository, configRootElement->FindNestedElementWithName("PlusOpenIGTLinkServer"), "") != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start OpenIGTLink server");
+    dataCollector->Stop();
+    dataCollector->Disconnect();
+    exit(EXIT_FAILURE);
+  }
+
+  igtl::ClientSocket::Pointer clientSocket = igtl::ClientSocket::New();
+  if (clientSocket->ConnectToServer("127.0.0.1", listeningPort) != 0)
+  {
+    LOG_ERROR("Failed to connect to server at port " << listeningPort);
+    server->Stop();
+    dataCollector->Stop();
+    dataCollector->Disconnect();
+    exit(EXIT_FAILURE);
+  }
+  clientSocket->SetReceiveTimeout(1000);
+
+  LOG_INFO("Measuring acquisition-to-socket latency for " << testDurationSec << " sec at " << acquisitionRate << " Hz acquisition rate");
+
+  std::vector<double> latenciesMs;
+  latenciesMs.reserve(static_cast<size_t>(testDurationSec * acquisitionRate * 2));
+  igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+  igtl::TimeStamp::Pointer messageTimestamp = igtl::TimeStamp::New();
+  const double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  while (vtkIGSIOAccurateTimer::GetSystemTime() < startTimeSec + testDurationSec)
+  {
+    headerMsg->InitPack();
+    bool timeout(false);
+    igtlUint64 numOfBytesReceived = clientSocket->Receive(headerMsg->GetPackPointer(), headerMsg->GetPackSize(), timeout);
+    const double receiveTimeUtc = vtkIGSIOAccurateTimer::GetUniversalTime();
+    if (numOfBytesReceived == 0 || timeout)
+    {
+      continue;
+    }
+    if (headerMsg->Unpack() != igtl::MessageHeader::UNPACK_HEADER)
+    {
+      LOG_ERROR("Failed to unpack message header");
+      break;
+    }
+    clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+    if (strcmp(headerMsg->GetDeviceType(), "TRANSFORM") != 0)
+    {
+      // keep alive or other message
+      continue;
+    }
+    headerMsg->GetTimeStamp(messageTimestamp);
+    latenciesMs.push_back((receiveTimeUtc - messageTimestamp->GetTimeStamp()) * 1000.0);
+  }
+
+  clientSocket->CloseSocket();
+  server->Stop();
+  dataCollector->Stop();
+  dataCollector->Disconnect();
+
+  if (latenciesMs.empty())
+  {
+    LOG_ERROR("No transform messages were received");
+    exit(EXIT_FAILURE);
+  }
+
+  std::sort(latenciesMs.begin(), latenciesMs.end());
+  double sumLatencyMs = 0;
+  for (std::vector<double>::iterator it = latenciesMs.begin(); it != latenciesMs.end(); ++it)
+  {
+    sumLatencyMs += *it;
+  }
+  const double medianLatencyMs = GetPercentile(latenciesMs, 50);
+
+  LOG_INFO("Received transforms: " << latenciesMs.size() << " (" << latenciesMs.size() / testDurationSec << " per sec)");
+  LOG_INFO("Acquisition-to-socket latency (ms): mean=" << sumLatencyMs / latenciesMs.size()
+           << ", median=" << medianLatencyMs
+           << ", 95th percentile=" << GetPercentile(latenciesMs, 95)
+           << ", min=" << latenciesMs.front()
+           << ", max=" << latenciesMs.back());
+
+  if (maxMedianLatencyMs > 0 && medianLatencyMs > maxMedianLatencyMs)
+  {
+    LOG_ERROR("Median latency (" << medianLatencyMs << " ms) is larger than the maximum allowed " << maxMedianLatencyMs << " ms");
+    exit(EXIT_FAILURE);
+  }
+
+  return EXIT_SUCCESS;
+}
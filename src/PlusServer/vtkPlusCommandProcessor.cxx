@@ -39,6 +39,7 @@ See License.txt for details.
 #include "vtkPlusAddRecordingDeviceCommand.h"
 #include "vtkPlusGenericSerialCommand.h"
 #include "vtkPlusGetFrameRateCommand.h"
+#include "vtkPlusGetServerStatisticsCommand.h"
 #include "vtkPlusGetPolydataCommand.h"
 #include "vtkPlusGetTransformCommand.h"
 #include "vtkPlusGetUsParameterCommand.h"
@@ -85,6 +86,7 @@ vtkPlusCommandProcessor::vtkPlusCommandProcessor()
   RegisterPlusCommand(vtkSmartPointer<vtkPlusAddRecordingDeviceCommand>::New());
   RegisterPlusCommand(vtkSmartPointer<vtkPlusGenericSerialCommand>::New());
   RegisterPlusCommand(vtkSmartPointer<vtkPlusGetFrameRateCommand>::New());
+  RegisterPlusCommand(vtkSmartPointer<vtkPlusGetServerStatisticsCommand>::New());
 #ifdef PLUS_USE_CAPISTRANO_VIDEO
   RegisterPlusCommand(vtkSmartPointer<vtkPlusCapistranoCommand>::New());
 #endif
@@ -42,6 +42,9 @@ See License.txt for details.
 // OpenIGTLinkIO includes
 #include <igtlioPolyDataConverter.h>
 
+// STL includes
+#include <iomanip>
+
 #if defined(WIN32)
   #include "vtkPlusOpenIGTLinkServerWin32.cxx"
 #elif defined(__APPLE__)
@@ -57,7 +60,8 @@ See License.txt for details.
 namespace
 {
   const double DELAY_ON_SENDING_ERROR_SEC = 0.02;
-  const double DELAY_ON_NO_NEW_FRAMES_SEC = 0.005;
+  // Maximum time to wait for new frames, before checking for command responses and keep alive again
+  const double MAX_WAIT_FOR_NEW_FRAMES_SEC = 0.005;
   const int NUMBER_OF_RECENT_COMMAND_IDS_STORED = 10;
   const int IGTL_EMPTY_DATA_SIZE = -1;
   const double SERVER_START_CHECK_DELAY_SEC = 2.0;
@@ -88,11 +92,14 @@ vtkPlusOpenIGTLinkServer::vtkPlusOpenIGTLinkServer()
   , NumberOfRetryAttempts(10)
   , DelayBetweenRetryAttemptsSec(0.05)
   , MaxNumberOfIgtlMessagesToSend(100)
+  , ClientSendQueueLength(50)
+  , ClientSendQueuePolicy(PlusIgtlClientSendQueue::DROP_OLDEST)
   , ConnectionReceiverThreadId(-1)
   , DataSenderThreadId(-1)
   , IgtlMessageFactory(vtkSmartPointer<vtkPlusIgtlMessageFactory>::New())
   , IgtlClientsMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
   , LastSentTrackedFrameTimestamp(0)
+  , LastBroadcastDataSequenceNumber(0)
   , MaxTimeSpentWithProcessingMs(50)
   , LastProcessingTimePerFrameMs(-1)
   , SendValidTransformsOnly(true)
@@ -153,6 +160,9 @@ PlusStatus vtkPlusOpenIGTLinkServer::QueueMessageResponseForClient(int clientId,
 void vtkPlusOpenIGTLinkServer::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "MessageCache:" << std::endl;
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  this->IgtlMessageCache.PrintSelf(os, indent.GetNextIndent());
 }
 
 //----------------------------------------------------------------------------
@@ -230,6 +240,12 @@ PlusStatus vtkPlusOpenIGTLinkServer::StopOpenIGTLinkService()
   }
 
   LOG_INFO("Plus OpenIGTLink server stopped.");
+  PlusIgtlMessageCache::Statistics cacheStatistics = this->GetMessageCacheStatistics();
+  LOG_INFO("Message packing: " << std::fixed << std::setprecision(3) << cacheStatistics.GetAveragePackTimeSec() * 1000.0 << " ms per client and frame, "
+           << std::setprecision(1) << cacheStatistics.GetHitRate() * 100.0 << "% of " << cacheStatistics.NumberOfLookups << " messages reused from the cache");
+  LOG_INFO("Broadcasted video frames: " << this->BroadcastFrameCopyCounter.NumberOfSharedFrames << " shared, "
+           << this->BroadcastFrameCopyCounter.NumberOfCopiedFrames << " copied ("
+           << this->BroadcastFrameCopyCounter.NumberOfCopiedBytes / (1024 * 1024) << " MB)");
 
   return PLUS_SUCCESS;
 }
@@ -298,6 +314,10 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
 #endif
       LOG_INFO("Received new client connection (client " << client->ClientId << " at " << address << ":" << port << "). Number of connected clients: " << self->GetNumberOfConnectedClients());
 
+      client->SendQueue = std::make_shared<PlusIgtlClientSendQueue>(client->ClientId, client->ClientSocket, self->ClientSendQueueLength, self->ClientSendQueuePolicy,
+                          self->NumberOfRetryAttempts, self->DelayBetweenRetryAttemptsSec);
+      client->SendQueue->Start();
+
       client->DataReceiverActive.first = true;
       client->DataReceiverThreadId = self->Threader->SpawnThread((vtkThreadFunctionType)&DataReceiverThread, client);
     }
@@ -451,7 +471,7 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendLatestFramesToClients(vtkPlusOpenIGTLin
           self.LastSentTrackedFrameTimestamp = oldestDataTimestamp + SAMPLING_SKIPPING_MARGIN_SEC;
         }
         static vtkIGSIOLogHelper logHelper(60.0, 500000);
-        CUSTOM_RETURN_WITH_FAIL_IF(self.BroadcastChannel->GetTrackedFrameList(self.LastSentTrackedFrameTimestamp, trackedFrameList, numberOfFramesToGet) != PLUS_SUCCESS,
+        CUSTOM_RETURN_WITH_FAIL_IF(self.BroadcastChannel->GetTrackedFrameList(self.LastSentTrackedFrameTimestamp, trackedFrameList, numberOfFramesToGet, true, &self.BroadcastFrameCopyCounter) != PLUS_SUCCESS,
                                    "Failed to get tracked frame list from data collector (last recorded timestamp: " << std::fixed << self.LastSentTrackedFrameTimestamp);
       }
     }
@@ -460,7 +480,15 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendLatestFramesToClients(vtkPlusOpenIGTLin
   // There is no new frame in the buffer
   if (trackedFrameList->GetNumberOfTrackedFrames() == 0)
   {
-    vtkIGSIOAccurateTimer::Delay(DELAY_ON_NO_NEW_FRAMES_SEC);
+    if (self.BroadcastChannel != NULL)
+    {
+      // Return as soon as a new item is added to the channel's buffers, so that the data is sent immediately after it is acquired
+      self.BroadcastChannel->WaitForNewData(self.LastBroadcastDataSequenceNumber, MAX_WAIT_FOR_NEW_FRAMES_SEC);
+    }
+    else
+    {
+      vtkIGSIOAccurateTimer::Delay(MAX_WAIT_FOR_NEW_FRAMES_SEC);
+    }
     elapsedTimeSinceLastPacketSentSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
 
     // Send keep alive packet to clients
@@ -500,18 +528,8 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendMessageResponses(vtkPlusOpenIGTLinkServ
   {
     for (ClientIdToMessageListMap::iterator it = self.MessageResponseQueue.begin(); it != self.MessageResponseQueue.end(); ++it)
     {
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
-      igtl::ClientSocket::Pointer clientSocket = NULL;
-
-      for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
-      {
-        if (clientIterator->ClientId == it->first)
-        {
-          clientSocket = clientIterator->ClientSocket;
-          break;
-        }
-      }
-      if (clientSocket.IsNull())
+      std::shared_ptr<PlusIgtlClientSendQueue> sendQueue = self.GetClientSendQueue(it->first);
+      if (sendQueue == nullptr)
       {
         LOG_WARNING("Message reply cannot be sent to client " << it->first << ", probably client has been disconnected.");
         continue;
@@ -519,7 +537,7 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendMessageResponses(vtkPlusOpenIGTLinkServ
 
       for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = it->second.begin(); messageIt != it->second.end(); ++messageIt)
       {
-        clientSocket->Send((*messageIt)->GetBufferPointer(), (*messageIt)->GetBufferSize());
+        sendQueue->QueueControlMessage(*messageIt);
       }
     }
     self.MessageResponseQueue.clear();
@@ -547,23 +565,13 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendCommandResponses(vtkPlusOpenIGTLinkServ
 
       // Only send the response to the client that requested the command
       LOG_DEBUG("Send command reply to client " << (*responseIt)->GetClientId() << ": " << igtlResponseMessage->GetDeviceName());
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
-      igtl::ClientSocket::Pointer clientSocket = NULL;
-      for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
-      {
-        if (clientIterator->ClientId == (*responseIt)->GetClientId())
-        {
-          clientSocket = clientIterator->ClientSocket;
-          break;
-        }
-      }
-
-      if (clientSocket.IsNull())
+      std::shared_ptr<PlusIgtlClientSendQueue> sendQueue = self.GetClientSendQueue((*responseIt)->GetClientId());
+      if (sendQueue == nullptr)
       {
         LOG_WARNING("Message reply cannot be sent to client " << (*responseIt)->GetClientId() << ", probably client has been disconnected");
         continue;
       }
-      clientSocket->Send(igtlResponseMessage->GetBufferPointer(), igtlResponseMessage->GetBufferSize());
+      sendQueue->QueueControlMessage(igtlResponseMessage);
     }
   }
 
@@ -1028,8 +1036,10 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
   trackedFrame.SetTimestamp(timestampUniversal);
 
   std::vector<int> disconnectedClientIds;
+  typedef std::pair<std::shared_ptr<PlusIgtlClientSendQueue>, std::vector<igtl::MessageBase::Pointer> > ClientSendQueueMessagesPair;
+  std::vector<ClientSendQueueMessagesPair> clientMessages;
   {
-    // Lock before we send message to the clients
+    // Lock before we pack messages for the clients
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
     if (this->NewClientConnected)
     {
@@ -1048,43 +1058,42 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& tracked
     }
     this->NewClientConnected = false;
 
+    // Messages that are requested by multiple clients are packed only once
+    this->IgtlMessageCache.BeginFrame();
+
     for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
     {
-      igtl::ClientSocket::Pointer clientSocket = (*clientIterator).ClientSocket;
-
       // Create IGT messages
       std::vector<igtl::MessageBase::Pointer> igtlMessages;
-      std::vector<igtl::MessageBase::Pointer>::iterator igtlMessageIterator;
 
-      if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, clientIterator->ClientInfo, igtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
+      double packStartTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, clientIterator->ClientInfo, igtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository, &this->IgtlMessageCache) != PLUS_SUCCESS)
       {
         LOG_WARNING("Failed to pack all IGT messages");
       }
+      this->IgtlMessageCache.AddPackTime(vtkIGSIOAccurateTimer::GetSystemTime() - packStartTimeSec);
 
-      // Send all messages to a client
-      for (igtlMessageIterator = igtlMessages.begin(); igtlMessageIterator != igtlMessages.end(); ++igtlMessageIterator)
+      // Update the TDATA timestamp, even if TDATA isn't sent (cheaper than checking for existing TDATA message type)
+      if (!igtlMessages.empty())
       {
-        igtl::MessageBase::Pointer igtlMessage = (*igtlMessageIterator);
-        if (igtlMessage.IsNull())
-        {
-          continue;
-        }
-
-        int retValue = 0;
-        RETRY_UNTIL_TRUE((retValue = clientSocket->Send(igtlMessage->GetBufferPointer(), igtlMessage->GetBufferSize())) != 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
-        if (retValue == 0)
-        {
-          disconnectedClientIds.push_back(clientIterator->ClientId);
-          auto ts = igtl::TimeStamp::New();
-          igtlMessage->GetTimeStamp(ts);
-          LOG_INFO("Client disconnected - could not send " << igtlMessage->GetMessageType() << " message to client (device name: " << igtlMessage->GetDeviceName()
-                   << "  Timestamp: " << std::fixed << ts->GetTimeStamp() << ").");
-          break;
-        }
-
-        // Update the TDATA timestamp, even if TDATA isn't sent (cheaper than checking for existing TDATA message type)
         clientIterator->ClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
       }
+
+      clientMessages.push_back(std::make_pair(clientIterator->SendQueue, igtlMessages));
+    }
+  }
+
+  // Messages are sent by the sender thread of each client. Queuing is done without holding the client list lock,
+  // because with BLOCK overflow policy it waits until the client's queue has space.
+  for (std::vector<ClientSendQueueMessagesPair>::iterator clientIt = clientMessages.begin(); clientIt != clientMessages.end(); ++clientIt)
+  {
+    if (clientIt->first == nullptr)
+    {
+      continue;
+    }
+    if (clientIt->first->QueueFrameMessages(clientIt->second) != PLUS_SUCCESS || !clientIt->first->IsConnected())
+    {
+      disconnectedClientIds.push_back(clientIt->first->GetClientId());
     }
   }
 
@@ -1160,6 +1169,14 @@ void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
   }
   while (clientDataReceiverThreadStillActive);
 
+  // Stop the client's sender thread. It is done without holding the lock, as the thread may be in the middle of sending a message.
+  std::shared_ptr<PlusIgtlClientSendQueue> sendQueue = this->GetClientSendQueue(clientId);
+  if (sendQueue != nullptr)
+  {
+    sendQueue->Stop();
+    this->LogClientSendQueueStatistics(*sendQueue);
+  }
+
   // Close socket and remove client from the list
   int port = 0;
   std::string address = "unknown";
@@ -1194,7 +1211,7 @@ void vtkPlusOpenIGTLinkServer::KeepAlive()
   std::vector< int > disconnectedClientIds;
 
   {
-    // Lock before we send message to the clients
+    // Lock before we queue messages for the clients
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
 
     for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
@@ -1203,18 +1220,10 @@ void vtkPlusOpenIGTLinkServer::KeepAlive()
       replyMsg->SetCode(igtl::StatusMessage::STATUS_OK);
       replyMsg->Pack();
 
-      int retValue = 0;
-      RETRY_UNTIL_TRUE(
-        (retValue = clientIterator->ClientSocket->Send(replyMsg->GetPackPointer(), replyMsg->GetPackSize())) != 0,
-        this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
-      if (retValue == 0)
+      // Failure to send is detected by the client's sender thread, the client is disconnected on the next call
+      if (clientIterator->SendQueue == nullptr || clientIterator->SendQueue->QueueControlMessage(replyMsg.GetPointer()) != PLUS_SUCCESS)
       {
         disconnectedClientIds.push_back(clientIterator->ClientId);
-        auto ts = igtl::TimeStamp::New();
-        replyMsg->GetTimeStamp(ts);
-
-        LOG_DEBUG("Client disconnected - could not send " << replyMsg->GetMessageType() << " message to client (device name: " << replyMsg->GetDeviceName()
-                  << "  Timestamp: " << std::fixed <<  ts->GetTimeStamp() << ").");
       }
     } // clientIterator
   } // unlock client list
@@ -1250,6 +1259,57 @@ PlusStatus vtkPlusOpenIGTLinkServer::GetClientInfo(unsigned int clientId, PlusIg
   return PLUS_FAIL;
 }
 
+//------------------------------------------------------------------------------
+std::shared_ptr<PlusIgtlClientSendQueue> vtkPlusOpenIGTLinkServer::GetClientSendQueue(int clientId) const
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  for (std::list<ClientData>::const_iterator it = this->IgtlClients.begin(); it != this->IgtlClients.end(); ++it)
+  {
+    if (it->ClientId == clientId)
+    {
+      return it->SendQueue;
+    }
+  }
+  return nullptr;
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::GetClientSendQueueStatistics(std::map<int, PlusIgtlClientSendQueue::Statistics>& statistics) const
+{
+  statistics.clear();
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  for (std::list<ClientData>::const_iterator it = this->IgtlClients.begin(); it != this->IgtlClients.end(); ++it)
+  {
+    if (it->SendQueue != nullptr)
+    {
+      statistics[it->ClientId] = it->SendQueue->GetStatistics();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::LogClientSendQueueStatistics(const PlusIgtlClientSendQueue& sendQueue)
+{
+  PlusIgtlClientSendQueue::Statistics statistics = sendQueue.GetStatistics();
+  LOG_INFO("Client " << sendQueue.GetClientId() << " send queue: " << statistics.NumberOfSentFrames << " frames sent, "
+           << statistics.NumberOfDroppedFrames << " dropped, " << statistics.NumberOfDroppedVideoFrames << " sent without images, max queue length: " << statistics.MaxQueueLength
+           << ", send latency average/max: " << std::fixed << std::setprecision(1) << statistics.GetAverageSendLatencySec() * 1000.0 << "/" << statistics.MaxSendLatencySec * 1000.0 << " ms");
+}
+
+//------------------------------------------------------------------------------
+PlusIgtlMessageCache::Statistics vtkPlusOpenIGTLinkServer::GetMessageCacheStatistics() const
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  return this->IgtlMessageCache.GetStatistics();
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::ResetMessageCacheStatistics()
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  this->IgtlMessageCache.ResetStatistics();
+}
+
 //------------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* serverElement, const std::string& aFilename)
 {
@@ -1273,6 +1333,20 @@ PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* server
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SendValidTransformsOnly, serverElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(IgtlMessageCrcCheckEnabled, serverElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(LogWarningOnNoDataAvailable, serverElement);
+  int clientSendQueueLength = this->ClientSendQueueLength;
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, ClientSendQueueLength, clientSendQueueLength, serverElement);
+  if (clientSendQueueLength < 1)
+  {
+    LOG_WARNING("ClientSendQueueLength must be at least 1, the configured value (" << clientSendQueueLength << ") is ignored. Using " << this->ClientSendQueueLength << " instead.");
+  }
+  else
+  {
+    this->ClientSendQueueLength = clientSendQueueLength;
+  }
+  XML_READ_ENUM3_ATTRIBUTE_OPTIONAL(ClientSendQueuePolicy, serverElement,
+                                    "DROP_OLDEST", PlusIgtlClientSendQueue::DROP_OLDEST,
+                                    "DROP_VIDEO_KEEP_TRANSFORMS", PlusIgtlClientSendQueue::DROP_VIDEO_KEEP_TRANSFORMS,
+                                    "BLOCK", PlusIgtlClientSendQueue::BLOCK);
 
   this->DefaultClientInfo.IgtlMessageTypes.clear();
   this->DefaultClientInfo.TransformNames.clear();
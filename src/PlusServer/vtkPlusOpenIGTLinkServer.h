@@ -10,6 +10,8 @@
 // Local includes
 #include "vtkPlusServerExport.h"
 #include "PlusIgtlClientInfo.h"
+#include "PlusIgtlClientSendQueue.h"
+#include "vtkPlusChannel.h"
 #include "vtkPlusDataCollector.h"
 #include "vtkPlusIgtlMessageFactory.h"
 #include "vtkIGSIOTransformRepository.h"
@@ -21,6 +23,8 @@
 
 // STL includes
 #include <deque>
+#include <map>
+#include <memory>
 
 // OS includes
 #if (_MSC_VER == 1500)
@@ -34,7 +38,6 @@
 //class igsioTrackedFrame; 
 class vtkPlusDataCollector;
 class vtkPlusOpenIGTLinkServer;
-class vtkPlusChannel;
 class vtkPlusCommandProcessor;
 class vtkPlusCommandResponse;
 class vtkIGSIORecursiveCriticalSection;
@@ -67,6 +70,9 @@ struct ClientData
 
   PlusIgtlClientInfo ClientInfo;
 
+  /// Queue and thread for sending messages to the client
+  std::shared_ptr<PlusIgtlClientSendQueue> SendQueue;
+
   vtkPlusOpenIGTLinkServer* Server;
 };
 
@@ -142,6 +148,18 @@ public:
     */
   virtual PlusStatus GetClientInfo(unsigned int clientId, PlusIgtlClientInfo& outClientInfo) const;
 
+  /*!
+    Get message packing statistics: time spent with packing the messages and how often
+    a message could be reused from the message cache instead of packing it for each client.
+  */
+  virtual PlusIgtlMessageCache::Statistics GetMessageCacheStatistics() const;
+
+  /*! Reset message packing statistics */
+  virtual void ResetMessageCacheStatistics();
+
+  /*! Get send queue statistics (queue length, dropped frames, send latency) of all connected clients, indexed by client ID */
+  virtual void GetClientSendQueueStatistics(std::map<int, PlusIgtlClientSendQueue::Statistics>& statistics) const;
+
   /*! Start server */
   PlusStatus StartOpenIGTLinkService();
 
@@ -184,7 +202,10 @@ protected:
   /*! Thread for receiving control data from clients */
   static void* DataReceiverThread(vtkMultiThreader::ThreadInfo* data);
 
-  /*! Tracked frame interface, sends the selected message type and data to all clients */
+  /*!
+    Tracked frame interface, sends the selected message type and data to all clients.
+    The image data of broadcasted frames is shared with the channel buffers, it is only read while packing the messages.
+  */
   virtual PlusStatus SendTrackedFrame(igsioTrackedFrame& trackedFrame);
 
   /*! Converts a command response to an OpenIGTLink message that can be sent to the client */
@@ -193,9 +214,15 @@ protected:
   /*! Send status message to clients to keep alive the connection */
   virtual void KeepAlive();
 
-  /*! Stops client's data receiving thread, closes the socket, and removes the client from the client list */
+  /*! Stops client's data receiving and sending threads, closes the socket, and removes the client from the client list */
   void DisconnectClient(int clientId);
 
+  /*! Returns the send queue of a client, NULL if the client is not found */
+  std::shared_ptr<PlusIgtlClientSendQueue> GetClientSendQueue(int clientId) const;
+
+  /*! Write send queue statistics of a client to the log */
+  void LogClientSendQueueStatistics(const PlusIgtlClientSendQueue& sendQueue);
+
   /*! Set IGTL CRC check flag (0: disabled, 1: enabled) */
   vtkSetMacro(IgtlMessageCrcCheckEnabled, bool);
   /*! Get IGTL CRC check flag (0: disabled, 1: enabled) */
@@ -216,6 +243,14 @@ protected:
   vtkSetMacro(KeepAliveIntervalSec, double);
   vtkGetMacroConst(KeepAliveIntervalSec, double);
 
+  /*! Maximum number of frames waiting to be sent to a client (at least 1) */
+  vtkSetClampMacro(ClientSendQueueLength, int, 1, VTK_INT_MAX);
+  vtkGetMacroConst(ClientSendQueueLength, int);
+
+  /*! What to do if a client cannot keep up with the data and its send queue is full */
+  vtkSetMacro(ClientSendQueuePolicy, PlusIgtlClientSendQueue::OverflowPolicyType);
+  vtkGetMacroConst(ClientSendQueuePolicy, PlusIgtlClientSendQueue::OverflowPolicyType);
+
   vtkSetStdStringMacro(OutputChannelId);
   vtkSetStdStringMacro(ConfigFilename);
 
@@ -253,6 +288,12 @@ private:
   /*! Maximum number of IGTL messages to send in one period */
   int MaxNumberOfIgtlMessagesToSend;
 
+  /*! Maximum number of frames waiting to be sent to a client */
+  int ClientSendQueueLength;
+
+  /*! What to do if a client cannot keep up with the data and its send queue is full */
+  PlusIgtlClientSendQueue::OverflowPolicyType ClientSendQueuePolicy;
+
   // Active flag for threads (request, respond )
   struct ThreadFlags
   {
@@ -276,12 +317,18 @@ private:
   /*! igtl Factory for message sending */
   vtkSmartPointer<vtkPlusIgtlMessageFactory> IgtlMessageFactory;
 
+  /*! Messages packed from the current tracked frame, shared between clients that request the same message. Protected by IgtlClientsMutex. */
+  PlusIgtlMessageCache IgtlMessageCache;
+
   /*! Mutex instance for accessing client data list */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> IgtlClientsMutex;
 
   /*! Last sent tracked frame timestamp */
   double LastSentTrackedFrameTimestamp;
 
+  /*! Sequence number of the latest new data notification of the broadcast channel that the data sender has seen */
+  unsigned long long LastBroadcastDataSequenceNumber;
+
   /*! Maximum time spent with processing (getting tracked frames, sending messages) per second (in milliseconds) */
   int MaxTimeSpentWithProcessingMs;
 
@@ -318,6 +365,9 @@ private:
   /*! Channel to use for broadcasting */
   vtkPlusChannel* BroadcastChannel;
 
+  /*! Number of video frames that were shared with or copied from the broadcast channel buffers */
+  vtkPlusChannel::FrameCopyCounter BroadcastFrameCopyCounter;
+
   bool LogWarningOnNoDataAvailable;
 
   double KeepAliveIntervalSec;
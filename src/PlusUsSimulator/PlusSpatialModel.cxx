@@ -8,6 +8,9 @@ See License.txt for details.
 
 #include "PlusSpatialModel.h"
 
+#include <memory>
+
+#include "vtkGenericCell.h"
 #include "vtkMath.h"
 #include "vtkMatrix4x4.h"
 #include "vtkModifiedBSPTree.h"
@@ -18,7 +21,12 @@ See License.txt for details.
 #include "vtkProbeFilter.h"
 #include "vtkPointData.h"
 #include "vtkIdList.h"
-#include "vtkTriangle.h"
+#include "vtkVersion.h"
+
+// vtkModifiedBSPTree::IntersectWithLine uses a caller-provided cell (instead of a cell stored in the localizer) since VTK 9.2
+#if VTK_MAJOR_VERSION > 9 || (VTK_MAJOR_VERSION == 9 && VTK_MINOR_VERSION >= 2)
+  #define PLUS_THREAD_SAFE_LINE_INTERSECTION
+#endif
 
 // If fraction of the transmitted beam intensity is smaller then this value then we consider the beam to be completely absorbed
 const double MINIMUM_BEAM_INTENSITY = 1e-9;
@@ -48,6 +56,14 @@ PlusSpatialModel::PlusSpatialModel()
 {
 }
 
+//-----------------------------------------------------------------------------
+PlusSpatialModel::LineIntersectionScratch::LineIntersectionScratch()
+  : IntersectionPoints_Model(vtkSmartPointer<vtkPoints>::New())
+  , IntersectionCellIds(vtkSmartPointer<vtkIdList>::New())
+  , Cell(vtkSmartPointer<vtkGenericCell>::New())
+{
+}
+
 //-----------------------------------------------------------------------------
 PlusSpatialModel::~PlusSpatialModel()
 {
@@ -253,9 +269,8 @@ void PlusSpatialModel::CalculateIntensity(std::vector<double>& reflectedIntensit
   }
 
   // Compute attenuation within this model
-  double intensityAttenuationCoefficientdBPerPixel = this->AttenuationCoefficientDbPerCmMhz * (distanceBetweenScanlineSamplePointsMm / 10.0) * this->ImagingFrequencyMhz;
   // intensityAttenuationCoefficientPerPixel: should be close to 1, as it's the ratio of (transmitted beam intensity / incident beam intensity) after traversing through a single pixel
-  double intensityAttenuationCoefficientPerPixel = pow(10.0, -intensityAttenuationCoefficientdBPerPixel / 10.0);
+  double intensityAttenuationCoefficientPerPixel = GetIntensityAttenuationCoefficientPerPixel(distanceBetweenScanlineSamplePointsMm);
   // intensityAttenuatedFractionPerPixel: how big fraction of the intensity is attenuated during traversing through one voxel
   double intensityAttenuatedFractionPerPixel = (1 - intensityAttenuationCoefficientPerPixel);
   // intensityTransmittedFractionPerPixelTwoWay: how big fraction of the intensity is transmitted during traversing through one voxel; takes into account both propagation directions
@@ -314,7 +329,49 @@ void PlusSpatialModel::CalculateIntensity(std::vector<double>& reflectedIntensit
 }
 
 //-----------------------------------------------------------------------------
-void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& lineIntersections, double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference)
+double PlusSpatialModel::GetIntensityAttenuationCoefficientPerPixel(double distanceBetweenScanlineSamplePointsMm)
+{
+  double intensityAttenuationCoefficientdBPerPixel = this->AttenuationCoefficientDbPerCmMhz * (distanceBetweenScanlineSamplePointsMm / 10.0) * this->ImagingFrequencyMhz;
+  return pow(10.0, -intensityAttenuationCoefficientdBPerPixel / 10.0);
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus PlusSpatialModel::PrepareForParallelSimulation(double distanceBetweenScanlineSamplePointsMm, unsigned int maxNumberOfFilledPixels)
+{
+  if (UpdateModelFile() != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  if (this->PolyData != NULL)
+  {
+    // Cells are built on first access, build them now so that concurrent GetCell calls only read them
+    this->PolyData->BuildCells();
+  }
+
+  // Fill the attenuation table that CalculateIntensity would otherwise update on demand
+  double intensityAttenuationCoefficientPerPixel = GetIntensityAttenuationCoefficientPerPixel(distanceBetweenScanlineSamplePointsMm);
+  double intensityTransmittedFractionPerPixelTwoWay = intensityAttenuationCoefficientPerPixel * intensityAttenuationCoefficientPerPixel;
+  if (maxNumberOfFilledPixels > 0 && (this->PrecomputedAttenuations.size() < maxNumberOfFilledPixels || intensityTransmittedFractionPerPixelTwoWay != this->PrecomputedAttenuations[0]))
+  {
+    UpdatePrecomputedAttenuations(intensityTransmittedFractionPerPixelTwoWay, maxNumberOfFilledPixels);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//-----------------------------------------------------------------------------
+bool PlusSpatialModel::IsLineIntersectionThreadSafe()
+{
+#ifdef PLUS_THREAD_SAFE_LINE_INTERSECTION
+  return true;
+#else
+  return false;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+void PlusSpatialModel::GetLineIntersections(std::vector<LineIntersectionInfo>& lineIntersections, double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference, LineIntersectionScratch* scratch /*=NULL*/)
 {
   UpdateModelFile();
 
@@ -345,19 +402,32 @@ void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& li
     searchLineStartPoint_Reference[i] = scanLineStartPoint_Reference[i] - this->TransducerSpatialModelMaxOverlapMm * scanLineDirectionVector_Reference[i] / scanLineDirectionVectorNorm_Reference;
   }
 
-  vtkSmartPointer<vtkMatrix4x4> objectToModelMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkMatrix4x4::Invert(this->ModelToObjectTransform, objectToModelMatrix);
-  vtkSmartPointer<vtkMatrix4x4> referenceToModelMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkMatrix4x4::Multiply4x4(objectToModelMatrix, this->ReferenceToObjectTransform, referenceToModelMatrix);
+  // Matrices are computed on the stack, as this method is called for each scanline, possibly from multiple threads
+  double objectToModelMatrix[16];
+  vtkMatrix4x4::Invert(this->ModelToObjectTransform->GetData(), objectToModelMatrix);
+  double referenceToModelMatrix[16];
+  vtkMatrix4x4::Multiply4x4(objectToModelMatrix, this->ReferenceToObjectTransform->GetData(), referenceToModelMatrix);
 
   double searchLineStartPoint_Model[4] = {0, 0, 0, 1};
   double scanLineEndPoint_Model[4] = {0, 0, 0, 1};
-  referenceToModelMatrix->MultiplyPoint(searchLineStartPoint_Reference, searchLineStartPoint_Model);
-  referenceToModelMatrix->MultiplyPoint(scanLineEndPoint_Reference, scanLineEndPoint_Model);
-
-  vtkSmartPointer<vtkPoints> intersectionPoints_Model = vtkSmartPointer<vtkPoints>::New();
-  vtkSmartPointer<vtkIdList> intersectionCellIds = vtkSmartPointer<vtkIdList>::New();
+  vtkMatrix4x4::MultiplyPoint(referenceToModelMatrix, searchLineStartPoint_Reference, searchLineStartPoint_Model);
+  vtkMatrix4x4::MultiplyPoint(referenceToModelMatrix, scanLineEndPoint_Reference, scanLineEndPoint_Model);
+
+  std::unique_ptr<LineIntersectionScratch> localScratch;
+  if (scratch == NULL)
+  {
+    localScratch.reset(new LineIntersectionScratch);
+    scratch = localScratch.get();
+  }
+  vtkPoints* intersectionPoints_Model = scratch->IntersectionPoints_Model;
+  vtkIdList* intersectionCellIds = scratch->IntersectionCellIds;
+  intersectionPoints_Model->Reset();
+  intersectionCellIds->Reset();
+#ifdef PLUS_THREAD_SAFE_LINE_INTERSECTION
+  this->ModelLocalizer->IntersectWithLine(searchLineStartPoint_Model, scanLineEndPoint_Model, 0.0, intersectionPoints_Model, intersectionCellIds, scratch->Cell);
+#else
   this->ModelLocalizer->IntersectWithLine(searchLineStartPoint_Model, scanLineEndPoint_Model, 0.0, intersectionPoints_Model, intersectionCellIds);
+#endif
 
   if (intersectionPoints_Model->GetNumberOfPoints() < 1)
   {
@@ -365,7 +435,7 @@ void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& li
     return;
   }
 
-  vtkSmartPointer<vtkMatrix4x4> modelToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  double modelToReferenceMatrix[16];
   vtkMatrix4x4::Invert(referenceToModelMatrix, modelToReferenceMatrix);
 
   // Measure the distance from the starting point in the reference coordinate system
@@ -378,7 +448,7 @@ void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& li
   for (; intersectionPointIndex < intersectionPoints_Model->GetNumberOfPoints(); intersectionPointIndex++)
   {
     intersectionPoints_Model->GetPoint(intersectionPointIndex, intersectionPoint_Model);
-    modelToReferenceMatrix->MultiplyPoint(intersectionPoint_Model, intersectionPoint_Reference);
+    vtkMatrix4x4::MultiplyPoint(modelToReferenceMatrix, intersectionPoint_Model, intersectionPoint_Reference);
     double intersectionDistanceFromSearchLineStartPointMm = sqrt(vtkMath::Distance2BetweenPoints(searchLineStartPoint_Reference, intersectionPoint_Reference));
     if (intersectionDistanceFromSearchLineStartPointMm <= this->TransducerSpatialModelMaxOverlapMm)
     {
@@ -408,16 +478,17 @@ void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& li
   }
 
   double scanLineDirectionVector_Model[4] = {0, 0, 0, 0};
-  referenceToModelMatrix->MultiplyPoint(scanLineDirectionVector_Reference, scanLineDirectionVector_Model);
+  vtkMatrix4x4::MultiplyPoint(referenceToModelMatrix, scanLineDirectionVector_Reference, scanLineDirectionVector_Model);
   vtkMath::Normalize(scanLineDirectionVector_Model);
 
   for (; intersectionPointIndex < intersectionPoints_Model->GetNumberOfPoints(); intersectionPointIndex++)
   {
     intersectionPoints_Model->GetPoint(intersectionPointIndex, intersectionPoint_Model);
-    modelToReferenceMatrix->MultiplyPoint(intersectionPoint_Model, intersectionPoint_Reference);
+    vtkMatrix4x4::MultiplyPoint(modelToReferenceMatrix, intersectionPoint_Model, intersectionPoint_Reference);
     intersectionInfo.IntersectionDistanceFromStartPointMm = sqrt(vtkMath::Distance2BetweenPoints(scanLineStartPoint_Reference, intersectionPoint_Reference));
-    vtkTriangle* cell = vtkTriangle::SafeDownCast(this->PolyData->GetCell(intersectionCellIds->GetId(intersectionPointIndex)));
-    if (cell != NULL && normals_Model != NULL)
+    vtkGenericCell* cell = scratch->Cell;
+    this->PolyData->GetCell(intersectionCellIds->GetId(intersectionPointIndex), cell);
+    if (cell->GetCellType() == VTK_TRIANGLE && normals_Model != NULL)
     {
       const int NUMBER_OF_POINTS_PER_CELL = 3; // triangle cell
       double pcoords[NUMBER_OF_POINTS_PER_CELL] = {0, 0, 0};
@@ -429,12 +500,9 @@ void PlusSpatialModel::GetLineIntersections(std::deque<LineIntersectionInfo>& li
       double interpolatedNormal_Model[3] = {0, 0, 0};
       for (int pointIndex = 0; pointIndex < NUMBER_OF_POINTS_PER_CELL; pointIndex++)
       {
-        double* normalAtCellCorner = normals_Model->GetTuple3(cell->GetPointId(pointIndex));
-        if (normalAtCellCorner == NULL)
-        {
-          LOG_ERROR("SpatialModel::GetLineIntersections error: invalid normal");
-          continue;
-        }
+        // GetTuple3 would return a pointer to a buffer in the array, which is not safe to use from multiple threads
+        double normalAtCellCorner[3] = {0, 0, 0};
+        normals_Model->GetTuple(cell->GetPointId(pointIndex), normalAtCellCorner);
         interpolatedNormal_Model[0] += normalAtCellCorner[0] * weights[pointIndex];
         interpolatedNormal_Model[1] += normalAtCellCorner[1] * weights[pointIndex];
         interpolatedNormal_Model[2] += normalAtCellCorner[2] * weights[pointIndex];
@@ -6,13 +6,18 @@
 #ifndef __SpatialModel_h
 #define __SpatialModel_h
 
-#include <deque>
 #include <string>
+#include <vector>
 
 #include "vtkPlusUsSimulatorExport.h"
 
+#include "vtkSmartPointer.h"
+
+class vtkGenericCell;
+class vtkIdList;
 class vtkMatrix4x4;
 class vtkModifiedBSPTree;
+class vtkPoints;
 class vtkPolyData;
 
 /*!
@@ -38,6 +43,18 @@ public:
     double IntersectionIncidenceAngleRad;
   };
 
+  /*!
+    Objects that GetLineIntersections uses for storing intermediate results.
+    Each thread that calls GetLineIntersections concurrently must use its own instance.
+  */
+  struct vtkPlusUsSimulatorExport LineIntersectionScratch
+  {
+    LineIntersectionScratch();
+    vtkSmartPointer<vtkPoints> IntersectionPoints_Model;
+    vtkSmartPointer<vtkIdList> IntersectionCellIds;
+    vtkSmartPointer<vtkGenericCell> Cell;
+  };
+
   PlusSpatialModel();
   virtual ~PlusSpatialModel();
 
@@ -69,8 +86,24 @@ public:
     The results are appended to the lineIntersections structure.
     If the line starts inside the model then the first intersection position is 0.
     The unit of the reference coordinate system must be in mm.
+    If scratch is NULL then temporary objects are allocated for the computation.
+    The method may be called from multiple threads concurrently (each thread with its own scratch) after PrepareForParallelSimulation
+    is called, if IsLineIntersectionThreadSafe() returns true.
   */
-  void GetLineIntersections(std::deque<LineIntersectionInfo>& lineIntersections, double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference);
+  void GetLineIntersections(std::vector<LineIntersectionInfo>& lineIntersections, double* scanLineStartPoint_Reference, double* scanLineEndPoint_Reference, LineIntersectionScratch* scratch = NULL);
+
+  /*!
+    Load the model and precompute all the data that is needed for simulating scanlines, so that GetLineIntersections and
+    CalculateIntensity only read the model data and can be called from multiple threads concurrently.
+    It has to be called again if any of the model properties change.
+  */
+  PlusStatus PrepareForParallelSimulation(double distanceBetweenScanlineSamplePointsMm, unsigned int maxNumberOfFilledPixels);
+
+  /*!
+    Returns true if the line intersection computation can be performed on multiple threads concurrently.
+    Requires VTK 9.2 or later, as earlier versions of vtkModifiedBSPTree store intermediate results in the localizer.
+  */
+  static bool IsLineIntersectionThreadSafe();
 
   double GetAcousticImpedanceMegarayls();
 
@@ -101,6 +134,9 @@ protected:
   PlusStatus UpdateModelFile();
   void UpdatePrecomputedAttenuations(double intensityTransmittedFractionPerPixelTwoWay, int numberOfElements);
 
+  /*! Ratio of the transmitted and incident beam intensity after traversing through a single pixel */
+  double GetIntensityAttenuationCoefficientPerPixel(double distanceBetweenScanlineSamplePointsMm);
+
 protected:
   //PlusStatus LoadModel(const std::string& absoluteImagePath);
 
@@ -7,8 +7,6 @@ See License.txt for details.
 #include "PlusConfigure.h"
 
 #include <algorithm>
-#include <list>
-#include <map>
 
 #include "vtkPlusUsSimulatorAlgo.h"
 
@@ -69,6 +67,9 @@ vtkPlusUsSimulatorAlgo::vtkPlusUsSimulatorAlgo()
   this->NoisePhase[1] = 0;
   this->NoisePhase[2] = 0;
 
+  this->Threader = vtkSmartPointer<vtkMultiThreader>::New();
+  this->NumberOfThreads = this->Threader->GetNumberOfThreads();
+
   // this->TransducerSpatialModel doesn't have to be initialized, as the default parameters of SpatialModel
   // are for soft tissue that should match the transducer material in acoustic impedance
 }
@@ -134,9 +135,6 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
   scanLines->SetExtent(0, this->NumberOfSamplesPerScanline - 1, 0, this->NumberOfScanlines - 1, 0, 0);
   scanLines->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
 
-  // Create BSPTree for fast scanline-model intersection computation
-  vtkSmartPointer<vtkPoints> scanLineIntersectionWithModel = vtkSmartPointer<vtkPoints>::New();
-
   vtkPlusUsScanConvert* scanConverter = this->RfProcessor->GetScanConverter();
   if (scanConverter == NULL)
   {
@@ -147,22 +145,20 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
   // GetScanLineEndPoints or GetDistanceBetweenScanlineSamplePointsMm methods
   scanConverter->SetInputImageExtent(scanLines->GetExtent());
 
-  double outputImageSpacingMm[3] = {1.0, 1.0, 1.0};
-  scanConverter->GetOutputImageSpacing(outputImageSpacingMm);
-
-  double distanceBetweenScanlineSamplePointsMm = scanConverter->GetDistanceBetweenScanlineSamplePointsMm();
+  FrameSimulationInfo frameInfo;
+  frameInfo.Algo = this;
+  frameInfo.ScanLines = scanLines;
+  frameInfo.DistanceBetweenScanlineSamplePointsMm = scanConverter->GetDistanceBetweenScanlineSamplePointsMm();
 
   // Initialize noise generator
-  vtkSmartPointer<vtkLineSource> noiseSamplerLine_Reference = vtkSmartPointer<vtkLineSource>::New();
   vtkSmartPointer<vtkPerlinNoise> noiseFunction = vtkSmartPointer<vtkPerlinNoise>::New();
-  double samplePointPosition_Reference[3] = {0, 0, 0};
   if (this->NoiseAmplitude > 0)
   {
-    noiseSamplerLine_Reference->SetResolution(this->NumberOfSamplesPerScanline - 1);
     noiseFunction->SetAmplitude(this->NoiseAmplitude);
     noiseFunction->SetFrequency(this->NoiseFrequency);
     noiseFunction->SetPhase(this->NoisePhase);
   }
+  frameInfo.NoiseFunction = noiseFunction;
 
   igsioTransformName imageToReferenceTransformName(this->GetImageCoordinateFrame(), this->GetReferenceCoordinateFrame());
   vtkSmartPointer<vtkMatrix4x4> imageToReferenceMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
@@ -183,18 +179,6 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
 
     return 0;
   }
-  vtkSmartPointer<vtkMatrix4x4> referenceToImageMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
-  vtkMatrix4x4::Invert(imageToReferenceMatrix, referenceToImageMatrix);
-
-  // Create a few variables outside the loop to avoid reallocations and to make the code easier to read
-  vtkPoints* samplePointPositions_Reference = 0;
-  // Create a buffer outside the for loop to allow reusing it
-  std::vector<double> intensities;
-  // scanline start/end positions in Image and Reference coordinate systems
-  double scanLineStartPoint_Image[4] = {0, 0, 0, 1};
-  double scanLineEndPoint_Image[4] = {0, 0, 0, 1};
-  double scanLineStartPoint_Reference[4] = {0, 0, 0, 1};
-  double scanLineEndPoint_Reference[4] = {0, 0, 0, 1};
 
   for (std::vector<PlusSpatialModel>::iterator spatialModelIt = this->SpatialModels.begin(); spatialModelIt != this->SpatialModels.end(); ++spatialModelIt)
   {
@@ -210,41 +194,139 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
       }
     }
     spatialModelIt->SetReferenceToObjectTransform(referenceToObjectMatrix);
+    // Load the model and fill all caches now, so that the models are only read while the scanlines are simulated
+    if (spatialModelIt->PrepareForParallelSimulation(frameInfo.DistanceBetweenScanlineSamplePointsMm, this->NumberOfSamplesPerScanline) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to prepare " << spatialModelIt->GetName() << " SpatialModel for simulation");
+      return 0;
+    }
   }
 
+  // Compute scanline start/end positions in Image and Reference coordinate systems
+  frameInfo.ScanLineStartPoints_Reference.resize(4 * this->NumberOfScanlines);
+  frameInfo.ScanLineEndPoints_Reference.resize(4 * this->NumberOfScanlines);
+  double scanLineStartPoint_Image[4] = {0, 0, 0, 1};
+  double scanLineEndPoint_Image[4] = {0, 0, 0, 1};
   for (int scanLineIndex = 0; scanLineIndex < this->NumberOfScanlines; scanLineIndex++)
   {
     scanConverter->GetScanLineEndPoints(scanLineIndex, scanLineStartPoint_Image, scanLineEndPoint_Image);
-    imageToReferenceMatrix->MultiplyPoint(scanLineStartPoint_Image, scanLineStartPoint_Reference);
-    imageToReferenceMatrix->MultiplyPoint(scanLineEndPoint_Image, scanLineEndPoint_Reference);
+    imageToReferenceMatrix->MultiplyPoint(scanLineStartPoint_Image, &frameInfo.ScanLineStartPoints_Reference[4 * scanLineIndex]);
+    imageToReferenceMatrix->MultiplyPoint(scanLineEndPoint_Image, &frameInfo.ScanLineEndPoints_Reference[4 * scanLineIndex]);
+  }
+
+  // Simulate the scanlines. Each scanline is computed independently, so the result does not depend on the number of threads.
+  int numberOfThreads = std::max(1, std::min(this->NumberOfThreads, this->NumberOfScanlines));
+  if (numberOfThreads > 1 && !PlusSpatialModel::IsLineIntersectionThreadSafe())
+  {
+    LOG_DEBUG("Scanline simulation is performed on a single thread, as line intersection computation is not thread-safe in this VTK version");
+    numberOfThreads = 1;
+  }
+  if (this->ThreadScratch.size() < static_cast<size_t>(numberOfThreads))
+  {
+    this->ThreadScratch.resize(numberOfThreads);
+  }
+  PlusStatus simulationStatus = PLUS_SUCCESS;
+  if (numberOfThreads == 1)
+  {
+    simulationStatus = this->SimulateScanLines(frameInfo, 0, this->NumberOfScanlines - 1, this->ThreadScratch[0]);
+  }
+  else
+  {
+    this->Threader->SetNumberOfThreads(numberOfThreads);
+    this->Threader->SetSingleMethod(&vtkPlusUsSimulatorAlgo::SimulateScanLinesThread, &frameInfo);
+    this->Threader->SingleMethodExecute();
+    for (int threadIndex = 0; threadIndex < numberOfThreads; threadIndex++)
+    {
+      if (this->ThreadScratch[threadIndex].Status != PLUS_SUCCESS)
+      {
+        simulationStatus = PLUS_FAIL;
+      }
+    }
+  }
+  if (simulationStatus != PLUS_SUCCESS)
+  {
+    return 0;
+  }
+
+  vtkImageData* simulatedUsImage = vtkImageData::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
+  if (simulatedUsImage == NULL)
+  {
+    LOG_ERROR("vtkPlusUsSimulatorAlgo output type is invalid");
+    return 0;
+  }
+  this->RfProcessor->SetRfFrame(scanLines, US_IMG_BRIGHTNESS);
+  simulatedUsImage->DeepCopy(this->RfProcessor->GetBrightnessScanConvertedImage());
+  return 1;
+}
+
+//-----------------------------------------------------------------------------
+VTK_THREAD_RETURN_TYPE vtkPlusUsSimulatorAlgo::SimulateScanLinesThread(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  FrameSimulationInfo* frameInfo = static_cast<FrameSimulationInfo*>(threadInfo->UserData);
+  vtkPlusUsSimulatorAlgo* self = frameInfo->Algo;
+
+  // Each thread simulates a contiguous range of scanlines
+  int numberOfScanLines = self->NumberOfScanlines;
+  int firstScanLineIndex = threadInfo->ThreadID * numberOfScanLines / threadInfo->NumberOfThreads;
+  int lastScanLineIndex = (threadInfo->ThreadID + 1) * numberOfScanLines / threadInfo->NumberOfThreads - 1;
+
+  ScanLineScratch& scratch = self->ThreadScratch[threadInfo->ThreadID];
+  scratch.Status = self->SimulateScanLines(*frameInfo, firstScanLineIndex, lastScanLineIndex, scratch);
+
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//-----------------------------------------------------------------------------
+PlusStatus vtkPlusUsSimulatorAlgo::SimulateScanLines(const FrameSimulationInfo& frameInfo, int firstScanLineIndex, int lastScanLineIndex, ScanLineScratch& scratch)
+{
+  double distanceBetweenScanlineSamplePointsMm = frameInfo.DistanceBetweenScanlineSamplePointsMm;
+  std::vector<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels = scratch.LineIntersectionsWithModels;
+  std::vector<double>& intensities = scratch.Intensities;
+
+  vtkPoints* samplePointPositions_Reference = 0;
+  double samplePointPosition_Reference[3] = {0, 0, 0};
+  if (this->NoiseAmplitude > 0)
+  {
+    if (scratch.NoiseSamplerLine_Reference.GetPointer() == NULL)
+    {
+      scratch.NoiseSamplerLine_Reference = vtkSmartPointer<vtkLineSource>::New();
+    }
+    scratch.NoiseSamplerLine_Reference->SetResolution(this->NumberOfSamplesPerScanline - 1);
+  }
+
+  for (int scanLineIndex = firstScanLineIndex; scanLineIndex <= lastScanLineIndex; scanLineIndex++)
+  {
+    double* scanLineStartPoint_Reference = const_cast<double*>(&frameInfo.ScanLineStartPoints_Reference[4 * scanLineIndex]);
+    double* scanLineEndPoint_Reference = const_cast<double*>(&frameInfo.ScanLineEndPoints_Reference[4 * scanLineIndex]);
 
     if (this->NoiseAmplitude > 0)
     {
-      noiseSamplerLine_Reference->SetPoint1(scanLineStartPoint_Reference);
-      noiseSamplerLine_Reference->SetPoint2(scanLineEndPoint_Reference);
-      noiseSamplerLine_Reference->Update();
-      samplePointPositions_Reference = noiseSamplerLine_Reference->GetOutput()->GetPoints();
+      scratch.NoiseSamplerLine_Reference->SetPoint1(scanLineStartPoint_Reference);
+      scratch.NoiseSamplerLine_Reference->SetPoint2(scanLineEndPoint_Reference);
+      scratch.NoiseSamplerLine_Reference->Update();
+      samplePointPositions_Reference = scratch.NoiseSamplerLine_Reference->GetOutput()->GetPoints();
     }
 
     // Get model intersection positions along the scanline for all the models
-    std::deque<PlusSpatialModel::LineIntersectionInfo> lineIntersectionsWithModels;
+    lineIntersectionsWithModels.clear();
     for (std::vector<PlusSpatialModel>::iterator spatialModelIt = this->SpatialModels.begin(); spatialModelIt != this->SpatialModels.end(); ++spatialModelIt)
     {
       // Append line intersections found with this model to lineIntersectionsWithModels
-      spatialModelIt->GetLineIntersections(lineIntersectionsWithModels, scanLineStartPoint_Reference, scanLineEndPoint_Reference);
+      spatialModelIt->GetLineIntersections(lineIntersectionsWithModels, scanLineStartPoint_Reference, scanLineEndPoint_Reference, &scratch.LineIntersection);
     }
 
-    ConvertLineModelIntersectionsToSegmentDescriptor(lineIntersectionsWithModels);
+    ConvertLineModelIntersectionsToSegmentDescriptor(lineIntersectionsWithModels, scratch.InsideModels);
 
     int currentPixelIndex = 0;
     int scanLineExtent[6] = {0, this->NumberOfSamplesPerScanline - 1, scanLineIndex, scanLineIndex, 0, 0};
-    unsigned char* dstPixelAddress = (unsigned char*)scanLines->GetScalarPointerForExtent(scanLineExtent);
+    unsigned char* dstPixelAddress = (unsigned char*)frameInfo.ScanLines->GetScalarPointerForExtent(scanLineExtent);
     double incomingBeamIntensity = this->IncomingIntensityMwPerCm2 * 1000;
     int numIntersectionPoints = lineIntersectionsWithModels.size();
     if (numIntersectionPoints < 1)
     {
       LOG_ERROR("No intersections with any SpatialObjects. Probably no background object is specified.");
-      return 0;
+      return PLUS_FAIL;
     }
     PlusSpatialModel* previousModel = &this->TransducerSpatialModel;
     for (vtkIdType intersectionIndex = 0; (intersectionIndex <= numIntersectionPoints) && (currentPixelIndex < this->NumberOfSamplesPerScanline); intersectionIndex++)
@@ -294,7 +376,7 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
         for (int pixelIndex = 0; pixelIndex < numberOfFilledPixels; pixelIndex++)
         {
           samplePointPositions_Reference->GetPoint(currentPixelIndex + pixelIndex, samplePointPosition_Reference);
-          double noise = noiseFunction->EvaluateFunction(samplePointPosition_Reference);
+          double noise = frameInfo.NoiseFunction->EvaluateFunction(samplePointPosition_Reference);
           // Noise is multiplicative: NoisySignal = signal + noise * (signal-SignalMean) = signal*(1+noise) - noise*SignalMean;
           (*dstPixelAddress++) = std::max(std::min(this->BrightnessConversionOffset + this->BrightnessConversionScale * fastPow(intensities[pixelIndex], this->BrightnessConversionGamma) + noise, 255.0), 0.0);
         }
@@ -313,15 +395,7 @@ int vtkPlusUsSimulatorAlgo::RequestData(vtkInformation* request, vtkInformationV
     }
   }
 
-  vtkImageData* simulatedUsImage = vtkImageData::SafeDownCast(outInfo->Get(vtkDataObject::DATA_OBJECT()));
-  if (simulatedUsImage == NULL)
-  {
-    LOG_ERROR("vtkPlusUsSimulatorAlgo output type is invalid");
-    return 0;
-  }
-  this->RfProcessor->SetRfFrame(scanLines, US_IMG_BRIGHTNESS);
-  simulatedUsImage->DeepCopy(this->RfProcessor->GetBrightnessScanConvertedImage());
-  return 1;
+  return PLUS_SUCCESS;
 }
 
 bool lineIntersectionLessThan(PlusSpatialModel::LineIntersectionInfo a, PlusSpatialModel::LineIntersectionInfo b)
@@ -333,7 +407,7 @@ bool lineIntersectionLessThan(PlusSpatialModel::LineIntersectionInfo a, PlusSpat
 // at the given intersection position (e.g., background/spine/spine).
 // We overwrite the "Model" by the model that starts from that intersection position (e.g., background/spine/background).
 //-----------------------------------------------------------------------------
-void vtkPlusUsSimulatorAlgo::ConvertLineModelIntersectionsToSegmentDescriptor(std::deque<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels)
+void vtkPlusUsSimulatorAlgo::ConvertLineModelIntersectionsToSegmentDescriptor(std::vector<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels, std::vector<PlusSpatialModel*>& insideModel)
 {
   // sort intersections based on the intersection distance
   std::sort(lineIntersectionsWithModels.begin(), lineIntersectionsWithModels.end(), lineIntersectionLessThan);
@@ -350,17 +424,14 @@ void vtkPlusUsSimulatorAlgo::ConvertLineModelIntersectionsToSegmentDescriptor(st
   //   if we are in background+spine segment => it's spine
   //   if we are in background+spine+needle segment => it's needle
   // It is assumed that the SpatialModels are listed in the config file in increasing cohesiveness order (background is the first).
-  std::map< PlusSpatialModel*, int > cohesiveness;
-  for (unsigned int i = 0; i < this->SpatialModels.size(); i++)
-  {
-    cohesiveness[&this->SpatialModels[i]] = i;
-  }
+  // Therefore the cohesiveness of a model is its index in SpatialModels (all the intersections refer to models in SpatialModels).
+  PlusSpatialModel* firstModel = this->SpatialModels.data();
   // insideModel contains all the SpatialModels that the current segment is in; listed in descending order based on cohesiveness
-  std::list<PlusSpatialModel*> insideModel;
-  for (std::deque<PlusSpatialModel::LineIntersectionInfo>::iterator intersectionIt = lineIntersectionsWithModels.begin();
+  insideModel.clear();
+  for (std::vector<PlusSpatialModel::LineIntersectionInfo>::iterator intersectionIt = lineIntersectionsWithModels.begin();
        intersectionIt != lineIntersectionsWithModels.end(); ++intersectionIt)
   {
-    std::list<PlusSpatialModel*>::iterator foundThisModelAt = find(insideModel.begin(), insideModel.end(), intersectionIt->Model);
+    std::vector<PlusSpatialModel*>::iterator foundThisModelAt = find(insideModel.begin(), insideModel.end(), intersectionIt->Model);
     if (foundThisModelAt != insideModel.end())
     {
       // we were already inside this model, so now we are out
@@ -369,9 +440,9 @@ void vtkPlusUsSimulatorAlgo::ConvertLineModelIntersectionsToSegmentDescriptor(st
     else
     {
       // we were not inside this model, so now we are in - need to put this model into the list
-      int thisModelsCohesiveness = cohesiveness[intersectionIt->Model];
-      std::list<PlusSpatialModel*>::iterator insertThisModelAt = insideModel.begin();
-      while (insertThisModelAt != insideModel.end() && cohesiveness[*insertThisModelAt] > thisModelsCohesiveness)
+      ptrdiff_t thisModelsCohesiveness = intersectionIt->Model - firstModel;
+      std::vector<PlusSpatialModel*>::iterator insertThisModelAt = insideModel.begin();
+      while (insertThisModelAt != insideModel.end() && (*insertThisModelAt) - firstModel > thisModelsCohesiveness)
       {
         ++insertThisModelAt;
       }
@@ -405,6 +476,7 @@ PlusStatus vtkPlusUsSimulatorAlgo::ReadConfiguration(vtkXMLDataElement* config)
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, NoiseAmplitude, usSimulatorAlgoElement);
   XML_READ_VECTOR_ATTRIBUTE_OPTIONAL(double, 3, NoiseFrequency, usSimulatorAlgoElement);
   XML_READ_VECTOR_ATTRIBUTE_OPTIONAL(double, 3, NoisePhase, usSimulatorAlgoElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfThreads, usSimulatorAlgoElement);
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(ImageCoordinateFrame, usSimulatorAlgoElement);
   XML_READ_CSTRING_ATTRIBUTE_REQUIRED(ReferenceCoordinateFrame, usSimulatorAlgoElement);
 
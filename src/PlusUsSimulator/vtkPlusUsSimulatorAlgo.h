@@ -10,10 +10,14 @@
 #include "vtkPlusUsSimulatorExport.h"
 
 #include "vtkImageAlgorithm.h"
+#include "vtkMultiThreader.h"
+#include "vtkSmartPointer.h"
 
 #include "PlusSpatialModel.h"
 #include "vtkIGSIOTransformRepository.h"
 
+class vtkLineSource;
+class vtkPerlinNoise;
 class vtkPolyDataNormals;
 class vtkTriangleFilter;
 class vtkStripper;
@@ -104,13 +108,52 @@ public:
   vtkSetVector3Macro(NoiseFrequency, double);
   vtkSetVector3Macro(NoisePhase, double);
 
+  /*!
+    Set the number of threads that simulate scanlines in parallel. By default it is the number of processors.
+    The simulated image does not depend on the number of threads.
+  */
+  vtkSetMacro(NumberOfThreads, int);
+  /*! Get the number of threads that simulate scanlines in parallel */
+  vtkGetMacro(NumberOfThreads, int);
+
 protected:
+  /*! Objects that are reused for all the scanlines that are simulated on the same thread */
+  struct ScanLineScratch
+  {
+    ScanLineScratch() : Status(PLUS_SUCCESS) {}
+    std::vector<PlusSpatialModel::LineIntersectionInfo> LineIntersectionsWithModels;
+    std::vector<PlusSpatialModel*> InsideModels;
+    std::vector<double> Intensities;
+    PlusSpatialModel::LineIntersectionScratch LineIntersection;
+    vtkSmartPointer<vtkLineSource> NoiseSamplerLine_Reference;
+    PlusStatus Status;
+  };
+
+  /*! Data of the frame that is being simulated, shared by all the threads */
+  struct FrameSimulationInfo
+  {
+    vtkPlusUsSimulatorAlgo* Algo;
+    vtkImageData* ScanLines;
+    double DistanceBetweenScanlineSamplePointsMm;
+    /*! Start and end points of the scanlines in the reference coordinate system (4 homogeneous coordinates for each scanline) */
+    std::vector<double> ScanLineStartPoints_Reference;
+    std::vector<double> ScanLineEndPoints_Reference;
+    vtkPerlinNoise* NoiseFunction;
+  };
+
+
   virtual int FillOutputPortInformation(int port, vtkInformation* info);
   virtual int RequestData(vtkInformation* request,
                           vtkInformationVector** inputVector,
                           vtkInformationVector* outputVector);
 
-  void ConvertLineModelIntersectionsToSegmentDescriptor(std::deque<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels);
+  void ConvertLineModelIntersectionsToSegmentDescriptor(std::vector<PlusSpatialModel::LineIntersectionInfo>& lineIntersectionsWithModels, std::vector<PlusSpatialModel*>& insideModel);
+
+  /*! Simulate the scanlines from firstScanLineIndex to lastScanLineIndex (inclusive) */
+  PlusStatus SimulateScanLines(const FrameSimulationInfo& frameInfo, int firstScanLineIndex, int lastScanLineIndex, ScanLineScratch& scratch);
+
+  /*! Thread function that simulates a contiguous range of scanlines */
+  static VTK_THREAD_RETURN_TYPE SimulateScanLinesThread(void* arg);
 
 protected:
   vtkPlusUsSimulatorAlgo();
@@ -163,6 +206,14 @@ private:
   double NoiseAmplitude;
   double NoiseFrequency[3];
   double NoisePhase[3];
+
+  /*! Number of threads that simulate scanlines in parallel */
+  int NumberOfThreads;
+
+  vtkSmartPointer<vtkMultiThreader> Threader;
+
+  /*! Scratch objects of each thread, kept between frames to avoid reallocations */
+  std::vector<ScanLineScratch> ThreadScratch;
 };
 
 #endif // __vtkPlusUsSimulatorAlgo_h